@@ -32,6 +32,14 @@ void ReleaseFreeMemory() {
     release_free_memory_function();
 }
 
+bool SetAllocationHooks(thunks::AllocationHookFunction allocation_hook,
+                        thunks::FreeHookFunction free_hook) {
+  thunks::SetAllocationHooksFunction set_allocation_hooks_function =
+      thunks::GetSetAllocationHooksFunction();
+  return set_allocation_hooks_function != NULL &&
+         set_allocation_hooks_function(allocation_hook, free_hook);
+}
+
 void SetGetAllocatorWasteSizeFunction(
     thunks::GetAllocatorWasteSizeFunction get_allocator_waste_size_function) {
   DCHECK_EQ(thunks::GetGetAllocatorWasteSizeFunction(),
@@ -52,5 +60,12 @@ void SetReleaseFreeMemoryFunction(
   thunks::SetReleaseFreeMemoryFunction(release_free_memory_function);
 }
 
+void SetSetAllocationHooksFunction(
+    thunks::SetAllocationHooksFunction set_allocation_hooks_function) {
+  DCHECK_EQ(thunks::GetSetAllocationHooksFunction(),
+            reinterpret_cast<thunks::SetAllocationHooksFunction>(NULL));
+  thunks::SetSetAllocationHooksFunction(set_allocation_hooks_function);
+}
+
 }  // namespace allocator
 }  // namespace base
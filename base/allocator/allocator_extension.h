@@ -35,6 +35,13 @@ BASE_EXPORT void GetStats(char* buffer, int buffer_length);
 // system.
 BASE_EXPORT void ReleaseFreeMemory();
 
+// Request that the allocator call |allocation_hook| after each allocation and
+// |free_hook| before each free, in place of the hooks set before, or no hooks
+// if they are NULL. The hooks are called on the allocating thread, and must
+// not allocate. Returns false if the allocator doesn't support hooks.
+BASE_EXPORT bool SetAllocationHooks(
+    thunks::AllocationHookFunction allocation_hook,
+    thunks::FreeHookFunction free_hook);
 
 // These settings allow specifying a callback used to implement the allocator
 // extension functions.  These are optional, but if set they must only be set
@@ -53,6 +60,9 @@ BASE_EXPORT void SetGetStatsFunction(
 BASE_EXPORT void SetReleaseFreeMemoryFunction(
     thunks::ReleaseFreeMemoryFunction release_free_memory_function);
 
+BASE_EXPORT void SetSetAllocationHooksFunction(
+    thunks::SetAllocationHooksFunction set_allocation_hooks_function);
+
 }  // namespace allocator
 }  // namespace base
 
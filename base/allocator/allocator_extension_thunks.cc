@@ -20,6 +20,7 @@ namespace thunks {
 static GetAllocatorWasteSizeFunction g_get_allocator_waste_size_function = NULL;
 static GetStatsFunction g_get_stats_function = NULL;
 static ReleaseFreeMemoryFunction g_release_free_memory_function = NULL;
+static SetAllocationHooksFunction g_set_allocation_hooks_function = NULL;
 
 void SetGetAllocatorWasteSizeFunction(
     GetAllocatorWasteSizeFunction get_allocator_waste_size_function) {
@@ -47,6 +48,15 @@ ReleaseFreeMemoryFunction GetReleaseFreeMemoryFunction() {
   return g_release_free_memory_function;
 }
 
+void SetSetAllocationHooksFunction(
+    SetAllocationHooksFunction set_allocation_hooks_function) {
+  g_set_allocation_hooks_function = set_allocation_hooks_function;
+}
+
+SetAllocationHooksFunction GetSetAllocationHooksFunction() {
+  return g_set_allocation_hooks_function;
+}
+
 }  // namespace thunks
 }  // namespace allocator
 }  // namespace base
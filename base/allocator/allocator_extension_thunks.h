@@ -29,6 +29,19 @@ void SetReleaseFreeMemoryFunction(
     ReleaseFreeMemoryFunction release_free_memory_function);
 ReleaseFreeMemoryFunction GetReleaseFreeMemoryFunction();
 
+// Called after each allocation, and before each free, with the address of the
+// block.
+typedef void (*AllocationHookFunction)(const void* address, size_t size);
+typedef void (*FreeHookFunction)(const void* address);
+// Replaces the hooks the allocator calls, or removes them if NULL. Returns
+// false if they could not be installed.
+typedef bool (*SetAllocationHooksFunction)(
+    AllocationHookFunction allocation_hook,
+    FreeHookFunction free_hook);
+void SetSetAllocationHooksFunction(
+    SetAllocationHooksFunction set_allocation_hooks_function);
+SetAllocationHooksFunction GetSetAllocationHooksFunction();
+
 }  // namespace thunks
 }  // namespace allocator
 }  // namespace base
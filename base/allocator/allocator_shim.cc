@@ -47,6 +47,10 @@ static Allocator allocator = TCMALLOC;
 static const char primary_name[] = "CHROME_ALLOCATOR";
 static const char secondary_name[] = "CHROME_ALLOCATOR_2";
 
+// Hooks set through base::allocator::SetAllocationHooks(), for heap profilers.
+static base::allocator::thunks::AllocationHookFunction allocation_hook = NULL;
+static base::allocator::thunks::FreeHookFunction free_hook = NULL;
+
 // We include tcmalloc and the win_allocator to get as much inlining as
 // possible.
 #include "debugallocation_shim.cc"
@@ -108,8 +112,11 @@ void* malloc(size_t size) {
         ptr = do_malloc(size);
         break;
     }
-    if (ptr)
+    if (ptr) {
+      if (allocation_hook)
+        allocation_hook(ptr, size);
       return ptr;
+    }
 
     if (!new_mode || !call_new_handler(true))
       break;
@@ -118,6 +125,8 @@ void* malloc(size_t size) {
 }
 
 void free(void* p) {
+  if (free_hook)
+    free_hook(p);
   switch (allocator) {
     case WINHEAP:
     case WINLFH:
@@ -152,8 +161,13 @@ void* realloc(void* ptr, size_t size) {
     // Subtle warning:  NULL return does not alwas indicate out-of-memory.  If
     // the requested new size is zero, realloc should free the ptr and return
     // NULL.
-    if (new_ptr || !size)
+    if (new_ptr || !size) {
+      if (free_hook)
+        free_hook(ptr);
+      if (new_ptr && allocation_hook)
+        allocation_hook(new_ptr, size);
       return new_ptr;
+    }
     if (!new_mode || !call_new_handler(true))
       break;
   }
@@ -219,6 +233,14 @@ static void release_free_memory_thunk() {
   MallocExtension::instance()->ReleaseFreeMemory();
 }
 
+static bool set_allocation_hooks_thunk(
+    base::allocator::thunks::AllocationHookFunction new_allocation_hook,
+    base::allocator::thunks::FreeHookFunction new_free_hook) {
+  allocation_hook = new_allocation_hook;
+  free_hook = new_free_hook;
+  return true;
+}
+
 // The CRT heap initialization stub.
 extern "C" int _heap_init() {
 // Don't use the environment variable if SYZYASAN is defined, as the
@@ -235,6 +257,10 @@ extern "C" int _heap_init() {
   }
 #endif
 
+  // The hooks are called by the shim, whichever the allocator.
+  base::allocator::thunks::SetSetAllocationHooksFunction(
+      set_allocation_hooks_thunk);
+
   switch (allocator) {
     case WINHEAP:
       return win_heap_init(false) ? 1 : 0;
@@ -306,6 +332,8 @@ void* _aligned_malloc(size_t size, size_t alignment) {
     if (ptr) {
       // Sanity check alignment.
       DCHECK_EQ(reinterpret_cast<uintptr_t>(ptr) & (alignment - 1), 0U);
+      if (allocation_hook)
+        allocation_hook(ptr, size);
       return ptr;
     }
 
@@ -316,6 +344,8 @@ void* _aligned_malloc(size_t size, size_t alignment) {
 }
 
 void _aligned_free(void* p) {
+  if (free_hook)
+    free_hook(p);
   // TCMalloc returns pointers from memalign() that are safe to use with free().
   // Pointers allocated with win_heap_memalign() MUST be freed via
   // win_heap_memalign_free() since the aligned pointer is not the real one.
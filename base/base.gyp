@@ -5,6 +5,9 @@
 {
   'variables': {
     'chromium_code': 1,
+    # Set to 1 to build MessagePumpIoUring, which needs the io_uring headers
+    # of Linux 5.11 or later.
+    'use_io_uring%': 0,
   },
   'includes': [
     '../build/win_precompile.gypi',
@@ -447,6 +450,10 @@
         'callback_unittest.nc',
         'cancelable_callback_unittest.cc',
         'command_line_unittest.cc',
+        'containers/flat_hash_map_unittest.cc',
+        'containers/flat_hash_set_unittest.cc',
+        'containers/flat_map_unittest.cc',
+        'containers/flat_set_unittest.cc',
         'containers/hash_tables_unittest.cc',
         'containers/linked_list_unittest.cc',
         'containers/mru_cache_unittest.cc',
@@ -456,9 +463,12 @@
         'debug/crash_logging_unittest.cc',
         'debug/leak_tracker_unittest.cc',
         'debug/proc_maps_linux_unittest.cc',
+        'debug/sampling_heap_profiler_unittest.cc',
         'debug/stack_trace_unittest.cc',
         'debug/task_annotator_unittest.cc',
         'debug/trace_event_argument_unittest.cc',
+        'debug/trace_event_binary_unittest.cc',
+        'debug/trace_event_cpu_profiler_unittest.cc',
         'debug/trace_event_memory_unittest.cc',
         'debug/trace_event_synthetic_delay_unittest.cc',
         'debug/trace_event_system_stats_monitor_unittest.cc',
@@ -474,8 +484,10 @@
         'files/file_unittest.cc',
         'files/file_util_proxy_unittest.cc',
         'files/file_util_unittest.cc',
+        'files/important_file_commit_scheduler_unittest.cc',
         'files/important_file_writer_unittest.cc',
         'files/memory_mapped_file_unittest.cc',
+        'files/parallel_file_enumerator_unittest.cc',
         'files/scoped_temp_dir_unittest.cc',
         'gmock_unittest.cc',
         'guid_unittest.cc',
@@ -495,6 +507,7 @@
         'ios/device_util_unittest.mm',
         'json/json_parser_unittest.cc',
         'json/json_reader_unittest.cc',
+        'json/json_stream_reader_unittest.cc',
         'json/json_value_converter_unittest.cc',
         'json/json_value_serializer_unittest.cc',
         'json/json_writer_unittest.cc',
@@ -523,20 +536,25 @@
         'memory/singleton_unittest.cc',
         'memory/weak_ptr_unittest.cc',
         'memory/weak_ptr_unittest.nc',
+        'message_loop/delayed_task_wheel_unittest.cc',
         'message_loop/message_loop_proxy_impl_unittest.cc',
         'message_loop/message_loop_proxy_unittest.cc',
         'message_loop/message_loop_unittest.cc',
         'message_loop/message_pump_glib_unittest.cc',
         'message_loop/message_pump_io_ios_unittest.cc',
         'message_loop/message_pump_libevent_unittest.cc',
+        'message_loop/mpsc_task_queue_unittest.cc',
         'metrics/sample_map_unittest.cc',
         'metrics/sample_vector_unittest.cc',
+        'metrics/sharded_sample_vector_unittest.cc',
         'metrics/bucket_ranges_unittest.cc',
         'metrics/field_trial_unittest.cc',
         'metrics/histogram_base_unittest.cc',
         'metrics/histogram_delta_serialization_unittest.cc',
         'metrics/histogram_snapshot_manager_unittest.cc',
         'metrics/histogram_unittest.cc',
+        'metrics/persistent_histogram_allocator_unittest.cc',
+        'metrics/persistent_memory_allocator_unittest.cc',
         'metrics/sparse_histogram_unittest.cc',
         'metrics/stats_table_unittest.cc',
         'metrics/statistics_recorder_unittest.cc',
@@ -576,6 +594,7 @@
         'stl_util_unittest.cc',
         'strings/nullable_string16_unittest.cc',
         'strings/safe_sprintf_unittest.cc',
+        'strings/shared_string_piece_unittest.cc',
         'strings/string16_unittest.cc',
         'strings/stringprintf_unittest.cc',
         'strings/string_number_conversions_unittest.cc',
@@ -798,6 +817,16 @@
             'memory/discardable_memory_ashmem_allocator_unittest.cc',
           ],
         }],
+        ['OS == "linux"', {
+          'sources': [
+            'memory/discardable_memory_pooled_allocator_unittest.cc',
+          ],
+        }],
+        ['OS == "linux" and use_io_uring == 1', {
+          'sources': [
+            'message_loop/message_pump_io_uring_unittest.cc',
+          ],
+        }],
         ['OS == "android"', {
           'sources/': [
             ['include', '^debug/proc_maps_linux_unittest\\.cc$'],
@@ -814,6 +843,17 @@
         '../testing/gtest.gyp:gtest',
       ],
       'sources': [
+        'containers/flat_hash_map_perftest.cc',
+        'debug/sampling_heap_profiler_perftest.cc',
+        'files/important_file_writer_perftest.cc',
+        'files/parallel_file_enumerator_perftest.cc',
+        'json/json_perftest.cc',
+        'memory/discardable_memory_perftest.cc',
+        'metrics/histogram_perftest.cc',
+        'message_loop/delayed_task_wheel_perftest.cc',
+        'message_loop/message_loop_perftest.cc',
+        'strings/utf_string_conversions_perftest.cc',
+        'threading/sequenced_worker_pool_perftest.cc',
         'threading/thread_perftest.cc',
         'test/run_all_unittests.cc',
         '../testing/perf/perf_test.cc'
@@ -824,6 +864,11 @@
             '../testing/android/native_test.gyp:native_test_native_code',
           ],
         }],
+        ['OS == "linux" and use_io_uring == 1', {
+          'sources': [
+            'message_loop/message_pump_io_uring_perftest.cc',
+          ],
+        }],
       ],
     },
     {
@@ -0,0 +1,139 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef BASE_CONTAINERS_FLAT_HASH_MAP_H_
+#define BASE_CONTAINERS_FLAT_HASH_MAP_H_
+
+#include <functional>
+#include <utility>
+
+#include "base/containers/flat_hash_table.h"
+
+namespace base {
+
+// An unordered map with the interface of base::hash_map that keeps all of its
+// values in a single array instead of allocating a node per value. Lookups
+// touch one or two cache lines in the common case, and inserting only
+// allocates when the table grows.
+//
+// WHEN TO USE IT
+// --------------
+//
+// Prefer it over base::hash_map for maps on hot paths that are looked up much
+// more often than they are iterated, with keys and values that are cheap to
+// copy (integers, pointers, short strings). Values are copied when the table
+// grows, so store large values through a pointer.
+//
+// With |kInlineCapacity| set (0, or a power of two of at least 4) the first
+// slots live inside the map itself, like SmallMap's array, so a map that stays
+// below 3/4 of that size never touches the heap.
+//
+// DIFFERENCES FROM base::hash_map
+// -------------------------------
+//
+//  - insert() and operator[] may invalidate all iterators and pointers to
+//    values, since values move when the table grows. Use reserve() up front to
+//    avoid that.
+//  - erase() never moves other values and returns nothing, so erasing while
+//    iterating is done with |map.erase(it++)|.
+//  - Only forward iteration is supported, and the order is unspecified.
+//
+// Example:
+//   base::FlatHashMap<int, std::string> names;
+//   names[3] = "three";
+//   if (names.find(3) != names.end())
+//     ...
+template <typename Key,
+          typename Mapped,
+          typename Hash = internal::FlatHashDefaultHash<Key>,
+          typename KeyEqual = std::equal_to<Key>,
+          size_t kInlineCapacity = 0>
+class FlatHashMap {
+ private:
+  struct SelectKey {
+    const Key& operator()(const std::pair<const Key, Mapped>& value) const {
+      return value.first;
+    }
+  };
+
+  // Builds the value operator[] inserts for a missing key.
+  class DefaultValueMaker {
+   public:
+    explicit DefaultValueMaker(const Key& key) : key_(key) {}
+    std::pair<const Key, Mapped> operator()() const {
+      return std::make_pair(key_, Mapped());
+    }
+
+   private:
+    const Key& key_;
+  };
+
+  typedef internal::FlatHashTable<Key, std::pair<const Key, Mapped>, SelectKey,
+                                  Hash, KeyEqual, kInlineCapacity> Table;
+
+ public:
+  typedef typename Table::key_type key_type;
+  typedef Mapped mapped_type;
+  typedef Mapped data_type;
+  typedef typename Table::value_type value_type;
+  typedef typename Table::size_type size_type;
+  typedef typename Table::difference_type difference_type;
+  typedef typename Table::hasher hasher;
+  typedef typename Table::key_equal key_equal;
+  typedef typename Table::iterator iterator;
+  typedef typename Table::const_iterator const_iterator;
+
+  FlatHashMap() {}
+
+  template <typename InputIterator>
+  FlatHashMap(InputIterator first, InputIterator last) {
+    table_.insert(first, last);
+  }
+
+  // Allow copy-constructor and assignment, since STL allows them too.
+
+  iterator begin() { return table_.begin(); }
+  iterator end() { return table_.end(); }
+  const_iterator begin() const { return table_.begin(); }
+  const_iterator end() const { return table_.end(); }
+
+  bool empty() const { return table_.empty(); }
+  size_type size() const { return table_.size(); }
+  size_type capacity() const { return table_.capacity(); }
+  bool UsingHeapStorage() const { return table_.UsingHeapStorage(); }
+
+  hasher hash_function() const { return table_.hash_function(); }
+  key_equal key_eq() const { return table_.key_eq(); }
+
+  iterator find(const key_type& key) { return table_.find(key); }
+  const_iterator find(const key_type& key) const { return table_.find(key); }
+  size_type count(const key_type& key) const { return table_.count(key); }
+
+  Mapped& operator[](const key_type& key) {
+    return table_.FindOrInsert(key, DefaultValueMaker(key)).first->second;
+  }
+
+  std::pair<iterator, bool> insert(const value_type& value) {
+    return table_.insert(value);
+  }
+  template <typename InputIterator>
+  void insert(InputIterator first, InputIterator last) {
+    table_.insert(first, last);
+  }
+
+  void erase(iterator position) { table_.erase(position); }
+  void erase(const_iterator position) { table_.erase(position); }
+  size_type erase(const key_type& key) { return table_.erase(key); }
+
+  void clear() { table_.clear(); }
+  void reserve(size_type count) { table_.reserve(count); }
+  void swap(FlatHashMap& other) { table_.swap(other.table_); }
+
+ private:
+  Table table_;
+};
+
+}  // namespace base
+
+#endif  // BASE_CONTAINERS_FLAT_HASH_MAP_H_
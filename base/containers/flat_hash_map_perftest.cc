@@ -0,0 +1,145 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "base/containers/flat_hash_map.h"
+#include "base/containers/hash_tables.h"
+#include "base/strings/stringprintf.h"
+#include "base/time/time.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "testing/perf/perf_test.h"
+
+namespace base {
+
+namespace {
+
+const size_t kSizes[] = { 16, 1024, 100000 };
+
+// Each measurement runs at least this many operations, over as many maps as
+// it takes.
+const size_t kOperationsPerMeasurement = 2000000;
+
+template <typename Key>
+Key MakeKey(size_t i);
+
+template <>
+int MakeKey<int>(size_t i) {
+  // Spread the keys out so they don't happen to be sequential slots.
+  return static_cast<int>(i * 2654435761U);
+}
+
+template <>
+std::string MakeKey<std::string>(size_t i) {
+  return StringPrintf("key-%08x", static_cast<unsigned>(i * 2654435761U));
+}
+
+// Shuffles |keys| with a fixed seed, so that runs are comparable.
+template <typename Key>
+void Shuffle(std::vector<Key>* keys) {
+  uint32 random = 12345;
+  for (size_t i = keys->size(); i > 1; --i) {
+    random = random * 1103515245 + 12345;
+    std::swap((*keys)[i - 1], (*keys)[(random >> 8) % i]);
+  }
+}
+
+void PrintNsPerOp(const std::string& measurement,
+                  const std::string& key_type,
+                  size_t size,
+                  const std::string& trace,
+                  TimeDelta elapsed,
+                  size_t operations) {
+  perf_test::PrintResult(
+      measurement, StringPrintf("_%s_%u", key_type.c_str(),
+                                static_cast<unsigned>(size)),
+      trace, elapsed.InMicroseconds() * 1000.0 / operations, "ns/op", true);
+}
+
+// Times insert, successful and failed find, iteration and erase of |size|
+// keys on a |Map|, which is rebuilt as often as needed. Lookups and erases go
+// in a different order than the inserts, since a node-based map would
+// otherwise find its nodes laid out in memory in lookup order.
+template <typename Map, typename Key>
+void RunMapTest(const std::string& trace,
+                const std::string& key_type,
+                size_t size) {
+  std::vector<Key> keys;
+  std::vector<Key> missing_keys;
+  for (size_t i = 0; i < size; ++i) {
+    keys.push_back(MakeKey<Key>(i));
+    missing_keys.push_back(MakeKey<Key>(i + size));
+  }
+  std::vector<Key> shuffled_keys(keys);
+  Shuffle(&shuffled_keys);
+  size_t rounds = std::max<size_t>(1, kOperationsPerMeasurement / size);
+  size_t operations = rounds * size;
+
+  TimeDelta insert_time;
+  TimeDelta find_time;
+  TimeDelta find_missing_time;
+  TimeDelta iterate_time;
+  TimeDelta erase_time;
+  // Accumulated so that the compiler can't drop the lookups.
+  size_t found = 0;
+  for (size_t round = 0; round < rounds; ++round) {
+    Map map;
+    TimeTicks start = TimeTicks::HighResNow();
+    for (size_t i = 0; i < size; ++i)
+      map[keys[i]] = i;
+    TimeTicks inserted = TimeTicks::HighResNow();
+    for (size_t i = 0; i < size; ++i)
+      found += map.find(shuffled_keys[i])->second;
+    TimeTicks looked_up = TimeTicks::HighResNow();
+    for (size_t i = 0; i < size; ++i)
+      found += map.count(missing_keys[i]);
+    TimeTicks missed = TimeTicks::HighResNow();
+    for (typename Map::const_iterator it = map.begin(); it != map.end(); ++it)
+      found += it->second;
+    TimeTicks iterated = TimeTicks::HighResNow();
+    for (size_t i = 0; i < size; ++i)
+      map.erase(shuffled_keys[i]);
+    TimeTicks erased = TimeTicks::HighResNow();
+    EXPECT_TRUE(map.empty());
+
+    insert_time += inserted - start;
+    find_time += looked_up - inserted;
+    find_missing_time += missed - looked_up;
+    iterate_time += iterated - missed;
+    erase_time += erased - iterated;
+  }
+  EXPECT_EQ(rounds * size * (size - 1), found);
+
+  PrintNsPerOp("map_insert", key_type, size, trace, insert_time, operations);
+  PrintNsPerOp("map_find", key_type, size, trace, find_time, operations);
+  PrintNsPerOp("map_find_missing", key_type, size, trace, find_missing_time,
+               operations);
+  PrintNsPerOp("map_iterate", key_type, size, trace, iterate_time, operations);
+  PrintNsPerOp("map_erase", key_type, size, trace, erase_time, operations);
+}
+
+template <typename Key>
+void RunAllMaps(const std::string& key_type) {
+  for (size_t i = 0; i < arraysize(kSizes); ++i) {
+    RunMapTest<FlatHashMap<Key, size_t>, Key>("flat_hash_map", key_type,
+                                              kSizes[i]);
+    RunMapTest<hash_map<Key, size_t>, Key>("hash_map", key_type, kSizes[i]);
+    RunMapTest<std::map<Key, size_t>, Key>("std_map", key_type, kSizes[i]);
+  }
+}
+
+}  // namespace
+
+TEST(FlatHashMapPerfTest, IntKeys) {
+  RunAllMaps<int>("int");
+}
+
+TEST(FlatHashMapPerfTest, StringKeys) {
+  RunAllMaps<std::string>("string");
+}
+
+}  // namespace base
@@ -0,0 +1,259 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/containers/flat_hash_map.h"
+
+#include <map>
+#include <string>
+
+#include "base/strings/string_number_conversions.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace base {
+
+namespace {
+
+// Sends every key to the same slot, so every lookup walks a probe sequence.
+struct CollidingHash {
+  size_t operator()(int key) const { return 0; }
+};
+
+// Counts live instances to check that every value is destroyed exactly once.
+class Counted {
+ public:
+  Counted() : value_(0) { ++live_count_; }
+  explicit Counted(int value) : value_(value) { ++live_count_; }
+  Counted(const Counted& other) : value_(other.value_) { ++live_count_; }
+  ~Counted() { --live_count_; }
+
+  int value() const { return value_; }
+  static int live_count() { return live_count_; }
+
+ private:
+  int value_;
+  static int live_count_;
+};
+
+int Counted::live_count_ = 0;
+
+}  // namespace
+
+TEST(FlatHashMapTest, General) {
+  FlatHashMap<int, int> m;
+  EXPECT_TRUE(m.empty());
+  EXPECT_EQ(0u, m.size());
+  EXPECT_TRUE(m.begin() == m.end());
+  EXPECT_TRUE(m.find(1) == m.end());
+  EXPECT_FALSE(m.UsingHeapStorage());
+
+  m[0] = 5;
+  m[9] = 2;
+  EXPECT_FALSE(m.empty());
+  EXPECT_EQ(2u, m.size());
+  EXPECT_EQ(5, m[0]);
+  EXPECT_EQ(2, m[9]);
+  EXPECT_EQ(1u, m.count(9));
+  EXPECT_EQ(0u, m.count(8));
+
+  std::pair<FlatHashMap<int, int>::iterator, bool> result =
+      m.insert(std::make_pair(9, 7));
+  EXPECT_FALSE(result.second);
+  EXPECT_EQ(9, result.first->first);
+  EXPECT_EQ(2, result.first->second);
+
+  result = m.insert(std::make_pair(-5, 6));
+  EXPECT_TRUE(result.second);
+  EXPECT_EQ(6, result.first->second);
+  EXPECT_EQ(3u, m.size());
+
+  int sum = 0;
+  size_t count = 0;
+  for (FlatHashMap<int, int>::const_iterator it = m.begin(); it != m.end();
+       ++it) {
+    sum += it->second;
+    ++count;
+  }
+  EXPECT_EQ(13, sum);
+  EXPECT_EQ(3u, count);
+
+  EXPECT_EQ(1u, m.erase(0));
+  EXPECT_EQ(0u, m.erase(0));
+  EXPECT_TRUE(m.find(0) == m.end());
+  EXPECT_EQ(2u, m.size());
+
+  m.clear();
+  EXPECT_TRUE(m.empty());
+  EXPECT_TRUE(m.begin() == m.end());
+}
+
+TEST(FlatHashMapTest, MatchesStdMap) {
+  FlatHashMap<int, int> m;
+  std::map<int, int> expected;
+  // A fixed linear congruential sequence, so that failures reproduce.
+  uint32 random = 12345;
+  for (int i = 0; i < 20000; ++i) {
+    random = random * 1103515245 + 12345;
+    int key = (random >> 8) % 1000;
+    if (random & 1) {
+      m[key] = i;
+      expected[key] = i;
+    } else {
+      EXPECT_EQ(expected.erase(key), m.erase(key));
+    }
+    ASSERT_EQ(expected.size(), m.size());
+  }
+
+  for (std::map<int, int>::const_iterator it = expected.begin();
+       it != expected.end(); ++it) {
+    FlatHashMap<int, int>::const_iterator found = m.find(it->first);
+    ASSERT_TRUE(found != m.end());
+    EXPECT_EQ(it->second, found->second);
+  }
+  std::map<int, int> iterated(m.begin(), m.end());
+  EXPECT_TRUE(expected == iterated);
+}
+
+TEST(FlatHashMapTest, Collisions) {
+  FlatHashMap<int, int, CollidingHash> m;
+  for (int i = 0; i < 100; ++i)
+    m[i] = i * 2;
+  for (int i = 0; i < 100; i += 2)
+    m.erase(i);
+  EXPECT_EQ(50u, m.size());
+  for (int i = 0; i < 100; ++i) {
+    if (i % 2)
+      EXPECT_EQ(i * 2, m.find(i)->second);
+    else
+      EXPECT_TRUE(m.find(i) == m.end());
+  }
+}
+
+TEST(FlatHashMapTest, EraseWhileIterating) {
+  FlatHashMap<int, int> m;
+  for (int i = 0; i < 1000; ++i)
+    m[i] = i;
+  for (FlatHashMap<int, int>::iterator it = m.begin(); it != m.end();) {
+    if (it->first % 3)
+      m.erase(it++);
+    else
+      ++it;
+  }
+  EXPECT_EQ(334u, m.size());
+  for (FlatHashMap<int, int>::iterator it = m.begin(); it != m.end(); ++it)
+    EXPECT_EQ(0, it->first % 3);
+}
+
+TEST(FlatHashMapTest, TombstonesDoNotGrowTable) {
+  FlatHashMap<int, int> m;
+  for (int i = 0; i < 50; ++i)
+    m[i] = i;
+  size_t capacity = m.capacity();
+
+  // Churning through keys at a constant size must reuse the slots rather than
+  // keep growing the table.
+  for (int i = 50; i < 100000; ++i) {
+    m.erase(i - 50);
+    m[i] = i;
+  }
+  EXPECT_EQ(50u, m.size());
+  EXPECT_EQ(capacity, m.capacity());
+  for (int i = 100000 - 50; i < 100000; ++i)
+    EXPECT_EQ(i, m[i]);
+}
+
+TEST(FlatHashMapTest, Reserve) {
+  FlatHashMap<int, int> m;
+  m.reserve(1000);
+  size_t capacity = m.capacity();
+  EXPECT_GE(capacity, 1000u);
+  m[0] = 0;
+  FlatHashMap<int, int>::iterator first = m.find(0);
+  for (int i = 1; i < 1000; ++i)
+    m[i] = i;
+  EXPECT_EQ(capacity, m.capacity());
+  // No rehash happened, so the iterator is still valid.
+  EXPECT_TRUE(first == m.find(0));
+}
+
+TEST(FlatHashMapTest, InlineStorage) {
+  typedef FlatHashMap<int, int, internal::FlatHashDefaultHash<int>,
+                      std::equal_to<int>, 8> InlineMap;
+  InlineMap m;
+  EXPECT_EQ(8u, m.capacity());
+  // 3/4 of the inline slots can be used before spilling to the heap.
+  for (int i = 0; i < 6; ++i)
+    m[i] = i;
+  EXPECT_FALSE(m.UsingHeapStorage());
+
+  InlineMap inline_copy(m);
+  EXPECT_FALSE(inline_copy.UsingHeapStorage());
+  EXPECT_EQ(6u, inline_copy.size());
+
+  m[6] = 6;
+  EXPECT_TRUE(m.UsingHeapStorage());
+  for (int i = 0; i < 7; ++i)
+    EXPECT_EQ(i, m[i]);
+
+  // Swap an inline map with a heap map in both directions.
+  inline_copy.swap(m);
+  EXPECT_TRUE(inline_copy.UsingHeapStorage());
+  EXPECT_EQ(7u, inline_copy.size());
+  EXPECT_FALSE(m.UsingHeapStorage());
+  EXPECT_EQ(6u, m.size());
+  m.swap(inline_copy);
+  EXPECT_EQ(7u, m.size());
+  EXPECT_EQ(6u, inline_copy.size());
+}
+
+TEST(FlatHashMapTest, CopyAndAssign) {
+  FlatHashMap<std::string, int> m;
+  for (int i = 0; i < 100; ++i)
+    m[IntToString(i)] = i;
+  m.erase("50");
+
+  FlatHashMap<std::string, int> copy(m);
+  EXPECT_EQ(99u, copy.size());
+  EXPECT_EQ(42, copy["42"]);
+  EXPECT_TRUE(copy.find("50") == copy.end());
+
+  FlatHashMap<std::string, int> assigned;
+  assigned["stale"] = 1;
+  assigned = m;
+  EXPECT_EQ(99u, assigned.size());
+  EXPECT_TRUE(assigned.find("stale") == assigned.end());
+  EXPECT_EQ(99, assigned["99"]);
+
+  // The copies are independent.
+  m["42"] = -1;
+  EXPECT_EQ(42, copy["42"]);
+  EXPECT_EQ(42, assigned["42"]);
+
+  FlatHashMap<std::string, int> other;
+  other["a"] = 1;
+  other.swap(m);
+  EXPECT_EQ(99u, other.size());
+  EXPECT_EQ(1u, m.size());
+  EXPECT_EQ(1, m["a"]);
+}
+
+TEST(FlatHashMapTest, DestroysValues) {
+  {
+    FlatHashMap<int, Counted> m;
+    for (int i = 0; i < 200; ++i)
+      m.insert(std::make_pair(i, Counted(i)));
+    EXPECT_EQ(200, Counted::live_count());
+    for (int i = 0; i < 100; ++i)
+      m.erase(i);
+    EXPECT_EQ(100, Counted::live_count());
+    EXPECT_EQ(150, m[150].value());
+
+    FlatHashMap<int, Counted> copy(m);
+    EXPECT_EQ(200, Counted::live_count());
+    copy.clear();
+    EXPECT_EQ(100, Counted::live_count());
+  }
+  EXPECT_EQ(0, Counted::live_count());
+}
+
+}  // namespace base
@@ -0,0 +1,91 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef BASE_CONTAINERS_FLAT_HASH_SET_H_
+#define BASE_CONTAINERS_FLAT_HASH_SET_H_
+
+#include <functional>
+#include <utility>
+
+#include "base/containers/flat_hash_table.h"
+
+namespace base {
+
+// An unordered set with the interface of base::hash_set that keeps all of its
+// elements in a single array. See flat_hash_map.h for when to use it and how
+// it differs from base::hash_set; the same applies here.
+//
+// Example:
+//   base::FlatHashSet<int, internal::FlatHashDefaultHash<int>,
+//                     std::equal_to<int>, 8> ids;  // No heap up to 6 ids.
+//   ids.insert(42);
+template <typename Key,
+          typename Hash = internal::FlatHashDefaultHash<Key>,
+          typename KeyEqual = std::equal_to<Key>,
+          size_t kInlineCapacity = 0>
+class FlatHashSet {
+ private:
+  struct Identity {
+    const Key& operator()(const Key& value) const { return value; }
+  };
+
+  typedef internal::FlatHashTable<Key, Key, Identity, Hash, KeyEqual,
+                                  kInlineCapacity> Table;
+
+ public:
+  typedef typename Table::key_type key_type;
+  typedef typename Table::value_type value_type;
+  typedef typename Table::size_type size_type;
+  typedef typename Table::difference_type difference_type;
+  typedef typename Table::hasher hasher;
+  typedef typename Table::key_equal key_equal;
+  // Elements can't be modified in place, since that could change their hash.
+  typedef typename Table::const_iterator iterator;
+  typedef typename Table::const_iterator const_iterator;
+
+  FlatHashSet() {}
+
+  template <typename InputIterator>
+  FlatHashSet(InputIterator first, InputIterator last) {
+    table_.insert(first, last);
+  }
+
+  // Allow copy-constructor and assignment, since STL allows them too.
+
+  const_iterator begin() const { return table_.begin(); }
+  const_iterator end() const { return table_.end(); }
+
+  bool empty() const { return table_.empty(); }
+  size_type size() const { return table_.size(); }
+  size_type capacity() const { return table_.capacity(); }
+  bool UsingHeapStorage() const { return table_.UsingHeapStorage(); }
+
+  hasher hash_function() const { return table_.hash_function(); }
+  key_equal key_eq() const { return table_.key_eq(); }
+
+  const_iterator find(const key_type& key) const { return table_.find(key); }
+  size_type count(const key_type& key) const { return table_.count(key); }
+
+  std::pair<iterator, bool> insert(const value_type& value) {
+    return table_.insert(value);
+  }
+  template <typename InputIterator>
+  void insert(InputIterator first, InputIterator last) {
+    table_.insert(first, last);
+  }
+
+  void erase(const_iterator position) { table_.erase(position); }
+  size_type erase(const key_type& key) { return table_.erase(key); }
+
+  void clear() { table_.clear(); }
+  void reserve(size_type count) { table_.reserve(count); }
+  void swap(FlatHashSet& other) { table_.swap(other.table_); }
+
+ private:
+  Table table_;
+};
+
+}  // namespace base
+
+#endif  // BASE_CONTAINERS_FLAT_HASH_SET_H_
@@ -0,0 +1,48 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/containers/flat_hash_set.h"
+
+#include <set>
+#include <string>
+
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace base {
+
+TEST(FlatHashSetTest, General) {
+  FlatHashSet<std::string> s;
+  EXPECT_TRUE(s.empty());
+  EXPECT_TRUE(s.insert("a").second);
+  EXPECT_TRUE(s.insert("b").second);
+  EXPECT_FALSE(s.insert("a").second);
+  EXPECT_EQ(2u, s.size());
+  EXPECT_EQ(1u, s.count("a"));
+  EXPECT_EQ(0u, s.count("c"));
+  EXPECT_EQ("b", *s.find("b"));
+
+  std::set<std::string> iterated(s.begin(), s.end());
+  EXPECT_EQ(2u, iterated.size());
+  EXPECT_EQ(1u, iterated.count("a"));
+  EXPECT_EQ(1u, iterated.count("b"));
+
+  s.erase(s.find("a"));
+  EXPECT_EQ(0u, s.count("a"));
+  EXPECT_EQ(1u, s.erase("b"));
+  EXPECT_TRUE(s.empty());
+}
+
+TEST(FlatHashSetTest, InlineStorage) {
+  int values[] = { 1, 2, 3 };
+  FlatHashSet<int, internal::FlatHashDefaultHash<int>, std::equal_to<int>, 4>
+      s(values, values + arraysize(values));
+  EXPECT_EQ(3u, s.size());
+  EXPECT_FALSE(s.UsingHeapStorage());
+  s.insert(4);
+  EXPECT_TRUE(s.UsingHeapStorage());
+  for (int i = 1; i <= 4; ++i)
+    EXPECT_EQ(1u, s.count(i));
+}
+
+}  // namespace base
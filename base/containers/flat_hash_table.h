@@ -0,0 +1,577 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// The open-addressing hash table shared by FlatHashMap and FlatHashSet. Use
+// those instead of including this file directly.
+
+#ifndef BASE_CONTAINERS_FLAT_HASH_TABLE_H_
+#define BASE_CONTAINERS_FLAT_HASH_TABLE_H_
+
+#include <string.h>
+
+#include <algorithm>
+#include <iterator>
+#include <utility>
+
+#include "base/basictypes.h"
+#include "base/containers/hash_tables.h"
+#include "base/logging.h"
+#include "base/memory/manual_constructor.h"
+#include "build/build_config.h"
+
+namespace base {
+namespace internal {
+
+// The hash function used when none is given: the same one base::hash_map
+// uses, so any key that works there works here too.
+template <typename Key>
+struct FlatHashDefaultHash {
+  size_t operator()(const Key& key) const {
+#if defined(COMPILER_MSVC)
+    return BASE_HASH_NAMESPACE::hash_compare<Key>()(key);
+#else
+    return BASE_HASH_NAMESPACE::hash<Key>()(key);
+#endif
+  }
+};
+
+// Scrambles the bits of |hash|. Many hash functions (e.g. the identity hash
+// for integers) leave the high bits unused or produce regular patterns, which
+// would cluster badly in a power-of-two sized table. This is the finalizer of
+// MurmurHash3.
+inline size_t FlatHashMix(size_t hash) {
+#if defined(ARCH_CPU_64_BITS)
+  uint64 h = hash;
+  h ^= h >> 33;
+  h *= GG_UINT64_C(0xff51afd7ed558ccd);
+  h ^= h >> 33;
+  h *= GG_UINT64_C(0xc4ceb9fe1a85ec53);
+  h ^= h >> 33;
+  return static_cast<size_t>(h);
+#else
+  uint32 h = hash;
+  h ^= h >> 16;
+  h *= 0x85ebca6bU;
+  h ^= h >> 13;
+  h *= 0xc2b2ae35U;
+  h ^= h >> 16;
+  return h;
+#endif
+}
+
+// Storage for the slots a table holds inside the object itself before it
+// needs a heap allocation. The specialization below takes no space at all.
+template <typename Slot, size_t kInlineCapacity>
+struct FlatHashInlineStorage {
+  uint8* control() { return control_; }
+  Slot* slots() { return slots_; }
+
+  uint8 control_[kInlineCapacity];
+  Slot slots_[kInlineCapacity];
+};
+
+template <typename Slot>
+struct FlatHashInlineStorage<Slot, 0> {
+  uint8* control() { return NULL; }
+  Slot* slots() { return NULL; }
+};
+
+// A hash table with linear probing that stores its values in one array of
+// slots instead of in a node per value. Next to the slots is an array of
+// control bytes, one per slot, which says whether the slot is empty, has been
+// erased, or holds a value. For a full slot the control byte holds seven bits
+// of the value's hash, so a probe only compares keys when those bits match,
+// and most probes never touch the slots of other keys.
+//
+// Erasing leaves a tombstone behind so that no other value has to move. The
+// table is rehashed once values and tombstones together take up 3/4 of the
+// slots.
+//
+// |KeyOfValue| is a functor that returns the key of a stored value.
+// |kInlineCapacity| is either 0 or a power of two of at least 4; in the
+// latter case that many slots live inside the table object.
+template <typename Key,
+          typename Value,
+          typename KeyOfValue,
+          typename Hash,
+          typename KeyEqual,
+          size_t kInlineCapacity>
+class FlatHashTable {
+  COMPILE_ASSERT(kInlineCapacity == 0 ||
+                 (kInlineCapacity >= 4 &&
+                  (kInlineCapacity & (kInlineCapacity - 1)) == 0),
+                 inline_capacity_must_be_zero_or_a_power_of_two);
+
+  typedef ManualConstructor<Value> Slot;
+
+ public:
+  typedef Key key_type;
+  typedef Value value_type;
+  typedef size_t size_type;
+  typedef ptrdiff_t difference_type;
+  typedef Hash hasher;
+  typedef KeyEqual key_equal;
+
+  class const_iterator;
+
+  class iterator {
+   public:
+    typedef std::forward_iterator_tag iterator_category;
+    typedef Value value_type;
+    typedef ptrdiff_t difference_type;
+    typedef Value* pointer;
+    typedef Value& reference;
+
+    iterator() : control_(NULL), slot_(NULL), control_end_(NULL) {}
+
+    iterator& operator++() {
+      ++control_;
+      ++slot_;
+      SkipEmptySlots();
+      return *this;
+    }
+    iterator operator++(int /*unused*/) {
+      iterator result(*this);
+      ++(*this);
+      return result;
+    }
+
+    Value& operator*() const { return **slot_; }
+    Value* operator->() const { return slot_->get(); }
+
+    bool operator==(const iterator& other) const {
+      return control_ == other.control_;
+    }
+    bool operator!=(const iterator& other) const {
+      return control_ != other.control_;
+    }
+
+   private:
+    friend class FlatHashTable;
+    friend class const_iterator;
+
+    iterator(const uint8* control, Slot* slot, const uint8* control_end)
+        : control_(control), slot_(slot), control_end_(control_end) {
+      SkipEmptySlots();
+    }
+
+    void SkipEmptySlots() {
+      while (control_ != control_end_ && !IsFull(*control_)) {
+        ++control_;
+        ++slot_;
+      }
+    }
+
+    const uint8* control_;
+    Slot* slot_;
+    const uint8* control_end_;
+  };
+
+  class const_iterator {
+   public:
+    typedef std::forward_iterator_tag iterator_category;
+    typedef Value value_type;
+    typedef ptrdiff_t difference_type;
+    typedef const Value* pointer;
+    typedef const Value& reference;
+
+    const_iterator() : control_(NULL), slot_(NULL), control_end_(NULL) {}
+    const_iterator(const iterator& other)
+        : control_(other.control_),
+          slot_(other.slot_),
+          control_end_(other.control_end_) {}
+
+    const_iterator& operator++() {
+      ++control_;
+      ++slot_;
+      SkipEmptySlots();
+      return *this;
+    }
+    const_iterator operator++(int /*unused*/) {
+      const_iterator result(*this);
+      ++(*this);
+      return result;
+    }
+
+    const Value& operator*() const { return **slot_; }
+    const Value* operator->() const { return slot_->get(); }
+
+    bool operator==(const const_iterator& other) const {
+      return control_ == other.control_;
+    }
+    bool operator!=(const const_iterator& other) const {
+      return control_ != other.control_;
+    }
+
+   private:
+    friend class FlatHashTable;
+
+    const_iterator(const uint8* control,
+                   const Slot* slot,
+                   const uint8* control_end)
+        : control_(control), slot_(slot), control_end_(control_end) {
+      SkipEmptySlots();
+    }
+
+    void SkipEmptySlots() {
+      while (control_ != control_end_ && !IsFull(*control_)) {
+        ++control_;
+        ++slot_;
+      }
+    }
+
+    const uint8* control_;
+    const Slot* slot_;
+    const uint8* control_end_;
+  };
+
+  FlatHashTable() {
+    InitEmpty();
+  }
+
+  FlatHashTable(const FlatHashTable& other)
+      : hasher_(other.hasher_), key_equal_(other.key_equal_) {
+    InitEmpty();
+    CopyFrom(other);
+  }
+
+  FlatHashTable& operator=(const FlatHashTable& other) {
+    if (&other == this)
+      return *this;
+    DestroyValues();
+    FreeHeapSlots();
+    InitEmpty();
+    hasher_ = other.hasher_;
+    key_equal_ = other.key_equal_;
+    CopyFrom(other);
+    return *this;
+  }
+
+  ~FlatHashTable() {
+    DestroyValues();
+    FreeHeapSlots();
+  }
+
+  iterator begin() { return iterator(control_, slots_, control_ + capacity_); }
+  iterator end() {
+    return iterator(control_ + capacity_, slots_ + capacity_,
+                    control_ + capacity_);
+  }
+  const_iterator begin() const {
+    return const_iterator(control_, slots_, control_ + capacity_);
+  }
+  const_iterator end() const {
+    return const_iterator(control_ + capacity_, slots_ + capacity_,
+                          control_ + capacity_);
+  }
+
+  bool empty() const { return size_ == 0; }
+  size_t size() const { return size_; }
+
+  // The number of slots, i.e. the equivalent of hash_map's bucket_count().
+  size_t capacity() const { return capacity_; }
+
+  // Returns true if the values live in heap memory rather than inline.
+  bool UsingHeapStorage() const { return capacity_ > kInlineCapacity; }
+
+  hasher hash_function() const { return hasher_; }
+  key_equal key_eq() const { return key_equal_; }
+
+  iterator find(const Key& key) {
+    size_t index = FindIndex(key);
+    return index == kNotFound ? end() : IteratorAt(index);
+  }
+  const_iterator find(const Key& key) const {
+    size_t index = FindIndex(key);
+    return index == kNotFound ? end() : ConstIteratorAt(index);
+  }
+
+  size_t count(const Key& key) const {
+    return FindIndex(key) == kNotFound ? 0 : 1;
+  }
+
+  std::pair<iterator, bool> insert(const Value& value) {
+    return FindOrInsert(KeyOfValue()(value), ValueCopier(value));
+  }
+
+  // Returns an iterator to the value for |key| and false if there is one, or
+  // else inserts |make_value()|, which must have |key| as its key, and returns
+  // an iterator to it and true. Lets FlatHashMap::operator[] probe only once
+  // and build its default value only when it is needed.
+  template <typename ValueMaker>
+  std::pair<iterator, bool> FindOrInsert(const Key& key,
+                                         const ValueMaker& make_value) {
+    size_t hash = FlatHashMix(hasher_(key));
+    size_t index = FindIndex(key, hash);
+    if (index != kNotFound)
+      return std::make_pair(IteratorAt(index), false);
+
+    if (!capacity_)
+      Grow();
+    index = FindSlotForInsert(hash);
+    // Reusing a tombstone doesn't add to the load of the table; filling an
+    // empty slot may require making room first.
+    if (control_[index] == kEmpty && size_ + deleted_ + 1 > MaxLoad()) {
+      Grow();
+      index = FindSlotForInsert(hash);
+    }
+    slots_[index].Init(make_value());
+    if (control_[index] == kDeleted)
+      --deleted_;
+    control_[index] = HashTag(hash);
+    ++size_;
+    return std::make_pair(IteratorAt(index), true);
+  }
+
+  template <typename InputIterator>
+  void insert(InputIterator first, InputIterator last) {
+    for (; first != last; ++first)
+      insert(*first);
+  }
+
+  // Unlike in base::hash_map, erasing never moves other values, so iterators
+  // to them stay valid and |table.erase(it++)| is safe.
+  void erase(const_iterator position) {
+    DCHECK(position != end());
+    EraseAt(position.control_ - control_);
+  }
+  void erase(iterator position) {
+    erase(const_iterator(position));
+  }
+  size_t erase(const Key& key) {
+    size_t index = FindIndex(key);
+    if (index == kNotFound)
+      return 0;
+    EraseAt(index);
+    return 1;
+  }
+
+  // Destroys all values but keeps the slots allocated.
+  void clear() {
+    DestroyValues();
+    if (capacity_)
+      memset(control_, kEmpty, capacity_);
+    size_ = 0;
+    deleted_ = 0;
+  }
+
+  // Makes room for at least |count| values without further rehashing.
+  void reserve(size_t count) {
+    if (count <= MaxLoad())
+      return;
+    size_t capacity = capacity_ ? capacity_ : kMinHeapCapacity;
+    while (count > MaxLoadFor(capacity))
+      capacity *= 2;
+    if (capacity > capacity_)
+      Rehash(capacity);
+  }
+
+  void swap(FlatHashTable& other) {
+    if (!UsingHeapStorage() || !other.UsingHeapStorage()) {
+      // Inline values can't change owner by swapping pointers.
+      FlatHashTable temp(*this);
+      *this = other;
+      other = temp;
+      return;
+    }
+    std::swap(control_, other.control_);
+    std::swap(slots_, other.slots_);
+    std::swap(capacity_, other.capacity_);
+    std::swap(size_, other.size_);
+    std::swap(deleted_, other.deleted_);
+    std::swap(hasher_, other.hasher_);
+    std::swap(key_equal_, other.key_equal_);
+  }
+
+ private:
+  // The ValueMaker used by insert().
+  class ValueCopier {
+   public:
+    explicit ValueCopier(const Value& value) : value_(value) {}
+    const Value& operator()() const { return value_; }
+
+   private:
+    const Value& value_;
+  };
+
+  // Control byte values. A full slot holds a 7-bit hash tag instead.
+  static const uint8 kEmpty = 0x80;
+  static const uint8 kDeleted = 0xFE;
+
+  static const size_t kMinHeapCapacity =
+      kInlineCapacity ? kInlineCapacity * 2 : 8;
+  static const size_t kNotFound = static_cast<size_t>(-1);
+
+  static bool IsFull(uint8 control) { return !(control & 0x80); }
+  static uint8 HashTag(size_t hash) { return static_cast<uint8>(hash & 0x7F); }
+  static size_t MaxLoadFor(size_t capacity) {
+    return capacity - capacity / 4;
+  }
+
+  size_t MaxLoad() const { return MaxLoadFor(capacity_); }
+
+  // The first slot to probe for |hash|. The low bits are used for the tag.
+  size_t ProbeStart(size_t hash) const {
+    return (hash >> 7) & (capacity_ - 1);
+  }
+
+  void InitEmpty() {
+    control_ = storage_.control();
+    slots_ = storage_.slots();
+    capacity_ = kInlineCapacity;
+    size_ = 0;
+    deleted_ = 0;
+    if (capacity_)
+      memset(control_, kEmpty, capacity_);
+  }
+
+  // Copies the values of |other| into the same slot positions. The table must
+  // be empty.
+  void CopyFrom(const FlatHashTable& other) {
+    DCHECK(empty());
+    if (other.UsingHeapStorage())
+      AllocateHeapSlots(other.capacity_);
+    DCHECK_EQ(capacity_, other.capacity_);
+    for (size_t i = 0; i < capacity_; ++i) {
+      control_[i] = other.control_[i];
+      if (IsFull(control_[i]))
+        slots_[i].Init(*other.slots_[i]);
+    }
+    size_ = other.size_;
+    deleted_ = other.deleted_;
+  }
+
+  size_t FindIndex(const Key& key) const {
+    if (!size_)
+      return kNotFound;
+    return FindIndex(key, FlatHashMix(hasher_(key)));
+  }
+
+  size_t FindIndex(const Key& key, size_t hash) const {
+    if (!capacity_)
+      return kNotFound;
+    uint8 tag = HashTag(hash);
+    size_t mask = capacity_ - 1;
+    // The load limit guarantees an empty slot, so this terminates.
+    for (size_t i = ProbeStart(hash);; i = (i + 1) & mask) {
+      if (control_[i] == kEmpty)
+        return kNotFound;
+      if (control_[i] == tag && key_equal_(KeyOfValue()(*slots_[i]), key))
+        return i;
+    }
+  }
+
+  // Returns the first empty or deleted slot on the probe sequence of |hash|.
+  size_t FindSlotForInsert(size_t hash) const {
+    DCHECK(capacity_);
+    size_t mask = capacity_ - 1;
+    for (size_t i = ProbeStart(hash);; i = (i + 1) & mask) {
+      if (!IsFull(control_[i]))
+        return i;
+    }
+  }
+
+  void EraseAt(size_t index) {
+    DCHECK(IsFull(control_[index]));
+    slots_[index].Destroy();
+    --size_;
+    // If the next slot is empty no probe sequence continues past this one,
+    // so it can become empty instead of a tombstone.
+    if (control_[(index + 1) & (capacity_ - 1)] == kEmpty) {
+      control_[index] = kEmpty;
+    } else {
+      control_[index] = kDeleted;
+      ++deleted_;
+    }
+  }
+
+  // Makes room for one more value: doubles the capacity, or only sweeps out
+  // the tombstones if at most half of the slots hold values. In the latter
+  // case at least 1/4 of the slots are free afterwards, which keeps the cost
+  // of the sweeps amortized constant per insert.
+  void Grow() {
+    if (!capacity_)
+      Rehash(kMinHeapCapacity);
+    else if (!UsingHeapStorage() || size_ > capacity_ / 2)
+      Rehash(capacity_ * 2);
+    else
+      Rehash(capacity_);
+  }
+
+  void Rehash(size_t new_capacity) {
+    DCHECK_GT(new_capacity, kInlineCapacity);
+    uint8* old_control = control_;
+    Slot* old_slots = slots_;
+    size_t old_capacity = capacity_;
+    bool old_on_heap = UsingHeapStorage();
+
+    AllocateHeapSlots(new_capacity);
+    for (size_t i = 0; i < old_capacity; ++i) {
+      if (!IsFull(old_control[i]))
+        continue;
+      size_t hash = FlatHashMix(hasher_(KeyOfValue()(*old_slots[i])));
+      size_t index = FindSlotForInsert(hash);
+      control_[index] = old_control[i];
+      slots_[index].Init(*old_slots[i]);
+      old_slots[i].Destroy();
+    }
+    deleted_ = 0;
+
+    if (old_on_heap)
+      ::operator delete(old_slots);
+  }
+
+  // Points the table at new, empty heap slots. Does not free the old ones.
+  // The slots and the control bytes share one allocation, slots first so that
+  // they get the alignment of operator new.
+  void AllocateHeapSlots(size_t capacity) {
+    char* block =
+        static_cast<char*>(::operator new(capacity * (sizeof(Slot) + 1)));
+    slots_ = reinterpret_cast<Slot*>(block);
+    control_ = reinterpret_cast<uint8*>(block + capacity * sizeof(Slot));
+    memset(control_, kEmpty, capacity);
+    capacity_ = capacity;
+  }
+
+  void FreeHeapSlots() {
+    if (UsingHeapStorage())
+      ::operator delete(slots_);
+  }
+
+  void DestroyValues() {
+    if (!size_)
+      return;
+    for (size_t i = 0; i < capacity_; ++i) {
+      if (IsFull(control_[i]))
+        slots_[i].Destroy();
+    }
+  }
+
+  iterator IteratorAt(size_t index) {
+    return iterator(control_ + index, slots_ + index, control_ + capacity_);
+  }
+  const_iterator ConstIteratorAt(size_t index) const {
+    return const_iterator(control_ + index, slots_ + index,
+                          control_ + capacity_);
+  }
+
+  // Either points into |storage_| or to heap arrays of |capacity_| entries.
+  uint8* control_;
+  Slot* slots_;
+  size_t capacity_;
+
+  // The number of values and of tombstones.
+  size_t size_;
+  size_t deleted_;
+
+  Hash hasher_;
+  KeyEqual key_equal_;
+
+  FlatHashInlineStorage<Slot, kInlineCapacity> storage_;
+};
+
+}  // namespace internal
+}  // namespace base
+
+#endif  // BASE_CONTAINERS_FLAT_HASH_TABLE_H_
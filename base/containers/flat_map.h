@@ -0,0 +1,99 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef BASE_CONTAINERS_FLAT_MAP_H_
+#define BASE_CONTAINERS_FLAT_MAP_H_
+
+#include <functional>
+#include <utility>
+
+#include "base/containers/flat_tree.h"
+
+namespace base {
+
+namespace internal {
+
+template <typename Key, typename Mapped>
+struct GetKeyFromPair {
+  const Key& operator()(const std::pair<Key, Mapped>& value) const {
+    return value.first;
+  }
+};
+
+}  // namespace internal
+
+// A std::map replacement that keeps its entries in one sorted std::vector
+// instead of in a red-black tree with a node per entry.
+//
+// WHEN TO USE IT
+// --------------
+//
+// Lookups are binary searches over contiguous memory, iteration is a linear
+// walk, and there is a single allocation, so FlatMap is smaller and faster
+// than std::map for maps that are built once (or rarely changed) and then
+// read. Inserting or erasing a single entry moves all entries after it, which
+// is O(n); for maps that are modified as often as they are read and grow past
+// a few dozen entries, stick to std::map or base::hash_map.
+//
+// To build a map from many entries, collect them first and construct the
+// FlatMap from the range, or use the range insert(), which sort only once.
+//
+// DIFFERENCES FROM std::map
+// -------------------------
+//
+//  - value_type is std::pair<Key, Mapped> rather than
+//    std::pair<const Key, Mapped>, since the vector has to be able to move
+//    entries. Don't change keys through iterators.
+//  - Any insert or erase invalidates all iterators and references.
+//  - erase() returns the iterator following the erased entries, like
+//    std::vector.
+//  - reserve(), capacity() and shrink_to_fit() manage the vector's memory.
+//
+// Example:
+//   std::vector<std::pair<std::string, int> > entries;
+//   ...
+//   base::FlatMap<std::string, int> map(entries.begin(), entries.end());
+//   base::FlatMap<std::string, int>::const_iterator it = map.find("key");
+template <typename Key, typename Mapped, typename Compare = std::less<Key> >
+class FlatMap
+    : public internal::FlatTree<Key,
+                                std::pair<Key, Mapped>,
+                                internal::GetKeyFromPair<Key, Mapped>,
+                                Compare> {
+ private:
+  typedef internal::FlatTree<Key,
+                             std::pair<Key, Mapped>,
+                             internal::GetKeyFromPair<Key, Mapped>,
+                             Compare> Tree;
+
+ public:
+  typedef Mapped mapped_type;
+  typedef typename Tree::value_type value_type;
+  typedef typename Tree::iterator iterator;
+
+  explicit FlatMap(const Compare& compare = Compare()) : Tree(compare) {}
+
+  // Sorts [first, last) once. Of several entries with the same key, only the
+  // first is kept.
+  template <typename InputIterator>
+  FlatMap(InputIterator first,
+          InputIterator last,
+          const Compare& compare = Compare())
+      : Tree(first, last, compare) {}
+
+  // Allow copy-constructor and assignment, since STL allows them too.
+
+  Mapped& operator[](const Key& key) {
+    iterator it = this->lower_bound(key);
+    if (it == this->end() || this->key_comp()(key, it->first))
+      it = this->insert(it, value_type(key, Mapped()));
+    return it->second;
+  }
+
+  void swap(FlatMap& other) { Tree::swap(other); }
+};
+
+}  // namespace base
+
+#endif  // BASE_CONTAINERS_FLAT_MAP_H_
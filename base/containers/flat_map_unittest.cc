@@ -0,0 +1,177 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/containers/flat_map.h"
+
+#include <algorithm>
+#include <functional>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace base {
+
+namespace {
+
+typedef FlatMap<int, std::string> IntStringMap;
+
+std::pair<int, std::string> Entry(int key, const std::string& value) {
+  return std::make_pair(key, value);
+}
+
+}  // namespace
+
+TEST(FlatMapTest, General) {
+  IntStringMap m;
+  EXPECT_TRUE(m.empty());
+  EXPECT_TRUE(m.begin() == m.end());
+  EXPECT_TRUE(m.find(1) == m.end());
+
+  m[3] = "three";
+  m[1] = "one";
+  EXPECT_EQ(2u, m.size());
+  EXPECT_EQ("one", m[1]);
+  EXPECT_EQ("three", m.find(3)->second);
+  EXPECT_EQ(1u, m.count(3));
+  EXPECT_EQ(0u, m.count(2));
+
+  std::pair<IntStringMap::iterator, bool> result = m.insert(Entry(2, "two"));
+  EXPECT_TRUE(result.second);
+  EXPECT_EQ(2, result.first->first);
+  result = m.insert(Entry(2, "deux"));
+  EXPECT_FALSE(result.second);
+  EXPECT_EQ("two", result.first->second);
+
+  // Iteration is in key order.
+  IntStringMap::const_iterator it = m.begin();
+  EXPECT_EQ(1, (it++)->first);
+  EXPECT_EQ(2, (it++)->first);
+  EXPECT_EQ(3, (it++)->first);
+  EXPECT_TRUE(it == m.end());
+  EXPECT_EQ(3, m.rbegin()->first);
+
+  EXPECT_EQ(1u, m.erase(2));
+  EXPECT_EQ(0u, m.erase(2));
+  IntStringMap::iterator next = m.erase(m.begin());
+  EXPECT_EQ(3, next->first);
+  EXPECT_EQ(1u, m.size());
+
+  m.clear();
+  EXPECT_TRUE(m.empty());
+}
+
+TEST(FlatMapTest, RangeConstructorSortsAndKeepsFirst) {
+  std::vector<std::pair<int, std::string> > entries;
+  entries.push_back(Entry(5, "five"));
+  entries.push_back(Entry(1, "one"));
+  entries.push_back(Entry(5, "cinq"));
+  entries.push_back(Entry(3, "three"));
+  entries.push_back(Entry(1, "un"));
+
+  IntStringMap m(entries.begin(), entries.end());
+  ASSERT_EQ(3u, m.size());
+  IntStringMap::const_iterator it = m.begin();
+  EXPECT_EQ(Entry(1, "one"), *it++);
+  EXPECT_EQ(Entry(3, "three"), *it++);
+  EXPECT_EQ(Entry(5, "five"), *it++);
+}
+
+TEST(FlatMapTest, RangeInsertKeepsExisting) {
+  IntStringMap m;
+  m[2] = "two";
+  m[4] = "four";
+
+  std::vector<std::pair<int, std::string> > entries;
+  entries.push_back(Entry(4, "vier"));
+  entries.push_back(Entry(3, "three"));
+  entries.push_back(Entry(1, "one"));
+  entries.push_back(Entry(3, "drei"));
+  m.insert(entries.begin(), entries.end());
+
+  std::map<int, std::string> expected;
+  expected[2] = "two";
+  expected[4] = "four";
+  expected.insert(entries.begin(), entries.end());
+  std::vector<std::pair<int, std::string> > expected_entries(expected.begin(),
+                                                            expected.end());
+  ASSERT_EQ(expected_entries.size(), m.size());
+  EXPECT_TRUE(std::equal(m.begin(), m.end(), expected_entries.begin()));
+}
+
+TEST(FlatMapTest, Bounds) {
+  IntStringMap m;
+  for (int i = 0; i < 10; i += 2)
+    m[i] = "even";
+
+  EXPECT_EQ(4, m.lower_bound(3)->first);
+  EXPECT_EQ(4, m.lower_bound(4)->first);
+  EXPECT_EQ(6, m.upper_bound(4)->first);
+  EXPECT_TRUE(m.lower_bound(9) == m.end());
+
+  std::pair<IntStringMap::iterator, IntStringMap::iterator> range =
+      m.equal_range(4);
+  EXPECT_EQ(4, range.first->first);
+  EXPECT_EQ(6, range.second->first);
+  range = m.equal_range(5);
+  EXPECT_TRUE(range.first == range.second);
+  EXPECT_EQ(6, range.first->first);
+
+  IntStringMap::iterator first = m.lower_bound(2);
+  IntStringMap::iterator last = m.lower_bound(7);
+  IntStringMap::iterator next = m.erase(first, last);
+  EXPECT_EQ(8, next->first);
+  EXPECT_EQ(2u, m.size());
+}
+
+TEST(FlatMapTest, HintedInsert) {
+  IntStringMap m;
+  // Appending in order at end() takes the fast path.
+  for (int i = 0; i < 100; ++i)
+    m.insert(m.end(), Entry(i, "value"));
+  EXPECT_EQ(100u, m.size());
+
+  // A wrong hint still inserts in the right place.
+  IntStringMap::iterator it = m.insert(m.begin(), Entry(1000, "last"));
+  EXPECT_EQ(1000, it->first);
+  EXPECT_EQ(1000, m.rbegin()->first);
+  // An existing key is not replaced.
+  it = m.insert(m.end(), Entry(50, "other"));
+  EXPECT_EQ("value", it->second);
+  EXPECT_EQ(101u, m.size());
+}
+
+TEST(FlatMapTest, CustomCompare) {
+  FlatMap<int, int, std::greater<int> > m;
+  m[1] = 1;
+  m[3] = 3;
+  m[2] = 2;
+  EXPECT_EQ(3, m.begin()->first);
+  EXPECT_EQ(1, m.rbegin()->first);
+  EXPECT_EQ(2, m.find(2)->second);
+}
+
+TEST(FlatMapTest, CopySwapAndCompare) {
+  IntStringMap m;
+  m[1] = "one";
+  m.reserve(100);
+  EXPECT_GE(m.capacity(), 100u);
+  m.shrink_to_fit();
+  EXPECT_LT(m.capacity(), 100u);
+
+  IntStringMap copy(m);
+  EXPECT_TRUE(copy == m);
+  copy[2] = "two";
+  EXPECT_FALSE(copy == m);
+  EXPECT_TRUE(m < copy);
+
+  IntStringMap other;
+  other.swap(copy);
+  EXPECT_TRUE(copy.empty());
+  EXPECT_EQ(2u, other.size());
+}
+
+}  // namespace base
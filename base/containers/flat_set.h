@@ -0,0 +1,63 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef BASE_CONTAINERS_FLAT_SET_H_
+#define BASE_CONTAINERS_FLAT_SET_H_
+
+#include <functional>
+
+#include "base/containers/flat_tree.h"
+
+namespace base {
+
+namespace internal {
+
+template <typename Key>
+struct GetKeyFromValueIdentity {
+  const Key& operator()(const Key& value) const { return value; }
+};
+
+}  // namespace internal
+
+// A std::set replacement that keeps its elements in one sorted std::vector.
+// See flat_map.h for when to use it and how it differs from the std
+// container; the same applies here. In particular, elements must not be
+// modified through iterators.
+//
+// Example:
+//   const char* const kSchemes[] = { "https", "http", "ftp" };
+//   base::FlatSet<std::string> schemes(kSchemes,
+//                                      kSchemes + arraysize(kSchemes));
+//   if (schemes.count(scheme))
+//     ...
+template <typename Key, typename Compare = std::less<Key> >
+class FlatSet
+    : public internal::FlatTree<Key,
+                                Key,
+                                internal::GetKeyFromValueIdentity<Key>,
+                                Compare> {
+ private:
+  typedef internal::FlatTree<Key,
+                             Key,
+                             internal::GetKeyFromValueIdentity<Key>,
+                             Compare> Tree;
+
+ public:
+  explicit FlatSet(const Compare& compare = Compare()) : Tree(compare) {}
+
+  // Sorts [first, last) once, dropping duplicates.
+  template <typename InputIterator>
+  FlatSet(InputIterator first,
+          InputIterator last,
+          const Compare& compare = Compare())
+      : Tree(first, last, compare) {}
+
+  // Allow copy-constructor and assignment, since STL allows them too.
+
+  void swap(FlatSet& other) { Tree::swap(other); }
+};
+
+}  // namespace base
+
+#endif  // BASE_CONTAINERS_FLAT_SET_H_
@@ -0,0 +1,48 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/containers/flat_set.h"
+
+#include <string>
+
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace base {
+
+TEST(FlatSetTest, General) {
+  const char* const kValues[] = { "b", "d", "a", "b", "c" };
+  FlatSet<std::string> s(kValues, kValues + arraysize(kValues));
+  ASSERT_EQ(4u, s.size());
+  FlatSet<std::string>::const_iterator it = s.begin();
+  EXPECT_EQ("a", *it++);
+  EXPECT_EQ("b", *it++);
+  EXPECT_EQ("c", *it++);
+  EXPECT_EQ("d", *it++);
+  EXPECT_TRUE(it == s.end());
+
+  EXPECT_EQ(1u, s.count("c"));
+  EXPECT_EQ(0u, s.count("e"));
+  EXPECT_TRUE(s.insert("e").second);
+  EXPECT_FALSE(s.insert("e").second);
+  EXPECT_EQ("e", *s.rbegin());
+  EXPECT_EQ("c", *s.lower_bound("bb"));
+
+  EXPECT_EQ(1u, s.erase("a"));
+  EXPECT_EQ("b", *s.begin());
+}
+
+TEST(FlatSetTest, RangeInsert) {
+  FlatSet<int> s;
+  s.insert(5);
+  int values[] = { 9, 1, 5, 3, 1 };
+  s.insert(values, values + arraysize(values));
+  ASSERT_EQ(4u, s.size());
+  FlatSet<int>::const_iterator it = s.begin();
+  EXPECT_EQ(1, *it++);
+  EXPECT_EQ(3, *it++);
+  EXPECT_EQ(5, *it++);
+  EXPECT_EQ(9, *it++);
+}
+
+}  // namespace base
@@ -0,0 +1,246 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// The sorted vector shared by FlatMap and FlatSet. Use those instead of
+// including this file directly.
+
+#ifndef BASE_CONTAINERS_FLAT_TREE_H_
+#define BASE_CONTAINERS_FLAT_TREE_H_
+
+#include <algorithm>
+#include <functional>
+#include <utility>
+#include <vector>
+
+#include "base/basictypes.h"
+
+namespace base {
+namespace internal {
+
+// Keeps |Value|s sorted by the key |GetKey| returns for them, without
+// duplicate keys, in a std::vector. This gives the std::map and std::set
+// interfaces with binary search for lookups, O(n) single inserts and erases,
+// and contiguous storage.
+template <typename Key, typename Value, typename GetKey, typename KeyCompare>
+class FlatTree {
+ private:
+  typedef std::vector<Value> Storage;
+
+ public:
+  typedef Key key_type;
+  typedef KeyCompare key_compare;
+  typedef Value value_type;
+  typedef typename Storage::size_type size_type;
+  typedef typename Storage::difference_type difference_type;
+  typedef typename Storage::reference reference;
+  typedef typename Storage::const_reference const_reference;
+  typedef typename Storage::pointer pointer;
+  typedef typename Storage::const_pointer const_pointer;
+  typedef typename Storage::iterator iterator;
+  typedef typename Storage::const_iterator const_iterator;
+  typedef typename Storage::reverse_iterator reverse_iterator;
+  typedef typename Storage::const_reverse_iterator const_reverse_iterator;
+
+  // Orders values by their keys.
+  class value_compare {
+   public:
+    explicit value_compare(const KeyCompare& compare) : compare_(compare) {}
+    bool operator()(const Value& left, const Value& right) const {
+      GetKey get_key;
+      return compare_(get_key(left), get_key(right));
+    }
+
+   private:
+    KeyCompare compare_;
+  };
+
+  explicit FlatTree(const KeyCompare& compare) : compare_(compare) {}
+
+  template <typename InputIterator>
+  FlatTree(InputIterator first, InputIterator last, const KeyCompare& compare)
+      : values_(first, last), compare_(compare) {
+    SortAndUnique(values_.begin());
+  }
+
+  iterator begin() { return values_.begin(); }
+  iterator end() { return values_.end(); }
+  const_iterator begin() const { return values_.begin(); }
+  const_iterator end() const { return values_.end(); }
+  reverse_iterator rbegin() { return values_.rbegin(); }
+  reverse_iterator rend() { return values_.rend(); }
+  const_reverse_iterator rbegin() const { return values_.rbegin(); }
+  const_reverse_iterator rend() const { return values_.rend(); }
+
+  bool empty() const { return values_.empty(); }
+  size_type size() const { return values_.size(); }
+  size_type max_size() const { return values_.max_size(); }
+  size_type capacity() const { return values_.capacity(); }
+  void reserve(size_type count) { values_.reserve(count); }
+  void clear() { values_.clear(); }
+
+  // Frees the memory reserve() or erased values left unused.
+  void shrink_to_fit() {
+    if (values_.capacity() > values_.size())
+      Storage(values_).swap(values_);
+  }
+
+  key_compare key_comp() const { return compare_; }
+  value_compare value_comp() const { return value_compare(compare_); }
+
+  iterator lower_bound(const Key& key) {
+    return std::lower_bound(values_.begin(), values_.end(), key,
+                            KeyValueCompare(compare_));
+  }
+  const_iterator lower_bound(const Key& key) const {
+    return std::lower_bound(values_.begin(), values_.end(), key,
+                            KeyValueCompare(compare_));
+  }
+  iterator upper_bound(const Key& key) {
+    return std::upper_bound(values_.begin(), values_.end(), key,
+                            KeyValueCompare(compare_));
+  }
+  const_iterator upper_bound(const Key& key) const {
+    return std::upper_bound(values_.begin(), values_.end(), key,
+                            KeyValueCompare(compare_));
+  }
+  std::pair<iterator, iterator> equal_range(const Key& key) {
+    iterator lower = lower_bound(key);
+    iterator upper = lower;
+    if (upper != end() && !compare_(key, GetKey()(*upper)))
+      ++upper;
+    return std::make_pair(lower, upper);
+  }
+  std::pair<const_iterator, const_iterator> equal_range(const Key& key) const {
+    const_iterator lower = lower_bound(key);
+    const_iterator upper = lower;
+    if (upper != end() && !compare_(key, GetKey()(*upper)))
+      ++upper;
+    return std::make_pair(lower, upper);
+  }
+
+  iterator find(const Key& key) {
+    iterator it = lower_bound(key);
+    return it != end() && !compare_(key, GetKey()(*it)) ? it : end();
+  }
+  const_iterator find(const Key& key) const {
+    const_iterator it = lower_bound(key);
+    return it != end() && !compare_(key, GetKey()(*it)) ? it : end();
+  }
+  size_type count(const Key& key) const {
+    return find(key) != end() ? 1 : 0;
+  }
+
+  std::pair<iterator, bool> insert(const Value& value) {
+    iterator it = lower_bound(GetKey()(value));
+    if (it != end() && !compare_(GetKey()(value), GetKey()(*it)))
+      return std::make_pair(it, false);
+    return std::make_pair(values_.insert(it, value), true);
+  }
+
+  // Inserts |value| if its key is missing. Starts by checking whether it
+  // belongs right before |hint|, which makes appending sorted values O(1)
+  // apart from the vector's own growth.
+  iterator insert(const_iterator hint, const Value& value) {
+    const Key& key = GetKey()(value);
+    iterator position = begin() + (hint - begin());
+    if ((position == end() || compare_(key, GetKey()(*position))) &&
+        (position == begin() || compare_(GetKey()(*(position - 1)), key))) {
+      return values_.insert(position, value);
+    }
+    return insert(value).first;
+  }
+
+  // Inserts every value in [first, last) whose key is missing. Like std::map,
+  // keeps the values already present, and the first of several new values
+  // with equal keys. Appends, sorts and merges in one pass, so this is
+  // O(n log n) in the number of new values plus O(n) in size().
+  template <typename InputIterator>
+  void insert(InputIterator first, InputIterator last) {
+    size_type old_size = size();
+    values_.insert(values_.end(), first, last);
+    SortAndUnique(values_.begin() + old_size);
+  }
+
+  iterator erase(const_iterator position) {
+    return values_.erase(begin() + (position - begin()));
+  }
+  iterator erase(const_iterator first, const_iterator last) {
+    return values_.erase(begin() + (first - begin()),
+                         begin() + (last - begin()));
+  }
+  size_type erase(const Key& key) {
+    iterator it = find(key);
+    if (it == end())
+      return 0;
+    values_.erase(it);
+    return 1;
+  }
+
+  void swap(FlatTree& other) {
+    values_.swap(other.values_);
+    std::swap(compare_, other.compare_);
+  }
+
+  bool operator==(const FlatTree& other) const {
+    return values_ == other.values_;
+  }
+  bool operator<(const FlatTree& other) const {
+    return values_ < other.values_;
+  }
+
+ private:
+  // Compares keys and values in any combination by their keys, for the
+  // binary searches.
+  class KeyValueCompare {
+   public:
+    explicit KeyValueCompare(const KeyCompare& compare) : compare_(compare) {}
+    template <typename Left, typename Right>
+    bool operator()(const Left& left, const Right& right) const {
+      return compare_(KeyOf(left), KeyOf(right));
+    }
+
+   private:
+    // For a set, Key and Value are the same type and the non-template
+    // overload wins, which is fine since GetKey is the identity there.
+    static const Key& KeyOf(const Value& value) { return GetKey()(value); }
+    template <typename K>
+    static const K& KeyOf(const K& key) { return key; }
+
+    const KeyCompare& compare_;
+  };
+
+  // Compares values by key for equality, for std::unique().
+  class ValueEquals {
+   public:
+    explicit ValueEquals(const KeyCompare& compare) : compare_(compare) {}
+    bool operator()(const Value& left, const Value& right) const {
+      return !compare_(GetKey()(left), GetKey()(right)) &&
+             !compare_(GetKey()(right), GetKey()(left));
+    }
+
+   private:
+    const KeyCompare& compare_;
+  };
+
+  // Sorts the unsorted values from |unsorted| on into the sorted ones before
+  // it and drops the values with duplicate keys, keeping the earliest of each.
+  void SortAndUnique(iterator unsorted) {
+    value_compare value_comp(compare_);
+    // Stable sorting and merging keep equal values in their original order,
+    // so the one std::unique() keeps is the earliest.
+    std::stable_sort(unsorted, values_.end(), value_comp);
+    std::inplace_merge(values_.begin(), unsorted, values_.end(), value_comp);
+    values_.erase(
+        std::unique(values_.begin(), values_.end(), ValueEquals(compare_)),
+        values_.end());
+  }
+
+  Storage values_;
+  KeyCompare compare_;
+};
+
+}  // namespace internal
+}  // namespace base
+
+#endif  // BASE_CONTAINERS_FLAT_TREE_H_
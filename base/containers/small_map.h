@@ -36,6 +36,12 @@ namespace base {
 //    something else) and will probably be faster and do fewer heap allocations
 //    than std::map if you have just a couple of items.
 //
+//  - base::FlatMap (base/containers/flat_map.h) keeps a sorted vector behind
+//    the std::map interface. Use it for maps that are built once or rarely
+//    modified and then mostly read: lookups are binary searches, iteration is
+//    a linear walk and there is a single heap allocation, but inserting or
+//    erasing a single entry is O(n).
+//
 //  - base::hash_map should be used if you need O(1) lookups. It may waste
 //    space in the hash table, and it can be easy to write correct-looking
 //    code with the default hash function being wrong or poorly-behaving.
@@ -0,0 +1,393 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/debug/sampling_heap_profiler.h"
+
+#include <math.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include "base/allocator/allocator_extension.h"
+#include "base/atomicops.h"
+#include "base/compiler_specific.h"
+#include "base/debug/leak_annotations.h"
+#include "base/debug/stack_trace.h"
+#include "base/logging.h"
+#include "base/memory/singleton.h"
+#include "base/time/time.h"
+
+#if defined(COMPILER_MSVC)
+#define SAMPLING_HEAP_PROFILER_THREAD_LOCAL __declspec(thread)
+#else
+// initial-exec, so that the first access from a thread doesn't allocate.
+#define SAMPLING_HEAP_PROFILER_THREAD_LOCAL \
+    __thread __attribute__((tls_model("initial-exec")))
+#endif
+
+namespace base {
+namespace debug {
+
+namespace {
+
+// StackTrace() and SampleAllocation(), which start every stack.
+const int kSkippedFrames = 2;
+const int kMaxFrames = 32;
+
+// Must be a power of 2.
+const size_t kMaxStacks = 4096;
+const int kLiveSampleCapacityBits = 15;
+const size_t kLiveSampleCapacity = 1 << kLiveSampleCapacityBits;
+
+// How far a live sample can be from its hash slot. Bounds the cost of the
+// frees which weren't sampled, which are nearly all of them.
+const size_t kMaxLiveSampleProbes = 16;
+
+// The states of a stack table entry.
+const subtle::Atomic32 kStackEmpty = 0;
+const subtle::Atomic32 kStackWriting = 1;
+const subtle::Atomic32 kStackReady = 2;
+
+// The values of a live sample address slot which aren't addresses.
+const subtle::AtomicWord kSlotEmpty = 0;
+const subtle::AtomicWord kSlotDeleted = 1;
+const subtle::AtomicWord kSlotWriting = 2;
+
+struct StackEntry {
+  subtle::Atomic32 state;
+  uint32 hash;
+  int frame_count;
+  const void* frames[kMaxFrames];
+  subtle::AtomicWord live_count;
+  subtle::AtomicWord live_bytes;
+  subtle::AtomicWord total_count;
+  subtle::AtomicWord total_bytes;
+};
+
+struct Tables {
+  StackEntry stacks[kMaxStacks];
+
+  // An open-addressed table of the sampled allocations not freed yet. The
+  // other fields of a slot are written before its address is published, and
+  // read before it is deleted.
+  subtle::AtomicWord live_addresses[kLiveSampleCapacity];
+  int32 live_stacks[kLiveSampleCapacity];
+  size_t live_counts[kLiveSampleCapacity];
+  size_t live_bytes[kLiveSampleCapacity];
+
+  subtle::Atomic32 dropped_count;
+};
+
+// Allocated the first time the profiler starts, and never freed, as a hook
+// may still be running after it stops.
+Tables* g_tables = NULL;
+
+subtle::Atomic32 g_running = 0;
+subtle::AtomicWord g_sampling_interval = 0;
+
+// The number of live samples. RecordFree() returns early when there are none.
+subtle::Atomic32 g_live_sample_count = 0;
+
+struct ThreadState {
+  // Bytes to allocate until the next sample. Zero until the first
+  // allocation of the thread.
+  intptr_t bytes_until_sample;
+  uint32 random_state;
+  bool in_sample;
+};
+
+SAMPLING_HEAP_PROFILER_THREAD_LOCAL ThreadState g_thread_state;
+
+// xorshift32, which doesn't lock or allocate like RandUint64() may.
+uint32 NextRandom(ThreadState* state) {
+  uint32 x = state->random_state;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  state->random_state = x;
+  return x;
+}
+
+// Draws the bytes to the next sample from an exponential distribution with a
+// mean of |interval|.
+intptr_t NextSampleInterval(ThreadState* state, size_t interval) {
+  // In (0, 1].
+  double uniform =
+      ((NextRandom(state) >> 8) + 1) / static_cast<double>(1 << 24);
+  double bytes = -log(uniform) * interval;
+  // At most about 17 times |interval|, with 24 random bits.
+  return std::max(static_cast<intptr_t>(bytes), static_cast<intptr_t>(1));
+}
+
+uint32 HashFrames(const void* const* frames, int count) {
+  uint32 hash = 2166136261u;
+  for (int i = 0; i < count; ++i) {
+    uintptr_t frame = reinterpret_cast<uintptr_t>(frames[i]);
+    hash = (hash ^ static_cast<uint32>(frame ^ (frame >> 16 >> 16))) *
+           16777619u;
+  }
+  return hash;
+}
+
+size_t HashAddress(const void* address) {
+  uintptr_t value = reinterpret_cast<uintptr_t>(address);
+  // Blocks are at least 8-byte aligned, and nearby ones are often freed
+  // together, so take the top bits of a multiplicative hash.
+  value = (value >> 3) * static_cast<uintptr_t>(0x9E3779B97F4A7C15ULL);
+  return static_cast<size_t>(value >>
+                             (sizeof(value) * 8 - kLiveSampleCapacityBits));
+}
+
+// Returns the index of the entry for the stack, adding it if needed, or -1 if
+// the table is full.
+int FindOrAddStack(const void* const* frames, int count) {
+  uint32 hash = HashFrames(frames, count);
+  size_t index = hash & (kMaxStacks - 1);
+  for (size_t probe = 0; probe < kMaxStacks;
+       ++probe, index = (index + 1) & (kMaxStacks - 1)) {
+    StackEntry* entry = &g_tables->stacks[index];
+    subtle::Atomic32 state = subtle::Acquire_Load(&entry->state);
+    if (state == kStackEmpty) {
+      state = subtle::Acquire_CompareAndSwap(&entry->state, kStackEmpty,
+                                             kStackWriting);
+      if (state == kStackEmpty) {
+        entry->hash = hash;
+        entry->frame_count = count;
+        memcpy(entry->frames, frames, count * sizeof(frames[0]));
+        subtle::Release_Store(&entry->state, kStackReady);
+        return static_cast<int>(index);
+      }
+    }
+    // Another thread is adding a stack here, which may be this one. Copying
+    // the frames takes no time.
+    while (state == kStackWriting)
+      state = subtle::Acquire_Load(&entry->state);
+    if (entry->hash == hash && entry->frame_count == count &&
+        !memcmp(entry->frames, frames, count * sizeof(frames[0]))) {
+      return static_cast<int>(index);
+    }
+  }
+  return -1;
+}
+
+bool AddLiveSample(const void* address,
+                   int stack,
+                   size_t count,
+                   size_t bytes) {
+  size_t index = HashAddress(address);
+  for (size_t probe = 0; probe < kMaxLiveSampleProbes;
+       ++probe, index = (index + 1) & (kLiveSampleCapacity - 1)) {
+    subtle::AtomicWord* slot = &g_tables->live_addresses[index];
+    subtle::AtomicWord value = subtle::NoBarrier_Load(slot);
+    if (value != kSlotEmpty && value != kSlotDeleted)
+      continue;
+    if (subtle::Acquire_CompareAndSwap(slot, value, kSlotWriting) != value)
+      continue;
+    g_tables->live_stacks[index] = stack;
+    g_tables->live_counts[index] = count;
+    g_tables->live_bytes[index] = bytes;
+    subtle::Release_Store(slot, reinterpret_cast<subtle::AtomicWord>(address));
+    subtle::NoBarrier_AtomicIncrement(&g_live_sample_count, 1);
+    return true;
+  }
+  return false;
+}
+
+void RemoveLiveSample(const void* address) {
+  const subtle::AtomicWord key = reinterpret_cast<subtle::AtomicWord>(address);
+  size_t index = HashAddress(address);
+  for (size_t probe = 0; probe < kMaxLiveSampleProbes;
+       ++probe, index = (index + 1) & (kLiveSampleCapacity - 1)) {
+    subtle::AtomicWord* slot = &g_tables->live_addresses[index];
+    subtle::AtomicWord value = subtle::Acquire_Load(slot);
+    if (value == kSlotEmpty)
+      return;
+    if (value != key)
+      continue;
+    // The slot can only be reused once deleted, so these are the fields of
+    // |address| if the deletion succeeds.
+    int stack = g_tables->live_stacks[index];
+    size_t count = g_tables->live_counts[index];
+    size_t bytes = g_tables->live_bytes[index];
+    if (subtle::NoBarrier_CompareAndSwap(slot, key, kSlotDeleted) != key)
+      return;
+    subtle::NoBarrier_AtomicIncrement(&g_live_sample_count, -1);
+    StackEntry* entry = &g_tables->stacks[stack];
+    subtle::NoBarrier_AtomicIncrement(&entry->live_count,
+                                      -static_cast<subtle::AtomicWord>(count));
+    subtle::NoBarrier_AtomicIncrement(&entry->live_bytes,
+                                      -static_cast<subtle::AtomicWord>(bytes));
+    return;
+  }
+}
+
+NOINLINE void SampleAllocation(const void* address,
+                               size_t size,
+                               size_t interval) {
+  // Each sample stands for the allocations of its size expected between two
+  // samples.
+  double weight = 1.0 / (1.0 - exp(-static_cast<double>(size) / interval));
+  size_t count = static_cast<size_t>(weight + 0.5);
+  size_t bytes = static_cast<size_t>(size * weight + 0.5);
+
+  StackTrace stack_trace;
+  size_t frame_count = 0;
+  const void* const* frames = stack_trace.Addresses(&frame_count);
+  int skipped = std::min(static_cast<int>(frame_count), kSkippedFrames);
+  int stack = FindOrAddStack(
+      frames + skipped,
+      std::min(static_cast<int>(frame_count) - skipped, kMaxFrames));
+  if (stack < 0) {
+    subtle::NoBarrier_AtomicIncrement(&g_tables->dropped_count, 1);
+    return;
+  }
+
+  StackEntry* entry = &g_tables->stacks[stack];
+  subtle::NoBarrier_AtomicIncrement(&entry->total_count, count);
+  subtle::NoBarrier_AtomicIncrement(&entry->total_bytes, bytes);
+  if (!AddLiveSample(address, stack, count, bytes)) {
+    subtle::NoBarrier_AtomicIncrement(&g_tables->dropped_count, 1);
+    return;
+  }
+  subtle::NoBarrier_AtomicIncrement(&entry->live_count, count);
+  subtle::NoBarrier_AtomicIncrement(&entry->live_bytes, bytes);
+}
+
+}  // namespace
+
+SamplingHeapProfiler::StackTotals::StackTotals()
+    : live_count(0),
+      live_bytes(0),
+      total_count(0),
+      total_bytes(0) {
+}
+
+SamplingHeapProfiler::StackTotals::~StackTotals() {
+}
+
+// static
+SamplingHeapProfiler* SamplingHeapProfiler::GetInstance() {
+  return Singleton<SamplingHeapProfiler,
+                   LeakySingletonTraits<SamplingHeapProfiler> >::get();
+}
+
+SamplingHeapProfiler::SamplingHeapProfiler() : running_(false) {
+}
+
+SamplingHeapProfiler::~SamplingHeapProfiler() {
+}
+
+bool SamplingHeapProfiler::Start(size_t sampling_interval_bytes) {
+  DCHECK_GT(sampling_interval_bytes, 0u);
+  AutoLock lock(lock_);
+  if (!g_tables) {
+    g_tables = new Tables();
+    ANNOTATE_LEAKING_OBJECT_PTR(g_tables);
+  }
+  subtle::NoBarrier_Store(&g_sampling_interval,
+                          static_cast<subtle::AtomicWord>(
+                              sampling_interval_bytes));
+  if (running_)
+    return allocator::SetAllocationHooks(&RecordAlloc, &RecordFree);
+
+  // The first StackTrace loads the unwinder, which allocates.
+  StackTrace();
+
+  running_ = true;
+  subtle::Release_Store(&g_running, 1);
+  return allocator::SetAllocationHooks(&RecordAlloc, &RecordFree);
+}
+
+void SamplingHeapProfiler::Stop() {
+  AutoLock lock(lock_);
+  if (!running_)
+    return;
+  allocator::SetAllocationHooks(NULL, NULL);
+  subtle::Release_Store(&g_running, 0);
+  running_ = false;
+}
+
+bool SamplingHeapProfiler::IsRunning() const {
+  AutoLock lock(lock_);
+  return running_;
+}
+
+void SamplingHeapProfiler::Clear() {
+  AutoLock lock(lock_);
+  DCHECK(!running_);
+  if (!g_tables)
+    return;
+  // Keep the hooks off the tables while they are wiped: uninstall them, and
+  // make any call that still comes in return before touching the tables.
+  allocator::SetAllocationHooks(NULL, NULL);
+  subtle::Release_Store(&g_running, 0);
+  subtle::Release_Store(&g_live_sample_count, 0);
+  memset(g_tables, 0, sizeof(*g_tables));
+}
+
+void SamplingHeapProfiler::GetProfile(
+    std::vector<StackTotals>* profile) const {
+  if (!g_tables)
+    return;
+  for (size_t i = 0; i < kMaxStacks; ++i) {
+    const StackEntry& entry = g_tables->stacks[i];
+    if (subtle::Acquire_Load(&entry.state) != kStackReady)
+      continue;
+    profile->push_back(StackTotals());
+    StackTotals& totals = profile->back();
+    totals.frames.assign(entry.frames, entry.frames + entry.frame_count);
+    totals.live_count = subtle::NoBarrier_Load(&entry.live_count);
+    totals.live_bytes = subtle::NoBarrier_Load(&entry.live_bytes);
+    totals.total_count = subtle::NoBarrier_Load(&entry.total_count);
+    totals.total_bytes = subtle::NoBarrier_Load(&entry.total_bytes);
+  }
+}
+
+int SamplingHeapProfiler::GetDroppedSampleCount() const {
+  if (!g_tables)
+    return 0;
+  return subtle::NoBarrier_Load(&g_tables->dropped_count);
+}
+
+// static
+void SamplingHeapProfiler::RecordAlloc(const void* address, size_t size) {
+  if (!subtle::NoBarrier_Load(&g_running))
+    return;
+  ThreadState* state = &g_thread_state;
+  if (static_cast<intptr_t>(size) < state->bytes_until_sample) {
+    state->bytes_until_sample -= size;
+    return;
+  }
+  // Allocations made while sampling, by StackTrace or by another hook, are
+  // not counted.
+  if (state->in_sample || !address)
+    return;
+  state->in_sample = true;
+
+  size_t interval = subtle::NoBarrier_Load(&g_sampling_interval);
+  if (!state->random_state) {
+    state->random_state =
+        static_cast<uint32>(reinterpret_cast<uintptr_t>(state)) ^
+        static_cast<uint32>(TimeTicks::Now().ToInternalValue());
+    if (!state->random_state)
+      state->random_state = 1;
+    state->bytes_until_sample = NextSampleInterval(state, interval);
+  }
+  state->bytes_until_sample -= size;
+  if (state->bytes_until_sample <= 0) {
+    state->bytes_until_sample = NextSampleInterval(state, interval);
+    SampleAllocation(address, size, interval);
+  }
+  state->in_sample = false;
+}
+
+// static
+void SamplingHeapProfiler::RecordFree(const void* address) {
+  if (!subtle::NoBarrier_Load(&g_live_sample_count) || !address)
+    return;
+  RemoveLiveSample(address);
+}
+
+}  // namespace debug
+}  // namespace base
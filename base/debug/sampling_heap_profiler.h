@@ -0,0 +1,104 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef BASE_DEBUG_SAMPLING_HEAP_PROFILER_H_
+#define BASE_DEBUG_SAMPLING_HEAP_PROFILER_H_
+
+#include <vector>
+
+#include "base/base_export.h"
+#include "base/basictypes.h"
+#include "base/synchronization/lock.h"
+
+template <typename T> struct DefaultSingletonTraits;
+
+namespace base {
+namespace debug {
+
+// Finds the call sites that allocate the most, cheaply enough to be left
+// running in production.
+//
+// Allocations are sampled in proportion to their size: each thread counts
+// down the bytes it allocates from an interval drawn from an exponential
+// distribution, so that the samples are a Poisson process over the bytes
+// allocated, and the allocation that reaches zero is sampled. A sample of
+// |size| bytes stands for 1 / (1 - exp(-size / mean_interval)) allocations
+// of that size, which makes the totals unbiased estimates of the totals of
+// all allocations. Allocations which aren't sampled only cost a thread-local
+// subtraction.
+//
+// The StackTrace of a sampled allocation goes to a table of stacks, and its
+// address to a table of live samples, so that freeing it takes it off the
+// live totals of its stack. Both tables are preallocated, and written to
+// without locks or allocations, as the hooks run inside the allocator;
+// samples that don't fit are dropped, and counted.
+//
+// The profiler gets the allocations from the hooks of
+// base::allocator::SetAllocationHooks(). Allocators without hooks can call
+// RecordAlloc() and RecordFree() themselves.
+class BASE_EXPORT SamplingHeapProfiler {
+ public:
+  // The mean number of bytes allocated between two samples by default.
+  static const size_t kDefaultSamplingIntervalBytes = 128 * 1024;
+
+  // The estimated totals of the allocations made from one stack.
+  struct BASE_EXPORT StackTotals {
+    StackTotals();
+    ~StackTotals();
+
+    // The return addresses of the stack, innermost first.
+    std::vector<const void*> frames;
+
+    // The allocations not freed yet.
+    size_t live_count;
+    size_t live_bytes;
+
+    // All the allocations since the profile was cleared.
+    size_t total_count;
+    size_t total_bytes;
+  };
+
+  static SamplingHeapProfiler* GetInstance();
+
+  // Starts sampling allocations, one every |sampling_interval_bytes| on
+  // average. Returns false if the allocator has no hooks, in which case only
+  // the allocations passed to RecordAlloc() are sampled.
+  bool Start(size_t sampling_interval_bytes);
+
+  // Stops sampling. The profile is kept until Clear().
+  void Stop();
+
+  bool IsRunning() const;
+
+  // Forgets the samples taken. Must not be called while running. Uninstalls
+  // the allocation hooks before the tables are wiped.
+  void Clear();
+
+  // Appends the totals of each stack sampled to |profile|.
+  void GetProfile(std::vector<StackTotals>* profile) const;
+
+  // The number of samples dropped because a table was full.
+  int GetDroppedSampleCount() const;
+
+  // The allocation hooks.
+  static void RecordAlloc(const void* address, size_t size);
+  static void RecordFree(const void* address);
+
+ private:
+  friend struct DefaultSingletonTraits<SamplingHeapProfiler>;
+
+  SamplingHeapProfiler();
+  ~SamplingHeapProfiler();
+
+  // Protects starting and stopping.
+  mutable Lock lock_;
+  bool running_;
+
+  DISALLOW_COPY_AND_ASSIGN(SamplingHeapProfiler);
+};
+
+}  // namespace debug
+}  // namespace base
+
+#endif  // BASE_DEBUG_SAMPLING_HEAP_PROFILER_H_
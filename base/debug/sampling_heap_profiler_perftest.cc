@@ -0,0 +1,57 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/debug/sampling_heap_profiler.h"
+
+#include <string>
+#include <vector>
+
+#include "base/allocator/allocator_extension.h"
+#include "base/time/time.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "testing/perf/perf_test.h"
+
+namespace base {
+namespace debug {
+
+namespace {
+
+const int kAllocations = 10000000;
+
+// Records the allocation and free of blocks of |size| bytes, as the hooks of
+// the allocator would, and reports the cost per allocation.
+void MeasureHookCost(const std::string& trace, size_t size) {
+  TimeTicks start = TimeTicks::Now();
+  for (int i = 0; i < kAllocations; ++i) {
+    const void* address = reinterpret_cast<const void*>(0x10000 + i * 64);
+    SamplingHeapProfiler::RecordAlloc(address, size);
+    SamplingHeapProfiler::RecordFree(address);
+  }
+  TimeDelta elapsed = TimeTicks::Now() - start;
+  perf_test::PrintResult("ns_per_allocation", "", trace,
+                         elapsed.InMillisecondsF() * 1e6 / kAllocations, "ns",
+                         true);
+}
+
+}  // namespace
+
+TEST(SamplingHeapProfilerPerfTest, HookCost) {
+  SamplingHeapProfiler* profiler = SamplingHeapProfiler::GetInstance();
+  MeasureHookCost("stopped", 64);
+
+  profiler->Start(SamplingHeapProfiler::kDefaultSamplingIntervalBytes);
+  // Only the allocations recorded here.
+  allocator::SetAllocationHooks(NULL, NULL);
+  MeasureHookCost("running_64_bytes", 64);
+  MeasureHookCost("running_4096_bytes", 4096);
+  profiler->Stop();
+
+  std::vector<SamplingHeapProfiler::StackTotals> profile;
+  profiler->GetProfile(&profile);
+  EXPECT_FALSE(profile.empty());
+  profiler->Clear();
+}
+
+}  // namespace debug
+}  // namespace base
@@ -0,0 +1,175 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/debug/sampling_heap_profiler.h"
+
+#include <string>
+#include <vector>
+
+#include "base/allocator/allocator_extension.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace base {
+namespace debug {
+
+namespace {
+
+// Larger than any number of bytes a thread can be left to allocate until its
+// next sample, so that allocations of this size are always sampled, with a
+// weight of one, when the interval is one byte.
+const size_t kLargeSize = 1 << 24;
+
+const void* FakeAddress(size_t index) {
+  return reinterpret_cast<const void*>(0x10000 + index * 64);
+}
+
+class SamplingHeapProfilerTest : public testing::Test {
+ public:
+  SamplingHeapProfilerTest()
+      : profiler_(SamplingHeapProfiler::GetInstance()) {}
+
+  virtual void SetUp() OVERRIDE {
+    profiler_->Clear();
+  }
+
+  virtual void TearDown() OVERRIDE {
+    profiler_->Stop();
+    profiler_->Clear();
+  }
+
+  void Start(size_t sampling_interval_bytes) {
+    profiler_->Start(sampling_interval_bytes);
+    // Only sample the allocations recorded by the tests.
+    allocator::SetAllocationHooks(NULL, NULL);
+  }
+
+  // Sums the totals of all stacks.
+  SamplingHeapProfiler::StackTotals GetTotals() {
+    std::vector<SamplingHeapProfiler::StackTotals> profile;
+    profiler_->GetProfile(&profile);
+    SamplingHeapProfiler::StackTotals totals;
+    for (size_t i = 0; i < profile.size(); ++i) {
+      totals.live_count += profile[i].live_count;
+      totals.live_bytes += profile[i].live_bytes;
+      totals.total_count += profile[i].total_count;
+      totals.total_bytes += profile[i].total_bytes;
+    }
+    return totals;
+  }
+
+ protected:
+  SamplingHeapProfiler* profiler_;
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(SamplingHeapProfilerTest);
+};
+
+}  // namespace
+
+TEST_F(SamplingHeapProfilerTest, NotRunning) {
+  EXPECT_FALSE(profiler_->IsRunning());
+  SamplingHeapProfiler::RecordAlloc(FakeAddress(0), kLargeSize);
+  SamplingHeapProfiler::RecordFree(FakeAddress(0));
+
+  std::vector<SamplingHeapProfiler::StackTotals> profile;
+  profiler_->GetProfile(&profile);
+  EXPECT_TRUE(profile.empty());
+}
+
+TEST_F(SamplingHeapProfilerTest, LiveAndTotal) {
+  Start(1);
+  EXPECT_TRUE(profiler_->IsRunning());
+  for (size_t i = 0; i < 10; ++i)
+    SamplingHeapProfiler::RecordAlloc(FakeAddress(i), kLargeSize);
+  for (size_t i = 0; i < 4; ++i)
+    SamplingHeapProfiler::RecordFree(FakeAddress(i));
+  // Frees of addresses which weren't sampled are ignored.
+  SamplingHeapProfiler::RecordFree(FakeAddress(100));
+  profiler_->Stop();
+  EXPECT_FALSE(profiler_->IsRunning());
+
+  std::vector<SamplingHeapProfiler::StackTotals> profile;
+  profiler_->GetProfile(&profile);
+  ASSERT_EQ(1u, profile.size());
+  EXPECT_FALSE(profile[0].frames.empty());
+  EXPECT_EQ(6u, profile[0].live_count);
+  EXPECT_EQ(6 * kLargeSize, profile[0].live_bytes);
+  EXPECT_EQ(10u, profile[0].total_count);
+  EXPECT_EQ(10 * kLargeSize, profile[0].total_bytes);
+  EXPECT_EQ(0, profiler_->GetDroppedSampleCount());
+
+  // The profile is kept after stopping, and frees still count.
+  SamplingHeapProfiler::RecordFree(FakeAddress(4));
+  SamplingHeapProfiler::StackTotals totals = GetTotals();
+  EXPECT_EQ(5u, totals.live_count);
+  EXPECT_EQ(10u, totals.total_count);
+
+  profiler_->Clear();
+  profile.clear();
+  profiler_->GetProfile(&profile);
+  EXPECT_TRUE(profile.empty());
+}
+
+TEST_F(SamplingHeapProfilerTest, Stacks) {
+  Start(1);
+  for (size_t i = 0; i < 3; ++i)
+    SamplingHeapProfiler::RecordAlloc(FakeAddress(i), kLargeSize);
+  SamplingHeapProfiler::RecordAlloc(FakeAddress(3), kLargeSize);
+  profiler_->Stop();
+
+  std::vector<SamplingHeapProfiler::StackTotals> profile;
+  profiler_->GetProfile(&profile);
+  size_t total_count = 0;
+  for (size_t i = 0; i < profile.size(); ++i) {
+    total_count += profile[i].total_count;
+    for (size_t j = 0; j < i; ++j)
+      EXPECT_NE(profile[i].frames, profile[j].frames);
+  }
+  EXPECT_EQ(4u, total_count);
+#if !defined(OS_NACL) && !defined(OS_IOS)
+  // The loop may be unrolled, but the call after it is a stack of its own.
+  EXPECT_GE(profile.size(), 2u);
+#endif
+}
+
+// The estimates of sampling a fraction of the allocations are close to the
+// actual totals.
+TEST_F(SamplingHeapProfilerTest, Estimates) {
+  const size_t kInterval = 4096;
+  const size_t kSize = 64;
+  const size_t kAllocations = 100000;
+  Start(kInterval);
+  for (size_t i = 0; i < kAllocations; ++i)
+    SamplingHeapProfiler::RecordAlloc(FakeAddress(i), kSize);
+  for (size_t i = 0; i < kAllocations / 2; ++i)
+    SamplingHeapProfiler::RecordFree(FakeAddress(i));
+  profiler_->Stop();
+
+  // About 1500 samples; more than 20% off is five standard deviations.
+  SamplingHeapProfiler::StackTotals totals = GetTotals();
+  EXPECT_NEAR(kAllocations * kSize, totals.total_bytes,
+              kAllocations * kSize / 5);
+  EXPECT_NEAR(kAllocations, totals.total_count, kAllocations / 5);
+  EXPECT_NEAR(kAllocations * kSize / 2, totals.live_bytes,
+              kAllocations * kSize / 5);
+  EXPECT_EQ(0, profiler_->GetDroppedSampleCount());
+}
+
+TEST_F(SamplingHeapProfilerTest, DroppedSamples) {
+  Start(1);
+  // Each sample of the same address takes another slot next to its hash,
+  // until there is none close enough.
+  for (size_t i = 0; i < 100; ++i)
+    SamplingHeapProfiler::RecordAlloc(FakeAddress(0), kLargeSize);
+  profiler_->Stop();
+
+  SamplingHeapProfiler::StackTotals totals = GetTotals();
+  EXPECT_EQ(100u, totals.total_count);
+  EXPECT_LT(totals.live_count, 100u);
+  EXPECT_EQ(100 - totals.live_count,
+            static_cast<size_t>(profiler_->GetDroppedSampleCount()));
+}
+
+}  // namespace debug
+}  // namespace base
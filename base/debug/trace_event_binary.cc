@@ -0,0 +1,724 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/debug/trace_event_binary.h"
+
+#include <string.h>
+
+#include "base/debug/trace_event.h"
+#include "base/files/file.h"
+#include "base/format_macros.h"
+#include "base/logging.h"
+#include "base/stl_util.h"
+#include "base/strings/stringprintf.h"
+#include "base/synchronization/condition_variable.h"
+#include "base/synchronization/lock.h"
+#include "base/threading/platform_thread.h"
+
+namespace base {
+namespace debug {
+
+namespace {
+
+const char kMagic[] = { 'T', 'R', 'C', 'B' };
+const uint8 kVersion = 1;
+
+// The tags of the records.
+const uint8 kStringRecord = 1;
+const uint8 kEventRecord = 2;
+
+// Writing falls too far behind when it has this many chunks left to write.
+const size_t kMaxQueuedChunks = 1024;
+
+// The number of written chunks kept for reuse.
+const size_t kMaxRecycledChunks = 16;
+
+void AppendVarint(uint64 value, std::string* out) {
+  while (value >= 0x80) {
+    out->push_back(static_cast<char>((value & 0x7F) | 0x80));
+    value >>= 7;
+  }
+  out->push_back(static_cast<char>(value));
+}
+
+void AppendSignedVarint(int64 value, std::string* out) {
+  // Zigzag encoding maps small negative values to small unsigned ones.
+  AppendVarint((static_cast<uint64>(value) << 1) ^
+                   static_cast<uint64>(value >> 63),
+               out);
+}
+
+void AppendBytes(const char* data, size_t length, std::string* out) {
+  AppendVarint(length, out);
+  out->append(data, length);
+}
+
+// Reads the records appended by the functions above.
+class BinaryTraceReader {
+ public:
+  BinaryTraceReader(const char* data, size_t size)
+      : pos_(data), end_(data + size) {}
+
+  bool AtEnd() const { return pos_ == end_; }
+
+  bool ReadByte(uint8* value) {
+    if (pos_ == end_)
+      return false;
+    *value = static_cast<uint8>(*pos_++);
+    return true;
+  }
+
+  bool ReadVarint(uint64* value) {
+    *value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+      uint8 byte;
+      if (!ReadByte(&byte))
+        return false;
+      *value |= static_cast<uint64>(byte & 0x7F) << shift;
+      if (!(byte & 0x80))
+        return true;
+    }
+    return false;
+  }
+
+  bool ReadSignedVarint(int64* value) {
+    uint64 zigzag;
+    if (!ReadVarint(&zigzag))
+      return false;
+    *value = static_cast<int64>(zigzag >> 1) ^ -static_cast<int64>(zigzag & 1);
+    return true;
+  }
+
+  bool ReadBytes(size_t length, const char** data) {
+    if (length > static_cast<size_t>(end_ - pos_))
+      return false;
+    *data = pos_;
+    pos_ += length;
+    return true;
+  }
+
+  bool ReadString(std::string* value) {
+    uint64 length;
+    const char* data;
+    if (!ReadVarint(&length) || !ReadBytes(length, &data))
+      return false;
+    value->assign(data, length);
+    return true;
+  }
+
+ private:
+  const char* pos_;
+  const char* const end_;
+
+  DISALLOW_COPY_AND_ASSIGN(BinaryTraceReader);
+};
+
+// Reads an interned string id and sets |value| to that string.
+bool ReadStringId(BinaryTraceReader* reader,
+                  const std::vector<std::string>& strings,
+                  const std::string** value) {
+  uint64 id;
+  if (!reader->ReadVarint(&id) || id >= strings.size())
+    return false;
+  *value = &strings[id];
+  return true;
+}
+
+// Reads an argument value and appends it to |out| as AppendAsJSON() does.
+bool ConvertArgumentToJSON(BinaryTraceReader* reader,
+                           unsigned char type,
+                           std::string* out) {
+  TraceEvent::TraceValue value;
+  std::string string_value;
+  switch (type) {
+    case TRACE_VALUE_TYPE_BOOL: {
+      uint8 byte;
+      if (!reader->ReadByte(&byte))
+        return false;
+      value.as_bool = byte != 0;
+      break;
+    }
+    case TRACE_VALUE_TYPE_UINT: {
+      uint64 uint_value;
+      if (!reader->ReadVarint(&uint_value))
+        return false;
+      value.as_uint = uint_value;
+      break;
+    }
+    case TRACE_VALUE_TYPE_POINTER: {
+      uint64 pointer_value;
+      if (!reader->ReadVarint(&pointer_value))
+        return false;
+      value.as_pointer =
+          reinterpret_cast<const void*>(static_cast<uintptr_t>(pointer_value));
+      break;
+    }
+    case TRACE_VALUE_TYPE_INT: {
+      int64 int_value;
+      if (!reader->ReadSignedVarint(&int_value))
+        return false;
+      value.as_int = int_value;
+      break;
+    }
+    case TRACE_VALUE_TYPE_DOUBLE: {
+      const char* data;
+      if (!reader->ReadBytes(sizeof(value.as_double), &data))
+        return false;
+      memcpy(&value.as_double, data, sizeof(value.as_double));
+      break;
+    }
+    case TRACE_VALUE_TYPE_STRING:
+    case TRACE_VALUE_TYPE_COPY_STRING: {
+      // The length is one more than that of the string, or 0 for NULL.
+      uint64 length;
+      const char* data;
+      if (!reader->ReadVarint(&length) || !reader->ReadBytes(
+              length ? length - 1 : 0, &data)) {
+        return false;
+      }
+      if (length) {
+        string_value.assign(data, length - 1);
+        value.as_string = string_value.c_str();
+      } else {
+        value.as_string = NULL;
+      }
+      break;
+    }
+    case TRACE_VALUE_TYPE_CONVERTABLE: {
+      // Written out as JSON already.
+      std::string json;
+      if (!reader->ReadString(&json))
+        return false;
+      *out += json;
+      return true;
+    }
+    default:
+      return false;
+  }
+  TraceEvent::AppendValueAsJSON(type, value, out);
+  return true;
+}
+
+// Reads an event record, past its tag, and appends it to |out| in the JSON
+// format of TraceEvent::AppendAsJSON().
+bool ConvertEventToJSON(BinaryTraceReader* reader,
+                        const std::vector<std::string>& strings,
+                        int process_id,
+                        int64* timestamp,
+                        std::string* out) {
+  uint8 phase;
+  uint8 flags;
+  const std::string* category;
+  const std::string* name;
+  int64 thread_id;
+  int64 timestamp_delta;
+  int64 thread_timestamp;
+  if (!reader->ReadByte(&phase) || !reader->ReadByte(&flags) ||
+      !ReadStringId(reader, strings, &category) ||
+      !ReadStringId(reader, strings, &name) ||
+      !reader->ReadSignedVarint(&thread_id) ||
+      !reader->ReadSignedVarint(&timestamp_delta) ||
+      !reader->ReadSignedVarint(&thread_timestamp)) {
+    return false;
+  }
+  int64 duration = -1;
+  int64 thread_duration = -1;
+  if (phase == TRACE_EVENT_PHASE_COMPLETE &&
+      (!reader->ReadSignedVarint(&duration) ||
+       !reader->ReadSignedVarint(&thread_duration))) {
+    return false;
+  }
+  uint64 id = 0;
+  if ((flags & TRACE_EVENT_FLAG_HAS_ID) && !reader->ReadVarint(&id))
+    return false;
+  *timestamp += timestamp_delta;
+
+  // Write the event to a string of its own, so that nothing of it is left in
+  // |out| if it turns out to be incomplete.
+  std::string json;
+  StringAppendF(&json,
+      "{\"cat\":\"%s\",\"pid\":%i,\"tid\":%i,\"ts\":%" PRId64 ","
+      "\"ph\":\"%c\",\"name\":\"%s\",\"args\":{",
+      category->c_str(),
+      process_id,
+      static_cast<int>(thread_id),
+      *timestamp,
+      phase,
+      name->c_str());
+
+  uint8 num_args;
+  if (!reader->ReadByte(&num_args) || num_args > kTraceMaxNumArgs)
+    return false;
+  for (uint8 i = 0; i < num_args; ++i) {
+    const std::string* arg_name;
+    uint8 arg_type;
+    if (!ReadStringId(reader, strings, &arg_name) ||
+        !reader->ReadByte(&arg_type)) {
+      return false;
+    }
+    if (i > 0)
+      json += ",";
+    json += "\"";
+    json += *arg_name;
+    json += "\":";
+    if (!ConvertArgumentToJSON(reader, arg_type, &json))
+      return false;
+  }
+  json += "}";
+
+  if (phase == TRACE_EVENT_PHASE_COMPLETE) {
+    if (duration != -1)
+      StringAppendF(&json, ",\"dur\":%" PRId64, duration);
+    if (thread_timestamp && thread_duration != -1)
+      StringAppendF(&json, ",\"tdur\":%" PRId64, thread_duration);
+  }
+  if (thread_timestamp)
+    StringAppendF(&json, ",\"tts\":%" PRId64, thread_timestamp);
+  if (flags & TRACE_EVENT_FLAG_HAS_ID)
+    StringAppendF(&json, ",\"id\":\"0x%" PRIx64 "\"", id);
+  if (phase == TRACE_EVENT_PHASE_INSTANT) {
+    char scope = '?';
+    switch (flags & TRACE_EVENT_FLAG_SCOPE_MASK) {
+      case TRACE_EVENT_SCOPE_GLOBAL:
+        scope = TRACE_EVENT_SCOPE_NAME_GLOBAL;
+        break;
+      case TRACE_EVENT_SCOPE_PROCESS:
+        scope = TRACE_EVENT_SCOPE_NAME_PROCESS;
+        break;
+      case TRACE_EVENT_SCOPE_THREAD:
+        scope = TRACE_EVENT_SCOPE_NAME_THREAD;
+        break;
+    }
+    StringAppendF(&json, ",\"s\":\"%c\"", scope);
+  }
+  json += "}";
+
+  if (!out->empty())
+    *out += ",";
+  *out += json;
+  return true;
+}
+
+}  // namespace
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// TraceEventBinaryWriter
+//
+////////////////////////////////////////////////////////////////////////////////
+
+TraceEventBinaryWriter::TraceEventBinaryWriter(int process_id)
+    : process_id_(process_id),
+      wrote_header_(false),
+      last_timestamp_(0),
+      next_string_id_(0) {
+}
+
+TraceEventBinaryWriter::~TraceEventBinaryWriter() {
+}
+
+void TraceEventBinaryWriter::AppendEvent(const TraceEvent& event,
+                                         std::string* out) {
+  if (!wrote_header_) {
+    out->append(kMagic, sizeof(kMagic));
+    out->push_back(static_cast<char>(kVersion));
+    AppendSignedVarint(process_id_, out);
+    wrote_header_ = true;
+  }
+
+  // The strings are defined ahead of the event record.
+  bool copied = !!(event.flags_ & TRACE_EVENT_FLAG_COPY);
+  uint32 category_id = InternString(
+      TraceLog::GetCategoryGroupName(event.category_group_enabled_), false,
+      out);
+  uint32 name_id = InternString(event.name_, copied, out);
+  int num_args = 0;
+  uint32 arg_name_ids[kTraceMaxNumArgs];
+  for (; num_args < kTraceMaxNumArgs && event.arg_names_[num_args];
+       ++num_args) {
+    arg_name_ids[num_args] =
+        InternString(event.arg_names_[num_args], copied, out);
+  }
+
+  char phase = event.phase_;
+  int64 duration = event.duration_.ToInternalValue();
+  if (phase == TRACE_EVENT_PHASE_COMPLETE && duration == -1)
+    phase = TRACE_EVENT_PHASE_BEGIN;
+
+  out->push_back(static_cast<char>(kEventRecord));
+  out->push_back(phase);
+  out->push_back(static_cast<char>(event.flags_));
+  AppendVarint(category_id, out);
+  AppendVarint(name_id, out);
+  AppendSignedVarint(event.thread_id_, out);
+  int64 timestamp = event.timestamp_.ToInternalValue();
+  AppendSignedVarint(timestamp - last_timestamp_, out);
+  last_timestamp_ = timestamp;
+  AppendSignedVarint(event.thread_timestamp_.ToInternalValue(), out);
+  if (phase == TRACE_EVENT_PHASE_COMPLETE) {
+    AppendSignedVarint(duration, out);
+    AppendSignedVarint(event.thread_duration_.ToInternalValue(), out);
+  }
+  if (event.flags_ & TRACE_EVENT_FLAG_HAS_ID)
+    AppendVarint(event.id_, out);
+
+  out->push_back(static_cast<char>(num_args));
+  for (int i = 0; i < num_args; ++i) {
+    unsigned char type = event.arg_types_[i];
+    const TraceEvent::TraceValue& value = event.arg_values_[i];
+    AppendVarint(arg_name_ids[i], out);
+    out->push_back(static_cast<char>(type));
+    switch (type) {
+      case TRACE_VALUE_TYPE_BOOL:
+        out->push_back(value.as_bool ? 1 : 0);
+        break;
+      case TRACE_VALUE_TYPE_UINT:
+        AppendVarint(value.as_uint, out);
+        break;
+      case TRACE_VALUE_TYPE_INT:
+        AppendSignedVarint(value.as_int, out);
+        break;
+      case TRACE_VALUE_TYPE_DOUBLE:
+        out->append(reinterpret_cast<const char*>(&value.as_double),
+                    sizeof(value.as_double));
+        break;
+      case TRACE_VALUE_TYPE_POINTER:
+        AppendVarint(reinterpret_cast<uintptr_t>(value.as_pointer), out);
+        break;
+      case TRACE_VALUE_TYPE_STRING:
+      case TRACE_VALUE_TYPE_COPY_STRING:
+        if (value.as_string) {
+          size_t length = strlen(value.as_string);
+          AppendVarint(length + 1, out);
+          out->append(value.as_string, length);
+        } else {
+          AppendVarint(0, out);
+        }
+        break;
+      case TRACE_VALUE_TYPE_CONVERTABLE: {
+        std::string json;
+        event.convertable_values_[i]->AppendAsTraceFormat(&json);
+        AppendBytes(json.data(), json.size(), out);
+        break;
+      }
+      default:
+        NOTREACHED() << "Don't know how to encode this value";
+        AppendVarint(0, out);
+        break;
+    }
+  }
+}
+
+uint32 TraceEventBinaryWriter::InternString(const char* str,
+                                            bool copied,
+                                            std::string* out) {
+  uint32* id;
+  if (copied) {
+    std::pair<hash_map<std::string, uint32>::iterator, bool> result =
+        copied_string_ids_.insert(std::make_pair(std::string(str), 0u));
+    if (!result.second)
+      return result.first->second;
+    id = &result.first->second;
+  } else {
+    std::pair<hash_map<const char*, uint32>::iterator, bool> result =
+        static_string_ids_.insert(std::make_pair(str, 0u));
+    if (!result.second)
+      return result.first->second;
+    id = &result.first->second;
+  }
+  *id = next_string_id_++;
+  out->push_back(static_cast<char>(kStringRecord));
+  AppendVarint(*id, out);
+  AppendBytes(str, strlen(str), out);
+  return *id;
+}
+
+bool ConvertBinaryTraceToJSON(const char* data,
+                              size_t size,
+                              std::string* out) {
+  BinaryTraceReader reader(data, size);
+  const char* magic;
+  uint8 version;
+  int64 process_id;
+  if (!reader.ReadBytes(sizeof(kMagic), &magic) ||
+      memcmp(magic, kMagic, sizeof(kMagic)) != 0 ||
+      !reader.ReadByte(&version) || version != kVersion ||
+      !reader.ReadSignedVarint(&process_id)) {
+    return false;
+  }
+
+  std::vector<std::string> strings;
+  int64 timestamp = 0;
+  std::string events;
+  bool valid = true;
+  while (!reader.AtEnd()) {
+    uint8 tag;
+    reader.ReadByte(&tag);
+    if (tag == kStringRecord) {
+      uint64 id;
+      std::string str;
+      // Ids are handed out in order.
+      if (!reader.ReadVarint(&id) || id != strings.size() ||
+          !reader.ReadString(&str)) {
+        valid = false;
+        break;
+      }
+      strings.push_back(str);
+    } else if (tag != kEventRecord ||
+               !ConvertEventToJSON(&reader, strings,
+                                   static_cast<int>(process_id), &timestamp,
+                                   &events)) {
+      valid = false;
+      break;
+    }
+  }
+
+  if (!events.empty()) {
+    if (!out->empty())
+      *out += ",";
+    *out += events;
+  }
+  return valid;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// TraceBufferStreaming
+//
+////////////////////////////////////////////////////////////////////////////////
+
+// Writes the chunks queued to it to the file on a thread of its own. Writing
+// goes on until Stop() is called and everything queued has been written.
+class TraceBufferStreaming::Writer : public PlatformThread::Delegate {
+ public:
+  // Opens |path| and starts the writing thread.
+  Writer(const FilePath& path, int process_id)
+      : path_(path),
+        file_(path, File::FLAG_CREATE_ALWAYS | File::FLAG_WRITE),
+        encoder_(process_id),
+        work_available_(&lock_),
+        stopping_(false),
+        failed_(false) {
+    if (!file_.IsValid()) {
+      DLOG(ERROR) << "Failed to open " << path_.value();
+      failed_ = true;
+    }
+    if (!PlatformThread::Create(0, this, &thread_handle_)) {
+      DLOG(ERROR) << "Failed to create the trace streaming thread";
+      failed_ = true;
+    }
+  }
+
+  virtual ~Writer() {
+    DCHECK(thread_handle_.is_null());
+    STLDeleteElements(&queue_);
+    STLDeleteElements(&recycled_);
+  }
+
+  void Write(scoped_ptr<TraceBufferChunk> chunk) {
+    AutoLock lock(lock_);
+    DCHECK(!stopping_);
+    queue_.push_back(chunk.release());
+    work_available_.Signal();
+  }
+
+  // Returns a chunk that was written, for reuse, or NULL if there is none.
+  scoped_ptr<TraceBufferChunk> TakeWrittenChunk() {
+    AutoLock lock(lock_);
+    if (recycled_.empty())
+      return scoped_ptr<TraceBufferChunk>();
+    scoped_ptr<TraceBufferChunk> chunk(recycled_.back());
+    recycled_.pop_back();
+    return chunk.Pass();
+  }
+
+  size_t queued_chunks() const {
+    AutoLock lock(lock_);
+    return queue_.size();
+  }
+
+  bool failed() const {
+    AutoLock lock(lock_);
+    return failed_;
+  }
+
+  // Waits for everything queued to be written and the file to be closed.
+  void Stop() {
+    {
+      AutoLock lock(lock_);
+      stopping_ = true;
+      work_available_.Signal();
+    }
+    if (!thread_handle_.is_null()) {
+      PlatformThread::Join(thread_handle_);
+      thread_handle_ = PlatformThreadHandle();
+    }
+  }
+
+  // PlatformThread::Delegate implementation:
+  virtual void ThreadMain() OVERRIDE {
+    PlatformThread::SetName("TraceStreamingThread");
+    std::string encoded;
+
+    AutoLock lock(lock_);
+    while (true) {
+      while (queue_.empty() && !stopping_)
+        work_available_.Wait();
+      if (queue_.empty())
+        break;
+      TraceBufferChunk* chunk = queue_.front();
+      queue_.pop_front();
+      bool failed = failed_;
+      {
+        AutoUnlock unlock(lock_);
+        if (!failed) {
+          encoded.clear();
+          for (size_t i = 0; i < chunk->size(); ++i)
+            encoder_.AppendEvent(*chunk->GetEventAt(i), &encoded);
+          failed = file_.WriteAtCurrentPos(encoded.data(), encoded.size()) !=
+                   static_cast<int>(encoded.size());
+        }
+        // Release the copied parameters and convertable values here rather
+        // than on the thread reusing the chunk.
+        chunk->Reset(0);
+      }
+      if (failed && !failed_) {
+        DLOG(ERROR) << "Failed to write " << path_.value();
+        failed_ = true;
+      }
+      if (recycled_.size() < kMaxRecycledChunks)
+        recycled_.push_back(chunk);
+      else
+        delete chunk;
+    }
+    file_.Close();
+  }
+
+ private:
+  const FilePath path_;
+  // Only used on the writing thread once it started.
+  File file_;
+  TraceEventBinaryWriter encoder_;
+  PlatformThreadHandle thread_handle_;
+
+  // Protects the members below.
+  mutable Lock lock_;
+  ConditionVariable work_available_;
+  std::deque<TraceBufferChunk*> queue_;
+  std::vector<TraceBufferChunk*> recycled_;
+  bool stopping_;
+  bool failed_;
+
+  DISALLOW_COPY_AND_ASSIGN(Writer);
+};
+
+// static
+const size_t TraceBufferStreaming::kRetainedChunks = 16;
+
+TraceBufferStreaming::TraceBufferStreaming(const FilePath& path,
+                                           int process_id)
+    : next_chunk_seq_(1),
+      finished_(false) {
+  if (!path.empty())
+    writer_.reset(new Writer(path, process_id));
+}
+
+TraceBufferStreaming::~TraceBufferStreaming() {
+  Finish();
+}
+
+scoped_ptr<TraceBufferChunk> TraceBufferStreaming::GetChunk(size_t* index) {
+  if (free_indices_.empty()) {
+    *index = chunks_.size();
+    chunks_.push_back(NULL);
+  } else {
+    *index = free_indices_.back();
+    free_indices_.pop_back();
+  }
+
+  uint32 seq = next_chunk_seq_++;
+  // Zero chunk_seq is not allowed.
+  if (!next_chunk_seq_)
+    next_chunk_seq_ = 1;
+  scoped_ptr<TraceBufferChunk> chunk;
+  if (writer_)
+    chunk = writer_->TakeWrittenChunk();
+  if (chunk)
+    chunk->Reset(seq);
+  else
+    chunk.reset(new TraceBufferChunk(seq));
+  return chunk.Pass();
+}
+
+void TraceBufferStreaming::ReturnChunk(size_t index,
+                                       scoped_ptr<TraceBufferChunk> chunk) {
+  DCHECK(chunk);
+  DCHECK_LT(index, chunks_.size());
+  DCHECK(!chunks_[index]);
+  chunks_[index] = chunk.release();
+  retained_indices_.push_back(index);
+  if (retained_indices_.size() > kRetainedChunks)
+    WriteOldestChunk();
+}
+
+bool TraceBufferStreaming::IsFull() const {
+  return writer_ &&
+         (writer_->failed() || writer_->queued_chunks() >= kMaxQueuedChunks);
+}
+
+size_t TraceBufferStreaming::Size() const {
+  // The events not written yet. This is approximate because not all of the
+  // chunks are full.
+  size_t chunks = retained_indices_.size();
+  if (writer_)
+    chunks += writer_->queued_chunks();
+  return chunks * TraceBufferChunk::kTraceBufferChunkSize;
+}
+
+size_t TraceBufferStreaming::Capacity() const {
+  return (kRetainedChunks + kMaxQueuedChunks) *
+         TraceBufferChunk::kTraceBufferChunkSize;
+}
+
+TraceEvent* TraceBufferStreaming::GetEventByHandle(TraceEventHandle handle) {
+  if (handle.chunk_index >= chunks_.size())
+    return NULL;
+  TraceBufferChunk* chunk = chunks_[handle.chunk_index];
+  if (!chunk || chunk->seq() != handle.chunk_seq)
+    return NULL;
+  return chunk->GetEventAt(handle.event_index);
+}
+
+const TraceBufferChunk* TraceBufferStreaming::NextChunk() {
+  Finish();
+  return NULL;
+}
+
+scoped_ptr<TraceBuffer> TraceBufferStreaming::CloneForIteration() const {
+  return scoped_ptr<TraceBuffer>(new TraceBufferStreaming(FilePath(), 0));
+}
+
+void TraceBufferStreaming::WriteOldestChunk() {
+  size_t index = retained_indices_.front();
+  retained_indices_.pop_front();
+  if (writer_)
+    writer_->Write(make_scoped_ptr(chunks_[index]));
+  else
+    delete chunks_[index];
+  chunks_[index] = NULL;
+  free_indices_.push_back(index);
+}
+
+void TraceBufferStreaming::Finish() {
+  if (finished_)
+    return;
+  finished_ = true;
+  while (!retained_indices_.empty())
+    WriteOldestChunk();
+  if (writer_)
+    writer_->Stop();
+}
+
+}  // namespace debug
+}  // namespace base
@@ -0,0 +1,137 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// A compact binary encoding of TraceEvents, for traces too long to keep in
+// memory and convert to JSON all at once. TraceLog streams the events of a
+// recording session to a file in this format when given a path with
+// TraceLog::SetStreamingFilePath(); ConvertBinaryTraceToJSON() turns such a
+// file back into the JSON that TraceLog::Flush() outputs.
+//
+// The stream starts with a header, the 4 bytes "TRCB", a version byte and
+// the process id, followed by records that each start with a tag byte:
+// - a string record defines the id of an interned string, a category group,
+//   an event name or an argument name, before the first event using it;
+// - an event record holds the phase and flags of an event, the ids of its
+//   category group and name, its thread id, its timestamp as the difference
+//   from that of the previous event, and, depending on the phase and flags,
+//   its thread timestamp, durations, id and arguments.
+// Integers are varints, signed ones zigzag-encoded first, so that small
+// values and timestamp deltas take a byte or two.
+
+#ifndef BASE_DEBUG_TRACE_EVENT_BINARY_H_
+#define BASE_DEBUG_TRACE_EVENT_BINARY_H_
+
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "base/base_export.h"
+#include "base/basictypes.h"
+#include "base/containers/hash_tables.h"
+#include "base/debug/trace_event_impl.h"
+#include "base/files/file_path.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/memory/scoped_vector.h"
+
+namespace base {
+namespace debug {
+
+// Encodes a stream of TraceEvents. Not thread-safe.
+class BASE_EXPORT TraceEventBinaryWriter {
+ public:
+  explicit TraceEventBinaryWriter(int process_id);
+  ~TraceEventBinaryWriter();
+
+  // Appends the encoding of |event| to |out|, preceded by the definitions of
+  // the strings it is the first to use, and by the header if this is the
+  // first event. TRACE_EVENT_PHASE_COMPLETE events whose duration hasn't been
+  // set are encoded as TRACE_EVENT_PHASE_BEGIN events.
+  void AppendEvent(const TraceEvent& event, std::string* out);
+
+ private:
+  // Returns the id of |str|, appending its definition to |out| if it has
+  // none yet. If |str| is |copied| it is interned by its contents; otherwise
+  // it outlives the writer, and its address is enough.
+  uint32 InternString(const char* str, bool copied, std::string* out);
+
+  const int process_id_;
+  bool wrote_header_;
+  int64 last_timestamp_;
+  uint32 next_string_id_;
+  hash_map<const char*, uint32> static_string_ids_;
+  hash_map<std::string, uint32> copied_string_ids_;
+
+  DISALLOW_COPY_AND_ASSIGN(TraceEventBinaryWriter);
+};
+
+// Appends the events encoded in the |size| bytes at |data| to |out| as
+// comma-separated JSON objects, the format of the output of
+// TraceLog::Flush(), which TraceResultBuffer makes a JSON array of. Returns
+// false if the data is not a valid stream or ends in the middle of a record,
+// as one cut short by a crash would; the events decoded before that are in
+// |out| either way.
+BASE_EXPORT bool ConvertBinaryTraceToJSON(const char* data,
+                                          size_t size,
+                                          std::string* out);
+
+// The TraceBuffer of TraceLog::SetStreamingFilePath(). Instead of keeping
+// the chunks returned to it, it has a thread of its own encode them into a
+// file with a TraceEventBinaryWriter, so a trace can be as long as there is
+// disk for. The last few chunks returned are kept a while, as their events
+// may still get their durations; COMPLETE events that end after that are
+// written as BEGIN events, which TraceLog ends with END events. The buffer
+// reports being full if the file can't be written, or if writing falls too
+// far behind.
+class TraceBufferStreaming : public TraceBuffer {
+ public:
+  // Opens |path|, replacing any file there, and starts the writing thread, so
+  // it must not be created while TraceLog's lock is held. An empty |path|
+  // makes a buffer that drops the chunks returned to it.
+  TraceBufferStreaming(const FilePath& path, int process_id);
+  virtual ~TraceBufferStreaming();
+
+  // TraceBuffer implementation:
+  virtual scoped_ptr<TraceBufferChunk> GetChunk(size_t* index) OVERRIDE;
+  virtual void ReturnChunk(size_t index,
+                           scoped_ptr<TraceBufferChunk> chunk) OVERRIDE;
+  virtual bool IsFull() const OVERRIDE;
+  virtual size_t Size() const OVERRIDE;
+  virtual size_t Capacity() const OVERRIDE;
+  virtual TraceEvent* GetEventByHandle(TraceEventHandle handle) OVERRIDE;
+  // Writes what is left and waits for the file to be complete. The events
+  // are in the file, not in the buffer, so this returns NULL.
+  virtual const TraceBufferChunk* NextChunk() OVERRIDE;
+  // Returns an empty buffer, for the same reason.
+  virtual scoped_ptr<TraceBuffer> CloneForIteration() const OVERRIDE;
+
+  // The number of chunks kept after they are returned.
+  static const size_t kRetainedChunks;
+
+ private:
+  class Writer;
+
+  // Hands the oldest of |retained_indices_| over to |writer_|.
+  void WriteOldestChunk();
+
+  // Writes all retained chunks and stops |writer_| once it wrote them.
+  void Finish();
+
+  // Indexed by the chunk index; NULL for in-flight chunks, those handed over
+  // to |writer_|, and |free_indices_|.
+  ScopedVector<TraceBufferChunk> chunks_;
+  std::vector<size_t> free_indices_;
+  // The indices of the chunks retained, in the order they were returned.
+  std::deque<size_t> retained_indices_;
+  uint32 next_chunk_seq_;
+
+  scoped_ptr<Writer> writer_;
+  bool finished_;
+
+  DISALLOW_COPY_AND_ASSIGN(TraceBufferStreaming);
+};
+
+}  // namespace debug
+}  // namespace base
+
+#endif  // BASE_DEBUG_TRACE_EVENT_BINARY_H_
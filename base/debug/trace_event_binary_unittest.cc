@@ -0,0 +1,224 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/debug/trace_event_binary.h"
+
+#include <string>
+
+#include "base/debug/trace_event.h"
+#include "base/memory/ref_counted.h"
+#include "base/time/time.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace base {
+namespace debug {
+
+namespace {
+
+class TestConvertable : public ConvertableToTraceFormat {
+ public:
+  TestConvertable() {}
+
+  virtual void AppendAsTraceFormat(std::string* out) const OVERRIDE {
+    out->append("{\"foo\":[1,2]}");
+  }
+
+ private:
+  virtual ~TestConvertable() {}
+  DISALLOW_COPY_AND_ASSIGN(TestConvertable);
+};
+
+// Initializes |event| with the arguments packed as the TRACE_EVENT macros do.
+void InitializeEvent(TraceEvent* event,
+                     int64 timestamp,
+                     int64 thread_timestamp,
+                     char phase,
+                     const char* name,
+                     unsigned long long id,
+                     unsigned char flags) {
+  event->Initialize(1234, TimeTicks::FromInternalValue(timestamp),
+                    TimeTicks::FromInternalValue(thread_timestamp), phase,
+                    TraceLog::GetCategoryGroupEnabled("binary,test"), name, id,
+                    0, NULL, NULL, NULL, NULL, flags);
+}
+
+std::string ToJSON(const TraceEvent& event) {
+  std::string json;
+  event.AppendAsJSON(&json);
+  return json;
+}
+
+}  // namespace
+
+class TraceEventBinaryTest : public testing::Test {
+ protected:
+  TraceEventBinaryTest()
+      : writer_(TraceLog::GetInstance()->process_id()) {}
+
+  // Encodes |event| and returns its JSON, as AppendAsJSON() would output it.
+  std::string Encode(const TraceEvent& event) {
+    writer_.AppendEvent(event, &encoded_);
+    return ToJSON(event);
+  }
+
+  std::string Convert() {
+    std::string json;
+    EXPECT_TRUE(ConvertBinaryTraceToJSON(encoded_.data(), encoded_.size(),
+                                         &json));
+    return json;
+  }
+
+  TraceEventBinaryWriter writer_;
+  std::string encoded_;
+};
+
+TEST_F(TraceEventBinaryTest, ConvertToJSON) {
+  std::string expected;
+
+  const char* arg_names[] = { "int", "string" };
+  unsigned char arg_types[] = { TRACE_VALUE_TYPE_INT, TRACE_VALUE_TYPE_STRING };
+  unsigned long long arg_values[] = {
+    static_cast<unsigned long long>(-5),
+    reinterpret_cast<unsigned long long>("hello")
+  };
+  TraceEvent complete;
+  complete.Initialize(1234, TimeTicks::FromInternalValue(1000),
+                      TimeTicks::FromInternalValue(300),
+                      TRACE_EVENT_PHASE_COMPLETE,
+                      TraceLog::GetCategoryGroupEnabled("binary,test"),
+                      "complete", 0, 2, arg_names, arg_types, arg_values, NULL,
+                      TRACE_EVENT_FLAG_NONE);
+  complete.UpdateDuration(TimeTicks::FromInternalValue(1500),
+                          TimeTicks::FromInternalValue(320));
+  expected += Encode(complete);
+
+  // Earlier than the previous event, with copied strings and an id.
+  const char* instant_arg_names[] = { "bool", "double" };
+  unsigned char instant_arg_types[] = {
+    TRACE_VALUE_TYPE_BOOL, TRACE_VALUE_TYPE_DOUBLE
+  };
+  TraceEvent::TraceValue bool_value;
+  bool_value.as_uint = 0;
+  bool_value.as_bool = true;
+  TraceEvent::TraceValue double_value;
+  double_value.as_double = 0.25;
+  unsigned long long instant_arg_values[] = {
+    bool_value.as_uint, double_value.as_uint
+  };
+  TraceEvent instant;
+  instant.Initialize(42, TimeTicks::FromInternalValue(900), TimeTicks(),
+                     TRACE_EVENT_PHASE_INSTANT,
+                     TraceLog::GetCategoryGroupEnabled("binary,test"),
+                     "instant", 0x1234567890ull, 2, instant_arg_names,
+                     instant_arg_types, instant_arg_values, NULL,
+                     TRACE_EVENT_FLAG_COPY | TRACE_EVENT_FLAG_HAS_ID |
+                         TRACE_EVENT_SCOPE_THREAD);
+  expected += "," + Encode(instant);
+
+  const char* begin_arg_names[] = { "uint", "pointer" };
+  unsigned char begin_arg_types[] = {
+    TRACE_VALUE_TYPE_UINT, TRACE_VALUE_TYPE_POINTER
+  };
+  unsigned long long begin_arg_values[] = {
+    1ull << 40, reinterpret_cast<unsigned long long>(&instant)
+  };
+  TraceEvent begin;
+  begin.Initialize(1234, TimeTicks::FromInternalValue(2000), TimeTicks(),
+                   TRACE_EVENT_PHASE_BEGIN,
+                   TraceLog::GetCategoryGroupEnabled("other"), "begin", 0, 2,
+                   begin_arg_names, begin_arg_types, begin_arg_values, NULL,
+                   TRACE_EVENT_FLAG_NONE);
+  expected += "," + Encode(begin);
+
+  const char* end_arg_names[] = { "convertable", "null" };
+  unsigned char end_arg_types[] = {
+    TRACE_VALUE_TYPE_CONVERTABLE, TRACE_VALUE_TYPE_STRING
+  };
+  unsigned long long end_arg_values[] = { 0, 0 };
+  scoped_refptr<ConvertableToTraceFormat> convertable_values[] = {
+    new TestConvertable, NULL
+  };
+  TraceEvent end;
+  end.Initialize(1234, TimeTicks::FromInternalValue(2001), TimeTicks(),
+                 TRACE_EVENT_PHASE_END,
+                 TraceLog::GetCategoryGroupEnabled("other"), "begin", 0, 2,
+                 end_arg_names, end_arg_types, end_arg_values,
+                 convertable_values, TRACE_EVENT_FLAG_NONE);
+  expected += "," + Encode(end);
+
+  EXPECT_EQ(expected, Convert());
+}
+
+TEST_F(TraceEventBinaryTest, InternStrings) {
+  TraceEvent event;
+  InitializeEvent(&event, 1000, 0, TRACE_EVENT_PHASE_BEGIN, "name", 0,
+                  TRACE_EVENT_FLAG_NONE);
+  Encode(event);
+  size_t first_size = encoded_.size();
+  InitializeEvent(&event, 1001, 0, TRACE_EVENT_PHASE_END, "name", 0,
+                  TRACE_EVENT_FLAG_NONE);
+  Encode(event);
+  // Only the event record: the tag, phase and flags, the category and name
+  // ids, the thread id and the timestamp delta, the thread timestamp and the
+  // number of arguments.
+  EXPECT_EQ(10u, encoded_.size() - first_size);
+
+  // Copied names are interned by their contents.
+  std::string copied_name("name");
+  InitializeEvent(&event, 1002, 0, TRACE_EVENT_PHASE_BEGIN,
+                  copied_name.c_str(), 0, TRACE_EVENT_FLAG_COPY);
+  Encode(event);
+  std::string same_name(copied_name);
+  InitializeEvent(&event, 1003, 0, TRACE_EVENT_PHASE_END, same_name.c_str(),
+                  0, TRACE_EVENT_FLAG_COPY);
+  size_t size = encoded_.size();
+  Encode(event);
+  EXPECT_EQ(10u, encoded_.size() - size);
+  same_name[0] = 'g';
+  InitializeEvent(&event, 1004, 0, TRACE_EVENT_PHASE_BEGIN, same_name.c_str(),
+                  0, TRACE_EVENT_FLAG_COPY);
+  size = encoded_.size();
+  std::string expected = Encode(event);
+  EXPECT_LT(10u, encoded_.size() - size);
+
+  std::string json = Convert();
+  EXPECT_EQ(expected, json.substr(json.size() - expected.size()));
+}
+
+TEST_F(TraceEventBinaryTest, UnfinishedCompleteEvent) {
+  TraceEvent complete;
+  InitializeEvent(&complete, 1000, 0, TRACE_EVENT_PHASE_COMPLETE, "complete",
+                  0, TRACE_EVENT_FLAG_NONE);
+  Encode(complete);
+
+  TraceEvent begin;
+  InitializeEvent(&begin, 1000, 0, TRACE_EVENT_PHASE_BEGIN, "complete", 0,
+                  TRACE_EVENT_FLAG_NONE);
+  EXPECT_EQ(ToJSON(begin), Convert());
+}
+
+TEST_F(TraceEventBinaryTest, Truncated) {
+  TraceEvent event;
+  InitializeEvent(&event, 1000, 0, TRACE_EVENT_PHASE_BEGIN, "first", 0,
+                  TRACE_EVENT_FLAG_NONE);
+  std::string expected = Encode(event);
+  size_t first_size = encoded_.size();
+  InitializeEvent(&event, 1001, 0, TRACE_EVENT_PHASE_END, "first", 0,
+                  TRACE_EVENT_FLAG_NONE);
+  Encode(event);
+
+  for (size_t size = first_size + 1; size < encoded_.size(); ++size) {
+    std::string json;
+    EXPECT_FALSE(ConvertBinaryTraceToJSON(encoded_.data(), size, &json));
+    EXPECT_EQ(expected, json);
+  }
+
+  std::string json;
+  EXPECT_FALSE(ConvertBinaryTraceToJSON("TRCB", 4, &json));
+  EXPECT_FALSE(ConvertBinaryTraceToJSON("{\"cat\"", 6, &json));
+  EXPECT_TRUE(json.empty());
+}
+
+}  // namespace debug
+}  // namespace base
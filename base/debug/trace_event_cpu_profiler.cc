@@ -0,0 +1,325 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/debug/trace_event_cpu_profiler.h"
+
+#include <vector>
+
+#include "base/atomicops.h"
+#include "base/debug/trace_event.h"
+#include "base/format_macros.h"
+#include "base/logging.h"
+#include "base/strings/stringprintf.h"
+#include "base/synchronization/cancellation_flag.h"
+
+#if defined(TRACE_CPU_PROFILER_SUPPORTED)
+#include <errno.h>
+#include <execinfo.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "base/debug/leak_annotations.h"
+#endif
+
+namespace base {
+namespace debug {
+
+namespace {
+
+#if defined(TRACE_CPU_PROFILER_SUPPORTED)
+
+// The frames of the signal handler and of the signal trampoline, which start
+// every sample.
+const int kSkippedFrames = 2;
+const int kMaxFrames = 32 + kSkippedFrames;
+
+// The number of samples the ring holds until they are written to the trace.
+const size_t kRingSize = 1024;
+
+// How often the samples are written to the trace.
+const int kWriteIntervalMilliseconds = 20;
+
+// How many milliseconds StopProfiling() waits at most for a pending SIGPROF.
+const int kMaxPendingSigprofWaits = 10;
+
+// The states of a slot of the ring.
+const subtle::Atomic32 kSlotEmpty = 0;
+const subtle::Atomic32 kSlotWriting = 1;
+const subtle::Atomic32 kSlotReady = 2;
+
+struct Sample {
+  subtle::Atomic32 state;
+  int thread_id;
+  int frame_count;
+  int64 timestamp;
+  void* frames[kMaxFrames];
+};
+
+struct SampleRing {
+  Sample samples[kRingSize];
+  // Where the next signal looks for an empty slot; it drops its sample if
+  // that slot hasn't been written to the trace yet.
+  subtle::Atomic32 next_slot;
+  subtle::Atomic32 dropped_count;
+};
+
+// Allocated the first time a profiler starts, and never freed, as a handler
+// interrupted before profiling stopped may still write to it.
+SampleRing* g_sample_ring = NULL;
+
+// Set by the profiler running, which owns the SIGPROF handler.
+subtle::Atomic32 g_profiler_running = 0;
+
+// Set while the signal handler takes samples.
+subtle::Atomic32 g_sampling = 0;
+
+struct sigaction g_old_sigprof_action;
+
+// Only calls async-signal-safe functions, and backtrace(), which
+// StartProfiling() calls first so that it doesn't allocate here.
+void OnSigprof(int signal, siginfo_t* info, void* context) {
+  if (!subtle::Acquire_Load(&g_sampling))
+    return;
+  int saved_errno = errno;
+  SampleRing* ring = g_sample_ring;
+  uint32 slot = static_cast<uint32>(
+      subtle::NoBarrier_AtomicIncrement(&ring->next_slot, 1));
+  Sample* sample = &ring->samples[slot % kRingSize];
+  if (subtle::Acquire_CompareAndSwap(&sample->state, kSlotEmpty,
+                                     kSlotWriting) != kSlotEmpty) {
+    subtle::NoBarrier_AtomicIncrement(&ring->dropped_count, 1);
+  } else {
+    sample->thread_id = static_cast<int>(PlatformThread::CurrentId());
+    sample->timestamp = TimeTicks::NowFromSystemTraceTime().ToInternalValue();
+    sample->frame_count = backtrace(sample->frames, kMaxFrames);
+    subtle::Release_Store(&sample->state, kSlotReady);
+  }
+  errno = saved_errno;
+}
+
+// Gives a SIGPROF generated before the timer was stopped a chance to be
+// delivered to OnSigprof(), rather than to the disposition restored after it.
+void WaitForPendingSigprof() {
+  for (int i = 0; i < kMaxPendingSigprofWaits; ++i) {
+    sigset_t pending;
+    if (sigpending(&pending) != 0 || !sigismember(&pending, SIGPROF))
+      return;
+    PlatformThread::Sleep(TimeDelta::FromMilliseconds(1));
+  }
+}
+
+bool SetProfilingTimer(TimeDelta interval) {
+  struct itimerval timer;
+  timer.it_interval.tv_sec = interval.InSeconds();
+  timer.it_interval.tv_usec =
+      (interval - TimeDelta::FromSeconds(timer.it_interval.tv_sec))
+          .InMicroseconds();
+  timer.it_value = timer.it_interval;
+  return setitimer(ITIMER_PROF, &timer, NULL) == 0;
+}
+
+#endif  // defined(TRACE_CPU_PROFILER_SUPPORTED)
+
+// Holds the frames of a sample until the trace is serialized.
+class StackFrames : public ConvertableToTraceFormat {
+ public:
+  StackFrames(void* const* frames, size_t count)
+      : frames_(frames, frames + count) {}
+
+  // ConvertableToTraceFormat implementation:
+  virtual void AppendAsTraceFormat(std::string* out) const OVERRIDE {
+    out->append("[");
+    for (size_t i = 0; i < frames_.size(); ++i) {
+      if (i > 0)
+        out->append(",");
+      StringAppendF(out, "\"0x%" PRIx64 "\"",
+                    static_cast<uint64>(reinterpret_cast<uintptr_t>(
+                        frames_[i])));
+    }
+    out->append("]");
+  }
+
+ private:
+  virtual ~StackFrames() {}
+
+  std::vector<void*> frames_;
+
+  DISALLOW_COPY_AND_ASSIGN(StackFrames);
+};
+
+}  // namespace
+
+// Writes the samples in the ring to the trace, every
+// kWriteIntervalMilliseconds until it is stopped.
+class TraceCpuProfiler::SampleWriter : public PlatformThread::Delegate {
+ public:
+  SampleWriter()
+      : category_group_enabled_(
+            TraceLog::GetCategoryGroupEnabled(TRACE_CPU_PROFILER_CATEGORY)) {}
+  virtual ~SampleWriter() {}
+
+  // PlatformThread::Delegate implementation:
+  virtual void ThreadMain() OVERRIDE {
+    PlatformThread::SetName("CpuProfilerThread");
+#if defined(TRACE_CPU_PROFILER_SUPPORTED)
+    while (!cancellation_flag_.IsSet()) {
+      PlatformThread::Sleep(
+          TimeDelta::FromMilliseconds(kWriteIntervalMilliseconds));
+      WriteSamples();
+    }
+#endif
+  }
+
+  void Stop() { cancellation_flag_.Set(); }
+
+  void WriteSamples() {
+#if defined(TRACE_CPU_PROFILER_SUPPORTED)
+    const char* arg_names[] = { "frames" };
+    static const unsigned char kArgTypes[] = { TRACE_VALUE_TYPE_CONVERTABLE };
+    static const unsigned long long kArgValues[] = { 0 };
+    for (size_t i = 0; i < kRingSize; ++i) {
+      Sample* sample = &g_sample_ring->samples[i];
+      if (subtle::Acquire_Load(&sample->state) != kSlotReady)
+        continue;
+      int frame_count = sample->frame_count - kSkippedFrames;
+      scoped_refptr<ConvertableToTraceFormat> frames[] = {
+        new StackFrames(sample->frames + kSkippedFrames,
+                        frame_count > 0 ? frame_count : 0)
+      };
+      int thread_id = sample->thread_id;
+      TimeTicks timestamp = TimeTicks::FromInternalValue(sample->timestamp);
+      subtle::Release_Store(&sample->state, kSlotEmpty);
+
+      TRACE_EVENT_API_ADD_TRACE_EVENT_WITH_THREAD_ID_AND_TIMESTAMP(
+          TRACE_EVENT_PHASE_SAMPLE, category_group_enabled_, "CpuSample",
+          trace_event_internal::kNoEventId, thread_id, timestamp, 1,
+          arg_names, kArgTypes, kArgValues, frames, TRACE_EVENT_FLAG_NONE);
+    }
+#endif
+  }
+
+ private:
+  const unsigned char* category_group_enabled_;
+  CancellationFlag cancellation_flag_;
+
+  DISALLOW_COPY_AND_ASSIGN(SampleWriter);
+};
+
+TraceCpuProfiler::TraceCpuProfiler(TimeDelta sampling_interval)
+    : sampling_interval_(sampling_interval) {
+  // Make the category show up in the trace viewer.
+  TRACE_EVENT0(TRACE_CPU_PROFILER_CATEGORY, "init");
+  TraceLog::GetInstance()->AddEnabledStateObserver(this);
+}
+
+TraceCpuProfiler::~TraceCpuProfiler() {
+  StopProfiling();
+  TraceLog::GetInstance()->RemoveEnabledStateObserver(this);
+}
+
+void TraceCpuProfiler::OnTraceLogEnabled() {
+  bool enabled;
+  TRACE_EVENT_CATEGORY_GROUP_ENABLED(TRACE_CPU_PROFILER_CATEGORY, &enabled);
+  if (enabled)
+    StartProfiling();
+}
+
+void TraceCpuProfiler::OnTraceLogWillDisable() {
+  // Stop while the category still records, so that the samples taken since
+  // the last write make it to the trace. StopProfiling() does nothing if the
+  // category wasn't enabled.
+  StopProfiling();
+}
+
+void TraceCpuProfiler::OnTraceLogDisabled() {
+}
+
+bool TraceCpuProfiler::StartProfiling() {
+#if defined(TRACE_CPU_PROFILER_SUPPORTED)
+  AutoLock lock(lock_);
+  if (sample_writer_)
+    return true;
+  if (subtle::Acquire_CompareAndSwap(&g_profiler_running, 0, 1) != 0) {
+    DLOG(ERROR) << "Another CPU profiler is running";
+    return false;
+  }
+
+  if (!g_sample_ring) {
+    g_sample_ring = new SampleRing();
+    ANNOTATE_LEAKING_OBJECT_PTR(g_sample_ring);
+  }
+  subtle::NoBarrier_Store(&g_sample_ring->dropped_count, 0);
+
+  // The first call of backtrace() loads the unwinder, which allocates.
+  void* frames[kMaxFrames];
+  backtrace(frames, kMaxFrames);
+
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  action.sa_sigaction = &OnSigprof;
+  action.sa_flags = SA_RESTART | SA_SIGINFO;
+  sigemptyset(&action.sa_mask);
+  if (sigaction(SIGPROF, &action, &g_old_sigprof_action) != 0) {
+    DPLOG(ERROR) << "sigaction";
+    subtle::Release_Store(&g_profiler_running, 0);
+    return false;
+  }
+
+  scoped_ptr<SampleWriter> sample_writer(new SampleWriter);
+  if (!PlatformThread::Create(0, sample_writer.get(),
+                              &sample_writer_handle_)) {
+    DLOG(ERROR) << "Failed to create the CPU profiler thread";
+    sigaction(SIGPROF, &g_old_sigprof_action, NULL);
+    subtle::Release_Store(&g_profiler_running, 0);
+    return false;
+  }
+  sample_writer_ = sample_writer.Pass();
+
+  subtle::Release_Store(&g_sampling, 1);
+  if (!SetProfilingTimer(sampling_interval_))
+    DPLOG(ERROR) << "setitimer";
+  return true;
+#else
+  return false;
+#endif
+}
+
+void TraceCpuProfiler::StopProfiling() {
+#if defined(TRACE_CPU_PROFILER_SUPPORTED)
+  AutoLock lock(lock_);
+  if (!sample_writer_)
+    return;
+
+  SetProfilingTimer(TimeDelta());
+  subtle::Release_Store(&g_sampling, 0);
+  // A signal still pending finds sampling stopped. The disposition found when
+  // profiling started, the default one included, is then restored as is.
+  WaitForPendingSigprof();
+  sigaction(SIGPROF, &g_old_sigprof_action, NULL);
+
+  sample_writer_->Stop();
+  PlatformThread::Join(sample_writer_handle_);
+  sample_writer_handle_ = PlatformThreadHandle();
+  sample_writer_->WriteSamples();
+  sample_writer_.reset();
+  subtle::Release_Store(&g_profiler_running, 0);
+#endif
+}
+
+bool TraceCpuProfiler::IsProfiling() const {
+  AutoLock lock(lock_);
+  return sample_writer_.get() != NULL;
+}
+
+int TraceCpuProfiler::GetDroppedSampleCount() const {
+#if defined(TRACE_CPU_PROFILER_SUPPORTED)
+  if (g_sample_ring)
+    return subtle::NoBarrier_Load(&g_sample_ring->dropped_count);
+#endif
+  return 0;
+}
+
+}  // namespace debug
+}  // namespace base
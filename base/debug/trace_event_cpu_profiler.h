@@ -0,0 +1,87 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef BASE_DEBUG_TRACE_EVENT_CPU_PROFILER_H_
+#define BASE_DEBUG_TRACE_EVENT_CPU_PROFILER_H_
+
+#include <string>
+
+#include "base/base_export.h"
+#include "base/debug/trace_event_impl.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/synchronization/lock.h"
+#include "base/threading/platform_thread.h"
+#include "base/time/time.h"
+
+#if defined(OS_LINUX) && !defined(OS_NACL)
+#define TRACE_CPU_PROFILER_SUPPORTED 1
+#endif
+
+namespace base {
+namespace debug {
+
+// The category of the events of TraceCpuProfiler.
+#define TRACE_CPU_PROFILER_CATEGORY TRACE_DISABLED_BY_DEFAULT("cpu_profiler")
+
+// Watches for tracing to be enabled with TRACE_CPU_PROFILER_CATEGORY, and
+// samples the stacks of the threads using CPU while it is. Unlike the
+// external profilers of profiler.h, the samples end up in the trace, as
+// TRACE_EVENT_PHASE_SAMPLE events on the thread that was sampled, so that
+// where CPU time goes can be seen next to the TRACE_EVENT spans of the time.
+//
+// A SIGPROF timer interrupts the process every |sampling_interval| of CPU
+// time it uses; the signal handler records the stack of the interrupted
+// thread into a preallocated ring without locking or allocating, and a
+// thread of the profiler turns what is in the ring into trace events. The
+// frames of a sample are the instruction pointers of the stack, for
+// symbolizing offline against the binaries of the process.
+//
+// There can only be one profiler running in a process at a time, and the
+// SIGPROF handler of another profiler is replaced while it runs, then
+// restored. Only supported where TRACE_CPU_PROFILER_SUPPORTED is defined;
+// elsewhere the profiler never starts.
+class BASE_EXPORT TraceCpuProfiler : public TraceLog::EnabledStateObserver {
+ public:
+  // The default interval between samples, in CPU time.
+  static const int kDefaultSamplingIntervalMicroseconds = 10000;
+
+  explicit TraceCpuProfiler(TimeDelta sampling_interval);
+  virtual ~TraceCpuProfiler();
+
+  // TraceLog::EnabledStateObserver implementation:
+  virtual void OnTraceLogEnabled() OVERRIDE;
+  virtual void OnTraceLogWillDisable() OVERRIDE;
+  virtual void OnTraceLogDisabled() OVERRIDE;
+
+  // Starts sampling, if not already. Returns false if the profiler could not
+  // be started, or another one is running.
+  bool StartProfiling();
+
+  // Stops sampling, and adds the samples taken to the trace, if the category
+  // is still enabled.
+  void StopProfiling();
+
+  bool IsProfiling() const;
+
+  // The number of samples lost because the ring was full, or another was
+  // being written to the same slot, since StartProfiling().
+  int GetDroppedSampleCount() const;
+
+ private:
+  class SampleWriter;
+
+  const TimeDelta sampling_interval_;
+
+  // Protects |sample_writer_| and the state of the profiling timer.
+  mutable Lock lock_;
+  scoped_ptr<SampleWriter> sample_writer_;
+  PlatformThreadHandle sample_writer_handle_;
+
+  DISALLOW_COPY_AND_ASSIGN(TraceCpuProfiler);
+};
+
+}  // namespace debug
+}  // namespace base
+
+#endif  // BASE_DEBUG_TRACE_EVENT_CPU_PROFILER_H_
@@ -0,0 +1,172 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/debug/trace_event_cpu_profiler.h"
+
+#include <string>
+
+#include "base/bind.h"
+#include "base/debug/trace_event.h"
+#include "base/json/json_reader.h"
+#include "base/memory/ref_counted_memory.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/threading/platform_thread.h"
+#include "base/time/time.h"
+#include "base/values.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace base {
+namespace debug {
+
+#if defined(TRACE_CPU_PROFILER_SUPPORTED)
+
+namespace {
+
+void AppendTraceData(std::string* json,
+                     const scoped_refptr<RefCountedString>& events,
+                     bool has_more_events) {
+  if (!json->empty() && !events->data().empty())
+    json->append(",");
+  json->append(events->data());
+}
+
+// Keeps the thread busy for |duration| of wall time.
+int Spin(TimeDelta duration) {
+  int result = 0;
+  TimeTicks end = TimeTicks::Now() + duration;
+  while (TimeTicks::Now() < end) {
+    for (int i = 0; i < 10000; ++i)
+      result += i * i;
+  }
+  return result;
+}
+
+// Keeps the thread busy until it used |cpu_time| of CPU time, which is what
+// the profiler samples, or until |timeout| of wall time passed.
+int SpinForCpuTime(TimeDelta cpu_time, TimeDelta timeout) {
+  int result = 0;
+  TimeTicks cpu_end = TimeTicks::ThreadNow() + cpu_time;
+  TimeTicks end = TimeTicks::Now() + timeout;
+  while (TimeTicks::ThreadNow() < cpu_end && TimeTicks::Now() < end) {
+    for (int i = 0; i < 10000; ++i)
+      result += i * i;
+  }
+  return result;
+}
+
+// Gets the span of the TRACE_EVENT named |name| in |events|.
+void GetSpan(ListValue* events,
+             const std::string& name,
+             double* begin,
+             double* end) {
+  *begin = 0;
+  *end = 0;
+  for (size_t i = 0; i < events->GetSize(); ++i) {
+    DictionaryValue* event = NULL;
+    std::string event_name;
+    ASSERT_TRUE(events->GetDictionary(i, &event));
+    if (event->GetString("name", &event_name) && event_name == name) {
+      double duration = 0;
+      EXPECT_TRUE(event->GetDouble("ts", begin));
+      EXPECT_TRUE(event->GetDouble("dur", &duration));
+      *end = *begin + duration;
+    }
+  }
+}
+
+// Returns the number of samples of |thread_id| in |events| between |begin|
+// and |end|.
+int CountSamples(ListValue* events, int thread_id, double begin, double end) {
+  int num_samples = 0;
+  for (size_t i = 0; i < events->GetSize(); ++i) {
+    DictionaryValue* event = NULL;
+    std::string name;
+    std::string phase;
+    int tid = 0;
+    double ts = 0;
+    ListValue* frames = NULL;
+    events->GetDictionary(i, &event);
+    if (!event->GetString("name", &name) || name != "CpuSample")
+      continue;
+    EXPECT_TRUE(event->GetString("ph", &phase));
+    EXPECT_EQ("P", phase);
+    EXPECT_TRUE(event->GetList("args.frames", &frames));
+    EXPECT_TRUE(frames && frames->GetSize() > 0);
+    if (event->GetInteger("tid", &tid) && tid == thread_id &&
+        event->GetDouble("ts", &ts) && ts >= begin && ts <= end) {
+      ++num_samples;
+    }
+  }
+  return num_samples;
+}
+
+}  // namespace
+
+TEST(TraceCpuProfilerTest, SamplesInTrace) {
+  TraceCpuProfiler profiler(TimeDelta::FromMilliseconds(1));
+  EXPECT_FALSE(profiler.IsProfiling());
+
+  TraceLog::GetInstance()->SetEnabled(
+      CategoryFilter(std::string(TRACE_CPU_PROFILER_CATEGORY) + ",test"),
+      TraceLog::RECORDING_MODE, TraceOptions());
+  EXPECT_TRUE(profiler.IsProfiling());
+
+  // Another profiler can't run at the same time.
+  TraceCpuProfiler other_profiler(TimeDelta::FromMilliseconds(1));
+  EXPECT_FALSE(other_profiler.StartProfiling());
+
+  {
+    TRACE_EVENT0("test", "Spin");
+    Spin(TimeDelta::FromMilliseconds(300));
+  }
+  // The samples of the end of this one are only written when tracing is
+  // disabled. About 100 samples are taken in 100 ms of CPU time.
+  {
+    TRACE_EVENT0("test", "LastSpin");
+    SpinForCpuTime(TimeDelta::FromMilliseconds(100), TimeDelta::FromSeconds(5));
+  }
+  TraceLog::GetInstance()->SetDisabled();
+  EXPECT_FALSE(profiler.IsProfiling());
+
+  std::string json;
+  TraceLog::GetInstance()->Flush(Bind(&AppendTraceData, &json));
+  scoped_ptr<Value> root(JSONReader::Read("[" + json + "]"));
+  ListValue* events = NULL;
+  ASSERT_TRUE(root && root->GetAsList(&events));
+
+  int thread_id = static_cast<int>(PlatformThread::CurrentId());
+  double spin_begin = 0;
+  double spin_end = 0;
+  GetSpan(events, "Spin", &spin_begin, &spin_end);
+  ASSERT_LT(spin_begin, spin_end);
+
+  // The thread was sampled while it spun.
+  EXPECT_LT(0, CountSamples(events, thread_id, spin_begin, spin_end));
+
+  // Including right before tracing was disabled.
+  GetSpan(events, "LastSpin", &spin_begin, &spin_end);
+  ASSERT_LT(spin_begin, spin_end);
+  EXPECT_LE(10, CountSamples(events, thread_id, spin_begin, spin_end));
+}
+
+TEST(TraceCpuProfilerTest, OtherCategories) {
+  TraceCpuProfiler profiler(TimeDelta::FromMilliseconds(1));
+  TraceLog::GetInstance()->SetEnabled(CategoryFilter("*"),
+                                      TraceLog::RECORDING_MODE,
+                                      TraceOptions());
+  // The category is disabled by default.
+  EXPECT_FALSE(profiler.IsProfiling());
+  TraceLog::GetInstance()->SetDisabled();
+
+  // It can still be started directly.
+  EXPECT_TRUE(profiler.StartProfiling());
+  EXPECT_TRUE(profiler.IsProfiling());
+  profiler.StopProfiling();
+  EXPECT_FALSE(profiler.IsProfiling());
+}
+
+#endif  // defined(TRACE_CPU_PROFILER_SUPPORTED)
+
+}  // namespace debug
+}  // namespace base
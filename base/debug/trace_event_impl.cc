@@ -11,6 +11,7 @@
 #include "base/command_line.h"
 #include "base/debug/leak_annotations.h"
 #include "base/debug/trace_event.h"
+#include "base/debug/trace_event_binary.h"
 #include "base/debug/trace_event_synthetic_delay.h"
 #include "base/float_util.h"
 #include "base/format_macros.h"
@@ -1398,6 +1399,26 @@ void TraceLog::SetEnabled(const CategoryFilter& category_filter,
                           Mode mode,
                           const TraceOptions& options) {
   std::vector<EnabledStateObserver*> observer_list;
+
+  // The buffer of a streamed session opens its file and starts its thread, so
+  // it is created before taking lock_. The buffer it replaces is deleted once
+  // lock_ is released.
+  scoped_ptr<TraceBuffer> streaming_buffer;
+  FilePath streaming_file_path;
+  int process_id = 0;
+  {
+    AutoLock lock(lock_);
+    if (!IsEnabled()) {
+      streaming_file_path =
+          GetStreamingFilePathWhileLocked(num_traces_recorded_ + 1);
+      process_id = process_id_;
+    }
+  }
+  if (!streaming_file_path.empty()) {
+    streaming_buffer.reset(
+        new TraceBufferStreaming(streaming_file_path, process_id));
+  }
+
   {
     AutoLock lock(lock_);
 
@@ -1432,10 +1453,12 @@ void TraceLog::SetEnabled(const CategoryFilter& category_filter,
 
     mode_ = mode;
 
-    if (new_options != old_options) {
+    if (new_options != old_options)
       subtle::NoBarrier_Store(&trace_options_, new_options);
+    if (streaming_buffer)
+      SwapTraceBuffer(&streaming_buffer);
+    else if (new_options != old_options)
       UseNextTraceBuffer();
-    }
 
     num_traces_recorded_++;
 
@@ -1533,6 +1556,17 @@ void TraceLog::SetDisabledWhileLocked() {
     return;
   }
 
+  dispatching_to_observer_list_ = true;
+  std::vector<EnabledStateObserver*> observer_list =
+      enabled_state_observer_list_;
+  {
+    // Dispatch to observers outside the lock, as they add trace events.
+    AutoUnlock unlock(lock_);
+    for (size_t i = 0; i < observer_list.size(); ++i)
+      observer_list[i]->OnTraceLogWillDisable();
+  }
+  dispatching_to_observer_list_ = false;
+
   mode_ = DISABLED;
 
   if (sampling_thread_.get()) {
@@ -1552,8 +1586,7 @@ void TraceLog::SetDisabledWhileLocked() {
   AddMetadataEventsWhileLocked();
 
   dispatching_to_observer_list_ = true;
-  std::vector<EnabledStateObserver*> observer_list =
-      enabled_state_observer_list_;
+  observer_list = enabled_state_observer_list_;
 
   {
     // Dispatch to observers outside the lock in case the observer triggers a
@@ -1572,6 +1605,34 @@ int TraceLog::GetNumTracesRecorded() {
   return num_traces_recorded_;
 }
 
+void TraceLog::SetStreamingFilePath(const FilePath& path) {
+  // The buffer replaced may still be writing the file of the last session,
+  // which its deletion waits for; it is deleted once lock_ is released.
+  scoped_ptr<TraceBuffer> previous_logged_events;
+  {
+    AutoLock lock(lock_);
+    DCHECK(!IsEnabled());
+    if (path == streaming_file_path_)
+      return;
+    streaming_file_path_ = path;
+    previous_logged_events.reset(CreateTraceBuffer());
+    SwapTraceBuffer(&previous_logged_events);
+  }
+}
+
+FilePath TraceLog::GetStreamingFilePath(int session) {
+  AutoLock lock(lock_);
+  return GetStreamingFilePathWhileLocked(session);
+}
+
+FilePath TraceLog::GetStreamingFilePathWhileLocked(int session) const {
+  lock_.AssertAcquired();
+  if (streaming_file_path_.empty())
+    return FilePath();
+  return streaming_file_path_.InsertBeforeExtensionASCII(
+      StringPrintf(".%d", session));
+}
+
 void TraceLog::AddEnabledStateObserver(EnabledStateObserver* listener) {
   enabled_state_observer_list_.push_back(listener);
 }
@@ -1855,7 +1916,12 @@ void TraceLog::FlushButLeaveBufferIntact(
 }
 
 void TraceLog::UseNextTraceBuffer() {
-  logged_events_.reset(CreateTraceBuffer());
+  scoped_ptr<TraceBuffer> buffer(CreateTraceBuffer());
+  SwapTraceBuffer(&buffer);
+}
+
+void TraceLog::SwapTraceBuffer(scoped_ptr<TraceBuffer>* buffer) {
+  logged_events_.swap(*buffer);
   subtle::NoBarrier_AtomicIncrement(&generation_, 1);
   thread_shared_chunk_.reset();
   thread_shared_chunk_index_ = 0;
@@ -2135,6 +2201,17 @@ void TraceLog::UpdateTraceEventDuration(
 #if defined(OS_ANDROID)
       trace_event->SendToATrace();
 #endif
+    } else if (handle.chunk_seq && !streaming_file_path_.empty()) {
+      // The event was streamed out as a BEGIN event before its duration was
+      // known; end it. |lock_| is held, so use the shared chunk.
+      trace_event = AddEventToThreadSharedChunkWhileLocked(NULL, true);
+      if (trace_event) {
+        trace_event->Initialize(
+            static_cast<int>(PlatformThread::CurrentId()), now, thread_now,
+            TRACE_EVENT_PHASE_END, category_group_enabled, name,
+            trace_event_internal::kNoEventId, 0, NULL, NULL, NULL, NULL,
+            TRACE_EVENT_FLAG_COPY);
+      }
     }
 
     if (trace_options() & kInternalEchoToConsole) {
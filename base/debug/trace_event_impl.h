@@ -14,6 +14,7 @@
 #include "base/base_export.h"
 #include "base/callback.h"
 #include "base/containers/hash_tables.h"
+#include "base/files/file_path.h"
 #include "base/gtest_prod_util.h"
 #include "base/memory/ref_counted_memory.h"
 #include "base/memory/scoped_vector.h"
@@ -184,6 +185,8 @@ class BASE_EXPORT TraceEvent {
   unsigned char flags_;
   unsigned char arg_types_[kTraceMaxNumArgs];
 
+  friend class TraceEventBinaryWriter;
+
   DISALLOW_COPY_AND_ASSIGN(TraceEvent);
 };
 
@@ -478,6 +481,21 @@ class BASE_EXPORT TraceLog {
 
   bool IsEnabled() { return mode_ != DISABLED; }
 
+  // Sets the path of the files that the events of the following recording
+  // sessions are written to as they are collected, in the format of
+  // trace_event_binary.h, instead of being kept in memory for Flush(). Each
+  // session has a file of its own, see GetStreamingFilePath(), which is
+  // opened when the session is enabled. Flush() then outputs no events, and
+  // returns once the file is complete. An empty |path| goes back to keeping
+  // the events in memory. Must be called while tracing is disabled.
+  void SetStreamingFilePath(const FilePath& path);
+
+  // Returns the file that the events of the recording session |session| are
+  // written to, |session| being what GetNumTracesRecorded() returns during
+  // it: the path given to SetStreamingFilePath(), with ".<session>" inserted
+  // before its extension. Returns an empty path if events are kept in memory.
+  FilePath GetStreamingFilePath(int session);
+
   // The number of times we have begun recording traces. If tracing is off,
   // returns -1. If tracing is on, then it returns the number of times we have
   // recorded a trace. By watching for this number to increment, you can
@@ -500,6 +518,11 @@ class BASE_EXPORT TraceLog {
     // |lock_|. TraceLog::IsEnabled() is true at this point.
     virtual void OnTraceLogEnabled() = 0;
 
+    // Called just before the tracing system disables, outside of the
+    // |lock_|. TraceLog::IsEnabled() is still true, and the enabled
+    // categories still record, so this is the time to add pending events.
+    virtual void OnTraceLogWillDisable() {}
+
     // Called just after the tracing system disables, outside of the |lock_|.
     // TraceLog::IsEnabled() is false at this point.
     virtual void OnTraceLogDisabled() = 0;
@@ -700,6 +723,7 @@ class BASE_EXPORT TraceLog {
 
   TraceBuffer* trace_buffer() const { return logged_events_.get(); }
   TraceBuffer* CreateTraceBuffer();
+  FilePath GetStreamingFilePathWhileLocked(int session) const;
   TraceBuffer* CreateTraceBufferVectorOfSize(size_t max_chunks);
 
   std::string EventToConsoleMessage(unsigned char phase,
@@ -729,6 +753,9 @@ class BASE_EXPORT TraceLog {
     return generation == this->generation();
   }
   void UseNextTraceBuffer();
+  // Makes |buffer| the buffer of the events, and returns the previous one in
+  // it.
+  void SwapTraceBuffer(scoped_ptr<TraceBuffer>* buffer);
 
   TimeTicks OffsetNow() const {
     return OffsetTimestamp(TimeTicks::NowFromSystemTraceTime());
@@ -756,6 +783,7 @@ class BASE_EXPORT TraceLog {
   Mode mode_;
   int num_traces_recorded_;
   scoped_ptr<TraceBuffer> logged_events_;
+  FilePath streaming_file_path_;
   subtle::AtomicWord /* EventCallback */ event_callback_;
   bool dispatching_to_observer_list_;
   std::vector<EnabledStateObserver*> enabled_state_observer_list_;
@@ -6,12 +6,14 @@
 
 #include "base/debug/leak_annotations.h"
 #include "base/debug/trace_event.h"
+#include "base/format_macros.h"
 #include "base/lazy_instance.h"
 #include "base/logging.h"
 #include "base/memory/scoped_ptr.h"
 #include "base/message_loop/message_loop.h"
 #include "base/strings/string_number_conversions.h"
 #include "base/strings/string_util.h"
+#include "base/strings/stringprintf.h"
 #include "base/threading/thread_local_storage.h"
 
 namespace base {
@@ -45,6 +47,41 @@ class MemoryDumpHolder : public base::debug::ConvertableToTraceFormat {
   DISALLOW_COPY_AND_ASSIGN(MemoryDumpHolder);
 };
 
+/////////////////////////////////////////////////////////////////////////////
+// Holds a profile of the SamplingHeapProfiler until the tracing system needs
+// to serialize it.
+class SampledHeapProfileHolder : public base::debug::ConvertableToTraceFormat {
+ public:
+  SampledHeapProfileHolder() {}
+
+  std::vector<SamplingHeapProfiler::StackTotals>* profile() {
+    return &profile_;
+  }
+
+  // base::debug::ConvertableToTraceFormat overrides:
+  virtual void AppendAsTraceFormat(std::string* out) const OVERRIDE {
+    AppendSampledHeapProfileAsTraceFormat(profile_, out);
+  }
+
+ private:
+  virtual ~SampledHeapProfileHolder() {}
+
+  std::vector<SamplingHeapProfiler::StackTotals> profile_;
+
+  DISALLOW_COPY_AND_ASSIGN(SampledHeapProfileHolder);
+};
+
+void AppendStackTotalsAsTraceFormat(size_t live_count,
+                                    size_t live_bytes,
+                                    size_t total_count,
+                                    size_t total_bytes,
+                                    std::string* output) {
+  StringAppendF(output,
+                "{\"current_allocs\": %" PRIuS ", \"current_bytes\": %" PRIuS
+                ", \"total_allocs\": %" PRIuS ", \"total_bytes\": %" PRIuS,
+                live_count, live_bytes, total_count, total_bytes);
+}
+
 /////////////////////////////////////////////////////////////////////////////
 // Records a stack of TRACE_MEMORY events. One per thread is required.
 struct TraceMemoryStack {
@@ -243,6 +280,88 @@ bool TraceMemoryController::IsTimerRunningForTest() const {
 
 /////////////////////////////////////////////////////////////////////////////
 
+TraceSampledHeapController::TraceSampledHeapController(
+    scoped_refptr<MessageLoopProxy> message_loop_proxy)
+    : message_loop_proxy_(message_loop_proxy),
+      weak_factory_(this) {
+  // Force the category to show up in the trace viewer.
+  TRACE_EVENT0(TRACE_SAMPLED_HEAP_CATEGORY, "init");
+  TraceLog::GetInstance()->AddEnabledStateObserver(this);
+}
+
+TraceSampledHeapController::~TraceSampledHeapController() {
+  if (dump_timer_.IsRunning())
+    StopProfiling();
+  TraceLog::GetInstance()->RemoveEnabledStateObserver(this);
+}
+
+void TraceSampledHeapController::OnTraceLogEnabled() {
+  bool enabled;
+  TRACE_EVENT_CATEGORY_GROUP_ENABLED(TRACE_SAMPLED_HEAP_CATEGORY, &enabled);
+  if (!enabled)
+    return;
+  message_loop_proxy_->PostTask(
+      FROM_HERE,
+      base::Bind(&TraceSampledHeapController::StartProfiling,
+                 weak_factory_.GetWeakPtr()));
+}
+
+void TraceSampledHeapController::OnTraceLogWillDisable() {
+  bool enabled;
+  TRACE_EVENT_CATEGORY_GROUP_ENABLED(TRACE_SAMPLED_HEAP_CATEGORY, &enabled);
+  if (!enabled)
+    return;
+  // Add the last profile while the category still records. GetProfile() is
+  // safe to call from any thread; only the timer belongs to the primary one.
+  DumpProfile();
+  message_loop_proxy_->PostTask(
+      FROM_HERE,
+      base::Bind(&TraceSampledHeapController::StopProfiling,
+                 weak_factory_.GetWeakPtr()));
+}
+
+void TraceSampledHeapController::OnTraceLogDisabled() {
+}
+
+void TraceSampledHeapController::StartProfiling() {
+  if (dump_timer_.IsRunning())
+    return;
+  SamplingHeapProfiler* profiler = SamplingHeapProfiler::GetInstance();
+  if (profiler->IsRunning())
+    return;
+  profiler->Clear();
+  if (!profiler->Start(SamplingHeapProfiler::kDefaultSamplingIntervalBytes)) {
+    DLOG(WARNING) << "The allocator has no hooks for the heap profiler";
+    profiler->Stop();
+    return;
+  }
+  const int kDumpIntervalSeconds = 5;
+  dump_timer_.Start(FROM_HERE,
+                    TimeDelta::FromSeconds(kDumpIntervalSeconds),
+                    base::Bind(&TraceSampledHeapController::DumpProfile,
+                               weak_factory_.GetWeakPtr()));
+}
+
+void TraceSampledHeapController::DumpProfile() {
+  scoped_refptr<SampledHeapProfileHolder> holder(new SampledHeapProfileHolder);
+  SamplingHeapProfiler::GetInstance()->GetProfile(holder->profile());
+  const int kSnapshotId = 1;
+  TRACE_EVENT_OBJECT_SNAPSHOT_WITH_ID(
+      TRACE_SAMPLED_HEAP_CATEGORY,
+      "memory::SampledHeap",
+      kSnapshotId,
+      scoped_refptr<ConvertableToTraceFormat>(holder));
+}
+
+void TraceSampledHeapController::StopProfiling() {
+  if (!dump_timer_.IsRunning())
+    return;
+  dump_timer_.Stop();
+  SamplingHeapProfiler::GetInstance()->Stop();
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
 // static
 bool ScopedTraceMemory::enabled_ = false;
 
@@ -426,6 +545,44 @@ bool AppendHeapProfileLineAsTraceFormat(const std::string& line,
   return true;
 }
 
+void AppendSampledHeapProfileAsTraceFormat(
+    const std::vector<SamplingHeapProfiler::StackTotals>& profile,
+    std::string* output) {
+  size_t live_count = 0;
+  size_t live_bytes = 0;
+  size_t total_count = 0;
+  size_t total_bytes = 0;
+  for (size_t i = 0; i < profile.size(); ++i) {
+    live_count += profile[i].live_count;
+    live_bytes += profile[i].live_bytes;
+    total_count += profile[i].total_count;
+    total_bytes += profile[i].total_bytes;
+  }
+  output->append("[");
+  AppendStackTotalsAsTraceFormat(live_count, live_bytes, total_count,
+                                 total_bytes, output);
+  output->append(", \"trace\": \"\"}");
+
+  for (size_t i = 0; i < profile.size(); ++i) {
+    const SamplingHeapProfiler::StackTotals& totals = profile[i];
+    output->append(",\n");
+    AppendStackTotalsAsTraceFormat(totals.live_count, totals.live_bytes,
+                                   totals.total_count, totals.total_bytes,
+                                   output);
+    // Return addresses, for symbolizing offline.
+    output->append(", \"frames\": [");
+    for (size_t j = 0; j < totals.frames.size(); ++j) {
+      if (j > 0)
+        output->append(",");
+      StringAppendF(output, "\"0x%" PRIx64 "\"",
+                    static_cast<uint64>(reinterpret_cast<uintptr_t>(
+                        totals.frames[j])));
+    }
+    output->append("]}");
+  }
+  output->append("]\n");
+}
+
 const char* StringFromHexAddress(const std::string& hex_address) {
   uint64 address = 0;
   if (!base::HexStringToUInt64(hex_address, &address))
@@ -5,7 +5,11 @@
 #ifndef BASE_DEBUG_TRACE_EVENT_MEMORY_H_
 #define BASE_DEBUG_TRACE_EVENT_MEMORY_H_
 
+#include <string>
+#include <vector>
+
 #include "base/base_export.h"
+#include "base/debug/sampling_heap_profiler.h"
 #include "base/debug/trace_event_impl.h"
 #include "base/gtest_prod_util.h"
 #include "base/memory/ref_counted.h"
@@ -83,6 +87,53 @@ class BASE_EXPORT TraceMemoryController
 
 //////////////////////////////////////////////////////////////////////////////
 
+// The category of the snapshots of TraceSampledHeapController.
+#define TRACE_SAMPLED_HEAP_CATEGORY TRACE_DISABLED_BY_DEFAULT("sampled_heap")
+
+// Watches for tracing to be enabled with TRACE_SAMPLED_HEAP_CATEGORY. While it
+// is, runs the SamplingHeapProfiler and adds its profile to the trace as
+// "memory::SampledHeap" snapshots. Unlike TraceMemoryController, it doesn't
+// need tcmalloc's heap profiler, only an allocator with hooks, and the
+// allocations are attributed to the stacks that made them rather than to
+// TRACE_EVENT scopes.
+class BASE_EXPORT TraceSampledHeapController
+    : public TraceLog::EnabledStateObserver {
+ public:
+  // |message_loop_proxy| must be a proxy to the primary thread for the client
+  // process, e.g. the UI thread in a browser.
+  explicit TraceSampledHeapController(
+      scoped_refptr<MessageLoopProxy> message_loop_proxy);
+  virtual ~TraceSampledHeapController();
+
+  // base::debug::TraceLog::EnabledStateChangedObserver overrides:
+  virtual void OnTraceLogEnabled() OVERRIDE;
+  virtual void OnTraceLogWillDisable() OVERRIDE;
+  virtual void OnTraceLogDisabled() OVERRIDE;
+
+  // Starts the sampling heap profiler.
+  void StartProfiling();
+
+  // Adds the profile so far to the trace.
+  void DumpProfile();
+
+  // Stops the profiler. The last profile is added by OnTraceLogWillDisable(),
+  // while the category is still enabled.
+  void StopProfiling();
+
+ private:
+  // Ensures the observer starts and stops profiling on the primary thread.
+  scoped_refptr<MessageLoopProxy> message_loop_proxy_;
+
+  // Timer to schedule profile dumps.
+  RepeatingTimer<TraceSampledHeapController> dump_timer_;
+
+  WeakPtrFactory<TraceSampledHeapController> weak_factory_;
+
+  DISALLOW_COPY_AND_ASSIGN(TraceSampledHeapController);
+};
+
+//////////////////////////////////////////////////////////////////////////////
+
 // A scoped context for memory tracing. Pushes the name onto a stack for
 // recording by tcmalloc heap profiling.
 class BASE_EXPORT ScopedTraceMemory {
@@ -141,6 +192,13 @@ BASE_EXPORT void AppendHeapProfileTotalsAsTraceFormat(const std::string& line,
 BASE_EXPORT bool AppendHeapProfileLineAsTraceFormat(const std::string& line,
                                                     std::string* output);
 
+// Converts the profile of the SamplingHeapProfiler to trace event compatible
+// JSON, the totals of all stacks first, then those of each stack, and appends
+// to |output|. Visible for testing.
+BASE_EXPORT void AppendSampledHeapProfileAsTraceFormat(
+    const std::vector<SamplingHeapProfiler::StackTotals>& profile,
+    std::string* output);
+
 // Returns a pointer to a string given its hexadecimal address in |hex_address|.
 // Handles both 32-bit and 64-bit addresses. Returns "null" for null pointers
 // and "error" if |address| could not be parsed. Visible for testing.
@@ -7,7 +7,11 @@
 #include <sstream>
 #include <string>
 
+#include "base/bind.h"
+#include "base/debug/sampling_heap_profiler.h"
+#include "base/debug/trace_event.h"
 #include "base/debug/trace_event_impl.h"
+#include "base/memory/ref_counted_memory.h"
 #include "base/message_loop/message_loop.h"
 #include "testing/gtest/include/gtest/gtest.h"
 
@@ -118,6 +122,65 @@ TEST_F(TraceMemoryTest, DeepScopeNesting) {
 
 #endif  // defined(TRACE_MEMORY_SUPPORTED)
 
+TEST_F(TraceMemoryTest, TraceSampledHeapController) {
+  MessageLoop message_loop;
+  SamplingHeapProfiler* profiler = SamplingHeapProfiler::GetInstance();
+
+  // Creating a controller adds it to the TraceLog observer list.
+  size_t observer_count = TraceLog::GetInstance()->GetObserverCountForTest();
+  scoped_ptr<TraceSampledHeapController> controller(
+      new TraceSampledHeapController(message_loop.message_loop_proxy()));
+  EXPECT_EQ(observer_count + 1,
+            TraceLog::GetInstance()->GetObserverCountForTest());
+  EXPECT_TRUE(
+      TraceLog::GetInstance()->HasEnabledStateObserver(controller.get()));
+
+  // The profiler runs at most while the controller does; not at all if the
+  // allocator has no hooks.
+  EXPECT_FALSE(profiler->IsRunning());
+  controller->StartProfiling();
+  controller->DumpProfile();
+  controller->StopProfiling();
+  EXPECT_FALSE(profiler->IsRunning());
+
+  // Deleting the controller removes it from the TraceLog observer list.
+  controller.reset();
+  EXPECT_EQ(observer_count,
+            TraceLog::GetInstance()->GetObserverCountForTest());
+  profiler->Clear();
+}
+
+namespace {
+
+void AppendTraceData(std::string* json,
+                     const scoped_refptr<RefCountedString>& events,
+                     bool has_more_events) {
+  json->append(events->data());
+}
+
+}  // namespace
+
+TEST_F(TraceMemoryTest, TraceSampledHeapControllerLastSnapshot) {
+  MessageLoop message_loop;
+  TraceSampledHeapController controller(message_loop.message_loop_proxy());
+
+  TraceLog::GetInstance()->SetEnabled(
+      CategoryFilter(TRACE_SAMPLED_HEAP_CATEGORY),
+      TraceLog::RECORDING_MODE, TraceOptions());
+  message_loop.RunUntilIdle();
+
+  // Disabled well before the first timed snapshot, so the only one in the
+  // trace is the last, taken while the category still records.
+  TraceLog::GetInstance()->SetDisabled();
+  message_loop.RunUntilIdle();
+  EXPECT_FALSE(SamplingHeapProfiler::GetInstance()->IsRunning());
+
+  std::string json;
+  TraceLog::GetInstance()->Flush(Bind(&AppendTraceData, &json));
+  EXPECT_NE(std::string::npos, json.find("\"memory::SampledHeap\""));
+  SamplingHeapProfiler::GetInstance()->Clear();
+}
+
 /////////////////////////////////////////////////////////////////////////////
 
 TEST_F(TraceMemoryTest, AppendHeapProfileTotalsAsTraceFormat) {
@@ -227,6 +290,38 @@ TEST_F(TraceMemoryTest, AppendHeapProfileAsTraceFormat) {
   EXPECT_EQ(kExpectedOutput, output);
 }
 
+TEST_F(TraceMemoryTest, AppendSampledHeapProfileAsTraceFormat) {
+  std::vector<SamplingHeapProfiler::StackTotals> profile;
+  std::string output;
+  AppendSampledHeapProfileAsTraceFormat(profile, &output);
+  EXPECT_EQ("[{\"current_allocs\": 0, \"current_bytes\": 0, "
+            "\"total_allocs\": 0, \"total_bytes\": 0, \"trace\": \"\"}]\n",
+            output);
+
+  profile.resize(2);
+  profile[0].frames.push_back(reinterpret_cast<const void*>(0x1234));
+  profile[0].frames.push_back(reinterpret_cast<const void*>(0xabcd));
+  profile[0].live_count = 1;
+  profile[0].live_bytes = 16;
+  profile[0].total_count = 2;
+  profile[0].total_bytes = 32;
+  profile[1].frames.push_back(reinterpret_cast<const void*>(0x5678));
+  profile[1].total_count = 3;
+  profile[1].total_bytes = 300;
+  output.clear();
+  AppendSampledHeapProfileAsTraceFormat(profile, &output);
+  EXPECT_EQ("[{\"current_allocs\": 1, \"current_bytes\": 16, "
+            "\"total_allocs\": 5, \"total_bytes\": 332, \"trace\": \"\"},\n"
+            "{\"current_allocs\": 1, \"current_bytes\": 16, "
+            "\"total_allocs\": 2, \"total_bytes\": 32, "
+            "\"frames\": [\"0x1234\",\"0xabcd\"]},\n"
+            "{\"current_allocs\": 0, \"current_bytes\": 0, "
+            "\"total_allocs\": 3, \"total_bytes\": 300, "
+            "\"frames\": [\"0x5678\"]}]\n",
+            output);
+
+}
+
 TEST_F(TraceMemoryTest, StringFromHexAddress) {
   EXPECT_STREQ("null", StringFromHexAddress("0x0"));
   EXPECT_STREQ("error", StringFromHexAddress("not an address"));
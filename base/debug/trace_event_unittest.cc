@@ -10,7 +10,10 @@
 #include "base/bind.h"
 #include "base/command_line.h"
 #include "base/debug/trace_event.h"
+#include "base/debug/trace_event_binary.h"
 #include "base/debug/trace_event_synthetic_delay.h"
+#include "base/files/file_util.h"
+#include "base/files/scoped_temp_dir.h"
 #include "base/json/json_reader.h"
 #include "base/json/json_writer.h"
 #include "base/memory/ref_counted_memory.h"
@@ -1000,6 +1003,10 @@ class AfterStateChangeEnabledStateObserver
     EXPECT_TRUE(TraceLog::GetInstance()->IsEnabled());
   }
 
+  virtual void OnTraceLogWillDisable() OVERRIDE {
+    EXPECT_TRUE(TraceLog::GetInstance()->IsEnabled());
+  }
+
   virtual void OnTraceLogDisabled() OVERRIDE {
     EXPECT_FALSE(TraceLog::GetInstance()->IsEnabled());
   }
@@ -2602,6 +2609,74 @@ TEST_F(TraceEventTestFixture, TraceBufferRingBufferFullIteration) {
   TraceLog::GetInstance()->SetDisabled();
 }
 
+TEST_F(TraceEventTestFixture, TraceBufferStreaming) {
+  ScopedTempDir temp_dir;
+  ASSERT_TRUE(temp_dir.CreateUniqueTempDir());
+  FilePath path = temp_dir.path().AppendASCII("trace");
+  TraceLog::GetInstance()->SetStreamingFilePath(path);
+
+  // Enough events for the chunk of the first to be written before it ends.
+  const int kNumInstantEvents = static_cast<int>(
+      (TraceBufferStreaming::kRetainedChunks + 2) *
+      TraceBufferChunk::kTraceBufferChunkSize);
+  BeginTrace();
+  int session = TraceLog::GetInstance()->GetNumTracesRecorded();
+  FilePath session_path =
+      TraceLog::GetInstance()->GetStreamingFilePath(session);
+  EXPECT_EQ(temp_dir.path().AppendASCII("trace.1").value(),
+            session_path.value());
+  // The file is opened when the session starts.
+  EXPECT_TRUE(PathExists(session_path));
+  {
+    TRACE_EVENT0("all", "outer");
+    for (int i = 0; i < kNumInstantEvents; ++i)
+      TRACE_EVENT_INSTANT1("all", "inner", TRACE_EVENT_SCOPE_THREAD, "i", i);
+  }
+  {
+    TRACE_EVENT0("all", "last");
+  }
+  EndTraceAndFlush();
+
+  // Flush() outputs nothing; the events are in the file.
+  EXPECT_FALSE(FindNamePhase("inner", "I"));
+  std::string data;
+  ASSERT_TRUE(ReadFileToString(session_path, &data));
+  std::string json;
+  ASSERT_TRUE(ConvertBinaryTraceToJSON(data.data(), data.size(), &json));
+  scoped_ptr<Value> root(JSONReader::Read("[" + json + "]"));
+  ListValue* root_list = NULL;
+  ASSERT_TRUE(root && root->GetAsList(&root_list));
+  trace_parsed_.Swap(root_list);
+
+  int num_inner = 0;
+  int outer_begin = -1;
+  int outer_end = -1;
+  for (size_t i = 0; i < trace_parsed_.GetSize(); ++i) {
+    const DictionaryValue* event = NULL;
+    std::string name;
+    std::string phase;
+    ASSERT_TRUE(trace_parsed_.GetDictionary(i, &event));
+    event->GetString("name", &name);
+    event->GetString("ph", &phase);
+    if (name == "inner") {
+      int value = -1;
+      EXPECT_TRUE(event->GetInteger("args.i", &value));
+      EXPECT_EQ(num_inner++, value);
+    } else if (name == "outer" && phase == "B") {
+      outer_begin = static_cast<int>(i);
+    } else if (name == "outer" && phase == "E") {
+      outer_end = static_cast<int>(i);
+    }
+  }
+  EXPECT_EQ(kNumInstantEvents, num_inner);
+  // The event that ended after its chunk was written is a BEGIN/END pair.
+  EXPECT_LE(0, outer_begin);
+  EXPECT_LT(outer_begin, outer_end);
+  EXPECT_FALSE(FindNamePhase("outer", "X"));
+  // The one that ended in time is complete.
+  EXPECT_TRUE(FindNamePhase("last", "X"));
+}
+
 TEST_F(TraceEventTestFixture, TraceRecordAsMuchAsPossibleMode) {
   TraceLog::GetInstance()->SetEnabled(CategoryFilter("*"),
                                       TraceLog::RECORDING_MODE,
@@ -0,0 +1,138 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/files/important_file_commit_scheduler.h"
+
+#include <algorithm>
+
+#include "base/bind.h"
+#include "base/critical_closure.h"
+#include "base/logging.h"
+#include "base/sequenced_task_runner.h"
+
+namespace base {
+
+namespace {
+
+const int kDefaultCommitIntervalMs = 10000;
+
+}  // namespace
+
+ImportantFileCommitScheduler::ImportantFileCommitScheduler(
+    const scoped_refptr<SequencedTaskRunner>& task_runner)
+    : task_runner_(task_runner),
+      commit_interval_(TimeDelta::FromMilliseconds(kDefaultCommitIntervalMs)),
+      max_writes_per_commit_(0),
+      commit_count_(0),
+      sync_count_(0),
+      bytes_written_(0) {
+  DCHECK(task_runner_.get());
+}
+
+ImportantFileCommitScheduler::~ImportantFileCommitScheduler() {
+  DCHECK(CalledOnValidThread());
+  DCHECK(!HasPendingCommit());
+}
+
+bool ImportantFileCommitScheduler::HasPendingCommit() const {
+  DCHECK(CalledOnValidThread());
+  return !pending_writers_.empty();
+}
+
+void ImportantFileCommitScheduler::CommitNow() {
+  Commit(0);
+}
+
+void ImportantFileCommitScheduler::ScheduleCommit(ImportantFileWriter* writer) {
+  DCHECK(CalledOnValidThread());
+  if (!IsCommitScheduled(writer))
+    pending_writers_.push_back(writer);
+  if (!timer_.IsRunning()) {
+    timer_.Start(FROM_HERE, commit_interval_, this,
+                 &ImportantFileCommitScheduler::CommitScheduledWrites);
+  }
+}
+
+void ImportantFileCommitScheduler::CancelCommit(ImportantFileWriter* writer) {
+  DCHECK(CalledOnValidThread());
+  pending_writers_.erase(
+      std::remove(pending_writers_.begin(), pending_writers_.end(), writer),
+      pending_writers_.end());
+  if (pending_writers_.empty())
+    timer_.Stop();
+}
+
+bool ImportantFileCommitScheduler::IsCommitScheduled(
+    const ImportantFileWriter* writer) const {
+  DCHECK(CalledOnValidThread());
+  return std::find(pending_writers_.begin(), pending_writers_.end(), writer) !=
+         pending_writers_.end();
+}
+
+void ImportantFileCommitScheduler::CommitScheduledWrites() {
+  Commit(max_writes_per_commit_);
+}
+
+void ImportantFileCommitScheduler::Commit(size_t max_writes) {
+  DCHECK(CalledOnValidThread());
+  timer_.Stop();
+
+  size_t count = pending_writers_.size();
+  if (max_writes && max_writes < count)
+    count = max_writes;
+  std::vector<ImportantFileWriter*> writers(pending_writers_.begin(),
+                                            pending_writers_.begin() + count);
+  pending_writers_.erase(pending_writers_.begin(),
+                         pending_writers_.begin() + count);
+
+  // The serializers may schedule other writes, which go to the next commit.
+  Writes writes;
+  for (size_t i = 0; i < writers.size(); ++i) {
+    scoped_refptr<ImportantFileWriter::Write> write =
+        writers[i]->SerializeScheduledWrite();
+    if (write.get())
+      writes.push_back(write);
+  }
+
+  if (!pending_writers_.empty() && !timer_.IsRunning()) {
+    timer_.Start(FROM_HERE, commit_interval_, this,
+                 &ImportantFileCommitScheduler::CommitScheduledWrites);
+  }
+
+  if (writes.empty())
+    return;
+  ++commit_count_;
+  for (size_t i = 0; i < writes.size(); ++i) {
+    ++sync_count_;
+    bytes_written_ += writes[i]->data.size();
+  }
+
+  if (!task_runner_->PostTaskAndReply(
+          FROM_HERE,
+          MakeCriticalClosure(
+              Bind(&ImportantFileCommitScheduler::PerformWrites, writes)),
+          Bind(&ImportantFileCommitScheduler::DidPerformWrites, writes))) {
+    // Posting the task to background message loop is not expected
+    // to fail, but if it does, avoid losing data and just hit the disk
+    // on the current thread.
+    NOTREACHED();
+
+    PerformWrites(writes);
+    DidPerformWrites(writes);
+  }
+}
+
+// static
+void ImportantFileCommitScheduler::PerformWrites(const Writes& writes) {
+  for (size_t i = 0; i < writes.size(); ++i)
+    ImportantFileWriter::PerformWrite(writes[i].get());
+}
+
+// static
+void ImportantFileCommitScheduler::DidPerformWrites(const Writes& writes) {
+  for (size_t i = 0; i < writes.size(); ++i)
+    ImportantFileWriter::DidPerformWrite(writes[i].get());
+}
+
+}  // namespace base
@@ -0,0 +1,115 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef BASE_FILES_IMPORTANT_FILE_COMMIT_SCHEDULER_H_
+#define BASE_FILES_IMPORTANT_FILE_COMMIT_SCHEDULER_H_
+
+#include <vector>
+
+#include "base/base_export.h"
+#include "base/basictypes.h"
+#include "base/files/important_file_writer.h"
+#include "base/memory/ref_counted.h"
+#include "base/threading/non_thread_safe.h"
+#include "base/time/time.h"
+#include "base/timer/timer.h"
+
+namespace base {
+
+class SequencedTaskRunner;
+
+// Commits the writes scheduled by a number of ImportantFileWriters together:
+// each writer given to the scheduler on construction has its scheduled write
+// serialized when the scheduler commits, rather than after its own commit
+// interval, and the writes of a commit are done in one task on the task
+// runner of the scheduler. As each write syncs its file, a cap on the writes
+// of a commit and the commit interval bound how often the disk is synced,
+// however many writers there are: writes over the cap are deferred to the
+// next commit, in the order they were scheduled.
+//
+// Scheduling again a writer whose write is pending doesn't add a write, so
+// that the changes made between two commits are serialized once. A writer
+// whose data is unchanged since it last wrote it doesn't write it again.
+//
+// All methods must be called on the thread of the writers.
+class BASE_EXPORT ImportantFileCommitScheduler : public NonThreadSafe {
+ public:
+  // |task_runner| is where the file I/O of the writers is done.
+  explicit ImportantFileCommitScheduler(
+      const scoped_refptr<SequencedTaskRunner>& task_runner);
+
+  // The writers of the scheduler must be destroyed first.
+  ~ImportantFileCommitScheduler();
+
+  const scoped_refptr<SequencedTaskRunner>& task_runner() const {
+    return task_runner_;
+  }
+
+  // The time between a write being scheduled, or the writes of a commit
+  // being deferred, and the next commit.
+  TimeDelta commit_interval() const { return commit_interval_; }
+  void set_commit_interval(const TimeDelta& interval) {
+    commit_interval_ = interval;
+  }
+
+  // The most writes a commit does, or 0 if there is no cap.
+  size_t max_writes_per_commit() const { return max_writes_per_commit_; }
+  void set_max_writes_per_commit(size_t max_writes) {
+    max_writes_per_commit_ = max_writes;
+  }
+
+  // Returns true if a writer has a write scheduled which has not been
+  // committed yet.
+  bool HasPendingCommit() const;
+
+  // Commits all the scheduled writes now, whatever their number.
+  void CommitNow();
+
+  // The number of commits that wrote anything, of writes, each syncing a
+  // file, and of bytes written since the scheduler was created.
+  int commit_count() const { return commit_count_; }
+  int sync_count() const { return sync_count_; }
+  int64 bytes_written() const { return bytes_written_; }
+
+ private:
+  friend class ImportantFileWriter;
+
+  typedef std::vector<scoped_refptr<ImportantFileWriter::Write> > Writes;
+
+  // Called by |writer| to have its scheduled write committed, or not.
+  void ScheduleCommit(ImportantFileWriter* writer);
+  void CancelCommit(ImportantFileWriter* writer);
+  bool IsCommitScheduled(const ImportantFileWriter* writer) const;
+
+  // Commits up to |max_writes_per_commit_| writes.
+  void CommitScheduledWrites();
+
+  // Commits the first |max_writes| scheduled writes, or all of them if 0.
+  void Commit(size_t max_writes);
+
+  // Does |writes|; runs on the task runner.
+  static void PerformWrites(const Writes& writes);
+
+  // Lets the writers know the result of |writes|.
+  static void DidPerformWrites(const Writes& writes);
+
+  const scoped_refptr<SequencedTaskRunner> task_runner_;
+
+  // The writers with a write scheduled, in the order they were scheduled.
+  std::vector<ImportantFileWriter*> pending_writers_;
+
+  OneShotTimer<ImportantFileCommitScheduler> timer_;
+  TimeDelta commit_interval_;
+  size_t max_writes_per_commit_;
+
+  int commit_count_;
+  int sync_count_;
+  int64 bytes_written_;
+
+  DISALLOW_COPY_AND_ASSIGN(ImportantFileCommitScheduler);
+};
+
+}  // namespace base
+
+#endif  // BASE_FILES_IMPORTANT_FILE_COMMIT_SCHEDULER_H_
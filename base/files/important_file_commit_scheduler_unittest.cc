@@ -0,0 +1,197 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/files/important_file_commit_scheduler.h"
+
+#include <string>
+
+#include "base/files/file_path.h"
+#include "base/files/file_util.h"
+#include "base/files/important_file_writer.h"
+#include "base/files/scoped_temp_dir.h"
+#include "base/message_loop/message_loop.h"
+#include "base/run_loop.h"
+#include "base/time/time.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace base {
+
+namespace {
+
+std::string GetFileContent(const FilePath& path) {
+  std::string content;
+  if (!ReadFileToString(path, &content))
+    return std::string();
+  return content;
+}
+
+// Serializes |data|, counting the serializations.
+class CountingSerializer : public ImportantFileWriter::DataSerializer {
+ public:
+  CountingSerializer() : serialize_count_(0) {}
+
+  void set_data(const std::string& data) { data_ = data; }
+  int serialize_count() const { return serialize_count_; }
+
+  virtual bool SerializeData(std::string* output) OVERRIDE {
+    ++serialize_count_;
+    output->assign(data_);
+    return true;
+  }
+
+ private:
+  std::string data_;
+  int serialize_count_;
+
+  DISALLOW_COPY_AND_ASSIGN(CountingSerializer);
+};
+
+}  // namespace
+
+class ImportantFileCommitSchedulerTest : public testing::Test {
+ public:
+  virtual void SetUp() OVERRIDE {
+    ASSERT_TRUE(temp_dir_.CreateUniqueTempDir());
+  }
+
+ protected:
+  FilePath GetPath(const std::string& name) {
+    return temp_dir_.path().AppendASCII(name);
+  }
+
+  // Runs the commits scheduled for the next 100 ms.
+  void RunScheduledCommits() {
+    MessageLoop::current()->PostDelayedTask(
+        FROM_HERE,
+        MessageLoop::QuitWhenIdleClosure(),
+        TimeDelta::FromMilliseconds(100));
+    MessageLoop::current()->Run();
+  }
+
+  MessageLoop loop_;
+
+ private:
+  ScopedTempDir temp_dir_;
+};
+
+TEST_F(ImportantFileCommitSchedulerTest, BatchesWriters) {
+  ImportantFileCommitScheduler scheduler(MessageLoopProxy::current().get());
+  scheduler.set_commit_interval(TimeDelta::FromMilliseconds(25));
+  ImportantFileWriter foo_writer(GetPath("foo"), &scheduler);
+  ImportantFileWriter bar_writer(GetPath("bar"), &scheduler);
+  CountingSerializer foo;
+  CountingSerializer bar;
+  foo.set_data("foo");
+  bar.set_data("bar");
+
+  // The interval of the scheduler applies, not that of the writer.
+  foo_writer.set_commit_interval(TimeDelta::FromHours(1));
+  foo_writer.ScheduleWrite(&foo);
+  bar_writer.ScheduleWrite(&bar);
+  foo_writer.ScheduleWrite(&foo);
+  EXPECT_TRUE(scheduler.HasPendingCommit());
+  EXPECT_TRUE(foo_writer.HasPendingWrite());
+  RunScheduledCommits();
+
+  EXPECT_FALSE(scheduler.HasPendingCommit());
+  EXPECT_FALSE(foo_writer.HasPendingWrite());
+  EXPECT_EQ("foo", GetFileContent(foo_writer.path()));
+  EXPECT_EQ("bar", GetFileContent(bar_writer.path()));
+  EXPECT_EQ(1, foo.serialize_count());
+  EXPECT_EQ(1, bar.serialize_count());
+  EXPECT_EQ(1, scheduler.commit_count());
+  EXPECT_EQ(2, scheduler.sync_count());
+  EXPECT_EQ(6, scheduler.bytes_written());
+}
+
+TEST_F(ImportantFileCommitSchedulerTest, MaxWritesPerCommit) {
+  ImportantFileCommitScheduler scheduler(MessageLoopProxy::current().get());
+  scheduler.set_commit_interval(TimeDelta::FromMilliseconds(10));
+  scheduler.set_max_writes_per_commit(2);
+  ImportantFileWriter foo_writer(GetPath("foo"), &scheduler);
+  ImportantFileWriter bar_writer(GetPath("bar"), &scheduler);
+  ImportantFileWriter baz_writer(GetPath("baz"), &scheduler);
+  CountingSerializer foo;
+  CountingSerializer bar;
+  CountingSerializer baz;
+  foo.set_data("foo");
+  bar.set_data("bar");
+  baz.set_data("baz");
+
+  baz_writer.ScheduleWrite(&baz);
+  foo_writer.ScheduleWrite(&foo);
+  bar_writer.ScheduleWrite(&bar);
+  RunScheduledCommits();
+  EXPECT_FALSE(scheduler.HasPendingCommit());
+  EXPECT_EQ("foo", GetFileContent(foo_writer.path()));
+  EXPECT_EQ("bar", GetFileContent(bar_writer.path()));
+  EXPECT_EQ("baz", GetFileContent(baz_writer.path()));
+  EXPECT_EQ(2, scheduler.commit_count());
+  EXPECT_EQ(3, scheduler.sync_count());
+
+  // CommitNow() commits all of the writes at once.
+  foo.set_data("foo2");
+  bar.set_data("bar2");
+  baz.set_data("baz2");
+  baz_writer.ScheduleWrite(&baz);
+  foo_writer.ScheduleWrite(&foo);
+  bar_writer.ScheduleWrite(&bar);
+  scheduler.CommitNow();
+  EXPECT_FALSE(scheduler.HasPendingCommit());
+  RunLoop().RunUntilIdle();
+  EXPECT_EQ("foo2", GetFileContent(foo_writer.path()));
+  EXPECT_EQ("bar2", GetFileContent(bar_writer.path()));
+  EXPECT_EQ("baz2", GetFileContent(baz_writer.path()));
+  EXPECT_EQ(3, scheduler.commit_count());
+  EXPECT_EQ(6, scheduler.sync_count());
+}
+
+TEST_F(ImportantFileCommitSchedulerTest, SkipsUnchangedData) {
+  ImportantFileCommitScheduler scheduler(MessageLoopProxy::current().get());
+  ImportantFileWriter writer(GetPath("foo"), &scheduler);
+  CountingSerializer foo;
+  foo.set_data("foo");
+  writer.ScheduleWrite(&foo);
+  scheduler.CommitNow();
+  RunLoop().RunUntilIdle();
+  EXPECT_EQ(1, scheduler.sync_count());
+
+  writer.ScheduleWrite(&foo);
+  scheduler.CommitNow();
+  RunLoop().RunUntilIdle();
+  EXPECT_EQ(2, foo.serialize_count());
+  EXPECT_EQ(1, scheduler.commit_count());
+  EXPECT_EQ(1, scheduler.sync_count());
+
+  // Unless the write failed.
+  ASSERT_TRUE(DeleteFile(writer.path(), false));
+  ASSERT_TRUE(CreateDirectory(writer.path()));
+  foo.set_data("bar");
+  writer.ScheduleWrite(&foo);
+  scheduler.CommitNow();
+  RunLoop().RunUntilIdle();
+  ASSERT_TRUE(DeleteFile(writer.path(), false));
+  writer.ScheduleWrite(&foo);
+  scheduler.CommitNow();
+  RunLoop().RunUntilIdle();
+  EXPECT_EQ("bar", GetFileContent(writer.path()));
+  EXPECT_EQ(3, scheduler.sync_count());
+}
+
+TEST_F(ImportantFileCommitSchedulerTest, WriteNowCancelsCommit) {
+  ImportantFileCommitScheduler scheduler(MessageLoopProxy::current().get());
+  ImportantFileWriter writer(GetPath("foo"), &scheduler);
+  CountingSerializer foo;
+  foo.set_data("foo");
+  writer.ScheduleWrite(&foo);
+  EXPECT_TRUE(writer.HasPendingWrite());
+  writer.WriteNow("bar");
+  EXPECT_FALSE(writer.HasPendingWrite());
+  EXPECT_FALSE(scheduler.HasPendingCommit());
+  RunLoop().RunUntilIdle();
+  EXPECT_EQ("bar", GetFileContent(writer.path()));
+  EXPECT_EQ(0, foo.serialize_count());
+}
+
+}  // namespace base
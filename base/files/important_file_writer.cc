@@ -5,7 +5,9 @@
 #include "base/files/important_file_writer.h"
 
 #include <stdio.h>
+#include <string.h>
 
+#include <algorithm>
 #include <string>
 
 #include "base/bind.h"
@@ -13,8 +15,11 @@
 #include "base/files/file.h"
 #include "base/files/file_path.h"
 #include "base/files/file_util.h"
+#include "base/files/important_file_commit_scheduler.h"
+#include "base/hash.h"
 #include "base/logging.h"
 #include "base/metrics/histogram.h"
+#include "base/sha1.h"
 #include "base/strings/string_number_conversions.h"
 #include "base/task_runner.h"
 #include "base/task_runner_util.h"
@@ -27,6 +32,18 @@ namespace {
 
 const int kDefaultCommitIntervalMs = 10000;
 
+// The journal starts with kJournalMagic and the SHA-1 hash of the data the
+// deltas apply to. Each delta follows as a record of its length and hash, in
+// host byte order, and of the delta itself.
+const char kJournalMagic[] = "IFWJ";
+const size_t kJournalMagicSize = sizeof(kJournalMagic) - 1;
+const size_t kJournalHeaderSize = kJournalMagicSize + kSHA1Length;
+const size_t kJournalRecordHeaderSize = 2 * sizeof(uint32);
+
+// The file is rewritten once the journal grows larger than it, or than this
+// for small files.
+const int64 kMinJournalCompactionSize = 64 * 1024;
+
 enum TempFileFailure {
   FAILED_CREATING,
   FAILED_OPENING,
@@ -44,8 +61,53 @@ void LogFailure(const FilePath& path, TempFileFailure failure_code,
                  << " : " << message;
 }
 
+bool AppendToJournal(const FilePath& path,
+                     bool start,
+                     const std::string& header,
+                     const std::string& data) {
+  File file(path, start ? File::FLAG_CREATE_ALWAYS | File::FLAG_WRITE
+                        : File::FLAG_OPEN | File::FLAG_READ |
+                              File::FLAG_APPEND);
+  if (!file.IsValid()) {
+    DPLOG(WARNING) << "could not open journal: " << path.value().c_str();
+    return false;
+  }
+
+  // Don't append to a journal for other data, if starting the journal failed
+  // or the file was replaced since.
+  if (!start) {
+    std::string journal_header(kJournalHeaderSize, '\0');
+    if (file.Read(0, &journal_header[0], kJournalHeaderSize) !=
+            static_cast<int>(kJournalHeaderSize) ||
+        journal_header != header) {
+      DLOG(WARNING) << "journal of other data: " << path.value().c_str();
+      return false;
+    }
+  }
+
+  CHECK_LE(data.length(), static_cast<size_t>(kint32max));
+  int bytes_written = file.WriteAtCurrentPos(data.data(),
+                                             static_cast<int>(data.length()));
+  if (bytes_written < static_cast<int>(data.length()) || !file.Flush()) {
+    DPLOG(WARNING) << "error writing journal: " << path.value().c_str();
+    return false;
+  }
+  return true;
+}
+
 }  // namespace
 
+ImportantFileWriter::Write::Write(Type type, const FilePath& path)
+    : type(type),
+      path(path),
+      delete_journal(false),
+      start_journal(false),
+      succeeded(false) {
+}
+
+ImportantFileWriter::Write::~Write() {
+}
+
 // static
 bool ImportantFileWriter::WriteFileAtomically(const FilePath& path,
                                               const std::string& data) {
@@ -88,12 +150,77 @@ bool ImportantFileWriter::WriteFileAtomically(const FilePath& path,
   return true;
 }
 
+// static
+bool ImportantFileWriter::ReadFileAndJournal(const FilePath& path,
+                                             std::string* data,
+                                             std::vector<std::string>* deltas) {
+  deltas->clear();
+  if (!ReadFileToString(path, data))
+    return false;
+
+  std::string journal;
+  if (!ReadFileToString(GetJournalPath(path), &journal) ||
+      journal.size() < kJournalHeaderSize ||
+      journal.compare(0, kJournalMagicSize, kJournalMagic) != 0 ||
+      journal.compare(kJournalMagicSize, kSHA1Length, SHA1HashString(*data)) !=
+          0) {
+    return true;
+  }
+
+  // Stop at the first record that wasn't completely written.
+  size_t offset = kJournalHeaderSize;
+  while (journal.size() - offset >= kJournalRecordHeaderSize) {
+    uint32 length;
+    uint32 hash;
+    memcpy(&length, journal.data() + offset, sizeof(length));
+    memcpy(&hash, journal.data() + offset + sizeof(length), sizeof(hash));
+    offset += kJournalRecordHeaderSize;
+    if (journal.size() - offset < length)
+      break;
+    std::string delta(journal, offset, length);
+    if (Hash(delta) != hash)
+      break;
+    deltas->push_back(delta);
+    offset += length;
+  }
+  return true;
+}
+
+// static
+FilePath ImportantFileWriter::GetJournalPath(const FilePath& path) {
+  return path.AddExtension(FILE_PATH_LITERAL("journal"));
+}
+
 ImportantFileWriter::ImportantFileWriter(
     const FilePath& path,
     const scoped_refptr<base::SequencedTaskRunner>& task_runner)
     : path_(path),
       task_runner_(task_runner),
+      scheduler_(NULL),
+      serializer_(NULL),
+      delta_serializer_(NULL),
+      uses_journal_(false),
+      written_size_(0),
+      journal_started_(false),
+      journal_size_(0),
+      commit_interval_(TimeDelta::FromMilliseconds(kDefaultCommitIntervalMs)),
+      weak_factory_(this) {
+  DCHECK(CalledOnValidThread());
+  DCHECK(task_runner_.get());
+}
+
+ImportantFileWriter::ImportantFileWriter(
+    const FilePath& path,
+    ImportantFileCommitScheduler* scheduler)
+    : path_(path),
+      task_runner_(scheduler->task_runner()),
+      scheduler_(scheduler),
       serializer_(NULL),
+      delta_serializer_(NULL),
+      uses_journal_(false),
+      written_size_(0),
+      journal_started_(false),
+      journal_size_(0),
       commit_interval_(TimeDelta::FromMilliseconds(kDefaultCommitIntervalMs)),
       weak_factory_(this) {
   DCHECK(CalledOnValidThread());
@@ -105,10 +232,14 @@ ImportantFileWriter::~ImportantFileWriter() {
   // to be our serializer. It may not be safe to call back to the parent object
   // being destructed.
   DCHECK(!HasPendingWrite());
+  if (scheduler_)
+    scheduler_->CancelCommit(this);
 }
 
 bool ImportantFileWriter::HasPendingWrite() const {
   DCHECK(CalledOnValidThread());
+  if (scheduler_)
+    return scheduler_->IsCommitScheduled(this);
   return timer_.IsRunning();
 }
 
@@ -119,9 +250,16 @@ void ImportantFileWriter::WriteNow(const std::string& data) {
     return;
   }
 
-  if (HasPendingWrite())
+  if (scheduler_)
+    scheduler_->CancelCommit(this);
+  else if (HasPendingWrite())
     timer_.Stop();
 
+  if (TracksWrites()) {
+    PostWrite(CreateFullWrite(data, false));
+    return;
+  }
+
   if (!PostWriteTask(data)) {
     // Posting the task to background message loop is not expected
     // to fail, but if it does, avoid losing data and just hit the disk
@@ -137,15 +275,35 @@ void ImportantFileWriter::ScheduleWrite(DataSerializer* serializer) {
 
   DCHECK(serializer);
   serializer_ = serializer;
+  delta_serializer_ = NULL;
 
-  if (!timer_.IsRunning()) {
+  if (scheduler_) {
+    scheduler_->ScheduleCommit(this);
+  } else if (!timer_.IsRunning()) {
     timer_.Start(FROM_HERE, commit_interval_, this,
                  &ImportantFileWriter::DoScheduledWrite);
   }
 }
 
+void ImportantFileWriter::ScheduleDeltaWrite(DeltaSerializer* serializer) {
+  ScheduleWrite(serializer);
+  delta_serializer_ = serializer;
+  uses_journal_ = true;
+}
+
 void ImportantFileWriter::DoScheduledWrite() {
   DCHECK(serializer_);
+  if (TracksWrites()) {
+    if (scheduler_)
+      scheduler_->CancelCommit(this);
+    else
+      timer_.Stop();
+    scoped_refptr<Write> write = SerializeScheduledWrite();
+    if (write.get())
+      PostWrite(write);
+    return;
+  }
+
   std::string data;
   if (serializer_->SerializeData(&data)) {
     WriteNow(data);
@@ -184,6 +342,126 @@ bool ImportantFileWriter::PostWriteTask(const std::string& data) {
                path_, data)));
 }
 
+bool ImportantFileWriter::TracksWrites() const {
+  return scheduler_ || uses_journal_;
+}
+
+scoped_refptr<ImportantFileWriter::Write>
+ImportantFileWriter::SerializeScheduledWrite() {
+  DCHECK(CalledOnValidThread());
+  DCHECK(serializer_);
+  DataSerializer* serializer = serializer_;
+  DeltaSerializer* delta_serializer = delta_serializer_;
+  serializer_ = NULL;
+  delta_serializer_ = NULL;
+
+  // Until this writer has written the file, what it holds isn't known, so
+  // the deltas can't be journaled.
+  if (delta_serializer && !written_hash_.empty() &&
+      journal_size_ < std::max(kMinJournalCompactionSize, written_size_)) {
+    std::string delta;
+    if (delta_serializer->SerializeDelta(&delta)) {
+      if (delta.empty())
+        return NULL;
+      return CreateJournalAppend(delta);
+    }
+  }
+
+  std::string data;
+  if (!serializer->SerializeData(&data)) {
+    DLOG(WARNING) << "failed to serialize data to be saved in "
+                  << path_.value().c_str();
+    return NULL;
+  }
+  return CreateFullWrite(data, true);
+}
+
+scoped_refptr<ImportantFileWriter::Write> ImportantFileWriter::CreateFullWrite(
+    const std::string& data,
+    bool skip_unchanged) {
+  std::string hash = SHA1HashString(data);
+  if (skip_unchanged && !journal_started_ && hash == written_hash_)
+    return NULL;
+
+  scoped_refptr<Write> write(new Write(Write::FULL_WRITE, path_));
+  write->data = data;
+  write->delete_journal = uses_journal_;
+  write->writer = weak_factory_.GetWeakPtr();
+  written_hash_ = hash;
+  written_size_ = data.size();
+  journal_started_ = false;
+  journal_size_ = 0;
+  return write;
+}
+
+scoped_refptr<ImportantFileWriter::Write>
+ImportantFileWriter::CreateJournalAppend(const std::string& delta) {
+  DCHECK(!written_hash_.empty());
+  CHECK_LE(delta.length(), static_cast<size_t>(kint32max));
+
+  scoped_refptr<Write> write(new Write(Write::JOURNAL_APPEND, path_));
+  write->start_journal = !journal_started_;
+  write->journal_header = kJournalMagic + written_hash_;
+  if (write->start_journal)
+    write->data = write->journal_header;
+  uint32 length = static_cast<uint32>(delta.size());
+  uint32 hash = Hash(delta);
+  write->data.append(reinterpret_cast<const char*>(&length), sizeof(length));
+  write->data.append(reinterpret_cast<const char*>(&hash), sizeof(hash));
+  write->data.append(delta);
+  write->writer = weak_factory_.GetWeakPtr();
+  journal_started_ = true;
+  journal_size_ += write->data.size();
+  return write;
+}
+
+void ImportantFileWriter::PostWrite(const scoped_refptr<Write>& write) {
+  if (!task_runner_->PostTaskAndReply(
+          FROM_HERE,
+          MakeCriticalClosure(Bind(&ImportantFileWriter::PerformWrite, write)),
+          Bind(&ImportantFileWriter::DidPerformWrite, write))) {
+    // Posting the task to background message loop is not expected
+    // to fail, but if it does, avoid losing data and just hit the disk
+    // on the current thread.
+    NOTREACHED();
+
+    PerformWrite(write.get());
+    DidPerformWrite(write.get());
+  }
+}
+
+// static
+void ImportantFileWriter::PerformWrite(Write* write) {
+  FilePath journal_path = GetJournalPath(write->path);
+  if (write->type == Write::JOURNAL_APPEND) {
+    write->succeeded = AppendToJournal(journal_path, write->start_journal,
+                                       write->journal_header, write->data);
+    return;
+  }
+
+  write->succeeded = WriteFileAtomically(write->path, write->data);
+  // The deltas of the journal were for the data just replaced. Should this
+  // fail, the journal is ignored anyway, as it was for other data.
+  if (write->succeeded && write->delete_journal)
+    base::DeleteFile(journal_path, false);
+}
+
+// static
+void ImportantFileWriter::DidPerformWrite(Write* write) {
+  if (write->writer)
+    write->writer->OnWriteDone(*write);
+}
+
+void ImportantFileWriter::OnWriteDone(const Write& write) {
+  DCHECK(CalledOnValidThread());
+  // What the file holds isn't known anymore; have the next write rewrite it.
+  if (!write.succeeded) {
+    written_hash_.clear();
+    journal_started_ = false;
+  }
+  ForwardSuccessfulWrite(write.succeeded);
+}
+
 void ImportantFileWriter::ForwardSuccessfulWrite(bool result) {
   DCHECK(CalledOnValidThread());
   if (result && !on_next_successful_write_.is_null()) {
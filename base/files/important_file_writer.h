@@ -6,18 +6,21 @@
 #define BASE_FILES_IMPORTANT_FILE_WRITER_H_
 
 #include <string>
+#include <vector>
 
 #include "base/base_export.h"
 #include "base/basictypes.h"
 #include "base/callback.h"
 #include "base/files/file_path.h"
 #include "base/memory/ref_counted.h"
+#include "base/memory/weak_ptr.h"
 #include "base/threading/non_thread_safe.h"
 #include "base/time/time.h"
 #include "base/timer/timer.h"
 
 namespace base {
 
+class ImportantFileCommitScheduler;
 class SequencedTaskRunner;
 class Thread;
 
@@ -37,6 +40,11 @@ class Thread;
 //
 // If you want to know more about this approach and ext3/ext4 fsync issues, see
 // http://valhenson.livejournal.com/37921.html
+//
+// Rewriting a large file for every small change is costly, so a writer can
+// be given a DeltaSerializer instead; the changes are then appended to a
+// journal next to the file, and the file is only rewritten once the journal
+// grows as large as it. ReadFileAndJournal() reads both back.
 class BASE_EXPORT ImportantFileWriter : public NonThreadSafe {
  public:
   // Used by ScheduleSave to lazily provide the data to be saved. Allows us
@@ -52,11 +60,34 @@ class BASE_EXPORT ImportantFileWriter : public NonThreadSafe {
     virtual ~DataSerializer() {}
   };
 
+  // A DataSerializer that can also serialize just what changed.
+  class BASE_EXPORT DeltaSerializer : public DataSerializer {
+   public:
+    // Should put what changed since the last call of SerializeData() or
+    // SerializeDelta() in |delta|, empty if nothing did, and return true.
+    // Returning false has all of the data serialized instead.
+    virtual bool SerializeDelta(std::string* delta) = 0;
+
+   protected:
+    virtual ~DeltaSerializer() {}
+  };
+
   // Save |data| to |path| in an atomic manner (see the class comment above).
   // Blocks and writes data on the current thread.
   static bool WriteFileAtomically(const FilePath& path,
                                   const std::string& data);
 
+  // Reads the file at |path| into |data|, and the deltas journaled since it
+  // was written, oldest first, into |deltas|. Deltas that were not
+  // completely written, or that were journaled for another version of the
+  // file, are left out. Returns false if the file couldn't be read.
+  static bool ReadFileAndJournal(const FilePath& path,
+                                 std::string* data,
+                                 std::vector<std::string>* deltas);
+
+  // Returns the path of the journal of the file at |path|.
+  static FilePath GetJournalPath(const FilePath& path);
+
   // Initialize the writer.
   // |path| is the name of file to write.
   // |task_runner| is the SequencedTaskRunner instance where on which we will
@@ -66,6 +97,13 @@ class BASE_EXPORT ImportantFileWriter : public NonThreadSafe {
       const FilePath& path,
       const scoped_refptr<base::SequencedTaskRunner>& task_runner);
 
+  // Initialize a writer whose scheduled writes are committed together with
+  // those of the other writers of |scheduler|, on its task runner, instead of
+  // after the commit interval of the writer. |scheduler| must outlive the
+  // writer.
+  ImportantFileWriter(const FilePath& path,
+                      ImportantFileCommitScheduler* scheduler);
+
   // You have to ensure that there are no pending writes at the moment
   // of destruction.
   ~ImportantFileWriter();
@@ -88,6 +126,13 @@ class BASE_EXPORT ImportantFileWriter : public NonThreadSafe {
   // ImportantFileWriter.
   void ScheduleWrite(DataSerializer* serializer);
 
+  // Like ScheduleWrite(), but only the changes are serialized and appended to
+  // the journal, unless the file has not been written by this writer yet, or
+  // the journal has grown as large as the file: then the file is rewritten
+  // and the journal deleted. A writer using this should not use
+  // ScheduleWrite() with another serializer.
+  void ScheduleDeltaWrite(DeltaSerializer* serializer);
+
   // Serialize data pending to be saved and execute write on backend thread.
   void DoScheduledWrite();
 
@@ -105,9 +150,74 @@ class BASE_EXPORT ImportantFileWriter : public NonThreadSafe {
   }
 
  private:
+  friend class ImportantFileCommitScheduler;
+
+  // A write of the file, or an append to its journal, ready to be done on
+  // the task runner.
+  struct Write : public RefCountedThreadSafe<Write> {
+    enum Type {
+      FULL_WRITE,
+      JOURNAL_APPEND,
+    };
+
+    Write(Type type, const FilePath& path);
+
+    const Type type;
+    const FilePath path;
+
+    // The data of the file, or the records appended to the journal.
+    std::string data;
+
+    // For FULL_WRITE, whether to delete the journal once the file is
+    // replaced.
+    bool delete_journal;
+
+    // For JOURNAL_APPEND, whether |data| starts the journal, and the header
+    // the journal starts with.
+    bool start_journal;
+    std::string journal_header;
+
+    bool succeeded;
+    WeakPtr<ImportantFileWriter> writer;
+
+   private:
+    friend class RefCountedThreadSafe<Write>;
+
+    ~Write();
+
+    DISALLOW_COPY_AND_ASSIGN(Write);
+  };
+
   // Helper method for WriteNow().
   bool PostWriteTask(const std::string& data);
 
+  // Whether the writes go through Write, to keep track of what was written.
+  bool TracksWrites() const;
+
+  // Serializes the data of the scheduled write. Returns NULL if there is
+  // nothing to write.
+  scoped_refptr<Write> SerializeScheduledWrite();
+
+  // Returns a write of |data| to the file, or NULL if |skip_unchanged| and
+  // the file already holds |data|.
+  scoped_refptr<Write> CreateFullWrite(const std::string& data,
+                                       bool skip_unchanged);
+
+  // Returns an append of |delta| to the journal.
+  scoped_refptr<Write> CreateJournalAppend(const std::string& delta);
+
+  // Does |write| on |task_runner_|, and lets the writer know the result.
+  void PostWrite(const scoped_refptr<Write>& write);
+
+  // Does |write|; runs on the task runner.
+  static void PerformWrite(Write* write);
+
+  // Lets the writer of |write| know its result, if it is still alive.
+  static void DidPerformWrite(Write* write);
+
+  // Called back with the result of each write of the writer.
+  void OnWriteDone(const Write& write);
+
   // If |result| is true and |on_next_successful_write_| is set, invokes
   // |on_successful_write_| and then resets it; no-ops otherwise.
   void ForwardSuccessfulWrite(bool result);
@@ -124,9 +234,28 @@ class BASE_EXPORT ImportantFileWriter : public NonThreadSafe {
   // Timer used to schedule commit after ScheduleWrite.
   OneShotTimer<ImportantFileWriter> timer_;
 
+  // The scheduler committing the writes, if any.
+  ImportantFileCommitScheduler* const scheduler_;
+
   // Serializer which will provide the data to be saved.
   DataSerializer* serializer_;
 
+  // |serializer_|, if it was scheduled with ScheduleDeltaWrite().
+  DeltaSerializer* delta_serializer_;
+
+  // Whether ScheduleDeltaWrite() was ever used, so that full writes delete
+  // the journal.
+  bool uses_journal_;
+
+  // The SHA-1 hash and size of the data last written in full, if known.
+  std::string written_hash_;
+  int64 written_size_;
+
+  // Whether the deltas since that write are being journaled, and the size of
+  // the journal.
+  bool journal_started_;
+  int64 journal_size_;
+
   // Time delta after which scheduled data will be written to disk.
   TimeDelta commit_interval_;
 
@@ -0,0 +1,246 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <map>
+#include <string>
+
+#include "base/files/file_path.h"
+#include "base/files/important_file_commit_scheduler.h"
+#include "base/files/important_file_writer.h"
+#include "base/files/scoped_temp_dir.h"
+#include "base/memory/scoped_vector.h"
+#include "base/message_loop/message_loop.h"
+#include "base/strings/stringprintf.h"
+#include "base/time/time.h"
+#include "base/timer/timer.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "testing/perf/perf_test.h"
+
+namespace base {
+
+namespace {
+
+// The workload runs for kTicks ticks of kTickMs, each standing for a second.
+const int kTicks = 100;
+const int kTickMs = 10;
+
+// The budget of the scheduler: up to kMaxWritesPerCommit writes a second.
+const size_t kMaxWritesPerCommit = 4;
+
+// A file of prefs, changing every |change_period| ticks.
+struct FileSpec {
+  const char* name;
+  int size;
+  int change_period;
+  bool journaled;
+};
+
+const FileSpec kFiles[] = {
+  { "Preferences", 256 * 1024, 1, true },
+  { "Local State", 32 * 1024, 3, true },
+  { "Current Session", 32 * 1024, 1, false },
+  { "Bookmarks", 128 * 1024, 20, false },
+  { "Extension State", 8 * 1024, 2, true },
+};
+
+// The settings of as many extensions, of 2 KB each, change every
+// kExtensionChangePeriod ticks.
+const int kExtensionCount = 16;
+const int kExtensionChangePeriod = 8;
+
+// Serializes key=value lines; the delta is the lines of the values set since
+// the last serialization.
+class PrefsSerializer : public ImportantFileWriter::DeltaSerializer {
+ public:
+  PrefsSerializer(int size, int change_period, bool journaled)
+      : change_period_(change_period),
+        journaled_(journaled),
+        serialize_count_(0),
+        bytes_serialized_(0) {
+    for (int i = 0; i < size / 64; ++i)
+      Set(i, 0);
+    delta_.clear();
+  }
+
+  // Sets the value of |key| to one made of |seed|.
+  void Set(int key, int seed) {
+    std::string line = StringPrintf("key%05d=%048d\n", key, seed);
+    values_[key] = line;
+    delta_.append(line);
+  }
+
+  int key_count() const { return static_cast<int>(values_.size()); }
+  int change_period() const { return change_period_; }
+  bool journaled() const { return journaled_; }
+  int serialize_count() const { return serialize_count_; }
+  int64 bytes_serialized() const { return bytes_serialized_; }
+
+  virtual bool SerializeData(std::string* data) OVERRIDE {
+    data->clear();
+    for (std::map<int, std::string>::const_iterator it = values_.begin();
+         it != values_.end(); ++it) {
+      data->append(it->second);
+    }
+    delta_.clear();
+    ++serialize_count_;
+    bytes_serialized_ += data->size();
+    return true;
+  }
+
+  virtual bool SerializeDelta(std::string* delta) OVERRIDE {
+    delta->swap(delta_);
+    delta_.clear();
+    return true;
+  }
+
+ private:
+  const int change_period_;
+  const bool journaled_;
+  std::map<int, std::string> values_;
+  std::string delta_;
+  int serialize_count_;
+  int64 bytes_serialized_;
+
+  DISALLOW_COPY_AND_ASSIGN(PrefsSerializer);
+};
+
+// Changes the prefs of the files every tick, and schedules their writes,
+// through |scheduler| or, if NULL, writers committing on their own.
+class PrefsWorkload {
+ public:
+  PrefsWorkload(const FilePath& dir, ImportantFileCommitScheduler* scheduler)
+      : scheduler_(scheduler), tick_(0) {
+    for (size_t i = 0; i < arraysize(kFiles); ++i) {
+      AddFile(dir.AppendASCII(kFiles[i].name), kFiles[i].size,
+              kFiles[i].change_period, kFiles[i].journaled);
+    }
+    for (int i = 0; i < kExtensionCount; ++i) {
+      AddFile(dir.AppendASCII(StringPrintf("Extension Settings %d", i)),
+              2 * 1024, kExtensionChangePeriod, false);
+    }
+  }
+
+  void Run() {
+    timer_.Start(FROM_HERE, TimeDelta::FromMilliseconds(kTickMs), this,
+                 &PrefsWorkload::Tick);
+    MessageLoop::current()->Run();
+  }
+
+  // The writes, each syncing a file, and the bytes written by writers
+  // committing on their own.
+  int GetSyncCount() const {
+    int count = 0;
+    for (size_t i = 0; i < serializers_.size(); ++i)
+      count += serializers_[i]->serialize_count();
+    return count;
+  }
+
+  int64 GetBytesWritten() const {
+    int64 bytes = 0;
+    for (size_t i = 0; i < serializers_.size(); ++i)
+      bytes += serializers_[i]->bytes_serialized();
+    return bytes;
+  }
+
+ private:
+  void AddFile(const FilePath& path,
+               int size,
+               int change_period,
+               bool journaled) {
+    serializers_.push_back(
+        new PrefsSerializer(size, change_period, journaled && scheduler_));
+    if (scheduler_) {
+      writers_.push_back(new ImportantFileWriter(path, scheduler_));
+    } else {
+      // Tick() commits the writes, for the ticks to stand for their commit
+      // interval however long the writes take.
+      writers_.push_back(
+          new ImportantFileWriter(path, MessageLoopProxy::current()));
+      writers_.back()->set_commit_interval(TimeDelta::FromDays(1));
+    }
+  }
+
+  void Tick() {
+    CommitWriters();
+    if (++tick_ > kTicks) {
+      timer_.Stop();
+      if (scheduler_)
+        scheduler_->CommitNow();
+      MessageLoop::current()->PostTask(FROM_HERE,
+                                       MessageLoop::QuitWhenIdleClosure());
+      return;
+    }
+
+    for (size_t i = 0; i < serializers_.size(); ++i) {
+      PrefsSerializer* serializer = serializers_[i];
+      if ((tick_ + static_cast<int>(i)) % serializer->change_period() != 0)
+        continue;
+      serializer->Set((tick_ * 7 + static_cast<int>(i)) %
+                          serializer->key_count(),
+                      tick_);
+      if (serializer->journaled())
+        writers_[i]->ScheduleDeltaWrite(serializer);
+      else
+        writers_[i]->ScheduleWrite(serializer);
+    }
+  }
+
+  // Commits the writes scheduled by the writers committing on their own.
+  void CommitWriters() {
+    if (scheduler_)
+      return;
+    for (size_t i = 0; i < writers_.size(); ++i) {
+      if (writers_[i]->HasPendingWrite())
+        writers_[i]->DoScheduledWrite();
+    }
+  }
+
+  ImportantFileCommitScheduler* scheduler_;
+  ScopedVector<PrefsSerializer> serializers_;
+  ScopedVector<ImportantFileWriter> writers_;
+  RepeatingTimer<PrefsWorkload> timer_;
+  int tick_;
+
+  DISALLOW_COPY_AND_ASSIGN(PrefsWorkload);
+};
+
+void PrintResults(const std::string& trace, int sync_count, int64 bytes) {
+  perf_test::PrintResult("important_file_writer", "_fsyncs", trace,
+                         static_cast<double>(sync_count) / kTicks, "fsyncs/s",
+                         true);
+  perf_test::PrintResult("important_file_writer", "_bytes_written", trace,
+                         static_cast<double>(bytes) / kTicks, "bytes/s", true);
+}
+
+}  // namespace
+
+// Writes the files of a synthetic prefs workload, each changing on its own
+// period, first with writers committing on their own, then through a
+// scheduler journaling the large files under a budget of fsyncs.
+TEST(ImportantFileWriterPerfTest, PrefsWorkload) {
+  MessageLoop loop;
+
+  ScopedTempDir independent_dir;
+  ASSERT_TRUE(independent_dir.CreateUniqueTempDir());
+  {
+    PrefsWorkload workload(independent_dir.path(), NULL);
+    workload.Run();
+    PrintResults("independent", workload.GetSyncCount(),
+                 workload.GetBytesWritten());
+  }
+
+  ScopedTempDir scheduled_dir;
+  ASSERT_TRUE(scheduled_dir.CreateUniqueTempDir());
+  ImportantFileCommitScheduler scheduler(MessageLoopProxy::current());
+  scheduler.set_commit_interval(TimeDelta::FromMilliseconds(kTickMs));
+  scheduler.set_max_writes_per_commit(kMaxWritesPerCommit);
+  {
+    PrefsWorkload workload(scheduled_dir.path(), &scheduler);
+    workload.Run();
+    PrintResults("scheduled", scheduler.sync_count(),
+                 scheduler.bytes_written());
+  }
+}
+
+}  // namespace base
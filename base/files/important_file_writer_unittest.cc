@@ -4,6 +4,9 @@
 
 #include "base/files/important_file_writer.h"
 
+#include <string>
+#include <vector>
+
 #include "base/bind.h"
 #include "base/compiler_specific.h"
 #include "base/files/file_path.h"
@@ -42,6 +45,46 @@ class DataSerializer : public ImportantFileWriter::DataSerializer {
   const std::string data_;
 };
 
+// Serializes the concatenation of the strings appended, and as a delta the
+// strings appended since the last serialization.
+class AppendSerializer : public ImportantFileWriter::DeltaSerializer {
+ public:
+  AppendSerializer() {}
+
+  void Append(const std::string& data) {
+    data_.append(data);
+    delta_.append(data);
+  }
+
+  virtual bool SerializeData(std::string* output) OVERRIDE {
+    output->assign(data_);
+    delta_.clear();
+    return true;
+  }
+
+  virtual bool SerializeDelta(std::string* delta) OVERRIDE {
+    delta->swap(delta_);
+    delta_.clear();
+    return true;
+  }
+
+ private:
+  std::string data_;
+  std::string delta_;
+
+  DISALLOW_COPY_AND_ASSIGN(AppendSerializer);
+};
+
+// Returns the file at |path| with its journal applied by AppendSerializer.
+std::string GetJournaledContent(const FilePath& path) {
+  std::string data;
+  std::vector<std::string> deltas;
+  EXPECT_TRUE(ImportantFileWriter::ReadFileAndJournal(path, &data, &deltas));
+  for (size_t i = 0; i < deltas.size(); ++i)
+    data.append(deltas[i]);
+  return data;
+}
+
 class SuccessfulWriteObserver {
  public:
   SuccessfulWriteObserver() : successful_write_observed_(false) {}
@@ -192,4 +235,122 @@ TEST_F(ImportantFileWriterTest, BatchingWrites) {
   EXPECT_EQ("baz", GetFileContent(writer.path()));
 }
 
+TEST_F(ImportantFileWriterTest, Journal) {
+  ImportantFileWriter writer(file_, MessageLoopProxy::current().get());
+  FilePath journal = ImportantFileWriter::GetJournalPath(file_);
+  AppendSerializer serializer;
+
+  // The first write is of all of the data.
+  serializer.Append("foo");
+  writer.ScheduleDeltaWrite(&serializer);
+  writer.DoScheduledWrite();
+  RunLoop().RunUntilIdle();
+  EXPECT_EQ("foo", GetFileContent(file_));
+  EXPECT_FALSE(PathExists(journal));
+
+  serializer.Append("bar");
+  writer.ScheduleDeltaWrite(&serializer);
+  writer.DoScheduledWrite();
+  serializer.Append("baz");
+  writer.ScheduleDeltaWrite(&serializer);
+  writer.DoScheduledWrite();
+  RunLoop().RunUntilIdle();
+  EXPECT_EQ("foo", GetFileContent(file_));
+  std::string data;
+  std::vector<std::string> deltas;
+  EXPECT_TRUE(ImportantFileWriter::ReadFileAndJournal(file_, &data, &deltas));
+  EXPECT_EQ("foo", data);
+  ASSERT_EQ(2u, deltas.size());
+  EXPECT_EQ("bar", deltas[0]);
+  EXPECT_EQ("baz", deltas[1]);
+
+  // Nothing changed, nothing is written.
+  std::string journal_content = GetFileContent(journal);
+  writer.ScheduleDeltaWrite(&serializer);
+  writer.DoScheduledWrite();
+  RunLoop().RunUntilIdle();
+  EXPECT_EQ(journal_content, GetFileContent(journal));
+
+  // Writing all of the data deletes the journal.
+  writer.WriteNow("qux");
+  RunLoop().RunUntilIdle();
+  EXPECT_EQ("qux", GetFileContent(file_));
+  EXPECT_FALSE(PathExists(journal));
+}
+
+TEST_F(ImportantFileWriterTest, JournalCompaction) {
+  ImportantFileWriter writer(file_, MessageLoopProxy::current().get());
+  FilePath journal = ImportantFileWriter::GetJournalPath(file_);
+  AppendSerializer serializer;
+  serializer.Append("foo");
+  writer.ScheduleDeltaWrite(&serializer);
+  writer.DoScheduledWrite();
+
+  // The journal grows until it is larger than the file, or 64 KB.
+  std::string delta(40 * 1024, 'x');
+  for (int i = 0; i < 2; ++i) {
+    serializer.Append(delta);
+    writer.ScheduleDeltaWrite(&serializer);
+    writer.DoScheduledWrite();
+  }
+  RunLoop().RunUntilIdle();
+  EXPECT_EQ("foo", GetFileContent(file_));
+  EXPECT_EQ("foo" + delta + delta, GetJournaledContent(file_));
+
+  serializer.Append("bar");
+  writer.ScheduleDeltaWrite(&serializer);
+  writer.DoScheduledWrite();
+  RunLoop().RunUntilIdle();
+  EXPECT_EQ("foo" + delta + delta + "bar", GetFileContent(file_));
+  EXPECT_FALSE(PathExists(journal));
+}
+
+TEST_F(ImportantFileWriterTest, TornJournal) {
+  ImportantFileWriter writer(file_, MessageLoopProxy::current().get());
+  FilePath journal = ImportantFileWriter::GetJournalPath(file_);
+  AppendSerializer serializer;
+  const char* const kData[] = { "foo", "bar", "baz" };
+  for (size_t i = 0; i < arraysize(kData); ++i) {
+    serializer.Append(kData[i]);
+    writer.ScheduleDeltaWrite(&serializer);
+    writer.DoScheduledWrite();
+  }
+  RunLoop().RunUntilIdle();
+  EXPECT_EQ("foobarbaz", GetJournaledContent(file_));
+
+  // A record not completely written, and those after it, are left out.
+  std::string journal_content = GetFileContent(journal);
+  for (size_t size = journal_content.size() - 1;
+       size > journal_content.size() - 3; --size) {
+    ASSERT_TRUE(WriteFile(journal, journal_content.data(),
+                          static_cast<int>(size)));
+    EXPECT_EQ("foobar", GetJournaledContent(file_));
+  }
+  std::string corrupt_content(journal_content);
+  corrupt_content[corrupt_content.size() - 5] = 'x';
+  ASSERT_TRUE(WriteFile(journal, corrupt_content.data(),
+                        static_cast<int>(corrupt_content.size())));
+  EXPECT_EQ("foobar", GetJournaledContent(file_));
+
+  // The journal is left out if the file was replaced.
+  ASSERT_TRUE(WriteFile(journal, journal_content.data(),
+                        static_cast<int>(journal_content.size())));
+  ASSERT_TRUE(WriteFile(file_, "qux", 3));
+  EXPECT_EQ("qux", GetJournaledContent(file_));
+
+  // Failing to append to the journal has the next write rewrite the file.
+  ASSERT_TRUE(DeleteFile(journal, false));
+  serializer.Append("quux");
+  writer.ScheduleDeltaWrite(&serializer);
+  writer.DoScheduledWrite();
+  RunLoop().RunUntilIdle();
+  EXPECT_FALSE(PathExists(journal));
+  serializer.Append("corge");
+  writer.ScheduleDeltaWrite(&serializer);
+  writer.DoScheduledWrite();
+  RunLoop().RunUntilIdle();
+  EXPECT_EQ("foobarbazquuxcorge", GetFileContent(file_));
+  EXPECT_FALSE(PathExists(journal));
+}
+
 }  // namespace base
@@ -0,0 +1,256 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/files/parallel_file_enumerator.h"
+
+#include "base/atomic_ref_count.h"
+#include "base/bind.h"
+#include "base/location.h"
+#include "base/logging.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/single_thread_task_runner.h"
+#include "base/synchronization/cancellation_flag.h"
+#include "base/thread_task_runner_handle.h"
+#include "base/threading/sequenced_worker_pool.h"
+#include "base/threading/thread_restrictions.h"
+
+#if defined(OS_LINUX)
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "base/files/dir_reader_linux.h"
+#include "base/files/scoped_file.h"
+#include "base/posix/eintr_wrapper.h"
+#endif
+
+namespace base {
+
+// Reads the directories on the worker pool, and passes the batches to the
+// origin thread. Refcounted, as the worker tasks may outlive the enumerator.
+class ParallelFileEnumerator::Core
+    : public RefCountedThreadSafe<ParallelFileEnumerator::Core> {
+ public:
+  Core(bool recursive,
+       int file_type,
+       const scoped_refptr<SequencedWorkerPool>& worker_pool,
+       const BatchCallback& batch_callback,
+       const Closure& done_callback)
+      : recursive_(recursive),
+        file_type_(file_type),
+        worker_pool_(worker_pool),
+        origin_task_runner_(ThreadTaskRunnerHandle::Get()),
+        batch_callback_(batch_callback),
+        done_callback_(done_callback),
+        pending_directories_(0) {
+  }
+
+  void Start(const FilePath& root_path) {
+    PostReadDirectory(root_path);
+  }
+
+  // Called on the origin thread.
+  void Cancel() {
+    cancelled_.Set();
+    batch_callback_.Reset();
+    done_callback_.Reset();
+  }
+
+ private:
+  friend class RefCountedThreadSafe<Core>;
+
+  ~Core() {}
+
+  void PostReadDirectory(const FilePath& directory) {
+    AtomicRefCountInc(&pending_directories_);
+    if (!worker_pool_->PostWorkerTaskWithShutdownBehavior(
+            FROM_HERE,
+            Bind(&Core::ReadDirectoryOnWorker, this, directory),
+            SequencedWorkerPool::SKIP_ON_SHUTDOWN)) {
+      OnDirectoryDone();
+    }
+  }
+
+  void ReadDirectoryOnWorker(const FilePath& directory) {
+    std::vector<FileEnumerator::FileInfo> infos;
+    if (!cancelled_.IsSet()) {
+#if defined(OS_POSIX)
+      const bool show_links =
+          (file_type_ & FileEnumerator::SHOW_SYM_LINKS) != 0;
+#else
+      const bool show_links = false;
+#endif
+      ParallelFileEnumerator::ReadDirectory(directory, show_links, &infos);
+    }
+
+    scoped_ptr<EntryBatch> batch(new EntryBatch);
+    for (size_t i = 0; i < infos.size(); ++i) {
+      const FileEnumerator::FileInfo& info = infos[i];
+      bool is_directory = info.IsDirectory();
+      FilePath path = directory.Append(info.GetName());
+      if (recursive_ && is_directory)
+        PostReadDirectory(path);
+      if (!(file_type_ & (is_directory ? FileEnumerator::DIRECTORIES
+                                       : FileEnumerator::FILES))) {
+        continue;
+      }
+
+      batch->push_back(Entry());
+      batch->back().path = path;
+      batch->back().info = info;
+      if (batch->size() == kMaxBatchSize) {
+        PostBatch(batch.Pass());
+        batch.reset(new EntryBatch);
+      }
+    }
+    if (!batch->empty())
+      PostBatch(batch.Pass());
+
+    OnDirectoryDone();
+  }
+
+  void PostBatch(scoped_ptr<EntryBatch> batch) {
+    origin_task_runner_->PostTask(
+        FROM_HERE, Bind(&Core::RunBatchCallback, this, Passed(&batch)));
+  }
+
+  // The batches of a directory are posted before its count is released, so
+  // the done callback, posted when the last count is released, runs after
+  // all the batches.
+  void OnDirectoryDone() {
+    if (!AtomicRefCountDec(&pending_directories_)) {
+      origin_task_runner_->PostTask(FROM_HERE,
+                                    Bind(&Core::RunDoneCallback, this));
+    }
+  }
+
+  void RunBatchCallback(scoped_ptr<EntryBatch> batch) {
+    if (!batch_callback_.is_null())
+      batch_callback_.Run(*batch);
+  }
+
+  void RunDoneCallback() {
+    if (done_callback_.is_null())
+      return;
+    Closure done_callback = done_callback_;
+    batch_callback_.Reset();
+    done_callback_.Reset();
+    done_callback.Run();
+  }
+
+  const bool recursive_;
+  const int file_type_;
+  scoped_refptr<SequencedWorkerPool> worker_pool_;
+  scoped_refptr<SingleThreadTaskRunner> origin_task_runner_;
+
+  // Only used on the origin thread.
+  BatchCallback batch_callback_;
+  Closure done_callback_;
+
+  // The directories posted and not read yet.
+  AtomicRefCount pending_directories_;
+
+  // Set when the enumerator is destroyed, so that the workers stop reading.
+  CancellationFlag cancelled_;
+
+  DISALLOW_COPY_AND_ASSIGN(Core);
+};
+
+ParallelFileEnumerator::Entry::Entry() {
+}
+
+ParallelFileEnumerator::Entry::~Entry() {
+}
+
+ParallelFileEnumerator::ParallelFileEnumerator(
+    const FilePath& root_path,
+    bool recursive,
+    int file_type,
+    const scoped_refptr<SequencedWorkerPool>& worker_pool)
+    : root_path_(root_path.StripTrailingSeparators()),
+      recursive_(recursive),
+      file_type_(file_type),
+      worker_pool_(worker_pool) {
+  DCHECK(!(file_type & FileEnumerator::INCLUDE_DOT_DOT));
+}
+
+ParallelFileEnumerator::~ParallelFileEnumerator() {
+  if (core_.get())
+    core_->Cancel();
+}
+
+void ParallelFileEnumerator::Start(const BatchCallback& batch_callback,
+                                   const Closure& done_callback) {
+  DCHECK(!core_.get());
+  core_ = new Core(recursive_, file_type_, worker_pool_, batch_callback,
+                   done_callback);
+  core_->Start(root_path_);
+}
+
+// static
+void ParallelFileEnumerator::ReadDirectory(
+    const FilePath& directory,
+    bool show_links,
+    std::vector<FileEnumerator::FileInfo>* entries) {
+  ThreadRestrictions::AssertIOAllowed();
+#if defined(OS_LINUX)
+  ScopedFD fd(HANDLE_EINTR(
+      open(directory.value().c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC)));
+  if (!fd.is_valid())
+    return;
+
+  // DirReaderLinux reads a few entries per call into a buffer on the stack,
+  // as it is used after fork(). A directory of a cache takes far fewer calls
+  // with a larger buffer.
+  const size_t kBufferSize = 32 * 1024;
+  scoped_ptr<char[]> buffer(new char[kBufferSize]);
+  for (;;) {
+    int size = HANDLE_EINTR(
+        syscall(__NR_getdents64, fd.get(), buffer.get(), kBufferSize));
+    if (size < 0) {
+      DPLOG(ERROR) << "Couldn't read " << directory.value();
+      break;
+    }
+    if (size == 0)
+      break;
+
+    for (int offset = 0; offset < size;) {
+      const linux_dirent* dirent =
+          reinterpret_cast<const linux_dirent*>(buffer.get() + offset);
+      offset += dirent->d_reclen;
+      if (!strcmp(dirent->d_name, ".") || !strcmp(dirent->d_name, ".."))
+        continue;
+
+      entries->push_back(FileEnumerator::FileInfo());
+      FileEnumerator::FileInfo* info = &entries->back();
+      info->filename_ = FilePath(dirent->d_name);
+      if (fstatat(fd.get(), dirent->d_name, &info->stat_,
+                  show_links ? AT_SYMLINK_NOFOLLOW : 0) < 0) {
+        // As FileEnumerator, keep the entry, with no information.
+        if (!(errno == ENOENT && !show_links)) {
+          DPLOG(ERROR) << "Couldn't stat "
+                       << directory.Append(dirent->d_name).value();
+        }
+        memset(&info->stat_, 0, sizeof(info->stat_));
+      }
+    }
+  }
+#else
+  int file_type = FileEnumerator::FILES | FileEnumerator::DIRECTORIES;
+#if defined(OS_POSIX)
+  if (show_links)
+    file_type |= FileEnumerator::SHOW_SYM_LINKS;
+#endif
+  FileEnumerator enumerator(directory, false, file_type);
+  for (FilePath path = enumerator.Next(); !path.empty();
+       path = enumerator.Next()) {
+    entries->push_back(enumerator.GetInfo());
+  }
+#endif
+}
+
+}  // namespace base
@@ -0,0 +1,110 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/files/parallel_file_enumerator.h"
+
+#include "base/bind.h"
+#include "base/files/file_enumerator.h"
+#include "base/files/file_util.h"
+#include "base/files/scoped_temp_dir.h"
+#include "base/message_loop/message_loop.h"
+#include "base/run_loop.h"
+#include "base/strings/stringprintf.h"
+#include "base/test/sequenced_worker_pool_owner.h"
+#include "base/time/time.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "testing/perf/perf_test.h"
+
+namespace base {
+
+namespace {
+
+// 200k files, in 16 directories of 16 subdirectories each, which is how the
+// larger caches and file systems of a profile are laid out.
+const int kDirectories = 16;
+const int kSubdirectories = 16;
+const int kFilesPerSubdirectory = 800;
+const int kFiles = kDirectories * kSubdirectories * kFilesPerSubdirectory;
+
+const size_t kWorkerThreads = 8;
+
+class ParallelFileEnumeratorPerfTest : public testing::Test {
+ public:
+  ParallelFileEnumeratorPerfTest()
+      : pool_owner_(kWorkerThreads, "ParallelFileEnumeratorPerfTest"),
+        file_count_(0),
+        bytes_(0) {}
+
+  virtual void SetUp() OVERRIDE {
+    ASSERT_TRUE(temp_dir_.CreateUniqueTempDir());
+    const std::string kContents(100, 'x');
+    for (int i = 0; i < kDirectories; ++i) {
+      for (int j = 0; j < kSubdirectories; ++j) {
+        FilePath directory = temp_dir_.path()
+                                 .AppendASCII(StringPrintf("%02x", i))
+                                 .AppendASCII(StringPrintf("%02x", j));
+        ASSERT_TRUE(CreateDirectory(directory));
+        for (int k = 0; k < kFilesPerSubdirectory; ++k) {
+          FilePath file = directory.AppendASCII(StringPrintf("%016x_0", k));
+          ASSERT_EQ(static_cast<int>(kContents.size()),
+                    WriteFile(file, kContents.data(), kContents.size()));
+        }
+      }
+    }
+  }
+
+  virtual void TearDown() OVERRIDE {
+    pool_owner_.pool()->Shutdown();
+  }
+
+  void OnBatch(const ParallelFileEnumerator::EntryBatch& batch) {
+    file_count_ += static_cast<int>(batch.size());
+    for (size_t i = 0; i < batch.size(); ++i)
+      bytes_ += batch[i].info.GetSize();
+  }
+
+ protected:
+  void Report(const std::string& trace, TimeTicks start) {
+    double ms = (TimeTicks::Now() - start).InMillisecondsF();
+    EXPECT_EQ(kFiles, file_count_);
+    EXPECT_EQ(static_cast<int64>(kFiles) * 100, bytes_);
+    perf_test::PrintResult("enumerate_200k_files", "", trace, ms, "ms", true);
+    file_count_ = 0;
+    bytes_ = 0;
+  }
+
+  MessageLoop message_loop_;
+  ScopedTempDir temp_dir_;
+  SequencedWorkerPoolOwner pool_owner_;
+
+  int file_count_;
+  int64 bytes_;
+};
+
+}  // namespace
+
+// The directories are in the page cache, having just been written, so this
+// measures the system calls and the work around them rather than the disk.
+TEST_F(ParallelFileEnumeratorPerfTest, EnumerateTree) {
+  TimeTicks start = TimeTicks::Now();
+  FileEnumerator enumerator(temp_dir_.path(), true, FileEnumerator::FILES);
+  for (FilePath path = enumerator.Next(); !path.empty();
+       path = enumerator.Next()) {
+    ++file_count_;
+    bytes_ += enumerator.GetInfo().GetSize();
+  }
+  Report("FileEnumerator", start);
+
+  start = TimeTicks::Now();
+  ParallelFileEnumerator parallel_enumerator(
+      temp_dir_.path(), true, FileEnumerator::FILES, pool_owner_.pool());
+  RunLoop run_loop;
+  parallel_enumerator.Start(
+      Bind(&ParallelFileEnumeratorPerfTest::OnBatch, Unretained(this)),
+      run_loop.QuitClosure());
+  run_loop.Run();
+  Report("ParallelFileEnumerator", start);
+}
+
+}  // namespace base
@@ -0,0 +1,187 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/files/parallel_file_enumerator.h"
+
+#include <set>
+
+#include "base/bind.h"
+#include "base/files/file_enumerator.h"
+#include "base/files/file_util.h"
+#include "base/files/scoped_temp_dir.h"
+#include "base/message_loop/message_loop.h"
+#include "base/run_loop.h"
+#include "base/strings/stringprintf.h"
+#include "base/test/sequenced_worker_pool_owner.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace base {
+
+namespace {
+
+class ParallelFileEnumeratorTest : public testing::Test {
+ public:
+  ParallelFileEnumeratorTest()
+      : pool_owner_(4, "ParallelFileEnumeratorTest"),
+        batch_count_(0),
+        done_count_(0) {}
+
+  virtual void SetUp() OVERRIDE {
+    ASSERT_TRUE(temp_dir_.CreateUniqueTempDir());
+  }
+
+  virtual void TearDown() OVERRIDE {
+    pool_owner_.pool()->Shutdown();
+  }
+
+  void OnBatch(const ParallelFileEnumerator::EntryBatch& batch) {
+    EXPECT_EQ(0, done_count_);
+    EXPECT_FALSE(batch.empty());
+    EXPECT_LE(batch.size(),
+              static_cast<size_t>(ParallelFileEnumerator::kMaxBatchSize));
+    ++batch_count_;
+    for (size_t i = 0; i < batch.size(); ++i) {
+      EXPECT_EQ(batch[i].info.GetName(), batch[i].path.BaseName());
+      EXPECT_TRUE(paths_.insert(batch[i].path).second);
+      sizes_.insert(batch[i].info.IsDirectory() ? -1
+                                                : batch[i].info.GetSize());
+    }
+  }
+
+  void OnDone(const Closure& quit_closure) {
+    ++done_count_;
+    quit_closure.Run();
+  }
+
+ protected:
+  const FilePath& root() const { return temp_dir_.path(); }
+
+  void CreateFile(const FilePath& path, const std::string& contents) {
+    ASSERT_TRUE(CreateDirectory(path.DirName()));
+    ASSERT_EQ(static_cast<int>(contents.size()),
+              WriteFile(path, contents.data(), contents.size()));
+  }
+
+  // Runs a ParallelFileEnumerator to completion.
+  void Enumerate(const FilePath& root_path, bool recursive, int file_type) {
+    ParallelFileEnumerator enumerator(root_path, recursive, file_type,
+                                      pool_owner_.pool());
+    RunLoop run_loop;
+    enumerator.Start(
+        Bind(&ParallelFileEnumeratorTest::OnBatch, Unretained(this)),
+        Bind(&ParallelFileEnumeratorTest::OnDone, Unretained(this),
+             run_loop.QuitClosure()));
+    run_loop.Run();
+    EXPECT_EQ(1, done_count_);
+  }
+
+  // The paths FileEnumerator finds.
+  std::set<FilePath> Expected(const FilePath& root_path,
+                              bool recursive,
+                              int file_type) {
+    std::set<FilePath> paths;
+    FileEnumerator enumerator(root_path, recursive, file_type);
+    for (FilePath path = enumerator.Next(); !path.empty();
+         path = enumerator.Next()) {
+      paths.insert(path);
+    }
+    return paths;
+  }
+
+  MessageLoop message_loop_;
+  ScopedTempDir temp_dir_;
+  SequencedWorkerPoolOwner pool_owner_;
+
+  std::set<FilePath> paths_;
+  std::multiset<int64> sizes_;
+  int batch_count_;
+  int done_count_;
+};
+
+void ExpectNotCalled() {
+  ADD_FAILURE();
+}
+
+}  // namespace
+
+TEST_F(ParallelFileEnumeratorTest, Empty) {
+  Enumerate(root(), true,
+            FileEnumerator::FILES | FileEnumerator::DIRECTORIES);
+  EXPECT_TRUE(paths_.empty());
+  EXPECT_EQ(0, batch_count_);
+}
+
+TEST_F(ParallelFileEnumeratorTest, MissingRoot) {
+  Enumerate(root().AppendASCII("missing"), true, FileEnumerator::FILES);
+  EXPECT_TRUE(paths_.empty());
+}
+
+TEST_F(ParallelFileEnumeratorTest, Tree) {
+  CreateFile(root().AppendASCII("a"), "1");
+  CreateFile(root().AppendASCII("b"), "22");
+  CreateFile(root().AppendASCII("dir1").AppendASCII("c"), "333");
+  CreateFile(root().AppendASCII("dir1").AppendASCII("dir2").AppendASCII("d"),
+             "4444");
+  ASSERT_TRUE(CreateDirectory(root().AppendASCII("dir1").AppendASCII("e")));
+  ASSERT_TRUE(CreateDirectory(root().AppendASCII("f")));
+
+  const int kFileTypes[] = {
+    FileEnumerator::FILES,
+    FileEnumerator::DIRECTORIES,
+    FileEnumerator::FILES | FileEnumerator::DIRECTORIES,
+  };
+  for (size_t i = 0; i < arraysize(kFileTypes); ++i) {
+    for (int recursive = 0; recursive < 2; ++recursive) {
+      paths_.clear();
+      sizes_.clear();
+      done_count_ = 0;
+      Enumerate(root(), recursive != 0, kFileTypes[i]);
+      EXPECT_EQ(Expected(root(), recursive != 0, kFileTypes[i]), paths_)
+          << "file_type " << kFileTypes[i] << " recursive " << recursive;
+    }
+  }
+
+  // The sizes come with the paths.
+  EXPECT_EQ(4u, sizes_.count(-1));
+  EXPECT_EQ(1u, sizes_.count(1));
+  EXPECT_EQ(1u, sizes_.count(4));
+}
+
+// The paths keep the form of the root path.
+TEST_F(ParallelFileEnumeratorTest, TrailingSeparator) {
+  CreateFile(root().AppendASCII("dir").AppendASCII("a"), "1");
+  FilePath root_path = root().AsEndingWithSeparator();
+  Enumerate(root_path, true, FileEnumerator::FILES);
+  ASSERT_EQ(1u, paths_.size());
+  EXPECT_EQ(root().AppendASCII("dir").AppendASCII("a"), *paths_.begin());
+}
+
+TEST_F(ParallelFileEnumeratorTest, Batches) {
+  const int kFiles = 2 * ParallelFileEnumerator::kMaxBatchSize + 10;
+  for (int i = 0; i < kFiles; ++i)
+    CreateFile(root().AppendASCII(StringPrintf("file%04d", i)), "");
+  Enumerate(root(), true, FileEnumerator::FILES);
+  EXPECT_EQ(static_cast<size_t>(kFiles), paths_.size());
+  EXPECT_EQ(3, batch_count_);
+}
+
+// Destroying the enumerator stops it, without running its callbacks.
+TEST_F(ParallelFileEnumeratorTest, Cancel) {
+  for (int i = 0; i < 20; ++i) {
+    CreateFile(root().AppendASCII(StringPrintf("dir%02d", i))
+                   .AppendASCII("file"), "");
+  }
+  {
+    ParallelFileEnumerator enumerator(root(), true, FileEnumerator::FILES,
+                                      pool_owner_.pool());
+    enumerator.Start(
+        Bind(&ParallelFileEnumeratorTest::OnBatch, Unretained(this)),
+        Bind(&ExpectNotCalled));
+  }
+  pool_owner_.pool()->FlushForTesting();
+  RunLoop().RunUntilIdle();
+  EXPECT_EQ(0, batch_count_);
+}
+
+}  // namespace base
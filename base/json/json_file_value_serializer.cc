@@ -5,6 +5,8 @@
 #include "base/json/json_file_value_serializer.h"
 
 #include "base/files/file_util.h"
+#include "base/files/memory_mapped_file.h"
+#include "base/json/json_reader.h"
 #include "base/json/json_string_value_serializer.h"
 #include "base/logging.h"
 
@@ -82,6 +84,19 @@ const char* JSONFileValueSerializer::GetErrorMessageForCode(int error_code) {
 
 base::Value* JSONFileValueSerializer::Deserialize(int* error_code,
                                                   std::string* error_str) {
+  if (map_file_) {
+    // An empty file can't be mapped, and the errors of a file that can't be
+    // are worked out by reading it below.
+    scoped_ptr<base::MemoryMappedFile> mapped_file(new base::MemoryMappedFile);
+    if (mapped_file->Initialize(json_file_path_)) {
+      return base::JSONReader::ReadMappedFileAndReturnError(
+          mapped_file.Pass(),
+          allow_trailing_comma_ ? base::JSON_ALLOW_TRAILING_COMMAS :
+              base::JSON_PARSE_RFC,
+          error_code, error_str);
+    }
+  }
+
   std::string json_string;
   int error = ReadFileToString(&json_string);
   if (error != JSON_NO_ERROR) {
@@ -20,7 +20,8 @@ class BASE_EXPORT JSONFileValueSerializer : public base::ValueSerializer {
   // serializer will attempt to create the file at the specified location.
   explicit JSONFileValueSerializer(const base::FilePath& json_file_path)
     : json_file_path_(json_file_path),
-      allow_trailing_comma_(false) {}
+      allow_trailing_comma_(false),
+      map_file_(false) {}
 
   virtual ~JSONFileValueSerializer() {}
 
@@ -71,11 +72,20 @@ class BASE_EXPORT JSONFileValueSerializer : public base::ValueSerializer {
     allow_trailing_comma_ = new_value;
   }
 
+  // If set, Deserialize() maps the file into memory and parses it in place,
+  // rather than reading it into a string and parsing a copy of that. The file
+  // is only mapped for the parse. Empty and unmappable files are read as
+  // usual.
+  void set_map_file(bool new_value) {
+    map_file_ = new_value;
+  }
+
  private:
   bool SerializeInternal(const base::Value& root, bool omit_binary_values);
 
   base::FilePath json_file_path_;
   bool allow_trailing_comma_;
+  bool map_file_;
 
   // A wrapper for ReadFileToString which returns a non-zero JsonFileError if
   // there were file errors.
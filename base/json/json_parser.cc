@@ -4,6 +4,11 @@
 
 #include "base/json/json_parser.h"
 
+#include <algorithm>
+#include <vector>
+
+#include "base/auto_reset.h"
+#include "base/files/memory_mapped_file.h"
 #include "base/float_util.h"
 #include "base/logging.h"
 #include "base/memory/scoped_ptr.h"
@@ -25,6 +30,64 @@ const int kStackMaxDepth = 100;
 
 const int32 kExtendedASCIIStart = 0x80;
 
+// Sizes of the blocks JSONValueArena carves Values out of. Blocks start small
+// so that parsing tiny documents stays cheap, and double up to the maximum.
+const size_t kArenaInitialBlockSize = 4 * 1024;
+const size_t kArenaMaxBlockSize = 256 * 1024;
+
+// All arena allocations are rounded up to this, which is enough for any Value.
+const size_t kArenaAlignment = 16;
+
+}  // namespace
+
+// A bump allocator that backs the Value tree when JSON_USE_ARENA is used.
+// Memory is never reused; it is all returned when the arena is destroyed,
+// which must happen after every Value allocated from it has been destroyed.
+class JSONValueArena {
+ public:
+  JSONValueArena()
+      : next_block_size_(kArenaInitialBlockSize),
+        current_(NULL),
+        remaining_(0) {
+  }
+
+  ~JSONValueArena() {
+    for (size_t i = 0; i < blocks_.size(); ++i)
+      delete[] blocks_[i];
+  }
+
+  void* Allocate(size_t size) {
+    size = (size + kArenaAlignment - 1) & ~(kArenaAlignment - 1);
+    if (size > remaining_) {
+      // Oversized requests get a block of their own so that the rest of the
+      // current block is not wasted.
+      if (size > next_block_size_ / 4) {
+        char* block = new char[size];
+        blocks_.push_back(block);
+        return block;
+      }
+      current_ = new char[next_block_size_];
+      blocks_.push_back(current_);
+      remaining_ = next_block_size_;
+      next_block_size_ = std::min(next_block_size_ * 2, kArenaMaxBlockSize);
+    }
+    void* result = current_;
+    current_ += size;
+    remaining_ -= size;
+    return result;
+  }
+
+ private:
+  std::vector<char*> blocks_;
+  size_t next_block_size_;
+  char* current_;
+  size_t remaining_;
+
+  DISALLOW_COPY_AND_ASSIGN(JSONValueArena);
+};
+
+namespace {
+
 // This and the class below are used to own the JSON input string for when
 // string tokens are stored as StringPiece instead of std::string. This
 // optimization avoids about 2/3rds of string memory copies. The constructor
@@ -32,11 +95,20 @@ const int32 kExtendedASCIIStart = 0x80;
 // the new instance.
 class DictionaryHiddenRootValue : public base::DictionaryValue {
  public:
-  DictionaryHiddenRootValue(std::string* json, Value* root) : json_(json) {
+  DictionaryHiddenRootValue(std::string* json,
+                            JSONValueArena* arena,
+                            Value* root)
+      : json_(json),
+        arena_(arena) {
     DCHECK(root->IsType(Value::TYPE_DICTIONARY));
     DictionaryValue::Swap(static_cast<DictionaryValue*>(root));
   }
 
+  virtual ~DictionaryHiddenRootValue() {
+    // The children may live in |arena_|, so destroy them while it is alive.
+    Clear();
+  }
+
   virtual void Swap(DictionaryValue* other) OVERRIDE {
     DVLOG(1) << "Swap()ing a DictionaryValue inefficiently.";
 
@@ -48,6 +120,7 @@ class DictionaryHiddenRootValue : public base::DictionaryValue {
     // Then erase the contents of the current dictionary and swap in the
     // new contents, originally from |other|.
     Clear();
+    arena_.reset();
     json_.reset();
     DictionaryValue::Swap(copy.get());
   }
@@ -76,17 +149,27 @@ class DictionaryHiddenRootValue : public base::DictionaryValue {
 
  private:
   scoped_ptr<std::string> json_;
+  scoped_ptr<JSONValueArena> arena_;
 
   DISALLOW_COPY_AND_ASSIGN(DictionaryHiddenRootValue);
 };
 
 class ListHiddenRootValue : public base::ListValue {
  public:
-  ListHiddenRootValue(std::string* json, Value* root) : json_(json) {
+  ListHiddenRootValue(std::string* json,
+                      JSONValueArena* arena,
+                      Value* root)
+      : json_(json),
+        arena_(arena) {
     DCHECK(root->IsType(Value::TYPE_LIST));
     ListValue::Swap(static_cast<ListValue*>(root));
   }
 
+  virtual ~ListHiddenRootValue() {
+    // The children may live in |arena_|, so destroy them while it is alive.
+    Clear();
+  }
+
   virtual void Swap(ListValue* other) OVERRIDE {
     DVLOG(1) << "Swap()ing a ListValue inefficiently.";
 
@@ -98,6 +181,7 @@ class ListHiddenRootValue : public base::ListValue {
     // Then erase the contents of the current list and swap in the new contents,
     // originally from |other|.
     Clear();
+    arena_.reset();
     json_.reset();
     ListValue::Swap(copy.get());
   }
@@ -122,6 +206,7 @@ class ListHiddenRootValue : public base::ListValue {
 
  private:
   scoped_ptr<std::string> json_;
+  scoped_ptr<JSONValueArena> arena_;
 
   DISALLOW_COPY_AND_ASSIGN(ListHiddenRootValue);
 };
@@ -161,6 +246,48 @@ class JSONStringValue : public base::Value {
   DISALLOW_COPY_AND_ASSIGN(JSONStringValue);
 };
 
+// A Value of type T placed in a JSONValueArena. Deleting one runs the
+// destructors as usual but leaves the memory to the arena. Like
+// JSONStringValue, these can only be stored in a child of hidden root.
+template <typename T>
+class ArenaValue : public T {
+ public:
+  ArenaValue() {}
+
+  template <typename Arg>
+  explicit ArenaValue(const Arg& arg) : T(arg) {}
+
+  static void* operator new(size_t size, JSONValueArena* arena) {
+    return arena->Allocate(size);
+  }
+  static void operator delete(void* ptr) {}
+  static void operator delete(void* ptr, JSONValueArena* arena) {}
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(ArenaValue);
+};
+
+// Allocates a T from |arena|, or from the heap if |arena| is NULL.
+template <typename T>
+T* NewValue(JSONValueArena* arena) {
+  if (arena)
+    return new (arena) ArenaValue<T>();
+  return new T();
+}
+
+template <typename T, typename Arg>
+T* NewValue(JSONValueArena* arena, const Arg& arg) {
+  if (arena)
+    return new (arena) ArenaValue<T>(arg);
+  return new T(arg);
+}
+
+Value* NewNullValue(JSONValueArena* arena) {
+  if (arena)
+    return new (arena) ArenaValue<Value>(Value::TYPE_NULL);
+  return Value::CreateNullValue();
+}
+
 // Simple class that checks for maximum recursion/"stack overflow."
 class StackMarker {
  public:
@@ -193,6 +320,8 @@ JSONParser::JSONParser(int options)
       stack_depth_(0),
       line_number_(0),
       index_last_line_(0),
+      delegate_(NULL),
+      event_state_(EVENT_EXPECT_ROOT),
       error_code_(JSONReader::JSON_NO_ERROR),
       error_line_(0),
       error_column_(0) {
@@ -208,12 +337,36 @@ Value* JSONParser::Parse(const StringPiece& input) {
   // be used anywhere.
   if (!(options_ & JSON_DETACHABLE_CHILDREN)) {
     input_copy.reset(new std::string(input.as_string()));
-    start_pos_ = input_copy->data();
-  } else {
-    start_pos_ = input.data();
+    StringPiece copied_input(*input_copy);
+    return ParseOwnedInput(copied_input, input_copy.Pass());
   }
+  return ParseOwnedInput(input, scoped_ptr<std::string>());
+}
+
+Value* JSONParser::ParseMappedFile(scoped_ptr<MemoryMappedFile> mapped_file) {
+  DCHECK(mapped_file->IsValid());
+  // The mapping is MAP_SHARED, so a value pointing into it would fault if the
+  // file were truncated. Parse as if the children were detachable, which
+  // copies every string out of the input, and unmap the file on return.
+  AutoReset<int> detachable_children(&options_,
+                                     options_ | JSON_DETACHABLE_CHILDREN);
+  StringPiece input(reinterpret_cast<const char*>(mapped_file->data()),
+                    mapped_file->length());
+  return ParseOwnedInput(input, scoped_ptr<std::string>());
+}
+
+Value* JSONParser::ParseOwnedInput(const StringPiece& input,
+                                   scoped_ptr<std::string> input_copy) {
+  start_pos_ = input.data();
   pos_ = start_pos_;
   end_pos_ = start_pos_ + input.length();
+
+  // The arena relies on a hidden root to own it, just like StringPiece does.
+  interned_keys_.clear();
+  arena_.reset();
+  if ((options_ & JSON_USE_ARENA) && !(options_ & JSON_DETACHABLE_CHILDREN))
+    arena_.reset(new JSONValueArena);
+
   index_ = 0;
   line_number_ = 1;
   index_last_line_ = 0;
@@ -249,13 +402,15 @@ Value* JSONParser::Parse(const StringPiece& input) {
   // hidden root.
   if (!(options_ & JSON_DETACHABLE_CHILDREN)) {
     if (root->IsType(Value::TYPE_DICTIONARY)) {
-      return new DictionaryHiddenRootValue(input_copy.release(), root.get());
+      return new DictionaryHiddenRootValue(input_copy.release(),
+                                           arena_.release(), root.get());
     } else if (root->IsType(Value::TYPE_LIST)) {
-      return new ListHiddenRootValue(input_copy.release(), root.get());
-    } else if (root->IsType(Value::TYPE_STRING)) {
-      // A string type could be a JSONStringValue, but because there's no
-      // corresponding HiddenRootValue, the memory will be lost. Deep copy to
-      // preserve it.
+      return new ListHiddenRootValue(input_copy.release(), arena_.release(),
+                                     root.get());
+    } else if (root->IsType(Value::TYPE_STRING) || arena_) {
+      // A string type could be a JSONStringValue, and in arena mode any value
+      // lives in the arena, but because there's no corresponding
+      // HiddenRootValue, the memory will be lost. Deep copy to preserve it.
       return root->DeepCopy();
     }
   }
@@ -273,6 +428,63 @@ std::string JSONParser::GetErrorMessage() const {
       JSONReader::ErrorCodeToString(error_code_));
 }
 
+void JSONParser::StartEvents(JSONStreamReader::Delegate* delegate) {
+  delegate_ = delegate;
+  event_state_ = EVENT_EXPECT_ROOT;
+  event_stack_.clear();
+
+  start_pos_ = NULL;
+  pos_ = NULL;
+  end_pos_ = NULL;
+  index_ = 0;
+  line_number_ = 1;
+  index_last_line_ = 0;
+
+  error_code_ = JSONReader::JSON_NO_ERROR;
+  error_line_ = 0;
+  error_column_ = 0;
+}
+
+bool JSONParser::ParseEventChunk(const StringPiece& input) {
+  DCHECK(delegate_);
+
+  // Columns are computed relative to |index_last_line_|, so rebase it onto the
+  // new window to keep line and column numbers continuous across windows.
+  index_last_line_ -= index_;
+  index_ = 0;
+  start_pos_ = input.data();
+  pos_ = start_pos_;
+  end_pos_ = start_pos_ + input.length();
+
+  // Skip a UTF-8 Byte-Order-Mark at the start of the document, like Parse().
+  if (event_state_ == EVENT_EXPECT_ROOT && CanConsume(3) &&
+      static_cast<uint8>(*pos_) == 0xEF &&
+      static_cast<uint8>(*(pos_ + 1)) == 0xBB &&
+      static_cast<uint8>(*(pos_ + 2)) == 0xBF) {
+    NextNChars(3);
+  }
+
+  Token token = GetNextToken();
+  while (token != T_END_OF_INPUT) {
+    if (!ParseEventToken(token))
+      return false;
+    NextChar();
+    token = GetNextToken();
+  }
+  return true;
+}
+
+bool JSONParser::FinishEvents() {
+  if (event_state_ == EVENT_DONE)
+    return true;
+
+  ReportError(event_state_ == EVENT_EXPECT_ROOT ?
+                  JSONReader::JSON_UNEXPECTED_TOKEN :
+                  JSONReader::JSON_SYNTAX_ERROR,
+              1);
+  return false;
+}
+
 // StringBuilder ///////////////////////////////////////////////////////////////
 
 JSONParser::StringBuilder::StringBuilder()
@@ -489,7 +701,7 @@ Value* JSONParser::ConsumeDictionary() {
     return NULL;
   }
 
-  scoped_ptr<DictionaryValue> dict(new DictionaryValue);
+  scoped_ptr<DictionaryValue> dict(NewValue<DictionaryValue>(arena_.get()));
 
   NextChar();
   Token token = GetNextToken();
@@ -521,7 +733,7 @@ Value* JSONParser::ConsumeDictionary() {
       return NULL;
     }
 
-    dict->SetWithoutPathExpansion(key.AsString(), value);
+    dict->SetWithoutPathExpansion(InternKey(&key), value);
 
     NextChar();
     token = GetNextToken();
@@ -553,7 +765,7 @@ Value* JSONParser::ConsumeList() {
     return NULL;
   }
 
-  scoped_ptr<ListValue> list(new ListValue);
+  scoped_ptr<ListValue> list(NewValue<ListValue>(arena_.get()));
 
   NextChar();
   Token token = GetNextToken();
@@ -592,14 +804,26 @@ Value* JSONParser::ConsumeString() {
   // Create the Value representation, using a hidden root, if configured
   // to do so, and if the string can be represented by StringPiece.
   if (string.CanBeStringPiece() && !(options_ & JSON_DETACHABLE_CHILDREN)) {
-    return new JSONStringValue(string.AsStringPiece());
+    return NewValue<JSONStringValue>(arena_.get(), string.AsStringPiece());
   } else {
     if (string.CanBeStringPiece())
       string.Convert();
-    return new StringValue(string.AsString());
+    return NewValue<StringValue>(arena_.get(), string.AsString());
   }
 }
 
+const std::string& JSONParser::InternKey(StringBuilder* key) {
+  if (!arena_ || !key->CanBeStringPiece())
+    return key->AsString();
+
+  // The pieces point into the input copy, which outlives the parse.
+  StringPiece piece = key->AsStringPiece();
+  hash_map<StringPiece, std::string>::iterator it = interned_keys_.find(piece);
+  if (it == interned_keys_.end())
+    it = interned_keys_.insert(std::make_pair(piece, piece.as_string())).first;
+  return it->second;
+}
+
 bool JSONParser::ConsumeStringRaw(StringBuilder* out) {
   if (*pos_ != '"') {
     ReportError(JSONReader::JSON_UNEXPECTED_TOKEN, 1);
@@ -804,6 +1028,24 @@ void JSONParser::DecodeUTF8(const int32& point, StringBuilder* dest) {
 }
 
 Value* JSONParser::ConsumeNumber() {
+  StringPiece num_string;
+  if (!ConsumeNumberRaw(&num_string))
+    return NULL;
+
+  int num_int;
+  if (StringToInt(num_string, &num_int))
+    return NewValue<FundamentalValue>(arena_.get(), num_int);
+
+  double num_double;
+  if (base::StringToDouble(num_string.as_string(), &num_double) &&
+      IsFinite(num_double)) {
+    return NewValue<FundamentalValue>(arena_.get(), num_double);
+  }
+
+  return NULL;
+}
+
+bool JSONParser::ConsumeNumberRaw(StringPiece* out) {
   const char* num_start = pos_;
   const int start_index = index_;
   int end_index = start_index;
@@ -813,7 +1055,7 @@ Value* JSONParser::ConsumeNumber() {
 
   if (!ReadInt(false)) {
     ReportError(JSONReader::JSON_SYNTAX_ERROR, 1);
-    return NULL;
+    return false;
   }
   end_index = index_;
 
@@ -821,12 +1063,12 @@ Value* JSONParser::ConsumeNumber() {
   if (*pos_ == '.') {
     if (!CanConsume(1)) {
       ReportError(JSONReader::JSON_SYNTAX_ERROR, 1);
-      return NULL;
+      return false;
     }
     NextChar();
     if (!ReadInt(true)) {
       ReportError(JSONReader::JSON_SYNTAX_ERROR, 1);
-      return NULL;
+      return false;
     }
     end_index = index_;
   }
@@ -838,7 +1080,7 @@ Value* JSONParser::ConsumeNumber() {
       NextChar();
     if (!ReadInt(true)) {
       ReportError(JSONReader::JSON_SYNTAX_ERROR, 1);
-      return NULL;
+      return false;
     }
     end_index = index_;
   }
@@ -858,25 +1100,14 @@ Value* JSONParser::ConsumeNumber() {
       break;
     default:
       ReportError(JSONReader::JSON_SYNTAX_ERROR, 1);
-      return NULL;
+      return false;
   }
 
   pos_ = exit_pos;
   index_ = exit_index;
 
-  StringPiece num_string(num_start, end_index - start_index);
-
-  int num_int;
-  if (StringToInt(num_string, &num_int))
-    return new FundamentalValue(num_int);
-
-  double num_double;
-  if (base::StringToDouble(num_string.as_string(), &num_double) &&
-      IsFinite(num_double)) {
-    return new FundamentalValue(num_double);
-  }
-
-  return NULL;
+  *out = StringPiece(num_start, end_index - start_index);
+  return true;
 }
 
 bool JSONParser::ReadInt(bool allow_leading_zeros) {
@@ -899,6 +1130,21 @@ bool JSONParser::ReadInt(bool allow_leading_zeros) {
 }
 
 Value* JSONParser::ConsumeLiteral() {
+  const char first = *pos_;
+  if (!ConsumeLiteralRaw())
+    return NULL;
+
+  switch (first) {
+    case 't':
+      return NewValue<FundamentalValue>(arena_.get(), true);
+    case 'f':
+      return NewValue<FundamentalValue>(arena_.get(), false);
+    default:
+      return NewNullValue(arena_.get());
+  }
+}
+
+bool JSONParser::ConsumeLiteralRaw() {
   switch (*pos_) {
     case 't': {
       const char* kTrueLiteral = "true";
@@ -906,10 +1152,10 @@ Value* JSONParser::ConsumeLiteral() {
       if (!CanConsume(kTrueLen - 1) ||
           !StringsAreEqual(pos_, kTrueLiteral, kTrueLen)) {
         ReportError(JSONReader::JSON_SYNTAX_ERROR, 1);
-        return NULL;
+        return false;
       }
       NextNChars(kTrueLen - 1);
-      return new FundamentalValue(true);
+      return true;
     }
     case 'f': {
       const char* kFalseLiteral = "false";
@@ -917,10 +1163,10 @@ Value* JSONParser::ConsumeLiteral() {
       if (!CanConsume(kFalseLen - 1) ||
           !StringsAreEqual(pos_, kFalseLiteral, kFalseLen)) {
         ReportError(JSONReader::JSON_SYNTAX_ERROR, 1);
-        return NULL;
+        return false;
       }
       NextNChars(kFalseLen - 1);
-      return new FundamentalValue(false);
+      return true;
     }
     case 'n': {
       const char* kNullLiteral = "null";
@@ -928,17 +1174,170 @@ Value* JSONParser::ConsumeLiteral() {
       if (!CanConsume(kNullLen - 1) ||
           !StringsAreEqual(pos_, kNullLiteral, kNullLen)) {
         ReportError(JSONReader::JSON_SYNTAX_ERROR, 1);
-        return NULL;
+        return false;
       }
       NextNChars(kNullLen - 1);
-      return Value::CreateNullValue();
+      return true;
     }
     default:
       ReportError(JSONReader::JSON_UNEXPECTED_TOKEN, 1);
-      return NULL;
+      return false;
+  }
+}
+
+bool JSONParser::ParseEventToken(Token token) {
+  switch (event_state_) {
+    case EVENT_EXPECT_ROOT:
+    case EVENT_EXPECT_PAIR_VALUE:
+      return ConsumeEventValue(token);
+
+    case EVENT_EXPECT_LIST_VALUE:
+      if (token == T_ARRAY_END) {
+        if (!(options_ & JSON_ALLOW_TRAILING_COMMAS)) {
+          ReportError(JSONReader::JSON_TRAILING_COMMA, 1);
+          return false;
+        }
+        return CloseEventContainer(token);
+      }
+      return ConsumeEventValue(token);
+
+    case EVENT_EXPECT_LIST_VALUE_OR_END:
+      if (token == T_ARRAY_END)
+        return CloseEventContainer(token);
+      return ConsumeEventValue(token);
+
+    case EVENT_EXPECT_KEY:
+    case EVENT_EXPECT_KEY_OR_END: {
+      if (token == T_OBJECT_END) {
+        if (event_state_ == EVENT_EXPECT_KEY &&
+            !(options_ & JSON_ALLOW_TRAILING_COMMAS)) {
+          ReportError(JSONReader::JSON_TRAILING_COMMA, 1);
+          return false;
+        }
+        return CloseEventContainer(token);
+      }
+      if (token != T_STRING) {
+        ReportError(JSONReader::JSON_UNQUOTED_DICTIONARY_KEY, 1);
+        return false;
+      }
+
+      StringBuilder key;
+      if (!ConsumeStringRaw(&key))
+        return false;
+      event_state_ = EVENT_EXPECT_PAIR_SEPARATOR;
+      return delegate_->OnKey(key.CanBeStringPiece() ?
+                                  key.AsStringPiece() :
+                                  StringPiece(key.AsString()));
+    }
+
+    case EVENT_EXPECT_PAIR_SEPARATOR:
+      if (token != T_OBJECT_PAIR_SEPARATOR) {
+        ReportError(JSONReader::JSON_SYNTAX_ERROR, 1);
+        return false;
+      }
+      event_state_ = EVENT_EXPECT_PAIR_VALUE;
+      return true;
+
+    case EVENT_EXPECT_SEPARATOR_OR_END: {
+      bool in_dictionary = event_stack_.back() == T_OBJECT_BEGIN;
+      if (token == T_LIST_SEPARATOR) {
+        event_state_ =
+            in_dictionary ? EVENT_EXPECT_KEY : EVENT_EXPECT_LIST_VALUE;
+        return true;
+      }
+      if (token == (in_dictionary ? T_OBJECT_END : T_ARRAY_END))
+        return CloseEventContainer(token);
+      ReportError(JSONReader::JSON_SYNTAX_ERROR, in_dictionary ? 0 : 1);
+      return false;
+    }
+
+    case EVENT_DONE:
+      ReportError(JSONReader::JSON_UNEXPECTED_DATA_AFTER_ROOT, 1);
+      return false;
+  }
+
+  NOTREACHED();
+  return false;
+}
+
+bool JSONParser::ConsumeEventValue(Token token) {
+  switch (token) {
+    case T_OBJECT_BEGIN:
+    case T_ARRAY_BEGIN:
+      // Same limit as the StackMarker of the recursive parser.
+      if (static_cast<int>(event_stack_.size()) + 1 >= kStackMaxDepth) {
+        ReportError(JSONReader::JSON_TOO_MUCH_NESTING, 1);
+        return false;
+      }
+      event_stack_.push_back(token);
+      if (token == T_OBJECT_BEGIN) {
+        event_state_ = EVENT_EXPECT_KEY_OR_END;
+        return delegate_->OnStartDictionary();
+      }
+      event_state_ = EVENT_EXPECT_LIST_VALUE_OR_END;
+      return delegate_->OnStartList();
+
+    case T_STRING: {
+      StringBuilder string;
+      if (!ConsumeStringRaw(&string))
+        return false;
+      FinishEventValue();
+      return delegate_->OnString(string.CanBeStringPiece() ?
+                                     string.AsStringPiece() :
+                                     StringPiece(string.AsString()));
+    }
+
+    case T_NUMBER: {
+      StringPiece num_string;
+      if (!ConsumeNumberRaw(&num_string))
+        return false;
+      FinishEventValue();
+
+      int num_int;
+      if (StringToInt(num_string, &num_int))
+        return delegate_->OnInteger(num_int);
+
+      double num_double;
+      if (base::StringToDouble(num_string.as_string(), &num_double) &&
+          IsFinite(num_double)) {
+        return delegate_->OnDouble(num_double);
+      }
+
+      ReportError(JSONReader::JSON_SYNTAX_ERROR, 1);
+      return false;
+    }
+
+    case T_BOOL_TRUE:
+    case T_BOOL_FALSE:
+    case T_NULL:
+      if (!ConsumeLiteralRaw())
+        return false;
+      FinishEventValue();
+      if (token == T_NULL)
+        return delegate_->OnNull();
+      return delegate_->OnBoolean(token == T_BOOL_TRUE);
+
+    default:
+      ReportError(JSONReader::JSON_UNEXPECTED_TOKEN, 1);
+      return false;
   }
 }
 
+bool JSONParser::CloseEventContainer(Token token) {
+  DCHECK(!event_stack_.empty());
+  bool is_dictionary = event_stack_.back() == T_OBJECT_BEGIN;
+  DCHECK_EQ(is_dictionary, token == T_OBJECT_END);
+  event_stack_.pop_back();
+  FinishEventValue();
+  return is_dictionary ? delegate_->OnEndDictionary() :
+                         delegate_->OnEndList();
+}
+
+void JSONParser::FinishEventValue() {
+  event_state_ =
+      event_stack_.empty() ? EVENT_DONE : EVENT_EXPECT_SEPARATOR_OR_END;
+}
+
 // static
 bool JSONParser::StringsAreEqual(const char* one, const char* two, size_t len) {
   return strncmp(one, two, len) == 0;
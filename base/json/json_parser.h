@@ -6,11 +6,15 @@
 #define BASE_JSON_JSON_PARSER_H_
 
 #include <string>
+#include <vector>
 
 #include "base/base_export.h"
 #include "base/basictypes.h"
 #include "base/compiler_specific.h"
+#include "base/containers/hash_tables.h"
 #include "base/json/json_reader.h"
+#include "base/json/json_stream_reader.h"
+#include "base/memory/scoped_ptr.h"
 #include "base/strings/string_piece.h"
 
 #if !defined(OS_CHROMEOS)
@@ -35,16 +39,22 @@ friend class test_case_name##_##test_name##_Test
 #endif  // OS_CHROMEOS
 
 namespace base {
+
+class MemoryMappedFile;
+
 namespace internal {
 
 class JSONParserTest;
+class JSONValueArena;
 
 // The implementation behind the JSONReader interface. This class is not meant
 // to be used directly; it encapsulates logic that need not be exposed publicly.
 //
 // This parser guarantees O(n) time through the input string. It also optimizes
 // base::StringValue by using StringPiece where possible when returning Value
-// objects by using "hidden roots," discussed in the implementation.
+// objects by using "hidden roots," discussed in the implementation. With
+// JSON_USE_ARENA, the hidden root additionally owns an arena from which every
+// Value in the tree is allocated.
 //
 // Iteration happens on the byte level, with the functions CanConsume and
 // NextChar. The conversion from byte to JSON token happens without advancing
@@ -57,6 +67,10 @@ class JSONParserTest;
 // of a token, such that the next iteration of the parser will be at the byte
 // immediately following the token, which would likely be the first byte of the
 // next token.
+//
+// JSONStreamReader drives the same tokenizer in an event mode that keeps the
+// stack of open containers explicitly instead of recursing, so that parsing
+// can stop at the end of one input window and resume in the next.
 class BASE_EXPORT_PRIVATE JSONParser {
  public:
   explicit JSONParser(int options);
@@ -66,12 +80,31 @@ class BASE_EXPORT_PRIVATE JSONParser {
   // result as a Value owned by the caller.
   Value* Parse(const StringPiece& input);
 
+  // Parses the contents of |mapped_file| like Parse(), without copying the
+  // whole input first. The strings are copied out of the mapping as they are
+  // parsed, as with JSON_DETACHABLE_CHILDREN, and |mapped_file| is unmapped
+  // before returning, so the result never refers to the file.
+  Value* ParseMappedFile(scoped_ptr<MemoryMappedFile> mapped_file);
+
   // Returns the error code.
   JSONReader::JsonParseError error_code() const;
 
   // Returns the human-friendly error message.
   std::string GetErrorMessage() const;
 
+  // Resets the parser to report the tokens of a new document to |delegate|
+  // through ParseEventChunk().
+  void StartEvents(JSONStreamReader::Delegate* delegate);
+
+  // Parses every token in |input|, the next window of the document, reporting
+  // each to the delegate. |input| must end on a token boundary. Returns false
+  // on error or if the delegate stopped parsing.
+  bool ParseEventChunk(const StringPiece& input);
+
+  // Checks that the windows parsed since StartEvents() formed exactly one
+  // complete JSON value. Returns false and sets the error otherwise.
+  bool FinishEvents();
+
  private:
   enum Token {
     T_OBJECT_BEGIN,           // {
@@ -89,6 +122,19 @@ class BASE_EXPORT_PRIVATE JSONParser {
     T_INVALID_TOKEN,
   };
 
+  // What the event mode expects the next token to be.
+  enum EventState {
+    EVENT_EXPECT_ROOT,               // At the start of the document.
+    EVENT_EXPECT_PAIR_VALUE,         // After ':'.
+    EVENT_EXPECT_LIST_VALUE,         // After ',' in a list.
+    EVENT_EXPECT_LIST_VALUE_OR_END,  // After '['.
+    EVENT_EXPECT_KEY,                // After ',' in a dictionary.
+    EVENT_EXPECT_KEY_OR_END,         // After '{'.
+    EVENT_EXPECT_PAIR_SEPARATOR,     // After a dictionary key.
+    EVENT_EXPECT_SEPARATOR_OR_END,   // After a value inside a container.
+    EVENT_DONE,                      // After the root value.
+  };
+
   // A helper class used for parsing strings. One optimization performed is to
   // create base::Value with a StringPiece to avoid unnecessary std::string
   // copies. This is not possible if the input string needs to be decoded from
@@ -164,6 +210,12 @@ class BASE_EXPORT_PRIVATE JSONParser {
   // currently wound to a '/'.
   bool EatComment();
 
+  // Parses |input|, which is either |input_copy|, or with
+  // JSON_DETACHABLE_CHILDREN, owned by the caller. The hidden root takes
+  // ownership of |input_copy|.
+  Value* ParseOwnedInput(const StringPiece& input,
+                         scoped_ptr<std::string> input_copy);
+
   // Calls GetNextToken() and then ParseToken(). Caller owns the result.
   Value* ParseNextToken();
 
@@ -183,6 +235,10 @@ class BASE_EXPORT_PRIVATE JSONParser {
   // Calls through ConsumeStringRaw and wraps it in a value.
   Value* ConsumeString();
 
+  // Returns the dictionary key held by |key|. In arena mode, keys that are
+  // plain slices of the input are interned in |interned_keys_|.
+  const std::string& InternKey(StringBuilder* key);
+
   // Assuming that the parser is wound to a double quote, this parses a string,
   // decoding any escape sequences and converts UTF-16 to UTF-8. Returns true on
   // success and Swap()s the result into |out|. Returns false on failure with
@@ -202,6 +258,9 @@ class BASE_EXPORT_PRIVATE JSONParser {
   // Assuming that the parser is wound to the start of a valid JSON number,
   // this parses and converts it to either an int or double value.
   Value* ConsumeNumber();
+  // Helper for ConsumeNumber() that validates the number and returns its text
+  // in |out|. Returns false with error information set on failure.
+  bool ConsumeNumberRaw(StringPiece* out);
   // Helper that reads characters that are ints. Returns true if a number was
   // read and false on error.
   bool ReadInt(bool allow_leading_zeros);
@@ -209,6 +268,23 @@ class BASE_EXPORT_PRIVATE JSONParser {
   // Consumes the literal values of |true|, |false|, and |null|, assuming the
   // parser is wound to the first character of any of those.
   Value* ConsumeLiteral();
+  // Helper for ConsumeLiteral() that validates the literal at the current
+  // position. Returns false with error information set on failure.
+  bool ConsumeLiteralRaw();
+
+  // Handles |token| in event mode, given |event_state_|. On return the parser
+  // is on the last byte of the token. Returns false to stop parsing.
+  bool ParseEventToken(Token token);
+
+  // Consumes the scalar value starting with |token| and reports it.
+  bool ConsumeEventValue(Token token);
+
+  // Reports the end of the innermost container, which must match |token|,
+  // and updates |event_state_| for its parent.
+  bool CloseEventContainer(Token token);
+
+  // Updates |event_state_| after a complete value has been reported.
+  void FinishEventValue();
 
   // Compares two string buffers of a given length.
   static bool StringsAreEqual(const char* left, const char* right, size_t len);
@@ -239,6 +315,14 @@ class BASE_EXPORT_PRIVATE JSONParser {
   // The index in the input stream to which the parser is wound.
   int index_;
 
+  // The arena the current Value tree is allocated from, or NULL if
+  // JSON_USE_ARENA is not in effect. Handed off to the hidden root.
+  scoped_ptr<JSONValueArena> arena_;
+
+  // Dictionary keys seen so far in arena mode, keyed by their slice of the
+  // input, so that repeated keys share one std::string.
+  hash_map<StringPiece, std::string> interned_keys_;
+
   // The number of times the parser has recursed (current stack depth).
   int stack_depth_;
 
@@ -248,6 +332,13 @@ class BASE_EXPORT_PRIVATE JSONParser {
   // The last value of |index_| on the previous line.
   int index_last_line_;
 
+  // Event mode state: the receiver of the events, what the next token may be,
+  // and the open containers (T_OBJECT_BEGIN or T_ARRAY_BEGIN) from outermost
+  // to innermost.
+  JSONStreamReader::Delegate* delegate_;
+  EventState event_state_;
+  std::vector<Token> event_stack_;
+
   // Error information.
   JSONReader::JsonParseError error_code_;
   int error_line_;
@@ -0,0 +1,139 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <string>
+
+#include "base/files/file_util.h"
+#include "base/files/scoped_temp_dir.h"
+#include "base/json/json_file_value_serializer.h"
+#include "base/json/json_reader.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/process/process_metrics.h"
+#include "base/strings/stringprintf.h"
+#include "base/time/time.h"
+#include "base/values.h"
+#include "build/build_config.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "testing/perf/perf_test.h"
+
+namespace base {
+
+namespace {
+
+const int kNumIterations = 10;
+
+// Builds a document of roughly 200 bytes per entry shaped like a large
+// preferences file: a dictionary of many small dictionaries that repeat the
+// same keys.
+std::string BuildDocument(int entries) {
+  std::string json = "{";
+  for (int i = 0; i < entries; ++i) {
+    if (i)
+      json += ",";
+    StringAppendF(&json,
+                  "\"entry_%d\": {\"name\": \"Entry number %d\", "
+                  "\"enabled\": %s, \"count\": %d, \"ratio\": %d.5, "
+                  "\"tags\": [\"alpha\", \"beta\", \"gamma\"], "
+                  "\"origin\": {\"host\": \"example%d.com\", \"port\": 443}, "
+                  "\"last_used\": null}",
+                  i, i, i % 2 ? "true" : "false", i, i, i % 100);
+  }
+  json += "}";
+  return json;
+}
+
+// Parses the document repeatedly with |options|, reporting the mean parse
+// time, and how much the resident set grows while one result is alive. Run
+// the two variants in separate processes (e.g. with --gtest_filter) for
+// meaningful peak RSS numbers, since the high water mark is per process.
+void RunParseTest(const std::string& trace, int options) {
+  const std::string json = BuildDocument(25000);
+#if defined(OS_MACOSX) && !defined(OS_IOS)
+  scoped_ptr<ProcessMetrics> metrics(
+      ProcessMetrics::CreateProcessMetrics(GetCurrentProcessHandle(), NULL));
+#else
+  scoped_ptr<ProcessMetrics> metrics(
+      ProcessMetrics::CreateProcessMetrics(GetCurrentProcessHandle()));
+#endif
+
+  size_t working_set_before = metrics->GetWorkingSetSize();
+  scoped_ptr<Value> held(JSONReader::Read(json, options));
+  ASSERT_TRUE(held.get());
+  size_t working_set_after = metrics->GetWorkingSetSize();
+
+  TimeDelta parse_time;
+  TimeDelta destroy_time;
+  for (int i = 0; i < kNumIterations; ++i) {
+    TimeTicks start = TimeTicks::HighResNow();
+    scoped_ptr<Value> root(JSONReader::Read(json, options));
+    TimeTicks parsed = TimeTicks::HighResNow();
+    ASSERT_TRUE(root.get());
+    root.reset();
+    parse_time += parsed - start;
+    destroy_time += TimeTicks::HighResNow() - parsed;
+  }
+
+  perf_test::PrintResult("json_parse", "", trace,
+                         parse_time.InMillisecondsF() / kNumIterations, "ms",
+                         true);
+  perf_test::PrintResult("json_destroy", "", trace,
+                         destroy_time.InMillisecondsF() / kNumIterations, "ms",
+                         true);
+  perf_test::PrintResult(
+      "json_resident_growth", "", trace,
+      working_set_after > working_set_before ?
+          working_set_after - working_set_before : 0,
+      "bytes", true);
+  perf_test::PrintResult("json_peak_rss", "", trace,
+                         metrics->GetPeakWorkingSetSize(), "bytes", false);
+}
+
+// Loads a 2 MB preferences file by reading it into a string and by mapping
+// it, reporting the mean time of each. The two alternate so that they see the
+// same heap, which would otherwise favor whichever runs second. The file is
+// in the page cache, having just been written, which is the common case of a
+// profile loaded soon after boot or a restart.
+void RunLoadFileTest() {
+  ScopedTempDir temp_dir;
+  ASSERT_TRUE(temp_dir.CreateUniqueTempDir());
+  FilePath path = temp_dir.path().AppendASCII("Preferences");
+  const std::string json = BuildDocument(10000);
+  ASSERT_EQ(static_cast<int>(json.size()),
+            WriteFile(path, json.data(), json.size()));
+
+  TimeDelta load_time[2];
+  for (int i = 0; i < kNumIterations; ++i) {
+    for (int map_file = 0; map_file < 2; ++map_file) {
+      JSONFileValueSerializer serializer(path);
+      serializer.set_map_file(map_file != 0);
+      TimeTicks start = TimeTicks::HighResNow();
+      scoped_ptr<Value> root(serializer.Deserialize(NULL, NULL));
+      load_time[map_file] += TimeTicks::HighResNow() - start;
+      ASSERT_TRUE(root.get());
+    }
+  }
+
+  perf_test::PrintResult("json_load_2mb_file", "", "read",
+                         load_time[0].InMillisecondsF() / kNumIterations, "ms",
+                         true);
+  perf_test::PrintResult("json_load_2mb_file", "", "mapped",
+                         load_time[1].InMillisecondsF() / kNumIterations, "ms",
+                         true);
+}
+
+}  // namespace
+
+TEST(JSONPerfTest, ParseHeap) {
+  RunParseTest("heap", JSON_PARSE_RFC);
+}
+
+TEST(JSONPerfTest, ParseArena) {
+  RunParseTest("arena", JSON_USE_ARENA);
+}
+
+TEST(JSONPerfTest, LoadFile) {
+  RunLoadFileTest();
+}
+
+}  // namespace base
@@ -4,6 +4,7 @@
 
 #include "base/json/json_reader.h"
 
+#include "base/files/memory_mapped_file.h"
 #include "base/json/json_parser.h"
 #include "base/logging.h"
 
@@ -72,6 +73,25 @@ Value* JSONReader::ReadAndReturnError(const StringPiece& json,
   return NULL;
 }
 
+// static
+Value* JSONReader::ReadMappedFileAndReturnError(
+    scoped_ptr<MemoryMappedFile> mapped_file,
+    int options,
+    int* error_code_out,
+    std::string* error_msg_out) {
+  internal::JSONParser parser(options);
+  Value* root = parser.ParseMappedFile(mapped_file.Pass());
+  if (root)
+    return root;
+
+  if (error_code_out)
+    *error_code_out = parser.error_code();
+  if (error_msg_out)
+    *error_msg_out = parser.GetErrorMessage();
+
+  return NULL;
+}
+
 // static
 std::string JSONReader::ErrorCodeToString(JsonParseError error_code) {
   switch (error_code) {
@@ -37,6 +37,7 @@
 
 namespace base {
 
+class MemoryMappedFile;
 class Value;
 
 namespace internal {
@@ -56,6 +57,14 @@ enum JSONParserOptions {
   // if the child is Remove()d from root, it would result in use-after-free
   // unless it is DeepCopy()ed or this option is used.
   JSON_DETACHABLE_CHILDREN = 1 << 1,
+
+  // Allocates the whole Value tree out of one arena owned by the returned
+  // root, which releases it all at once, and shares storage between repeated
+  // dictionary keys. This avoids a heap allocation per value when parsing
+  // large documents. The same lifetime rules as for the hidden root apply:
+  // children must be DeepCopy()ed before they outlive the root. Ignored if
+  // JSON_DETACHABLE_CHILDREN is set.
+  JSON_USE_ARENA = 1 << 2,
 };
 
 class BASE_EXPORT JSONReader {
@@ -110,6 +119,16 @@ class BASE_EXPORT JSONReader {
                                    int* error_code_out,
                                    std::string* error_msg_out);
 
+  // Parses the contents of |mapped_file| like ReadAndReturnError(), without
+  // copying the whole file first. Only the strings are copied out, and the
+  // file is unmapped before returning: the Value never refers to it, so the
+  // file may be rewritten or truncated afterwards.
+  static Value* ReadMappedFileAndReturnError(
+      scoped_ptr<MemoryMappedFile> mapped_file,
+      int options,  // JSONParserOptions
+      int* error_code_out,
+      std::string* error_msg_out);
+
   // Converts a JSON parse error code into a human readable message.
   // Returns an empty string if error_code is JSON_NO_ERROR.
   static std::string ErrorCodeToString(JsonParseError error_code);
@@ -6,6 +6,8 @@
 
 #include "base/base_paths.h"
 #include "base/files/file_util.h"
+#include "base/files/memory_mapped_file.h"
+#include "base/files/scoped_temp_dir.h"
 #include "base/logging.h"
 #include "base/memory/scoped_ptr.h"
 #include "base/path_service.h"
@@ -623,6 +625,160 @@ TEST(JSONReaderTest, StringOptimizations) {
   EXPECT_EQ("b", s);
 }
 
+TEST(JSONReaderTest, ArenaMatchesHeapParse) {
+  const char* json[] = {
+      "{\"a\": [1, 2.5, true, null, \"s\", {\"a\": \"x\\ny\"}],"
+      " \"b\": {\"a\": 1}, \"\\u00e9\": \"\\u00e9\"}",
+      "[1, {\"key\": \"value\"}, {\"key\": \"value\"}]",
+      "42",
+      "3.5",
+      "\"string\"",
+      "null",
+  };
+
+  for (size_t i = 0; i < arraysize(json); ++i) {
+    scoped_ptr<Value> heap_root(JSONReader::Read(json[i]));
+    scoped_ptr<Value> arena_root(JSONReader::Read(json[i], JSON_USE_ARENA));
+    ASSERT_TRUE(heap_root.get()) << json[i];
+    ASSERT_TRUE(arena_root.get()) << json[i];
+    EXPECT_TRUE(heap_root->Equals(arena_root.get())) << json[i];
+  }
+
+  EXPECT_FALSE(JSONReader::Read("{\"a\": [1, 2", JSON_USE_ARENA));
+}
+
+TEST(JSONReaderTest, ArenaChildrenOutliveRoot) {
+  scoped_ptr<DictionaryValue> dict_value;
+  scoped_ptr<Value> list_value;
+  {
+    scoped_ptr<Value> root(JSONReader::Read(
+        "{\"dict\": {\"a\": \"b\", \"c\": [1, 2]}, \"list\": [true]}",
+        JSON_USE_ARENA));
+    ASSERT_TRUE(root.get());
+    DictionaryValue* root_dict = NULL;
+    ASSERT_TRUE(root->GetAsDictionary(&root_dict));
+
+    // Removing from the root hands out copies that do not use the arena.
+    scoped_ptr<Value> dict_owned;
+    EXPECT_TRUE(root_dict->Remove("dict", &dict_owned));
+    dict_value.reset(static_cast<DictionaryValue*>(dict_owned.release()));
+    EXPECT_TRUE(root_dict->Remove("list", &list_value));
+
+    // Replacing values in an arena-backed tree destroys the old ones.
+    root_dict->SetString("dict", "replacement");
+    root_dict->SetInteger("dict", 3);
+  }
+
+  std::string str;
+  EXPECT_TRUE(dict_value->GetString("a", &str));
+  EXPECT_EQ("b", str);
+  ListValue* list = NULL;
+  ASSERT_TRUE(dict_value->GetList("c", &list));
+  EXPECT_EQ(2u, list->GetSize());
+
+  ASSERT_TRUE(list_value->GetAsList(&list));
+  bool b = false;
+  EXPECT_TRUE(list->GetBoolean(0, &b));
+  EXPECT_TRUE(b);
+}
+
+TEST(JSONReaderTest, ArenaReusedReader) {
+  JSONReader reader(JSON_USE_ARENA);
+  scoped_ptr<Value> first(reader.ReadToValue("{\"key\": [1, 2, 3]}"));
+  scoped_ptr<Value> second(reader.ReadToValue("{\"key\": \"value\"}"));
+  ASSERT_TRUE(first.get());
+  ASSERT_TRUE(second.get());
+
+  // Each root owns its own arena, so both stay valid independently.
+  second.reset();
+  DictionaryValue* dict = NULL;
+  ASSERT_TRUE(first->GetAsDictionary(&dict));
+  ListValue* list = NULL;
+  ASSERT_TRUE(dict->GetList("key", &list));
+  EXPECT_EQ(3u, list->GetSize());
+}
+
+namespace {
+
+// Writes |json| to a file in |temp_dir| and maps it.
+scoped_ptr<MemoryMappedFile> MapJSON(const ScopedTempDir& temp_dir,
+                                     const std::string& json) {
+  FilePath path = temp_dir.path().AppendASCII("mapped.json");
+  EXPECT_EQ(static_cast<int>(json.size()),
+            WriteFile(path, json.data(), json.size()));
+  scoped_ptr<MemoryMappedFile> mapped_file(new MemoryMappedFile);
+  EXPECT_TRUE(mapped_file->Initialize(path));
+  return mapped_file.Pass();
+}
+
+}  // namespace
+
+TEST(JSONReaderTest, ReadMappedFile) {
+  ScopedTempDir temp_dir;
+  ASSERT_TRUE(temp_dir.CreateUniqueTempDir());
+  const char* json[] = {
+      "{\"a\": [1, 2.5, true, null, \"s\", {\"a\": \"x\\ny\"}],"
+      " \"b\": {\"a\": 1}, \"\\u00e9\": \"\\u00e9\"}",
+      "[1, {\"key\": \"value\"}, {\"key\": \"value\"}]",
+      "\"string\"",
+      "42",
+  };
+  const int kOptions[] = {
+      JSON_PARSE_RFC, JSON_USE_ARENA, JSON_DETACHABLE_CHILDREN,
+  };
+
+  for (size_t i = 0; i < arraysize(json); ++i) {
+    for (size_t j = 0; j < arraysize(kOptions); ++j) {
+      scoped_ptr<Value> expected(JSONReader::Read(json[i]));
+      scoped_ptr<Value> root(JSONReader::ReadMappedFileAndReturnError(
+          MapJSON(temp_dir, json[i]), kOptions[j], NULL, NULL));
+      ASSERT_TRUE(root.get()) << json[i];
+      EXPECT_TRUE(expected->Equals(root.get())) << json[i];
+
+      // The file is unmapped once parsed, so it can be truncated in place
+      // under the root.
+      ASSERT_EQ(0, WriteFile(temp_dir.path().AppendASCII("mapped.json"), "",
+                             0));
+      scoped_ptr<Value> copy(root->DeepCopy());
+      EXPECT_TRUE(expected->Equals(copy.get())) << json[i];
+    }
+  }
+}
+
+// The strings of a mapped file are copied out of the mapping, so they stay
+// valid wherever the contents of the root move.
+TEST(JSONReaderTest, ReadMappedFileSwap) {
+  ScopedTempDir temp_dir;
+  ASSERT_TRUE(temp_dir.CreateUniqueTempDir());
+  scoped_ptr<Value> root(JSONReader::ReadMappedFileAndReturnError(
+      MapJSON(temp_dir, "{\"key\": \"value\"}"), JSON_PARSE_RFC, NULL,
+      NULL));
+  ASSERT_TRUE(root.get());
+  DictionaryValue* root_dict = NULL;
+  ASSERT_TRUE(root->GetAsDictionary(&root_dict));
+
+  DictionaryValue other;
+  other.SetString("other", "x");
+  root_dict->Swap(&other);
+  root.reset();
+
+  std::string str;
+  EXPECT_TRUE(other.GetString("key", &str));
+  EXPECT_EQ("value", str);
+}
+
+TEST(JSONReaderTest, ReadMappedFileError) {
+  ScopedTempDir temp_dir;
+  ASSERT_TRUE(temp_dir.CreateUniqueTempDir());
+  int error_code = JSONReader::JSON_NO_ERROR;
+  std::string error_msg;
+  EXPECT_FALSE(JSONReader::ReadMappedFileAndReturnError(
+      MapJSON(temp_dir, "{\"a\": [1, 2"), JSON_PARSE_RFC, &error_code,
+      &error_msg));
+  EXPECT_EQ(JSONReader::JSON_SYNTAX_ERROR, error_code);
+  EXPECT_NE("", error_msg);
+}
+
 // A smattering of invalid JSON designed to test specific portions of the
 // parser implementation against buffer overflow. Best run with DCHECKs so
 // that the one in NextChar fires.
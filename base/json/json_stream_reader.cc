@@ -0,0 +1,158 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/json/json_stream_reader.h"
+
+#include "base/files/file.h"
+#include "base/json/json_parser.h"
+#include "base/logging.h"
+
+namespace base {
+
+namespace {
+
+// Size of the chunks ParseFile() reads at a time.
+const int kReadChunkSize = 64 * 1024;
+
+}  // namespace
+
+JSONStreamReader::JSONStreamReader(int options, Delegate* delegate)
+    : parser_(new internal::JSONParser(options)),
+      scan_pos_(0),
+      scan_state_(SCAN_DEFAULT),
+      failed_(false) {
+  DCHECK(delegate);
+  parser_->StartEvents(delegate);
+}
+
+JSONStreamReader::~JSONStreamReader() {
+}
+
+bool JSONStreamReader::Parse(const StringPiece& json) {
+  DCHECK(buffer_.empty());
+  // The whole document is available, so there is no need to buffer it.
+  if (failed_ || !parser_->ParseEventChunk(json) || !parser_->FinishEvents()) {
+    failed_ = true;
+    return false;
+  }
+  return true;
+}
+
+bool JSONStreamReader::Feed(const StringPiece& data) {
+  if (failed_)
+    return false;
+
+  data.AppendToString(&buffer_);
+  size_t boundary = ScanForBoundary();
+  if (!boundary)
+    return true;
+
+  if (!parser_->ParseEventChunk(StringPiece(buffer_.data(), boundary))) {
+    failed_ = true;
+    return false;
+  }
+  buffer_.erase(0, boundary);
+  scan_pos_ -= boundary;
+  return true;
+}
+
+bool JSONStreamReader::Finish() {
+  if (failed_ || !parser_->ParseEventChunk(buffer_) ||
+      !parser_->FinishEvents()) {
+    failed_ = true;
+    return false;
+  }
+  buffer_.clear();
+  scan_pos_ = 0;
+  return true;
+}
+
+bool JSONStreamReader::ParseFile(File* file) {
+  scoped_ptr<char[]> chunk(new char[kReadChunkSize]);
+  while (true) {
+    int bytes_read = file->ReadAtCurrentPos(chunk.get(), kReadChunkSize);
+    if (bytes_read < 0) {
+      failed_ = true;
+      return false;
+    }
+    if (bytes_read == 0)
+      return Finish();
+    if (!Feed(StringPiece(chunk.get(), bytes_read)))
+      return false;
+  }
+}
+
+JSONReader::JsonParseError JSONStreamReader::error_code() const {
+  return parser_->error_code();
+}
+
+std::string JSONStreamReader::GetErrorMessage() const {
+  return parser_->GetErrorMessage();
+}
+
+size_t JSONStreamReader::ScanForBoundary() {
+  size_t boundary = 0;
+  for (; scan_pos_ < buffer_.size(); ++scan_pos_) {
+    char c = buffer_[scan_pos_];
+    switch (scan_state_) {
+      case SCAN_SLASH:
+        if (c == '/') {
+          scan_state_ = SCAN_LINE_COMMENT;
+          break;
+        }
+        if (c == '*') {
+          scan_state_ = SCAN_BLOCK_COMMENT;
+          break;
+        }
+        // Not a comment. The parser reports the stray slash; treat |c| as
+        // regular input.
+        scan_state_ = SCAN_DEFAULT;
+        // Fall through.
+      case SCAN_DEFAULT:
+        switch (c) {
+          case '"':
+            scan_state_ = SCAN_STRING;
+            break;
+          case '/':
+            scan_state_ = SCAN_SLASH;
+            break;
+          case '{':
+          case '}':
+          case '[':
+          case ']':
+          case ',':
+          case ':':
+            boundary = scan_pos_ + 1;
+            break;
+        }
+        break;
+      case SCAN_STRING:
+        if (c == '\\')
+          scan_state_ = SCAN_STRING_ESCAPE;
+        else if (c == '"')
+          scan_state_ = SCAN_DEFAULT;
+        break;
+      case SCAN_STRING_ESCAPE:
+        scan_state_ = SCAN_STRING;
+        break;
+      case SCAN_LINE_COMMENT:
+        if (c == '\n' || c == '\r')
+          scan_state_ = SCAN_DEFAULT;
+        break;
+      case SCAN_BLOCK_COMMENT:
+        if (c == '*')
+          scan_state_ = SCAN_BLOCK_COMMENT_STAR;
+        break;
+      case SCAN_BLOCK_COMMENT_STAR:
+        if (c == '/')
+          scan_state_ = SCAN_DEFAULT;
+        else if (c != '*')
+          scan_state_ = SCAN_BLOCK_COMMENT;
+        break;
+    }
+  }
+  return boundary;
+}
+
+}  // namespace base
@@ -0,0 +1,119 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+//
+// An event-driven ("SAX-style") JSON parser. Instead of building a Value tree
+// like JSONReader, it reports every token of the document to a Delegate as
+// soon as it is parsed, so large documents can be filtered or converted while
+// only holding a small window of the input in memory.
+//
+// The grammar, options and error codes are the same as JSONReader's. Input can
+// be supplied all at once, incrementally with Feed() and Finish(), or read
+// straight from a File.
+
+#ifndef BASE_JSON_JSON_STREAM_READER_H_
+#define BASE_JSON_JSON_STREAM_READER_H_
+
+#include <string>
+
+#include "base/base_export.h"
+#include "base/basictypes.h"
+#include "base/json/json_reader.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/strings/string_piece.h"
+
+namespace base {
+
+class File;
+
+namespace internal {
+class JSONParser;
+}
+
+// Parses a single JSON document, reporting it to a Delegate.
+class BASE_EXPORT JSONStreamReader {
+ public:
+  // Receives the parse events. Every callback returns true to continue
+  // parsing or false to stop it, in which case the pending Parse(), Feed(),
+  // Finish() or ParseFile() call returns false and error_code() stays
+  // JSON_NO_ERROR. StringPiece arguments are only valid during the call.
+  class BASE_EXPORT Delegate {
+   public:
+    virtual ~Delegate() {}
+
+    virtual bool OnStartDictionary() = 0;
+    virtual bool OnKey(const StringPiece& key) = 0;
+    virtual bool OnEndDictionary() = 0;
+    virtual bool OnStartList() = 0;
+    virtual bool OnEndList() = 0;
+    virtual bool OnString(const StringPiece& value) = 0;
+    virtual bool OnInteger(int value) = 0;
+    virtual bool OnDouble(double value) = 0;
+    virtual bool OnBoolean(bool value) = 0;
+    virtual bool OnNull() = 0;
+  };
+
+  // |options| is a bitmask of JSONParserOptions. |delegate| must outlive this.
+  JSONStreamReader(int options, Delegate* delegate);
+  ~JSONStreamReader();
+
+  // Parses the complete document |json|. Returns true if it was well formed
+  // and the delegate never stopped parsing.
+  bool Parse(const StringPiece& json);
+
+  // Appends |data| to the document and reports every complete token in it.
+  // Bytes that may belong to an unfinished token are kept until the next call.
+  // Returns false once an error occurs or the delegate stops parsing.
+  bool Feed(const StringPiece& data);
+
+  // Signals the end of the document fed so far and parses what is left.
+  // Returns true if the whole document was well formed.
+  bool Finish();
+
+  // Reads |file| from its current position to the end, feeding it in chunks.
+  // Also returns false if reading fails, leaving error_code() JSON_NO_ERROR.
+  bool ParseFile(File* file);
+
+  // Returns the error code of the last failure, or JSON_NO_ERROR.
+  JSONReader::JsonParseError error_code() const;
+
+  // Converts error_code() to a human-readable string, including line and
+  // column numbers if appropriate.
+  std::string GetErrorMessage() const;
+
+ private:
+  // States of the scanner that finds token boundaries in the buffered input.
+  enum ScanState {
+    SCAN_DEFAULT,
+    SCAN_STRING,
+    SCAN_STRING_ESCAPE,
+    SCAN_SLASH,
+    SCAN_LINE_COMMENT,
+    SCAN_BLOCK_COMMENT,
+    SCAN_BLOCK_COMMENT_STAR,
+  };
+
+  // Scans |buffer_| from |scan_pos_| and returns the length of the longest
+  // prefix that ends on a token boundary, i.e. right after a structural
+  // character outside of strings and comments. No token can span such a
+  // boundary, so the prefix can be parsed on its own.
+  size_t ScanForBoundary();
+
+  scoped_ptr<internal::JSONParser> parser_;
+
+  // Input that has been fed but not parsed yet.
+  std::string buffer_;
+
+  // How far into |buffer_| the scanner has got, and its state there.
+  size_t scan_pos_;
+  ScanState scan_state_;
+
+  // Set once parsing has failed or was stopped by the delegate.
+  bool failed_;
+
+  DISALLOW_COPY_AND_ASSIGN(JSONStreamReader);
+};
+
+}  // namespace base
+
+#endif  // BASE_JSON_JSON_STREAM_READER_H_
@@ -0,0 +1,298 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/json/json_stream_reader.h"
+
+#include <string>
+#include <vector>
+
+#include "base/files/file.h"
+#include "base/files/file_util.h"
+#include "base/files/scoped_temp_dir.h"
+#include "base/json/json_reader.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/values.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace base {
+
+namespace {
+
+// Records the events as a compact string, e.g. {a:1b:[s"x"n]}.
+class RecordingDelegate : public JSONStreamReader::Delegate {
+ public:
+  RecordingDelegate() : stop_after_(-1) {}
+
+  // Makes the |count|th event return false.
+  void set_stop_after(int count) { stop_after_ = count; }
+
+  const std::string& events() const { return events_; }
+
+  virtual bool OnStartDictionary() OVERRIDE { return Record("{"); }
+  virtual bool OnKey(const StringPiece& key) OVERRIDE {
+    return Record(key.as_string() + ":");
+  }
+  virtual bool OnEndDictionary() OVERRIDE { return Record("}"); }
+  virtual bool OnStartList() OVERRIDE { return Record("["); }
+  virtual bool OnEndList() OVERRIDE { return Record("]"); }
+  virtual bool OnString(const StringPiece& value) OVERRIDE {
+    return Record("s\"" + value.as_string() + "\"");
+  }
+  virtual bool OnInteger(int value) OVERRIDE {
+    return Record(IntToString(value));
+  }
+  virtual bool OnDouble(double value) OVERRIDE {
+    return Record("d" + DoubleToString(value));
+  }
+  virtual bool OnBoolean(bool value) OVERRIDE {
+    return Record(value ? "t" : "f");
+  }
+  virtual bool OnNull() OVERRIDE { return Record("n"); }
+
+ private:
+  bool Record(const std::string& event) {
+    events_ += event;
+    return stop_after_-- != 0;
+  }
+
+  std::string events_;
+  int stop_after_;
+
+  DISALLOW_COPY_AND_ASSIGN(RecordingDelegate);
+};
+
+// Rebuilds the Value tree from the events, for comparison with JSONReader.
+class ValueBuildingDelegate : public JSONStreamReader::Delegate {
+ public:
+  ValueBuildingDelegate() {}
+
+  Value* root() { return root_.get(); }
+
+  virtual bool OnStartDictionary() OVERRIDE {
+    return Push(new DictionaryValue);
+  }
+  virtual bool OnKey(const StringPiece& key) OVERRIDE {
+    key.CopyToString(&key_);
+    return true;
+  }
+  virtual bool OnEndDictionary() OVERRIDE { return Pop(); }
+  virtual bool OnStartList() OVERRIDE { return Push(new ListValue); }
+  virtual bool OnEndList() OVERRIDE { return Pop(); }
+  virtual bool OnString(const StringPiece& value) OVERRIDE {
+    return Add(new StringValue(value.as_string()));
+  }
+  virtual bool OnInteger(int value) OVERRIDE {
+    return Add(new FundamentalValue(value));
+  }
+  virtual bool OnDouble(double value) OVERRIDE {
+    return Add(new FundamentalValue(value));
+  }
+  virtual bool OnBoolean(bool value) OVERRIDE {
+    return Add(new FundamentalValue(value));
+  }
+  virtual bool OnNull() OVERRIDE { return Add(Value::CreateNullValue()); }
+
+ private:
+  bool Add(Value* value) {
+    if (stack_.empty()) {
+      root_.reset(value);
+    } else if (stack_.back()->IsType(Value::TYPE_DICTIONARY)) {
+      static_cast<DictionaryValue*>(stack_.back())->SetWithoutPathExpansion(
+          key_, value);
+    } else {
+      static_cast<ListValue*>(stack_.back())->Append(value);
+    }
+    return true;
+  }
+
+  bool Push(Value* container) {
+    Add(container);
+    stack_.push_back(container);
+    return true;
+  }
+
+  bool Pop() {
+    stack_.pop_back();
+    return true;
+  }
+
+  scoped_ptr<Value> root_;
+  std::vector<Value*> stack_;
+  std::string key_;
+
+  DISALLOW_COPY_AND_ASSIGN(ValueBuildingDelegate);
+};
+
+const char* const kDocuments[] = {
+  "{\"a\": 1, \"b\": [\"x\", null, true, false, 2.5], \"c\": {}}",
+  "  [ [], {}, [[1]], {\"k\": {\"k\": \"v\"}} ]  ",
+  "/* comment, with [structural] chars */ {\"a\": // line, comment\n"
+  "  \"b,\\\"}\\\\\", \"c\\u00e9\": \"\\u00e9\\n\"}",
+  "\xEF\xBB\xBF{\"bom\": true}",
+  "42",
+  "-1.5e3",
+  "\"root string\"",
+  "null",
+};
+
+}  // namespace
+
+TEST(JSONStreamReaderTest, Events) {
+  RecordingDelegate delegate;
+  JSONStreamReader reader(JSON_PARSE_RFC, &delegate);
+  EXPECT_TRUE(reader.Parse(
+      "{\"a\": 1, \"b\": [\"x\", null, true, 2.5], \"c\": {}}"));
+  EXPECT_EQ("{a:1b:[s\"x\"ntd2.5]c:{}}", delegate.events());
+  EXPECT_EQ(JSONReader::JSON_NO_ERROR, reader.error_code());
+}
+
+TEST(JSONStreamReaderTest, MatchesJSONReader) {
+  for (size_t i = 0; i < arraysize(kDocuments); ++i) {
+    scoped_ptr<Value> expected(JSONReader::Read(kDocuments[i]));
+    ASSERT_TRUE(expected.get()) << kDocuments[i];
+
+    ValueBuildingDelegate delegate;
+    JSONStreamReader reader(JSON_PARSE_RFC, &delegate);
+    ASSERT_TRUE(reader.Parse(kDocuments[i])) << kDocuments[i];
+    ASSERT_TRUE(delegate.root()) << kDocuments[i];
+    EXPECT_TRUE(expected->Equals(delegate.root())) << kDocuments[i];
+  }
+}
+
+TEST(JSONStreamReaderTest, IncrementalFeed) {
+  for (size_t i = 0; i < arraysize(kDocuments); ++i) {
+    std::string json(kDocuments[i]);
+    RecordingDelegate whole;
+    JSONStreamReader whole_reader(JSON_PARSE_RFC, &whole);
+    ASSERT_TRUE(whole_reader.Parse(json));
+
+    // Feeding the document one byte at a time must produce the same events.
+    RecordingDelegate bytewise;
+    JSONStreamReader reader(JSON_PARSE_RFC, &bytewise);
+    for (size_t j = 0; j < json.size(); ++j)
+      ASSERT_TRUE(reader.Feed(StringPiece(json.data() + j, 1))) << json;
+    ASSERT_TRUE(reader.Finish()) << json;
+    EXPECT_EQ(whole.events(), bytewise.events()) << json;
+
+    // And so must every split into two pieces.
+    for (size_t split = 0; split <= json.size(); ++split) {
+      RecordingDelegate split_delegate;
+      JSONStreamReader split_reader(JSON_PARSE_RFC, &split_delegate);
+      ASSERT_TRUE(split_reader.Feed(StringPiece(json.data(), split)));
+      ASSERT_TRUE(split_reader.Feed(
+          StringPiece(json.data() + split, json.size() - split)));
+      ASSERT_TRUE(split_reader.Finish());
+      EXPECT_EQ(whole.events(), split_delegate.events()) << json;
+    }
+  }
+}
+
+TEST(JSONStreamReaderTest, Errors) {
+  struct {
+    const char* json;
+    JSONReader::JsonParseError error;
+  } cases[] = {
+    { "", JSONReader::JSON_UNEXPECTED_TOKEN },
+    { "[1, 2,]", JSONReader::JSON_TRAILING_COMMA },
+    { "{\"a\": 1,}", JSONReader::JSON_TRAILING_COMMA },
+    { "{a: 1}", JSONReader::JSON_UNQUOTED_DICTIONARY_KEY },
+    { "{\"a\" 1}", JSONReader::JSON_SYNTAX_ERROR },
+    { "[1 2]", JSONReader::JSON_SYNTAX_ERROR },
+    { "[1, 2", JSONReader::JSON_SYNTAX_ERROR },
+    { "[1]]", JSONReader::JSON_UNEXPECTED_DATA_AFTER_ROOT },
+    { "[}", JSONReader::JSON_UNEXPECTED_TOKEN },
+    { "\"\\q\"", JSONReader::JSON_INVALID_ESCAPE },
+  };
+
+  for (size_t i = 0; i < arraysize(cases); ++i) {
+    RecordingDelegate delegate;
+    JSONStreamReader reader(JSON_PARSE_RFC, &delegate);
+    EXPECT_FALSE(reader.Parse(cases[i].json)) << cases[i].json;
+    EXPECT_EQ(cases[i].error, reader.error_code()) << cases[i].json;
+    EXPECT_NE("", reader.GetErrorMessage()) << cases[i].json;
+  }
+
+  RecordingDelegate delegate;
+  JSONStreamReader reader(JSON_ALLOW_TRAILING_COMMAS, &delegate);
+  EXPECT_TRUE(reader.Parse("{\"a\": [1, 2,],}"));
+  EXPECT_EQ("{a:[12]}", delegate.events());
+}
+
+TEST(JSONStreamReaderTest, ErrorLocationAcrossChunks) {
+  const std::string json = "{\n  \"a\": [1,\n   2,\n   x]\n}";
+  JSONReader tree_reader;
+  EXPECT_FALSE(tree_reader.ReadToValue(json));
+
+  RecordingDelegate delegate;
+  JSONStreamReader reader(JSON_PARSE_RFC, &delegate);
+  bool ok = true;
+  for (size_t i = 0; ok && i < json.size(); ++i)
+    ok = reader.Feed(StringPiece(json.data() + i, 1));
+  EXPECT_FALSE(ok && reader.Finish());
+  EXPECT_EQ(tree_reader.error_code(), reader.error_code());
+  EXPECT_EQ(tree_reader.GetErrorMessage(), reader.GetErrorMessage());
+}
+
+TEST(JSONStreamReaderTest, TooMuchNesting) {
+  // The same limit as for JSONReader applies.
+  std::string deep(100, '[');
+  deep.append(100, ']');
+  EXPECT_FALSE(JSONReader::Read(deep));
+  RecordingDelegate delegate;
+  JSONStreamReader reader(JSON_PARSE_RFC, &delegate);
+  EXPECT_FALSE(reader.Parse(deep));
+  EXPECT_EQ(JSONReader::JSON_TOO_MUCH_NESTING, reader.error_code());
+
+  std::string shallow(99, '[');
+  shallow.append(99, ']');
+  scoped_ptr<Value> shallow_value(JSONReader::Read(shallow));
+  EXPECT_TRUE(shallow_value.get());
+  RecordingDelegate shallow_delegate;
+  JSONStreamReader shallow_reader(JSON_PARSE_RFC, &shallow_delegate);
+  EXPECT_TRUE(shallow_reader.Parse(shallow));
+}
+
+TEST(JSONStreamReaderTest, DelegateStops) {
+  RecordingDelegate delegate;
+  delegate.set_stop_after(2);
+  JSONStreamReader reader(JSON_PARSE_RFC, &delegate);
+  EXPECT_FALSE(reader.Parse("[1, 2, 3, 4]"));
+  EXPECT_EQ("[12", delegate.events());
+  EXPECT_EQ(JSONReader::JSON_NO_ERROR, reader.error_code());
+
+  // Further input is ignored once parsing has stopped.
+  EXPECT_FALSE(reader.Feed("5"));
+  EXPECT_FALSE(reader.Finish());
+}
+
+TEST(JSONStreamReaderTest, ParseFile) {
+  ScopedTempDir temp_dir;
+  ASSERT_TRUE(temp_dir.CreateUniqueTempDir());
+  FilePath path = temp_dir.path().AppendASCII("test.json");
+
+  // Large enough to span several read chunks.
+  std::string json = "{\"list\": [";
+  for (int i = 0; i < 50000; ++i) {
+    if (i)
+      json += ", ";
+    json += "{\"index\": " + IntToString(i) + ", \"name\": \"item\"}";
+  }
+  json += "]}";
+  ASSERT_EQ(static_cast<int>(json.size()),
+            WriteFile(path, json.data(), json.size()));
+
+  scoped_ptr<Value> expected(JSONReader::Read(json));
+  ASSERT_TRUE(expected.get());
+
+  File file(path, File::FLAG_OPEN | File::FLAG_READ);
+  ASSERT_TRUE(file.IsValid());
+  ValueBuildingDelegate delegate;
+  JSONStreamReader reader(JSON_PARSE_RFC, &delegate);
+  EXPECT_TRUE(reader.ParseFile(&file));
+  ASSERT_TRUE(delegate.root());
+  EXPECT_TRUE(expected->Equals(delegate.root()));
+}
+
+}  // namespace base
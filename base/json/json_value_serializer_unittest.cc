@@ -164,6 +164,47 @@ TEST(JSONValueSerializerTest, ReadJSONWithCommasFromFile) {
   CheckJSONIsStillTheSame(*value);
 }
 
+// Test that a mapped file deserializes like a read one, and that the files
+// that can't be mapped report the same errors.
+TEST(JSONValueSerializerTest, ReadJSONFromMappedFile) {
+  ScopedTempDir tempdir;
+  ASSERT_TRUE(tempdir.CreateUniqueTempDir());
+  FilePath temp_file(tempdir.path().AppendASCII("test.json"));
+  ASSERT_EQ(static_cast<int>(strlen(kProperJSONWithCommas)),
+            WriteFile(temp_file, kProperJSONWithCommas,
+                      strlen(kProperJSONWithCommas)));
+
+  JSONFileValueSerializer file_deserializer(temp_file);
+  file_deserializer.set_map_file(true);
+  int error_code = 0;
+  std::string error_message;
+  scoped_ptr<Value> value(
+      file_deserializer.Deserialize(&error_code, &error_message));
+  ASSERT_FALSE(value.get());
+  EXPECT_EQ(JSONReader::JSON_TRAILING_COMMA, error_code);
+  file_deserializer.set_allow_trailing_comma(true);
+  value.reset(file_deserializer.Deserialize(NULL, NULL));
+  ASSERT_TRUE(value.get());
+  CheckJSONIsStillTheSame(*value);
+
+  // The file is unmapped once parsed, so it can be truncated or removed
+  // under the value.
+  ASSERT_EQ(0, WriteFile(temp_file, "", 0));
+  CheckJSONIsStillTheSame(*value);
+  ASSERT_TRUE(DeleteFile(temp_file, false));
+
+  value.reset(file_deserializer.Deserialize(&error_code, &error_message));
+  ASSERT_FALSE(value.get());
+  EXPECT_EQ(JSONFileValueSerializer::JSON_NO_SUCH_FILE, error_code);
+
+  // An empty file can't be mapped, and is read as a parse error.
+  ASSERT_EQ(0, WriteFile(temp_file, "", 0));
+  value.reset(file_deserializer.Deserialize(&error_code, &error_message));
+  ASSERT_FALSE(value.get());
+  EXPECT_NE(JSONReader::JSON_NO_ERROR, error_code);
+  EXPECT_GT(JSONReader::JSON_PARSE_ERROR_COUNT, error_code);
+}
+
 TEST(JSONValueSerializerTest, Roundtrip) {
   const std::string original_serialization =
     "{\"bool\":true,\"double\":3.14,\"int\":42,\"list\":[1,2],\"null\":null}";
@@ -17,7 +17,8 @@ const struct TypeNamePair {
   { DISCARDABLE_MEMORY_TYPE_ASHMEM, "ashmem" },
   { DISCARDABLE_MEMORY_TYPE_MAC, "mac" },
   { DISCARDABLE_MEMORY_TYPE_EMULATED, "emulated" },
-  { DISCARDABLE_MEMORY_TYPE_MALLOC, "malloc" }
+  { DISCARDABLE_MEMORY_TYPE_MALLOC, "malloc" },
+  { DISCARDABLE_MEMORY_TYPE_POOLED, "pooled" }
 };
 
 DiscardableMemoryType g_preferred_type = DISCARDABLE_MEMORY_TYPE_NONE;
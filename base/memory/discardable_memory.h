@@ -20,7 +20,8 @@ enum DiscardableMemoryType {
   DISCARDABLE_MEMORY_TYPE_ASHMEM,
   DISCARDABLE_MEMORY_TYPE_MAC,
   DISCARDABLE_MEMORY_TYPE_EMULATED,
-  DISCARDABLE_MEMORY_TYPE_MALLOC
+  DISCARDABLE_MEMORY_TYPE_MALLOC,
+  DISCARDABLE_MEMORY_TYPE_POOLED
 };
 
 enum DiscardableMemoryLockStatus {
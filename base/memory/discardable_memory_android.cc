@@ -65,6 +65,7 @@ scoped_ptr<DiscardableMemory> DiscardableMemory::CreateLockedMemoryWithType(
   switch (type) {
     case DISCARDABLE_MEMORY_TYPE_NONE:
     case DISCARDABLE_MEMORY_TYPE_MAC:
+    case DISCARDABLE_MEMORY_TYPE_POOLED:
       return scoped_ptr<DiscardableMemory>();
     case DISCARDABLE_MEMORY_TYPE_ASHMEM: {
       SharedState* const shared_state = g_shared_state.Pointer();
@@ -4,21 +4,53 @@
 
 #include "base/memory/discardable_memory.h"
 
+#include "base/bind.h"
+#include "base/lazy_instance.h"
 #include "base/logging.h"
 #include "base/memory/discardable_memory_emulated.h"
 #include "base/memory/discardable_memory_malloc.h"
+#include "base/memory/discardable_memory_pooled.h"
+#include "base/memory/discardable_memory_pooled_allocator.h"
+#include "base/memory/memory_pressure_listener.h"
 
 namespace base {
+namespace {
+
+// The same limits as for emulated discardable memory: past the memory limit,
+// allocating purges the pool; reducing memory usage purges it down to the
+// soft memory limit.
+const size_t kPooledMemoryLimit = 512 * 1024 * 1024;
+const size_t kPooledSoftMemoryLimit = 32 * 1024 * 1024;
+
+// Holds the shared state used for pooled allocations. Note that memory
+// pressure is only listened to if the first pooled allocation is made on a
+// thread with a message loop.
+struct SharedState {
+  SharedState()
+      : allocator(kPooledMemoryLimit, kPooledSoftMemoryLimit),
+        memory_pressure_listener(
+            Bind(&internal::DiscardableMemoryPooledAllocator::OnMemoryPressure,
+                 Unretained(&allocator))) {}
+
+  internal::DiscardableMemoryPooledAllocator allocator;
+  MemoryPressureListener memory_pressure_listener;
+};
+LazyInstance<SharedState>::Leaky g_shared_state = LAZY_INSTANCE_INITIALIZER;
+
+}  // namespace
 
 // static
 bool DiscardableMemory::ReduceMemoryUsage() {
-  return internal::DiscardableMemoryEmulated::ReduceMemoryUsage();
+  bool pooled_reduced = g_shared_state.Pointer()->allocator.ReduceMemoryUsage();
+  return internal::DiscardableMemoryEmulated::ReduceMemoryUsage() &&
+         pooled_reduced;
 }
 
 // static
 void DiscardableMemory::GetSupportedTypes(
     std::vector<DiscardableMemoryType>* types) {
   const DiscardableMemoryType supported_types[] = {
+    DISCARDABLE_MEMORY_TYPE_POOLED,
     DISCARDABLE_MEMORY_TYPE_EMULATED,
     DISCARDABLE_MEMORY_TYPE_MALLOC
   };
@@ -33,6 +65,19 @@ scoped_ptr<DiscardableMemory> DiscardableMemory::CreateLockedMemoryWithType(
     case DISCARDABLE_MEMORY_TYPE_ASHMEM:
     case DISCARDABLE_MEMORY_TYPE_MAC:
       return scoped_ptr<DiscardableMemory>();
+    case DISCARDABLE_MEMORY_TYPE_POOLED:
+      // Rounding large allocations up to a power of two would waste too much
+      // memory; they are emulated instead.
+      if (size <= internal::DiscardableMemoryPooledAllocator::kMaxPooledSize) {
+        scoped_ptr<internal::DiscardableMemoryPooled> memory(
+            new internal::DiscardableMemoryPooled(
+                size, &g_shared_state.Pointer()->allocator));
+        if (!memory->Initialize())
+          return scoped_ptr<DiscardableMemory>();
+
+        return memory.PassAs<DiscardableMemory>();
+      }
+      // Fall through.
     case DISCARDABLE_MEMORY_TYPE_EMULATED: {
       scoped_ptr<internal::DiscardableMemoryEmulated> memory(
           new internal::DiscardableMemoryEmulated(size));
@@ -57,6 +102,7 @@ scoped_ptr<DiscardableMemory> DiscardableMemory::CreateLockedMemoryWithType(
 
 // static
 void DiscardableMemory::PurgeForTesting() {
+  g_shared_state.Pointer()->allocator.PurgeAll();
   internal::DiscardableMemoryEmulated::PurgeForTesting();
 }
 
@@ -0,0 +1,75 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <string>
+#include <vector>
+
+#include "base/memory/discardable_memory.h"
+#include "base/memory/linked_ptr.h"
+#include "base/time/time.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "testing/perf/perf_test.h"
+
+namespace base {
+
+namespace {
+
+// The allocations live at a time, as for the decoded images of a page.
+const size_t kLiveAllocations = 2000;
+const int kIterations = 200000;
+
+// One in kReplacePeriod iterations replaces an allocation with a new one.
+const int kReplacePeriod = 8;
+
+// The sizes of the allocations cycle through these.
+const size_t kSizes[] = { 1024, 4096, 12 * 1024, 40 * 1024, 100 * 1024 };
+
+// Locks, touches and unlocks allocations of |type| in turn, replacing some of
+// them along the way, and prints the time per iteration.
+void RunChurnTest(DiscardableMemoryType type) {
+  std::vector<linked_ptr<DiscardableMemory> > memories(kLiveAllocations);
+  for (size_t i = 0; i < memories.size(); ++i) {
+    memories[i].reset(DiscardableMemory::CreateLockedMemoryWithType(
+        type, kSizes[i % arraysize(kSizes)]).release());
+    ASSERT_TRUE(memories[i].get());
+    memories[i]->Unlock();
+  }
+
+  size_t purged_count = 0;
+  TimeTicks begin = TimeTicks::HighResNow();
+  for (int i = 0; i < kIterations; ++i) {
+    size_t index = (i * 7919) % memories.size();
+    if (i % kReplacePeriod == 0) {
+      memories[index].reset(DiscardableMemory::CreateLockedMemoryWithType(
+          type, kSizes[i % arraysize(kSizes)]).release());
+      ASSERT_TRUE(memories[index].get());
+    } else {
+      DiscardableMemoryLockStatus status = memories[index]->Lock();
+      ASSERT_NE(DISCARDABLE_MEMORY_LOCK_STATUS_FAILED, status);
+      if (status == DISCARDABLE_MEMORY_LOCK_STATUS_PURGED)
+        ++purged_count;
+    }
+    static_cast<char*>(memories[index]->Memory())[0] = static_cast<char>(i);
+    memories[index]->Unlock();
+  }
+  TimeDelta elapsed = TimeTicks::HighResNow() - begin;
+
+  std::string trace = DiscardableMemory::GetTypeName(type);
+  perf_test::PrintResult("discardable_memory_churn", "", trace,
+                         elapsed.InMicroseconds() * 1000.0 / kIterations,
+                         "ns/iteration", true);
+  perf_test::PrintResult("discardable_memory_purged", "", trace,
+                         purged_count, "locks", false);
+}
+
+}  // namespace
+
+TEST(DiscardableMemoryPerfTest, Churn) {
+  std::vector<DiscardableMemoryType> types;
+  DiscardableMemory::GetSupportedTypes(&types);
+  for (size_t i = 0; i < types.size(); ++i)
+    RunChurnTest(types[i]);
+}
+
+}  // namespace base
@@ -0,0 +1,57 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/memory/discardable_memory_pooled.h"
+
+#include "base/logging.h"
+#include "base/memory/discardable_memory_pooled_allocator.h"
+
+namespace base {
+namespace internal {
+
+DiscardableMemoryPooled::DiscardableMemoryPooled(
+    size_t bytes,
+    DiscardableMemoryPooledAllocator* allocator)
+    : bytes_(bytes),
+      allocator_(allocator),
+      is_locked_(false) {
+}
+
+DiscardableMemoryPooled::~DiscardableMemoryPooled() {
+  if (is_locked_)
+    Unlock();
+}
+
+bool DiscardableMemoryPooled::Initialize() {
+  pooled_chunk_ = allocator_->Allocate(bytes_);
+  if (!pooled_chunk_)
+    return false;
+
+  is_locked_ = true;
+  return true;
+}
+
+DiscardableMemoryLockStatus DiscardableMemoryPooled::Lock() {
+  DCHECK(!is_locked_);
+  DCHECK(pooled_chunk_);
+
+  bool resident = pooled_chunk_->Lock();
+  is_locked_ = true;
+  return resident ? DISCARDABLE_MEMORY_LOCK_STATUS_SUCCESS
+                  : DISCARDABLE_MEMORY_LOCK_STATUS_PURGED;
+}
+
+void DiscardableMemoryPooled::Unlock() {
+  DCHECK(is_locked_);
+  pooled_chunk_->Unlock();
+  is_locked_ = false;
+}
+
+void* DiscardableMemoryPooled::Memory() const {
+  DCHECK(is_locked_);
+  return pooled_chunk_->Memory();
+}
+
+}  // namespace internal
+}  // namespace base
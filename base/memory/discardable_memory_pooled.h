@@ -0,0 +1,45 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef BASE_MEMORY_DISCARDABLE_MEMORY_POOLED_H_
+#define BASE_MEMORY_DISCARDABLE_MEMORY_POOLED_H_
+
+#include "base/memory/discardable_memory.h"
+
+#include "base/macros.h"
+
+namespace base {
+namespace internal {
+
+class DiscardablePooledChunk;
+class DiscardableMemoryPooledAllocator;
+
+// Unlike the other implementations, not tracked by a DiscardableMemoryManager:
+// |allocator| purges the memory itself.
+class DiscardableMemoryPooled : public DiscardableMemory {
+ public:
+  DiscardableMemoryPooled(size_t bytes,
+                          DiscardableMemoryPooledAllocator* allocator);
+  virtual ~DiscardableMemoryPooled();
+
+  bool Initialize();
+
+  // Overridden from DiscardableMemory:
+  virtual DiscardableMemoryLockStatus Lock() OVERRIDE;
+  virtual void Unlock() OVERRIDE;
+  virtual void* Memory() const OVERRIDE;
+
+ private:
+  const size_t bytes_;
+  DiscardableMemoryPooledAllocator* const allocator_;
+  bool is_locked_;
+  scoped_ptr<DiscardablePooledChunk> pooled_chunk_;
+
+  DISALLOW_COPY_AND_ASSIGN(DiscardableMemoryPooled);
+};
+
+}  // namespace internal
+}  // namespace base
+
+#endif  // BASE_MEMORY_DISCARDABLE_MEMORY_POOLED_H_
@@ -0,0 +1,411 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/memory/discardable_memory_pooled_allocator.h"
+
+#include <sys/mman.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "base/logging.h"
+#include "base/synchronization/lock.h"
+
+// The allocator consists of four parts (classes):
+// - DiscardableMemoryPooledAllocator: entry point of all allocations (through
+// its Allocate() method) that are dispatched to the PooledSizeClass instances
+// (which it owns), and of purging.
+// - PooledSizeClass: manages the regions of a slot size, under its own lock.
+// - PooledRegion: a large (e.g. 1 MByte) anonymous mapping divided into slots.
+// - DiscardablePooledChunk: class mimicking the DiscardableMemory interface
+// whose instances are returned to the client.
+
+namespace base {
+namespace {
+
+const size_t kMinSlotSize = 256;
+const size_t kRegionSize = 1024 * 1024;
+
+// The states of a slot.
+enum SlotState {
+  SLOT_FREE,
+  SLOT_LOCKED,
+  SLOT_UNLOCKED,
+  // Unlocked, and the region was purged since.
+  SLOT_PURGED,
+};
+
+}  // namespace
+
+namespace internal {
+
+class PooledRegion {
+ public:
+  // Returns NULL if the region couldn't be mapped.
+  static scoped_ptr<PooledRegion> Create(size_t slot_size, int id) {
+    size_t slot_count = std::max<size_t>(kRegionSize / slot_size, 1);
+    size_t size = slot_count * slot_size;
+    void* address = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (address == MAP_FAILED) {
+      DPLOG(ERROR) << "Failed to map memory.";
+      return scoped_ptr<PooledRegion>();
+    }
+    return make_scoped_ptr(new PooledRegion(static_cast<char*>(address), size,
+                                            slot_size, slot_count, id));
+  }
+
+  ~PooledRegion() {
+    DCHECK_EQ(0u, used_count_);
+    if (munmap(address_, size_) == -1)
+      DPLOG(ERROR) << "Failed to unmap memory.";
+  }
+
+  int id() const { return id_; }
+  size_t size() const { return size_; }
+  bool resident() const { return resident_; }
+  bool has_free_slot() const { return !free_slots_.empty(); }
+  bool is_empty() const { return used_count_ == 0; }
+  bool can_be_purged() const { return resident_ && locked_count_ == 0; }
+  intptr_t last_unlock_stamp() const { return last_unlock_stamp_; }
+
+  void* GetSlotAddress(size_t slot) const {
+    return address_ + slot * slot_size_;
+  }
+
+  // Each returns the change of the resident size.
+  intptr_t AllocateSlot(size_t* slot) {
+    DCHECK(has_free_slot());
+    *slot = free_slots_.back();
+    free_slots_.pop_back();
+    slot_states_[*slot] = SLOT_LOCKED;
+    ++used_count_;
+    ++locked_count_;
+    return MakeResident();
+  }
+
+  intptr_t LockSlot(size_t slot, bool* resident) {
+    DCHECK(slot_states_[slot] == SLOT_UNLOCKED ||
+           slot_states_[slot] == SLOT_PURGED);
+    *resident = slot_states_[slot] == SLOT_UNLOCKED;
+    slot_states_[slot] = SLOT_LOCKED;
+    ++locked_count_;
+    return MakeResident();
+  }
+
+  void UnlockSlot(size_t slot, intptr_t stamp) {
+    DCHECK_EQ(SLOT_LOCKED, slot_states_[slot]);
+    slot_states_[slot] = SLOT_UNLOCKED;
+    --locked_count_;
+    last_unlock_stamp_ = stamp;
+  }
+
+  void FreeSlot(size_t slot) {
+    DCHECK_NE(SLOT_FREE, slot_states_[slot]);
+    if (slot_states_[slot] == SLOT_LOCKED)
+      --locked_count_;
+    slot_states_[slot] = SLOT_FREE;
+    free_slots_.push_back(slot);
+    --used_count_;
+  }
+
+  intptr_t Purge() {
+    DCHECK(can_be_purged());
+    // The pages are zero-filled when next touched. MADV_FREE would save the
+    // page faults if the memory isn't needed, but the pages it discards can't
+    // be told from those it doesn't.
+    if (madvise(address_, size_, MADV_DONTNEED) == -1) {
+      DPLOG(ERROR) << "Failed to purge memory.";
+      return 0;
+    }
+    for (size_t i = 0; i < slot_states_.size(); ++i) {
+      if (slot_states_[i] == SLOT_UNLOCKED)
+        slot_states_[i] = SLOT_PURGED;
+    }
+    resident_ = false;
+    return -static_cast<intptr_t>(size_);
+  }
+
+  // Returns minus the resident size of the region, before it is deleted.
+  intptr_t Release() const {
+    return resident_ ? -static_cast<intptr_t>(size_) : 0;
+  }
+
+ private:
+  PooledRegion(char* address,
+               size_t size,
+               size_t slot_size,
+               size_t slot_count,
+               int id)
+      : address_(address),
+        size_(size),
+        slot_size_(slot_size),
+        id_(id),
+        slot_states_(slot_count, SLOT_FREE),
+        used_count_(0),
+        locked_count_(0),
+        resident_(true),
+        last_unlock_stamp_(0) {
+    // Hand out the slots in address order.
+    free_slots_.reserve(slot_count);
+    for (size_t i = slot_count; i > 0; --i)
+      free_slots_.push_back(i - 1);
+  }
+
+  intptr_t MakeResident() {
+    if (resident_)
+      return 0;
+    resident_ = true;
+    return size_;
+  }
+
+  char* const address_;
+  const size_t size_;
+  const size_t slot_size_;
+  const int id_;
+  std::vector<uint8> slot_states_;
+  std::vector<size_t> free_slots_;
+  size_t used_count_;
+  size_t locked_count_;
+  bool resident_;
+  intptr_t last_unlock_stamp_;
+
+  DISALLOW_COPY_AND_ASSIGN(PooledRegion);
+};
+
+class PooledSizeClass {
+ public:
+  // A region that can be purged, identified by its id as it may be unmapped
+  // by the time it is purged.
+  struct PurgeCandidate {
+    PurgeCandidate(intptr_t stamp, PooledSizeClass* size_class, int region_id)
+        : stamp(stamp), size_class(size_class), region_id(region_id) {}
+
+    bool operator<(const PurgeCandidate& other) const {
+      return stamp < other.stamp;
+    }
+
+    intptr_t stamp;
+    PooledSizeClass* size_class;
+    int region_id;
+  };
+
+  PooledSizeClass(DiscardableMemoryPooledAllocator* allocator,
+                  size_t slot_size)
+      : allocator_(allocator), slot_size_(slot_size), next_region_id_(0) {}
+
+  ~PooledSizeClass() {
+    for (size_t i = 0; i < regions_.size(); ++i)
+      allocator_->ResidentSizeChanged(regions_[i]->Release());
+  }
+
+  size_t slot_size() const { return slot_size_; }
+
+  scoped_ptr<DiscardablePooledChunk> Allocate() {
+    AutoLock auto_lock(lock_);
+    // Prefer the resident regions, whose pages were faulted in already.
+    PooledRegion* region = NULL;
+    for (size_t i = 0; i < regions_.size(); ++i) {
+      if (!regions_[i]->has_free_slot())
+        continue;
+      region = regions_[i];
+      if (region->resident())
+        break;
+    }
+    if (!region) {
+      scoped_ptr<PooledRegion> new_region =
+          PooledRegion::Create(slot_size_, next_region_id_++);
+      if (!new_region)
+        return scoped_ptr<DiscardablePooledChunk>();
+      allocator_->ResidentSizeChanged(new_region->size());
+      region = new_region.get();
+      regions_.push_back(new_region.release());
+    }
+
+    size_t slot;
+    allocator_->ResidentSizeChanged(region->AllocateSlot(&slot));
+    return make_scoped_ptr(new DiscardablePooledChunk(
+        this, region, slot, region->GetSlotAddress(slot)));
+  }
+
+  bool LockSlot(PooledRegion* region, size_t slot) {
+    AutoLock auto_lock(lock_);
+    bool resident;
+    allocator_->ResidentSizeChanged(region->LockSlot(slot, &resident));
+    return resident;
+  }
+
+  void UnlockSlot(PooledRegion* region, size_t slot) {
+    intptr_t stamp = allocator_->NextUnlockStamp();
+    AutoLock auto_lock(lock_);
+    region->UnlockSlot(slot, stamp);
+  }
+
+  void FreeSlot(PooledRegion* region, size_t slot) {
+    AutoLock auto_lock(lock_);
+    region->FreeSlot(slot);
+    // Keep one region mapped, not to map and unmap one over and over.
+    if (!region->is_empty() || regions_.size() == 1)
+      return;
+    allocator_->ResidentSizeChanged(region->Release());
+    regions_.erase(std::find(regions_.begin(), regions_.end(), region));
+  }
+
+  void GetPurgeCandidates(std::vector<PurgeCandidate>* candidates) {
+    AutoLock auto_lock(lock_);
+    for (size_t i = 0; i < regions_.size(); ++i) {
+      if (regions_[i]->can_be_purged()) {
+        candidates->push_back(PurgeCandidate(
+            regions_[i]->last_unlock_stamp(), this, regions_[i]->id()));
+      }
+    }
+  }
+
+  // Purges the region with |region_id| if it is still mapped, and can still
+  // be purged.
+  void PurgeRegion(int region_id) {
+    AutoLock auto_lock(lock_);
+    for (size_t i = 0; i < regions_.size(); ++i) {
+      if (regions_[i]->id() != region_id)
+        continue;
+      if (regions_[i]->can_be_purged())
+        allocator_->ResidentSizeChanged(regions_[i]->Purge());
+      return;
+    }
+  }
+
+  size_t GetRegionCount() const {
+    AutoLock auto_lock(lock_);
+    return regions_.size();
+  }
+
+ private:
+  DiscardableMemoryPooledAllocator* const allocator_;
+  const size_t slot_size_;
+
+  mutable Lock lock_;
+  ScopedVector<PooledRegion> regions_;
+  int next_region_id_;
+
+  DISALLOW_COPY_AND_ASSIGN(PooledSizeClass);
+};
+
+DiscardablePooledChunk::DiscardablePooledChunk(PooledSizeClass* size_class,
+                                               PooledRegion* region,
+                                               size_t slot,
+                                               void* address)
+    : size_class_(size_class),
+      region_(region),
+      slot_(slot),
+      address_(address),
+      locked_(true) {
+}
+
+DiscardablePooledChunk::~DiscardablePooledChunk() {
+  size_class_->FreeSlot(region_, slot_);
+}
+
+bool DiscardablePooledChunk::Lock() {
+  DCHECK(!locked_);
+  locked_ = true;
+  return size_class_->LockSlot(region_, slot_);
+}
+
+void DiscardablePooledChunk::Unlock() {
+  DCHECK(locked_);
+  locked_ = false;
+  size_class_->UnlockSlot(region_, slot_);
+}
+
+void* DiscardablePooledChunk::Memory() const {
+  return address_;
+}
+
+DiscardableMemoryPooledAllocator::DiscardableMemoryPooledAllocator(
+    size_t memory_limit,
+    size_t soft_memory_limit)
+    : memory_limit_(memory_limit),
+      soft_memory_limit_(soft_memory_limit),
+      resident_size_(0),
+      unlock_stamp_(0) {
+  for (size_t slot_size = kMinSlotSize; slot_size <= kMaxPooledSize;
+       slot_size *= 2) {
+    size_classes_.push_back(new PooledSizeClass(this, slot_size));
+  }
+}
+
+DiscardableMemoryPooledAllocator::~DiscardableMemoryPooledAllocator() {
+}
+
+scoped_ptr<DiscardablePooledChunk> DiscardableMemoryPooledAllocator::Allocate(
+    size_t size) {
+  if (size == 0 || size > kMaxPooledSize)
+    return scoped_ptr<DiscardablePooledChunk>();
+
+  size_t index = 0;
+  while (size_classes_[index]->slot_size() < size)
+    ++index;
+  scoped_ptr<DiscardablePooledChunk> chunk =
+      size_classes_[index]->Allocate();
+  if (GetResidentSize() > memory_limit_)
+    PurgeUntilWithinLimit(memory_limit_);
+  return chunk.Pass();
+}
+
+bool DiscardableMemoryPooledAllocator::ReduceMemoryUsage() {
+  return PurgeUntilWithinLimit(soft_memory_limit_);
+}
+
+void DiscardableMemoryPooledAllocator::OnMemoryPressure(
+    MemoryPressureListener::MemoryPressureLevel level) {
+  switch (level) {
+    case MemoryPressureListener::MEMORY_PRESSURE_MODERATE:
+      PurgeUntilWithinLimit(soft_memory_limit_);
+      return;
+    case MemoryPressureListener::MEMORY_PRESSURE_CRITICAL:
+      PurgeAll();
+      return;
+  }
+  NOTREACHED();
+}
+
+void DiscardableMemoryPooledAllocator::PurgeAll() {
+  PurgeUntilWithinLimit(0);
+}
+
+size_t DiscardableMemoryPooledAllocator::GetResidentSize() const {
+  return static_cast<size_t>(subtle::NoBarrier_Load(&resident_size_));
+}
+
+size_t DiscardableMemoryPooledAllocator::GetRegionCountForTesting() const {
+  size_t count = 0;
+  for (size_t i = 0; i < size_classes_.size(); ++i)
+    count += size_classes_[i]->GetRegionCount();
+  return count;
+}
+
+bool DiscardableMemoryPooledAllocator::PurgeUntilWithinLimit(size_t limit) {
+  if (GetResidentSize() <= limit)
+    return true;
+
+  std::vector<PooledSizeClass::PurgeCandidate> candidates;
+  for (size_t i = 0; i < size_classes_.size(); ++i)
+    size_classes_[i]->GetPurgeCandidates(&candidates);
+  std::sort(candidates.begin(), candidates.end());
+  for (size_t i = 0; i < candidates.size() && GetResidentSize() > limit; ++i)
+    candidates[i].size_class->PurgeRegion(candidates[i].region_id);
+  return GetResidentSize() <= limit;
+}
+
+void DiscardableMemoryPooledAllocator::ResidentSizeChanged(intptr_t delta) {
+  if (delta)
+    subtle::NoBarrier_AtomicIncrement(&resident_size_, delta);
+}
+
+intptr_t DiscardableMemoryPooledAllocator::NextUnlockStamp() {
+  return subtle::NoBarrier_AtomicIncrement(&unlock_stamp_, 1);
+}
+
+}  // namespace internal
+}  // namespace base
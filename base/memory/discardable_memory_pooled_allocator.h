@@ -0,0 +1,130 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef BASE_MEMORY_DISCARDABLE_MEMORY_POOLED_ALLOCATOR_H_
+#define BASE_MEMORY_DISCARDABLE_MEMORY_POOLED_ALLOCATOR_H_
+
+#include "base/atomicops.h"
+#include "base/base_export.h"
+#include "base/basictypes.h"
+#include "base/memory/memory_pressure_listener.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/memory/scoped_vector.h"
+
+namespace base {
+namespace internal {
+
+class PooledRegion;
+class PooledSizeClass;
+
+// Internal class, whose instances are returned to the client of the allocator
+// (e.g. DiscardableMemoryPooled), that mimicks the DiscardableMemory interface.
+class BASE_EXPORT_PRIVATE DiscardablePooledChunk {
+ public:
+  ~DiscardablePooledChunk();
+
+  // Returns whether the memory is still resident.
+  bool Lock();
+
+  void Unlock();
+
+  void* Memory() const;
+
+ private:
+  friend class PooledSizeClass;
+
+  DiscardablePooledChunk(PooledSizeClass* size_class,
+                         PooledRegion* region,
+                         size_t slot,
+                         void* address);
+
+  PooledSizeClass* const size_class_;
+  PooledRegion* const region_;
+  const size_t slot_;
+  void* const address_;
+  bool locked_;
+
+  DISALLOW_COPY_AND_ASSIGN(DiscardablePooledChunk);
+};
+
+// Allocating discardable memory one mapping at a time costs a system call,
+// and tracking it in DiscardableMemoryManager a map node, for every
+// allocation. This allocator instead carves the chunks it returns out of
+// large anonymous mappings, "regions", each divided into slots of one size
+// class, so that allocating, locking and unlocking a chunk only takes the
+// lock of its size class.
+//
+// A region is purged as a whole, with a single madvise(MADV_DONTNEED), once
+// none of its chunks is locked: least recently unlocked first when the
+// resident size goes over the memory limit, under memory pressure, or when
+// memory usage is reduced. Locking a chunk of a purged region then reports
+// that its contents were lost.
+//
+// Allocations are rounded up to a power of two, so that this should not be
+// used for allocations larger than kMaxPooledSize.
+class BASE_EXPORT_PRIVATE DiscardableMemoryPooledAllocator {
+ public:
+  // The largest allocation the allocator makes.
+  static const size_t kMaxPooledSize = 256 * 1024;
+
+  // |memory_limit| is the resident size above which allocating purges
+  // regions, and |soft_memory_limit| the one ReduceMemoryUsage() and
+  // moderate memory pressure purge regions down to.
+  DiscardableMemoryPooledAllocator(size_t memory_limit,
+                                   size_t soft_memory_limit);
+
+  // All of the chunks must have been deleted.
+  ~DiscardableMemoryPooledAllocator();
+
+  // Returns a locked chunk of at least |size| bytes, or NULL if |size| is 0 or
+  // larger than kMaxPooledSize, or a region couldn't be mapped. Note that the
+  // allocator must outlive the returned chunk.
+  scoped_ptr<DiscardablePooledChunk> Allocate(size_t size);
+
+  // Purges regions until the resident size is within the soft memory limit.
+  // Returns true if it is.
+  bool ReduceMemoryUsage();
+
+  // Purges regions according to |level|: down to the soft memory limit if
+  // moderate, and all of them if critical.
+  void OnMemoryPressure(MemoryPressureListener::MemoryPressureLevel level);
+
+  // Purges all of the regions of which no chunk is locked.
+  void PurgeAll();
+
+  // Returns the size of the regions which were not purged since their
+  // chunks were last locked.
+  size_t GetResidentSize() const;
+
+  // Returns the number of regions mapped. This is used for testing only.
+  size_t GetRegionCountForTesting() const;
+
+ private:
+  friend class PooledSizeClass;
+
+  // Purges the regions of which no chunk is locked, least recently unlocked
+  // first, until the resident size is within |limit|. Returns true if it is.
+  bool PurgeUntilWithinLimit(size_t limit);
+
+  // Called by the size classes as regions are mapped, purged, used again and
+  // unmapped.
+  void ResidentSizeChanged(intptr_t delta);
+
+  // Returns a stamp that is greater than the ones returned before, to order
+  // the regions by when they were unlocked.
+  intptr_t NextUnlockStamp();
+
+  const size_t memory_limit_;
+  const size_t soft_memory_limit_;
+  ScopedVector<PooledSizeClass> size_classes_;
+  subtle::AtomicWord resident_size_;
+  subtle::AtomicWord unlock_stamp_;
+
+  DISALLOW_COPY_AND_ASSIGN(DiscardableMemoryPooledAllocator);
+};
+
+}  // namespace internal
+}  // namespace base
+
+#endif  // BASE_MEMORY_DISCARDABLE_MEMORY_POOLED_ALLOCATOR_H_
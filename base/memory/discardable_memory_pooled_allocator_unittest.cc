@@ -0,0 +1,181 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/memory/discardable_memory_pooled_allocator.h"
+
+#include <string.h>
+
+#include "base/memory/scoped_ptr.h"
+#include "base/memory/scoped_vector.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace base {
+namespace internal {
+
+const size_t kRegionSize = 1024 * 1024;
+const size_t kMemoryLimitForTesting = 64 * kRegionSize;
+const size_t kSoftMemoryLimitForTesting = 8 * kRegionSize;
+
+class DiscardableMemoryPooledAllocatorTest : public testing::Test {
+ protected:
+  DiscardableMemoryPooledAllocatorTest()
+      : allocator_(kMemoryLimitForTesting, kSoftMemoryLimitForTesting) {
+  }
+
+  DiscardableMemoryPooledAllocator allocator_;
+};
+
+char* GetMemory(DiscardablePooledChunk* chunk) {
+  return static_cast<char*>(chunk->Memory());
+}
+
+TEST_F(DiscardableMemoryPooledAllocatorTest, Basic) {
+  const size_t size = 128;
+  scoped_ptr<DiscardablePooledChunk> chunk(allocator_.Allocate(size));
+  ASSERT_TRUE(chunk);
+  memset(chunk->Memory(), 'a', size);
+  chunk->Unlock();
+  EXPECT_TRUE(chunk->Lock());
+  EXPECT_EQ('a', GetMemory(chunk.get())[size - 1]);
+}
+
+TEST_F(DiscardableMemoryPooledAllocatorTest, UnsupportedSizesFail) {
+  EXPECT_FALSE(allocator_.Allocate(0));
+  EXPECT_FALSE(allocator_.Allocate(
+      DiscardableMemoryPooledAllocator::kMaxPooledSize + 1));
+  EXPECT_TRUE(allocator_.Allocate(
+      DiscardableMemoryPooledAllocator::kMaxPooledSize));
+}
+
+TEST_F(DiscardableMemoryPooledAllocatorTest, ChunksOfASizeClassShareRegions) {
+  ScopedVector<DiscardablePooledChunk> chunks;
+  for (size_t i = 0; i < 100; ++i) {
+    chunks.push_back(allocator_.Allocate(1000).release());
+    ASSERT_TRUE(chunks.back());
+  }
+  EXPECT_EQ(1u, allocator_.GetRegionCountForTesting());
+  EXPECT_EQ(kRegionSize, allocator_.GetResidentSize());
+
+  // Rounded up to 1024 bytes.
+  for (size_t i = 1; i < chunks.size(); ++i)
+    EXPECT_EQ(1024, GetMemory(chunks[i]) - GetMemory(chunks[i - 1]));
+
+  scoped_ptr<DiscardablePooledChunk> other_size(allocator_.Allocate(5000));
+  ASSERT_TRUE(other_size);
+  EXPECT_EQ(2u, allocator_.GetRegionCountForTesting());
+}
+
+TEST_F(DiscardableMemoryPooledAllocatorTest, EmptyRegionsAreUnmapped) {
+  // Four chunks of the largest size class fit in a region.
+  ScopedVector<DiscardablePooledChunk> chunks;
+  for (size_t i = 0; i < 9; ++i) {
+    chunks.push_back(allocator_.Allocate(
+        DiscardableMemoryPooledAllocator::kMaxPooledSize).release());
+  }
+  EXPECT_EQ(3u, allocator_.GetRegionCountForTesting());
+  EXPECT_EQ(3 * kRegionSize, allocator_.GetResidentSize());
+
+  // One region of the size class is kept.
+  chunks.clear();
+  EXPECT_EQ(1u, allocator_.GetRegionCountForTesting());
+  EXPECT_EQ(kRegionSize, allocator_.GetResidentSize());
+}
+
+TEST_F(DiscardableMemoryPooledAllocatorTest, Purge) {
+  const size_t size = 4096;
+  scoped_ptr<DiscardablePooledChunk> chunk(allocator_.Allocate(size));
+  ASSERT_TRUE(chunk);
+  memset(chunk->Memory(), 'a', size);
+
+  // Locked chunks are not purged.
+  allocator_.PurgeAll();
+  EXPECT_EQ(kRegionSize, allocator_.GetResidentSize());
+  EXPECT_EQ('a', GetMemory(chunk.get())[0]);
+
+  chunk->Unlock();
+  allocator_.PurgeAll();
+  EXPECT_EQ(0u, allocator_.GetResidentSize());
+  EXPECT_FALSE(chunk->Lock());
+  EXPECT_EQ(kRegionSize, allocator_.GetResidentSize());
+  EXPECT_EQ(0, GetMemory(chunk.get())[0]);
+
+  // The chunk is resident again once it is locked.
+  memset(chunk->Memory(), 'b', size);
+  chunk->Unlock();
+  EXPECT_TRUE(chunk->Lock());
+  EXPECT_EQ('b', GetMemory(chunk.get())[0]);
+}
+
+TEST_F(DiscardableMemoryPooledAllocatorTest, RegionsArePurgedAsAWhole) {
+  scoped_ptr<DiscardablePooledChunk> locked(allocator_.Allocate(1024));
+  scoped_ptr<DiscardablePooledChunk> unlocked(allocator_.Allocate(1024));
+  ASSERT_TRUE(locked && unlocked);
+  GetMemory(unlocked.get())[0] = 'a';
+  unlocked->Unlock();
+
+  // The region has a locked chunk.
+  allocator_.PurgeAll();
+  EXPECT_TRUE(unlocked->Lock());
+  EXPECT_EQ('a', GetMemory(unlocked.get())[0]);
+
+  locked->Unlock();
+  unlocked->Unlock();
+  allocator_.PurgeAll();
+  EXPECT_FALSE(locked->Lock());
+  EXPECT_FALSE(unlocked->Lock());
+}
+
+TEST(DiscardableMemoryPooledAllocatorLimitTest,
+     PurgesLeastRecentlyUnlockedFirst) {
+  DiscardableMemoryPooledAllocator allocator(kMemoryLimitForTesting,
+                                             kRegionSize);
+  // A region for each of the sizes.
+  const size_t kSizes[] = { 1024, 2048, 4096 };
+  ScopedVector<DiscardablePooledChunk> chunks;
+  for (size_t i = 0; i < arraysize(kSizes); ++i)
+    chunks.push_back(allocator.Allocate(kSizes[i]).release());
+  EXPECT_EQ(3 * kRegionSize, allocator.GetResidentSize());
+  chunks[1]->Unlock();
+  chunks[0]->Unlock();
+  chunks[2]->Unlock();
+
+  EXPECT_TRUE(allocator.ReduceMemoryUsage());
+  EXPECT_EQ(kRegionSize, allocator.GetResidentSize());
+  EXPECT_FALSE(chunks[0]->Lock());
+  EXPECT_FALSE(chunks[1]->Lock());
+  EXPECT_TRUE(chunks[2]->Lock());
+}
+
+TEST(DiscardableMemoryPooledAllocatorLimitTest, MemoryLimit) {
+  DiscardableMemoryPooledAllocator allocator(2 * kRegionSize, kRegionSize);
+  scoped_ptr<DiscardablePooledChunk> first(allocator.Allocate(1024));
+  scoped_ptr<DiscardablePooledChunk> second(allocator.Allocate(2048));
+  first->Unlock();
+  second->Unlock();
+
+  // Going over the limit purges the least recently unlocked region.
+  scoped_ptr<DiscardablePooledChunk> third(allocator.Allocate(4096));
+  EXPECT_EQ(2 * kRegionSize, allocator.GetResidentSize());
+  EXPECT_FALSE(first->Lock());
+  EXPECT_TRUE(second->Lock());
+}
+
+TEST(DiscardableMemoryPooledAllocatorLimitTest, MemoryPressure) {
+  DiscardableMemoryPooledAllocator allocator(kMemoryLimitForTesting,
+                                             kRegionSize);
+  const size_t kSizes[] = { 1024, 2048, 4096 };
+  ScopedVector<DiscardablePooledChunk> chunks;
+  for (size_t i = 0; i < arraysize(kSizes); ++i) {
+    chunks.push_back(allocator.Allocate(kSizes[i]).release());
+    chunks.back()->Unlock();
+  }
+
+  allocator.OnMemoryPressure(MemoryPressureListener::MEMORY_PRESSURE_MODERATE);
+  EXPECT_EQ(kRegionSize, allocator.GetResidentSize());
+  allocator.OnMemoryPressure(MemoryPressureListener::MEMORY_PRESSURE_CRITICAL);
+  EXPECT_EQ(0u, allocator.GetResidentSize());
+}
+
+}  // namespace internal
+}  // namespace base
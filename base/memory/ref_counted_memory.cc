@@ -7,6 +7,7 @@
 #include <stdlib.h>
 
 #include "base/logging.h"
+#include "base/memory/shared_memory.h"
 
 namespace base {
 
@@ -97,4 +98,22 @@ RefCountedMallocedMemory::~RefCountedMallocedMemory() {
   free(data_);
 }
 
+RefCountedSharedMemory::RefCountedSharedMemory(
+    scoped_ptr<SharedMemory> shared_memory, size_t size)
+    : shared_memory_(shared_memory.Pass()), size_(size) {
+  DCHECK(shared_memory_->memory());
+  DCHECK_LE(size_, shared_memory_->mapped_size());
+}
+
+const unsigned char* RefCountedSharedMemory::front() const {
+  return size_ ? static_cast<const unsigned char*>(shared_memory_->memory())
+               : NULL;
+}
+
+size_t RefCountedSharedMemory::size() const {
+  return size_;
+}
+
+RefCountedSharedMemory::~RefCountedSharedMemory() {}
+
 }  //  namespace base
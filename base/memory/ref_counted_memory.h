@@ -11,9 +11,12 @@
 #include "base/base_export.h"
 #include "base/compiler_specific.h"
 #include "base/memory/ref_counted.h"
+#include "base/memory/scoped_ptr.h"
 
 namespace base {
 
+class SharedMemory;
+
 // A generic interface to memory. This object is reference counted because one
 // of its two subclasses own the data they carry, and we need to have
 // heterogeneous containers of these two types of memory.
@@ -141,6 +144,27 @@ class BASE_EXPORT RefCountedMallocedMemory : public base::RefCountedMemory {
   DISALLOW_COPY_AND_ASSIGN(RefCountedMallocedMemory);
 };
 
+// An implementation of RefCountedMemory over a mapped SharedMemory region,
+// which it owns. This hands the contents of a region to an API that takes
+// RefCountedMemory, like Pickle::WriteDataReference(), without copying them.
+class BASE_EXPORT RefCountedSharedMemory : public RefCountedMemory {
+ public:
+  // |shared_memory| must be mapped, and at least |size| bytes long.
+  RefCountedSharedMemory(scoped_ptr<SharedMemory> shared_memory, size_t size);
+
+  // Overridden from RefCountedMemory:
+  virtual const unsigned char* front() const OVERRIDE;
+  virtual size_t size() const OVERRIDE;
+
+ private:
+  virtual ~RefCountedSharedMemory();
+
+  scoped_ptr<SharedMemory> shared_memory_;
+  size_t size_;
+
+  DISALLOW_COPY_AND_ASSIGN(RefCountedSharedMemory);
+};
+
 }  // namespace base
 
 #endif  // BASE_MEMORY_REF_COUNTED_MEMORY_H_
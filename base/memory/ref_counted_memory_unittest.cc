@@ -4,6 +4,7 @@
 
 #include "base/memory/ref_counted_memory.h"
 
+#include "base/memory/shared_memory.h"
 #include "testing/gtest/include/gtest/gtest.h"
 
 namespace base {
@@ -60,6 +61,17 @@ TEST(RefCountedMemoryUnitTest, RefCountedMallocedMemory) {
   EXPECT_EQ(0, memcmp("hello", mem->front(), 6));
 }
 
+TEST(RefCountedMemoryUnitTest, RefCountedSharedMemory) {
+  scoped_ptr<SharedMemory> shared_memory(new SharedMemory);
+  ASSERT_TRUE(shared_memory->CreateAndMapAnonymous(64));
+  memcpy(shared_memory->memory(), "shared", 6);
+  scoped_refptr<RefCountedMemory> mem =
+      new RefCountedSharedMemory(shared_memory.Pass(), 6);
+
+  EXPECT_EQ(6U, mem->size());
+  EXPECT_EQ("shared", std::string(mem->front_as<char>(), mem->size()));
+}
+
 TEST(RefCountedMemoryUnitTest, Equals) {
   std::string s1("same");
   scoped_refptr<RefCountedMemory> mem1 = RefCountedString::TakeString(&s1);
@@ -0,0 +1,294 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/message_loop/delayed_task_wheel.h"
+
+#include <algorithm>
+#include <limits>
+
+#include "base/logging.h"
+#include "base/time/time.h"
+
+#if defined(COMPILER_MSVC)
+#include <intrin.h>
+#endif
+
+namespace base {
+
+namespace {
+
+const uint32 kNone = std::numeric_limits<uint32>::max();
+
+// Where a node is, when not in a slot of a level of the wheel.
+enum {
+  kOverflow = 100,
+  kEarliest = -1,
+  // In the heap of the earliest tasks, and erased.
+  kCancelled = -2,
+  kFree = -3,
+};
+
+// Returns the index of the lowest bit set in |bits|, which must not be 0.
+int FindFirstSet(uint64 bits) {
+  DCHECK(bits);
+#if defined(COMPILER_GCC)
+  return __builtin_ctzll(bits);
+#elif defined(COMPILER_MSVC)
+  unsigned long index;
+  if (_BitScanForward(&index, static_cast<uint32>(bits)))
+    return index;
+  _BitScanForward(&index, static_cast<uint32>(bits >> 32));
+  return 32 + index;
+#else
+  int index = 0;
+  while (!(bits & 1)) {
+    bits >>= 1;
+    ++index;
+  }
+  return index;
+#endif
+}
+
+int64 TickOf(const PendingTask& pending_task) {
+  return pending_task.delayed_run_time.ToInternalValue() /
+         Time::kMicrosecondsPerMillisecond;
+}
+
+}  // namespace
+
+struct DelayedTaskWheel::Node {
+  explicit Node(const PendingTask& pending_task)
+      : task(pending_task),
+        tick(0),
+        prev(kNone),
+        next(kNone),
+        generation(1),
+        location(kFree),
+        slot(0) {}
+
+  PendingTask task;
+  int64 tick;
+  // Links of the list of a slot, or of the overflow list.
+  uint32 prev;
+  uint32 next;
+  // Changes when the node is freed, making its handles stale.
+  uint32 generation;
+  // A level of the wheel, kOverflow, kEarliest, kCancelled or kFree.
+  int location;
+  int slot;
+};
+
+// Orders the heap of the earliest tasks by PendingTask::operator<, which puts
+// the task to run first at its top.
+class DelayedTaskWheel::RunsLater {
+ public:
+  explicit RunsLater(const std::vector<Node>* nodes) : nodes_(nodes) {}
+
+  bool operator()(uint32 a, uint32 b) const {
+    return (*nodes_)[a].task < (*nodes_)[b].task;
+  }
+
+ private:
+  const std::vector<Node>* nodes_;
+};
+
+DelayedTaskWheel::DelayedTaskWheel()
+    : free_head_(kNone),
+      overflow_head_(kNone),
+      current_tick_(0),
+      wheel_size_(0),
+      size_(0) {
+  for (int level = 0; level < kLevels; ++level) {
+    std::fill(slots_[level], slots_[level] + kSlotsPerLevel, kNone);
+    occupied_slots_[level] = 0;
+  }
+}
+
+DelayedTaskWheel::~DelayedTaskWheel() {
+}
+
+DelayedTaskWheel::Handle DelayedTaskWheel::push(
+    const PendingTask& pending_task) {
+  DCHECK(!pending_task.delayed_run_time.is_null());
+  uint32 index = AllocateNode(pending_task);
+  Node& node = nodes_[index];
+  node.tick = TickOf(pending_task);
+  // Start the wheel over from the first task, rather than cascading it from
+  // wherever the last one left it.
+  if (size_ == 0)
+    current_tick_ = node.tick;
+  Insert(index);
+  ++size_;
+  return (static_cast<Handle>(node.generation) << 32) | index;
+}
+
+bool DelayedTaskWheel::erase(Handle handle) {
+  uint32 index = static_cast<uint32>(handle);
+  uint32 generation = static_cast<uint32>(handle >> 32);
+  if (index >= nodes_.size())
+    return false;
+  Node& node = nodes_[index];
+  if (node.generation != generation || node.location == kFree ||
+      node.location == kCancelled) {
+    return false;
+  }
+
+  // The task is deleted last, as that may call back into the wheel.
+  Closure task = node.task.task;
+  node.task.task.Reset();
+  if (node.location == kEarliest) {
+    // Dropped once at the top of the heap.
+    node.location = kCancelled;
+    if (++node.generation == 0)
+      node.generation = 1;
+  } else {
+    Unlink(index);
+    FreeNode(index);
+  }
+  --size_;
+  return true;
+}
+
+const PendingTask& DelayedTaskWheel::top() {
+  DCHECK(!empty());
+  for (;;) {
+    PullEarliest();
+    uint32 index = earliest_.front();
+    if (nodes_[index].location != kCancelled)
+      return nodes_[index].task;
+    std::pop_heap(earliest_.begin(), earliest_.end(), RunsLater(&nodes_));
+    earliest_.pop_back();
+    FreeNode(index);
+  }
+}
+
+void DelayedTaskWheel::pop() {
+  top();
+  uint32 index = earliest_.front();
+  std::pop_heap(earliest_.begin(), earliest_.end(), RunsLater(&nodes_));
+  earliest_.pop_back();
+  Closure task = nodes_[index].task.task;
+  nodes_[index].task.task.Reset();
+  FreeNode(index);
+  --size_;
+}
+
+uint32 DelayedTaskWheel::AllocateNode(const PendingTask& pending_task) {
+  if (free_head_ == kNone) {
+    DCHECK_LT(nodes_.size(), static_cast<size_t>(kNone));
+    nodes_.push_back(Node(pending_task));
+    return static_cast<uint32>(nodes_.size() - 1);
+  }
+  uint32 index = free_head_;
+  free_head_ = nodes_[index].next;
+  nodes_[index].task = pending_task;
+  return index;
+}
+
+void DelayedTaskWheel::FreeNode(uint32 index) {
+  Node& node = nodes_[index];
+  DCHECK(node.task.task.is_null());
+  node.location = kFree;
+  if (++node.generation == 0)
+    node.generation = 1;
+  node.prev = kNone;
+  node.next = free_head_;
+  free_head_ = index;
+}
+
+void DelayedTaskWheel::Insert(uint32 index) {
+  Node& node = nodes_[index];
+  if (node.tick <= current_tick_) {
+    node.location = kEarliest;
+    earliest_.push_back(index);
+    std::push_heap(earliest_.begin(), earliest_.end(), RunsLater(&nodes_));
+    return;
+  }
+
+  ++wheel_size_;
+  // The lowest level whose slots are as long as the span of the ticks the
+  // task and the wheel do not share.
+  uint64 differing = node.tick ^ current_tick_;
+  for (int level = 0; level < kLevels; ++level) {
+    if (differing >> ((level + 1) * kLevelBits))
+      continue;
+    int slot = (node.tick >> (level * kLevelBits)) & (kSlotsPerLevel - 1);
+    node.location = level;
+    node.slot = slot;
+    Link(index, &slots_[level][slot]);
+    occupied_slots_[level] |= GG_UINT64_C(1) << slot;
+    return;
+  }
+  node.location = kOverflow;
+  Link(index, &overflow_head_);
+}
+
+void DelayedTaskWheel::Link(uint32 index, uint32* head) {
+  Node& node = nodes_[index];
+  node.prev = kNone;
+  node.next = *head;
+  if (*head != kNone)
+    nodes_[*head].prev = index;
+  *head = index;
+}
+
+void DelayedTaskWheel::Unlink(uint32 index) {
+  Node& node = nodes_[index];
+  uint32* head = node.location == kOverflow ?
+      &overflow_head_ : &slots_[node.location][node.slot];
+  if (node.prev != kNone)
+    nodes_[node.prev].next = node.next;
+  else
+    *head = node.next;
+  if (node.next != kNone)
+    nodes_[node.next].prev = node.prev;
+  if (*head == kNone && node.location != kOverflow)
+    occupied_slots_[node.location] &= ~(GG_UINT64_C(1) << node.slot);
+  node.prev = node.next = kNone;
+  --wheel_size_;
+}
+
+void DelayedTaskWheel::PullEarliest() {
+  while (earliest_.empty()) {
+    DCHECK(wheel_size_);
+    int level = 0;
+    while (level < kLevels && !occupied_slots_[level])
+      ++level;
+
+    uint32 head;
+    if (level < kLevels) {
+      // Move the wheel to the start of the first occupied slot of the lowest
+      // occupied level, which holds the earliest tasks: those of the later
+      // slots and of the higher levels are after it.
+      int slot = FindFirstSet(occupied_slots_[level]);
+      int shift = level * kLevelBits;
+      int64 level_mask = (GG_INT64_C(1) << (shift + kLevelBits)) - 1;
+      current_tick_ = (current_tick_ & ~level_mask) |
+                      (static_cast<int64>(slot) << shift);
+      head = slots_[level][slot];
+      slots_[level][slot] = kNone;
+      occupied_slots_[level] &= ~(GG_UINT64_C(1) << slot);
+    } else {
+      // Only tasks too far ahead for the wheel are left: move it to the first
+      // of them, and place them all again.
+      head = overflow_head_;
+      overflow_head_ = kNone;
+      current_tick_ = std::numeric_limits<int64>::max();
+      for (uint32 index = head; index != kNone; index = nodes_[index].next)
+        current_tick_ = std::min(current_tick_, nodes_[index].tick);
+    }
+    Cascade(head);
+  }
+}
+
+void DelayedTaskWheel::Cascade(uint32 head) {
+  while (head != kNone) {
+    uint32 index = head;
+    head = nodes_[index].next;
+    --wheel_size_;
+    Insert(index);
+  }
+}
+
+}  // namespace base
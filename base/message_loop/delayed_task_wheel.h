@@ -0,0 +1,116 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef BASE_MESSAGE_LOOP_DELAYED_TASK_WHEEL_H_
+#define BASE_MESSAGE_LOOP_DELAYED_TASK_WHEEL_H_
+
+#include <vector>
+
+#include "base/base_export.h"
+#include "base/basictypes.h"
+#include "base/pending_task.h"
+
+namespace base {
+
+// The delayed work queue of MessageLoop: a hierarchical timing wheel of
+// delayed PendingTasks, which runs them in the same order as DelayedTaskQueue,
+// by |delayed_run_time| and then |sequence_num|.
+//
+// A std::priority_queue costs O(log n) per task, and a task can't be taken
+// out of it before its turn, so the cancelled timeouts of network code pile
+// up until they are due. Here, pushing a task links it into a slot of the
+// wheel and cancelling one unlinks it, both in O(1).
+//
+// The wheel has kLevels levels of kSlotsPerLevel slots, each slot of a level
+// spanning as many milliseconds as the whole level below. A task goes into
+// the lowest level whose slot span tells it apart from the current position
+// of the wheel, and is moved down a level, once at most per level, as the
+// wheel reaches its slot. The tasks of the earliest millisecond are kept in a
+// heap, which orders them exactly. Tasks too far ahead for the wheel wait in
+// an overflow list.
+//
+// Not thread safe: only the thread of the MessageLoop uses it.
+class BASE_EXPORT DelayedTaskWheel {
+ public:
+  // Identifies a task, for erase(). 0 is never a handle.
+  typedef uint64 Handle;
+
+  DelayedTaskWheel();
+  ~DelayedTaskWheel();
+
+  // Adds |pending_task|, which must have a |delayed_run_time|.
+  Handle push(const PendingTask& pending_task);
+
+  // Deletes the task of |handle|, if it wasn't popped or erased yet. Returns
+  // whether it was.
+  bool erase(Handle handle);
+
+  // Returns the task to run first. The wheel must not be empty.
+  const PendingTask& top();
+
+  // Deletes the task returned by top().
+  void pop();
+
+  bool empty() const { return size_ == 0; }
+  size_t size() const { return size_; }
+
+ private:
+  enum {
+    kLevelBits = 6,
+    kSlotsPerLevel = 1 << kLevelBits,
+    kLevels = 5,
+  };
+
+  struct Node;
+  class RunsLater;
+
+  // Returns the index of a node holding |pending_task|.
+  uint32 AllocateNode(const PendingTask& pending_task);
+
+  // Releases the node at |index|, invalidating its handle.
+  void FreeNode(uint32 index);
+
+  // Puts the node at |index| in the heap of the earliest tasks if its tick is
+  // not after the current one, and in the wheel otherwise.
+  void Insert(uint32 index);
+
+  // Links the node at |index| into |*head|.
+  void Link(uint32 index, uint32* head);
+
+  // Unlinks the node at |index| from the wheel.
+  void Unlink(uint32 index);
+
+  // Fills the heap of the earliest tasks, if empty, from the wheel.
+  void PullEarliest();
+
+  // Moves the tasks of |head| into the heap or lower levels of the wheel.
+  void Cascade(uint32 head);
+
+  std::vector<Node> nodes_;
+  // Freed nodes, linked through their |next|.
+  uint32 free_head_;
+
+  // The lists of tasks of the slots, and the slots which are not empty.
+  uint32 slots_[kLevels][kSlotsPerLevel];
+  uint64 occupied_slots_[kLevels];
+  uint32 overflow_head_;
+
+  // Heap of the tasks of the earliest tick. It also holds the erased tasks
+  // which were in it, until they reach its top.
+  std::vector<uint32> earliest_;
+
+  // The position of the wheel, in milliseconds: the tasks in the heap are not
+  // after it, and those in the wheel are.
+  int64 current_tick_;
+
+  // The tasks in the slots and the overflow list.
+  size_t wheel_size_;
+  size_t size_;
+
+  DISALLOW_COPY_AND_ASSIGN(DelayedTaskWheel);
+};
+
+}  // namespace base
+
+#endif  // BASE_MESSAGE_LOOP_DELAYED_TASK_WHEEL_H_
@@ -0,0 +1,152 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <string>
+#include <vector>
+
+#include "base/bind.h"
+#include "base/bind_helpers.h"
+#include "base/memory/linked_ptr.h"
+#include "base/message_loop/delayed_task_wheel.h"
+#include "base/message_loop/message_loop.h"
+#include "base/pending_task.h"
+#include "base/rand_util.h"
+#include "base/run_loop.h"
+#include "base/time/time.h"
+#include "base/timer/timer.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "testing/perf/perf_test.h"
+
+namespace base {
+
+namespace {
+
+// The timers outstanding at a time, as for the timeouts of the connections and
+// requests of a busy network stack, which are mostly restarted or stopped
+// rather than reached.
+const size_t kOutstandingTimers = 100000;
+const int kRestarts = 1000000;
+
+// Delays are spread over this, with a resolution of a microsecond.
+const int64 kMaxDelayUs = 30 * Time::kMicrosecondsPerSecond;
+
+void PrintResult(const std::string& measurement,
+                 const std::string& trace,
+                 TimeDelta elapsed,
+                 size_t count) {
+  perf_test::PrintResult(measurement, "", trace,
+                         elapsed.InMicroseconds() * 1000.0 / count, "ns", true);
+}
+
+class DelayedTaskWheelPerfTest : public testing::Test {
+ protected:
+  DelayedTaskWheelPerfTest()
+      : origin_(TimeTicks::Now()),
+        task_(Bind(&DoNothing)),
+        next_sequence_num_(0) {}
+
+  PendingTask MakeTask() {
+    PendingTask pending_task(
+        FROM_HERE, task_,
+        origin_ + TimeDelta::FromMicroseconds(RandGenerator(kMaxDelayUs)),
+        true);
+    pending_task.sequence_num = next_sequence_num_++;
+    return pending_task;
+  }
+
+  const TimeTicks origin_;
+  const Closure task_;
+  int next_sequence_num_;
+};
+
+}  // namespace
+
+// Restarting a timer cancels its task and posts a new one. The wheel deletes
+// the cancelled task, while the priority queue keeps it until it is due, as
+// MessageLoop used to.
+TEST_F(DelayedTaskWheelPerfTest, RestartTimers) {
+  std::vector<PendingTask> tasks;
+  tasks.reserve(kOutstandingTimers + kRestarts);
+  for (size_t i = 0; i < kOutstandingTimers + kRestarts; ++i)
+    tasks.push_back(MakeTask());
+
+  {
+    DelayedTaskQueue queue;
+    TimeTicks begin = TimeTicks::HighResNow();
+    for (size_t i = 0; i < kOutstandingTimers; ++i)
+      queue.push(tasks[i]);
+    PrintResult("delayed_task_push", "priority_queue",
+                TimeTicks::HighResNow() - begin, kOutstandingTimers);
+
+    begin = TimeTicks::HighResNow();
+    for (int i = 0; i < kRestarts; ++i)
+      queue.push(tasks[kOutstandingTimers + i]);
+    PrintResult("delayed_task_restart", "priority_queue",
+                TimeTicks::HighResNow() - begin, kRestarts);
+
+    size_t size = queue.size();
+    begin = TimeTicks::HighResNow();
+    while (!queue.empty())
+      queue.pop();
+    PrintResult("delayed_task_pop", "priority_queue",
+                TimeTicks::HighResNow() - begin, size);
+  }
+
+  {
+    DelayedTaskWheel wheel;
+    std::vector<DelayedTaskWheel::Handle> handles(kOutstandingTimers);
+    TimeTicks begin = TimeTicks::HighResNow();
+    for (size_t i = 0; i < kOutstandingTimers; ++i)
+      handles[i] = wheel.push(tasks[i]);
+    PrintResult("delayed_task_push", "wheel",
+                TimeTicks::HighResNow() - begin, kOutstandingTimers);
+
+    begin = TimeTicks::HighResNow();
+    for (int i = 0; i < kRestarts; ++i) {
+      DelayedTaskWheel::Handle* handle = &handles[i % kOutstandingTimers];
+      wheel.erase(*handle);
+      *handle = wheel.push(tasks[kOutstandingTimers + i]);
+    }
+    PrintResult("delayed_task_restart", "wheel",
+                TimeTicks::HighResNow() - begin, kRestarts);
+
+    size_t size = wheel.size();
+    EXPECT_EQ(kOutstandingTimers, size);
+    begin = TimeTicks::HighResNow();
+    while (!wheel.empty())
+      wheel.pop();
+    PrintResult("delayed_task_pop", "wheel",
+                TimeTicks::HighResNow() - begin, size);
+  }
+}
+
+// Restarts base::Timers sooner than they were due, which posts new tasks, and
+// then stops them all.
+TEST(DelayedTaskWheelTimerPerfTest, RestartAndStopTimers) {
+  MessageLoop loop;
+  std::vector<linked_ptr<Timer> > timers(kOutstandingTimers);
+  Closure task = Bind(&DoNothing);
+  for (size_t i = 0; i < timers.size(); ++i) {
+    timers[i].reset(new Timer(false, false));
+    timers[i]->Start(FROM_HERE, TimeDelta::FromSeconds(60), task);
+  }
+
+  TimeTicks begin = TimeTicks::HighResNow();
+  for (int i = 0; i < kRestarts; ++i) {
+    timers[i % timers.size()]->Start(
+        FROM_HERE,
+        TimeDelta::FromMicroseconds(kMaxDelayUs - RandGenerator(1000) - i),
+        task);
+  }
+  PrintResult("timer_restart", "", TimeTicks::HighResNow() - begin, kRestarts);
+
+  begin = TimeTicks::HighResNow();
+  for (size_t i = 0; i < timers.size(); ++i)
+    timers[i]->Stop();
+  PrintResult("timer_stop", "", TimeTicks::HighResNow() - begin,
+              timers.size());
+  RunLoop().RunUntilIdle();
+}
+
+}  // namespace base
@@ -0,0 +1,216 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/message_loop/delayed_task_wheel.h"
+
+#include <vector>
+
+#include "base/bind.h"
+#include "base/bind_helpers.h"
+#include "base/memory/ref_counted.h"
+#include "base/message_loop/message_loop.h"
+#include "base/rand_util.h"
+#include "base/run_loop.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace base {
+
+namespace {
+
+class Counted : public RefCounted<Counted> {
+ public:
+  explicit Counted(int* deletions) : deletions_(deletions) {}
+
+ private:
+  friend class RefCounted<Counted>;
+  ~Counted() { ++*deletions_; }
+
+  int* deletions_;
+};
+
+void Hold(scoped_refptr<Counted> counted) {}
+
+// Erases |*handle| from |wheel| when deleted, and stores whether it was.
+class EraseOnDelete {
+ public:
+  EraseOnDelete(DelayedTaskWheel* wheel,
+                DelayedTaskWheel::Handle* handle,
+                bool* erased)
+      : wheel_(wheel), handle_(handle), erased_(erased) {}
+  ~EraseOnDelete() { *erased_ = wheel_->erase(*handle_); }
+
+ private:
+  DelayedTaskWheel* wheel_;
+  DelayedTaskWheel::Handle* handle_;
+  bool* erased_;
+};
+
+void RunEraseOnDelete(EraseOnDelete* erase_on_delete) {}
+
+class DelayedTaskWheelTest : public testing::Test {
+ protected:
+  DelayedTaskWheelTest()
+      : origin_(TimeTicks::FromInternalValue(1234567890123LL)),
+        next_sequence_num_(0) {}
+
+  PendingTask MakeTask(int64 delay_us) {
+    return MakeTask(delay_us, Bind(&DoNothing));
+  }
+
+  PendingTask MakeTask(int64 delay_us, const Closure& task) {
+    PendingTask pending_task(
+        FROM_HERE, task, origin_ + TimeDelta::FromMicroseconds(delay_us),
+        true);
+    pending_task.sequence_num = next_sequence_num_++;
+    return pending_task;
+  }
+
+  // Pops all the tasks of |wheel_| and returns their sequence numbers.
+  std::vector<int> PopAll() {
+    std::vector<int> order;
+    while (!wheel_.empty()) {
+      order.push_back(wheel_.top().sequence_num);
+      wheel_.pop();
+    }
+    return order;
+  }
+
+  const TimeTicks origin_;
+  int next_sequence_num_;
+  DelayedTaskWheel wheel_;
+};
+
+}  // namespace
+
+TEST_F(DelayedTaskWheelTest, Empty) {
+  EXPECT_TRUE(wheel_.empty());
+  EXPECT_EQ(0u, wheel_.size());
+  EXPECT_FALSE(wheel_.erase(0));
+  EXPECT_FALSE(wheel_.erase(12345));
+}
+
+// Tasks due at the same time run in the order they were posted.
+TEST_F(DelayedTaskWheelTest, SameRunTime) {
+  for (int i = 0; i < 10; ++i)
+    wheel_.push(MakeTask(5000));
+  std::vector<int> order = PopAll();
+  ASSERT_EQ(10u, order.size());
+  for (int i = 0; i < 10; ++i)
+    EXPECT_EQ(i, order[i]);
+}
+
+// Tasks run in the same order as with a DelayedTaskQueue, whichever level of
+// the wheel they go to, including tasks too far ahead for the wheel and tasks
+// pushed while others are popped.
+TEST_F(DelayedTaskWheelTest, MatchesDelayedTaskQueue) {
+  const int64 kMaxDelaysUs[] = {
+    1000, 64 * 1000, 4096 * 1000, Time::kMicrosecondsPerDay,
+    1000 * Time::kMicrosecondsPerDay };
+  DelayedTaskQueue queue;
+  for (int round = 0; round < 20; ++round) {
+    for (int i = 0; i < 200; ++i) {
+      int64 max_delay_us =
+          kMaxDelaysUs[RandInt(0, arraysize(kMaxDelaysUs) - 1)];
+      PendingTask pending_task =
+          MakeTask(RandGenerator(max_delay_us) + round * 1000);
+      queue.push(pending_task);
+      wheel_.push(pending_task);
+    }
+    for (int i = 0; i < 150; ++i) {
+      ASSERT_EQ(queue.top().sequence_num, wheel_.top().sequence_num);
+      queue.pop();
+      wheel_.pop();
+    }
+    ASSERT_EQ(queue.size(), wheel_.size());
+  }
+  while (!queue.empty()) {
+    ASSERT_EQ(queue.top().sequence_num, wheel_.top().sequence_num);
+    queue.pop();
+    wheel_.pop();
+  }
+  EXPECT_TRUE(wheel_.empty());
+}
+
+TEST_F(DelayedTaskWheelTest, Erase) {
+  int deletions = 0;
+  // Tasks of the same tick, which end up in the heap of the earliest tasks,
+  // and of other levels of the wheel, and too far ahead for it.
+  const int64 kDelaysUs[] = {
+    1000, 1000, 1000, 50 * 1000, 3000 * 1000, 200000 * 1000,
+    Time::kMicrosecondsPerDay, 100 * Time::kMicrosecondsPerDay };
+  std::vector<DelayedTaskWheel::Handle> handles;
+  for (size_t i = 0; i < arraysize(kDelaysUs); ++i) {
+    handles.push_back(wheel_.push(MakeTask(
+        kDelaysUs[i],
+        Bind(&Hold, make_scoped_refptr(new Counted(&deletions))))));
+  }
+  // Move the first tasks to the heap.
+  EXPECT_EQ(0, wheel_.top().sequence_num);
+
+  // Erase every other task.
+  for (size_t i = 0; i < handles.size(); i += 2) {
+    EXPECT_TRUE(wheel_.erase(handles[i]));
+    EXPECT_EQ(static_cast<int>(i / 2 + 1), deletions);
+  }
+  EXPECT_EQ(handles.size() / 2, wheel_.size());
+
+  std::vector<int> order = PopAll();
+  ASSERT_EQ(handles.size() / 2, order.size());
+  for (size_t i = 0; i < order.size(); ++i)
+    EXPECT_EQ(static_cast<int>(i * 2 + 1), order[i]);
+  EXPECT_EQ(static_cast<int>(handles.size()), deletions);
+}
+
+// The handles of popped or erased tasks are not reused for new ones.
+TEST_F(DelayedTaskWheelTest, StaleHandles) {
+  DelayedTaskWheel::Handle popped = wheel_.push(MakeTask(1000));
+  wheel_.pop();
+  DelayedTaskWheel::Handle erased = wheel_.push(MakeTask(1000));
+  EXPECT_TRUE(wheel_.erase(erased));
+  EXPECT_FALSE(wheel_.erase(erased));
+
+  DelayedTaskWheel::Handle live = wheel_.push(MakeTask(1000));
+  EXPECT_NE(popped, live);
+  EXPECT_NE(erased, live);
+  EXPECT_FALSE(wheel_.erase(popped));
+  EXPECT_FALSE(wheel_.erase(erased));
+  EXPECT_EQ(1u, wheel_.size());
+  EXPECT_TRUE(wheel_.erase(live));
+  EXPECT_TRUE(wheel_.empty());
+}
+
+// A task is deleted after it is taken out of the wheel, so its destructor may
+// use the wheel.
+TEST_F(DelayedTaskWheelTest, EraseFromTaskDestructor) {
+  DelayedTaskWheel::Handle handle = 0;
+  bool erased = true;
+  handle = wheel_.push(MakeTask(
+      1000, Bind(&RunEraseOnDelete,
+                 Owned(new EraseOnDelete(&wheel_, &handle, &erased)))));
+  EXPECT_TRUE(wheel_.erase(handle));
+  EXPECT_FALSE(erased);
+  EXPECT_TRUE(wheel_.empty());
+}
+
+TEST(DelayedTaskWheelMessageLoopTest, CancelDelayedTask) {
+  MessageLoop loop;
+  int deletions = 0;
+  MessageLoop::DelayedTaskHandle handle = loop.PostCancelableDelayedTask(
+      FROM_HERE, Bind(&Hold, make_scoped_refptr(new Counted(&deletions))),
+      TimeDelta::FromDays(1));
+  EXPECT_NE(0u, handle);
+  EXPECT_TRUE(loop.CancelDelayedTask(handle));
+  EXPECT_EQ(1, deletions);
+  EXPECT_FALSE(loop.CancelDelayedTask(handle));
+}
+
+TEST(DelayedTaskWheelMessageLoopTest, PostCancelableDelayedTask) {
+  MessageLoop loop;
+  RunLoop run_loop;
+  loop.PostCancelableDelayedTask(FROM_HERE, run_loop.QuitClosure(),
+                                 TimeDelta::FromMilliseconds(10));
+  run_loop.Run();
+}
+
+}  // namespace base
@@ -6,16 +6,26 @@
 
 #include "base/location.h"
 #include "base/message_loop/message_loop.h"
+#include "base/message_loop/mpsc_task_queue.h"
 #include "base/synchronization/waitable_event.h"
+#include "base/threading/platform_thread.h"
 #include "base/time/time.h"
 
 namespace base {
 namespace internal {
 
-IncomingTaskQueue::IncomingTaskQueue(MessageLoop* message_loop)
+IncomingTaskQueue::IncomingTaskQueue(MessageLoop* message_loop,
+                                     bool use_lock_free_queue)
     : high_res_task_count_(0),
       message_loop_(message_loop),
-      next_sequence_num_(0) {
+      next_sequence_num_(0),
+      atomic_high_res_task_count_(0),
+      atomic_next_sequence_num_(0),
+      schedule_work_requested_(0),
+      posters_in_flight_(0),
+      message_loop_destroyed_(0) {
+  if (use_lock_free_queue)
+    lock_free_queue_.reset(new MpscTaskQueue());
 }
 
 bool IncomingTaskQueue::AddToIncomingQueue(
@@ -23,7 +33,6 @@ bool IncomingTaskQueue::AddToIncomingQueue(
     const Closure& task,
     TimeDelta delay,
     bool nestable) {
-  AutoLock locked(incoming_queue_lock_);
   PendingTask pending_task(
       from_here, task, CalculateDelayedRuntime(delay), nestable);
 #if defined(OS_WIN)
@@ -33,19 +42,38 @@ bool IncomingTaskQueue::AddToIncomingQueue(
   // resolution on Windows is between 10 and 15ms.
   if (delay > TimeDelta() &&
       delay.InMilliseconds() < (2 * Time::kMinLowResolutionThresholdMs)) {
-    ++high_res_task_count_;
     pending_task.is_high_res = true;
   }
 #endif
+  if (lock_free_queue_) {
+    if (pending_task.is_high_res)
+      subtle::NoBarrier_AtomicIncrement(&atomic_high_res_task_count_, 1);
+    return PostPendingTaskLockFree(&pending_task);
+  }
+
+  AutoLock locked(incoming_queue_lock_);
+  if (pending_task.is_high_res)
+    ++high_res_task_count_;
   return PostPendingTask(&pending_task);
 }
 
+int IncomingTaskQueue::GetNextSequenceNum() {
+  if (lock_free_queue_)
+    return subtle::NoBarrier_AtomicIncrement(&atomic_next_sequence_num_, 1) - 1;
+  AutoLock lock(incoming_queue_lock_);
+  return next_sequence_num_++;
+}
+
 bool IncomingTaskQueue::HasHighResolutionTasks() {
+  if (lock_free_queue_)
+    return subtle::NoBarrier_Load(&atomic_high_res_task_count_) > 0;
   AutoLock lock(incoming_queue_lock_);
   return high_res_task_count_ > 0;
 }
 
 bool IncomingTaskQueue::IsIdleForTesting() {
+  if (lock_free_queue_)
+    return lock_free_queue_->IsEmpty();
   AutoLock lock(incoming_queue_lock_);
   return incoming_queue_.empty();
 }
@@ -54,6 +82,11 @@ int IncomingTaskQueue::ReloadWorkQueue(TaskQueue* work_queue) {
   // Make sure no tasks are lost.
   DCHECK(work_queue->empty());
 
+  if (lock_free_queue_) {
+    ReloadWorkQueueLockFree(work_queue);
+    return subtle::NoBarrier_AtomicExchange(&atomic_high_res_task_count_, 0);
+  }
+
   // Acquire all we can from the inter-thread queue with one lock acquisition.
   AutoLock lock(incoming_queue_lock_);
   if (!incoming_queue_.empty())
@@ -66,6 +99,14 @@ int IncomingTaskQueue::ReloadWorkQueue(TaskQueue* work_queue) {
 }
 
 void IncomingTaskQueue::WillDestroyCurrentMessageLoop() {
+  if (lock_free_queue_) {
+    // Stop new posters, then wait out the ones that got in before the flag
+    // was raised; they may still be touching |message_loop_|.
+    subtle::NoBarrier_Store(&message_loop_destroyed_, 1);
+    subtle::MemoryBarrier();
+    while (subtle::Acquire_Load(&posters_in_flight_) != 0)
+      PlatformThread::YieldCurrentThread();
+  }
   AutoLock lock(incoming_queue_lock_);
   message_loop_ = NULL;
 }
@@ -115,5 +156,50 @@ bool IncomingTaskQueue::PostPendingTask(PendingTask* pending_task) {
   return true;
 }
 
+bool IncomingTaskQueue::PostPendingTaskLockFree(PendingTask* pending_task) {
+  subtle::Barrier_AtomicIncrement(&posters_in_flight_, 1);
+  if (subtle::Acquire_Load(&message_loop_destroyed_)) {
+    subtle::Barrier_AtomicIncrement(&posters_in_flight_, -1);
+    pending_task->task.Reset();
+    return false;
+  }
+
+  // Sequence numbers from different threads may reach the queue slightly out
+  // of order. That only matters for delayed tasks with identical run times
+  // posted concurrently from different threads, whose relative order is
+  // unspecified anyway.
+  pending_task->sequence_num =
+      subtle::NoBarrier_AtomicIncrement(&atomic_next_sequence_num_, 1) - 1;
+
+  message_loop_->task_annotator()->DidQueueTask("MessageLoop::PostTask",
+                                                *pending_task);
+
+  lock_free_queue_->Push(*pending_task);
+  pending_task->task.Reset();
+
+  // The push must be visible before we look at |schedule_work_requested_|,
+  // pairing with the barrier in ReloadWorkQueueLockFree().
+  subtle::MemoryBarrier();
+  bool needs_wakeup =
+      subtle::NoBarrier_AtomicExchange(&schedule_work_requested_, 1) == 0;
+  message_loop_->ScheduleWork(needs_wakeup);
+
+  subtle::Barrier_AtomicIncrement(&posters_in_flight_, -1);
+  return true;
+}
+
+void IncomingTaskQueue::ReloadWorkQueueLockFree(TaskQueue* work_queue) {
+  // Any poster that runs after this store sees 0 and wakes the pump, so tasks
+  // we fail to observe below are guaranteed another DoWork().
+  subtle::NoBarrier_Store(&schedule_work_requested_, 0);
+  subtle::MemoryBarrier();
+  if (!lock_free_queue_->PopAll(work_queue)) {
+    // A poster is halfway through linking its task in. Rather than spin on
+    // the loop thread, come back for it on the next pass.
+    if (message_loop_)
+      message_loop_->ScheduleWork(true);
+  }
+}
+
 }  // namespace internal
 }  // namespace base
@@ -5,8 +5,10 @@
 #ifndef BASE_MESSAGE_LOOP_INCOMING_TASK_QUEUE_H_
 #define BASE_MESSAGE_LOOP_INCOMING_TASK_QUEUE_H_
 
+#include "base/atomicops.h"
 #include "base/base_export.h"
 #include "base/memory/ref_counted.h"
+#include "base/memory/scoped_ptr.h"
 #include "base/pending_task.h"
 #include "base/synchronization/lock.h"
 #include "base/time/time.h"
@@ -18,13 +20,21 @@ class WaitableEvent;
 
 namespace internal {
 
+class MpscTaskQueue;
+
 // Implements a queue of tasks posted to the message loop running on the current
 // thread. This class takes care of synchronizing posting tasks from different
 // threads and together with MessageLoop ensures clean shutdown.
+//
+// By default posting threads serialize on |incoming_queue_lock_|. When
+// |use_lock_free_queue| is true, tasks are instead appended to an MpscTaskQueue
+// and posting threads never block each other or the loop thread. Delayed tasks
+// take the same path and are moved to the MessageLoop's delayed work queue by
+// the loop thread, exactly as in the locked mode.
 class BASE_EXPORT IncomingTaskQueue
     : public RefCountedThreadSafe<IncomingTaskQueue> {
  public:
-  explicit IncomingTaskQueue(MessageLoop* message_loop);
+  IncomingTaskQueue(MessageLoop* message_loop, bool use_lock_free_queue);
 
   // Appends a task to the incoming queue. Posting of all tasks is routed though
   // AddToIncomingQueue() or TryAddToIncomingQueue() to make sure that posting
@@ -38,6 +48,10 @@ class BASE_EXPORT IncomingTaskQueue
                           TimeDelta delay,
                           bool nestable);
 
+  // Returns the sequence number of a task which the loop thread adds to its
+  // delayed work queue itself, in the same sequence as the posted tasks.
+  int GetNextSequenceNum();
+
   // Returns true if the queue contains tasks that require higher than default
   // timer resolution. Currently only needed for Windows.
   bool HasHighResolutionTasks();
@@ -66,6 +80,13 @@ class BASE_EXPORT IncomingTaskQueue
   // does not retain |pending_task->task| beyond this function call.
   bool PostPendingTask(PendingTask* pending_task);
 
+  // Lock-free counterpart of PostPendingTask(), used when |lock_free_queue_|
+  // is non-NULL.
+  bool PostPendingTaskLockFree(PendingTask* pending_task);
+
+  // Drains |lock_free_queue_| into |work_queue|.
+  void ReloadWorkQueueLockFree(TaskQueue* work_queue);
+
   // Number of tasks that require high resolution timing. This value is kept
   // so that ReloadWorkQueue() completes in constant time.
   int high_res_task_count_;
@@ -84,6 +105,25 @@ class BASE_EXPORT IncomingTaskQueue
   // The next sequence number to use for delayed tasks.
   int next_sequence_num_;
 
+  // The members below are only used when the lock-free queue is enabled.
+  // |lock_free_queue_| replaces |incoming_queue_|, and the atomic counters
+  // replace |high_res_task_count_| and |next_sequence_num_|.
+  scoped_ptr<MpscTaskQueue> lock_free_queue_;
+  subtle::Atomic32 atomic_high_res_task_count_;
+  subtle::Atomic32 atomic_next_sequence_num_;
+
+  // Set to 1 by the poster that finds it 0 and then wakes the pump; reset by
+  // the loop thread before draining. This keeps the pump from being woken for
+  // every task while guaranteeing that no posted task goes unnoticed.
+  subtle::Atomic32 schedule_work_requested_;
+
+  // Number of threads currently inside PostPendingTaskLockFree(), and whether
+  // WillDestroyCurrentMessageLoop() has been called. Together they let the
+  // loop wait for in-flight posters instead of holding a lock around
+  // |message_loop_|.
+  subtle::Atomic32 posters_in_flight_;
+  subtle::Atomic32 message_loop_destroyed_;
+
   DISALLOW_COPY_AND_ASSIGN(IncomingTaskQueue);
 };
 
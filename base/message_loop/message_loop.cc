@@ -135,7 +135,22 @@ MessageLoop::MessageLoop(Type type)
 #endif  // OS_WIN
       message_histogram_(NULL),
       run_loop_(NULL) {
-  Init();
+  Init(INCOMING_QUEUE_LOCKED);
+
+  pump_ = CreateMessagePumpForType(type).Pass();
+}
+
+MessageLoop::MessageLoop(Type type, IncomingQueueMode incoming_queue_mode)
+    : type_(type),
+      pending_high_res_tasks_(0),
+      in_high_res_mode_(false),
+      nestable_tasks_allowed_(true),
+#if defined(OS_WIN)
+      os_modal_loop_(false),
+#endif  // OS_WIN
+      message_histogram_(NULL),
+      run_loop_(NULL) {
+  Init(incoming_queue_mode);
 
   pump_ = CreateMessagePumpForType(type).Pass();
 }
@@ -152,7 +167,7 @@ MessageLoop::MessageLoop(scoped_ptr<MessagePump> pump)
       message_histogram_(NULL),
       run_loop_(NULL) {
   DCHECK(pump_.get());
-  Init();
+  Init(INCOMING_QUEUE_LOCKED);
 }
 
 MessageLoop::~MessageLoop() {
@@ -303,6 +318,34 @@ void MessageLoop::PostNonNestableDelayedTask(
   incoming_task_queue_->AddToIncomingQueue(from_here, task, delay, false);
 }
 
+MessageLoop::DelayedTaskHandle MessageLoop::PostCancelableDelayedTask(
+    const tracked_objects::Location& from_here,
+    const Closure& task,
+    TimeDelta delay) {
+  DCHECK_EQ(this, current());
+  DCHECK(!task.is_null()) << from_here.ToString();
+  if (delay <= TimeDelta()) {
+    PostTask(from_here, task);
+    return 0;
+  }
+
+  // Straight to the delayed work queue, skipping the incoming queue as the
+  // task is posted from the thread of the loop.
+  PendingTask pending_task(from_here, task, TimeTicks::Now() + delay, true);
+  pending_task.sequence_num = incoming_task_queue_->GetNextSequenceNum();
+  task_annotator_.DidQueueTask("MessageLoop::PostTask", pending_task);
+  DelayedTaskHandle handle = delayed_work_queue_.push(pending_task);
+  // If we changed the topmost task, then it is time to reschedule.
+  if (delayed_work_queue_.top().sequence_num == pending_task.sequence_num)
+    pump_->ScheduleDelayedWork(pending_task.delayed_run_time);
+  return handle;
+}
+
+bool MessageLoop::CancelDelayedTask(DelayedTaskHandle handle) {
+  DCHECK_EQ(this, current());
+  return delayed_work_queue_.erase(handle);
+}
+
 void MessageLoop::Run() {
   RunLoop run_loop;
   run_loop.Run();
@@ -388,11 +431,12 @@ bool MessageLoop::IsIdleForTesting() {
 
 //------------------------------------------------------------------------------
 
-void MessageLoop::Init() {
+void MessageLoop::Init(IncomingQueueMode incoming_queue_mode) {
   DCHECK(!current()) << "should only have one message loop per thread";
   lazy_tls_ptr.Pointer()->Set(this);
 
-  incoming_task_queue_ = new internal::IncomingTaskQueue(this);
+  incoming_task_queue_ = new internal::IncomingTaskQueue(
+      this, incoming_queue_mode == INCOMING_QUEUE_LOCK_FREE);
   message_loop_proxy_ =
       new internal::MessageLoopProxyImpl(incoming_task_queue_);
   thread_task_runner_handle_.reset(
@@ -15,6 +15,7 @@
 #include "base/location.h"
 #include "base/memory/ref_counted.h"
 #include "base/memory/scoped_ptr.h"
+#include "base/message_loop/delayed_task_wheel.h"
 #include "base/message_loop/incoming_task_queue.h"
 #include "base/message_loop/message_loop_proxy.h"
 #include "base/message_loop/message_loop_proxy_impl.h"
@@ -109,9 +110,29 @@ class BASE_EXPORT MessageLoop : public MessagePump::Delegate {
 #endif // defined(OS_ANDROID)
   };
 
+  // Selects how tasks posted from other threads reach the loop.
+  //
+  // INCOMING_QUEUE_LOCKED
+  //   Posting threads append to a queue guarded by a single lock. This is the
+  //   default.
+  //
+  // INCOMING_QUEUE_LOCK_FREE
+  //   Posting threads append to a lock-free linked queue and never contend
+  //   with each other or with the loop thread. Each posted task costs an extra
+  //   heap allocation, so this only pays off for loops with many concurrent
+  //   posters, such as the IO thread.
+  //
+  enum IncomingQueueMode {
+    INCOMING_QUEUE_LOCKED,
+    INCOMING_QUEUE_LOCK_FREE,
+  };
+
   // Normally, it is not necessary to instantiate a MessageLoop.  Instead, it
   // is typical to make use of the current thread's MessageLoop instance.
   explicit MessageLoop(Type type = TYPE_DEFAULT);
+  // Creates a MessageLoop of |type| whose incoming queue uses
+  // |incoming_queue_mode|.
+  MessageLoop(Type type, IncomingQueueMode incoming_queue_mode);
   // Creates a TYPE_CUSTOM MessageLoop with the supplied MessagePump, which must
   // be non-NULL.
   explicit MessageLoop(scoped_ptr<base::MessagePump> pump);
@@ -188,6 +209,25 @@ class BASE_EXPORT MessageLoop : public MessagePump::Delegate {
                                   const Closure& task,
                                   TimeDelta delay);
 
+  // Identifies a task posted with PostCancelableDelayedTask(). 0 is never a
+  // handle.
+  typedef DelayedTaskWheel::Handle DelayedTaskHandle;
+
+  // Same as PostDelayedTask(), but returns a handle which CancelDelayedTask()
+  // takes to delete the task right away, rather than when it is due, as
+  // base::Timer does when stopped. Returns 0 if |delay| is not positive, as
+  // the task is then posted with PostTask() and can't be cancelled.
+  //
+  // NOTE: These methods must be called on the thread of the loop.
+  DelayedTaskHandle PostCancelableDelayedTask(
+      const tracked_objects::Location& from_here,
+      const Closure& task,
+      TimeDelta delay);
+
+  // Deletes the task of |handle| without running it. Returns false if it
+  // already ran or was deleted.
+  bool CancelDelayedTask(DelayedTaskHandle handle);
+
   // A variant on PostTask that deletes the given object.  This is useful
   // if the object needs to live until the next run of the MessageLoop (for
   // example, deleting a RenderProcessHost from within an IPC callback is not
@@ -399,8 +439,8 @@ class BASE_EXPORT MessageLoop : public MessagePump::Delegate {
   friend class internal::IncomingTaskQueue;
   friend class RunLoop;
 
-  // Configures various members for the two constructors.
-  void Init();
+  // Configures various members for the constructors.
+  void Init(IncomingQueueMode incoming_queue_mode);
 
   // Invokes the actual run loop using the message pump.
   void RunHandler();
@@ -464,7 +504,7 @@ class BASE_EXPORT MessageLoop : public MessagePump::Delegate {
   bool in_high_res_mode_;
 
   // Contains delayed tasks, sorted by their 'delayed_run_time' property.
-  DelayedTaskQueue delayed_work_queue_;
+  DelayedTaskWheel delayed_work_queue_;
 
   // A recent snapshot of Time::Now(), used to check delayed_work_queue_.
   TimeTicks recent_time_;
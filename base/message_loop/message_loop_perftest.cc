@@ -0,0 +1,143 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <string>
+
+#include "base/base_switches.h"
+#include "base/bind.h"
+#include "base/command_line.h"
+#include "base/memory/scoped_vector.h"
+#include "base/message_loop/message_loop.h"
+#include "base/message_loop/message_loop_proxy.h"
+#include "base/strings/stringprintf.h"
+#include "base/synchronization/waitable_event.h"
+#include "base/threading/simple_thread.h"
+#include "base/threading/thread.h"
+#include "base/time/time.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "testing/perf/perf_test.h"
+
+namespace base {
+
+namespace {
+
+const int kTotalTasks = 320000;
+
+// Counts tasks on the target thread and signals |done_| once all of them
+// have run.
+class TaskCounter {
+ public:
+  TaskCounter(int expected, WaitableEvent* done)
+      : expected_(expected), count_(0), done_(done) {}
+
+  void Increment() {
+    if (++count_ == expected_)
+      done_->Signal();
+  }
+
+ private:
+  const int expected_;
+  int count_;
+  WaitableEvent* done_;
+};
+
+// Waits for |start| and then posts |num_tasks| tasks to |target| as fast as
+// it can.
+class Poster : public DelegateSimpleThread::Delegate {
+ public:
+  Poster(scoped_refptr<MessageLoopProxy> target,
+         TaskCounter* counter,
+         WaitableEvent* start,
+         int num_tasks)
+      : target_(target),
+        counter_(counter),
+        start_(start),
+        num_tasks_(num_tasks) {}
+
+  virtual void Run() OVERRIDE {
+    start_->Wait();
+    for (int i = 0; i < num_tasks_; ++i) {
+      target_->PostTask(FROM_HERE, Bind(&TaskCounter::Increment,
+                                        Unretained(counter_)));
+    }
+  }
+
+ private:
+  scoped_refptr<MessageLoopProxy> target_;
+  TaskCounter* counter_;
+  WaitableEvent* start_;
+  const int num_tasks_;
+};
+
+class MessageLoopPerfTest : public testing::Test {
+ public:
+  MessageLoopPerfTest() {
+    // Disable the task profiler as it adds significant cost!
+    CommandLine::Init(0, NULL);
+    CommandLine::ForCurrentProcess()->AppendSwitchASCII(
+        switches::kProfilerTiming,
+        switches::kProfilerTimingDisabledValue);
+  }
+
+  // Measures how long it takes |num_posters| threads to post kTotalTasks tasks
+  // to an IO loop using |mode|, until the last one has run.
+  void RunPostTest(const std::string& name,
+                   MessageLoop::IncomingQueueMode mode,
+                   int num_posters) {
+    Thread::Options options(MessageLoop::TYPE_IO, 0);
+    options.incoming_queue_mode = mode;
+    Thread target("PostTarget");
+    ASSERT_TRUE(target.StartWithOptions(options));
+
+    int tasks_per_poster = kTotalTasks / num_posters;
+    WaitableEvent start(true, false);
+    WaitableEvent done(false, false);
+    TaskCounter counter(tasks_per_poster * num_posters, &done);
+
+    ScopedVector<Poster> posters;
+    ScopedVector<DelegateSimpleThread> threads;
+    for (int i = 0; i < num_posters; ++i) {
+      posters.push_back(new Poster(target.message_loop_proxy(), &counter,
+                                   &start, tasks_per_poster));
+      threads.push_back(new DelegateSimpleThread(posters.back(), "Poster"));
+      threads.back()->Start();
+    }
+
+    TimeTicks begin = TimeTicks::HighResNow();
+    start.Signal();
+    done.Wait();
+    TimeDelta elapsed = TimeTicks::HighResNow() - begin;
+
+    for (size_t i = 0; i < threads.size(); ++i)
+      threads[i]->Join();
+    target.Stop();
+
+    double total = static_cast<double>(tasks_per_poster * num_posters);
+    perf_test::PrintResult("post_throughput",
+                           StringPrintf("_%d_posters", num_posters),
+                           name,
+                           total / elapsed.InSecondsF(),
+                           "tasks/s",
+                           true);
+  }
+
+  void RunAllPosterCounts(const std::string& name,
+                          MessageLoop::IncomingQueueMode mode) {
+    const int kPosterCounts[] = {1, 2, 4, 8, 16, 32};
+    for (size_t i = 0; i < arraysize(kPosterCounts); ++i)
+      RunPostTest(name, mode, kPosterCounts[i]);
+  }
+};
+
+}  // namespace
+
+TEST_F(MessageLoopPerfTest, CrossThreadPostLocked) {
+  RunAllPosterCounts("locked", MessageLoop::INCOMING_QUEUE_LOCKED);
+}
+
+TEST_F(MessageLoopPerfTest, CrossThreadPostLockFree) {
+  RunAllPosterCounts("lock_free", MessageLoop::INCOMING_QUEUE_LOCK_FREE);
+}
+
+}  // namespace base
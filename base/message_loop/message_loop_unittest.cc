@@ -9,6 +9,7 @@
 #include "base/compiler_specific.h"
 #include "base/logging.h"
 #include "base/memory/ref_counted.h"
+#include "base/memory/scoped_vector.h"
 #include "base/message_loop/message_loop.h"
 #include "base/message_loop/message_loop_proxy_impl.h"
 #include "base/message_loop/message_loop_test.h"
@@ -925,6 +926,99 @@ TEST(MessageLoopTest, IsType) {
   EXPECT_FALSE(loop.IsType(MessageLoop::TYPE_DEFAULT));
 }
 
+namespace {
+
+void RecordOrder(std::vector<int>* order, int value) {
+  order->push_back(value);
+}
+
+void PostRecordOrderTasks(scoped_refptr<MessageLoopProxy> proxy,
+                          std::vector<int>* order,
+                          int first,
+                          int count) {
+  for (int i = first; i < first + count; ++i)
+    proxy->PostTask(FROM_HERE, Bind(&RecordOrder, order, i));
+}
+
+}  // namespace
+
+TEST(MessageLoopTest, LockFreeIncomingQueue_PostTask) {
+  MessageLoop loop(MessageLoop::TYPE_DEFAULT,
+                   MessageLoop::INCOMING_QUEUE_LOCK_FREE);
+  EXPECT_TRUE(loop.IsIdleForTesting());
+
+  std::vector<int> order;
+  PostRecordOrderTasks(loop.message_loop_proxy(), &order, 0, 10);
+  EXPECT_FALSE(loop.IsIdleForTesting());
+  loop.RunUntilIdle();
+
+  ASSERT_EQ(10u, order.size());
+  for (int i = 0; i < 10; ++i)
+    EXPECT_EQ(i, order[i]);
+  EXPECT_TRUE(loop.IsIdleForTesting());
+}
+
+TEST(MessageLoopTest, LockFreeIncomingQueue_DelayedTasksRunInOrder) {
+  MessageLoop loop(MessageLoop::TYPE_DEFAULT,
+                   MessageLoop::INCOMING_QUEUE_LOCK_FREE);
+
+  std::vector<int> order;
+  loop.PostDelayedTask(FROM_HERE, Bind(&RecordOrder, &order, 2),
+                       TimeDelta::FromMilliseconds(20));
+  loop.PostDelayedTask(FROM_HERE, Bind(&RecordOrder, &order, 1),
+                       TimeDelta::FromMilliseconds(10));
+  loop.PostTask(FROM_HERE, Bind(&RecordOrder, &order, 0));
+  loop.PostDelayedTask(FROM_HERE, MessageLoop::QuitClosure(),
+                       TimeDelta::FromMilliseconds(30));
+  loop.Run();
+
+  ASSERT_EQ(3u, order.size());
+  EXPECT_EQ(0, order[0]);
+  EXPECT_EQ(1, order[1]);
+  EXPECT_EQ(2, order[2]);
+}
+
+TEST(MessageLoopTest, LockFreeIncomingQueue_PostFromOtherThreads) {
+  const int kNumThreads = 4;
+  const int kTasksPerThread = 1000;
+
+  Thread::Options options(MessageLoop::TYPE_IO, 0);
+  options.incoming_queue_mode = MessageLoop::INCOMING_QUEUE_LOCK_FREE;
+  Thread target("LockFreeTarget");
+  ASSERT_TRUE(target.StartWithOptions(options));
+
+  // Every poster appends to its own vector, so per-thread FIFO order can be
+  // checked without any extra synchronization on the target thread.
+  std::vector<int> orders[kNumThreads];
+  ScopedVector<Thread> posters;
+  for (int i = 0; i < kNumThreads; ++i) {
+    posters.push_back(new Thread("LockFreePoster"));
+    ASSERT_TRUE(posters.back()->Start());
+    posters.back()->message_loop()->PostTask(
+        FROM_HERE, Bind(&PostRecordOrderTasks,
+                        target.message_loop_proxy(), &orders[i], 0,
+                        kTasksPerThread));
+  }
+  posters.clear();  // Joins the posters; all tasks are now queued.
+  target.Stop();    // Runs everything that was queued.
+
+  for (int i = 0; i < kNumThreads; ++i) {
+    ASSERT_EQ(static_cast<size_t>(kTasksPerThread), orders[i].size());
+    for (int j = 0; j < kTasksPerThread; ++j)
+      EXPECT_EQ(j, orders[i][j]);
+  }
+}
+
+TEST(MessageLoopTest, LockFreeIncomingQueue_PostAfterDestruction) {
+  scoped_refptr<MessageLoopProxy> proxy;
+  {
+    MessageLoop loop(MessageLoop::TYPE_DEFAULT,
+                     MessageLoop::INCOMING_QUEUE_LOCK_FREE);
+    proxy = loop.message_loop_proxy();
+  }
+  EXPECT_FALSE(proxy->PostTask(FROM_HERE, Bind(&DoNothing)));
+}
+
 #if defined(OS_WIN)
 void EmptyFunction() {}
 
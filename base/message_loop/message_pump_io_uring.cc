@@ -0,0 +1,687 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/message_loop/message_pump_io_uring.h"
+
+#include <errno.h>
+#include <linux/io_uring.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include "base/atomicops.h"
+#include "base/auto_reset.h"
+#include "base/logging.h"
+#include "base/posix/eintr_wrapper.h"
+
+// The system call numbers are the same on all architectures but Alpha.
+#if !defined(__NR_io_uring_setup)
+#define __NR_io_uring_setup 425
+#define __NR_io_uring_enter 426
+#endif
+
+namespace base {
+
+namespace {
+
+const unsigned kRingEntries = 256;
+
+// The features the pump relies on: mapping both queues at once, the kernel
+// keeping completions rather than dropping them when the completion queue is
+// full, reads and writes at the current position, and timed waits.
+const uint32 kRequiredFeatures = IORING_FEAT_SINGLE_MMAP | IORING_FEAT_NODROP |
+                                 IORING_FEAT_RW_CUR_POS | IORING_FEAT_EXT_ARG;
+
+// The user data of the read of the wakeup eventfd, and of the requests whose
+// completion doesn't matter. Operations are numbered from kFirstOperationId.
+const uint64 kWakeupId = 0;
+const uint64 kIgnoredId = 1;
+const uint64 kFirstOperationId = 2;
+
+int SetupRing(unsigned entries, io_uring_params* params) {
+  memset(params, 0, sizeof(*params));
+  return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+}
+
+int EnterRing(int ring_fd,
+              unsigned to_submit,
+              unsigned min_complete,
+              unsigned flags,
+              io_uring_getevents_arg* arg) {
+  return static_cast<int>(syscall(__NR_io_uring_enter, ring_fd, to_submit,
+                                  min_complete, flags | IORING_ENTER_EXT_ARG,
+                                  arg, sizeof(*arg)));
+}
+
+// The head and tail of the queues are shared with the kernel.
+unsigned LoadAcquire(const unsigned* value) {
+  return static_cast<unsigned>(subtle::Acquire_Load(
+      reinterpret_cast<const volatile subtle::Atomic32*>(value)));
+}
+
+void StoreRelease(unsigned* value, unsigned new_value) {
+  subtle::Release_Store(reinterpret_cast<volatile subtle::Atomic32*>(value),
+                        static_cast<subtle::Atomic32>(new_value));
+}
+
+// Returns the poll events for the WATCH_* |mode|.
+uint32 PollEventsForMode(int mode) {
+  uint32 events = 0;
+  if (mode & MessagePumpIoUring::WATCH_READ)
+    events |= POLLIN;
+  if (mode & MessagePumpIoUring::WATCH_WRITE)
+    events |= POLLOUT;
+  return events;
+}
+
+}  // namespace
+
+MessagePumpIoUring::FileDescriptorWatcher::FileDescriptorWatcher()
+    : fd_(-1),
+      mode_(0),
+      persistent_(false),
+      poll_id_(0),
+      pump_(NULL),
+      watcher_(NULL),
+      weak_factory_(this) {
+}
+
+MessagePumpIoUring::FileDescriptorWatcher::~FileDescriptorWatcher() {
+  StopWatchingFileDescriptor();
+}
+
+bool MessagePumpIoUring::FileDescriptorWatcher::StopWatchingFileDescriptor() {
+  // |pump_| is only used while a poll is in flight: the pump clears
+  // |poll_id_| of the watchers it still polls when it is destroyed.
+  if (poll_id_)
+    pump_->CancelPoll(this);
+  fd_ = -1;
+  mode_ = 0;
+  persistent_ = false;
+  pump_ = NULL;
+  watcher_ = NULL;
+  return true;
+}
+
+void MessagePumpIoUring::FileDescriptorWatcher::OnFileCanReadWithoutBlocking(
+    int fd, MessagePumpIoUring* pump) {
+  // Since OnFileCanWriteWithoutBlocking() gets called first, it can stop
+  // watching the file descriptor.
+  if (!watcher_)
+    return;
+  pump->WillProcessIOEvent();
+  watcher_->OnFileCanReadWithoutBlocking(fd);
+  pump->DidProcessIOEvent();
+}
+
+void MessagePumpIoUring::FileDescriptorWatcher::OnFileCanWriteWithoutBlocking(
+    int fd, MessagePumpIoUring* pump) {
+  DCHECK(watcher_);
+  pump->WillProcessIOEvent();
+  watcher_->OnFileCanWriteWithoutBlocking(fd);
+  pump->DidProcessIOEvent();
+}
+
+MessagePumpIoUring::Operation::Operation()
+    : controller(NULL),
+      opcode(0),
+      fd(-1),
+      offset(-1),
+      buffer(NULL),
+      length(0),
+      polling(false) {
+}
+
+MessagePumpIoUring::Operation::~Operation() {
+}
+
+MessagePumpIoUring::MessagePumpIoUring()
+    : keep_running_(true),
+      in_run_(false),
+      ring_fd_(-1),
+      ring_(MAP_FAILED),
+      ring_size_(0),
+      sqes_(static_cast<io_uring_sqe*>(MAP_FAILED)),
+      sqes_size_(0),
+      sq_head_(NULL),
+      sq_tail_(NULL),
+      sq_mask_(0),
+      sq_entries_(0),
+      sq_array_(NULL),
+      cq_head_(NULL),
+      cq_tail_(NULL),
+      cq_mask_(0),
+      cqes_(NULL),
+      pending_submissions_(0),
+      wakeup_fd_(-1),
+      wakeup_value_(0),
+      wakeup_read_pending_(false),
+      next_operation_id_(kFirstOperationId) {
+}
+
+MessagePumpIoUring::~MessagePumpIoUring() {
+  for (OperationMap::iterator it = operations_.begin();
+       it != operations_.end(); ++it) {
+    if (it->second.controller)
+      it->second.controller->poll_id_ = 0;
+  }
+  if (ring_ != MAP_FAILED)
+    CancelTransfers();
+  operations_.clear();
+
+  if (sqes_ != MAP_FAILED)
+    munmap(sqes_, sqes_size_);
+  if (ring_ != MAP_FAILED)
+    munmap(ring_, ring_size_);
+  if (ring_fd_ >= 0) {
+    if (IGNORE_EINTR(close(ring_fd_)) < 0)
+      DPLOG(ERROR) << "close";
+  }
+  if (wakeup_fd_ >= 0) {
+    if (IGNORE_EINTR(close(wakeup_fd_)) < 0)
+      DPLOG(ERROR) << "close";
+  }
+}
+
+// static
+bool MessagePumpIoUring::IsSupported() {
+  io_uring_params params;
+  int ring_fd = SetupRing(1, &params);
+  if (ring_fd < 0)
+    return false;
+  if (IGNORE_EINTR(close(ring_fd)) < 0)
+    DPLOG(ERROR) << "close";
+  return (params.features & kRequiredFeatures) == kRequiredFeatures;
+}
+
+// static
+scoped_ptr<MessagePumpIoUring> MessagePumpIoUring::Create() {
+  scoped_ptr<MessagePumpIoUring> pump(new MessagePumpIoUring);
+  if (!pump->Init())
+    return scoped_ptr<MessagePumpIoUring>();
+  return pump.Pass();
+}
+
+bool MessagePumpIoUring::WatchFileDescriptor(int fd,
+                                             bool persistent,
+                                             int mode,
+                                             FileDescriptorWatcher* controller,
+                                             Watcher* delegate) {
+  DCHECK_GE(fd, 0);
+  DCHECK(controller);
+  DCHECK(delegate);
+  DCHECK(mode == WATCH_READ || mode == WATCH_WRITE || mode == WATCH_READ_WRITE);
+  // WatchFileDescriptor should be called on the pump thread. It is not
+  // threadsafe, and your watcher may never be registered.
+  DCHECK(thread_checker_.CalledOnValidThread());
+
+  if (controller->mode_) {
+    // It's illegal to use this function to listen on 2 separate fds with the
+    // same |controller|.
+    if (controller->fd_ != fd) {
+      NOTREACHED() << "FDs don't match" << controller->fd_ << "!=" << fd;
+      return false;
+    }
+    // Combine old/new modes.
+    mode |= controller->mode_;
+    persistent |= controller->persistent_;
+    if (controller->poll_id_)
+      controller->pump_->CancelPoll(controller);
+  }
+
+  controller->fd_ = fd;
+  controller->mode_ = mode;
+  controller->persistent_ = persistent;
+  controller->pump_ = this;
+  controller->watcher_ = delegate;
+  if (!QueuePoll(controller)) {
+    controller->StopWatchingFileDescriptor();
+    return false;
+  }
+  return true;
+}
+
+bool MessagePumpIoUring::Read(int fd,
+                              int64 offset,
+                              char* buffer,
+                              int length,
+                              const IOCallback& callback) {
+  return QueueTransfer(IORING_OP_READ, fd, offset, buffer, length, callback);
+}
+
+bool MessagePumpIoUring::Write(int fd,
+                               int64 offset,
+                               const char* buffer,
+                               int length,
+                               const IOCallback& callback) {
+  return QueueTransfer(IORING_OP_WRITE, fd, offset, buffer, length, callback);
+}
+
+void MessagePumpIoUring::AddIOObserver(IOObserver* obs) {
+  io_observers_.AddObserver(obs);
+}
+
+void MessagePumpIoUring::RemoveIOObserver(IOObserver* obs) {
+  io_observers_.RemoveObserver(obs);
+}
+
+// Reentrant!
+void MessagePumpIoUring::Run(Delegate* delegate) {
+  AutoReset<bool> auto_reset_keep_running(&keep_running_, true);
+  AutoReset<bool> auto_reset_in_run(&in_run_, true);
+
+  for (;;) {
+    bool did_work = delegate->DoWork();
+    if (!keep_running_)
+      break;
+
+    // Only makes a system call if there are requests to submit.
+    SubmitAndWait(false);
+    did_work |= ProcessCompletions();
+    if (!keep_running_)
+      break;
+
+    did_work |= delegate->DoDelayedWork(&delayed_work_time_);
+    if (!keep_running_)
+      break;
+
+    if (did_work)
+      continue;
+
+    did_work = delegate->DoIdleWork();
+    if (!keep_running_)
+      break;
+
+    if (did_work)
+      continue;
+
+    if (!delayed_work_time_.is_null() &&
+        delayed_work_time_ <= TimeTicks::Now()) {
+      // It looks like delayed_work_time_ indicates a time in the past, so we
+      // need to call DoDelayedWork now.
+      delayed_work_time_ = TimeTicks();
+      continue;
+    }
+
+    // The completions, if any, are processed at the top of the loop.
+    SubmitAndWait(true);
+  }
+}
+
+void MessagePumpIoUring::Quit() {
+  DCHECK(in_run_) << "Quit was called outside of Run!";
+  // Tell Run that it should break out of its loop.
+  keep_running_ = false;
+  ScheduleWork();
+}
+
+void MessagePumpIoUring::ScheduleWork() {
+  // Completes the read of the eventfd in flight, if the pump sleeps on it.
+  uint64 value = 1;
+  int nwrite = HANDLE_EINTR(write(wakeup_fd_, &value, sizeof(value)));
+  DCHECK(nwrite == sizeof(value))
+      << "[nwrite:" << nwrite << "] [errno:" << errno << "]";
+}
+
+void MessagePumpIoUring::ScheduleDelayedWork(
+    const TimeTicks& delayed_work_time) {
+  // We know that we can't be blocked on Wait right now since this method can
+  // only be called on the same thread as Run, so we only need to update our
+  // record of how long to sleep when we do sleep.
+  delayed_work_time_ = delayed_work_time;
+}
+
+void MessagePumpIoUring::WillProcessIOEvent() {
+  FOR_EACH_OBSERVER(IOObserver, io_observers_, WillProcessIOEvent());
+}
+
+void MessagePumpIoUring::DidProcessIOEvent() {
+  FOR_EACH_OBSERVER(IOObserver, io_observers_, DidProcessIOEvent());
+}
+
+bool MessagePumpIoUring::Init() {
+  io_uring_params params;
+  ring_fd_ = SetupRing(kRingEntries, &params);
+  if (ring_fd_ < 0) {
+    DPLOG(ERROR) << "io_uring_setup";
+    return false;
+  }
+  if ((params.features & kRequiredFeatures) != kRequiredFeatures) {
+    DLOG(ERROR) << "io_uring lacks features: " << params.features;
+    return false;
+  }
+
+  // Both queues share a single mapping.
+  size_t sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  size_t cq_size =
+      params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+  ring_size_ = std::max(sq_size, cq_size);
+  ring_ = mmap(NULL, ring_size_, PROT_READ | PROT_WRITE,
+               MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQ_RING);
+  if (ring_ == MAP_FAILED) {
+    DPLOG(ERROR) << "mmap";
+    return false;
+  }
+  sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+  sqes_ = static_cast<io_uring_sqe*>(
+      mmap(NULL, sqes_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+           ring_fd_, IORING_OFF_SQES));
+  if (sqes_ == MAP_FAILED) {
+    DPLOG(ERROR) << "mmap";
+    return false;
+  }
+
+  char* ring = static_cast<char*>(ring_);
+  sq_head_ = reinterpret_cast<unsigned*>(ring + params.sq_off.head);
+  sq_tail_ = reinterpret_cast<unsigned*>(ring + params.sq_off.tail);
+  sq_mask_ = *reinterpret_cast<unsigned*>(ring + params.sq_off.ring_mask);
+  sq_entries_ = params.sq_entries;
+  sq_array_ = reinterpret_cast<unsigned*>(ring + params.sq_off.array);
+  cq_head_ = reinterpret_cast<unsigned*>(ring + params.cq_off.head);
+  cq_tail_ = reinterpret_cast<unsigned*>(ring + params.cq_off.tail);
+  cq_mask_ = *reinterpret_cast<unsigned*>(ring + params.cq_off.ring_mask);
+  cqes_ = reinterpret_cast<io_uring_cqe*>(ring + params.cq_off.cqes);
+
+  // Blocking, as the ring would otherwise complete its read with EAGAIN
+  // rather than wait for a write.
+  wakeup_fd_ = eventfd(0, EFD_CLOEXEC);
+  if (wakeup_fd_ < 0) {
+    DPLOG(ERROR) << "eventfd";
+    return false;
+  }
+  return QueueWakeupRead();
+}
+
+io_uring_sqe* MessagePumpIoUring::GetSubmissionEntry() {
+  unsigned tail = *sq_tail_;
+  if (tail - LoadAcquire(sq_head_) >= sq_entries_) {
+    if (!SubmitAndWait(false) || tail - LoadAcquire(sq_head_) >= sq_entries_)
+      return NULL;
+  }
+  io_uring_sqe* sqe = &sqes_[tail & sq_mask_];
+  memset(sqe, 0, sizeof(*sqe));
+  return sqe;
+}
+
+void MessagePumpIoUring::QueueSubmissionEntry() {
+  unsigned tail = *sq_tail_;
+  sq_array_[tail & sq_mask_] = tail & sq_mask_;
+  StoreRelease(sq_tail_, tail + 1);
+  ++pending_submissions_;
+}
+
+bool MessagePumpIoUring::SubmitAndWait(bool wait) {
+  if (!wait && !pending_submissions_)
+    return true;
+
+  io_uring_getevents_arg arg;
+  memset(&arg, 0, sizeof(arg));
+  __kernel_timespec timeout;
+  unsigned flags = 0;
+  if (wait) {
+    flags |= IORING_ENTER_GETEVENTS;
+    if (!delayed_work_time_.is_null()) {
+      TimeDelta delay = delayed_work_time_ - TimeTicks::Now();
+      if (delay < TimeDelta())
+        delay = TimeDelta();
+      timeout.tv_sec = delay.InSeconds();
+      timeout.tv_nsec = (delay.InMicroseconds() % Time::kMicrosecondsPerSecond) *
+                        Time::kNanosecondsPerMicrosecond;
+      arg.ts = reinterpret_cast<uintptr_t>(&timeout);
+    }
+  }
+
+  int rv = EnterRing(ring_fd_, pending_submissions_, wait ? 1 : 0, flags,
+                     &arg);
+  if (rv < 0) {
+    // Timing out and being interrupted are as good as a completion, and
+    // EBUSY means completions are waiting to be processed.
+    if (errno == ETIME || errno == EINTR || errno == EBUSY)
+      return true;
+    DPLOG(ERROR) << "io_uring_enter";
+    return false;
+  }
+  DCHECK_LE(static_cast<unsigned>(rv), pending_submissions_);
+  pending_submissions_ -= rv;
+  return true;
+}
+
+bool MessagePumpIoUring::QueuePoll(FileDescriptorWatcher* controller) {
+  DCHECK(!controller->poll_id_);
+  io_uring_sqe* sqe = GetSubmissionEntry();
+  if (!sqe)
+    return false;
+  uint64 id = next_operation_id_++;
+  sqe->opcode = IORING_OP_POLL_ADD;
+  sqe->fd = controller->fd_;
+  sqe->poll32_events = PollEventsForMode(controller->mode_);
+  sqe->user_data = id;
+  QueueSubmissionEntry();
+  operations_[id].controller = controller;
+  controller->poll_id_ = id;
+  return true;
+}
+
+void MessagePumpIoUring::CancelPoll(FileDescriptorWatcher* controller) {
+  DCHECK(controller->poll_id_);
+  operations_.erase(controller->poll_id_);
+  // If the removal can't be queued, the poll completes unnoticed.
+  io_uring_sqe* sqe = GetSubmissionEntry();
+  if (sqe) {
+    sqe->opcode = IORING_OP_POLL_REMOVE;
+    sqe->fd = -1;
+    sqe->addr = controller->poll_id_;
+    sqe->user_data = kIgnoredId;
+    QueueSubmissionEntry();
+  }
+  controller->poll_id_ = 0;
+}
+
+bool MessagePumpIoUring::QueueWakeupRead() {
+  DCHECK(!wakeup_read_pending_);
+  io_uring_sqe* sqe = GetSubmissionEntry();
+  if (!sqe)
+    return false;
+  sqe->opcode = IORING_OP_READ;
+  sqe->fd = wakeup_fd_;
+  sqe->addr = reinterpret_cast<uintptr_t>(&wakeup_value_);
+  sqe->len = sizeof(wakeup_value_);
+  sqe->off = static_cast<uint64>(-1);
+  sqe->user_data = kWakeupId;
+  QueueSubmissionEntry();
+  wakeup_read_pending_ = true;
+  return true;
+}
+
+bool MessagePumpIoUring::QueueTransfer(uint8 opcode,
+                                       int fd,
+                                       int64 offset,
+                                       const char* buffer,
+                                       int length,
+                                       const IOCallback& callback) {
+  DCHECK_GE(fd, 0);
+  DCHECK_GE(length, 0);
+  DCHECK(!callback.is_null());
+  DCHECK(thread_checker_.CalledOnValidThread());
+
+  Operation operation;
+  operation.callback = callback;
+  operation.opcode = opcode;
+  operation.fd = fd;
+  operation.offset = offset;
+  operation.buffer = buffer;
+  operation.length = length;
+  uint64 id = next_operation_id_++;
+  if (!QueueTransferEntry(id, operation, false))
+    return false;
+  operations_[id] = operation;
+  return true;
+}
+
+bool MessagePumpIoUring::QueueTransferEntry(uint64 id,
+                                            const Operation& operation,
+                                            bool poll) {
+  io_uring_sqe* sqe = GetSubmissionEntry();
+  if (!sqe)
+    return false;
+  sqe->fd = operation.fd;
+  sqe->user_data = id;
+  if (poll) {
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->poll32_events = operation.opcode == IORING_OP_READ ? POLLIN : POLLOUT;
+  } else {
+    sqe->opcode = operation.opcode;
+    sqe->addr = reinterpret_cast<uintptr_t>(operation.buffer);
+    sqe->len = operation.length;
+    sqe->off = static_cast<uint64>(operation.offset);
+  }
+  QueueSubmissionEntry();
+  return true;
+}
+
+void MessagePumpIoUring::CancelTransfers() {
+  // The kernel writes to the buffers of the reads in flight until they
+  // complete, and their owners go with the callbacks.
+  size_t in_flight = 0;
+  for (OperationMap::iterator it = operations_.begin();
+       it != operations_.end(); ++it) {
+    if (it->second.controller)
+      continue;
+    io_uring_sqe* sqe = GetSubmissionEntry();
+    if (sqe) {
+      sqe->opcode = IORING_OP_ASYNC_CANCEL;
+      sqe->fd = -1;
+      sqe->addr = it->first;
+      sqe->user_data = kIgnoredId;
+      QueueSubmissionEntry();
+    }
+    ++in_flight;
+  }
+  if (wakeup_read_pending_) {
+    io_uring_sqe* sqe = GetSubmissionEntry();
+    if (sqe) {
+      sqe->opcode = IORING_OP_ASYNC_CANCEL;
+      sqe->fd = -1;
+      sqe->addr = kWakeupId;
+      sqe->user_data = kIgnoredId;
+      QueueSubmissionEntry();
+    }
+    ++in_flight;
+  }
+
+  delayed_work_time_ = TimeTicks();
+  while (in_flight) {
+    if (!SubmitAndWait(true))
+      break;
+    unsigned head = *cq_head_;
+    unsigned tail = LoadAcquire(cq_tail_);
+    for (; head != tail; ++head) {
+      uint64 user_data = cqes_[head & cq_mask_].user_data;
+      if (user_data == kWakeupId) {
+        wakeup_read_pending_ = false;
+        --in_flight;
+        continue;
+      }
+      OperationMap::iterator it = operations_.find(user_data);
+      if (it != operations_.end() && !it->second.controller) {
+        operations_.erase(it);
+        --in_flight;
+      }
+    }
+    StoreRelease(cq_head_, head);
+  }
+}
+
+bool MessagePumpIoUring::ProcessCompletions() {
+  bool processed = false;
+  for (;;) {
+    unsigned head = *cq_head_;
+    if (head == LoadAcquire(cq_tail_))
+      break;
+    const io_uring_cqe* cqe = &cqes_[head & cq_mask_];
+    uint64 user_data = cqe->user_data;
+    int result = cqe->res;
+    // Consumed before it is dispatched, for a nested Run() not to see it.
+    StoreRelease(cq_head_, head + 1);
+    OnCompletion(user_data, result);
+    processed = true;
+  }
+  return processed;
+}
+
+void MessagePumpIoUring::OnCompletion(uint64 user_data, int result) {
+  if (user_data == kWakeupId) {
+    wakeup_read_pending_ = false;
+    if (!QueueWakeupRead())
+      NOTREACHED();
+    return;
+  }
+
+  OperationMap::iterator it = operations_.find(user_data);
+  if (it == operations_.end())
+    return;
+
+  if (!it->second.controller) {
+    Operation& operation = it->second;
+    bool poll = false;
+    if (result == -EAGAIN && !operation.polling) {
+      // The FD is non-blocking: poll it and try again.
+      poll = true;
+    } else if (!operation.polling) {
+      IOCallback callback = operation.callback;
+      operations_.erase(it);
+      WillProcessIOEvent();
+      callback.Run(result);
+      DidProcessIOEvent();
+      return;
+    }
+    operation.polling = poll;
+    if (!QueueTransferEntry(user_data, operation, poll)) {
+      IOCallback callback = operation.callback;
+      operations_.erase(it);
+      callback.Run(-EIO);
+    }
+    return;
+  }
+
+  FileDescriptorWatcher* controller = it->second.controller;
+  operations_.erase(it);
+  DCHECK_EQ(user_data, controller->poll_id_);
+  controller->poll_id_ = 0;
+
+  int ready = controller->mode_;
+  if (result >= 0 && !(result & (POLLERR | POLLHUP))) {
+    ready = 0;
+    if (result & (POLLIN | POLLPRI | POLLRDHUP))
+      ready |= WATCH_READ;
+    if (result & POLLOUT)
+      ready |= WATCH_WRITE;
+    ready &= controller->mode_;
+  }
+
+  WeakPtr<FileDescriptorWatcher> weak_controller =
+      controller->weak_factory_.GetWeakPtr();
+  int fd = controller->fd_;
+  if (ready & WATCH_WRITE)
+    controller->OnFileCanWriteWithoutBlocking(fd, this);
+  // Check |controller| in case it's been deleted in
+  // controller->OnFileCanWriteWithoutBlocking().
+  if (weak_controller.get() && (ready & WATCH_READ))
+    controller->OnFileCanReadWithoutBlocking(fd, this);
+
+  // Polls are one-shot: poll again for persistent watchers, unless the
+  // delegate stopped watching or watched again.
+  if (weak_controller.get() && controller->mode_ && !controller->poll_id_ &&
+      (controller->persistent_ || !ready)) {
+    if (!QueuePoll(controller))
+      NOTREACHED();
+  }
+}
+
+}  // namespace base
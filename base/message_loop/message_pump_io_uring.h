@@ -0,0 +1,255 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef BASE_MESSAGE_LOOP_MESSAGE_PUMP_IO_URING_H_
+#define BASE_MESSAGE_LOOP_MESSAGE_PUMP_IO_URING_H_
+
+#include <map>
+
+#include "base/basictypes.h"
+#include "base/callback.h"
+#include "base/compiler_specific.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/memory/weak_ptr.h"
+#include "base/message_loop/message_pump.h"
+#include "base/message_loop/message_pump_libevent.h"
+#include "base/observer_list.h"
+#include "base/threading/thread_checker.h"
+#include "base/time/time.h"
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+namespace base {
+
+// Alternative to MessagePumpLibevent for Linux IO threads, built on an
+// io_uring submission/completion ring shared by everything the thread waits
+// for.
+//
+// MessagePumpLibevent makes a system call for every change of the watched
+// file descriptors and for every read and write, and file I/O goes to a
+// worker pool. Here, readiness polls, reads and writes are all requests
+// queued on the submission ring, and are submitted together, in a single
+// io_uring_enter() call, when the pump next checks for completions or goes
+// to sleep. Completions are read off the completion ring without any system
+// call.
+//
+// Watching file descriptors follows the contract of MessagePumpLibevent, and
+// takes the same Watcher. Read() and Write() additionally hand the transfer
+// itself to the kernel, and report its result once it is done, which works
+// for regular files as well as sockets and pipes.
+//
+// The pump is created explicitly with Create(), and run with
+// MessageLoop(scoped_ptr<>); Create() fails if the kernel doesn't support
+// io_uring or doesn't let the process use it, and callers then fall back to
+// MessagePumpLibevent. It is only built with use_io_uring set, as it
+// needs the io_uring headers of Linux 5.11 or later.
+class BASE_EXPORT MessagePumpIoUring : public MessagePump {
+ public:
+  typedef MessagePumpLibevent::IOObserver IOObserver;
+  typedef MessagePumpLibevent::Watcher Watcher;
+
+  // Called with the number of bytes transferred, or with a negative errno
+  // value if the transfer failed.
+  typedef Callback<void(int)> IOCallback;
+
+  // Object returned by WatchFileDescriptor to manage further watching.
+  class BASE_EXPORT FileDescriptorWatcher {
+   public:
+    FileDescriptorWatcher();
+    ~FileDescriptorWatcher();  // Implicitly calls StopWatchingFileDescriptor.
+
+    // Stop watching the FD, always safe to call.  No-op if there's nothing
+    // to do.
+    bool StopWatchingFileDescriptor();
+
+   private:
+    friend class MessagePumpIoUring;
+
+    void OnFileCanReadWithoutBlocking(int fd, MessagePumpIoUring* pump);
+    void OnFileCanWriteWithoutBlocking(int fd, MessagePumpIoUring* pump);
+
+    int fd_;
+    // The WATCH_* modes watched, 0 if not watching.
+    int mode_;
+    bool persistent_;
+    // The request of the poll in flight, 0 if none.
+    uint64 poll_id_;
+    MessagePumpIoUring* pump_;
+    Watcher* watcher_;
+    WeakPtrFactory<FileDescriptorWatcher> weak_factory_;
+
+    DISALLOW_COPY_AND_ASSIGN(FileDescriptorWatcher);
+  };
+
+  enum Mode {
+    WATCH_READ = MessagePumpLibevent::WATCH_READ,
+    WATCH_WRITE = MessagePumpLibevent::WATCH_WRITE,
+    WATCH_READ_WRITE = MessagePumpLibevent::WATCH_READ_WRITE
+  };
+
+  virtual ~MessagePumpIoUring();
+
+  // Returns whether the kernel supports the io_uring features the pump needs.
+  static bool IsSupported();
+
+  // Returns a new pump, or NULL if the ring can't be set up, in which case
+  // the caller should use a MessagePumpLibevent instead.
+  static scoped_ptr<MessagePumpIoUring> Create();
+
+  // Same as MessagePumpLibevent::WatchFileDescriptor().
+  bool WatchFileDescriptor(int fd,
+                           bool persistent,
+                           int mode,
+                           FileDescriptorWatcher* controller,
+                           Watcher* delegate);
+
+  // Reads up to |length| bytes from |fd| into |buffer|, at |offset|, or at
+  // the current position if -1, as for sockets and pipes, and then runs
+  // |callback| on the pump thread. |buffer| must stay valid until then, or
+  // until the pump is destroyed, in which case |callback| is never run;
+  // binding its owner to |callback| does that. Returns false if the read
+  // could not be queued. Must be called on the pump thread.
+  bool Read(int fd,
+            int64 offset,
+            char* buffer,
+            int length,
+            const IOCallback& callback);
+
+  // Same as Read(), for writing |length| bytes of |buffer| to |fd|.
+  bool Write(int fd,
+             int64 offset,
+             const char* buffer,
+             int length,
+             const IOCallback& callback);
+
+  void AddIOObserver(IOObserver* obs);
+  void RemoveIOObserver(IOObserver* obs);
+
+  // MessagePump methods:
+  virtual void Run(Delegate* delegate) OVERRIDE;
+  virtual void Quit() OVERRIDE;
+  virtual void ScheduleWork() OVERRIDE;
+  virtual void ScheduleDelayedWork(const TimeTicks& delayed_work_time) OVERRIDE;
+
+ private:
+  // A request in flight, by the id it was submitted with.
+  struct Operation {
+    Operation();
+    ~Operation();
+
+    // Set for a poll of a watched FD.
+    FileDescriptorWatcher* controller;
+
+    // Set for a read or a write, with its arguments.
+    IOCallback callback;
+    uint8 opcode;
+    int fd;
+    int64 offset;
+    const char* buffer;
+    int length;
+    // Set while the FD of a read or write which would have blocked is
+    // polled, before the read or write is retried.
+    bool polling;
+  };
+  typedef std::map<uint64, Operation> OperationMap;
+
+  MessagePumpIoUring();
+
+  void WillProcessIOEvent();
+  void DidProcessIOEvent();
+
+  // Risky part of Create().  Returns true on success.
+  bool Init();
+
+  // Returns an empty entry of the submission ring, first submitting the
+  // queued ones if it is full, or NULL if that fails.
+  io_uring_sqe* GetSubmissionEntry();
+
+  // Queues the entry returned by GetSubmissionEntry().
+  void QueueSubmissionEntry();
+
+  // Submits the queued entries, and if |wait|, waits for a completion, until
+  // |delayed_work_time_| if set. Returns false on failure.
+  bool SubmitAndWait(bool wait);
+
+  // Queues a poll of |controller|'s FD for the modes it watches.
+  bool QueuePoll(FileDescriptorWatcher* controller);
+
+  // Queues the removal of the poll in flight of |controller|, if any.
+  void CancelPoll(FileDescriptorWatcher* controller);
+
+  // Queues a read of the wakeup eventfd.
+  bool QueueWakeupRead();
+
+  // Queues a read or write for Read() and Write().
+  bool QueueTransfer(uint8 opcode,
+                     int fd,
+                     int64 offset,
+                     const char* buffer,
+                     int length,
+                     const IOCallback& callback);
+
+  // Queues the read or write of |operation|, or the poll of its FD if
+  // |poll|, with |id|.
+  bool QueueTransferEntry(uint64 id, const Operation& operation, bool poll);
+
+  // Cancels the reads and writes in flight, and the read of the wakeup
+  // eventfd, and waits for them to complete.
+  void CancelTransfers();
+
+  // Dispatches the completions on the completion ring. Returns true if there
+  // were any.
+  bool ProcessCompletions();
+
+  // Dispatches a single completion.
+  void OnCompletion(uint64 user_data, int result);
+
+  // This flag is set to false when Run should return.
+  bool keep_running_;
+
+  // This flag is set when inside Run.
+  bool in_run_;
+
+  // The time at which we should call DoDelayedWork.
+  TimeTicks delayed_work_time_;
+
+  // The ring, and the mappings of its queues and of its submission entries.
+  int ring_fd_;
+  void* ring_;
+  size_t ring_size_;
+  io_uring_sqe* sqes_;
+  size_t sqes_size_;
+
+  // Pointers into the rings.
+  unsigned* sq_head_;
+  unsigned* sq_tail_;
+  unsigned sq_mask_;
+  unsigned sq_entries_;
+  unsigned* sq_array_;
+  unsigned* cq_head_;
+  unsigned* cq_tail_;
+  unsigned cq_mask_;
+  io_uring_cqe* cqes_;
+
+  // The entries queued on the submission ring and not submitted yet.
+  unsigned pending_submissions_;
+
+  // eventfd written by ScheduleWork(), and the buffer it is read into.
+  int wakeup_fd_;
+  uint64 wakeup_value_;
+  bool wakeup_read_pending_;
+
+  uint64 next_operation_id_;
+  OperationMap operations_;
+
+  ObserverList<IOObserver> io_observers_;
+  ThreadChecker thread_checker_;
+
+  DISALLOW_COPY_AND_ASSIGN(MessagePumpIoUring);
+};
+
+}  // namespace base
+
+#endif  // BASE_MESSAGE_LOOP_MESSAGE_PUMP_IO_URING_H_
@@ -0,0 +1,263 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <string>
+
+#include "base/bind.h"
+#include "base/memory/ref_counted_memory.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/memory/scoped_vector.h"
+#include "base/memory/weak_ptr.h"
+#include "base/message_loop/message_loop.h"
+#include "base/message_loop/message_pump_io_uring.h"
+#include "base/message_loop/message_pump_libevent.h"
+#include "base/posix/eintr_wrapper.h"
+#include "base/run_loop.h"
+#include "base/time/time.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "testing/perf/perf_test.h"
+
+namespace base {
+
+namespace {
+
+// Clients each send a message to an echo server and wait for it to come back
+// before sending the next one, on as many connections, all on the thread of
+// the pump.
+const int kConnections = 64;
+const int kMessageSize = 1024;
+const int kRoundTripsPerConnection = 500;
+
+// A connected pair of non-blocking sockets, as net sockets are.
+class Connection {
+ public:
+  Connection() {
+    fds_[0] = fds_[1] = -1;
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds_) == 0) {
+      for (size_t i = 0; i < arraysize(fds_); ++i) {
+        int flags = fcntl(fds_[i], F_GETFL);
+        fcntl(fds_[i], F_SETFL, flags | O_NONBLOCK);
+      }
+    }
+  }
+
+  ~Connection() {
+    for (size_t i = 0; i < arraysize(fds_); ++i) {
+      if (fds_[i] >= 0 && IGNORE_EINTR(close(fds_[i])) < 0)
+        PLOG(ERROR) << "close";
+    }
+  }
+
+  int client_fd() const { return fds_[0]; }
+  int server_fd() const { return fds_[1]; }
+
+ private:
+  int fds_[2];
+
+  DISALLOW_COPY_AND_ASSIGN(Connection);
+};
+
+// Counts the round trips of all the connections, and quits once they are
+// done.
+class RoundTripCounter {
+ public:
+  explicit RoundTripCounter(const Closure& quit_closure)
+      : remaining_connections_(kConnections), quit_closure_(quit_closure) {}
+
+  void OnConnectionDone() {
+    if (--remaining_connections_ == 0)
+      quit_closure_.Run();
+  }
+
+ private:
+  int remaining_connections_;
+  Closure quit_closure_;
+};
+
+// Echoes, or sends and waits for, messages on one end of a connection,
+// reading and writing when the pump reports the socket is ready, as net
+// sockets do.
+template <typename Pump>
+class ReadinessEndpoint : public Pump::Watcher {
+ public:
+  ReadinessEndpoint(Pump* pump, int fd, RoundTripCounter* counter)
+      : fd_(fd),
+        counter_(counter),
+        buffer_(kMessageSize, 'x'),
+        round_trips_(0) {
+    pump->WatchFileDescriptor(fd_, true, Pump::WATCH_READ, &controller_,
+                              this);
+  }
+  virtual ~ReadinessEndpoint() {}
+
+  // Sends the first message of a client.
+  void Start() { Send(); }
+
+  // Pump::Watcher implementation:
+  virtual void OnFileCanReadWithoutBlocking(int fd) OVERRIDE {
+    int rv = HANDLE_EINTR(read(fd_, &buffer_[0], buffer_.size()));
+    if (rv <= 0)
+      return;
+    if (!counter_) {
+      EXPECT_EQ(rv, HANDLE_EINTR(write(fd_, &buffer_[0], rv)));
+      return;
+    }
+    // Messages are small enough to arrive in one piece.
+    DCHECK_EQ(kMessageSize, rv);
+    if (++round_trips_ == kRoundTripsPerConnection) {
+      controller_.StopWatchingFileDescriptor();
+      counter_->OnConnectionDone();
+      return;
+    }
+    Send();
+  }
+
+  virtual void OnFileCanWriteWithoutBlocking(int fd) OVERRIDE {}
+
+ private:
+  void Send() {
+    EXPECT_EQ(kMessageSize,
+              HANDLE_EINTR(write(fd_, &buffer_[0], buffer_.size())));
+  }
+
+  const int fd_;
+  // Set for a client.
+  RoundTripCounter* counter_;
+  std::string buffer_;
+  int round_trips_;
+  typename Pump::FileDescriptorWatcher controller_;
+
+  DISALLOW_COPY_AND_ASSIGN(ReadinessEndpoint);
+};
+
+// Same as ReadinessEndpoint, handing the reads and writes to the ring. The
+// callbacks hold the buffer, which the kernel may write to until the pump
+// drops them.
+class CompletionEndpoint {
+ public:
+  CompletionEndpoint(MessagePumpIoUring* pump,
+                     int fd,
+                     RoundTripCounter* counter)
+      : pump_(pump),
+        fd_(fd),
+        counter_(counter),
+        buffer_(new RefCountedString),
+        round_trips_(0),
+        weak_factory_(this) {
+    buffer_->data().assign(kMessageSize, 'x');
+    if (!counter_)
+      Receive();
+  }
+
+  void Start() { Send(kMessageSize); }
+
+ private:
+  void Receive() {
+    pump_->Read(fd_, -1, &buffer_->data()[0], kMessageSize,
+                Bind(&CompletionEndpoint::OnReceived,
+                     weak_factory_.GetWeakPtr(), buffer_));
+  }
+
+  void Send(int size) {
+    pump_->Write(fd_, -1, buffer_->data().data(), size,
+                 Bind(&CompletionEndpoint::OnSent,
+                      weak_factory_.GetWeakPtr(), buffer_));
+  }
+
+  void OnReceived(scoped_refptr<RefCountedString> buffer, int rv) {
+    if (rv <= 0)
+      return;
+    if (!counter_) {
+      Send(rv);
+      return;
+    }
+    DCHECK_EQ(kMessageSize, rv);
+    if (++round_trips_ == kRoundTripsPerConnection) {
+      counter_->OnConnectionDone();
+      return;
+    }
+    Send(kMessageSize);
+  }
+
+  void OnSent(scoped_refptr<RefCountedString> buffer, int rv) {
+    EXPECT_GT(rv, 0);
+    Receive();
+  }
+
+  MessagePumpIoUring* pump_;
+  const int fd_;
+  RoundTripCounter* counter_;
+  scoped_refptr<RefCountedString> buffer_;
+  int round_trips_;
+  WeakPtrFactory<CompletionEndpoint> weak_factory_;
+
+  DISALLOW_COPY_AND_ASSIGN(CompletionEndpoint);
+};
+
+void PrintResult(const std::string& trace, TimeDelta elapsed) {
+  perf_test::PrintResult(
+      "echo_server", "", trace,
+      kConnections * kRoundTripsPerConnection / elapsed.InSecondsF(),
+      "round_trips/s", true);
+}
+
+// Runs the echo server on a loop of |Pump|, watching the sockets.
+template <typename Pump, typename Endpoint>
+void RunEcho(Pump* pump, const std::string& trace) {
+  MessageLoop loop((scoped_ptr<MessagePump>(pump)));
+  RunLoop run_loop;
+  RoundTripCounter counter(run_loop.QuitClosure());
+  ScopedVector<Connection> connections;
+  ScopedVector<Endpoint> servers;
+  ScopedVector<Endpoint> clients;
+  for (int i = 0; i < kConnections; ++i) {
+    connections.push_back(new Connection);
+    ASSERT_GE(connections.back()->client_fd(), 0);
+    servers.push_back(
+        new Endpoint(pump, connections.back()->server_fd(), NULL));
+    clients.push_back(
+        new Endpoint(pump, connections.back()->client_fd(), &counter));
+  }
+
+  TimeTicks begin = TimeTicks::HighResNow();
+  for (size_t i = 0; i < clients.size(); ++i)
+    clients[i]->Start();
+  run_loop.Run();
+  PrintResult(trace, TimeTicks::HighResNow() - begin);
+
+  // The endpoints stop watching before the pump goes.
+  servers.clear();
+  clients.clear();
+}
+
+}  // namespace
+
+TEST(MessagePumpIoUringPerfTest, EchoLibevent) {
+  MessagePumpLibevent* pump = new MessagePumpLibevent;
+  RunEcho<MessagePumpLibevent, ReadinessEndpoint<MessagePumpLibevent> >(
+      pump, "libevent");
+}
+
+TEST(MessagePumpIoUringPerfTest, EchoIoUringWatch) {
+  scoped_ptr<MessagePumpIoUring> pump = MessagePumpIoUring::Create();
+  if (!pump)
+    return;
+  RunEcho<MessagePumpIoUring, ReadinessEndpoint<MessagePumpIoUring> >(
+      pump.release(), "io_uring_watch");
+}
+
+TEST(MessagePumpIoUringPerfTest, EchoIoUringReadWrite) {
+  scoped_ptr<MessagePumpIoUring> pump = MessagePumpIoUring::Create();
+  if (!pump)
+    return;
+  RunEcho<MessagePumpIoUring, CompletionEndpoint>(pump.release(),
+                                                  "io_uring_read_write");
+}
+
+}  // namespace base
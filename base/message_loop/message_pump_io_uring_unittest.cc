@@ -0,0 +1,277 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/message_loop/message_pump_io_uring.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <string>
+
+#include "base/bind.h"
+#include "base/files/file_path.h"
+#include "base/files/scoped_temp_dir.h"
+#include "base/message_loop/message_loop.h"
+#include "base/posix/eintr_wrapper.h"
+#include "base/run_loop.h"
+#include "base/threading/thread.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace base {
+
+namespace {
+
+// The tests return early if the kernel doesn't support the pump.
+class MessagePumpIoUringTest : public testing::Test {
+ protected:
+  MessagePumpIoUringTest() : pump_(NULL) {}
+  virtual ~MessagePumpIoUringTest() {}
+
+  virtual void SetUp() OVERRIDE {
+    scoped_ptr<MessagePumpIoUring> pump = MessagePumpIoUring::Create();
+    supported_ = pump.get() != NULL;
+    if (!supported_)
+      return;
+    pump_ = pump.get();
+    loop_.reset(new MessageLoop(pump.PassAs<MessagePump>()));
+    ASSERT_EQ(0, pipe(pipefds_));
+    ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, sockets_));
+  }
+
+  virtual void TearDown() OVERRIDE {
+    if (!supported_)
+      return;
+    loop_.reset();
+    for (size_t i = 0; i < arraysize(pipefds_); ++i) {
+      if (IGNORE_EINTR(close(pipefds_[i])) < 0)
+        PLOG(ERROR) << "close";
+      if (IGNORE_EINTR(close(sockets_[i])) < 0)
+        PLOG(ERROR) << "close";
+    }
+  }
+
+  bool supported_;
+  MessagePumpIoUring* pump_;
+  scoped_ptr<MessageLoop> loop_;
+  int pipefds_[2];
+  int sockets_[2];
+};
+
+// Quits the loop after |expected_reads| notifications that the FD can be
+// read, reading a byte each time.
+class ReadWatcher : public MessagePumpIoUring::Watcher {
+ public:
+  ReadWatcher(int expected_reads, const Closure& quit_closure)
+      : expected_reads_(expected_reads),
+        read_count_(0),
+        quit_closure_(quit_closure) {}
+  virtual ~ReadWatcher() {}
+
+  int read_count() const { return read_count_; }
+
+  // MessagePumpIoUring::Watcher interface
+  virtual void OnFileCanReadWithoutBlocking(int fd) OVERRIDE {
+    char buf;
+    EXPECT_EQ(1, HANDLE_EINTR(read(fd, &buf, 1)));
+    if (++read_count_ == expected_reads_)
+      quit_closure_.Run();
+  }
+
+  virtual void OnFileCanWriteWithoutBlocking(int /* fd */) OVERRIDE {
+    NOTREACHED();
+  }
+
+ private:
+  const int expected_reads_;
+  int read_count_;
+  Closure quit_closure_;
+};
+
+// Stops watching, or deletes its controller, when the FD can be written to.
+class StopWatcher : public MessagePumpIoUring::Watcher {
+ public:
+  StopWatcher(MessagePumpIoUring::FileDescriptorWatcher* controller,
+              bool delete_controller,
+              const Closure& quit_closure)
+      : controller_(controller),
+        delete_controller_(delete_controller),
+        quit_closure_(quit_closure) {}
+  virtual ~StopWatcher() {}
+
+  // MessagePumpIoUring::Watcher interface
+  virtual void OnFileCanReadWithoutBlocking(int /* fd */) OVERRIDE {
+    NOTREACHED();
+  }
+
+  virtual void OnFileCanWriteWithoutBlocking(int /* fd */) OVERRIDE {
+    ASSERT_TRUE(controller_);
+    if (delete_controller_)
+      delete controller_;
+    else
+      controller_->StopWatchingFileDescriptor();
+    controller_ = NULL;
+    // Let the loop spin, to catch another notification.
+    MessageLoop::current()->PostDelayedTask(
+        FROM_HERE, quit_closure_, TimeDelta::FromMilliseconds(10));
+  }
+
+ private:
+  MessagePumpIoUring::FileDescriptorWatcher* controller_;
+  const bool delete_controller_;
+  Closure quit_closure_;
+};
+
+void WriteByte(int fd) {
+  char buf = 0;
+  EXPECT_EQ(1, HANDLE_EINTR(write(fd, &buf, 1)));
+}
+
+void SetResult(int* result, const Closure& quit_closure, int rv) {
+  *result = rv;
+  quit_closure.Run();
+}
+
+void PostTaskTo(scoped_refptr<MessageLoopProxy> proxy, const Closure& task) {
+  proxy->PostTask(FROM_HERE, task);
+}
+
+void NotReached(int rv) {
+  ADD_FAILURE() << "Unexpected completion: " << rv;
+}
+
+}  // namespace
+
+TEST_F(MessagePumpIoUringTest, WatchRead) {
+  if (!supported_)
+    return;
+  RunLoop run_loop;
+  ReadWatcher delegate(1, run_loop.QuitClosure());
+  MessagePumpIoUring::FileDescriptorWatcher watcher;
+  ASSERT_TRUE(pump_->WatchFileDescriptor(
+      pipefds_[0], false, MessagePumpIoUring::WATCH_READ, &watcher,
+      &delegate));
+  loop_->PostTask(FROM_HERE, Bind(&WriteByte, pipefds_[1]));
+  run_loop.Run();
+  EXPECT_EQ(1, delegate.read_count());
+}
+
+TEST_F(MessagePumpIoUringTest, WatchReadPersistent) {
+  if (!supported_)
+    return;
+  RunLoop run_loop;
+  ReadWatcher delegate(3, run_loop.QuitClosure());
+  MessagePumpIoUring::FileDescriptorWatcher watcher;
+  ASSERT_TRUE(pump_->WatchFileDescriptor(
+      pipefds_[0], true, MessagePumpIoUring::WATCH_READ, &watcher,
+      &delegate));
+  for (int i = 0; i < 3; ++i) {
+    loop_->PostDelayedTask(FROM_HERE, Bind(&WriteByte, pipefds_[1]),
+                           TimeDelta::FromMilliseconds(i));
+  }
+  run_loop.Run();
+  EXPECT_EQ(3, delegate.read_count());
+}
+
+TEST_F(MessagePumpIoUringTest, StopWatcher) {
+  if (!supported_)
+    return;
+  RunLoop run_loop;
+  MessagePumpIoUring::FileDescriptorWatcher watcher;
+  StopWatcher delegate(&watcher, false, run_loop.QuitClosure());
+  ASSERT_TRUE(pump_->WatchFileDescriptor(
+      pipefds_[1], true, MessagePumpIoUring::WATCH_WRITE, &watcher,
+      &delegate));
+  run_loop.Run();
+}
+
+TEST_F(MessagePumpIoUringTest, DeleteWatcher) {
+  if (!supported_)
+    return;
+  RunLoop run_loop;
+  MessagePumpIoUring::FileDescriptorWatcher* watcher =
+      new MessagePumpIoUring::FileDescriptorWatcher;
+  StopWatcher delegate(watcher, true, run_loop.QuitClosure());
+  ASSERT_TRUE(pump_->WatchFileDescriptor(
+      pipefds_[1], true, MessagePumpIoUring::WATCH_READ_WRITE, watcher,
+      &delegate));
+  run_loop.Run();
+}
+
+TEST_F(MessagePumpIoUringTest, ReadWriteFile) {
+  if (!supported_)
+    return;
+  ScopedTempDir temp_dir;
+  ASSERT_TRUE(temp_dir.CreateUniqueTempDir());
+  FilePath path = temp_dir.path().AppendASCII("file");
+  int fd = HANDLE_EINTR(open(path.value().c_str(), O_RDWR | O_CREAT, 0600));
+  ASSERT_GE(fd, 0);
+
+  const std::string data("0123456789");
+  int result = 0;
+  {
+    RunLoop run_loop;
+    ASSERT_TRUE(pump_->Write(fd, 5, data.data(), data.size(),
+                             Bind(&SetResult, &result,
+                                  run_loop.QuitClosure())));
+    run_loop.Run();
+    EXPECT_EQ(static_cast<int>(data.size()), result);
+  }
+
+  char buffer[8];
+  {
+    RunLoop run_loop;
+    ASSERT_TRUE(pump_->Read(fd, 7, buffer, sizeof(buffer),
+                            Bind(&SetResult, &result,
+                                 run_loop.QuitClosure())));
+    run_loop.Run();
+    ASSERT_EQ(8, result);
+    EXPECT_EQ("23456789", std::string(buffer, result));
+  }
+  EXPECT_EQ(0, IGNORE_EINTR(close(fd)));
+}
+
+// A read of a non-blocking socket waits for data rather than failing.
+TEST_F(MessagePumpIoUringTest, ReadNonBlockingSocket) {
+  if (!supported_)
+    return;
+  int flags = fcntl(sockets_[0], F_GETFL);
+  ASSERT_EQ(0, fcntl(sockets_[0], F_SETFL, flags | O_NONBLOCK));
+
+  RunLoop run_loop;
+  int result = 0;
+  char buffer[4];
+  ASSERT_TRUE(pump_->Read(sockets_[0], -1, buffer, sizeof(buffer),
+                          Bind(&SetResult, &result, run_loop.QuitClosure())));
+  loop_->PostDelayedTask(FROM_HERE, Bind(&WriteByte, sockets_[1]),
+                         TimeDelta::FromMilliseconds(10));
+  run_loop.Run();
+  EXPECT_EQ(1, result);
+}
+
+TEST_F(MessagePumpIoUringTest, PostTaskFromOtherThread) {
+  if (!supported_)
+    return;
+  Thread thread("MessagePumpIoUringTestThread");
+  ASSERT_TRUE(thread.Start());
+  RunLoop run_loop;
+  thread.message_loop()->PostTask(
+      FROM_HERE,
+      Bind(&PostTaskTo, loop_->message_loop_proxy(), run_loop.QuitClosure()));
+  run_loop.Run();
+}
+
+// The callbacks of the reads in flight are dropped with the pump.
+TEST_F(MessagePumpIoUringTest, DestroyWithReadInFlight) {
+  if (!supported_)
+    return;
+  char buffer[4];
+  ASSERT_TRUE(pump_->Read(sockets_[0], -1, buffer, sizeof(buffer),
+                          Bind(&NotReached)));
+  RunLoop().RunUntilIdle();
+  loop_.reset();
+}
+
+}  // namespace base
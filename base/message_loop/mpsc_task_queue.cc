@@ -0,0 +1,100 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/message_loop/mpsc_task_queue.h"
+
+#include "base/logging.h"
+
+namespace base {
+namespace internal {
+
+MpscTaskQueue::MpscTaskQueue()
+    : head_(reinterpret_cast<subtle::AtomicWord>(&stub_)),
+      tail_(&stub_) {
+}
+
+MpscTaskQueue::~MpscTaskQueue() {
+  bool busy = false;
+  while (Node* node = Pop(&busy))
+    delete node;
+  DCHECK(!busy);
+}
+
+void MpscTaskQueue::Push(const PendingTask& pending_task) {
+  PushLink(new Node(pending_task));
+}
+
+bool MpscTaskQueue::PopAll(TaskQueue* work_queue) {
+  bool busy = false;
+  while (Node* node = Pop(&busy)) {
+    work_queue->push(node->pending_task);
+    delete node;
+  }
+  return !busy;
+}
+
+bool MpscTaskQueue::IsEmpty() const {
+  return tail_ == &stub_ &&
+         reinterpret_cast<Link*>(subtle::Acquire_Load(&head_)) == &stub_;
+}
+
+void MpscTaskQueue::PushLink(Link* link) {
+  subtle::NoBarrier_Store(&link->next, 0);
+  // The store above must be visible before |link| becomes reachable through
+  // |head_|, since the next producer writes |link->next|.
+  subtle::MemoryBarrier();
+  Link* prev = reinterpret_cast<Link*>(subtle::NoBarrier_AtomicExchange(
+      &head_, reinterpret_cast<subtle::AtomicWord>(link)));
+  // Between the exchange and this store the consumer cannot see |link| or
+  // anything pushed after it. Pop() detects that window and reports |busy|.
+  subtle::Release_Store(&prev->next,
+                        reinterpret_cast<subtle::AtomicWord>(link));
+}
+
+MpscTaskQueue::Node* MpscTaskQueue::Pop(bool* busy) {
+  *busy = false;
+  Link* tail = tail_;
+  Link* next = NextOf(tail);
+  if (tail == &stub_) {
+    if (!next) {
+      *busy =
+          reinterpret_cast<Link*>(subtle::Acquire_Load(&head_)) != &stub_;
+      return NULL;
+    }
+    tail_ = next;
+    tail = next;
+    next = NextOf(next);
+  }
+
+  if (next) {
+    tail_ = next;
+    return static_cast<Node*>(tail);
+  }
+
+  // |tail| is the last visible node. Unless it is also the head, a producer is
+  // between its exchange and its link.
+  if (tail != reinterpret_cast<Link*>(subtle::Acquire_Load(&head_))) {
+    *busy = true;
+    return NULL;
+  }
+
+  // Re-insert the stub behind |tail| so that |tail| can be handed out without
+  // leaving the list empty.
+  PushLink(&stub_);
+  next = NextOf(tail);
+  if (next) {
+    tail_ = next;
+    return static_cast<Node*>(tail);
+  }
+  *busy = true;
+  return NULL;
+}
+
+// static
+MpscTaskQueue::Link* MpscTaskQueue::NextOf(const Link* link) {
+  return reinterpret_cast<Link*>(subtle::Acquire_Load(&link->next));
+}
+
+}  // namespace internal
+}  // namespace base
@@ -0,0 +1,83 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef BASE_MESSAGE_LOOP_MPSC_TASK_QUEUE_H_
+#define BASE_MESSAGE_LOOP_MPSC_TASK_QUEUE_H_
+
+#include "base/atomicops.h"
+#include "base/base_export.h"
+#include "base/basictypes.h"
+#include "base/pending_task.h"
+
+namespace base {
+namespace internal {
+
+// An unbounded multi-producer single-consumer queue of PendingTasks, built as
+// an intrusive singly linked list with a stub node (see Dmitry Vyukov's
+// "Intrusive MPSC node-based queue"). Push() may be called from any thread and
+// never blocks: it costs one allocation and one atomic exchange. PopAll() may
+// only be called from the single consumer thread.
+//
+// A producer that has swapped itself in as the new head but not yet linked its
+// predecessor is briefly invisible to the consumer. PopAll() reports this case
+// so the caller can come back for the remaining tasks later instead of
+// spinning.
+class BASE_EXPORT MpscTaskQueue {
+ public:
+  MpscTaskQueue();
+
+  // Deletes any tasks still in the queue. No producer may be running.
+  ~MpscTaskQueue();
+
+  // Appends a copy of |pending_task|. Safe to call from any thread.
+  void Push(const PendingTask& pending_task);
+
+  // Moves every task currently reachable from the consumer end into
+  // |work_queue|, in push order. Returns false if a producer was caught in the
+  // middle of Push(), in which case some tasks may have been left behind and
+  // PopAll() must be called again. Consumer thread only.
+  bool PopAll(TaskQueue* work_queue);
+
+  // Returns true if no tasks have been pushed since the last PopAll() drained
+  // the queue. Consumer thread only.
+  bool IsEmpty() const;
+
+ private:
+  struct Link {
+    Link() : next(0) {}
+    subtle::AtomicWord next;
+  };
+
+  struct Node : public Link {
+    explicit Node(const PendingTask& pending_task)
+        : pending_task(pending_task) {}
+    PendingTask pending_task;
+  };
+
+  // Links |link| in as the new head. Used by Push() and to re-insert |stub_|.
+  void PushLink(Link* link);
+
+  // Unlinks and returns the oldest node, or NULL if the queue is empty or a
+  // producer is mid-push. |*busy| is set to true in the latter case.
+  Node* Pop(bool* busy);
+
+  static Link* NextOf(const Link* link);
+
+  // Most recently pushed link. Written by all producers.
+  subtle::AtomicWord head_;
+
+  // Oldest link. Only accessed by the consumer.
+  Link* tail_;
+
+  // Placeholder that keeps the list non-empty so producers never need to
+  // touch |tail_|.
+  Link stub_;
+
+  DISALLOW_COPY_AND_ASSIGN(MpscTaskQueue);
+};
+
+}  // namespace internal
+}  // namespace base
+
+#endif  // BASE_MESSAGE_LOOP_MPSC_TASK_QUEUE_H_
@@ -0,0 +1,147 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/message_loop/mpsc_task_queue.h"
+
+#include <vector>
+
+#include "base/bind.h"
+#include "base/bind_helpers.h"
+#include "base/memory/scoped_vector.h"
+#include "base/threading/simple_thread.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace base {
+namespace internal {
+
+namespace {
+
+PendingTask MakeTask(int sequence_num) {
+  PendingTask pending_task(FROM_HERE, Bind(&DoNothing));
+  pending_task.sequence_num = sequence_num;
+  return pending_task;
+}
+
+// Pushes |num_tasks| tasks tagged with |producer_id| in their delayed run
+// time field so the consumer can check per-producer FIFO order.
+class Producer : public DelegateSimpleThread::Delegate {
+ public:
+  Producer(MpscTaskQueue* queue, int producer_id, int num_tasks)
+      : queue_(queue), producer_id_(producer_id), num_tasks_(num_tasks) {}
+
+  virtual void Run() OVERRIDE {
+    for (int i = 0; i < num_tasks_; ++i) {
+      PendingTask pending_task(FROM_HERE, Bind(&DoNothing),
+                               TimeTicks::FromInternalValue(producer_id_),
+                               true);
+      pending_task.sequence_num = i;
+      queue_->Push(pending_task);
+    }
+  }
+
+ private:
+  MpscTaskQueue* queue_;
+  const int producer_id_;
+  const int num_tasks_;
+};
+
+}  // namespace
+
+TEST(MpscTaskQueueTest, EmptyQueue) {
+  MpscTaskQueue queue;
+  EXPECT_TRUE(queue.IsEmpty());
+
+  TaskQueue work_queue;
+  EXPECT_TRUE(queue.PopAll(&work_queue));
+  EXPECT_TRUE(work_queue.empty());
+}
+
+TEST(MpscTaskQueueTest, PopAllPreservesOrder) {
+  MpscTaskQueue queue;
+  for (int i = 0; i < 5; ++i)
+    queue.Push(MakeTask(i));
+  EXPECT_FALSE(queue.IsEmpty());
+
+  TaskQueue work_queue;
+  EXPECT_TRUE(queue.PopAll(&work_queue));
+  EXPECT_TRUE(queue.IsEmpty());
+  ASSERT_EQ(5u, work_queue.size());
+  for (int i = 0; i < 5; ++i) {
+    EXPECT_EQ(i, work_queue.front().sequence_num);
+    work_queue.pop();
+  }
+}
+
+TEST(MpscTaskQueueTest, InterleavedPushAndPop) {
+  MpscTaskQueue queue;
+  TaskQueue work_queue;
+
+  queue.Push(MakeTask(0));
+  EXPECT_TRUE(queue.PopAll(&work_queue));
+  ASSERT_EQ(1u, work_queue.size());
+  EXPECT_EQ(0, work_queue.front().sequence_num);
+  work_queue.pop();
+
+  // The stub node is re-inserted after the queue drains; make sure later
+  // pushes are still seen.
+  queue.Push(MakeTask(1));
+  queue.Push(MakeTask(2));
+  EXPECT_TRUE(queue.PopAll(&work_queue));
+  ASSERT_EQ(2u, work_queue.size());
+  EXPECT_EQ(1, work_queue.front().sequence_num);
+  work_queue.pop();
+  EXPECT_EQ(2, work_queue.front().sequence_num);
+}
+
+TEST(MpscTaskQueueTest, DestructorDeletesPendingTasks) {
+  scoped_ptr<MpscTaskQueue> queue(new MpscTaskQueue);
+  queue->Push(MakeTask(0));
+  queue->Push(MakeTask(1));
+  // Should not leak; verified by the memory tools bots.
+  queue.reset();
+}
+
+TEST(MpscTaskQueueTest, MultipleProducers) {
+  const int kNumProducers = 8;
+  const int kTasksPerProducer = 10000;
+
+  MpscTaskQueue queue;
+  ScopedVector<Producer> producers;
+  ScopedVector<DelegateSimpleThread> threads;
+  for (int i = 0; i < kNumProducers; ++i) {
+    producers.push_back(new Producer(&queue, i, kTasksPerProducer));
+    threads.push_back(
+        new DelegateSimpleThread(producers.back(), "MpscTaskQueueProducer"));
+  }
+  for (size_t i = 0; i < threads.size(); ++i)
+    threads[i]->Start();
+
+  // Drain concurrently with the producers.
+  std::vector<int> next_expected(kNumProducers, 0);
+  int total = 0;
+  TaskQueue work_queue;
+  while (total < kNumProducers * kTasksPerProducer) {
+    queue.PopAll(&work_queue);
+    while (!work_queue.empty()) {
+      const PendingTask& pending_task = work_queue.front();
+      int producer = static_cast<int>(
+          pending_task.delayed_run_time.ToInternalValue());
+      ASSERT_GE(producer, 0);
+      ASSERT_LT(producer, kNumProducers);
+      EXPECT_EQ(next_expected[producer], pending_task.sequence_num);
+      next_expected[producer] = pending_task.sequence_num + 1;
+      ++total;
+      work_queue.pop();
+    }
+  }
+
+  for (size_t i = 0; i < threads.size(); ++i)
+    threads[i]->Join();
+  EXPECT_TRUE(queue.PopAll(&work_queue));
+  EXPECT_TRUE(work_queue.empty());
+  EXPECT_TRUE(queue.IsEmpty());
+}
+
+}  // namespace internal
+}  // namespace base
@@ -17,7 +17,9 @@
 #include "base/compiler_specific.h"
 #include "base/debug/alias.h"
 #include "base/logging.h"
+#include "base/metrics/persistent_histogram_allocator.h"
 #include "base/metrics/sample_vector.h"
+#include "base/metrics/sharded_sample_vector.h"
 #include "base/metrics/statistics_recorder.h"
 #include "base/pickle.h"
 #include "base/strings/string_util.h"
@@ -105,8 +107,7 @@ HistogramBase* Histogram::FactoryGet(const string& name,
         new Histogram(name, minimum, maximum, registered_ranges);
 
     tentative_histogram->SetFlags(flags);
-    histogram =
-        StatisticsRecorder::RegisterOrDeleteDuplicate(tentative_histogram);
+    histogram = RegisterOrDeleteDuplicate(tentative_histogram);
   }
 
   DCHECK_EQ(HISTOGRAM, histogram->GetHistogramType());
@@ -263,6 +264,10 @@ void Histogram::Add(int value) {
     value = kSampleType_MAX - 1;
   if (value < 0)
     value = 0;
+  if (flags() & kShardedRecordingFlag) {
+    GetShardedSamples()->Accumulate(value, 1);
+    return;
+  }
   samples_->Accumulate(value, 1);
 }
 
@@ -307,18 +312,35 @@ Histogram::Histogram(const string& name,
   : HistogramBase(name),
     bucket_ranges_(ranges),
     declared_min_(minimum),
-    declared_max_(maximum) {
+    declared_max_(maximum),
+    sharded_samples_(0) {
   if (ranges)
     samples_.reset(new SampleVector(ranges));
 }
 
 Histogram::~Histogram() {
+  delete reinterpret_cast<ShardedSampleVector*>(sharded_samples_);
 }
 
 bool Histogram::PrintEmptyBucket(size_t index) const {
   return true;
 }
 
+// static
+HistogramBase* Histogram::RegisterOrDeleteDuplicate(
+    Histogram* tentative_histogram) {
+  PersistentHistogramAllocator* allocator =
+      PersistentHistogramAllocator::GetGlobalAllocator();
+  PersistentMemoryAllocator::Reference ref = 0;
+  if (allocator)
+    ref = allocator->AllocateHistogram(tentative_histogram);
+  HistogramBase* histogram =
+      StatisticsRecorder::RegisterOrDeleteDuplicate(tentative_histogram);
+  if (ref)
+    allocator->FinalizeHistogram(ref, histogram == tentative_histogram);
+  return histogram;
+}
+
 // Use the actual bucket widths (like a linear histogram) until the widths get
 // over some transition value, and then use that transition width.  Exponentials
 // get so big so fast (and we don't expect to see a lot of entries in the large
@@ -368,9 +390,29 @@ HistogramBase* Histogram::DeserializeInfoImpl(PickleIterator* iter) {
 scoped_ptr<SampleVector> Histogram::SnapshotSampleVector() const {
   scoped_ptr<SampleVector> samples(new SampleVector(bucket_ranges()));
   samples->Add(*samples_);
+  subtle::AtomicWord sharded_samples = subtle::Acquire_Load(&sharded_samples_);
+  if (sharded_samples)
+    reinterpret_cast<ShardedSampleVector*>(sharded_samples)->AddTo(
+        samples.get());
   return samples.Pass();
 }
 
+ShardedSampleVector* Histogram::GetShardedSamples() {
+  subtle::AtomicWord sharded_samples = subtle::Acquire_Load(&sharded_samples_);
+  if (!sharded_samples) {
+    // Threads racing to get here each create one; the first to publish its
+    // own wins, and the others delete theirs.
+    ShardedSampleVector* created = new ShardedSampleVector(bucket_ranges());
+    sharded_samples = subtle::Release_CompareAndSwap(
+        &sharded_samples_, 0, reinterpret_cast<subtle::AtomicWord>(created));
+    if (sharded_samples)
+      delete created;
+    else
+      sharded_samples = reinterpret_cast<subtle::AtomicWord>(created);
+  }
+  return reinterpret_cast<ShardedSampleVector*>(sharded_samples);
+}
+
 void Histogram::WriteAsciiImpl(bool graph_it,
                                const string& newline,
                                string* output) const {
@@ -563,8 +605,7 @@ HistogramBase* LinearHistogram::FactoryGetWithRangeDescription(
     }
 
     tentative_histogram->SetFlags(flags);
-    histogram =
-        StatisticsRecorder::RegisterOrDeleteDuplicate(tentative_histogram);
+    histogram = RegisterOrDeleteDuplicate(tentative_histogram);
   }
 
   DCHECK_EQ(LINEAR_HISTOGRAM, histogram->GetHistogramType());
@@ -668,8 +709,7 @@ HistogramBase* BooleanHistogram::FactoryGet(const string& name, int32 flags) {
         new BooleanHistogram(name, registered_ranges);
 
     tentative_histogram->SetFlags(flags);
-    histogram =
-        StatisticsRecorder::RegisterOrDeleteDuplicate(tentative_histogram);
+    histogram = RegisterOrDeleteDuplicate(tentative_histogram);
   }
 
   DCHECK_EQ(BOOLEAN_HISTOGRAM, histogram->GetHistogramType());
@@ -727,8 +767,7 @@ HistogramBase* CustomHistogram::FactoryGet(const string& name,
 
     tentative_histogram->SetFlags(flags);
 
-    histogram =
-        StatisticsRecorder::RegisterOrDeleteDuplicate(tentative_histogram);
+    histogram = RegisterOrDeleteDuplicate(tentative_histogram);
   }
 
   DCHECK_EQ(histogram->GetHistogramType(), CUSTOM_HISTOGRAM);
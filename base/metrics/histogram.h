@@ -306,7 +306,9 @@ class Lock;
 //------------------------------------------------------------------------------
 
 class BucketRanges;
+class PersistentHistogramAllocator;
 class SampleVector;
+class ShardedSampleVector;
 
 class BooleanHistogram;
 class CustomHistogram;
@@ -418,6 +420,13 @@ class BASE_EXPORT Histogram : public HistogramBase {
   // be a name (or string description) given to the bucket.
   virtual const std::string GetAsciiBucketRange(size_t it) const;
 
+  // Registers |tentative_histogram| with the StatisticsRecorder like
+  // StatisticsRecorder::RegisterOrDeleteDuplicate() does, after placing its
+  // samples in the memory of the global PersistentHistogramAllocator if
+  // there is one.
+  static HistogramBase* RegisterOrDeleteDuplicate(
+      Histogram* tentative_histogram);
+
  private:
   // Allow tests to corrupt our innards for testing purposes.
   FRIEND_TEST_ALL_PREFIXES(HistogramTest, BoundsTest);
@@ -425,7 +434,9 @@ class BASE_EXPORT Histogram : public HistogramBase {
   FRIEND_TEST_ALL_PREFIXES(HistogramTest, CorruptBucketBounds);
   FRIEND_TEST_ALL_PREFIXES(HistogramTest, CorruptSampleCounts);
   FRIEND_TEST_ALL_PREFIXES(HistogramTest, NameMatchTest);
+  FRIEND_TEST_ALL_PREFIXES(HistogramTest, ShardedRecording);
 
+  friend class PersistentHistogramAllocator;  // To place samples in its memory.
   friend class StatisticsRecorder;  // To allow it to delete duplicates.
   friend class StatisticsRecorderTest;
 
@@ -436,6 +447,9 @@ class BASE_EXPORT Histogram : public HistogramBase {
   // Implementation of SnapshotSamples function.
   scoped_ptr<SampleVector> SnapshotSampleVector() const;
 
+  // Returns |sharded_samples_|, creating it if needed.
+  ShardedSampleVector* GetShardedSamples();
+
   //----------------------------------------------------------------------------
   // Helpers for emitting Ascii graphic.  Each method appends data to output.
 
@@ -474,6 +488,10 @@ class BASE_EXPORT Histogram : public HistogramBase {
   // sample.
   scoped_ptr<SampleVector> samples_;
 
+  // The samples recorded with kShardedRecordingFlag, a ShardedSampleVector*.
+  // Created without locking by the first Add(), so it is set atomically.
+  subtle::AtomicWord sharded_samples_;
+
   DISALLOW_COPY_AND_ASSIGN(Histogram);
 };
 
@@ -540,6 +558,8 @@ class BASE_EXPORT LinearHistogram : public Histogram {
   virtual bool PrintEmptyBucket(size_t index) const OVERRIDE;
 
  private:
+  friend class PersistentHistogramAllocator;
+
   friend BASE_EXPORT_PRIVATE HistogramBase* DeserializeHistogramInfo(
       PickleIterator* iter);
   static HistogramBase* DeserializeInfoImpl(PickleIterator* iter);
@@ -565,6 +585,8 @@ class BASE_EXPORT BooleanHistogram : public LinearHistogram {
  private:
   BooleanHistogram(const std::string& name, const BucketRanges* ranges);
 
+  friend class PersistentHistogramAllocator;
+
   friend BASE_EXPORT_PRIVATE HistogramBase* DeserializeHistogramInfo(
       PickleIterator* iter);
   static HistogramBase* DeserializeInfoImpl(PickleIterator* iter);
@@ -606,6 +628,8 @@ class BASE_EXPORT CustomHistogram : public Histogram {
   virtual double GetBucketSize(Count current, size_t i) const OVERRIDE;
 
  private:
+  friend class PersistentHistogramAllocator;
+
   friend BASE_EXPORT_PRIVATE HistogramBase* DeserializeHistogramInfo(
       PickleIterator* iter);
   static HistogramBase* DeserializeInfoImpl(PickleIterator* iter);
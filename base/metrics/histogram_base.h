@@ -75,6 +75,13 @@ class BASE_EXPORT HistogramBase {
     // the source histogram!).
     kIPCSerializationSourceFlag = 0x10,
 
+    // Only for Histogram and its sub classes: records samples into per-thread
+    // shards, which snapshots merge, so that threads recording concurrently
+    // don't contend for the histogram's counters. This costs a copy of the
+    // counters per shard, so only use it for histograms recorded very often
+    // from many threads. Must be passed to FactoryGet().
+    kShardedRecordingFlag = 0x20,
+
     // Only for Histogram and its sub classes: fancy bucket-naming support.
     kHexRangePrintingFlag = 0x8000,
   };
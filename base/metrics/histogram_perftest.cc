@@ -0,0 +1,83 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <string>
+
+#include "base/memory/scoped_vector.h"
+#include "base/metrics/histogram.h"
+#include "base/strings/stringprintf.h"
+#include "base/synchronization/waitable_event.h"
+#include "base/threading/simple_thread.h"
+#include "base/time/time.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "testing/perf/perf_test.h"
+
+namespace base {
+
+namespace {
+
+const int kSamplesPerThread = 2000000;
+
+// Records kSamplesPerThread samples into |histogram| once |start| is signaled.
+class RecordRunner : public DelegateSimpleThread::Delegate {
+ public:
+  RecordRunner(HistogramBase* histogram, WaitableEvent* start)
+      : histogram_(histogram), start_(start) {}
+
+  virtual void Run() OVERRIDE {
+    start_->Wait();
+    for (int i = 0; i < kSamplesPerThread; ++i)
+      histogram_->Add(i & 63);
+  }
+
+ private:
+  HistogramBase* histogram_;
+  WaitableEvent* start_;
+};
+
+// Records from |thread_count| threads at once into a new histogram with
+// |flags|, and prints the time per sample.
+void RunRecordTest(const std::string& trace, int thread_count, int32 flags) {
+  HistogramBase* histogram = Histogram::FactoryGet(
+      StringPrintf("HistogramPerfTest.%s.%d", trace.c_str(), thread_count),
+      1, 64, 16, flags);
+  WaitableEvent start(true, false);
+  ScopedVector<RecordRunner> runners;
+  ScopedVector<DelegateSimpleThread> threads;
+  for (int i = 0; i < thread_count; ++i) {
+    runners.push_back(new RecordRunner(histogram, &start));
+    threads.push_back(new DelegateSimpleThread(runners.back(), "Recorder"));
+    threads.back()->Start();
+  }
+
+  TimeTicks begin = TimeTicks::HighResNow();
+  start.Signal();
+  for (size_t i = 0; i < threads.size(); ++i)
+    threads[i]->Join();
+  TimeDelta elapsed = TimeTicks::HighResNow() - begin;
+
+  // Wall time per sample on each thread: without contention, this stays flat
+  // as threads are added.
+  perf_test::PrintResult(
+      "histogram_add", StringPrintf("_%d_threads", thread_count), trace,
+      elapsed.InMicroseconds() * 1000.0 / kSamplesPerThread, "ns/sample",
+      true);
+
+  scoped_ptr<HistogramSamples> samples = histogram->SnapshotSamples();
+  if (flags & HistogramBase::kShardedRecordingFlag)
+    EXPECT_EQ(thread_count * kSamplesPerThread, samples->TotalCount());
+}
+
+}  // namespace
+
+TEST(HistogramPerfTest, Record) {
+  const int kThreadCounts[] = { 1, 4, 16 };
+  for (size_t i = 0; i < arraysize(kThreadCounts); ++i) {
+    RunRecordTest("shared", kThreadCounts[i], HistogramBase::kNoFlags);
+    RunRecordTest("sharded", kThreadCounts[i],
+                  HistogramBase::kShardedRecordingFlag);
+  }
+}
+
+}  // namespace base
@@ -30,7 +30,14 @@ void HistogramSnapshotManager::PrepareDeltas(
     HistogramBase::Flags required_flags) {
   StatisticsRecorder::Histograms histograms;
   StatisticsRecorder::GetHistograms(&histograms);
-  for (StatisticsRecorder::Histograms::const_iterator it = histograms.begin();
+  PrepareDeltas(histograms, flag_to_set, required_flags);
+}
+
+void HistogramSnapshotManager::PrepareDeltas(
+    const std::vector<HistogramBase*>& histograms,
+    HistogramBase::Flags flag_to_set,
+    HistogramBase::Flags required_flags) {
+  for (std::vector<HistogramBase*>::const_iterator it = histograms.begin();
        histograms.end() != it;
        ++it) {
     (*it)->SetFlags(flag_to_set);
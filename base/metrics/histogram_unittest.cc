@@ -330,6 +330,23 @@ TEST_F(HistogramTest, CorruptSampleCounts) {
             histogram->FindCorruption(*snapshot));
 }
 
+TEST_F(HistogramTest, ShardedRecording) {
+  Histogram* histogram = static_cast<Histogram*>(Histogram::FactoryGet(
+      "ShardedHistogram", 1, 64, 8, HistogramBase::kShardedRecordingFlag));
+
+  histogram->Add(20);
+  histogram->Add(40);
+  histogram->AddSamples(*histogram->SnapshotSamples());
+
+  scoped_ptr<SampleVector> snapshot = histogram->SnapshotSampleVector();
+  EXPECT_EQ(HistogramBase::NO_INCONSISTENCIES,
+            histogram->FindCorruption(*snapshot));
+  EXPECT_EQ(4, snapshot->TotalCount());
+  EXPECT_EQ(2, snapshot->GetCount(20));
+  EXPECT_EQ(2, snapshot->GetCount(40));
+  EXPECT_EQ(120, snapshot->sum());
+}
+
 TEST_F(HistogramTest, CorruptBucketBounds) {
   Histogram* histogram = static_cast<Histogram*>(
       Histogram::FactoryGet("Histogram", 1, 64, 8, HistogramBase::kNoFlags));
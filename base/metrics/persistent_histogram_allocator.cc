@@ -0,0 +1,338 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/metrics/persistent_histogram_allocator.h"
+
+#include <stddef.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include "base/logging.h"
+#include "base/metrics/bucket_ranges.h"
+#include "base/metrics/histogram.h"
+#include "base/metrics/histogram_flattener.h"
+#include "base/metrics/histogram_snapshot_manager.h"
+#include "base/metrics/sample_vector.h"
+#include "base/metrics/statistics_recorder.h"
+
+namespace base {
+
+typedef HistogramBase::Sample Sample;
+typedef PersistentMemoryAllocator::Reference Reference;
+
+namespace {
+
+// The types of the blocks a histogram is kept in. The low digit is a version
+// number, to change along with the layout of the block.
+const uint32 kTypeIdHistogram = 0xF1645911;
+const uint32 kTypeIdRangesArray = 0xBCEA2251;
+const uint32 kTypeIdCountsArray = 0x53215531;
+
+PersistentHistogramAllocator* g_allocator = NULL;
+
+// Returns the histogram registered with the StatisticsRecorder under the name
+// of |histogram|, creating it if there is none, if it has the same type and
+// bucket ranges. Returns NULL otherwise.
+HistogramBase* GetOrCreateRegisteredHistogram(const Histogram& histogram) {
+  const std::string& name = histogram.histogram_name();
+  HistogramBase* registered = StatisticsRecorder::FindHistogram(name);
+  if (!registered) {
+    switch (histogram.GetHistogramType()) {
+      case HISTOGRAM:
+        registered = Histogram::FactoryGet(
+            name, histogram.declared_min(), histogram.declared_max(),
+            histogram.bucket_count(), histogram.flags());
+        break;
+      case LINEAR_HISTOGRAM:
+        registered = LinearHistogram::FactoryGet(
+            name, histogram.declared_min(), histogram.declared_max(),
+            histogram.bucket_count(), histogram.flags());
+        break;
+      case BOOLEAN_HISTOGRAM:
+        registered = BooleanHistogram::FactoryGet(name, histogram.flags());
+        break;
+      case CUSTOM_HISTOGRAM: {
+        // The first and last ranges are always 0 and kSampleType_MAX.
+        std::vector<Sample> custom_ranges;
+        for (size_t i = 1; i < histogram.bucket_count(); ++i)
+          custom_ranges.push_back(histogram.ranges(i));
+        registered =
+            CustomHistogram::FactoryGet(name, custom_ranges, histogram.flags());
+        break;
+      }
+      default:
+        NOTREACHED();
+        return NULL;
+    }
+  }
+
+  if (!registered ||
+      registered->GetHistogramType() != histogram.GetHistogramType() ||
+      !static_cast<Histogram*>(registered)->bucket_ranges()->Equals(
+          histogram.bucket_ranges())) {
+    DLOG(ERROR) << "Histogram " << name << " does not match the registered one";
+    return NULL;
+  }
+  return registered;
+}
+
+}  // namespace
+
+// The block describing a histogram. Its bucket ranges and counts are in
+// blocks of their own.
+struct PersistentHistogramAllocator::PersistentHistogramData {
+  int32 histogram_type;
+  int32 flags;
+  int32 minimum;
+  int32 maximum;
+  uint32 bucket_count;
+  Reference ranges_ref;
+  uint32 ranges_checksum;
+  Reference counts_ref;
+  HistogramSamples::Metadata samples_metadata;
+
+  // The NUL-terminated name, allocated past the end of the struct.
+  char name[1];
+};
+
+// Adds the deltas a HistogramSnapshotManager finds to the histograms of the
+// same names registered with the StatisticsRecorder.
+class PersistentHistogramAllocator::StatisticsRecorderMerger
+    : public HistogramFlattener {
+ public:
+  StatisticsRecorderMerger() {}
+  virtual ~StatisticsRecorderMerger() {}
+
+  virtual void RecordDelta(const HistogramBase& histogram,
+                           const HistogramSamples& snapshot) OVERRIDE {
+    HistogramBase* registered = GetOrCreateRegisteredHistogram(
+        static_cast<const Histogram&>(histogram));
+    if (registered)
+      registered->AddSamples(snapshot);
+  }
+
+  // HistogramSnapshotManager leaves out inconsistent samples, which is all
+  // there is to do about them here.
+  virtual void InconsistencyDetected(
+      HistogramBase::Inconsistency problem) OVERRIDE {}
+  virtual void UniqueInconsistencyDetected(
+      HistogramBase::Inconsistency problem) OVERRIDE {}
+  virtual void InconsistencyDetectedInLoggedCount(int amount) OVERRIDE {}
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(StatisticsRecorderMerger);
+};
+
+PersistentHistogramAllocator::Iterator::Iterator(
+    PersistentHistogramAllocator* allocator)
+    : allocator_(allocator) {
+  allocator_->memory_allocator()->CreateIterator(&memory_iter_);
+}
+
+PersistentHistogramAllocator::Iterator::~Iterator() {}
+
+scoped_ptr<HistogramBase> PersistentHistogramAllocator::Iterator::GetNext() {
+  Reference ref;
+  uint32 type_id;
+  while ((ref = allocator_->memory_allocator()->GetNextIterable(
+              &memory_iter_, &type_id)) != 0) {
+    if (type_id != kTypeIdHistogram)
+      continue;
+    scoped_ptr<HistogramBase> histogram = allocator_->CreateHistogram(ref);
+    if (histogram)
+      return histogram.Pass();
+  }
+  return scoped_ptr<HistogramBase>();
+}
+
+PersistentHistogramAllocator::PersistentHistogramAllocator(
+    scoped_ptr<PersistentMemoryAllocator> memory_allocator)
+    : memory_allocator_(memory_allocator.Pass()) {}
+
+PersistentHistogramAllocator::~PersistentHistogramAllocator() {}
+
+void PersistentHistogramAllocator::MergeDeltasToStatisticsRecorder() {
+  if (!merge_iterator_) {
+    merge_iterator_.reset(new Iterator(this));
+    merge_flattener_.reset(new StatisticsRecorderMerger);
+    merge_snapshot_manager_.reset(
+        new HistogramSnapshotManager(merge_flattener_.get()));
+  }
+
+  while (true) {
+    scoped_ptr<HistogramBase> histogram = merge_iterator_->GetNext();
+    if (!histogram)
+      break;
+    merge_histograms_.push_back(histogram.release());
+  }
+  merge_snapshot_manager_->PrepareDeltas(merge_histograms_.get(),
+                                         HistogramBase::kNoFlags,
+                                         HistogramBase::kNoFlags);
+}
+
+// static
+void PersistentHistogramAllocator::SetGlobalAllocator(
+    scoped_ptr<PersistentHistogramAllocator> allocator) {
+  DCHECK(!g_allocator);
+  g_allocator = allocator.release();
+}
+
+// static
+PersistentHistogramAllocator*
+PersistentHistogramAllocator::GetGlobalAllocator() {
+  return g_allocator;
+}
+
+// static
+scoped_ptr<PersistentHistogramAllocator>
+PersistentHistogramAllocator::ReleaseGlobalAllocatorForTesting() {
+  PersistentHistogramAllocator* allocator = g_allocator;
+  g_allocator = NULL;
+  return make_scoped_ptr(allocator);
+}
+
+Reference PersistentHistogramAllocator::AllocateHistogram(
+    Histogram* histogram) {
+  // Such histograms record into per-thread shards on the heap.
+  if (histogram->flags() & HistogramBase::kShardedRecordingFlag)
+    return 0;
+  DCHECK_EQ(0, histogram->samples_->redundant_count());
+
+  const BucketRanges* bucket_ranges = histogram->bucket_ranges();
+  size_t bucket_count = bucket_ranges->bucket_count();
+  const std::string& name = histogram->histogram_name();
+  Reference ranges_ref = memory_allocator_->Allocate(
+      (bucket_count + 1) * sizeof(Sample), kTypeIdRangesArray);
+  Reference counts_ref = memory_allocator_->Allocate(
+      bucket_count * sizeof(HistogramBase::AtomicCount), kTypeIdCountsArray);
+  Reference data_ref = memory_allocator_->Allocate(
+      offsetof(PersistentHistogramData, name) + name.length() + 1,
+      kTypeIdHistogram);
+  Sample* ranges_data = memory_allocator_->GetAsArray<Sample>(
+      ranges_ref, kTypeIdRangesArray, bucket_count + 1);
+  HistogramBase::AtomicCount* counts =
+      memory_allocator_->GetAsArray<HistogramBase::AtomicCount>(
+          counts_ref, kTypeIdCountsArray, bucket_count);
+  PersistentHistogramData* data =
+      memory_allocator_->GetAsObject<PersistentHistogramData>(
+          data_ref, kTypeIdHistogram);
+  // Whatever was allocated goes unused if the memory is full.
+  if (!ranges_data || !counts || !data)
+    return 0;
+
+  for (size_t i = 0; i <= bucket_count; ++i)
+    ranges_data[i] = bucket_ranges->range(i);
+  data->histogram_type = histogram->GetHistogramType();
+  data->flags = histogram->flags();
+  data->minimum = histogram->declared_min();
+  data->maximum = histogram->declared_max();
+  data->bucket_count = static_cast<uint32>(bucket_count);
+  data->ranges_ref = ranges_ref;
+  data->ranges_checksum = bucket_ranges->checksum();
+  data->counts_ref = counts_ref;
+  memcpy(data->name, name.data(), name.length());
+
+  histogram->samples_.reset(
+      new SampleVector(bucket_ranges, counts, &data->samples_metadata));
+  return data_ref;
+}
+
+void PersistentHistogramAllocator::FinalizeHistogram(Reference ref,
+                                                     bool registered) {
+  // The memory of a histogram deleted as a duplicate stays unused.
+  if (registered)
+    memory_allocator_->MakeIterable(ref);
+}
+
+scoped_ptr<HistogramBase> PersistentHistogramAllocator::CreateHistogram(
+    Reference ref) {
+  PersistentHistogramData* data =
+      memory_allocator_->GetAsObject<PersistentHistogramData>(
+          ref, kTypeIdHistogram);
+  if (!data)
+    return scoped_ptr<HistogramBase>();
+
+  // Another process may change the data at any time, so copy it before
+  // checking it.
+  int32 histogram_type = data->histogram_type;
+  int32 flags = data->flags;
+  Sample minimum = data->minimum;
+  Sample maximum = data->maximum;
+  size_t bucket_count = data->bucket_count;
+  Reference ranges_ref = data->ranges_ref;
+  uint32 ranges_checksum = data->ranges_checksum;
+  Reference counts_ref = data->counts_ref;
+  size_t alloc_size = memory_allocator_->GetAllocSize(ref);
+  if (alloc_size < sizeof(PersistentHistogramData))
+    return scoped_ptr<HistogramBase>();
+  const char* name_end = static_cast<const char*>(memchr(
+      data->name, '\0', alloc_size - offsetof(PersistentHistogramData, name)));
+  if (!name_end)
+    return scoped_ptr<HistogramBase>();
+  std::string name(data->name, name_end - data->name);
+
+  if (bucket_count < 2 || bucket_count >= Histogram::kBucketCount_MAX)
+    return scoped_ptr<HistogramBase>();
+  const Sample* ranges_data = memory_allocator_->GetAsArray<Sample>(
+      ranges_ref, kTypeIdRangesArray, bucket_count + 1);
+  HistogramBase::AtomicCount* counts =
+      memory_allocator_->GetAsArray<HistogramBase::AtomicCount>(
+          counts_ref, kTypeIdCountsArray, bucket_count);
+  if (!ranges_data || !counts)
+    return scoped_ptr<HistogramBase>();
+
+  scoped_ptr<BucketRanges> ranges(new BucketRanges(bucket_count + 1));
+  for (size_t i = 0; i <= bucket_count; ++i)
+    ranges->set_range(i, ranges_data[i]);
+  ranges->ResetChecksum();
+  if (ranges->checksum() != ranges_checksum ||
+      ranges->range(0) != 0 ||
+      ranges->range(bucket_count) != HistogramBase::kSampleType_MAX) {
+    return scoped_ptr<HistogramBase>();
+  }
+  for (size_t i = 1; i <= bucket_count; ++i) {
+    if (ranges->range(i - 1) >= ranges->range(i))
+      return scoped_ptr<HistogramBase>();
+  }
+
+  Histogram* histogram;
+  switch (histogram_type) {
+    case HISTOGRAM:
+    case LINEAR_HISTOGRAM: {
+      Sample checked_minimum = minimum;
+      Sample checked_maximum = maximum;
+      size_t checked_bucket_count = bucket_count;
+      if (!Histogram::InspectConstructionArguments(name,
+                                                   &checked_minimum,
+                                                   &checked_maximum,
+                                                   &checked_bucket_count) ||
+          checked_minimum != minimum || checked_maximum != maximum ||
+          checked_bucket_count != bucket_count) {
+        return scoped_ptr<HistogramBase>();
+      }
+      if (histogram_type == HISTOGRAM)
+        histogram = new Histogram(name, minimum, maximum, ranges.get());
+      else
+        histogram = new LinearHistogram(name, minimum, maximum, ranges.get());
+      break;
+    }
+    case BOOLEAN_HISTOGRAM:
+      histogram = new BooleanHistogram(name, ranges.get());
+      break;
+    case CUSTOM_HISTOGRAM:
+      histogram = new CustomHistogram(name, ranges.get());
+      break;
+    default:
+      return scoped_ptr<HistogramBase>();
+  }
+  histogram->SetFlags(flags);
+  histogram->samples_.reset(
+      new SampleVector(ranges.get(), counts, &data->samples_metadata));
+  ranges_.push_back(ranges.release());
+  return scoped_ptr<HistogramBase>(histogram);
+}
+
+}  // namespace base
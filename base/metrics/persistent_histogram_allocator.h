@@ -0,0 +1,125 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef BASE_METRICS_PERSISTENT_HISTOGRAM_ALLOCATOR_H_
+#define BASE_METRICS_PERSISTENT_HISTOGRAM_ALLOCATOR_H_
+
+#include "base/base_export.h"
+#include "base/basictypes.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/memory/scoped_vector.h"
+#include "base/metrics/persistent_memory_allocator.h"
+
+namespace base {
+
+class BucketRanges;
+class Histogram;
+class HistogramBase;
+class HistogramSnapshotManager;
+
+// PersistentHistogramAllocator keeps histograms in the memory of a
+// PersistentMemoryAllocator: their type, construction arguments, bucket
+// ranges, counts and sum. The histograms record straight into that memory,
+// so that a process sharing it, or reading it after the one that recorded
+// them crashed, can get them back without any serialization.
+//
+// A process places its histograms in persistent memory by setting a global
+// allocator before creating them, such as one over shared memory it has
+// given to the browser process. The browser then merges what they recorded
+// into its own histograms with MergeDeltasToStatisticsRecorder(), in place of
+// receiving them through HistogramDeltaSerialization.
+//
+// Only Histogram and its subclasses are supported; SparseHistograms, and
+// histograms created with HistogramBase::kShardedRecordingFlag, stay on the
+// heap.
+class BASE_EXPORT PersistentHistogramAllocator {
+ public:
+  // Iterates the histograms in the memory of an allocator, in the order they
+  // were created. Calling GetNext() again after it returned NULL returns
+  // those created in the meantime.
+  class BASE_EXPORT Iterator {
+   public:
+    explicit Iterator(PersistentHistogramAllocator* allocator);
+    ~Iterator();
+
+    // Returns the next histogram, or NULL if there are no more. Histograms
+    // whose data is inconsistent are skipped. The returned histogram records
+    // into and reads from the allocator's memory and must not outlive the
+    // allocator. It is not registered with the StatisticsRecorder.
+    scoped_ptr<HistogramBase> GetNext();
+
+   private:
+    PersistentHistogramAllocator* const allocator_;
+    PersistentMemoryAllocator::Iterator memory_iter_;
+
+    DISALLOW_COPY_AND_ASSIGN(Iterator);
+  };
+
+  explicit PersistentHistogramAllocator(
+      scoped_ptr<PersistentMemoryAllocator> memory_allocator);
+  ~PersistentHistogramAllocator();
+
+  PersistentMemoryAllocator* memory_allocator() {
+    return memory_allocator_.get();
+  }
+
+  // Adds the samples the histograms in this allocator's memory recorded since
+  // the previous call to the histograms of the same names registered with the
+  // StatisticsRecorder, creating those where needed. This is how a process
+  // collects the histograms another one records into shared memory.
+  void MergeDeltasToStatisticsRecorder();
+
+  // Sets the allocator that Histogram, LinearHistogram, BooleanHistogram and
+  // CustomHistogram place the histograms they create from then on in. It is
+  // leaked, as the histograms using it are.
+  static void SetGlobalAllocator(
+      scoped_ptr<PersistentHistogramAllocator> allocator);
+
+  // Returns the global allocator, or NULL if there is none.
+  static PersistentHistogramAllocator* GetGlobalAllocator();
+
+  // Unsets and returns the global allocator. Histograms created in it must
+  // not be used after it is deleted.
+  static scoped_ptr<PersistentHistogramAllocator>
+      ReleaseGlobalAllocatorForTesting();
+
+ private:
+  friend class Histogram;
+
+  class StatisticsRecorderMerger;
+  struct PersistentHistogramData;
+
+  // Places the bucket ranges and samples of |histogram|, which has not
+  // recorded anything yet, in persistent memory. Returns the reference to
+  // its data, or 0 if it stays on the heap.
+  PersistentMemoryAllocator::Reference AllocateHistogram(Histogram* histogram);
+
+  // Makes the histogram at |ref| visible to iterators if it was |registered|
+  // with the StatisticsRecorder rather than deleted as a duplicate.
+  void FinalizeHistogram(PersistentMemoryAllocator::Reference ref,
+                         bool registered);
+
+  // Creates the histogram described at |ref|, or returns NULL if that isn't
+  // consistent.
+  scoped_ptr<HistogramBase> CreateHistogram(
+      PersistentMemoryAllocator::Reference ref);
+
+  scoped_ptr<PersistentMemoryAllocator> memory_allocator_;
+
+  // The bucket ranges of the histograms CreateHistogram() returned.
+  ScopedVector<BucketRanges> ranges_;
+
+  // The state of MergeDeltasToStatisticsRecorder(). The snapshot manager
+  // keeps the samples merged so far.
+  scoped_ptr<Iterator> merge_iterator_;
+  ScopedVector<HistogramBase> merge_histograms_;
+  scoped_ptr<StatisticsRecorderMerger> merge_flattener_;
+  scoped_ptr<HistogramSnapshotManager> merge_snapshot_manager_;
+
+  DISALLOW_COPY_AND_ASSIGN(PersistentHistogramAllocator);
+};
+
+}  // namespace base
+
+#endif  // BASE_METRICS_PERSISTENT_HISTOGRAM_ALLOCATOR_H_
@@ -0,0 +1,196 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/metrics/persistent_histogram_allocator.h"
+
+#include <vector>
+
+#include "base/memory/scoped_ptr.h"
+#include "base/metrics/histogram.h"
+#include "base/metrics/histogram_samples.h"
+#include "base/metrics/persistent_memory_allocator.h"
+#include "base/metrics/statistics_recorder.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace base {
+
+namespace {
+
+const size_t kTestMemorySize = 64 << 10;
+
+}  // namespace
+
+class PersistentHistogramAllocatorTest : public testing::Test {
+ protected:
+  virtual void SetUp() {
+    statistics_recorder_ = new StatisticsRecorder();
+    memory_allocator_ =
+        new LocalPersistentMemoryAllocator(kTestMemorySize, 0, "Test");
+    PersistentHistogramAllocator::SetGlobalAllocator(
+        make_scoped_ptr(new PersistentHistogramAllocator(
+            make_scoped_ptr(memory_allocator_))));
+  }
+
+  virtual void TearDown() {
+    // The histograms are leaked with the StatisticsRecorder, and must not be
+    // used once the memory holding their samples is gone.
+    delete statistics_recorder_;
+    PersistentHistogramAllocator::ReleaseGlobalAllocatorForTesting();
+  }
+
+  void ResetStatisticsRecorder() {
+    delete statistics_recorder_;
+    statistics_recorder_ = new StatisticsRecorder();
+  }
+
+  // Returns an allocator over the memory of the global one, as another
+  // process mapping it would have.
+  scoped_ptr<PersistentHistogramAllocator> CreateReader() {
+    return make_scoped_ptr(new PersistentHistogramAllocator(
+        make_scoped_ptr(new PersistentMemoryAllocator(
+            const_cast<void*>(memory_allocator_->data()),
+            memory_allocator_->size(), 0, "", true))));
+  }
+
+  StatisticsRecorder* statistics_recorder_;
+  PersistentMemoryAllocator* memory_allocator_;
+};
+
+TEST_F(PersistentHistogramAllocatorTest, CreateAndIterate) {
+  HistogramBase* histogram = Histogram::FactoryGet(
+      "TestHistogram", 1, 1000, 10, HistogramBase::kNoFlags);
+  ASSERT_TRUE(histogram);
+  histogram->Add(5);
+  histogram->Add(500);
+  size_t used = memory_allocator_->used();
+  EXPECT_EQ(histogram, Histogram::FactoryGet(
+      "TestHistogram", 1, 1000, 10, HistogramBase::kNoFlags));
+  EXPECT_EQ(used, memory_allocator_->used());
+
+  HistogramBase* linear_histogram = LinearHistogram::FactoryGet(
+      "TestLinearHistogram", 1, 100, 10, HistogramBase::kNoFlags);
+  linear_histogram->Add(50);
+  HistogramBase* boolean_histogram = BooleanHistogram::FactoryGet(
+      "TestBooleanHistogram", HistogramBase::kNoFlags);
+  boolean_histogram->AddBoolean(true);
+  std::vector<HistogramBase::Sample> custom_ranges;
+  custom_ranges.push_back(1);
+  custom_ranges.push_back(5);
+  HistogramBase* custom_histogram = CustomHistogram::FactoryGet(
+      "TestCustomHistogram", custom_ranges, HistogramBase::kNoFlags);
+  custom_histogram->Add(3);
+  EXPECT_LT(used, memory_allocator_->used());
+
+  scoped_ptr<PersistentHistogramAllocator> reader = CreateReader();
+  PersistentHistogramAllocator::Iterator iter(reader.get());
+
+  scoped_ptr<HistogramBase> found = iter.GetNext();
+  ASSERT_TRUE(found);
+  EXPECT_EQ("TestHistogram", found->histogram_name());
+  EXPECT_EQ(HISTOGRAM, found->GetHistogramType());
+  EXPECT_TRUE(found->HasConstructionArguments(1, 1000, 10));
+  scoped_ptr<HistogramSamples> samples = found->SnapshotSamples();
+  EXPECT_EQ(2, samples->TotalCount());
+  EXPECT_EQ(1, samples->GetCount(5));
+  EXPECT_EQ(505, samples->sum());
+  // Both record into the same memory.
+  histogram->Add(5);
+  EXPECT_EQ(2, found->SnapshotSamples()->GetCount(5));
+
+  found = iter.GetNext();
+  ASSERT_TRUE(found);
+  EXPECT_EQ("TestLinearHistogram", found->histogram_name());
+  EXPECT_EQ(LINEAR_HISTOGRAM, found->GetHistogramType());
+  EXPECT_EQ(1, found->SnapshotSamples()->GetCount(50));
+
+  found = iter.GetNext();
+  ASSERT_TRUE(found);
+  EXPECT_EQ("TestBooleanHistogram", found->histogram_name());
+  EXPECT_EQ(BOOLEAN_HISTOGRAM, found->GetHistogramType());
+  EXPECT_EQ(1, found->SnapshotSamples()->GetCount(1));
+
+  found = iter.GetNext();
+  ASSERT_TRUE(found);
+  EXPECT_EQ("TestCustomHistogram", found->histogram_name());
+  EXPECT_EQ(CUSTOM_HISTOGRAM, found->GetHistogramType());
+  EXPECT_TRUE(static_cast<Histogram*>(custom_histogram)->bucket_ranges()->
+      Equals(static_cast<Histogram*>(found.get())->bucket_ranges()));
+  EXPECT_EQ(1, found->SnapshotSamples()->GetCount(3));
+
+  EXPECT_FALSE(iter.GetNext());
+
+  // Histograms created later are found too.
+  Histogram::FactoryGet("TestLaterHistogram", 1, 1000, 10,
+                        HistogramBase::kNoFlags);
+  found = iter.GetNext();
+  ASSERT_TRUE(found);
+  EXPECT_EQ("TestLaterHistogram", found->histogram_name());
+  EXPECT_FALSE(iter.GetNext());
+}
+
+TEST_F(PersistentHistogramAllocatorTest, ShardedStaysOnHeap) {
+  size_t used = memory_allocator_->used();
+  HistogramBase* histogram = Histogram::FactoryGet(
+      "TestShardedHistogram", 1, 1000, 10,
+      HistogramBase::kShardedRecordingFlag);
+  histogram->Add(5);
+  EXPECT_EQ(used, memory_allocator_->used());
+  EXPECT_EQ(1, histogram->SnapshotSamples()->GetCount(5));
+
+  scoped_ptr<PersistentHistogramAllocator> reader = CreateReader();
+  PersistentHistogramAllocator::Iterator iter(reader.get());
+  EXPECT_FALSE(iter.GetNext());
+}
+
+TEST_F(PersistentHistogramAllocatorTest, MergeDeltasToStatisticsRecorder) {
+  HistogramBase* histogram = LinearHistogram::FactoryGet(
+      "TestLinearHistogram", 1, 100, 10, HistogramBase::kNoFlags);
+  histogram->Add(20);
+  histogram->Add(50);
+
+  // As seen by the browser process, whose histograms are its own.
+  scoped_ptr<PersistentHistogramAllocator> allocator =
+      PersistentHistogramAllocator::ReleaseGlobalAllocatorForTesting();
+  ResetStatisticsRecorder();
+  allocator->MergeDeltasToStatisticsRecorder();
+
+  HistogramBase* merged =
+      StatisticsRecorder::FindHistogram("TestLinearHistogram");
+  ASSERT_TRUE(merged);
+  EXPECT_NE(histogram, merged);
+  EXPECT_EQ(LINEAR_HISTOGRAM, merged->GetHistogramType());
+  scoped_ptr<HistogramSamples> samples = merged->SnapshotSamples();
+  EXPECT_EQ(2, samples->TotalCount());
+  EXPECT_EQ(1, samples->GetCount(20));
+  EXPECT_EQ(70, samples->sum());
+
+  // Only what was recorded since is merged the next time.
+  allocator->MergeDeltasToStatisticsRecorder();
+  EXPECT_EQ(2, merged->SnapshotSamples()->TotalCount());
+  histogram->Add(20);
+  allocator->MergeDeltasToStatisticsRecorder();
+  samples = merged->SnapshotSamples();
+  EXPECT_EQ(3, samples->TotalCount());
+  EXPECT_EQ(2, samples->GetCount(20));
+  EXPECT_EQ(90, samples->sum());
+
+  PersistentHistogramAllocator::SetGlobalAllocator(allocator.Pass());
+}
+
+TEST_F(PersistentHistogramAllocatorTest, MergeMismatchedHistogram) {
+  Histogram::FactoryGet("TestHistogram", 1, 1000, 10, HistogramBase::kNoFlags)
+      ->Add(5);
+
+  scoped_ptr<PersistentHistogramAllocator> allocator =
+      PersistentHistogramAllocator::ReleaseGlobalAllocatorForTesting();
+  ResetStatisticsRecorder();
+  HistogramBase* registered = Histogram::FactoryGet(
+      "TestHistogram", 1, 100, 10, HistogramBase::kNoFlags);
+  allocator->MergeDeltasToStatisticsRecorder();
+  EXPECT_EQ(0, registered->SnapshotSamples()->TotalCount());
+
+  PersistentHistogramAllocator::SetGlobalAllocator(allocator.Pass());
+}
+
+}  // namespace base
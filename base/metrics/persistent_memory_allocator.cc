@@ -0,0 +1,422 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/metrics/persistent_memory_allocator.h"
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include "base/files/memory_mapped_file.h"
+#include "base/logging.h"
+#include "base/memory/shared_memory.h"
+
+namespace base {
+
+namespace {
+
+// Marks a segment as set up, and for this version of the layout below.
+const uint32 kGlobalCookie = 0x408305DC;
+const uint32 kGlobalVersion = 1;
+
+// Marks a block header as written by Allocate().
+const uint32 kBlockCookieAllocated = 0xC8799269;
+// Marks the head of the iterable queue.
+const uint32 kBlockCookieQueue = 1;
+
+// The type of the block holding the name of the segment.
+const uint32 kTypeIdSegmentName = 0x4E414D45;
+
+// Bits of SharedMetadata::flags.
+const subtle::Atomic32 kFlagCorrupt = 1 << 0;
+const subtle::Atomic32 kFlagFull = 1 << 1;
+
+void SetFlag(subtle::Atomic32* flags, subtle::Atomic32 flag) {
+  subtle::Atomic32 old_flags = subtle::NoBarrier_Load(flags);
+  while (!(old_flags & flag)) {
+    subtle::Atomic32 existing =
+        subtle::NoBarrier_CompareAndSwap(flags, old_flags, old_flags | flag);
+    if (existing == old_flags)
+      break;
+    old_flags = existing;
+  }
+}
+
+}  // namespace
+
+// static
+const size_t PersistentMemoryAllocator::kSegmentMinSize = 1 << 10;
+// static
+const size_t PersistentMemoryAllocator::kSegmentMaxSize = 1 << 30;
+// static
+const size_t PersistentMemoryAllocator::kAllocAlignment = 8;
+
+// Starts every block. All fields are written by Allocate() before the block
+// is handed out, except |next|, which links iterable blocks.
+struct PersistentMemoryAllocator::BlockHeader {
+  uint32 size;  // Of the whole block, including this header.
+  uint32 cookie;
+  uint32 type_id;
+  subtle::Atomic32 next;  // 0 until the block is made iterable.
+};
+
+// Starts the segment.
+struct PersistentMemoryAllocator::SharedMetadata {
+  subtle::Atomic32 cookie;  // Written last when setting up the segment.
+  uint32 size;
+  uint32 version;
+  Reference name;
+  uint64 id;
+  subtle::Atomic32 freeptr;  // Where the next block goes.
+  subtle::Atomic32 flags;
+  subtle::Atomic32 tailptr;  // The last block in the iterable queue.
+  uint32 padding;
+
+  // The head of the iterable queue, a singly linked list of blocks which the
+  // last one closes by pointing back here.
+  BlockHeader queue;
+};
+
+// static
+const PersistentMemoryAllocator::Reference
+    PersistentMemoryAllocator::kReferenceQueue =
+        offsetof(SharedMetadata, queue);
+
+PersistentMemoryAllocator::PersistentMemoryAllocator(void* base,
+                                                     size_t size,
+                                                     uint64 id,
+                                                     const std::string& name,
+                                                     bool read_only)
+    : mem_base_(static_cast<char*>(base)),
+      mem_size_(size),
+      read_only_(read_only),
+      corrupt_(0) {
+  COMPILE_ASSERT(sizeof(BlockHeader) % 8 == 0, block_header_not_aligned);
+  COMPILE_ASSERT(sizeof(SharedMetadata) % 8 == 0, shared_metadata_not_aligned);
+  CHECK(IsMemoryAcceptable(base, size));
+
+  SharedMetadata* meta = shared_meta();
+  if (subtle::Acquire_Load(&meta->cookie) !=
+      static_cast<subtle::Atomic32>(kGlobalCookie)) {
+    // There is no segment yet; set one up, if the memory is as blank as it
+    // has to be for that.
+    if (read_only_ || meta->size != 0 || meta->version != 0 ||
+        subtle::NoBarrier_Load(&meta->freeptr) != 0 ||
+        subtle::NoBarrier_Load(&meta->tailptr) != 0) {
+      SetCorrupt();
+      return;
+    }
+    meta->size = static_cast<uint32>(mem_size_);
+    meta->version = kGlobalVersion;
+    meta->id = id;
+    meta->queue.cookie = kBlockCookieQueue;
+    subtle::NoBarrier_Store(&meta->queue.next, kReferenceQueue);
+    subtle::NoBarrier_Store(&meta->tailptr, kReferenceQueue);
+    subtle::NoBarrier_Store(&meta->freeptr, sizeof(SharedMetadata));
+    if (!name.empty()) {
+      Reference name_ref = Allocate(name.length() + 1, kTypeIdSegmentName);
+      char* name_cstr =
+          GetAsArray<char>(name_ref, kTypeIdSegmentName, name.length() + 1);
+      if (name_cstr) {
+        memcpy(name_cstr, name.data(), name.length());
+        meta->name = name_ref;
+      }
+    }
+    subtle::Release_Store(&meta->cookie, kGlobalCookie);
+    return;
+  }
+
+  // Use the existing segment, after checking it is one that can be used.
+  uint32 freeptr = subtle::NoBarrier_Load(&meta->freeptr);
+  if (meta->version != kGlobalVersion || meta->size > mem_size_ ||
+      meta->size < kSegmentMinSize || meta->size % kAllocAlignment != 0 ||
+      freeptr < sizeof(SharedMetadata) || freeptr > meta->size) {
+    SetCorrupt();
+    return;
+  }
+  mem_size_ = meta->size;
+}
+
+PersistentMemoryAllocator::~PersistentMemoryAllocator() {}
+
+// static
+bool PersistentMemoryAllocator::IsMemoryAcceptable(const void* base,
+                                                   size_t size) {
+  return base && reinterpret_cast<uintptr_t>(base) % kAllocAlignment == 0 &&
+         size >= kSegmentMinSize && size <= kSegmentMaxSize &&
+         size % kAllocAlignment == 0;
+}
+
+uint64 PersistentMemoryAllocator::Id() const {
+  return shared_meta()->id;
+}
+
+const char* PersistentMemoryAllocator::Name() const {
+  Reference name_ref = shared_meta()->name;
+  const char* name_cstr = GetAsObject<char>(name_ref, kTypeIdSegmentName);
+  size_t name_length = GetAllocSize(name_ref);
+  if (!name_cstr || !name_length)
+    return "";
+  if (name_cstr[name_length - 1] != '\0') {
+    SetCorrupt();
+    return "";
+  }
+  return name_cstr;
+}
+
+bool PersistentMemoryAllocator::IsCorrupt() const {
+  return subtle::NoBarrier_Load(&corrupt_) ||
+         (subtle::NoBarrier_Load(&shared_meta()->flags) & kFlagCorrupt);
+}
+
+bool PersistentMemoryAllocator::IsFull() const {
+  return (subtle::NoBarrier_Load(&shared_meta()->flags) & kFlagFull) != 0;
+}
+
+size_t PersistentMemoryAllocator::used() const {
+  return std::min(
+      static_cast<size_t>(subtle::NoBarrier_Load(&shared_meta()->freeptr)),
+      mem_size_);
+}
+
+uint32 PersistentMemoryAllocator::GetType(Reference ref) const {
+  const BlockHeader* block = GetBlock(ref, 0, 0, false);
+  return block ? block->type_id : 0;
+}
+
+size_t PersistentMemoryAllocator::GetAllocSize(Reference ref) const {
+  const BlockHeader* block = GetBlock(ref, 0, 0, false);
+  if (!block)
+    return 0;
+  // Read the size once, as another process may change it at any time.
+  uint32 size = block->size;
+  if (size <= sizeof(BlockHeader) || size > mem_size_ - ref)
+    return 0;
+  return size - sizeof(BlockHeader);
+}
+
+PersistentMemoryAllocator::Reference PersistentMemoryAllocator::Allocate(
+    size_t req_size,
+    uint32 type_id) {
+  DCHECK_NE(0u, type_id);
+  DCHECK(!read_only_);
+  if (read_only_ || IsCorrupt())
+    return 0;
+  if (req_size > kSegmentMaxSize - sizeof(BlockHeader))
+    return 0;
+  uint32 size = static_cast<uint32>(
+      (req_size + sizeof(BlockHeader) + kAllocAlignment - 1) &
+      ~(kAllocAlignment - 1));
+
+  SharedMetadata* meta = shared_meta();
+  uint32 freeptr = subtle::NoBarrier_Load(&meta->freeptr);
+  while (true) {
+    if (freeptr < sizeof(SharedMetadata) || freeptr > mem_size_ ||
+        freeptr % kAllocAlignment != 0) {
+      SetCorrupt();
+      return 0;
+    }
+    if (size > mem_size_ - freeptr) {
+      SetFlag(&meta->flags, kFlagFull);
+      return 0;
+    }
+    uint32 existing = subtle::NoBarrier_CompareAndSwap(
+        &meta->freeptr, freeptr, freeptr + size);
+    if (existing == freeptr)
+      break;
+    freeptr = existing;
+  }
+
+  // Nothing should have written past the free pointer.
+  BlockHeader* block = reinterpret_cast<BlockHeader*>(mem_base_ + freeptr);
+  if (block->size != 0 || block->cookie != 0 || block->type_id != 0 ||
+      subtle::NoBarrier_Load(&block->next) != 0) {
+    SetCorrupt();
+    return 0;
+  }
+  block->size = size;
+  block->type_id = type_id;
+  block->cookie = kBlockCookieAllocated;
+  return freeptr;
+}
+
+void PersistentMemoryAllocator::MakeIterable(Reference ref) {
+  DCHECK(!read_only_);
+  if (read_only_)
+    return;
+  BlockHeader* block = GetBlock(ref, 0, 0, false);
+  if (!block)
+    return;
+  if (subtle::NoBarrier_CompareAndSwap(&block->next, 0, kReferenceQueue) !=
+      0) {
+    NOTREACHED() << "Block " << ref << " is iterable already";
+    return;
+  }
+
+  // Link the block after the tail of the queue, then move the tail to it. A
+  // thread that finds the tail was linked to but not moved yet moves it along
+  // for the one that linked it, so that no thread waits on another.
+  SharedMetadata* meta = shared_meta();
+  const size_t max_tries = mem_size_ / sizeof(BlockHeader);
+  for (size_t tries = 0; tries < max_tries; ++tries) {
+    Reference tail = subtle::Acquire_Load(&meta->tailptr);
+    BlockHeader* tail_block = GetBlock(tail, 0, 0, true);
+    if (!tail_block)
+      break;
+    // The release makes what was written to the block visible to whoever
+    // reaches it through the queue.
+    Reference next = subtle::Release_CompareAndSwap(
+        &tail_block->next, kReferenceQueue, ref);
+    if (next == kReferenceQueue) {
+      subtle::Release_CompareAndSwap(&meta->tailptr, tail, ref);
+      return;
+    }
+    subtle::Release_CompareAndSwap(&meta->tailptr, tail, next);
+  }
+  SetCorrupt();
+}
+
+void PersistentMemoryAllocator::CreateIterator(Iterator* state) const {
+  state->last = kReferenceQueue;
+  state->count = 0;
+}
+
+PersistentMemoryAllocator::Reference PersistentMemoryAllocator::GetNextIterable(
+    Iterator* state,
+    uint32* type_id) const {
+  const BlockHeader* block = GetBlock(state->last, 0, 0, true);
+  if (!block)
+    return 0;
+  Reference next = subtle::Acquire_Load(&block->next);
+  if (next == kReferenceQueue)
+    return 0;
+
+  // Every block in the queue points on, and there can't be more of them
+  // than fit in the segment; anything else means the queue was damaged.
+  block = GetBlock(next, 0, 0, false);
+  if (!block || ++state->count > mem_size_ / sizeof(BlockHeader)) {
+    SetCorrupt();
+    return 0;
+  }
+  state->last = next;
+  *type_id = block->type_id;
+  return next;
+}
+
+PersistentMemoryAllocator::SharedMetadata*
+PersistentMemoryAllocator::shared_meta() const {
+  return reinterpret_cast<SharedMetadata*>(mem_base_);
+}
+
+PersistentMemoryAllocator::BlockHeader* PersistentMemoryAllocator::GetBlock(
+    Reference ref,
+    uint32 type_id,
+    size_t size,
+    bool queue_ok) const {
+  if (IsCorrupt())
+    return NULL;
+  if (ref == kReferenceQueue && queue_ok)
+    return &shared_meta()->queue;
+  if (ref < sizeof(SharedMetadata) || ref % kAllocAlignment != 0)
+    return NULL;
+  if (ref >= static_cast<uint32>(
+                 subtle::NoBarrier_Load(&shared_meta()->freeptr)) ||
+      size > mem_size_ - sizeof(BlockHeader) ||
+      ref > mem_size_ - sizeof(BlockHeader) - size) {
+    return NULL;
+  }
+
+  BlockHeader* block = reinterpret_cast<BlockHeader*>(mem_base_ + ref);
+  if (block->cookie != kBlockCookieAllocated)
+    return NULL;
+  uint32 block_size = block->size;
+  if (block_size < sizeof(BlockHeader) + size)
+    return NULL;
+  if (block_size > mem_size_ - ref) {
+    SetCorrupt();
+    return NULL;
+  }
+  if (type_id != 0 && block->type_id != type_id)
+    return NULL;
+  return block;
+}
+
+void* PersistentMemoryAllocator::GetBlockData(Reference ref,
+                                              uint32 type_id,
+                                              size_t size) const {
+  BlockHeader* block = GetBlock(ref, type_id, size, false);
+  if (!block)
+    return NULL;
+  return reinterpret_cast<char*>(block) + sizeof(BlockHeader);
+}
+
+void PersistentMemoryAllocator::SetCorrupt() const {
+  DLOG(ERROR) << "Persistent memory segment is corrupt";
+  subtle::NoBarrier_Store(&corrupt_, 1);
+  if (!read_only_)
+    SetFlag(&shared_meta()->flags, kFlagCorrupt);
+}
+
+//----------------------------------------------------------------------------
+// LocalPersistentMemoryAllocator
+//----------------------------------------------------------------------------
+
+LocalPersistentMemoryAllocator::LocalPersistentMemoryAllocator(
+    size_t size,
+    uint64 id,
+    const std::string& name)
+    : PersistentMemoryAllocator(calloc(size, 1), size, id, name, false) {}
+
+LocalPersistentMemoryAllocator::~LocalPersistentMemoryAllocator() {
+  free(mem_base_);
+}
+
+//----------------------------------------------------------------------------
+// SharedPersistentMemoryAllocator
+//----------------------------------------------------------------------------
+
+SharedPersistentMemoryAllocator::SharedPersistentMemoryAllocator(
+    scoped_ptr<SharedMemory> memory,
+    uint64 id,
+    const std::string& name,
+    bool read_only)
+    : PersistentMemoryAllocator(memory->memory(),
+                                memory->mapped_size(),
+                                id,
+                                name,
+                                read_only),
+      shared_memory_(memory.Pass()) {}
+
+SharedPersistentMemoryAllocator::~SharedPersistentMemoryAllocator() {}
+
+// static
+bool SharedPersistentMemoryAllocator::IsSharedMemoryAcceptable(
+    const SharedMemory& memory) {
+  return IsMemoryAcceptable(memory.memory(), memory.mapped_size());
+}
+
+//----------------------------------------------------------------------------
+// FilePersistentMemoryAllocator
+//----------------------------------------------------------------------------
+
+FilePersistentMemoryAllocator::FilePersistentMemoryAllocator(
+    scoped_ptr<MemoryMappedFile> file)
+    : PersistentMemoryAllocator(const_cast<uint8*>(file->data()),
+                                file->length(),
+                                0,
+                                std::string(),
+                                true),
+      mapped_file_(file.Pass()) {}
+
+FilePersistentMemoryAllocator::~FilePersistentMemoryAllocator() {}
+
+// static
+bool FilePersistentMemoryAllocator::IsFileAcceptable(
+    const MemoryMappedFile& file) {
+  return IsMemoryAcceptable(file.data(), file.length());
+}
+
+}  // namespace base
@@ -0,0 +1,233 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef BASE_METRICS_PERSISTENT_MEMORY_ALLOCATOR_H_
+#define BASE_METRICS_PERSISTENT_MEMORY_ALLOCATOR_H_
+
+#include <string>
+
+#include "base/atomicops.h"
+#include "base/base_export.h"
+#include "base/basictypes.h"
+#include "base/memory/scoped_ptr.h"
+
+namespace base {
+
+class MemoryMappedFile;
+class SharedMemory;
+
+// PersistentMemoryAllocator hands out blocks of one segment of memory that
+// another process can map too, or that outlives the process, like a file or
+// named shared memory. Everything it keeps, including its own state, is
+// inside the segment, so whoever maps it next can find what was stored. This
+// is what lets one process read the histograms of another without having them
+// serialized, or read those of a process that crashed.
+//
+// Since the segment may be mapped at a different address in every process,
+// blocks are identified by References: their offset from the start of the
+// segment. Blocks can't be freed. Allocate() and MakeIterable() take no
+// locks and may be called from several threads or processes at once.
+//
+// Nothing in the segment can be trusted by a process that didn't write it.
+// All accessors check References and block headers before returning a
+// pointer, and anything found inconsistent marks the allocator corrupt, after
+// which it returns nothing more. What is inside a block is for its user to
+// validate.
+//
+// Example:
+//   PersistentMemoryAllocator::Reference ref =
+//       allocator->Allocate(sizeof(MyRecord), kTypeIdMyRecord);
+//   MyRecord* record =
+//       allocator->GetAsObject<MyRecord>(ref, kTypeIdMyRecord);
+//   if (record) {
+//     ... fill |record| ...
+//     allocator->MakeIterable(ref);  // Now other readers may find it.
+//   }
+class BASE_EXPORT PersistentMemoryAllocator {
+ public:
+  typedef uint32 Reference;
+
+  // The state of an iteration over the iterable blocks. Set up with
+  // CreateIterator().
+  struct Iterator {
+    Reference last;
+    uint32 count;
+  };
+
+  // The bounds on the size of a segment, which must also be a multiple of
+  // kAllocAlignment and start on such a boundary.
+  static const size_t kSegmentMinSize;
+  static const size_t kSegmentMaxSize;
+  static const size_t kAllocAlignment;
+
+  // Uses the |size| bytes at |base| for allocations. If they hold a segment
+  // already, that one is used as is; otherwise they must be zeroed, and a new
+  // segment identified by |id| and |name| is set up in them. A |read_only|
+  // allocator only reads an existing segment. |base| must stay mapped for
+  // the lifetime of this object.
+  PersistentMemoryAllocator(void* base,
+                            size_t size,
+                            uint64 id,
+                            const std::string& name,
+                            bool read_only);
+  virtual ~PersistentMemoryAllocator();
+
+  // Returns whether |base| and |size| meet the requirements on a segment.
+  static bool IsMemoryAcceptable(const void* base, size_t size);
+
+  uint64 Id() const;
+  const char* Name() const;
+
+  bool IsReadonly() const { return read_only_; }
+
+  // Whether an inconsistency was found in the segment. Allocation, access
+  // and iteration all fail once this is set.
+  bool IsCorrupt() const;
+
+  // Whether an allocation failed for lack of space.
+  bool IsFull() const;
+
+  // The number of bytes of the segment in use, which is what a copy of it
+  // has to hold.
+  size_t used() const;
+  size_t size() const { return mem_size_; }
+
+  // The start of the segment, for saving a copy of its first used() bytes.
+  const void* data() const { return mem_base_; }
+
+  // Returns the object of type T in the block at |ref|, or NULL if that isn't
+  // a block of |type_id| with room for a T. Other processes may change the
+  // object at any time; don't trust what is read from it.
+  template <typename T>
+  T* GetAsObject(Reference ref, uint32 type_id) const {
+    return static_cast<T*>(GetBlockData(ref, type_id, sizeof(T)));
+  }
+
+  // Like GetAsObject(), for an array of |count| T's.
+  template <typename T>
+  T* GetAsArray(Reference ref, uint32 type_id, size_t count) const {
+    if (count > kSegmentMaxSize / sizeof(T))
+      return NULL;
+    return static_cast<T*>(GetBlockData(ref, type_id, count * sizeof(T)));
+  }
+
+  // Returns the type of the block at |ref|, or 0 if there is no block there.
+  uint32 GetType(Reference ref) const;
+
+  // Returns the usable size of the block at |ref|, which may exceed the size
+  // it was allocated with, or 0 if there is no block there.
+  size_t GetAllocSize(Reference ref) const;
+
+  // Allocates a block of |size| zeroed bytes tagged with |type_id|, which
+  // must not be 0. Returns its Reference, or 0 if the segment is full,
+  // corrupt or read-only.
+  Reference Allocate(size_t size, uint32 type_id);
+
+  // Makes the block at |ref| visible to iterators. Call this once the block
+  // holds everything a reader needs, and only once per block; this also
+  // publishes what was written to it so far to readers that find it by
+  // iterating.
+  void MakeIterable(Reference ref);
+
+  // Starts |state| at the first iterable block.
+  void CreateIterator(Iterator* state) const;
+
+  // Returns the next iterable block and sets |type_id| to its type, or
+  // returns 0 when there are no more. Blocks made iterable later are found
+  // by calling this again with the same |state|.
+  Reference GetNextIterable(Iterator* state, uint32* type_id) const;
+
+ protected:
+  char* const mem_base_;
+  size_t mem_size_;
+
+ private:
+  struct BlockHeader;
+  struct SharedMetadata;
+
+  // The head of the iterable queue, inside the SharedMetadata.
+  static const Reference kReferenceQueue;
+
+  SharedMetadata* shared_meta() const;
+
+  // Returns the header of the block at |ref| if it's a valid block of
+  // |type_id|, or of any type if that's 0, with at least |size| bytes of
+  // data. |queue_ok| allows the head of the iterable queue, which is not an
+  // allocated block.
+  BlockHeader* GetBlock(Reference ref,
+                        uint32 type_id,
+                        size_t size,
+                        bool queue_ok) const;
+
+  void* GetBlockData(Reference ref, uint32 type_id, size_t size) const;
+
+  void SetCorrupt() const;
+
+  const bool read_only_;
+
+  // Also set when the segment can't be marked corrupt, because it's
+  // read-only.
+  mutable subtle::Atomic32 corrupt_;
+
+  DISALLOW_COPY_AND_ASSIGN(PersistentMemoryAllocator);
+};
+
+// A PersistentMemoryAllocator on the heap. The segment doesn't outlive the
+// process, but is handy where no other memory is needed, such as in tests.
+class BASE_EXPORT LocalPersistentMemoryAllocator
+    : public PersistentMemoryAllocator {
+ public:
+  LocalPersistentMemoryAllocator(size_t size,
+                                 uint64 id,
+                                 const std::string& name);
+  virtual ~LocalPersistentMemoryAllocator();
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(LocalPersistentMemoryAllocator);
+};
+
+// A PersistentMemoryAllocator in a mapped SharedMemory segment, which other
+// processes can map as well. Named shared memory also survives a crash of
+// the process that created it.
+class BASE_EXPORT SharedPersistentMemoryAllocator
+    : public PersistentMemoryAllocator {
+ public:
+  // |memory| must be mapped, and meet IsSharedMemoryAcceptable().
+  SharedPersistentMemoryAllocator(scoped_ptr<SharedMemory> memory,
+                                  uint64 id,
+                                  const std::string& name,
+                                  bool read_only);
+  virtual ~SharedPersistentMemoryAllocator();
+
+  SharedMemory* shared_memory() { return shared_memory_.get(); }
+
+  static bool IsSharedMemoryAcceptable(const SharedMemory& memory);
+
+ private:
+  scoped_ptr<SharedMemory> shared_memory_;
+
+  DISALLOW_COPY_AND_ASSIGN(SharedPersistentMemoryAllocator);
+};
+
+// A read-only PersistentMemoryAllocator over a file holding a segment, such
+// as a copy of another allocator's memory saved to disk. The id and name are
+// those the segment was created with.
+class BASE_EXPORT FilePersistentMemoryAllocator
+    : public PersistentMemoryAllocator {
+ public:
+  // |file| must be valid and meet IsFileAcceptable().
+  explicit FilePersistentMemoryAllocator(scoped_ptr<MemoryMappedFile> file);
+  virtual ~FilePersistentMemoryAllocator();
+
+  static bool IsFileAcceptable(const MemoryMappedFile& file);
+
+ private:
+  scoped_ptr<MemoryMappedFile> mapped_file_;
+
+  DISALLOW_COPY_AND_ASSIGN(FilePersistentMemoryAllocator);
+};
+
+}  // namespace base
+
+#endif  // BASE_METRICS_PERSISTENT_MEMORY_ALLOCATOR_H_
@@ -0,0 +1,212 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/metrics/persistent_memory_allocator.h"
+
+#include <string.h>
+
+#include "base/files/file_path.h"
+#include "base/files/file_util.h"
+#include "base/files/memory_mapped_file.h"
+#include "base/files/scoped_temp_dir.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/memory/shared_memory.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace base {
+
+namespace {
+
+const size_t kTestMemorySize = 1 << 16;
+const uint64 kTestId = 12345;
+const uint32 kTypeIdFoo = 0x1000;
+const uint32 kTypeIdBar = 0x2000;
+
+struct Foo {
+  int32 value;
+  char text[28];
+};
+
+}  // namespace
+
+TEST(PersistentMemoryAllocatorTest, AllocateAndIterate) {
+  LocalPersistentMemoryAllocator allocator(kTestMemorySize, kTestId, "Test");
+  EXPECT_EQ(kTestId, allocator.Id());
+  EXPECT_STREQ("Test", allocator.Name());
+  EXPECT_FALSE(allocator.IsCorrupt());
+  EXPECT_FALSE(allocator.IsFull());
+  size_t used = allocator.used();
+  EXPECT_LT(0u, used);
+
+  PersistentMemoryAllocator::Iterator iter;
+  uint32 type_id;
+  allocator.CreateIterator(&iter);
+  EXPECT_EQ(0u, allocator.GetNextIterable(&iter, &type_id));
+
+  PersistentMemoryAllocator::Reference foo_ref =
+      allocator.Allocate(sizeof(Foo), kTypeIdFoo);
+  ASSERT_NE(0u, foo_ref);
+  EXPECT_LT(used, allocator.used());
+  EXPECT_EQ(kTypeIdFoo, allocator.GetType(foo_ref));
+  EXPECT_LE(sizeof(Foo), allocator.GetAllocSize(foo_ref));
+  Foo* foo = allocator.GetAsObject<Foo>(foo_ref, kTypeIdFoo);
+  ASSERT_TRUE(foo);
+  // New blocks are zeroed.
+  EXPECT_EQ(0, foo->value);
+  foo->value = 42;
+  // The type and the size are checked.
+  EXPECT_FALSE(allocator.GetAsObject<Foo>(foo_ref, kTypeIdBar));
+  EXPECT_FALSE(allocator.GetAsArray<Foo>(foo_ref, kTypeIdFoo, 100));
+
+  // Blocks are only found by iterating once they are made iterable, in the
+  // order that happens in.
+  PersistentMemoryAllocator::Reference bar_ref =
+      allocator.Allocate(8, kTypeIdBar);
+  ASSERT_NE(0u, bar_ref);
+  EXPECT_EQ(0u, allocator.GetNextIterable(&iter, &type_id));
+  allocator.MakeIterable(bar_ref);
+  allocator.MakeIterable(foo_ref);
+  EXPECT_EQ(bar_ref, allocator.GetNextIterable(&iter, &type_id));
+  EXPECT_EQ(kTypeIdBar, type_id);
+  EXPECT_EQ(foo_ref, allocator.GetNextIterable(&iter, &type_id));
+  EXPECT_EQ(kTypeIdFoo, type_id);
+  EXPECT_EQ(0u, allocator.GetNextIterable(&iter, &type_id));
+
+  // The iteration picks up blocks made iterable later.
+  PersistentMemoryAllocator::Reference baz_ref = allocator.Allocate(16, 3);
+  allocator.MakeIterable(baz_ref);
+  EXPECT_EQ(baz_ref, allocator.GetNextIterable(&iter, &type_id));
+  EXPECT_EQ(0u, allocator.GetNextIterable(&iter, &type_id));
+
+  EXPECT_FALSE(allocator.IsCorrupt());
+}
+
+TEST(PersistentMemoryAllocatorTest, BadReferences) {
+  LocalPersistentMemoryAllocator allocator(kTestMemorySize, kTestId, "");
+  EXPECT_STREQ("", allocator.Name());
+  PersistentMemoryAllocator::Reference ref = allocator.Allocate(32, 1);
+  ASSERT_NE(0u, ref);
+
+  EXPECT_FALSE(allocator.GetAsObject<Foo>(0, 0));
+  EXPECT_FALSE(allocator.GetAsObject<Foo>(ref + 1, 0));
+  EXPECT_FALSE(allocator.GetAsObject<Foo>(ref + 8, 0));
+  EXPECT_FALSE(allocator.GetAsObject<Foo>(kTestMemorySize - 8, 0));
+  EXPECT_FALSE(allocator.GetAsObject<Foo>(0xFFFFFFF8, 0));
+  EXPECT_EQ(0u, allocator.GetType(ref + 8));
+  EXPECT_EQ(0u, allocator.GetAllocSize(ref + 8));
+  EXPECT_TRUE(allocator.GetAsObject<Foo>(ref, 0));
+  // None of this is corruption, just bad references.
+  EXPECT_FALSE(allocator.IsCorrupt());
+}
+
+TEST(PersistentMemoryAllocatorTest, Full) {
+  LocalPersistentMemoryAllocator allocator(
+      PersistentMemoryAllocator::kSegmentMinSize, kTestId, "");
+  EXPECT_EQ(0u, allocator.Allocate(kTestMemorySize, 1));
+  EXPECT_TRUE(allocator.IsFull());
+
+  // What fits is still handed out.
+  EXPECT_NE(0u, allocator.Allocate(16, 1));
+  while (allocator.Allocate(16, 1)) {
+  }
+  EXPECT_LE(allocator.size() - 32, allocator.used());
+  EXPECT_FALSE(allocator.IsCorrupt());
+}
+
+TEST(PersistentMemoryAllocatorTest, Corruption) {
+  LocalPersistentMemoryAllocator allocator(kTestMemorySize, kTestId, "");
+  PersistentMemoryAllocator::Reference ref = allocator.Allocate(32, 1);
+  allocator.MakeIterable(ref);
+
+  // Make the block point back at itself, as if to loop the iteration.
+  PersistentMemoryAllocator::Reference* block_next =
+      reinterpret_cast<PersistentMemoryAllocator::Reference*>(
+          allocator.GetAsObject<char>(ref, 1)) - 1;
+  *block_next = ref;
+  PersistentMemoryAllocator::Iterator iter;
+  uint32 type_id;
+  allocator.CreateIterator(&iter);
+  size_t count = 0;
+  while (allocator.GetNextIterable(&iter, &type_id))
+    ++count;
+  EXPECT_LT(1u, count);
+  EXPECT_TRUE(allocator.IsCorrupt());
+
+  // Nothing more is handed out.
+  EXPECT_EQ(0u, allocator.Allocate(32, 1));
+  EXPECT_FALSE(allocator.GetAsObject<char>(ref, 1));
+}
+
+TEST(PersistentMemoryAllocatorTest, SharedMemory) {
+  scoped_ptr<SharedMemory> shared_memory(new SharedMemory());
+  ASSERT_TRUE(shared_memory->CreateAndMapAnonymous(kTestMemorySize));
+  SharedMemoryHandle handle;
+  ASSERT_TRUE(shared_memory->ShareToProcess(GetCurrentProcessHandle(),
+                                            &handle));
+  ASSERT_TRUE(
+      SharedPersistentMemoryAllocator::IsSharedMemoryAcceptable(*shared_memory));
+  SharedPersistentMemoryAllocator writer(shared_memory.Pass(), kTestId,
+                                         "Shared", false);
+  PersistentMemoryAllocator::Reference ref =
+      writer.Allocate(sizeof(Foo), kTypeIdFoo);
+  Foo* foo = writer.GetAsObject<Foo>(ref, kTypeIdFoo);
+  ASSERT_TRUE(foo);
+  foo->value = 7;
+  writer.MakeIterable(ref);
+
+  // A second mapping, as in another process, finds what was written, and
+  // sees later changes.
+  scoped_ptr<SharedMemory> reader_memory(new SharedMemory(handle, true));
+  ASSERT_TRUE(reader_memory->Map(kTestMemorySize));
+  SharedPersistentMemoryAllocator reader(reader_memory.Pass(), 0, "", true);
+  EXPECT_TRUE(reader.IsReadonly());
+  EXPECT_EQ(kTestId, reader.Id());
+  EXPECT_STREQ("Shared", reader.Name());
+  PersistentMemoryAllocator::Iterator iter;
+  uint32 type_id;
+  reader.CreateIterator(&iter);
+  ASSERT_EQ(ref, reader.GetNextIterable(&iter, &type_id));
+  const Foo* read_foo = reader.GetAsObject<Foo>(ref, kTypeIdFoo);
+  ASSERT_TRUE(read_foo);
+  EXPECT_EQ(7, read_foo->value);
+  foo->value = 8;
+  EXPECT_EQ(8, read_foo->value);
+  EXPECT_FALSE(reader.IsCorrupt());
+}
+
+TEST(PersistentMemoryAllocatorTest, File) {
+  ScopedTempDir temp_dir;
+  ASSERT_TRUE(temp_dir.CreateUniqueTempDir());
+  FilePath file_path = temp_dir.path().AppendASCII("segment");
+
+  PersistentMemoryAllocator::Reference ref;
+  {
+    LocalPersistentMemoryAllocator writer(kTestMemorySize, kTestId, "File");
+    ref = writer.Allocate(sizeof(Foo), kTypeIdFoo);
+    Foo* foo = writer.GetAsObject<Foo>(ref, kTypeIdFoo);
+    ASSERT_TRUE(foo);
+    strcpy(foo->text, "persistent");
+    writer.MakeIterable(ref);
+    ASSERT_EQ(static_cast<int>(writer.size()),
+              WriteFile(file_path, static_cast<const char*>(writer.data()),
+                        writer.size()));
+  }
+
+  scoped_ptr<MemoryMappedFile> file(new MemoryMappedFile());
+  ASSERT_TRUE(file->Initialize(file_path));
+  ASSERT_TRUE(FilePersistentMemoryAllocator::IsFileAcceptable(*file));
+  FilePersistentMemoryAllocator reader(file.Pass());
+  EXPECT_TRUE(reader.IsReadonly());
+  EXPECT_EQ(kTestId, reader.Id());
+  EXPECT_STREQ("File", reader.Name());
+  PersistentMemoryAllocator::Iterator iter;
+  uint32 type_id;
+  reader.CreateIterator(&iter);
+  ASSERT_EQ(ref, reader.GetNextIterable(&iter, &type_id));
+  EXPECT_EQ(kTypeIdFoo, type_id);
+  EXPECT_STREQ("persistent", reader.GetAsObject<Foo>(ref, kTypeIdFoo)->text);
+  EXPECT_EQ(0u, reader.Allocate(8, 1));
+}
+
+}  // namespace base
@@ -23,6 +23,12 @@ class BucketRanges;
 class BASE_EXPORT_PRIVATE SampleVector : public HistogramSamples {
  public:
   explicit SampleVector(const BucketRanges* bucket_ranges);
+  // Keeps the counts in |counts|, which has room for one per bucket, and the
+  // sum and redundant count in |meta|. Both must outlive this object. Used for
+  // samples kept in persistent memory.
+  SampleVector(const BucketRanges* bucket_ranges,
+               HistogramBase::AtomicCount* counts,
+               HistogramSamples::Metadata* meta);
   virtual ~SampleVector();
 
   // HistogramSamples implementation:
@@ -36,6 +42,10 @@ class BASE_EXPORT_PRIVATE SampleVector : public HistogramSamples {
   // Get count of a specific bucket.
   HistogramBase::Count GetCountAtIndex(size_t bucket_index) const;
 
+  // Returns the index of the bucket in |bucket_ranges| that |value| goes in.
+  static size_t FindBucketIndex(const BucketRanges* bucket_ranges,
+                                HistogramBase::Sample value);
+
  protected:
   virtual bool AddSubtractImpl(
       SampleCountIterator* iter,
@@ -46,7 +56,11 @@ class BASE_EXPORT_PRIVATE SampleVector : public HistogramSamples {
  private:
   FRIEND_TEST_ALL_PREFIXES(HistogramTest, CorruptSampleCounts);
 
-  std::vector<HistogramBase::AtomicCount> counts_;
+  // Holds the counts unless they were given to the constructor.
+  std::vector<HistogramBase::AtomicCount> local_counts_;
+
+  HistogramBase::AtomicCount* counts_;
+  const size_t counts_size_;
 
   // Shares the same BucketRanges with Histogram object.
   const BucketRanges* const bucket_ranges_;
@@ -58,6 +72,9 @@ class BASE_EXPORT_PRIVATE SampleVectorIterator : public SampleCountIterator {
  public:
   SampleVectorIterator(const std::vector<HistogramBase::AtomicCount>* counts,
                        const BucketRanges* bucket_ranges);
+  SampleVectorIterator(const HistogramBase::AtomicCount* counts,
+                       size_t counts_size,
+                       const BucketRanges* bucket_ranges);
   virtual ~SampleVectorIterator();
 
   // SampleCountIterator implementation:
@@ -73,7 +90,8 @@ class BASE_EXPORT_PRIVATE SampleVectorIterator : public SampleCountIterator {
  private:
   void SkipEmptyBuckets();
 
-  const std::vector<HistogramBase::AtomicCount>* counts_;
+  const HistogramBase::AtomicCount* counts_;
+  size_t counts_size_;
   const BucketRanges* bucket_ranges_;
 
   size_t index_;
@@ -0,0 +1,136 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/metrics/sharded_sample_vector.h"
+
+#include <string.h>
+
+#include <vector>
+
+#include "base/atomicops.h"
+#include "base/lazy_instance.h"
+#include "base/memory/aligned_memory.h"
+#include "base/metrics/bucket_ranges.h"
+#include "base/metrics/histogram_samples.h"
+#include "base/metrics/sample_vector.h"
+#include "base/threading/thread_local.h"
+
+namespace base {
+
+typedef HistogramBase::Count Count;
+typedef HistogramBase::Sample Sample;
+
+namespace {
+
+// The shard index of each thread plus one, so that NULL means none yet.
+LazyInstance<ThreadLocalPointer<void> >::Leaky g_thread_shard_index =
+    LAZY_INSTANCE_INITIALIZER;
+
+// The number of shard indices given out so far.
+subtle::Atomic32 g_shard_indices_given_out = 0;
+
+// At least the cache line size of the CPUs we run on. Some of them fetch
+// cache lines in adjacent pairs, so this is twice the usual 64 bytes.
+const size_t kCacheLineSize = 128;
+
+// The totals of all shards. Derives from SampleVector for access to the
+// protected HistogramSamples methods that add to the sum and redundant count.
+class ShardTotals : public SampleVector {
+ public:
+  explicit ShardTotals(const BucketRanges* bucket_ranges)
+      : SampleVector(bucket_ranges),
+        bucket_ranges_(bucket_ranges) {}
+
+  void AddShards(const std::vector<HistogramBase::AtomicCount>& counts,
+                 int64 sum,
+                 Count redundant_count) {
+    SampleVectorIterator iter(&counts, bucket_ranges_);
+    AddSubtractImpl(&iter, ADD);
+    IncreaseSum(sum);
+    IncreaseRedundantCount(redundant_count);
+  }
+
+ private:
+  const BucketRanges* const bucket_ranges_;
+
+  DISALLOW_COPY_AND_ASSIGN(ShardTotals);
+};
+
+}  // namespace
+
+struct ShardedSampleVector::ShardHeader {
+  int64 sum;
+  HistogramBase::AtomicCount redundant_count;
+};
+
+ShardedSampleVector::ShardedSampleVector(const BucketRanges* bucket_ranges)
+    : bucket_ranges_(bucket_ranges) {
+  size_t shard_size = sizeof(ShardHeader) +
+      bucket_ranges->bucket_count() * sizeof(HistogramBase::AtomicCount);
+  shard_stride_ = (shard_size + kCacheLineSize - 1) & ~(kCacheLineSize - 1);
+  shards_ = static_cast<char*>(
+      AlignedAlloc(kShardCount * shard_stride_, kCacheLineSize));
+  memset(shards_, 0, kShardCount * shard_stride_);
+}
+
+ShardedSampleVector::~ShardedSampleVector() {
+  AlignedFree(shards_);
+}
+
+void ShardedSampleVector::Accumulate(Sample value, Count count) {
+  size_t bucket_index = SampleVector::FindBucketIndex(bucket_ranges_, value);
+  ShardHeader* shard = GetShard(GetCurrentThreadShardIndex());
+  HistogramBase::AtomicCount* counts = GetShardCounts(shard);
+  subtle::NoBarrier_Store(
+      &counts[bucket_index],
+      subtle::NoBarrier_Load(&counts[bucket_index]) + count);
+  shard->sum += static_cast<int64>(count) * value;
+  subtle::NoBarrier_Store(
+      &shard->redundant_count,
+      subtle::NoBarrier_Load(&shard->redundant_count) + count);
+}
+
+void ShardedSampleVector::AddTo(HistogramSamples* samples) const {
+  size_t bucket_count = bucket_ranges_->bucket_count();
+  std::vector<HistogramBase::AtomicCount> counts(bucket_count);
+  int64 sum = 0;
+  Count redundant_count = 0;
+  for (size_t i = 0; i < kShardCount; ++i) {
+    ShardHeader* shard = GetShard(i);
+    const HistogramBase::AtomicCount* shard_counts = GetShardCounts(shard);
+    for (size_t j = 0; j < bucket_count; ++j)
+      counts[j] += subtle::NoBarrier_Load(&shard_counts[j]);
+    sum += shard->sum;
+    redundant_count += subtle::NoBarrier_Load(&shard->redundant_count);
+  }
+
+  ShardTotals totals(bucket_ranges_);
+  totals.AddShards(counts, sum, redundant_count);
+  samples->Add(totals);
+}
+
+// static
+size_t ShardedSampleVector::GetCurrentThreadShardIndex() {
+  ThreadLocalPointer<void>* thread_shard_index = g_thread_shard_index.Pointer();
+  uintptr_t index = reinterpret_cast<uintptr_t>(thread_shard_index->Get());
+  if (!index) {
+    index = static_cast<uint32>(
+        subtle::NoBarrier_AtomicIncrement(&g_shard_indices_given_out, 1));
+    thread_shard_index->Set(reinterpret_cast<void*>(index));
+  }
+  return (index - 1) % kShardCount;
+}
+
+ShardedSampleVector::ShardHeader* ShardedSampleVector::GetShard(
+    size_t index) const {
+  return reinterpret_cast<ShardHeader*>(shards_ + index * shard_stride_);
+}
+
+// static
+HistogramBase::AtomicCount* ShardedSampleVector::GetShardCounts(
+    ShardHeader* shard) {
+  return reinterpret_cast<HistogramBase::AtomicCount*>(shard + 1);
+}
+
+}  // namespace base
@@ -0,0 +1,65 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// ShardedSampleVector stores the samples of a Histogram created with
+// HistogramBase::kShardedRecordingFlag. It spreads them over a shard per
+// recording thread, each holding a sum and bucket counts on cache lines of
+// its own, so that threads recording into the same histogram concurrently
+// don't write to the same cache lines.
+
+#ifndef BASE_METRICS_SHARDED_SAMPLE_VECTOR_H_
+#define BASE_METRICS_SHARDED_SAMPLE_VECTOR_H_
+
+#include "base/base_export.h"
+#include "base/basictypes.h"
+#include "base/metrics/histogram_base.h"
+
+namespace base {
+
+class BucketRanges;
+class HistogramSamples;
+
+class BASE_EXPORT_PRIVATE ShardedSampleVector {
+ public:
+  // Threads are given shards round-robin, so up to this many threads record
+  // without sharing a shard.
+  static const size_t kShardCount = 16;
+
+  explicit ShardedSampleVector(const BucketRanges* bucket_ranges);
+  ~ShardedSampleVector();
+
+  // Accumulates into the calling thread's shard. This takes no locks; like
+  // SampleVector::Accumulate(), it doesn't make its updates atomic either, so
+  // threads that share a shard may occasionally lose a sample.
+  void Accumulate(HistogramBase::Sample value, HistogramBase::Count count);
+
+  // Adds the samples of all shards to |samples|, which must use the same
+  // bucket ranges.
+  void AddTo(HistogramSamples* samples) const;
+
+  // Returns the shard index of the calling thread. Exposed for testing.
+  static size_t GetCurrentThreadShardIndex();
+
+ private:
+  // Starts each shard, and is followed by the shard's bucket counts.
+  struct ShardHeader;
+
+  ShardHeader* GetShard(size_t index) const;
+  static HistogramBase::AtomicCount* GetShardCounts(ShardHeader* shard);
+
+  const BucketRanges* const bucket_ranges_;
+
+  // The distance between shards: the shard size rounded up to whole cache
+  // lines.
+  size_t shard_stride_;
+
+  // All kShardCount shards, in one block aligned to the cache line size.
+  char* shards_;
+
+  DISALLOW_COPY_AND_ASSIGN(ShardedSampleVector);
+};
+
+}  // namespace base
+
+#endif  // BASE_METRICS_SHARDED_SAMPLE_VECTOR_H_
@@ -0,0 +1,88 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/metrics/sharded_sample_vector.h"
+
+#include <set>
+
+#include "base/memory/scoped_vector.h"
+#include "base/metrics/bucket_ranges.h"
+#include "base/metrics/sample_vector.h"
+#include "base/strings/stringprintf.h"
+#include "base/threading/simple_thread.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace base {
+namespace {
+
+// Accumulates |count| samples of |value| into |samples| and records the shard
+// index of its thread.
+class AccumulateRunner : public DelegateSimpleThread::Delegate {
+ public:
+  AccumulateRunner(ShardedSampleVector* samples,
+                   HistogramBase::Sample value,
+                   int count)
+      : samples_(samples), value_(value), count_(count), shard_index_(0) {}
+
+  virtual void Run() OVERRIDE {
+    shard_index_ = ShardedSampleVector::GetCurrentThreadShardIndex();
+    for (int i = 0; i < count_; ++i)
+      samples_->Accumulate(value_, 1);
+    EXPECT_EQ(shard_index_, ShardedSampleVector::GetCurrentThreadShardIndex());
+  }
+
+  size_t shard_index() const { return shard_index_; }
+
+ private:
+  ShardedSampleVector* samples_;
+  HistogramBase::Sample value_;
+  int count_;
+  size_t shard_index_;
+};
+
+TEST(ShardedSampleVectorTest, AccumulateFromThreads) {
+  // Custom buckets: [1, 5) [5, 10)
+  BucketRanges ranges(3);
+  ranges.set_range(0, 1);
+  ranges.set_range(1, 5);
+  ranges.set_range(2, 10);
+  ShardedSampleVector sharded_samples(&ranges);
+
+  const size_t kShardCount = ShardedSampleVector::kShardCount;
+  ScopedVector<AccumulateRunner> runners;
+  ScopedVector<DelegateSimpleThread> threads;
+  for (size_t i = 0; i < kShardCount; ++i) {
+    runners.push_back(new AccumulateRunner(&sharded_samples, i % 2 ? 2 : 6,
+                                           1000));
+    threads.push_back(new DelegateSimpleThread(
+        runners.back(), StringPrintf("AccumulateRunner%u",
+                                     static_cast<unsigned>(i))));
+  }
+  // Gives this thread its shard before the others start.
+  sharded_samples.Accumulate(1, 5);
+  for (size_t i = 0; i < threads.size(); ++i)
+    threads[i]->Start();
+  for (size_t i = 0; i < threads.size(); ++i)
+    threads[i]->Join();
+
+  // Threads that start together get shards of their own.
+  std::set<size_t> shard_indices;
+  for (size_t i = 0; i < runners.size(); ++i) {
+    EXPECT_LT(runners[i]->shard_index(), kShardCount);
+    shard_indices.insert(runners[i]->shard_index());
+  }
+  EXPECT_EQ(kShardCount, shard_indices.size());
+
+  // The shards merge into the same samples as one SampleVector would hold.
+  SampleVector samples(&ranges);
+  samples.Accumulate(7, 3);
+  sharded_samples.AddTo(&samples);
+  EXPECT_EQ(5 + 8 * 1000, samples.GetCountAtIndex(0));
+  EXPECT_EQ(3 + 8 * 1000, samples.GetCountAtIndex(1));
+  EXPECT_EQ(5 + 8 * 1000 * 2 + 7 * 3 + 8 * 1000 * 6, samples.sum());
+  EXPECT_EQ(samples.TotalCount(), samples.redundant_count());
+}
+
+}  // namespace
+}  // namespace base
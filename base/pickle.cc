@@ -8,6 +8,8 @@
 
 #include <algorithm>  // for max()
 
+#include "base/memory/ref_counted_memory.h"
+
 //------------------------------------------------------------------------------
 
 using base::char16;
@@ -18,6 +20,23 @@ const int Pickle::kPayloadUnit = 64;
 
 static const size_t kCapacityReadOnly = static_cast<size_t>(-1);
 
+// The payload of a Pickle with external data is its own buffer with the
+// referenced blobs spliced in.  Each blob is followed by its alignment
+// padding in the Pickle's own buffer, so write_offset_ may be unaligned there.
+struct Pickle::ExternalData {
+  ExternalData() : size(0) {}
+
+  struct Segment {
+    // Where |memory| goes in the payload in the Pickle's own buffer.
+    size_t offset;
+    scoped_refptr<base::RefCountedMemory> memory;
+  };
+
+  std::vector<Segment> segments;
+  // The total size of the segments' memory.
+  size_t size;
+};
+
 PickleIterator::PickleIterator(const Pickle& pickle)
     : payload_(pickle.payload()),
       read_index_(0),
@@ -230,9 +249,13 @@ Pickle::Pickle(const Pickle& other)
       header_size_(other.header_size_),
       capacity_after_header_(0),
       write_offset_(other.write_offset_) {
-  size_t payload_size = header_size_ + other.header_->payload_size;
+  // The copy shares the external data, which is read-only.
+  size_t payload_size = header_size_ + (other.external_data_ ?
+      other.write_offset_ : other.header_->payload_size);
   Resize(payload_size);
   memcpy(header_, other.header_, payload_size);
+  if (other.external_data_)
+    external_data_.reset(new ExternalData(*other.external_data_));
 }
 
 Pickle::~Pickle() {
@@ -254,10 +277,13 @@ Pickle& Pickle::operator=(const Pickle& other) {
     header_ = NULL;
     header_size_ = other.header_size_;
   }
-  Resize(other.header_->payload_size);
-  memcpy(header_, other.header_,
-         other.header_size_ + other.header_->payload_size);
+  size_t payload_size = other.external_data_ ?
+      other.write_offset_ : other.header_->payload_size;
+  Resize(payload_size);
+  memcpy(header_, other.header_, other.header_size_ + payload_size);
   write_offset_ = other.write_offset_;
+  external_data_.reset(other.external_data_ ?
+                       new ExternalData(*other.external_data_) : NULL);
   return *this;
 }
 
@@ -293,6 +319,83 @@ bool Pickle::WriteBytes(const void* data, int length) {
   return true;
 }
 
+bool Pickle::WriteDataReference(
+    const scoped_refptr<base::RefCountedMemory>& data) {
+  size_t length = data->size();
+  size_t data_len = AlignInt(length, sizeof(uint32));
+  if (length > static_cast<size_t>(kint32max) ||
+      header_->payload_size > kuint32max - sizeof(int) - data_len) {
+    return false;
+  }
+  if (!WriteInt(static_cast<int>(length)))
+    return false;
+  if (!length)
+    return true;
+
+  ExternalData::Segment segment;
+  segment.offset = write_offset_;
+  segment.memory = data;
+  if (!external_data_)
+    external_data_.reset(new ExternalData);
+  external_data_->segments.push_back(segment);
+  external_data_->size += length;
+
+  size_t padding = data_len - length;
+  if (write_offset_ + padding > capacity_after_header_)
+    Resize(capacity_after_header_ * 2 + padding);
+  memset(mutable_payload() + write_offset_, 0, padding);
+  write_offset_ += padding;
+  header_->payload_size =
+      static_cast<uint32>(write_offset_ + external_data_->size);
+  return true;
+}
+
+void Pickle::GetDataSegments(std::vector<base::StringPiece>* segments) const {
+  const char* start = reinterpret_cast<const char*>(header_);
+  if (!external_data_) {
+    segments->push_back(base::StringPiece(start, size()));
+    return;
+  }
+
+  const char* next = start;
+  for (size_t i = 0; i < external_data_->segments.size(); ++i) {
+    const ExternalData::Segment& segment = external_data_->segments[i];
+    const char* end = start + header_size_ + segment.offset;
+    if (end != next)
+      segments->push_back(base::StringPiece(next, end - next));
+    segments->push_back(base::StringPiece(segment.memory->front_as<char>(),
+                                          segment.memory->size()));
+    next = end;
+  }
+  const char* end = start + header_size_ + write_offset_;
+  if (end != next)
+    segments->push_back(base::StringPiece(next, end - next));
+}
+
+void Pickle::FlattenExternalData() const {
+  DCHECK(external_data_);
+  std::vector<base::StringPiece> segments;
+  GetDataSegments(&segments);
+
+  size_t payload_size = header_->payload_size;
+  size_t capacity = AlignInt(payload_size, kPayloadUnit);
+  char* flat = static_cast<char*>(malloc(header_size_ + capacity));
+  CHECK(flat);
+  char* write = flat;
+  for (size_t i = 0; i < segments.size(); ++i) {
+    memcpy(write, segments[i].data(), segments[i].size());
+    write += segments[i].size();
+  }
+  DCHECK_EQ(size(), static_cast<size_t>(write - flat));
+
+  Pickle* self = const_cast<Pickle*>(this);
+  free(self->header_);
+  self->header_ = reinterpret_cast<Header*>(flat);
+  self->capacity_after_header_ = capacity;
+  self->write_offset_ = payload_size;
+  self->external_data_.reset();
+}
+
 void Pickle::Reserve(size_t length) {
   size_t data_len = AlignInt(length, sizeof(uint32));
   DCHECK_GE(data_len, length);
@@ -358,5 +461,7 @@ inline void Pickle::WriteBytesCommon(const void* data, size_t length) {
   memcpy(write, data, length);
   memset(write + length, 0, data_len - length);
   header_->payload_size = static_cast<uint32>(new_size);
+  if (external_data_)
+    header_->payload_size += static_cast<uint32>(external_data_->size);
   write_offset_ = new_size;
 }
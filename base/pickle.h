@@ -6,13 +6,21 @@
 #define BASE_PICKLE_H__
 
 #include <string>
+#include <vector>
 
 #include "base/base_export.h"
 #include "base/basictypes.h"
 #include "base/compiler_specific.h"
 #include "base/gtest_prod_util.h"
 #include "base/logging.h"
+#include "base/memory/ref_counted.h"
+#include "base/memory/scoped_ptr.h"
 #include "base/strings/string16.h"
+#include "base/strings/string_piece.h"
+
+namespace base {
+class RefCountedMemory;
+}
 
 class Pickle;
 
@@ -106,6 +114,12 @@ class BASE_EXPORT PickleIterator {
 // space is controlled by the header_size parameter passed to the Pickle
 // constructor.
 //
+// Large blobs can be added with WriteDataReference(), which references them
+// instead of copying them into the internal buffer.  Such a Pickle's data is
+// split over several buffers until something needs it in one piece (see
+// WriteDataReference()); GetDataSegments() gives access to the pieces for
+// writing them out with scatter/gather I/O.
+//
 class BASE_EXPORT Pickle {
  public:
   // Initialize a Pickle object using the default header size.
@@ -138,8 +152,23 @@ class BASE_EXPORT Pickle {
   // Returns the size of the Pickle's data.
   size_t size() const { return header_size_ + header_->payload_size; }
 
-  // Returns the data for this Pickle.
-  const void* data() const { return header_; }
+  // Returns the data for this Pickle.  This flattens the Pickle if it has
+  // external data, see WriteDataReference().
+  const void* data() const {
+    if (external_data_)
+      FlattenExternalData();
+    return header_;
+  }
+
+  // Returns whether the payload has blobs written by WriteDataReference()
+  // that still live outside of the Pickle's own buffer.
+  bool has_external_data() const { return !!external_data_; }
+
+  // Appends to |segments| the byte ranges that make up the Pickle's data, in
+  // order, without flattening it.  Their concatenation is what data() would
+  // return, header included; without external data, that is one range.  The
+  // ranges stay valid until the Pickle is modified or flattened.
+  void GetDataSegments(std::vector<base::StringPiece>* segments) const;
 
   // For compatibility, these older style read methods pass through to the
   // PickleIterator methods.
@@ -264,6 +293,17 @@ class BASE_EXPORT Pickle {
   // when reading and writing. It is normally used to serialize PoD types of a
   // known size. See also WriteData.
   bool WriteBytes(const void* data, int length);
+  // Same as WriteData() of |data|'s bytes, but without copying them: the
+  // Pickle keeps a reference to |data| and leaves the bytes where they are.
+  // Readers of the Pickle's data can't tell the difference.  Whenever the
+  // data is needed in one piece -- through data(), payload(), or a
+  // PickleIterator -- the Pickle is "flattened", copying the referenced bytes
+  // in after all, so this only saves the copy when the data is written out
+  // through GetDataSegments(), as IPC::ChannelPosix does.  Flattening
+  // modifies a const Pickle's buffers, so a Pickle with external data must
+  // not be read on several threads at once.  Worth it for blobs of tens of
+  // kilobytes and up; smaller ones are cheaper to copy.
+  bool WriteDataReference(const scoped_refptr<base::RefCountedMemory>& data);
 
   // Reserves space for upcoming writes when multiple writes will be made and
   // their sizes are computed in advance. It can be significantly faster to call
@@ -294,7 +334,10 @@ class BASE_EXPORT Pickle {
     return header_ ? header_->payload_size : 0;
   }
 
+  // Flattens the Pickle if it has external data, see WriteDataReference().
   const char* payload() const {
+    if (external_data_)
+      FlattenExternalData();
     return reinterpret_cast<const char*>(header_) + header_size_;
   }
 
@@ -335,14 +378,23 @@ class BASE_EXPORT Pickle {
  private:
   friend class PickleIterator;
 
+  // The blobs written by WriteDataReference(), see pickle.cc.
+  struct ExternalData;
+
   Header* header_;
   size_t header_size_;  // Supports extra data between header and payload.
   // Allocation size of payload (or -1 if allocation is const). Note: this
   // doesn't count the header.
   size_t capacity_after_header_;
   // The offset at which we will write the next field. Note: this doesn't count
-  // the header.
+  // the header, nor external data.
   size_t write_offset_;
+  // NULL unless the payload references external data.
+  scoped_ptr<ExternalData> external_data_;
+
+  // Copies the external data into the Pickle's own buffer.  This doesn't
+  // change the Pickle's contents, so it is done on const Pickles too.
+  void FlattenExternalData() const;
 
   // Just like WriteBytes, but with a compile-time size, for performance.
   template<size_t length> void BASE_EXPORT WriteBytesStatic(const void* data);
@@ -5,12 +5,14 @@
 #include <string>
 
 #include "base/basictypes.h"
+#include "base/memory/ref_counted_memory.h"
 #include "base/memory/scoped_ptr.h"
 #include "base/pickle.h"
 #include "base/strings/string16.h"
 #include "testing/gtest/include/gtest/gtest.h"
 
 // Remove when this file is in the base namespace.
+using base::StringPiece;
 using base::string16;
 
 namespace {
@@ -368,3 +370,94 @@ TEST(PickleTest, ReadBytes) {
   memcpy(&outdata, outdata_char, sizeof(outdata));
   EXPECT_EQ(data, outdata);
 }
+
+std::string JoinDataSegments(const Pickle& pickle) {
+  std::vector<StringPiece> segments;
+  pickle.GetDataSegments(&segments);
+  std::string data;
+  for (size_t i = 0; i < segments.size(); ++i)
+    segments[i].AppendToString(&data);
+  return data;
+}
+
+// Check that data written by reference reads back as if it had been copied.
+TEST(PickleTest, DataReference) {
+  const char kUnaligned[] = "hello";
+  std::string blob(1000, 'x');
+  scoped_refptr<base::RefCountedMemory> unaligned =
+      new base::RefCountedStaticMemory(kUnaligned, 5);
+  scoped_refptr<base::RefCountedMemory> empty =
+      new base::RefCountedStaticMemory();
+
+  Pickle expected;
+  EXPECT_TRUE(expected.WriteInt(testint));
+  EXPECT_TRUE(expected.WriteData(kUnaligned, 5));
+  EXPECT_TRUE(expected.WriteString(teststr));
+  EXPECT_TRUE(expected.WriteData(blob.data(), static_cast<int>(blob.size())));
+  EXPECT_TRUE(expected.WriteData(NULL, 0));
+  EXPECT_TRUE(expected.WriteInt(testint));
+  std::string expected_data(static_cast<const char*>(expected.data()),
+                            expected.size());
+
+  Pickle pickle;
+  EXPECT_TRUE(pickle.WriteInt(testint));
+  EXPECT_TRUE(pickle.WriteDataReference(unaligned));
+  EXPECT_TRUE(pickle.WriteString(teststr));
+  std::string blob_copy(blob);
+  EXPECT_TRUE(pickle.WriteDataReference(
+      base::RefCountedString::TakeString(&blob_copy)));
+  EXPECT_TRUE(pickle.WriteDataReference(empty));
+  EXPECT_TRUE(pickle.WriteInt(testint));
+
+  EXPECT_TRUE(pickle.has_external_data());
+  EXPECT_EQ(expected.size(), pickle.size());
+  std::vector<StringPiece> segments;
+  pickle.GetDataSegments(&segments);
+  EXPECT_EQ(5u, segments.size());
+  EXPECT_EQ(expected_data, JoinDataSegments(pickle));
+
+  // Copies share the referenced data.
+  Pickle copy(pickle);
+  EXPECT_TRUE(copy.has_external_data());
+  EXPECT_EQ(expected_data, JoinDataSegments(copy));
+  Pickle assigned;
+  assigned = pickle;
+  EXPECT_TRUE(assigned.has_external_data());
+  EXPECT_EQ(expected_data, JoinDataSegments(assigned));
+
+  // Reading flattens the pickle.
+  PickleIterator iter(pickle);
+  EXPECT_FALSE(pickle.has_external_data());
+  int outint;
+  const char* outdata;
+  int outdatalen;
+  std::string outstr;
+  EXPECT_TRUE(iter.ReadInt(&outint));
+  EXPECT_EQ(testint, outint);
+  EXPECT_TRUE(iter.ReadData(&outdata, &outdatalen));
+  EXPECT_EQ("hello", std::string(outdata, outdatalen));
+  EXPECT_TRUE(iter.ReadString(&outstr));
+  EXPECT_EQ(teststr, outstr);
+  EXPECT_TRUE(iter.ReadString(&outstr));
+  EXPECT_EQ(blob, outstr);
+  EXPECT_TRUE(iter.ReadData(&outdata, &outdatalen));
+  EXPECT_EQ(0, outdatalen);
+  EXPECT_TRUE(iter.ReadInt(&outint));
+  EXPECT_EQ(testint, outint);
+  EXPECT_EQ(expected_data,
+            std::string(static_cast<const char*>(pickle.data()),
+                        pickle.size()));
+
+  // The flattened pickle can still be written to.
+  EXPECT_TRUE(pickle.WriteInt(testint));
+  EXPECT_TRUE(expected.WriteInt(testint));
+  EXPECT_EQ(std::string(static_cast<const char*>(expected.data()),
+                        expected.size()),
+            std::string(static_cast<const char*>(pickle.data()),
+                        pickle.size()));
+
+  // The copies are unaffected.
+  EXPECT_TRUE(copy.has_external_data());
+  EXPECT_EQ(expected_data, std::string(static_cast<const char*>(copy.data()),
+                                       copy.size()));
+}
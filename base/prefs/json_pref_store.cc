@@ -19,6 +19,7 @@
 #include "base/strings/string_util.h"
 #include "base/task_runner_util.h"
 #include "base/threading/sequenced_worker_pool.h"
+#include "base/time/time.h"
 #include "base/values.h"
 
 // Result returned from internal read tasks.
@@ -47,6 +48,14 @@ namespace {
 // Some extensions we'll tack on to copies of the Preferences files.
 const base::FilePath::CharType kBadExtension[] = FILE_PATH_LITERAL("bad");
 
+// Returns the suffix of the histograms of the file at |path|.
+std::string GetHistogramSuffix(const base::FilePath& path) {
+  std::string spaceless_basename;
+  base::ReplaceChars(path.BaseName().MaybeAsASCII(), " ", "_",
+                     &spaceless_basename);
+  return spaceless_basename;
+}
+
 PersistentPrefStore::PrefReadError HandleReadErrors(
     const base::Value* value,
     const base::FilePath& path,
@@ -104,7 +113,23 @@ scoped_ptr<JsonPrefStore::ReadResult> ReadPrefsFromDisk(
   scoped_ptr<JsonPrefStore::ReadResult> read_result(
       new JsonPrefStore::ReadResult);
   JSONFileValueSerializer serializer(path);
+  // Parse the file in place rather than reading a copy of it. The file is
+  // unmapped once parsed, so the prefs don't refer to it.
+  serializer.set_map_file(true);
+  base::TimeTicks start = base::TimeTicks::Now();
   read_result->value.reset(serializer.Deserialize(&error_code, &error_msg));
+
+  // The histogram below is an expansion of the UMA_HISTOGRAM_TIMES macro
+  // adapted to allow for a dynamically suffixed histogram name.
+  // Note: The factory creates and owns the histogram.
+  base::HistogramBase* histogram = base::Histogram::FactoryTimeGet(
+      "Settings.JsonDataReadTime." + GetHistogramSuffix(path),
+      base::TimeDelta::FromMilliseconds(1),
+      base::TimeDelta::FromSeconds(10),
+      50,
+      base::HistogramBase::kUmaTargetedHistogramFlag);
+  histogram->AddTime(base::TimeTicks::Now() - start);
+
   read_result->error =
       HandleReadErrors(read_result->value.get(), path, error_code, error_msg);
   read_result->no_dir = !base::PathExists(path.DirName());
@@ -393,16 +418,12 @@ bool JsonPrefStore::SerializeData(std::string* output) {
   bool result = serializer.Serialize(*prefs_);
 
   if (result) {
-    std::string spaceless_basename;
-    base::ReplaceChars(path_.BaseName().MaybeAsASCII(), " ", "_",
-                       &spaceless_basename);
-
     // The histogram below is an expansion of the UMA_HISTOGRAM_COUNTS_10000
     // macro adapted to allow for a dynamically suffixed histogram name.
     // Note: The factory creates and owns the histogram.
     base::HistogramBase* histogram =
         base::LinearHistogram::FactoryGet(
-            "Settings.JsonDataSizeKilobytes." + spaceless_basename,
+            "Settings.JsonDataSizeKilobytes." + GetHistogramSuffix(path_),
             1,
             10000,
             50,
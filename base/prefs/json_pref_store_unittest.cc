@@ -329,6 +329,45 @@ TEST_F(JsonPrefStoreTest, PreserveEmptyValues) {
   EXPECT_TRUE(DictionaryValue().Equals(result));
 }
 
+// The prefs file is mapped to be parsed, so check that the loaded prefs don't
+// refer to it: they must outlive the file being truncated in place or
+// replaced.
+TEST_F(JsonPrefStoreTest, ReplaceLoadedFile) {
+  FilePath pref_file = temp_dir_.path().AppendASCII("replaced.json");
+  const char kContents[] = "{\"homepage\": \"http://www.cnn.com\"}";
+  ASSERT_EQ(static_cast<int>(strlen(kContents)),
+            WriteFile(pref_file, kContents, strlen(kContents)));
+
+  scoped_refptr<JsonPrefStore> pref_store = new JsonPrefStore(
+      pref_file,
+      message_loop_.message_loop_proxy(),
+      scoped_ptr<PrefFilter>());
+  ASSERT_EQ(PersistentPrefStore::PREF_READ_ERROR_NONE, pref_store->ReadPrefs());
+
+  ASSERT_EQ(0, WriteFile(pref_file, "", 0));
+  const Value* result = NULL;
+  EXPECT_TRUE(pref_store->GetValue(kHomePage, &result));
+  EXPECT_TRUE(base::StringValue("http://www.cnn.com").Equals(result));
+
+  pref_store->SetValue("other", new base::StringValue("value"));
+  pref_store->CommitPendingWrite();
+  MessageLoop::current()->RunUntilIdle();
+
+  EXPECT_TRUE(pref_store->GetValue(kHomePage, &result));
+  EXPECT_TRUE(base::StringValue("http://www.cnn.com").Equals(result));
+
+  // Reload.
+  pref_store = new JsonPrefStore(
+      pref_file,
+      message_loop_.message_loop_proxy(),
+      scoped_ptr<PrefFilter>());
+  ASSERT_EQ(PersistentPrefStore::PREF_READ_ERROR_NONE, pref_store->ReadPrefs());
+  EXPECT_TRUE(pref_store->GetValue(kHomePage, &result));
+  EXPECT_TRUE(base::StringValue("http://www.cnn.com").Equals(result));
+  EXPECT_TRUE(pref_store->GetValue("other", &result));
+  EXPECT_TRUE(base::StringValue("value").Equals(result));
+}
+
 // This test is just documenting some potentially non-obvious behavior. It
 // shouldn't be taken as normative.
 TEST_F(JsonPrefStoreTest, RemoveClearsEmptyParent) {
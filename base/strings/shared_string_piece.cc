@@ -0,0 +1,68 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/strings/shared_string_piece.h"
+
+#include "base/logging.h"
+
+namespace base {
+
+namespace {
+
+StringPiece PieceOf(const RefCountedMemory* buffer) {
+  if (!buffer)
+    return StringPiece();
+  return StringPiece(buffer->front_as<char>(), buffer->size());
+}
+
+}  // namespace
+
+SharedStringPiece::SharedStringPiece() {
+}
+
+SharedStringPiece::SharedStringPiece(const StringPiece& piece) {
+  if (piece.empty())
+    return;
+  std::string str;
+  piece.CopyToString(&str);
+  *this = TakeString(&str);
+}
+
+SharedStringPiece::SharedStringPiece(
+    const scoped_refptr<RefCountedMemory>& buffer)
+    : buffer_(buffer),
+      piece_(PieceOf(buffer.get())) {
+}
+
+SharedStringPiece::SharedStringPiece(
+    const scoped_refptr<RefCountedMemory>& buffer,
+    const StringPiece& piece)
+    : buffer_(buffer),
+      piece_(piece) {
+  DCHECK(piece.empty() ||
+         (buffer.get() && piece.data() >= buffer->front_as<char>() &&
+          piece.data() + piece.size() <=
+              buffer->front_as<char>() + buffer->size()));
+}
+
+SharedStringPiece::~SharedStringPiece() {
+}
+
+// static
+SharedStringPiece SharedStringPiece::TakeString(std::string* str) {
+  if (str->empty())
+    return SharedStringPiece();
+  return SharedStringPiece(
+      scoped_refptr<RefCountedMemory>(RefCountedString::TakeString(str)));
+}
+
+SharedStringPiece SharedStringPiece::substr(size_t pos, size_t n) const {
+  return SharedStringPiece(buffer_, piece_.substr(pos, n));
+}
+
+bool operator==(const SharedStringPiece& x, const SharedStringPiece& y) {
+  return x.piece() == y.piece();
+}
+
+}  // namespace base
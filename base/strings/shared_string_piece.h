@@ -0,0 +1,71 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef BASE_STRINGS_SHARED_STRING_PIECE_H_
+#define BASE_STRINGS_SHARED_STRING_PIECE_H_
+
+#include <string>
+
+#include "base/base_export.h"
+#include "base/memory/ref_counted.h"
+#include "base/memory/ref_counted_memory.h"
+#include "base/strings/string_piece.h"
+
+namespace base {
+
+// A StringPiece which holds a reference to the RefCountedMemory it points
+// into, so that it stays valid for as long as it is kept, and can be copied,
+// passed to other threads and sliced further without copying the characters.
+// The memory is never modified: whoever wants a different string makes a new
+// buffer, and the slices of the old one are unaffected.
+//
+// Use it to keep parts of a large block, such as the values of an HTTP header
+// block, that would otherwise be copied into std::strings.
+class BASE_EXPORT SharedStringPiece {
+ public:
+  SharedStringPiece();
+
+  // Copies |piece| into a new buffer.
+  explicit SharedStringPiece(const StringPiece& piece);
+
+  // Refers to all of |buffer|.
+  explicit SharedStringPiece(const scoped_refptr<RefCountedMemory>& buffer);
+
+  // Refers to |piece|, which must lie within |buffer|.
+  SharedStringPiece(const scoped_refptr<RefCountedMemory>& buffer,
+                    const StringPiece& piece);
+
+  ~SharedStringPiece();
+
+  // Takes the contents of |str|, leaving it empty, without copying them.
+  static SharedStringPiece TakeString(std::string* str);
+
+  // Returns a slice of the same buffer, as StringPiece::substr() does.
+  SharedStringPiece substr(size_t pos, size_t n = StringPiece::npos) const;
+
+  const StringPiece& piece() const { return piece_; }
+  const char* data() const { return piece_.data(); }
+  size_t size() const { return piece_.size(); }
+  bool empty() const { return piece_.empty(); }
+  std::string as_string() const { return piece_.as_string(); }
+
+  // The buffer the piece points into. NULL if empty.
+  const scoped_refptr<RefCountedMemory>& buffer() const { return buffer_; }
+
+ private:
+  scoped_refptr<RefCountedMemory> buffer_;
+  StringPiece piece_;
+};
+
+BASE_EXPORT bool operator==(const SharedStringPiece& x,
+                            const SharedStringPiece& y);
+
+inline bool operator!=(const SharedStringPiece& x,
+                       const SharedStringPiece& y) {
+  return !(x == y);
+}
+
+}  // namespace base
+
+#endif  // BASE_STRINGS_SHARED_STRING_PIECE_H_
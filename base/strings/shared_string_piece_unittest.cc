@@ -0,0 +1,74 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/strings/shared_string_piece.h"
+
+#include <vector>
+
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace base {
+
+TEST(SharedStringPieceTest, Empty) {
+  SharedStringPiece empty;
+  EXPECT_TRUE(empty.empty());
+  EXPECT_EQ(0u, empty.size());
+  EXPECT_FALSE(empty.buffer().get());
+  EXPECT_EQ(empty, SharedStringPiece(StringPiece()));
+
+  std::string str;
+  EXPECT_FALSE(SharedStringPiece::TakeString(&str).buffer().get());
+}
+
+TEST(SharedStringPieceTest, CopiesPiece) {
+  std::string str("hello");
+  SharedStringPiece piece((StringPiece(str)));
+  str[0] = 'j';
+  EXPECT_EQ("hello", piece.as_string());
+  EXPECT_NE(str.data(), piece.data());
+}
+
+TEST(SharedStringPieceTest, TakeString) {
+  // Long enough not to be stored inline by std::string.
+  std::string str(100, 'x');
+  const char* data = str.data();
+  SharedStringPiece piece = SharedStringPiece::TakeString(&str);
+  EXPECT_TRUE(str.empty());
+  EXPECT_EQ(std::string(100, 'x'), piece.as_string());
+  EXPECT_EQ(data, piece.data());
+}
+
+// Slices share the buffer, and keep it alive after the original is gone.
+TEST(SharedStringPieceTest, Substr) {
+  SharedStringPiece world;
+  {
+    std::string str("hello world");
+    SharedStringPiece piece = SharedStringPiece::TakeString(&str);
+    world = piece.substr(6);
+    EXPECT_EQ(piece.buffer().get(), world.buffer().get());
+    EXPECT_EQ(piece.data() + 6, world.data());
+  }
+  EXPECT_EQ("world", world.as_string());
+  EXPECT_EQ("or", world.substr(1, 2).as_string());
+  EXPECT_EQ("world", world.substr(0).as_string());
+  EXPECT_TRUE(world.substr(5).empty());
+  EXPECT_TRUE(world.buffer()->HasOneRef());
+}
+
+TEST(SharedStringPieceTest, Buffer) {
+  std::vector<unsigned char> bytes;
+  bytes.push_back('a');
+  bytes.push_back('b');
+  bytes.push_back('c');
+  scoped_refptr<RefCountedMemory> buffer(RefCountedBytes::TakeVector(&bytes));
+
+  SharedStringPiece all(buffer);
+  EXPECT_EQ("abc", all.as_string());
+  SharedStringPiece part(buffer, StringPiece(buffer->front_as<char>() + 1, 2));
+  EXPECT_EQ("bc", part.as_string());
+  EXPECT_EQ(part, all.substr(1));
+  EXPECT_NE(part, all);
+}
+
+}  // namespace base
@@ -322,22 +322,12 @@ bool ContainsOnlyChars(const StringPiece16& input,
   return input.find_first_not_of(characters) == StringPiece16::npos;
 }
 
-template<class STR>
-static bool DoIsStringASCII(const STR& str) {
-  for (size_t i = 0; i < str.length(); i++) {
-    typename ToUnsigned<typename STR::value_type>::Unsigned c = str[i];
-    if (c > 0x7F)
-      return false;
-  }
-  return true;
-}
-
 bool IsStringASCII(const StringPiece& str) {
-  return DoIsStringASCII(str);
+  return CountLeadingASCII(str.data(), str.length()) == str.length();
 }
 
 bool IsStringASCII(const string16& str) {
-  return DoIsStringASCII(str);
+  return CountLeadingASCII(str.data(), str.length()) == str.length();
 }
 
 bool IsStringUTF8(const std::string& str) {
@@ -5,9 +5,33 @@
 #include "base/strings/utf_string_conversion_utils.h"
 
 #include "base/third_party/icu/icu_utf.h"
+#include "build/build_config.h"
+
+#if defined(ARCH_CPU_X86_FAMILY) && (defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define UTF_CONVERSION_USE_SSE2 1
+#include <emmintrin.h>
+#elif defined(ARCH_CPU_ARM_FAMILY) && \
+    (defined(__ARM_NEON__) || defined(__ARM_NEON))
+#define UTF_CONVERSION_USE_NEON 1
+#include <arm_neon.h>
+#endif
 
 namespace base {
 
+namespace {
+
+#if defined(UTF_CONVERSION_USE_NEON)
+// Returns true if any of the bytes of |v| has its high bit set.
+inline bool AnyHighBitSet(uint8x16_t v) {
+  uint8x8_t folded = vorr_u8(vget_low_u8(v), vget_high_u8(v));
+  return (vget_lane_u64(vreinterpret_u64_u8(folded), 0) &
+          0x8080808080808080ULL) != 0;
+}
+#endif
+
+}  // namespace
+
 // ReadUnicodeCharacter --------------------------------------------------------
 
 bool ReadUnicodeCharacter(const char* src,
@@ -102,6 +126,108 @@ size_t WriteUnicodeCharacter(uint32 code_point, string16* output) {
   return CBU16_MAX_LENGTH;
 }
 
+// ASCII fast paths ------------------------------------------------------------
+
+// The vector loops below stop at the first block containing a non-ASCII
+// character and leave the exact position to the scalar loop that follows.
+
+size_t CountLeadingASCII(const char* src, size_t src_len) {
+  size_t i = 0;
+#if defined(UTF_CONVERSION_USE_SSE2)
+  for (; i + 16 <= src_len; i += 16) {
+    __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+    if (_mm_movemask_epi8(chunk))
+      break;
+  }
+#elif defined(UTF_CONVERSION_USE_NEON)
+  for (; i + 16 <= src_len; i += 16) {
+    if (AnyHighBitSet(vld1q_u8(reinterpret_cast<const uint8*>(src + i))))
+      break;
+  }
+#endif
+  for (; i < src_len; ++i) {
+    if (static_cast<uint8>(src[i]) >= 0x80)
+      break;
+  }
+  return i;
+}
+
+size_t CountLeadingASCII(const char16* src, size_t src_len) {
+  size_t i = 0;
+#if defined(UTF_CONVERSION_USE_SSE2)
+  const __m128i non_ascii_bits = _mm_set1_epi16(static_cast<short>(0xFF80));
+  const __m128i zero = _mm_setzero_si128();
+  for (; i + 8 <= src_len; i += 8) {
+    __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+    __m128i non_ascii = _mm_and_si128(chunk, non_ascii_bits);
+    if (_mm_movemask_epi8(_mm_cmpeq_epi16(non_ascii, zero)) != 0xFFFF)
+      break;
+  }
+#elif defined(UTF_CONVERSION_USE_NEON)
+  const uint16x8_t non_ascii_bits = vdupq_n_u16(0xFF80);
+  for (; i + 8 <= src_len; i += 8) {
+    uint16x8_t non_ascii = vandq_u16(
+        vld1q_u16(reinterpret_cast<const uint16*>(src + i)), non_ascii_bits);
+    uint16x4_t folded =
+        vorr_u16(vget_low_u16(non_ascii), vget_high_u16(non_ascii));
+    if (vget_lane_u64(vreinterpret_u64_u16(folded), 0))
+      break;
+  }
+#endif
+  for (; i < src_len; ++i) {
+    if (src[i] >= 0x80)
+      break;
+  }
+  return i;
+}
+
+void WidenASCII(const char* src, size_t length, char16* dest) {
+  size_t i = 0;
+#if defined(UTF_CONVERSION_USE_SSE2)
+  const __m128i zero = _mm_setzero_si128();
+  for (; i + 16 <= length; i += 16) {
+    __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i),
+                     _mm_unpacklo_epi8(chunk, zero));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i + 8),
+                     _mm_unpackhi_epi8(chunk, zero));
+  }
+#elif defined(UTF_CONVERSION_USE_NEON)
+  for (; i + 16 <= length; i += 16) {
+    uint8x16_t chunk = vld1q_u8(reinterpret_cast<const uint8*>(src + i));
+    vst1q_u16(reinterpret_cast<uint16*>(dest + i),
+              vmovl_u8(vget_low_u8(chunk)));
+    vst1q_u16(reinterpret_cast<uint16*>(dest + i + 8),
+              vmovl_u8(vget_high_u8(chunk)));
+  }
+#endif
+  for (; i < length; ++i)
+    dest[i] = static_cast<uint8>(src[i]);
+}
+
+void NarrowASCII(const char16* src, size_t length, char* dest) {
+  size_t i = 0;
+#if defined(UTF_CONVERSION_USE_SSE2)
+  for (; i + 16 <= length; i += 16) {
+    __m128i low = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+    __m128i high =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 8));
+    // The input is ASCII, so the saturation of the pack never kicks in.
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i),
+                     _mm_packus_epi16(low, high));
+  }
+#elif defined(UTF_CONVERSION_USE_NEON)
+  for (; i + 16 <= length; i += 16) {
+    uint16x8_t low = vld1q_u16(reinterpret_cast<const uint16*>(src + i));
+    uint16x8_t high = vld1q_u16(reinterpret_cast<const uint16*>(src + i + 8));
+    vst1q_u8(reinterpret_cast<uint8*>(dest + i),
+             vcombine_u8(vmovn_u16(low), vmovn_u16(high)));
+  }
+#endif
+  for (; i < length; ++i)
+    dest[i] = static_cast<char>(src[i]);
+}
+
 // Generalized Unicode converter -----------------------------------------------
 
 template<typename CHAR>
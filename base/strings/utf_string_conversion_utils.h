@@ -78,6 +78,22 @@ inline size_t WriteUnicodeCharacter(uint32 code_point, std::wstring* output) {
 }
 #endif  // defined(WCHAR_T_IS_UTF32)
 
+// ASCII fast paths ------------------------------------------------------------
+
+// Most strings are largely ASCII, which converts between UTF-8 and UTF-16 by
+// plain widening or narrowing. These helpers process such runs a vector at a
+// time with SSE2 or NEON where available.
+
+// Returns the number of ASCII characters at the start of |src|.
+BASE_EXPORT size_t CountLeadingASCII(const char* src, size_t src_len);
+BASE_EXPORT size_t CountLeadingASCII(const char16* src, size_t src_len);
+
+// Converts |length| ASCII characters from |src| to UTF-16 in |dest|.
+BASE_EXPORT void WidenASCII(const char* src, size_t length, char16* dest);
+
+// Converts |length| ASCII characters from |src| to UTF-8 in |dest|.
+BASE_EXPORT void NarrowASCII(const char16* src, size_t length, char* dest);
+
 // Generalized Unicode converter -----------------------------------------------
 
 // Guesses the length of the output in UTF-8 in bytes, clears that output
@@ -14,6 +14,44 @@ namespace {
 
 // Generalized Unicode converter -----------------------------------------------
 
+// Copies the run of ASCII characters starting at |*char_index| to |output| and
+// advances |*char_index| past it. This is the general version; the overloads
+// below handle UTF-8 <-> UTF-16 a vector at a time.
+template<typename SRC_CHAR, typename DEST_STRING>
+void ConvertASCIIRun(const SRC_CHAR* src,
+                     int32 src_len,
+                     int32* char_index,
+                     DEST_STRING* output) {
+  int32 i = *char_index;
+  while (i < src_len && static_cast<uint32>(src[i]) < 0x80) {
+    output->push_back(static_cast<typename DEST_STRING::value_type>(src[i]));
+    i++;
+  }
+  *char_index = i;
+}
+
+void ConvertASCIIRun(const char* src,
+                     int32 src_len,
+                     int32* char_index,
+                     string16* output) {
+  size_t length = CountLeadingASCII(src + *char_index, src_len - *char_index);
+  size_t old_size = output->size();
+  output->resize(old_size + length);
+  WidenASCII(src + *char_index, length, &(*output)[old_size]);
+  *char_index += static_cast<int32>(length);
+}
+
+void ConvertASCIIRun(const char16* src,
+                     int32 src_len,
+                     int32* char_index,
+                     std::string* output) {
+  size_t length = CountLeadingASCII(src + *char_index, src_len - *char_index);
+  size_t old_size = output->size();
+  output->resize(old_size + length);
+  NarrowASCII(src + *char_index, length, &(*output)[old_size]);
+  *char_index += static_cast<int32>(length);
+}
+
 // Converts the given source Unicode character type to the given destination
 // Unicode character type as a STL string. The given input buffer and size
 // determine the source, and the given output STL string will be replaced by
@@ -25,7 +63,13 @@ bool ConvertUnicode(const SRC_CHAR* src,
   // ICU requires 32-bit numbers.
   bool success = true;
   int32 src_len32 = static_cast<int32>(src_len);
-  for (int32 i = 0; i < src_len32; i++) {
+  int32 i = 0;
+  while (i < src_len32) {
+    if (static_cast<uint32>(src[i]) < 0x80) {
+      ConvertASCIIRun(src, src_len32, &i, output);
+      continue;
+    }
+
     uint32 code_point;
     if (ReadUnicodeCharacter(src, src_len32, &i, &code_point)) {
       WriteUnicodeCharacter(code_point, output);
@@ -33,6 +77,7 @@ bool ConvertUnicode(const SRC_CHAR* src,
       WriteUnicodeCharacter(0xFFFD, output);
       success = false;
     }
+    i++;
   }
 
   return success;
@@ -0,0 +1,210 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <string>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "base/strings/string16.h"
+#include "base/strings/string_util.h"
+#include "base/strings/utf_string_conversion_utils.h"
+#include "base/strings/utf_string_conversions.h"
+#include "base/time/time.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "testing/perf/perf_test.h"
+
+namespace base {
+
+namespace {
+
+// Each corpus is converted until at least this many bytes have been processed.
+const size_t kBytesPerMeasurement = 64 * 1024 * 1024;
+
+// The pre-SIMD conversion loop, one code point at a time, as the baseline.
+template<typename SRC_CHAR, typename DEST_STRING>
+void ScalarConvert(const SRC_CHAR* src, size_t src_len, DEST_STRING* output) {
+  output->clear();
+  int32 src_len32 = static_cast<int32>(src_len);
+  for (int32 i = 0; i < src_len32; i++) {
+    uint32 code_point;
+    if (ReadUnicodeCharacter(src, src_len32, &i, &code_point))
+      WriteUnicodeCharacter(code_point, output);
+    else
+      WriteUnicodeCharacter(0xFFFD, output);
+  }
+}
+
+bool ScalarIsStringASCII(const std::string& str) {
+  for (size_t i = 0; i < str.length(); i++) {
+    if (static_cast<uint8>(str[i]) > 0x7F)
+      return false;
+  }
+  return true;
+}
+
+struct Corpus {
+  std::string name;
+  std::vector<std::string> strings;
+  size_t total_bytes;
+};
+
+Corpus MakeCorpus(const std::string& name,
+                  const char* const* strings,
+                  size_t count) {
+  Corpus corpus;
+  corpus.name = name;
+  corpus.total_bytes = 0;
+  for (size_t i = 0; i < count; ++i) {
+    corpus.strings.push_back(strings[i]);
+    corpus.total_bytes += corpus.strings.back().size();
+  }
+  return corpus;
+}
+
+std::vector<Corpus> MakeCorpora() {
+  const char* const kURLs[] = {
+    "https://www.google.com/search?q=chromium+base+strings&ie=UTF-8&oe=UTF-8",
+    "http://example.com/",
+    "https://en.wikipedia.org/wiki/UTF-16#Byte_order_encoding_schemes",
+    "https://mail.google.com/mail/u/0/#inbox/14a8c3f2d7e9b1a0",
+    "chrome-extension://aapocclcgogkmnckokdopfmhonfmgoek/main.html",
+    "https://fonts.googleapis.com/css?family=Roboto:400,700&subset=latin",
+  };
+  const char* const kHeaders[] = {
+    "Content-Type: text/html; charset=utf-8",
+    "Cache-Control: private, max-age=0, must-revalidate",
+    "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 "
+        "(KHTML, like Gecko) Chrome/38.0.2125.0 Safari/537.36",
+    "Accept-Language: en-US,en;q=0.8",
+    "Set-Cookie: NID=67=abcdefghijklmnopqrstuvwxyz0123456789; "
+        "expires=Fri, 01-Jan-2016 00:00:00 GMT; path=/; domain=.google.com",
+  };
+  const char* const kJSONKeys[] = {
+    "browser", "enabled", "last_known_google_url", "window_placement",
+    "profile.content_settings.pattern_pairs", "homepage_is_newtabpage",
+    "extensions.settings", "download.default_directory",
+  };
+  const char* const kMixed[] = {
+    // "Поиск страниц на русском"
+    "\xD0\x9F\xD0\xBE\xD0\xB8\xD1\x81\xD0\xBA \xD1\x81\xD1\x82\xD1\x80\xD0\xB0"
+    "\xD0\xBD\xD0\xB8\xD1\x86 \xD0\xBD\xD0\xB0 \xD1\x80\xD1\x83\xD1\x81\xD1\x81"
+    "\xD0\xBA\xD0\xBE\xD0\xBC",
+    // A mostly ASCII title with a few accented characters.
+    "Caf\xC3\xA9 M\xC3\xBCller - Stra\xC3\x9F" "e 12, M\xC3\xBCnchen - Google Maps",
+    // "网页 图片 资讯更多"
+    "\xE7\xBD\x91\xE9\xA1\xB5 \xE5\x9B\xBE\xE7\x89\x87 "
+    "\xE8\xB5\x84\xE8\xAE\xAF\xE6\x9B\xB4\xE5\xA4\x9A",
+  };
+
+  std::vector<Corpus> corpora;
+  corpora.push_back(MakeCorpus("urls", kURLs, arraysize(kURLs)));
+  corpora.push_back(MakeCorpus("headers", kHeaders, arraysize(kHeaders)));
+  corpora.push_back(MakeCorpus("json_keys", kJSONKeys, arraysize(kJSONKeys)));
+  corpora.push_back(MakeCorpus("mixed", kMixed, arraysize(kMixed)));
+  return corpora;
+}
+
+void PrintThroughput(const std::string& measurement,
+                     const std::string& corpus,
+                     const std::string& trace,
+                     size_t bytes,
+                     TimeDelta elapsed) {
+  perf_test::PrintResult(measurement, "_" + corpus, trace,
+                         bytes / elapsed.InSecondsF() / (1024 * 1024),
+                         "MB/s", true);
+}
+
+}  // namespace
+
+TEST(UTFStringConversionsPerfTest, UTF8ToUTF16) {
+  std::vector<Corpus> corpora = MakeCorpora();
+  for (size_t c = 0; c < corpora.size(); ++c) {
+    const Corpus& corpus = corpora[c];
+    size_t iterations = kBytesPerMeasurement / corpus.total_bytes;
+    string16 output;
+
+    TimeTicks start = TimeTicks::HighResNow();
+    for (size_t n = 0; n < iterations; ++n) {
+      for (size_t i = 0; i < corpus.strings.size(); ++i) {
+        const std::string& str = corpus.strings[i];
+        ScalarConvert(str.data(), str.size(), &output);
+      }
+    }
+    PrintThroughput("utf8_to_utf16", corpus.name, "scalar",
+                    iterations * corpus.total_bytes,
+                    TimeTicks::HighResNow() - start);
+
+    start = TimeTicks::HighResNow();
+    for (size_t n = 0; n < iterations; ++n) {
+      for (size_t i = 0; i < corpus.strings.size(); ++i) {
+        const std::string& str = corpus.strings[i];
+        UTF8ToUTF16(str.data(), str.size(), &output);
+      }
+    }
+    PrintThroughput("utf8_to_utf16", corpus.name, "simd",
+                    iterations * corpus.total_bytes,
+                    TimeTicks::HighResNow() - start);
+  }
+}
+
+TEST(UTFStringConversionsPerfTest, UTF16ToUTF8) {
+  std::vector<Corpus> corpora = MakeCorpora();
+  for (size_t c = 0; c < corpora.size(); ++c) {
+    const Corpus& corpus = corpora[c];
+    std::vector<string16> strings;
+    for (size_t i = 0; i < corpus.strings.size(); ++i)
+      strings.push_back(UTF8ToUTF16(corpus.strings[i]));
+    size_t iterations = kBytesPerMeasurement / corpus.total_bytes;
+    std::string output;
+
+    TimeTicks start = TimeTicks::HighResNow();
+    for (size_t n = 0; n < iterations; ++n) {
+      for (size_t i = 0; i < strings.size(); ++i)
+        ScalarConvert(strings[i].data(), strings[i].size(), &output);
+    }
+    PrintThroughput("utf16_to_utf8", corpus.name, "scalar",
+                    iterations * corpus.total_bytes,
+                    TimeTicks::HighResNow() - start);
+
+    start = TimeTicks::HighResNow();
+    for (size_t n = 0; n < iterations; ++n) {
+      for (size_t i = 0; i < strings.size(); ++i)
+        UTF16ToUTF8(strings[i].data(), strings[i].size(), &output);
+    }
+    PrintThroughput("utf16_to_utf8", corpus.name, "simd",
+                    iterations * corpus.total_bytes,
+                    TimeTicks::HighResNow() - start);
+  }
+}
+
+TEST(UTFStringConversionsPerfTest, IsStringASCII) {
+  std::vector<Corpus> corpora = MakeCorpora();
+  for (size_t c = 0; c < corpora.size(); ++c) {
+    const Corpus& corpus = corpora[c];
+    size_t iterations = kBytesPerMeasurement / corpus.total_bytes;
+    // Accumulate the results so the calls are not optimized away.
+    size_t ascii_count = 0;
+
+    TimeTicks start = TimeTicks::HighResNow();
+    for (size_t n = 0; n < iterations; ++n) {
+      for (size_t i = 0; i < corpus.strings.size(); ++i)
+        ascii_count += ScalarIsStringASCII(corpus.strings[i]);
+    }
+    PrintThroughput("is_string_ascii", corpus.name, "scalar",
+                    iterations * corpus.total_bytes,
+                    TimeTicks::HighResNow() - start);
+
+    start = TimeTicks::HighResNow();
+    for (size_t n = 0; n < iterations; ++n) {
+      for (size_t i = 0; i < corpus.strings.size(); ++i)
+        ascii_count -= IsStringASCII(corpus.strings[i]);
+    }
+    PrintThroughput("is_string_ascii", corpus.name, "simd",
+                    iterations * corpus.total_bytes,
+                    TimeTicks::HighResNow() - start);
+    EXPECT_EQ(0u, ascii_count);
+  }
+}
+
+}  // namespace base
@@ -208,4 +208,47 @@ TEST(UTFStringConversionsTest, ConvertMultiString) {
   EXPECT_EQ(expected, converted);
 }
 
+// The ASCII fast paths work on blocks of characters; make sure every position
+// of a non-ASCII character relative to the block boundaries is handled.
+TEST(UTFStringConversionsTest, ASCIIRunBoundaries) {
+  for (size_t length = 0; length < 50; ++length) {
+    std::string ascii_utf8;
+    string16 ascii_utf16;
+    for (size_t i = 0; i < length; ++i) {
+      ascii_utf8.push_back(static_cast<char>('a' + i % 26));
+      ascii_utf16.push_back(static_cast<char16>('a' + i % 26));
+    }
+    EXPECT_EQ(ascii_utf16, UTF8ToUTF16(ascii_utf8));
+    EXPECT_EQ(ascii_utf8, UTF16ToUTF8(ascii_utf16));
+    EXPECT_TRUE(IsStringASCII(ascii_utf8));
+    EXPECT_TRUE(IsStringASCII(ascii_utf16));
+
+    for (size_t pos = 0; pos < length; ++pos) {
+      // U+00E9, which is two bytes in UTF-8.
+      std::string utf8 = ascii_utf8;
+      utf8.replace(pos, 1, "\xc3\xa9");
+      string16 utf16 = ascii_utf16;
+      utf16[pos] = 0xE9;
+      EXPECT_EQ(utf16, UTF8ToUTF16(utf8)) << length << " " << pos;
+      EXPECT_EQ(utf8, UTF16ToUTF8(utf16)) << length << " " << pos;
+      EXPECT_FALSE(IsStringASCII(utf8)) << length << " " << pos;
+      EXPECT_FALSE(IsStringASCII(utf16)) << length << " " << pos;
+
+      // U+0100 has none of the bits of an ASCII character's low byte set.
+      utf16[pos] = 0x100;
+      EXPECT_FALSE(IsStringASCII(utf16)) << length << " " << pos;
+
+      // Invalid UTF-8 is still replaced with U+FFFD.
+      std::string invalid_utf8 = ascii_utf8;
+      invalid_utf8[pos] = '\xff';
+      string16 replaced = ascii_utf16;
+      replaced[pos] = 0xFFFD;
+      string16 converted;
+      EXPECT_FALSE(UTF8ToUTF16(invalid_utf8.data(), invalid_utf8.length(),
+                               &converted));
+      EXPECT_EQ(replaced, converted) << length << " " << pos;
+    }
+  }
+}
+
 }  // base
@@ -4,6 +4,8 @@
 
 #include "base/threading/sequenced_worker_pool.h"
 
+#include <algorithm>
+#include <deque>
 #include <list>
 #include <map>
 #include <set>
@@ -250,12 +252,17 @@ class SequencedWorkerPool::Worker : public SimpleThread {
     return running_sequence_;
   }
 
+  // Zero-based index of this worker, used to find its deque in
+  // WORK_STEALING mode.
+  size_t index() const { return index_; }
+
   WorkerShutdown running_shutdown_behavior() const {
     return running_shutdown_behavior_;
   }
 
  private:
   scoped_refptr<SequencedWorkerPool> worker_pool_;
+  const size_t index_;
   SequenceToken running_sequence_;
   WorkerShutdown running_shutdown_behavior_;
 
@@ -270,6 +277,7 @@ class SequencedWorkerPool::Inner {
   // by it).
   Inner(SequencedWorkerPool* worker_pool, size_t max_threads,
         const std::string& thread_name_prefix,
+        SchedulingMode scheduling_mode,
         TestingObserver* observer);
 
   ~Inner();
@@ -347,10 +355,41 @@ class SequencedWorkerPool::Inner {
   // In any case, the calling code should clear the given
   // delete_these_outside_lock vector the next time the lock is released.
   // See the implementation for a more detailed description.
-  GetWorkStatus GetWork(SequencedTask* task,
+  GetWorkStatus GetWork(const Worker* this_worker,
+                        SequencedTask* task,
                         TimeDelta* wait_time,
                         std::vector<Closure>* delete_these_outside_lock);
 
+  // The WORK_STEALING implementation of GetWork().
+  GetWorkStatus GetWorkStealing(
+      const Worker* this_worker,
+      SequencedTask* task,
+      TimeDelta* wait_time,
+      std::vector<Closure>* delete_these_outside_lock);
+
+  // Called from within the lock, adds |task| to the pending work. |delayed|
+  // is true if the task must not run before its time_to_run.
+  void LockedEnqueueTask(const SequencedTask& task, bool delayed);
+
+  // WORK_STEALING helpers, called from within the lock.
+  //
+  // Makes |task| available to workers: sequenced tasks are appended to their
+  // sequence's queue, unsequenced ones to the deque of |worker_index|.
+  void LockedEnqueueReadyTask(const SequencedTask& task, size_t worker_index);
+  // Moves delayed tasks whose time has come into the ready structures.
+  void LockedPromoteDueDelayedTasks(TimeTicks now, size_t worker_index);
+  // Removes the oldest task available to |worker_index| and stores it in
+  // |task|, taking either from a runnable sequence, the worker's own deque,
+  // or (if that is empty) another worker's deque. Returns false if nothing is
+  // ready to run.
+  bool LockedTakeReadyTask(size_t worker_index, SequencedTask* task);
+  // Returns the index of the deque that a task posted from the current
+  // thread should go to.
+  size_t LockedWorkerIndexForPost();
+
+  // Returns true if there are pending tasks of any kind.
+  bool LockedHasPendingTasks() const;
+
   void HandleCleanup();
 
   // Peforms init and cleanup around running the given task. WillRun...
@@ -445,6 +484,33 @@ class SequencedWorkerPool::Inner {
   typedef std::set<SequencedTask, SequencedTaskLessThan> PendingTaskSet;
   PendingTaskSet pending_tasks_;
 
+  const SchedulingMode scheduling_mode_;
+
+  // The members below hold pending tasks in WORK_STEALING mode, in which case
+  // |pending_tasks_| stays empty.
+  typedef std::deque<SequencedTask> TaskDeque;
+
+  // Ready-to-run unsequenced tasks, one deque per potential worker. The owner
+  // takes from the front; other workers steal from the back.
+  std::vector<TaskDeque> worker_queues_;
+  size_t ready_unsequenced_task_count_;
+
+  // Round-robin cursor for distributing tasks posted from non-worker threads.
+  size_t next_worker_queue_for_post_;
+
+  // Per-sequence FIFOs of ready tasks, keyed by sequence token ID.
+  std::map<int, TaskDeque> sequence_queues_;
+
+  // Sequences that have queued tasks and are not currently running, in the
+  // order in which they became runnable.
+  std::deque<int> runnable_sequences_;
+
+  // Tasks that are not due yet, in time-to-run order.
+  PendingTaskSet delayed_tasks_;
+
+  // Total number of tasks held in any of the structures above.
+  size_t work_stealing_pending_task_count_;
+
   // The next sequence number for a new sequenced task.
   int64 next_sequence_task_number_;
 
@@ -484,6 +550,7 @@ SequencedWorkerPool::Worker::Worker(
     const std::string& prefix)
     : SimpleThread(prefix + StringPrintf("Worker%d", thread_number)),
       worker_pool_(worker_pool),
+      index_(thread_number - 1),
       running_shutdown_behavior_(CONTINUE_ON_SHUTDOWN) {
   Start();
 }
@@ -516,6 +583,7 @@ SequencedWorkerPool::Inner::Inner(
     SequencedWorkerPool* worker_pool,
     size_t max_threads,
     const std::string& thread_name_prefix,
+    SchedulingMode scheduling_mode,
     TestingObserver* observer)
     : worker_pool_(worker_pool),
       lock_(),
@@ -526,6 +594,10 @@ SequencedWorkerPool::Inner::Inner(
       thread_being_created_(false),
       waiting_thread_count_(0),
       blocking_shutdown_thread_count_(0),
+      scheduling_mode_(scheduling_mode),
+      ready_unsequenced_task_count_(0),
+      next_worker_queue_for_post_(0),
+      work_stealing_pending_task_count_(0),
       next_sequence_task_number_(0),
       blocking_shutdown_pending_task_count_(0),
       trace_id_(0),
@@ -534,7 +606,10 @@ SequencedWorkerPool::Inner::Inner(
       cleanup_state_(CLEANUP_DONE),
       cleanup_idlers_(0),
       cleanup_cv_(&lock_),
-      testing_observer_(observer) {}
+      testing_observer_(observer) {
+  if (scheduling_mode_ == WORK_STEALING)
+    worker_queues_.resize(max_threads_);
+}
 
 SequencedWorkerPool::Inner::~Inner() {
   // You must call Shutdown() before destroying the pool.
@@ -608,7 +683,7 @@ bool SequencedWorkerPool::Inner::PostTask(
     if (optional_token_name)
       sequenced.sequence_token_id = LockedGetNamedTokenID(*optional_token_name);
 
-    pending_tasks_.insert(sequenced);
+    LockedEnqueueTask(sequenced, delay > TimeDelta());
     if (shutdown_behavior == BLOCK_SHUTDOWN)
       blocking_shutdown_pending_task_count_++;
 
@@ -647,7 +722,7 @@ void SequencedWorkerPool::Inner::CleanupForTesting() {
   CHECK_EQ(CLEANUP_DONE, cleanup_state_);
   if (shutdown_called_)
     return;
-  if (pending_tasks_.empty() && waiting_thread_count_ == threads_.size())
+  if (!LockedHasPendingTasks() && waiting_thread_count_ == threads_.size())
     return;
   cleanup_state_ = CLEANUP_REQUESTED;
   cleanup_idlers_ = 0;
@@ -729,8 +804,8 @@ void SequencedWorkerPool::Inner::ThreadLoop(Worker* this_worker) {
       SequencedTask task;
       TimeDelta wait_time;
       std::vector<Closure> delete_these_outside_lock;
-      GetWorkStatus status =
-          GetWork(&task, &wait_time, &delete_these_outside_lock);
+      GetWorkStatus status = GetWork(
+          this_worker, &task, &wait_time, &delete_these_outside_lock);
       if (status == GET_WORK_FOUND) {
         TRACE_EVENT_FLOW_END0(TRACE_DISABLED_BY_DEFAULT("toplevel.flow"),
             "SequencedWorkerPool::PostTask",
@@ -898,11 +973,17 @@ SequencedWorkerPool::Inner::LockedCurrentThreadShutdownBehavior() const {
 }
 
 SequencedWorkerPool::Inner::GetWorkStatus SequencedWorkerPool::Inner::GetWork(
+    const Worker* this_worker,
     SequencedTask* task,
     TimeDelta* wait_time,
     std::vector<Closure>* delete_these_outside_lock) {
   lock_.AssertAcquired();
 
+  if (scheduling_mode_ == WORK_STEALING) {
+    return GetWorkStealing(
+        this_worker, task, wait_time, delete_these_outside_lock);
+  }
+
 #if !defined(OS_NACL)
   UMA_HISTOGRAM_COUNTS_100("SequencedWorkerPool.TaskCount",
                            static_cast<int>(pending_tasks_.size()));
@@ -998,6 +1079,190 @@ SequencedWorkerPool::Inner::GetWorkStatus SequencedWorkerPool::Inner::GetWork(
   return status;
 }
 
+SequencedWorkerPool::Inner::GetWorkStatus
+SequencedWorkerPool::Inner::GetWorkStealing(
+    const Worker* this_worker,
+    SequencedTask* task,
+    TimeDelta* wait_time,
+    std::vector<Closure>* delete_these_outside_lock) {
+  lock_.AssertAcquired();
+  DCHECK_EQ(WORK_STEALING, scheduling_mode_);
+
+#if !defined(OS_NACL)
+  UMA_HISTOGRAM_COUNTS_100("SequencedWorkerPool.TaskCount",
+                           static_cast<int>(work_stealing_pending_task_count_));
+#endif
+
+  const size_t worker_index = this_worker->index();
+  const TimeTicks current_time = TimeTicks::Now();
+  // Once shutdown has started, delayed tasks (which are never BLOCK_SHUTDOWN)
+  // will not run. Make them all ready so the loop below deletes each one as
+  // soon as its sequence allows, just like SHARED_QUEUE mode does.
+  LockedPromoteDueDelayedTasks(
+      shutdown_called_ ? TimeTicks::FromInternalValue(kint64max)
+                       : current_time,
+      worker_index);
+
+  while (LockedTakeReadyTask(worker_index, task)) {
+    if (shutdown_called_ && task->shutdown_behavior != BLOCK_SHUTDOWN) {
+      // See GetWork() for why these are deleted outside the lock. The task's
+      // sequence is not running, so let the next task in it be picked up.
+      delete_these_outside_lock->push_back(task->task);
+      if (task->sequence_token_id &&
+          ContainsKey(sequence_queues_, task->sequence_token_id)) {
+        runnable_sequences_.push_front(task->sequence_token_id);
+      }
+      continue;
+    }
+
+    if (task->shutdown_behavior == BLOCK_SHUTDOWN)
+      blocking_shutdown_pending_task_count_--;
+    return GET_WORK_FOUND;
+  }
+
+  if (delayed_tasks_.empty())
+    return GET_WORK_NOT_FOUND;
+
+  if (cleanup_state_ == CLEANUP_RUNNING) {
+    // Deferred tasks are deleted when cleaning up, see Inner::ThreadLoop.
+    for (PendingTaskSet::const_iterator i = delayed_tasks_.begin();
+         i != delayed_tasks_.end(); ++i) {
+      delete_these_outside_lock->push_back(i->task);
+    }
+    work_stealing_pending_task_count_ -= delayed_tasks_.size();
+    delayed_tasks_.clear();
+    *wait_time = TimeDelta();
+    return GET_WORK_WAIT;
+  }
+
+  *wait_time = delayed_tasks_.begin()->time_to_run - current_time;
+  return GET_WORK_WAIT;
+}
+
+void SequencedWorkerPool::Inner::LockedEnqueueTask(const SequencedTask& task,
+                                                   bool delayed) {
+  lock_.AssertAcquired();
+  if (scheduling_mode_ == SHARED_QUEUE) {
+    pending_tasks_.insert(task);
+    return;
+  }
+
+  work_stealing_pending_task_count_++;
+  if (delayed)
+    delayed_tasks_.insert(task);
+  else
+    LockedEnqueueReadyTask(task, LockedWorkerIndexForPost());
+}
+
+void SequencedWorkerPool::Inner::LockedEnqueueReadyTask(
+    const SequencedTask& task,
+    size_t worker_index) {
+  lock_.AssertAcquired();
+  if (task.sequence_token_id) {
+    TaskDeque& queue = sequence_queues_[task.sequence_token_id];
+    bool was_empty = queue.empty();
+    queue.push_back(task);
+    // A running sequence is re-added by DidRunWorkerTask() instead.
+    if (was_empty && IsSequenceTokenRunnable(task.sequence_token_id))
+      runnable_sequences_.push_back(task.sequence_token_id);
+    return;
+  }
+
+  DCHECK_LT(worker_index, worker_queues_.size());
+  worker_queues_[worker_index].push_back(task);
+  ready_unsequenced_task_count_++;
+}
+
+void SequencedWorkerPool::Inner::LockedPromoteDueDelayedTasks(
+    TimeTicks now,
+    size_t worker_index) {
+  lock_.AssertAcquired();
+  while (!delayed_tasks_.empty() &&
+         delayed_tasks_.begin()->time_to_run <= now) {
+    LockedEnqueueReadyTask(*delayed_tasks_.begin(), worker_index);
+    delayed_tasks_.erase(delayed_tasks_.begin());
+  }
+}
+
+bool SequencedWorkerPool::Inner::LockedTakeReadyTask(size_t worker_index,
+                                                     SequencedTask* task) {
+  lock_.AssertAcquired();
+
+  // Prefer our own deque; otherwise steal the most recently queued task from
+  // the next non-empty deque, leaving the older ones to their owner.
+  TaskDeque* unsequenced_queue = NULL;
+  bool take_front = true;
+  if (!worker_queues_[worker_index].empty()) {
+    unsequenced_queue = &worker_queues_[worker_index];
+  } else if (ready_unsequenced_task_count_ > 0) {
+    for (size_t i = 1; i < worker_queues_.size(); ++i) {
+      TaskDeque* victim =
+          &worker_queues_[(worker_index + i) % worker_queues_.size()];
+      if (!victim->empty()) {
+        unsequenced_queue = victim;
+        take_front = false;
+        break;
+      }
+    }
+    DCHECK(unsequenced_queue);
+  }
+
+  const SequencedTask* unsequenced_candidate = NULL;
+  if (unsequenced_queue) {
+    unsequenced_candidate = take_front ? &unsequenced_queue->front()
+                                       : &unsequenced_queue->back();
+  }
+  std::map<int, TaskDeque>::iterator sequence_queue = sequence_queues_.end();
+  if (!runnable_sequences_.empty()) {
+    sequence_queue = sequence_queues_.find(runnable_sequences_.front());
+    DCHECK(sequence_queue != sequence_queues_.end());
+    DCHECK(IsSequenceTokenRunnable(sequence_queue->first));
+  }
+
+  if (sequence_queue == sequence_queues_.end() && !unsequenced_candidate)
+    return false;
+
+  // Between the two candidates, run whichever was posted first so that
+  // neither sequences nor unsequenced work can starve the other.
+  if (sequence_queue != sequence_queues_.end() &&
+      (!unsequenced_candidate ||
+       sequence_queue->second.front().sequence_task_number <
+           unsequenced_candidate->sequence_task_number)) {
+    runnable_sequences_.pop_front();
+    *task = sequence_queue->second.front();
+    sequence_queue->second.pop_front();
+    if (sequence_queue->second.empty())
+      sequence_queues_.erase(sequence_queue);
+  } else {
+    *task = *unsequenced_candidate;
+    if (take_front)
+      unsequenced_queue->pop_front();
+    else
+      unsequenced_queue->pop_back();
+    ready_unsequenced_task_count_--;
+  }
+  work_stealing_pending_task_count_--;
+  return true;
+}
+
+size_t SequencedWorkerPool::Inner::LockedWorkerIndexForPost() {
+  lock_.AssertAcquired();
+  // Workers keep what they post for themselves; the other threads spread
+  // their tasks across the workers that exist so far.
+  ThreadMap::const_iterator found = threads_.find(PlatformThread::CurrentId());
+  if (found != threads_.end())
+    return found->second->index();
+  size_t num_queues = std::max<size_t>(threads_.size(), 1);
+  return next_worker_queue_for_post_++ % num_queues;
+}
+
+bool SequencedWorkerPool::Inner::LockedHasPendingTasks() const {
+  lock_.AssertAcquired();
+  if (scheduling_mode_ == WORK_STEALING)
+    return work_stealing_pending_task_count_ > 0;
+  return !pending_tasks_.empty();
+}
+
 int SequencedWorkerPool::Inner::WillRunWorkerTask(const SequencedTask& task) {
   lock_.AssertAcquired();
 
@@ -1037,8 +1302,20 @@ void SequencedWorkerPool::Inner::DidRunWorkerTask(const SequencedTask& task) {
     blocking_shutdown_thread_count_--;
   }
 
-  if (task.sequence_token_id)
+  if (task.sequence_token_id) {
     current_sequences_.erase(task.sequence_token_id);
+
+    // In WORK_STEALING mode, tasks posted to this sequence while it was
+    // running have been held back; make the sequence visible again.
+    if (scheduling_mode_ == WORK_STEALING) {
+      std::map<int, TaskDeque>::iterator found =
+          sequence_queues_.find(task.sequence_token_id);
+      if (found != sequence_queues_.end()) {
+        DCHECK(!found->second.empty());
+        runnable_sequences_.push_back(task.sequence_token_id);
+      }
+    }
+  }
 }
 
 bool SequencedWorkerPool::Inner::IsSequenceTokenRunnable(
@@ -1085,6 +1362,13 @@ int SequencedWorkerPool::Inner::PrepareToStartAdditionalThreadIfHelpful() {
       cleanup_state_ == CLEANUP_DONE &&
       threads_.size() < max_threads_ &&
       waiting_thread_count_ == 0) {
+    if (scheduling_mode_ == WORK_STEALING) {
+      if (ready_unsequenced_task_count_ == 0 && runnable_sequences_.empty())
+        return 0;
+      thread_being_created_ = true;
+      return static_cast<int>(threads_.size() + 1);
+    }
+
     // We could use an additional thread if there's work to be done.
     for (PendingTaskSet::const_iterator i = pending_tasks_.begin();
          i != pending_tasks_.end(); ++i) {
@@ -1145,15 +1429,27 @@ SequencedWorkerPool::SequencedWorkerPool(
     size_t max_threads,
     const std::string& thread_name_prefix)
     : constructor_message_loop_(MessageLoopProxy::current()),
-      inner_(new Inner(this, max_threads, thread_name_prefix, NULL)) {
+      inner_(new Inner(this, max_threads, thread_name_prefix, SHARED_QUEUE,
+                       NULL)) {
+}
+
+SequencedWorkerPool::SequencedWorkerPool(
+    size_t max_threads,
+    const std::string& thread_name_prefix,
+    TestingObserver* observer)
+    : constructor_message_loop_(MessageLoopProxy::current()),
+      inner_(new Inner(this, max_threads, thread_name_prefix, SHARED_QUEUE,
+                       observer)) {
 }
 
 SequencedWorkerPool::SequencedWorkerPool(
     size_t max_threads,
     const std::string& thread_name_prefix,
+    SchedulingMode scheduling_mode,
     TestingObserver* observer)
     : constructor_message_loop_(MessageLoopProxy::current()),
-      inner_(new Inner(this, max_threads, thread_name_prefix, observer)) {
+      inner_(new Inner(this, max_threads, thread_name_prefix, scheduling_mode,
+                       observer)) {
 }
 
 SequencedWorkerPool::~SequencedWorkerPool() {}
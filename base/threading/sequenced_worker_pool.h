@@ -118,6 +118,24 @@ class BASE_EXPORT SequencedWorkerPool : public TaskRunner {
     BLOCK_SHUTDOWN,
   };
 
+  // Selects how the pool organizes pending work. Both modes honor the
+  // SequenceToken and WorkerShutdown guarantees described above.
+  enum SchedulingMode {
+    // All pending tasks live in a single time-ordered set which workers scan
+    // for the first task whose sequence is not already running. Tasks start
+    // in posting order, but picking a task costs O(pending tasks).
+    SHARED_QUEUE,
+
+    // Unsequenced tasks go to per-worker deques: a worker posting to the pool
+    // pushes to its own deque and idle workers steal from the others. Each
+    // sequence gets its own FIFO queue that only becomes visible to workers
+    // while nothing else from that sequence is running, and delayed tasks wait
+    // in a separate time-ordered set. Picking a task is O(1) in the number of
+    // pending tasks, at the cost of only approximate FIFO order across
+    // different sequences.
+    WORK_STEALING,
+  };
+
   // Opaque identifier that defines sequencing of tasks posted to the worker
   // pool.
   class SequenceToken {
@@ -171,6 +189,13 @@ class BASE_EXPORT SequencedWorkerPool : public TaskRunner {
                       const std::string& thread_name_prefix,
                       TestingObserver* observer);
 
+  // Like above, but with an explicit |scheduling_mode|. The other
+  // constructors use SHARED_QUEUE. |observer| may be NULL.
+  SequencedWorkerPool(size_t max_threads,
+                      const std::string& thread_name_prefix,
+                      SchedulingMode scheduling_mode,
+                      TestingObserver* observer);
+
   // Returns a unique token that can be used to sequence tasks posted to
   // PostSequencedWorkerTask(). Valid tokens are always nonzero.
   SequenceToken GetSequenceToken();
@@ -0,0 +1,184 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "base/atomicops.h"
+#include "base/base_switches.h"
+#include "base/bind.h"
+#include "base/command_line.h"
+#include "base/message_loop/message_loop.h"
+#include "base/synchronization/waitable_event.h"
+#include "base/test/sequenced_worker_pool_owner.h"
+#include "base/threading/sequenced_worker_pool.h"
+#include "base/time/time.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "testing/perf/perf_test.h"
+
+namespace base {
+
+namespace {
+
+const size_t kNumWorkerThreads = 8;
+const int kNumTasks = 100000;
+const int kNumSequences = 16;
+const int kFanOutDepth = 15;  // 2^16 - 1 tasks.
+
+// Records the queueing latency of every task into a preallocated slot so the
+// measurement itself adds no shared-state contention beyond one atomic
+// increment per task.
+class LatencyRecorder {
+ public:
+  explicit LatencyRecorder(int expected_tasks)
+      : latencies_us_(expected_tasks),
+        completed_(0),
+        done_(true, false) {}
+
+  void Record(TimeTicks posted) {
+    int index = subtle::NoBarrier_AtomicIncrement(&completed_, 1) - 1;
+    latencies_us_[index] = (TimeTicks::HighResNow() - posted).InMicroseconds();
+    if (index + 1 == static_cast<int>(latencies_us_.size()))
+      done_.Signal();
+  }
+
+  void Wait() { done_.Wait(); }
+
+  // Returns the |percentile|th latency in microseconds. Only valid after
+  // Wait() returns.
+  double Percentile(double percentile) {
+    size_t index = static_cast<size_t>(
+        (latencies_us_.size() - 1) * percentile / 100.0);
+    std::nth_element(latencies_us_.begin(), latencies_us_.begin() + index,
+                     latencies_us_.end());
+    return static_cast<double>(latencies_us_[index]);
+  }
+
+ private:
+  std::vector<int64> latencies_us_;
+  subtle::Atomic32 completed_;
+  WaitableEvent done_;
+
+  DISALLOW_COPY_AND_ASSIGN(LatencyRecorder);
+};
+
+void RecordTask(LatencyRecorder* recorder, TimeTicks posted) {
+  recorder->Record(posted);
+}
+
+// Posts two children from the worker until |depth| reaches zero, exercising
+// the path where workers feed themselves.
+void FanOutTask(SequencedWorkerPool* pool,
+                LatencyRecorder* recorder,
+                int depth,
+                TimeTicks posted) {
+  if (depth > 0) {
+    for (int i = 0; i < 2; ++i) {
+      pool->PostWorkerTask(FROM_HERE,
+                           Bind(&FanOutTask, Unretained(pool),
+                                Unretained(recorder), depth - 1,
+                                TimeTicks::HighResNow()));
+    }
+  }
+  recorder->Record(posted);
+}
+
+class SequencedWorkerPoolPerfTest
+    : public testing::TestWithParam<SequencedWorkerPool::SchedulingMode> {
+ public:
+  SequencedWorkerPoolPerfTest() {
+    // Disable the task profiler as it adds significant cost!
+    CommandLine::Init(0, NULL);
+    CommandLine::ForCurrentProcess()->AppendSwitchASCII(
+        switches::kProfilerTiming,
+        switches::kProfilerTimingDisabledValue);
+  }
+
+  std::string ModeName() const {
+    return GetParam() == SequencedWorkerPool::WORK_STEALING ? "work_stealing"
+                                                            : "shared_queue";
+  }
+
+  void PrintResults(const std::string& scenario,
+                    int num_tasks,
+                    TimeDelta elapsed,
+                    LatencyRecorder* recorder) {
+    std::string trace = ModeName();
+    perf_test::PrintResult("throughput", "_" + scenario, trace,
+                           num_tasks / elapsed.InSecondsF(), "tasks/s", true);
+    perf_test::PrintResult("latency_p50", "_" + scenario, trace,
+                           recorder->Percentile(50), "us", false);
+    perf_test::PrintResult("latency_p99", "_" + scenario, trace,
+                           recorder->Percentile(99), "us", true);
+  }
+
+ protected:
+  MessageLoop message_loop_;
+};
+
+}  // namespace
+
+// Unsequenced tasks posted from a single non-worker thread.
+TEST_P(SequencedWorkerPoolPerfTest, Unsequenced) {
+  SequencedWorkerPoolOwner owner(kNumWorkerThreads, "PerfTest", GetParam());
+  LatencyRecorder recorder(kNumTasks);
+
+  TimeTicks start = TimeTicks::HighResNow();
+  for (int i = 0; i < kNumTasks; ++i) {
+    owner.pool()->PostWorkerTask(
+        FROM_HERE,
+        Bind(&RecordTask, Unretained(&recorder), TimeTicks::HighResNow()));
+  }
+  recorder.Wait();
+  PrintResults("unsequenced", kNumTasks, TimeTicks::HighResNow() - start,
+               &recorder);
+  owner.pool()->Shutdown();
+}
+
+// Tasks spread round-robin over a handful of sequences.
+TEST_P(SequencedWorkerPoolPerfTest, Sequenced) {
+  SequencedWorkerPoolOwner owner(kNumWorkerThreads, "PerfTest", GetParam());
+  LatencyRecorder recorder(kNumTasks);
+  std::vector<SequencedWorkerPool::SequenceToken> tokens;
+  for (int i = 0; i < kNumSequences; ++i)
+    tokens.push_back(owner.pool()->GetSequenceToken());
+
+  TimeTicks start = TimeTicks::HighResNow();
+  for (int i = 0; i < kNumTasks; ++i) {
+    owner.pool()->PostSequencedWorkerTask(
+        tokens[i % kNumSequences], FROM_HERE,
+        Bind(&RecordTask, Unretained(&recorder), TimeTicks::HighResNow()));
+  }
+  recorder.Wait();
+  PrintResults("sequenced", kNumTasks, TimeTicks::HighResNow() - start,
+               &recorder);
+  owner.pool()->Shutdown();
+}
+
+// A binary tree of tasks where every task posts its children from a worker.
+TEST_P(SequencedWorkerPoolPerfTest, FanOut) {
+  SequencedWorkerPoolOwner owner(kNumWorkerThreads, "PerfTest", GetParam());
+  const int num_tasks = (2 << kFanOutDepth) - 1;
+  LatencyRecorder recorder(num_tasks);
+
+  TimeTicks start = TimeTicks::HighResNow();
+  owner.pool()->PostWorkerTask(
+      FROM_HERE, Bind(&FanOutTask, Unretained(owner.pool().get()),
+                      Unretained(&recorder), kFanOutDepth,
+                      TimeTicks::HighResNow()));
+  recorder.Wait();
+  PrintResults("fan_out", num_tasks, TimeTicks::HighResNow() - start,
+               &recorder);
+  owner.pool()->Shutdown();
+}
+
+INSTANTIATE_TEST_CASE_P(SharedQueue,
+                        SequencedWorkerPoolPerfTest,
+                        testing::Values(SequencedWorkerPool::SHARED_QUEUE));
+INSTANTIATE_TEST_CASE_P(WorkStealing,
+                        SequencedWorkerPoolPerfTest,
+                        testing::Values(SequencedWorkerPool::WORK_STEALING));
+
+}  // namespace base
@@ -51,6 +51,7 @@ struct Thread::StartupData {
 
 Thread::Options::Options()
     : message_loop_type(MessageLoop::TYPE_DEFAULT),
+      incoming_queue_mode(MessageLoop::INCOMING_QUEUE_LOCKED),
       timer_slack(TIMER_SLACK_NONE),
       stack_size(0) {
 }
@@ -58,6 +59,7 @@ Thread::Options::Options()
 Thread::Options::Options(MessageLoop::Type type,
                          size_t size)
     : message_loop_type(type),
+      incoming_queue_mode(MessageLoop::INCOMING_QUEUE_LOCKED),
       timer_slack(TIMER_SLACK_NONE),
       stack_size(size) {
 }
@@ -196,7 +198,8 @@ void Thread::ThreadMain() {
           new MessageLoop(startup_data_->options.message_pump_factory.Run()));
     } else {
       message_loop.reset(
-          new MessageLoop(startup_data_->options.message_loop_type));
+          new MessageLoop(startup_data_->options.message_loop_type,
+                          startup_data_->options.incoming_queue_mode));
     }
 
     // Complete the initialization of our Thread object.
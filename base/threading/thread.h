@@ -45,6 +45,11 @@ class BASE_EXPORT Thread : PlatformThread::Delegate {
     // This is ignored if message_pump_factory.is_null() is false.
     MessageLoop::Type message_loop_type;
 
+    // Specifies how tasks posted from other threads reach the thread's
+    // message loop. This is ignored if message_pump_factory.is_null() is
+    // false.
+    MessageLoop::IncomingQueueMode incoming_queue_mode;
+
     // Specify timer slack for thread message loop.
     TimerSlack timer_slack;
 
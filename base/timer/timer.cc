@@ -8,6 +8,7 @@
 
 #include "base/logging.h"
 #include "base/memory/ref_counted.h"
+#include "base/message_loop/message_loop.h"
 #include "base/single_thread_task_runner.h"
 #include "base/thread_task_runner_handle.h"
 #include "base/threading/platform_thread.h"
@@ -41,6 +42,7 @@ class BaseTimerTaskInternal {
     // *this will be deleted by the task runner, so Timer needs to
     // forget us:
     timer_->scheduled_task_ = NULL;
+    timer_->scheduled_task_handle_ = 0;
 
     // Although Timer should not call back into *this, let's clear
     // the timer_ member first to be pedantic.
@@ -61,6 +63,7 @@ class BaseTimerTaskInternal {
 
 Timer::Timer(bool retain_user_task, bool is_repeating)
     : scheduled_task_(NULL),
+      scheduled_task_handle_(0),
       thread_id_(0),
       is_repeating_(is_repeating),
       retain_user_task_(retain_user_task),
@@ -72,6 +75,7 @@ Timer::Timer(const tracked_objects::Location& posted_from,
              const base::Closure& user_task,
              bool is_repeating)
     : scheduled_task_(NULL),
+      scheduled_task_handle_(0),
       posted_from_(posted_from),
       delay_(delay),
       user_task_(user_task),
@@ -102,6 +106,10 @@ void Timer::Start(const tracked_objects::Location& posted_from,
 
 void Timer::Stop() {
   is_running_ = false;
+  // Rather than leaving the task to run for nothing, delete it now if that is
+  // cheap.
+  if (scheduled_task_handle_)
+    AbandonScheduledTask();
   if (!retain_user_task_)
     user_task_.Reset();
 }
@@ -145,7 +153,15 @@ void Timer::PostNewScheduledTask(TimeDelta delay) {
   DCHECK(scheduled_task_ == NULL);
   is_running_ = true;
   scheduled_task_ = new BaseTimerTaskInternal(this);
-  if (delay > TimeDelta::FromMicroseconds(0)) {
+  // Tasks posted straight to the MessageLoop of the thread can be cancelled.
+  MessageLoop* loop = MessageLoop::current();
+  if (delay > TimeDelta::FromMicroseconds(0) && loop &&
+      loop->task_runner().get() == ThreadTaskRunnerHandle::Get().get()) {
+    scheduled_task_handle_ = loop->PostCancelableDelayedTask(posted_from_,
+        base::Bind(&BaseTimerTaskInternal::Run, base::Owned(scheduled_task_)),
+        delay);
+    scheduled_run_time_ = desired_run_time_ = TimeTicks::Now() + delay;
+  } else if (delay > TimeDelta::FromMicroseconds(0)) {
     ThreadTaskRunnerHandle::Get()->PostDelayedTask(posted_from_,
         base::Bind(&BaseTimerTaskInternal::Run, base::Owned(scheduled_task_)),
         delay);
@@ -168,6 +184,13 @@ void Timer::AbandonScheduledTask() {
     scheduled_task_->Abandon();
     scheduled_task_ = NULL;
   }
+  if (scheduled_task_handle_) {
+    // The task may already be being deleted, with the MessageLoop.
+    DelayedTaskWheel::Handle handle = scheduled_task_handle_;
+    scheduled_task_handle_ = 0;
+    if (MessageLoop::current())
+      MessageLoop::current()->CancelDelayedTask(handle);
+  }
 }
 
 void Timer::RunScheduledTask() {
@@ -55,6 +55,7 @@
 #include "base/bind_helpers.h"
 #include "base/callback.h"
 #include "base/location.h"
+#include "base/message_loop/delayed_task_wheel.h"
 #include "base/time/time.h"
 
 namespace base {
@@ -94,7 +95,8 @@ class BASE_EXPORT Timer {
                      const base::Closure& user_task);
 
   // Call this method to stop and cancel the timer.  It is a no-op if the timer
-  // is not running.
+  // is not running. The task posted to the MessageLoop of the thread is
+  // deleted right away.
   virtual void Stop();
 
   // Call this method to reset the timer delay. The user_task_ must be set. If
@@ -139,6 +141,10 @@ class BASE_EXPORT Timer {
   // RunScheduledTask() at scheduled_run_time_.
   BaseTimerTaskInternal* scheduled_task_;
 
+  // Cancels scheduled_task_ when it was posted to the MessageLoop of the
+  // thread, 0 otherwise.
+  DelayedTaskWheel::Handle scheduled_task_handle_;
+
   // Location in user code.
   tracked_objects::Location posted_from_;
   // Delay requested by user.
@@ -177,8 +177,7 @@ void OverrideResponseAsRedirect(
   request->SetLoadFlags(request->load_flags() |
                         net::LOAD_DISABLE_CACHE |
                         net::LOAD_BYPASS_PROXY);
-  *override_response_headers = new net::HttpResponseHeaders(
-      original_response_headers->raw_headers());
+  *override_response_headers = original_response_headers->Clone();
   (*override_response_headers)->ReplaceStatusLine("HTTP/1.1 302 Found");
   (*override_response_headers)->RemoveHeader("Location");
   (*override_response_headers)->AddHeader("Location: " +
@@ -56,6 +56,7 @@
 
 #if defined(USE_TCMALLOC)
 #include "third_party/tcmalloc/chromium/src/gperftools/malloc_extension.h"
+#include "third_party/tcmalloc/chromium/src/gperftools/malloc_hook.h"
 #if defined(TYPE_PROFILING)
 #include "base/allocator/type_profiler.h"
 #include "base/allocator/type_profiler_tcmalloc.h"
@@ -478,6 +479,23 @@ class ContentMainRunnerImpl : public ContentMainRunner {
   static void ReleaseFreeMemoryThunk() {
     MallocExtension::instance()->ReleaseFreeMemory();
   }
+
+  static bool SetAllocationHooksThunk(
+      base::allocator::thunks::AllocationHookFunction allocation_hook,
+      base::allocator::thunks::FreeHookFunction free_hook) {
+    // tcmalloc calls every hook added, so remove the ones added before.
+    static base::allocator::thunks::AllocationHookFunction
+        current_allocation_hook = NULL;
+    static base::allocator::thunks::FreeHookFunction current_free_hook = NULL;
+    if (current_allocation_hook)
+      MallocHook::RemoveNewHook(current_allocation_hook);
+    if (current_free_hook)
+      MallocHook::RemoveDeleteHook(current_free_hook);
+    current_allocation_hook = allocation_hook;
+    current_free_hook = free_hook;
+    return (!allocation_hook || MallocHook::AddNewHook(allocation_hook)) &&
+           (!free_hook || MallocHook::AddDeleteHook(free_hook));
+  }
 #endif
 
   virtual int Initialize(const ContentMainParams& params) OVERRIDE {
@@ -519,6 +537,7 @@ class ContentMainRunnerImpl : public ContentMainRunner {
         GetAllocatorWasteSizeThunk);
     base::allocator::SetGetStatsFunction(GetStatsThunk);
     base::allocator::SetReleaseFreeMemoryFunction(ReleaseFreeMemoryThunk);
+    base::allocator::SetSetAllocationHooksFunction(SetAllocationHooksThunk);
 
     // Provide optional hook for monitoring allocation quantities on a
     // per-thread basis.  Only set the hook if the environment indicates this
@@ -555,6 +555,9 @@ void BrowserMainLoop::MainMessageLoopStart() {
       ::HeapProfilerStop,
       ::GetHeapProfile));
 #endif
+  trace_sampled_heap_controller_.reset(
+      new base::debug::TraceSampledHeapController(
+          base::MessageLoop::current()->message_loop_proxy()));
 }
 
 int BrowserMainLoop::PreCreateThreads() {
@@ -782,6 +785,7 @@ void BrowserMainLoop::ShutdownThreadsAndCleanUp() {
   }
 
   trace_memory_controller_.reset();
+  trace_sampled_heap_controller_.reset();
   system_stats_monitor_.reset();
 
 #if !defined(OS_IOS)
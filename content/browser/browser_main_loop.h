@@ -23,6 +23,7 @@ class SystemMonitor;
 namespace debug {
 class TraceMemoryController;
 class TraceEventSystemStatsMonitor;
+class TraceSampledHeapController;
 }  // namespace debug
 }  // namespace base
 
@@ -192,6 +193,8 @@ class CONTENT_EXPORT BrowserMainLoop {
   scoped_ptr<base::Thread> indexed_db_thread_;
   scoped_ptr<MemoryObserver> memory_observer_;
   scoped_ptr<base::debug::TraceMemoryController> trace_memory_controller_;
+  scoped_ptr<base::debug::TraceSampledHeapController>
+      trace_sampled_heap_controller_;
   scoped_ptr<base::debug::TraceEventSystemStatsMonitor> system_stats_monitor_;
 
   bool is_tracing_startup_;
@@ -34,10 +34,8 @@ StreamHandleImpl::StreamHandleImpl(
       stream_message_loop_(base::MessageLoopProxy::current().get()) {
   // Make a copy of the response headers so it is safe to pass this across
   // threads.
-  if (response_headers.get()) {
-    response_headers_ =
-        new net::HttpResponseHeaders(response_headers->raw_headers());
-  }
+  if (response_headers.get())
+    response_headers_ = response_headers->Clone();
 }
 
 StreamHandleImpl::~StreamHandleImpl() {
@@ -352,6 +352,9 @@ void ChildThread::Init(const Options& options) {
       ::HeapProfilerStop,
       ::GetHeapProfile));
 #endif
+  trace_sampled_heap_controller_.reset(
+      new base::debug::TraceSampledHeapController(
+          message_loop_->message_loop_proxy()));
 
   shared_bitmap_manager_.reset(
       new ChildSharedBitmapManager(thread_safe_sender()));
@@ -23,6 +23,7 @@ class MessageLoop;
 
 namespace debug {
 class TraceMemoryController;
+class TraceSampledHeapController;
 }  // namespace debug
 }  // namespace base
 
@@ -245,6 +246,11 @@ class CONTENT_EXPORT ChildThread : public IPC::Listener, public IPC::Sender {
   // starts profiling the tcmalloc heap.
   scoped_ptr<base::debug::TraceMemoryController> trace_memory_controller_;
 
+  // Observes the trace event system. When tracing is enabled with the
+  // sampled heap category, runs the sampling heap profiler.
+  scoped_ptr<base::debug::TraceSampledHeapController>
+      trace_sampled_heap_controller_;
+
   scoped_ptr<base::PowerMonitor> power_monitor_;
 
   bool in_browser_process_;
@@ -10,15 +10,13 @@
 #include <sys/socket.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <sys/un.h>
 #include <unistd.h>
 
-#if defined(OS_OPENBSD)
-#include <sys/uio.h>
-#endif
-
 #include <map>
 #include <string>
+#include <vector>
 
 #include "base/command_line.h"
 #include "base/files/file_path.h"
@@ -32,6 +30,7 @@
 #include "base/process/process_handle.h"
 #include "base/rand_util.h"
 #include "base/stl_util.h"
+#include "base/strings/string_piece.h"
 #include "base/strings/string_util.h"
 #include "base/synchronization/lock.h"
 #include "ipc/file_descriptor_set_posix.h"
@@ -161,6 +160,47 @@ bool SocketWriteErrorIsRecoverable() {
 #endif  // OS_MACOSX
 }
 
+// The most byte ranges of a message that are written with one system call.
+const size_t kMaxIOVecsPerWrite = 16;
+
+// Points |iov| at the data of |msg| that follows its first |offset| bytes, in
+// at most kMaxIOVecsPerWrite ranges. Returns the number of ranges and sets
+// |*length| to their total size, which is less than the rest of the message
+// if it has more ranges than that. A message with external data (see
+// Pickle::WriteDataReference()) is gathered from its segments, so the
+// external data is never copied.
+size_t FillOutgoingIOVecs(const Message& msg,
+                          size_t offset,
+                          struct iovec* iov,
+                          size_t* length) {
+  if (!msg.has_external_data()) {
+    iov[0].iov_base =
+        const_cast<char*>(static_cast<const char*>(msg.data())) + offset;
+    iov[0].iov_len = msg.size() - offset;
+    *length = iov[0].iov_len;
+    return 1;
+  }
+
+  std::vector<base::StringPiece> segments;
+  msg.GetDataSegments(&segments);
+  size_t count = 0;
+  *length = 0;
+  for (size_t i = 0; i < segments.size() && count < kMaxIOVecsPerWrite; ++i) {
+    base::StringPiece segment = segments[i];
+    if (offset >= segment.size()) {
+      offset -= segment.size();
+      continue;
+    }
+    segment.remove_prefix(offset);
+    offset = 0;
+    iov[count].iov_base = const_cast<char*>(segment.data());
+    iov[count].iov_len = segment.size();
+    *length += segment.size();
+    ++count;
+  }
+  return count;
+}
+
 }  // namespace
 
 #if defined(OS_ANDROID)
@@ -394,15 +434,15 @@ bool ChannelPosix::ProcessOutgoingMessages() {
   while (!output_queue_.empty()) {
     Message* msg = output_queue_.front();
 
-    size_t amt_to_write = msg->size() - message_send_bytes_written_;
+    struct iovec iov[kMaxIOVecsPerWrite];
+    size_t amt_to_write = 0;
+    size_t iov_count = FillOutgoingIOVecs(*msg, message_send_bytes_written_,
+                                          iov, &amt_to_write);
     DCHECK_NE(0U, amt_to_write);
-    const char* out_bytes = reinterpret_cast<const char*>(msg->data()) +
-        message_send_bytes_written_;
 
     struct msghdr msgh = {0};
-    struct iovec iov = {const_cast<char*>(out_bytes), amt_to_write};
-    msgh.msg_iov = &iov;
-    msgh.msg_iovlen = 1;
+    msgh.msg_iov = iov;
+    msgh.msg_iovlen = iov_count;
     char buf[CMSG_SPACE(
         sizeof(int) * FileDescriptorSet::kMaxDescriptorsPerMessage)];
 
@@ -447,9 +487,11 @@ bool ChannelPosix::ProcessOutgoingMessages() {
         // fd_pipe_ which makes Seccomp sandbox operation more efficient.
         struct iovec fd_pipe_iov = { const_cast<char *>(""), 1 };
         msgh.msg_iov = &fd_pipe_iov;
+        msgh.msg_iovlen = 1;
         fd_written = fd_pipe_;
         bytes_written = HANDLE_EINTR(sendmsg(fd_pipe_, &msgh, MSG_DONTWAIT));
-        msgh.msg_iov = &iov;
+        msgh.msg_iov = iov;
+        msgh.msg_iovlen = iov_count;
         msgh.msg_controllen = 0;
         if (bytes_written > 0) {
           CloseFileDescriptors(msg);
@@ -464,8 +506,11 @@ bool ChannelPosix::ProcessOutgoingMessages() {
       if ((mode_ & MODE_CLIENT_FLAG) && IsHelloMessage(*msg)) {
         DCHECK_EQ(msg->file_descriptor_set()->size(), 1U);
       }
-      if (!msgh.msg_controllen) {
-        bytes_written = HANDLE_EINTR(write(pipe_, out_bytes, amt_to_write));
+      if (!msgh.msg_controllen && iov_count == 1) {
+        bytes_written = HANDLE_EINTR(
+            write(pipe_, iov[0].iov_base, iov[0].iov_len));
+      } else if (!msgh.msg_controllen) {
+        bytes_written = HANDLE_EINTR(writev(pipe_, iov, iov_count));
       } else
 #endif  // IPC_USES_READWRITE
       {
@@ -513,6 +558,9 @@ bool ChannelPosix::ProcessOutgoingMessages() {
           &write_watcher_,
           this);
       return true;
+    } else if (message_send_bytes_written_ + amt_to_write != msg->size()) {
+      // The message has more ranges than fit in |iov|; write the rest next.
+      message_send_bytes_written_ += amt_to_write;
     } else {
       message_send_bytes_written_ = 0;
 
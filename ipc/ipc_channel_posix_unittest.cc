@@ -14,6 +14,7 @@
 #include "base/basictypes.h"
 #include "base/files/file_path.h"
 #include "base/files/file_util.h"
+#include "base/memory/ref_counted_memory.h"
 #include "base/memory/scoped_ptr.h"
 #include "base/message_loop/message_loop.h"
 #include "base/path_service.h"
@@ -100,6 +101,22 @@ class IPCChannelPosixTestListener : public IPC::Listener {
   bool quit_only_on_message_;
 };
 
+// Keeps a copy of the message it receives.
+class IPCChannelPosixCopyingListener : public IPCChannelPosixTestListener {
+ public:
+  IPCChannelPosixCopyingListener() : IPCChannelPosixTestListener(true) {}
+
+  virtual bool OnMessageReceived(const IPC::Message& message) OVERRIDE {
+    message_.reset(new IPC::Message(message));
+    return IPCChannelPosixTestListener::OnMessageReceived(message);
+  }
+
+  const IPC::Message* message() const { return message_.get(); }
+
+ private:
+  scoped_ptr<IPC::Message> message_;
+};
+
 class IPCChannelPosixTest : public base::MultiProcessTest {
  public:
   static void SetUpSocket(IPC::ChannelHandle *handle,
@@ -263,6 +280,54 @@ TEST_F(IPCChannelPosixTest, SendHangTest) {
   ASSERT_EQ(IPCChannelPosixTestListener::CHANNEL_ERROR, out_listener.status());
 }
 
+// Messages with external data are written out from the referenced buffers,
+// and arrive like any other message.
+TEST_F(IPCChannelPosixTest, SendExternalData) {
+  IPCChannelPosixTestListener out_listener(true);
+  IPCChannelPosixCopyingListener in_listener;
+  IPC::ChannelHandle in_handle("IN");
+  scoped_ptr<IPC::ChannelPosix> in_chan(new IPC::ChannelPosix(
+      in_handle, IPC::Channel::MODE_SERVER, &in_listener));
+  base::FileDescriptor out_fd(
+      in_chan->TakeClientFileDescriptor(), false);
+  IPC::ChannelHandle out_handle("OUT", out_fd);
+  scoped_ptr<IPC::ChannelPosix> out_chan(new IPC::ChannelPosix(
+      out_handle, IPC::Channel::MODE_CLIENT, &out_listener));
+  ASSERT_TRUE(in_chan->Connect());
+  ASSERT_TRUE(out_chan->Connect());
+
+  // Use more pieces than are written with one system call, and more bytes
+  // than the socket buffers hold.
+  const int kBlobCount = 20;
+  const int kLargeBlob = 10;
+  const std::string kSmallData("small");
+  const std::string kLargeData(1024 * 1024, 'L');
+  IPC::Message* message = new IPC::Message(0,  // routing_id
+                                           kQuitMessage,  // message type
+                                           IPC::Message::PRIORITY_NORMAL);
+  for (int i = 0; i < kBlobCount; ++i) {
+    EXPECT_TRUE(message->WriteInt(i));
+    std::string data(i == kLargeBlob ? kLargeData : kSmallData);
+    EXPECT_TRUE(message->WriteDataReference(
+        base::RefCountedString::TakeString(&data)));
+  }
+  EXPECT_TRUE(message->has_external_data());
+  ASSERT_TRUE(out_chan->Send(message));
+  SpinRunLoop(TestTimeouts::action_max_timeout());
+  ASSERT_EQ(IPCChannelPosixTestListener::MESSAGE_RECEIVED,
+            in_listener.status());
+
+  PickleIterator iter(*in_listener.message());
+  for (int i = 0; i < kBlobCount; ++i) {
+    int index;
+    std::string data;
+    EXPECT_TRUE(iter.ReadInt(&index));
+    EXPECT_EQ(i, index);
+    EXPECT_TRUE(iter.ReadString(&data));
+    EXPECT_EQ(i == kLargeBlob ? kLargeData : kSmallData, data);
+  }
+}
+
 // If a connection closes right before a Connect() call, we may end up closing
 // the connection without notifying the listener, which can cause hangs in
 // sync_message_filter and others. Make sure the listener is notified.
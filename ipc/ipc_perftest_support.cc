@@ -9,6 +9,7 @@
 
 #include "base/basictypes.h"
 #include "base/logging.h"
+#include "base/memory/ref_counted_memory.h"
 #include "base/memory/scoped_ptr.h"
 #include "base/pickle.h"
 #include "base/strings/stringprintf.h"
@@ -132,8 +133,11 @@ class ChannelReflectorListener : public Listener {
 
 class PerformanceChannelListener : public Listener {
  public:
-  explicit PerformanceChannelListener(const std::string& label)
+  // If |reference_payload|, the payload is written to messages with
+  // Pickle::WriteDataReference() instead of being copied.
+  PerformanceChannelListener(const std::string& label, bool reference_payload)
       : label_(label),
+        reference_payload_(reference_payload),
         sender_(NULL),
         msg_count_(0),
         msg_size_(0),
@@ -158,6 +162,10 @@ class PerformanceChannelListener : public Listener {
     msg_size_ = msg_size;
     count_down_ = msg_count_;
     payload_ = std::string(msg_size_, 'a');
+    if (reference_payload_) {
+      std::string payload(payload_);
+      payload_reference_ = base::RefCountedString::TakeString(&payload);
+    }
   }
 
   virtual bool OnMessageReceived(const Message& message) OVERRIDE {
@@ -203,19 +211,24 @@ class PerformanceChannelListener : public Listener {
     Message* msg = new Message(0, 2, Message::PRIORITY_NORMAL);
     msg->WriteInt64(base::TimeTicks::Now().ToInternalValue());
     msg->WriteInt(count_down_);
-    msg->WriteString(payload_);
+    if (reference_payload_)
+      msg->WriteDataReference(payload_reference_);
+    else
+      msg->WriteString(payload_);
     sender_->Send(msg);
     return true;
   }
 
  private:
   std::string label_;
+  bool reference_payload_;
   Sender* sender_;
   int msg_count_;
   size_t msg_size_;
 
   int count_down_;
   std::string payload_;
+  scoped_refptr<base::RefCountedMemory> payload_reference_;
   EventTimeTracker latency_tracker_;
   scoped_ptr<base::PerfTimeLogger> perf_logger_;
 };
@@ -233,12 +246,37 @@ IPCChannelPerfTestBase::GetDefaultTestParams() {
   return list;
 }
 
+std::vector<PingPongTestParams>
+IPCChannelPerfTestBase::GetLargeMessageTestParams() {
+  // Test sizes from 1 KB to 16 MB in steps of 16x, and limit the message count
+  // to keep the test duration reasonable.
+  std::vector<PingPongTestParams> list;
+  list.push_back(PingPongTestParams(1 << 10, 20000));
+  list.push_back(PingPongTestParams(1 << 14, 10000));
+  list.push_back(PingPongTestParams(1 << 18, 1000));
+  list.push_back(PingPongTestParams(1 << 22, 100));
+  list.push_back(PingPongTestParams(1 << 24, 20));
+  return list;
+}
+
 void IPCChannelPerfTestBase::RunTestChannelPingPong(
     const std::vector<PingPongTestParams>& params) {
+  RunChannelPingPong("Channel", false, params);
+}
+
+void IPCChannelPerfTestBase::RunTestChannelPingPongWithPayloadReference(
+    const std::vector<PingPongTestParams>& params) {
+  RunChannelPingPong("ChannelPayloadReference", true, params);
+}
+
+void IPCChannelPerfTestBase::RunChannelPingPong(
+    const std::string& label,
+    bool reference_payload,
+    const std::vector<PingPongTestParams>& params) {
   Init("PerformanceClient");
 
   // Set up IPC channel and start client.
-  PerformanceChannelListener listener("Channel");
+  PerformanceChannelListener listener(label, reference_payload);
   CreateChannel(&listener);
   listener.Init(channel());
   ASSERT_TRUE(ConnectChannel());
@@ -279,7 +317,7 @@ void IPCChannelPerfTestBase::RunTestChannelProxyPingPong(
   base::TestIOThread io_thread(base::TestIOThread::kAutoStart);
 
   // Set up IPC channel and start client.
-  PerformanceChannelListener listener("ChannelProxy");
+  PerformanceChannelListener listener("ChannelProxy", false);
   CreateChannelProxy(&listener, io_thread.task_runner());
   listener.Init(channel_proxy());
   ASSERT_TRUE(StartClient());
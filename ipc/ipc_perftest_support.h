@@ -5,6 +5,7 @@
 #ifndef IPC_IPC_PERFTEST_SUPPORT_H_
 #define IPC_IPC_PERFTEST_SUPPORT_H_
 
+#include <string>
 #include <vector>
 
 #include "ipc/ipc_test_base.h"
@@ -31,11 +32,23 @@ class PingPongTestParams {
 class IPCChannelPerfTestBase : public IPCTestBase {
  public:
   static std::vector<PingPongTestParams> GetDefaultTestParams();
+  // Large messages, from 1 KB to 16 MB.
+  static std::vector<PingPongTestParams> GetLargeMessageTestParams();
 
   void RunTestChannelPingPong(
       const std::vector<PingPongTestParams>& params_list);
+  // Same as RunTestChannelPingPong(), but the test writes its payloads with
+  // Pickle::WriteDataReference() rather than copying them into each message.
+  // The client still copies them into its replies.
+  void RunTestChannelPingPongWithPayloadReference(
+      const std::vector<PingPongTestParams>& params_list);
   void RunTestChannelProxyPingPong(
       const std::vector<PingPongTestParams>& params_list);
+
+ private:
+  void RunChannelPingPong(const std::string& label,
+                          bool reference_payload,
+                          const std::vector<PingPongTestParams>& params_list);
 };
 
 class PingPongTestClient {
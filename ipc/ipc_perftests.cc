@@ -17,6 +17,15 @@ TEST_F(IPCChannelPerfTest, ChannelPingPong) {
   RunTestChannelPingPong(GetDefaultTestParams());
 }
 
+// Compares copying large payloads into messages with referencing them.
+TEST_F(IPCChannelPerfTest, ChannelPingPongLargeMessages) {
+  RunTestChannelPingPong(GetLargeMessageTestParams());
+}
+
+TEST_F(IPCChannelPerfTest, ChannelPingPongLargeMessagesPayloadReference) {
+  RunTestChannelPingPongWithPayloadReference(GetLargeMessageTestParams());
+}
+
 TEST_F(IPCChannelPerfTest, ChannelProxyPingPong) {
   RunTestChannelProxyPingPong(GetDefaultTestParams());
 }
@@ -21,7 +21,9 @@ enum CacheType {
 enum BackendType {
   CACHE_BACKEND_DEFAULT,
   CACHE_BACKEND_BLOCKFILE,  // The |BackendImpl|.
-  CACHE_BACKEND_SIMPLE  // The |SimpleBackendImpl|.
+  CACHE_BACKEND_SIMPLE,  // The |SimpleBackendImpl|.
+  CACHE_BACKEND_SIMPLE_PACKED  // The |SimpleBackendImpl|, with the small
+                               // entries packed in segment files.
 };
 
 }  // namespace disk_cache
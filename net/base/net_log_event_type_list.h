@@ -835,6 +835,10 @@ EVENT_TYPE(HTTP_CACHE_WRITE_INFO)
 EVENT_TYPE(HTTP_CACHE_READ_DATA)
 EVENT_TYPE(HTTP_CACHE_WRITE_DATA)
 
+// Logged when a stale entry is used while a background transaction
+// revalidates it, as allowed by its stale-while-revalidate directive.
+EVENT_TYPE(HTTP_CACHE_ASYNC_VALIDATION)
+
 // ------------------------------------------------------------------------
 // Disk Cache / Memory Cache
 // ------------------------------------------------------------------------
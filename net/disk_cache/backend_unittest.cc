@@ -3166,6 +3166,11 @@ TEST_F(DiskCacheBackendTest, SimpleCacheBasics) {
   BackendBasics();
 }
 
+TEST_F(DiskCacheBackendTest, SimpleCacheMappedIndexBasics) {
+  SetSimpleCacheMappedIndexMode();
+  BackendBasics();
+}
+
 TEST_F(DiskCacheBackendTest, SimpleCacheAppCacheBasics) {
   SetCacheType(net::APP_CACHE);
   SetSimpleCacheMode();
@@ -3225,6 +3230,11 @@ TEST_F(DiskCacheBackendTest, SimpleCacheDoomAll) {
   BackendDoomAll();
 }
 
+TEST_F(DiskCacheBackendTest, SimpleCacheMappedIndexDoomRecent) {
+  SetSimpleCacheMappedIndexMode();
+  BackendDoomRecent();
+}
+
 TEST_F(DiskCacheBackendTest, SimpleCacheAppCacheOnlyDoomAll) {
   SetCacheType(net::APP_CACHE);
   SetSimpleCacheMode();
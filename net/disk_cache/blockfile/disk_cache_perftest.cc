@@ -2,13 +2,16 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include <algorithm>
 #include <string>
 
 #include "base/basictypes.h"
 #include "base/bind.h"
 #include "base/bind_helpers.h"
+#include "base/files/file_enumerator.h"
 #include "base/hash.h"
 #include "base/strings/string_util.h"
+#include "base/strings/stringprintf.h"
 #include "base/test/perf_time_logger.h"
 #include "base/test/test_file_util.h"
 #include "base/threading/thread.h"
@@ -19,10 +22,15 @@
 #include "net/base/test_completion_callback.h"
 #include "net/disk_cache/blockfile/backend_impl.h"
 #include "net/disk_cache/blockfile/block_files.h"
+#include "net/disk_cache/compressed_entry.h"
 #include "net/disk_cache/disk_cache.h"
 #include "net/disk_cache/disk_cache_test_base.h"
 #include "net/disk_cache/disk_cache_test_util.h"
+#include "net/disk_cache/memory/mem_backend_impl.h"
+#include "net/disk_cache/simple/simple_backend_impl.h"
+#include "net/disk_cache/tiered/tiered_backend.h"
 #include "testing/gtest/include/gtest/gtest.h"
+#include "testing/perf/perf_test.h"
 #include "testing/platform_test.h"
 
 using base::Time;
@@ -144,31 +152,34 @@ int BlockSize() {
   return (rand() & 0x3) + 1;
 }
 
-}  // namespace
-
-TEST_F(DiskCacheTest, Hash) {
-  int seed = static_cast<int>(Time::Now().ToInternalValue());
-  srand(seed);
-
-  base::PerfTimeLogger timer("Hash disk cache keys");
-  for (int i = 0; i < 300000; i++) {
-    std::string key = GenerateKey(true);
-    base::Hash(key);
+// Evicts the files of the cache at |cache_path| from the system cache, and
+// returns how many there are.
+size_t EvictCacheFiles(const base::FilePath& cache_path) {
+  size_t file_count = 0;
+  base::FileEnumerator enumerator(cache_path, true,
+                                  base::FileEnumerator::FILES);
+  for (base::FilePath path = enumerator.Next(); !path.empty();
+       path = enumerator.Next()) {
+    EXPECT_TRUE(base::EvictFileFromSystemCache(path));
+    ++file_count;
   }
-  timer.Done();
+  return file_count;
 }
 
-TEST_F(DiskCacheTest, CacheBackendPerformance) {
+// Writes entries to a cache of |backend_type| at |cache_path|, and reads them
+// back, cold and warm.
+void CacheBackendPerformance(const base::FilePath& cache_path,
+                             net::BackendType backend_type,
+                             const std::string& trace) {
   base::Thread cache_thread("CacheThread");
   ASSERT_TRUE(cache_thread.StartWithOptions(
                   base::Thread::Options(base::MessageLoop::TYPE_IO, 0)));
 
-  ASSERT_TRUE(CleanupCacheDir());
   net::TestCompletionCallback cb;
   scoped_ptr<disk_cache::Backend> cache;
   int rv = disk_cache::CreateCacheBackend(net::DISK_CACHE,
-                                          net::CACHE_BACKEND_BLOCKFILE,
-                                          cache_path_,
+                                          backend_type,
+                                          cache_path,
                                           0,
                                           false,
                                           cache_thread.task_runner(),
@@ -188,21 +199,16 @@ TEST_F(DiskCacheTest, CacheBackendPerformance) {
 
   base::MessageLoop::current()->RunUntilIdle();
   cache.reset();
+  // The simple cache closes its entries on its worker pool.
+  disk_cache::SimpleBackendImpl::FlushWorkerPoolForTesting();
+  base::MessageLoop::current()->RunUntilIdle();
 
-  ASSERT_TRUE(base::EvictFileFromSystemCache(
-              cache_path_.AppendASCII("index")));
-  ASSERT_TRUE(base::EvictFileFromSystemCache(
-              cache_path_.AppendASCII("data_0")));
-  ASSERT_TRUE(base::EvictFileFromSystemCache(
-              cache_path_.AppendASCII("data_1")));
-  ASSERT_TRUE(base::EvictFileFromSystemCache(
-              cache_path_.AppendASCII("data_2")));
-  ASSERT_TRUE(base::EvictFileFromSystemCache(
-              cache_path_.AppendASCII("data_3")));
+  perf_test::PrintResult("cache_files", "", trace,
+                         EvictCacheFiles(cache_path), "files", true);
 
   rv = disk_cache::CreateCacheBackend(net::DISK_CACHE,
-                                      net::CACHE_BACKEND_BLOCKFILE,
-                                      cache_path_,
+                                      backend_type,
+                                      cache_path,
                                       0,
                                       false,
                                       cache_thread.task_runner(),
@@ -218,6 +224,357 @@ TEST_F(DiskCacheTest, CacheBackendPerformance) {
   base::MessageLoop::current()->RunUntilIdle();
 }
 
+// Returns a response body of |size| bytes that looks like script, style sheet
+// or JSON text, after |kind|.
+std::string TextBody(int kind, int size) {
+  std::string body;
+  for (int i = 0; static_cast<int>(body.size()) < size; ++i) {
+    const int token = rand();
+    switch (kind % 3) {
+      case 0:
+        body += base::StringPrintf(
+            "function f%x(a, b) { return a.items[%d] + b.get('k%x'); }\n",
+            token % 4096, i, token);
+        break;
+      case 1:
+        body += base::StringPrintf(
+            ".c%x { margin: %dpx; color: #%06x; font-family: sans-serif; }\n",
+            token % 4096, i % 40, token & 0xffffff);
+        break;
+      default:
+        body += base::StringPrintf(
+            "{\"id\": %d, \"name\": \"item%x\", \"visible\": true},\n", i,
+            token);
+        break;
+    }
+  }
+  body.resize(size);
+  return body;
+}
+
+// Opens the entry |key| of |cache| wrapped in a CompressedEntry, with its
+// stream open if |compressed|.
+disk_cache::CompressedEntry* OpenCompressedEntry(disk_cache::Backend* cache,
+                                                 const std::string& key,
+                                                 bool compressed) {
+  disk_cache::Entry* cache_entry;
+  net::TestCompletionCallback cb;
+  if (cb.GetResult(cache->OpenEntry(key, &cache_entry, cb.callback())) !=
+      net::OK) {
+    return NULL;
+  }
+  disk_cache::CompressedEntry* entry =
+      new disk_cache::CompressedEntry(cache_entry, 1);
+  if (compressed &&
+      cb.GetResult(entry->OpenCompressedStream(cb.callback())) != net::OK) {
+    entry->Close();
+    return NULL;
+  }
+  return entry;
+}
+
+// Reads the whole stream of each entry listed on |entries|.
+bool TimeCompressedRead(disk_cache::Backend* cache,
+                        const TestEntries& entries,
+                        bool compressed,
+                        const std::string& trace) {
+  const int kReadSize = 32 * 1024;
+  scoped_refptr<net::IOBuffer> buffer(new net::IOBuffer(kReadSize));
+
+  base::PerfTimeLogger timer(("Read compressed streams " + trace).c_str());
+  for (size_t i = 0; i < entries.size(); i++) {
+    disk_cache::CompressedEntry* entry =
+        OpenCompressedEntry(cache, entries[i].key, compressed);
+    if (!entry)
+      return false;
+    int offset = 0;
+    while (offset < entries[i].data_len) {
+      net::TestCompletionCallback cb;
+      int rv = cb.GetResult(
+          entry->ReadData(1, offset, buffer.get(), kReadSize, cb.callback()));
+      if (rv <= 0)
+        break;
+      offset += rv;
+    }
+    entry->Close();
+    if (offset != entries[i].data_len)
+      return false;
+  }
+  timer.Done();
+  return true;
+}
+
+// Writes text bodies to a simple cache at |cache_path|, compressed or not,
+// and reads them back, cold and warm, reporting the bytes they use.
+void CompressedStreamPerformance(const base::FilePath& cache_path,
+                                 bool compressed,
+                                 const std::string& trace) {
+  base::Thread cache_thread("CacheThread");
+  ASSERT_TRUE(cache_thread.StartWithOptions(
+                  base::Thread::Options(base::MessageLoop::TYPE_IO, 0)));
+
+  net::TestCompletionCallback cb;
+  scoped_ptr<disk_cache::Backend> cache;
+  int rv = disk_cache::CreateCacheBackend(net::DISK_CACHE,
+                                          net::CACHE_BACKEND_SIMPLE,
+                                          cache_path,
+                                          0,
+                                          false,
+                                          cache_thread.task_runner(),
+                                          NULL,
+                                          &cache,
+                                          cb.callback());
+  ASSERT_EQ(net::OK, cb.GetResult(rv));
+
+  // The same corpus for both runs.
+  srand(1);
+  const int kNumEntries = 200;
+  const int kWriteSize = 16 * 1024;
+  TestEntries entries;
+  {
+    base::PerfTimeLogger timer(("Write compressed streams " + trace).c_str());
+    for (int i = 0; i < kNumEntries; i++) {
+      TestEntry test_entry;
+      test_entry.key = GenerateKey(true);
+      test_entry.data_len = 4 * 1024 + rand() % (200 * 1024);
+      entries.push_back(test_entry);
+      const std::string body = TextBody(i, test_entry.data_len);
+
+      disk_cache::Entry* cache_entry;
+      rv = cache->CreateEntry(test_entry.key, &cache_entry, cb.callback());
+      ASSERT_EQ(net::OK, cb.GetResult(rv));
+      disk_cache::CompressedEntry* entry =
+          new disk_cache::CompressedEntry(cache_entry, 1);
+      if (compressed)
+        entry->StartCompressedStream();
+      for (int offset = 0; offset < test_entry.data_len;
+           offset += kWriteSize) {
+        const int size = std::min(kWriteSize, test_entry.data_len - offset);
+        scoped_refptr<net::StringIOBuffer> buffer(
+            new net::StringIOBuffer(body.substr(offset, size)));
+        rv = entry->WriteData(1, offset, buffer.get(), size, cb.callback(),
+                              false);
+        ASSERT_EQ(size, cb.GetResult(rv));
+      }
+      entry->Close();
+    }
+    base::MessageLoop::current()->RunUntilIdle();
+    timer.Done();
+  }
+
+  size_t logical_bytes = 0;
+  size_t stored_bytes = 0;
+  for (size_t i = 0; i < entries.size(); i++) {
+    disk_cache::Entry* cache_entry;
+    rv = cache->OpenEntry(entries[i].key, &cache_entry, cb.callback());
+    ASSERT_EQ(net::OK, cb.GetResult(rv));
+    logical_bytes += entries[i].data_len;
+    stored_bytes += cache_entry->GetDataSize(1);
+    cache_entry->Close();
+  }
+  perf_test::PrintResult("stream_bytes", "", trace, logical_bytes, "bytes",
+                         false);
+  perf_test::PrintResult("stored_bytes", "", trace, stored_bytes, "bytes",
+                         true);
+
+  cache.reset();
+  disk_cache::SimpleBackendImpl::FlushWorkerPoolForTesting();
+  base::MessageLoop::current()->RunUntilIdle();
+  EvictCacheFiles(cache_path);
+
+  rv = disk_cache::CreateCacheBackend(net::DISK_CACHE,
+                                      net::CACHE_BACKEND_SIMPLE,
+                                      cache_path,
+                                      0,
+                                      false,
+                                      cache_thread.task_runner(),
+                                      NULL,
+                                      &cache,
+                                      cb.callback());
+  ASSERT_EQ(net::OK, cb.GetResult(rv));
+
+  EXPECT_TRUE(TimeCompressedRead(cache.get(), entries, compressed,
+                                 trace + " (cold)"));
+  EXPECT_TRUE(TimeCompressedRead(cache.get(), entries, compressed,
+                                 trace + " (warm)"));
+
+  base::MessageLoop::current()->RunUntilIdle();
+}
+
+// Returns |count| indices of |entries| entries, drawn from a Zipf distribution
+// so that a few entries get most of the opens, as the hits of a browser cache.
+std::vector<int> SkewedTrace(int entries, int count) {
+  std::vector<double> cumulative_weights;
+  double total = 0;
+  for (int i = 0; i < entries; i++) {
+    total += 1.0 / (i + 1);
+    cumulative_weights.push_back(total);
+  }
+
+  std::vector<int> trace;
+  for (int i = 0; i < count; i++) {
+    const double draw = total * rand() / RAND_MAX;
+    trace.push_back(std::min<int>(
+        entries - 1,
+        std::lower_bound(cumulative_weights.begin(), cumulative_weights.end(),
+                         draw) - cumulative_weights.begin()));
+  }
+  return trace;
+}
+
+// Opens and reads the entries of |entries| in the order of |trace|.
+bool TimeReplay(disk_cache::Backend* cache,
+                const TestEntries& entries,
+                const std::vector<int>& trace,
+                const std::string& name) {
+  scoped_refptr<net::IOBuffer> buffer(new net::IOBuffer(kMaxSize));
+
+  base::PerfTimeLogger timer(("Replay cache hits " + name).c_str());
+  for (size_t i = 0; i < trace.size(); i++) {
+    const TestEntry& test_entry = entries[trace[i]];
+    disk_cache::Entry* cache_entry;
+    net::TestCompletionCallback cb;
+    int rv = cache->OpenEntry(test_entry.key, &cache_entry, cb.callback());
+    if (cb.GetResult(rv) != net::OK)
+      return false;
+    rv = cache_entry->ReadData(0, 0, buffer.get(), kMaxSize, cb.callback());
+    if (cb.GetResult(rv) != 200) {
+      cache_entry->Close();
+      return false;
+    }
+    rv = cache_entry->ReadData(1, 0, buffer.get(), kMaxSize, cb.callback());
+    cache_entry->Close();
+    if (cb.GetResult(rv) != test_entry.data_len)
+      return false;
+  }
+  timer.Done();
+  return true;
+}
+
+// Replays a skewed trace of cache hits on a cold simple cache at
+// |cache_path|, with a memory tier of |memory_tier_bytes| in front of it if
+// that isn't zero.
+void TieredReplayPerformance(const base::FilePath& cache_path,
+                             int memory_tier_bytes,
+                             const std::string& trace_name) {
+  base::Thread cache_thread("CacheThread");
+  ASSERT_TRUE(cache_thread.StartWithOptions(
+                  base::Thread::Options(base::MessageLoop::TYPE_IO, 0)));
+
+  net::TestCompletionCallback cb;
+  scoped_ptr<disk_cache::Backend> cache;
+  int rv = disk_cache::CreateCacheBackend(net::DISK_CACHE,
+                                          net::CACHE_BACKEND_SIMPLE,
+                                          cache_path,
+                                          0,
+                                          false,
+                                          cache_thread.task_runner(),
+                                          NULL,
+                                          &cache,
+                                          cb.callback());
+  ASSERT_EQ(net::OK, cb.GetResult(rv));
+
+  // The same entries and trace for both runs.
+  srand(1);
+  const int kNumEntries = 2000;
+  TestEntries entries;
+  EXPECT_TRUE(TimeWrite(kNumEntries, cache.get(), &entries));
+  const std::vector<int> trace = SkewedTrace(kNumEntries, 20000);
+
+  cache.reset();
+  disk_cache::SimpleBackendImpl::FlushWorkerPoolForTesting();
+  base::MessageLoop::current()->RunUntilIdle();
+  EvictCacheFiles(cache_path);
+
+  rv = disk_cache::CreateCacheBackend(net::DISK_CACHE,
+                                      net::CACHE_BACKEND_SIMPLE,
+                                      cache_path,
+                                      0,
+                                      false,
+                                      cache_thread.task_runner(),
+                                      NULL,
+                                      &cache,
+                                      cb.callback());
+  ASSERT_EQ(net::OK, cb.GetResult(rv));
+  disk_cache::TieredBackend* tiered_cache = NULL;
+  if (memory_tier_bytes) {
+    tiered_cache = new disk_cache::TieredBackend(
+        cache.Pass(),
+        disk_cache::MemBackendImpl::CreateBackend(memory_tier_bytes, NULL));
+    cache.reset(tiered_cache);
+  }
+
+  EXPECT_TRUE(TimeReplay(cache.get(), entries, trace, trace_name));
+  if (tiered_cache) {
+    const size_t memory_hits = tiered_cache->memory_hit_count();
+    const size_t disk_hits = tiered_cache->disk_hit_count();
+    perf_test::PrintResult("memory_tier_hits", "", trace_name, memory_hits,
+                           "hits", true);
+    perf_test::PrintResult("disk_tier_hits", "", trace_name, disk_hits, "hits",
+                           true);
+  }
+
+  cache.reset();
+  disk_cache::SimpleBackendImpl::FlushWorkerPoolForTesting();
+  base::MessageLoop::current()->RunUntilIdle();
+}
+
+}  // namespace
+
+TEST_F(DiskCacheTest, Hash) {
+  int seed = static_cast<int>(Time::Now().ToInternalValue());
+  srand(seed);
+
+  base::PerfTimeLogger timer("Hash disk cache keys");
+  for (int i = 0; i < 300000; i++) {
+    std::string key = GenerateKey(true);
+    base::Hash(key);
+  }
+  timer.Done();
+}
+
+TEST_F(DiskCacheTest, CacheBackendPerformance) {
+  ASSERT_TRUE(CleanupCacheDir());
+  CacheBackendPerformance(cache_path_, net::CACHE_BACKEND_BLOCKFILE,
+                          "blockfile");
+}
+
+TEST_F(DiskCacheTest, SimpleCacheBackendPerformance) {
+  ASSERT_TRUE(CleanupCacheDir());
+  CacheBackendPerformance(cache_path_, net::CACHE_BACKEND_SIMPLE, "simple");
+}
+
+// As above, with the small entries packed in segment files.
+TEST_F(DiskCacheTest, SimpleCachePackedBackendPerformance) {
+  ASSERT_TRUE(CleanupCacheDir());
+  CacheBackendPerformance(cache_path_, net::CACHE_BACKEND_SIMPLE_PACKED,
+                          "simple_packed");
+}
+
+// Text bodies, stored as received and compressed. The corpus is synthetic
+// script, style sheet and JSON text.
+TEST_F(DiskCacheTest, UncompressedStreamPerformance) {
+  ASSERT_TRUE(CleanupCacheDir());
+  CompressedStreamPerformance(cache_path_, false, "uncompressed");
+}
+
+TEST_F(DiskCacheTest, CompressedStreamPerformance) {
+  ASSERT_TRUE(CleanupCacheDir());
+  CompressedStreamPerformance(cache_path_, true, "compressed");
+}
+
+// Cache hits following a synthetic Zipf trace, with and without a memory tier
+// in front of the simple cache.
+TEST_F(DiskCacheTest, SimpleCacheReplayPerformance) {
+  ASSERT_TRUE(CleanupCacheDir());
+  TieredReplayPerformance(cache_path_, 0, "simple");
+}
+
+TEST_F(DiskCacheTest, TieredCacheReplayPerformance) {
+  ASSERT_TRUE(CleanupCacheDir());
+  TieredReplayPerformance(cache_path_, 8 * 1024 * 1024, "tiered");
+}
+
 // Creating and deleting "entries" on a block-file is something quite frequent
 // (after all, almost everything is stored on block files). The operation is
 // almost free when the file is empty, but can be expensive if the file gets
@@ -92,11 +92,14 @@ int CacheCreator::Run() {
   static const bool kSimpleBackendIsDefault = false;
 #endif
   if (backend_type_ == net::CACHE_BACKEND_SIMPLE ||
+      backend_type_ == net::CACHE_BACKEND_SIMPLE_PACKED ||
       (backend_type_ == net::CACHE_BACKEND_DEFAULT &&
        kSimpleBackendIsDefault)) {
     disk_cache::SimpleBackendImpl* simple_cache =
         new disk_cache::SimpleBackendImpl(
             path_, max_bytes_, type_, thread_, net_log_);
+    simple_cache->set_use_segment_store(
+        backend_type_ == net::CACHE_BACKEND_SIMPLE_PACKED);
     created_cache_.reset(simple_cache);
     return simple_cache->Init(
         base::Bind(&CacheCreator::OnIOComplete, base::Unretained(this)));
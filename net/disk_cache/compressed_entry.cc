@@ -0,0 +1,496 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/disk_cache/compressed_entry.h"
+
+#include <algorithm>
+
+#include "base/bind.h"
+#include "base/logging.h"
+#include "base/stl_util.h"
+#include "net/base/io_buffer.h"
+#include "net/base/net_errors.h"
+#include "third_party/zlib/zlib.h"
+
+namespace {
+
+const uint32 kFooterMagic = 0xc0de51a6;
+
+struct TableEntry {
+  uint32 size;
+  uint32 logical_size;
+};
+
+struct Footer {
+  uint32 block_count;
+  uint32 magic;
+};
+
+// Runs |callback| with |result|, or with |length| if |result| isn't an error.
+void RunWithLength(const net::CompletionCallback& callback,
+                   int length,
+                   int result) {
+  callback.Run(result < 0 ? result : length);
+}
+
+}  // namespace
+
+namespace disk_cache {
+
+CompressedEntry::Block::Block(int32 offset,
+                              int32 size,
+                              int32 logical_offset,
+                              int32 logical_size)
+    : offset(offset),
+      size(size),
+      logical_offset(logical_offset),
+      logical_size(logical_size) {
+}
+
+CompressedEntry::CompressedEntry(Entry* entry, int stream_index)
+    : entry_(entry),
+      stream_index_(stream_index),
+      compressed_(false),
+      data_end_(0),
+      cached_block_index_(-1),
+      opening_(false),
+      open_result_(net::OK),
+      writing_(false),
+      closing_(false),
+      weak_factory_(this) {
+  DCHECK(entry_);
+}
+
+void CompressedEntry::StartCompressedStream() {
+  DCHECK_EQ(0, entry_->GetDataSize(stream_index_));
+  DCHECK(!opening_);
+  Reset();
+  compressed_ = true;
+}
+
+int CompressedEntry::OpenCompressedStream(
+    const net::CompletionCallback& callback) {
+  if (compressed_)
+    return net::OK;
+  if (opening_) {
+    open_callbacks_.push_back(callback);
+    return net::ERR_IO_PENDING;
+  }
+
+  const int32 size = entry_->GetDataSize(stream_index_);
+  if (size < static_cast<int32>(sizeof(Footer)))
+    return net::ERR_CACHE_READ_FAILURE;
+
+  opening_ = true;
+  open_result_ = net::ERR_IO_PENDING;
+  scoped_refptr<net::IOBuffer> footer(new net::IOBuffer(sizeof(Footer)));
+  int rv = entry_->ReadData(
+      stream_index_, size - sizeof(Footer), footer.get(), sizeof(Footer),
+      base::Bind(&CompressedEntry::OnFooterRead, weak_factory_.GetWeakPtr(),
+                 footer));
+  if (rv != net::ERR_IO_PENDING)
+    OnFooterRead(footer, rv);
+
+  // The open may have completed synchronously, before there was any callback
+  // to run.
+  if (!opening_)
+    return open_result_;
+  open_callbacks_.push_back(callback);
+  return net::ERR_IO_PENDING;
+}
+
+int CompressedEntry::Flush(const net::CompletionCallback& callback) {
+  DCHECK(!writing_);
+  if (!compressed_)
+    return net::OK;
+  return WriteBlocks(true, callback);
+}
+
+int32 CompressedEntry::GetCompressedDataSize() const {
+  return compressed_ ? data_end_ : entry_->GetDataSize(stream_index_);
+}
+
+void CompressedEntry::Doom() {
+  entry_->Doom();
+}
+
+void CompressedEntry::Close() {
+  closing_ = true;
+  if (!writing_)
+    FinishClose();
+}
+
+std::string CompressedEntry::GetKey() const {
+  return entry_->GetKey();
+}
+
+base::Time CompressedEntry::GetLastUsed() const {
+  return entry_->GetLastUsed();
+}
+
+base::Time CompressedEntry::GetLastModified() const {
+  return entry_->GetLastModified();
+}
+
+int32 CompressedEntry::GetDataSize(int index) const {
+  if (index != stream_index_ || !compressed_)
+    return entry_->GetDataSize(index);
+  return GetStoredLogicalSize() + static_cast<int32>(pending_data_.size());
+}
+
+int CompressedEntry::ReadData(int index,
+                              int offset,
+                              net::IOBuffer* buf,
+                              int buf_len,
+                              const CompletionCallback& callback) {
+  if (index != stream_index_ || !compressed_)
+    return entry_->ReadData(index, offset, buf, buf_len, callback);
+
+  if (offset < 0 || buf_len < 0)
+    return net::ERR_INVALID_ARGUMENT;
+  if (offset >= GetDataSize(index) || buf_len == 0)
+    return 0;
+
+  const int32 stored_size = GetStoredLogicalSize();
+  if (offset >= stored_size) {
+    const int length =
+        std::min(buf_len, static_cast<int>(stored_size + pending_data_.size() -
+                                           offset));
+    memcpy(buf->data(), pending_data_.data() + offset - stored_size, length);
+    return length;
+  }
+
+  const size_t block_index = FindBlock(offset);
+  if (static_cast<int>(block_index) == cached_block_index_)
+    return CopyFromCachedBlock(block_index, offset, buf, buf_len);
+
+  const Block& block = blocks_[block_index];
+  scoped_refptr<net::IOBuffer> data(new net::IOBuffer(block.size));
+  int rv = entry_->ReadData(
+      stream_index_, block.offset, data.get(), block.size,
+      base::Bind(&CompressedEntry::OnBlockRead, weak_factory_.GetWeakPtr(),
+                 data, offset, make_scoped_refptr(buf), buf_len, callback));
+  if (rv == net::ERR_IO_PENDING)
+    return rv;
+  return InflateBlock(block_index, data.get(), rv, offset, buf, buf_len);
+}
+
+int CompressedEntry::WriteData(int index,
+                               int offset,
+                               net::IOBuffer* buf,
+                               int buf_len,
+                               const CompletionCallback& callback,
+                               bool truncate) {
+  if (index != stream_index_ || !compressed_)
+    return entry_->WriteData(index, offset, buf, buf_len, callback, truncate);
+
+  DCHECK(!writing_);
+  if (truncate && offset == 0 && buf_len == 0) {
+    Reset();
+    compressed_ = false;
+    return entry_->WriteData(index, offset, buf, buf_len, callback, truncate);
+  }
+  if (offset != GetDataSize(index) || buf_len < 0)
+    return net::ERR_INVALID_ARGUMENT;
+
+  pending_data_.append(buf->data(), buf_len);
+  if (pending_data_.size() < static_cast<size_t>(kBlockSize))
+    return buf_len;
+
+  int rv = WriteBlocks(false, base::Bind(&RunWithLength, callback, buf_len));
+  if (rv == net::ERR_IO_PENDING || rv < 0)
+    return rv;
+  return buf_len;
+}
+
+int CompressedEntry::ReadSparseData(int64 offset,
+                                    net::IOBuffer* buf,
+                                    int buf_len,
+                                    const CompletionCallback& callback) {
+  return entry_->ReadSparseData(offset, buf, buf_len, callback);
+}
+
+int CompressedEntry::WriteSparseData(int64 offset,
+                                     net::IOBuffer* buf,
+                                     int buf_len,
+                                     const CompletionCallback& callback) {
+  return entry_->WriteSparseData(offset, buf, buf_len, callback);
+}
+
+int CompressedEntry::GetAvailableRange(int64 offset,
+                                       int len,
+                                       int64* start,
+                                       const CompletionCallback& callback) {
+  return entry_->GetAvailableRange(offset, len, start, callback);
+}
+
+bool CompressedEntry::CouldBeSparse() const {
+  return entry_->CouldBeSparse();
+}
+
+void CompressedEntry::CancelSparseIO() {
+  entry_->CancelSparseIO();
+}
+
+int CompressedEntry::ReadyForSparseIO(const CompletionCallback& callback) {
+  return entry_->ReadyForSparseIO(callback);
+}
+
+CompressedEntry::~CompressedEntry() {
+}
+
+void CompressedEntry::Reset() {
+  blocks_.clear();
+  data_end_ = 0;
+  pending_data_.clear();
+  cached_block_index_ = -1;
+  cached_block_.clear();
+}
+
+size_t CompressedEntry::FindBlock(int offset) const {
+  DCHECK(!blocks_.empty());
+  size_t begin = 0;
+  size_t end = blocks_.size();
+  while (end - begin > 1) {
+    const size_t middle = begin + (end - begin) / 2;
+    if (blocks_[middle].logical_offset <= offset)
+      begin = middle;
+    else
+      end = middle;
+  }
+  return begin;
+}
+
+int32 CompressedEntry::GetStoredLogicalSize() const {
+  if (blocks_.empty())
+    return 0;
+  return blocks_.back().logical_offset + blocks_.back().logical_size;
+}
+
+void CompressedEntry::OnFooterRead(scoped_refptr<net::IOBuffer> footer_buffer,
+                                   int result) {
+  if (result != static_cast<int>(sizeof(Footer))) {
+    FinishOpen(net::ERR_CACHE_READ_FAILURE);
+    return;
+  }
+
+  Footer footer;
+  memcpy(&footer, footer_buffer->data(), sizeof(footer));
+  const int32 size = entry_->GetDataSize(stream_index_);
+  const uint32 max_block_count =
+      (size - sizeof(Footer)) / sizeof(TableEntry);
+  if (footer.magic != kFooterMagic || footer.block_count > max_block_count) {
+    FinishOpen(net::ERR_CACHE_READ_FAILURE);
+    return;
+  }
+
+  const int32 table_size = footer.block_count * sizeof(TableEntry);
+  if (table_size == 0) {
+    OnTableRead(NULL, 0, 0);
+    return;
+  }
+  scoped_refptr<net::IOBuffer> table(new net::IOBuffer(table_size));
+  int rv = entry_->ReadData(
+      stream_index_, size - sizeof(Footer) - table_size, table.get(),
+      table_size,
+      base::Bind(&CompressedEntry::OnTableRead, weak_factory_.GetWeakPtr(),
+                 table, footer.block_count));
+  if (rv != net::ERR_IO_PENDING)
+    OnTableRead(table, footer.block_count, rv);
+}
+
+void CompressedEntry::OnTableRead(scoped_refptr<net::IOBuffer> table,
+                                  int32 block_count,
+                                  int result) {
+  const int32 table_size = block_count * sizeof(TableEntry);
+  if (result != table_size) {
+    FinishOpen(net::ERR_CACHE_READ_FAILURE);
+    return;
+  }
+
+  BlockList blocks;
+  int64 offset = 0;
+  int64 logical_offset = 0;
+  for (int32 i = 0; i < block_count; ++i) {
+    TableEntry entry;
+    memcpy(&entry, table->data() + i * sizeof(entry), sizeof(entry));
+    if (entry.size == 0 || entry.size > entry.logical_size ||
+        entry.logical_size > static_cast<uint32>(kBlockSize)) {
+      FinishOpen(net::ERR_CACHE_READ_FAILURE);
+      return;
+    }
+    blocks.push_back(Block(static_cast<int32>(offset), entry.size,
+                           static_cast<int32>(logical_offset),
+                           entry.logical_size));
+    offset += entry.size;
+    logical_offset += entry.logical_size;
+  }
+  if (offset + table_size + sizeof(Footer) !=
+          static_cast<uint64>(entry_->GetDataSize(stream_index_)) ||
+      logical_offset > kint32max) {
+    FinishOpen(net::ERR_CACHE_READ_FAILURE);
+    return;
+  }
+
+  Reset();
+  blocks_.swap(blocks);
+  data_end_ = static_cast<int32>(offset);
+  compressed_ = true;
+  FinishOpen(net::OK);
+}
+
+void CompressedEntry::FinishOpen(int result) {
+  DCHECK(opening_);
+  opening_ = false;
+  open_result_ = result;
+  std::vector<CompletionCallback> callbacks;
+  callbacks.swap(open_callbacks_);
+  for (size_t i = 0; i < callbacks.size(); ++i)
+    callbacks[i].Run(result);
+}
+
+int CompressedEntry::CopyFromCachedBlock(size_t block_index,
+                                         int offset,
+                                         net::IOBuffer* buf,
+                                         int buf_len) {
+  DCHECK_EQ(static_cast<int>(block_index), cached_block_index_);
+  const Block& block = blocks_[block_index];
+  const int offset_in_block = offset - block.logical_offset;
+  const int length = std::min(buf_len, block.logical_size - offset_in_block);
+  memcpy(buf->data(), cached_block_.data() + offset_in_block, length);
+  return length;
+}
+
+int CompressedEntry::InflateBlock(size_t block_index,
+                                  net::IOBuffer* data,
+                                  int result,
+                                  int offset,
+                                  net::IOBuffer* buf,
+                                  int buf_len) {
+  const Block& block = blocks_[block_index];
+  if (result != block.size)
+    return result < 0 ? result : net::ERR_CACHE_READ_FAILURE;
+
+  cached_block_index_ = -1;
+  if (block.size == block.logical_size) {
+    cached_block_.assign(data->data(), block.size);
+  } else {
+    cached_block_.resize(block.logical_size);
+    uLongf inflated_size = block.logical_size;
+    if (uncompress(reinterpret_cast<Bytef*>(string_as_array(&cached_block_)),
+                   &inflated_size, reinterpret_cast<Bytef*>(data->data()),
+                   block.size) != Z_OK ||
+        inflated_size != static_cast<uLongf>(block.logical_size)) {
+      return net::ERR_CACHE_READ_FAILURE;
+    }
+  }
+  cached_block_index_ = block_index;
+  return CopyFromCachedBlock(block_index, offset, buf, buf_len);
+}
+
+void CompressedEntry::OnBlockRead(scoped_refptr<net::IOBuffer> data,
+                                  int offset,
+                                  scoped_refptr<net::IOBuffer> buf,
+                                  int buf_len,
+                                  const CompletionCallback& callback,
+                                  int result) {
+  if (!compressed_ || offset >= GetStoredLogicalSize()) {
+    // The stream was truncated while the block was read.
+    callback.Run(net::ERR_FAILED);
+    return;
+  }
+  callback.Run(InflateBlock(FindBlock(offset), data.get(), result, offset,
+                            buf.get(), buf_len));
+}
+
+int CompressedEntry::WriteBlocks(bool flush,
+                                 const CompletionCallback& callback) {
+  std::string data;
+  size_t consumed = 0;
+  while (pending_data_.size() - consumed >= static_cast<size_t>(kBlockSize) ||
+         (flush && consumed < pending_data_.size())) {
+    const int32 logical_size = std::min(
+        static_cast<size_t>(kBlockSize), pending_data_.size() - consumed);
+    const char* logical_data = pending_data_.data() + consumed;
+
+    uLongf size = compressBound(logical_size);
+    const size_t block_offset = data.size();
+    data.resize(block_offset + size);
+    Bytef* block_data =
+        reinterpret_cast<Bytef*>(string_as_array(&data) + block_offset);
+    if (compress2(block_data, &size,
+                  reinterpret_cast<const Bytef*>(logical_data), logical_size,
+                  Z_BEST_SPEED) != Z_OK ||
+        size >= static_cast<uLongf>(logical_size)) {
+      // Store the block as is.
+      size = logical_size;
+      memcpy(block_data, logical_data, logical_size);
+    }
+    data.resize(block_offset + size);
+
+    blocks_.push_back(Block(data_end_ + block_offset, size,
+                            GetStoredLogicalSize(), logical_size));
+    consumed += logical_size;
+  }
+  if (!consumed)
+    return net::OK;
+  pending_data_.erase(0, consumed);
+
+  for (size_t i = 0; i < blocks_.size(); ++i) {
+    TableEntry entry;
+    entry.size = blocks_[i].size;
+    entry.logical_size = blocks_[i].logical_size;
+    data.append(reinterpret_cast<const char*>(&entry), sizeof(entry));
+  }
+  Footer footer;
+  footer.block_count = blocks_.size();
+  footer.magic = kFooterMagic;
+  data.append(reinterpret_cast<const char*>(&footer), sizeof(footer));
+
+  const int32 write_offset = data_end_;
+  data_end_ = blocks_.back().offset + blocks_.back().size;
+  scoped_refptr<net::StringIOBuffer> buffer(new net::StringIOBuffer(data));
+
+  writing_ = true;
+  int rv = entry_->WriteData(
+      stream_index_, write_offset, buffer.get(), buffer->size(),
+      base::Bind(&CompressedEntry::OnBlocksWritten, weak_factory_.GetWeakPtr(),
+                 callback),
+      true);
+  if (rv == net::ERR_IO_PENDING)
+    return rv;
+  writing_ = false;
+  return rv < 0 ? rv : net::OK;
+}
+
+void CompressedEntry::OnBlocksWritten(const CompletionCallback& callback,
+                                      int result) {
+  writing_ = false;
+  if (closing_) {
+    // The entry was closed while the blocks were being written, and there is
+    // no one left to tell.
+    if (result < 0) {
+      entry_->Doom();
+      pending_data_.clear();
+    }
+    FinishClose();
+    return;
+  }
+  callback.Run(result < 0 ? result : net::OK);
+}
+
+void CompressedEntry::FinishClose() {
+  DCHECK(closing_);
+  if (compressed_ && !pending_data_.empty()) {
+    int rv = WriteBlocks(true, CompletionCallback());
+    if (rv == net::ERR_IO_PENDING)
+      return;
+    if (rv < 0)
+      entry_->Doom();
+  }
+  entry_->Close();
+  delete this;
+}
+
+}  // namespace disk_cache
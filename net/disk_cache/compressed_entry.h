@@ -0,0 +1,185 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_DISK_CACHE_COMPRESSED_ENTRY_H_
+#define NET_DISK_CACHE_COMPRESSED_ENTRY_H_
+
+#include <string>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "base/memory/ref_counted.h"
+#include "base/memory/weak_ptr.h"
+#include "net/base/completion_callback.h"
+#include "net/base/net_export.h"
+#include "net/disk_cache/disk_cache.h"
+
+namespace net {
+class IOBuffer;
+}
+
+namespace disk_cache {
+
+// A CompressedEntry wraps an entry of any backend, and can store one of its
+// streams compressed. The other streams and the sparse data of the entry are
+// passed through untouched, as is the compressed stream until it is switched
+// to compressed mode by StartCompressedStream() or OpenCompressedStream().
+//
+// A compressed stream holds blocks of up to kBlockSize bytes deflated one at a
+// time, so that a read at any offset only inflates the block holding it,
+// followed by a table of the blocks and a footer:
+//
+//   +---------+-----+---------+--------------------------+--------+
+//   | Block 0 | ... | Block n | n x (size, logical size) | Footer |
+//   +---------+-----+---------+--------------------------+--------+
+//
+// A block that doesn't deflate to less than its logical size is stored as is.
+// Every write that completes a block rewrites the table and the footer after
+// it, and Flush(), or else Close(), writes the last, partial, block. Writes to
+// a compressed stream must append to it, or truncate it to zero bytes, which
+// switches it back to the uncompressed mode.
+//
+// GetDataSize() of a compressed stream returns its logical size. Reads return
+// bytes from at most one block, and may be short.
+class NET_EXPORT_PRIVATE CompressedEntry : public Entry {
+ public:
+  // The logical size of the blocks of a compressed stream.
+  static const int kBlockSize = 32 * 1024;
+
+  // Wraps |entry|, which is closed when this entry is. |stream_index| is the
+  // index of the stream that may be compressed.
+  CompressedEntry(Entry* entry, int stream_index);
+
+  // Switches the stream, which must be empty, to compressed mode.
+  void StartCompressedStream();
+
+  // Switches the stream to compressed mode by reading the table of the stored
+  // blocks. Returns a net error code, or net::ERR_IO_PENDING if |callback|
+  // will be called with one. Fails with net::ERR_CACHE_READ_FAILURE if the
+  // stream doesn't hold a compressed stream.
+  int OpenCompressedStream(const net::CompletionCallback& callback);
+
+  // Writes the data of the compressed stream that follows its last complete
+  // block as a partial block, so that the stream can be read, or appended to,
+  // by another CompressedEntry. Returns a net error code, or
+  // net::ERR_IO_PENDING if |callback| will be called with one.
+  int Flush(const net::CompletionCallback& callback);
+
+  bool is_compressed() const { return compressed_; }
+
+  // The bytes used on disk by the compressed stream, excluding the data that
+  // hasn't been written yet.
+  int32 GetCompressedDataSize() const;
+
+  // Entry interface.
+  virtual void Doom() OVERRIDE;
+  virtual void Close() OVERRIDE;
+  virtual std::string GetKey() const OVERRIDE;
+  virtual base::Time GetLastUsed() const OVERRIDE;
+  virtual base::Time GetLastModified() const OVERRIDE;
+  virtual int32 GetDataSize(int index) const OVERRIDE;
+  virtual int ReadData(int index, int offset, net::IOBuffer* buf, int buf_len,
+                       const CompletionCallback& callback) OVERRIDE;
+  virtual int WriteData(int index, int offset, net::IOBuffer* buf, int buf_len,
+                        const CompletionCallback& callback,
+                        bool truncate) OVERRIDE;
+  virtual int ReadSparseData(int64 offset, net::IOBuffer* buf, int buf_len,
+                             const CompletionCallback& callback) OVERRIDE;
+  virtual int WriteSparseData(int64 offset, net::IOBuffer* buf, int buf_len,
+                              const CompletionCallback& callback) OVERRIDE;
+  virtual int GetAvailableRange(int64 offset, int len, int64* start,
+                                const CompletionCallback& callback) OVERRIDE;
+  virtual bool CouldBeSparse() const OVERRIDE;
+  virtual void CancelSparseIO() OVERRIDE;
+  virtual int ReadyForSparseIO(const CompletionCallback& callback) OVERRIDE;
+
+ private:
+  struct Block {
+    Block(int32 offset, int32 size, int32 logical_offset, int32 logical_size);
+
+    int32 offset;
+    int32 size;
+    int32 logical_offset;
+    int32 logical_size;
+  };
+  typedef std::vector<Block> BlockList;
+
+  virtual ~CompressedEntry();
+
+  // Resets the compressed stream state to that of an empty stream.
+  void Reset();
+
+  // Returns the index of the block holding the logical |offset|, which must be
+  // stored in a block.
+  size_t FindBlock(int offset) const;
+
+  // The logical size of the blocks written to the entry.
+  int32 GetStoredLogicalSize() const;
+
+  // Reads the table of the blocks, once the footer is in |footer|.
+  void OnFooterRead(scoped_refptr<net::IOBuffer> footer, int result);
+  void OnTableRead(scoped_refptr<net::IOBuffer> table, int32 block_count,
+                   int result);
+  void FinishOpen(int result);
+
+  // Copies bytes of the block |block_index|, which is held inflated in
+  // |cached_block_|, from the logical |offset| to |buf|.
+  int CopyFromCachedBlock(size_t block_index, int offset, net::IOBuffer* buf,
+                          int buf_len);
+
+  // Inflates the block |block_index| from |data|, which |result| bytes were
+  // read to, into |cached_block_| and copies bytes from it to |buf|.
+  int InflateBlock(size_t block_index, net::IOBuffer* data, int result,
+                   int offset, net::IOBuffer* buf, int buf_len);
+  void OnBlockRead(scoped_refptr<net::IOBuffer> data, int offset,
+                   scoped_refptr<net::IOBuffer> buf, int buf_len,
+                   const CompletionCallback& callback, int result);
+
+  // Deflates the complete blocks of |pending_data_|, or all of it if |flush|,
+  // and writes them to the entry along with the new table and footer. Returns
+  // net::OK if there was nothing to write.
+  int WriteBlocks(bool flush, const CompletionCallback& callback);
+  void OnBlocksWritten(const CompletionCallback& callback, int result);
+
+  // Writes the remaining data once no write is in progress, then closes the
+  // wrapped entry and deletes this one. The entry is doomed if a write fails,
+  // as the stream would be missing data.
+  void FinishClose();
+
+  Entry* const entry_;
+  const int stream_index_;
+
+  bool compressed_;
+
+  // The blocks of the compressed stream, and the end of their data.
+  BlockList blocks_;
+  int32 data_end_;
+
+  // The logical bytes that follow the last block, and have yet to be written.
+  std::string pending_data_;
+
+  // The last block read, inflated, if |cached_block_index_| isn't -1.
+  int cached_block_index_;
+  std::string cached_block_;
+
+  // Set while the table of the blocks is read. |open_result_| is the result
+  // of the last open.
+  bool opening_;
+  int open_result_;
+
+  // The callbacks of the OpenCompressedStream() calls in progress.
+  std::vector<CompletionCallback> open_callbacks_;
+
+  // Set while blocks are written, and once Close() was called.
+  bool writing_;
+  bool closing_;
+
+  base::WeakPtrFactory<CompressedEntry> weak_factory_;
+
+  DISALLOW_COPY_AND_ASSIGN(CompressedEntry);
+};
+
+}  // namespace disk_cache
+
+#endif  // NET_DISK_CACHE_COMPRESSED_ENTRY_H_
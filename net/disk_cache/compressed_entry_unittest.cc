@@ -0,0 +1,265 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/disk_cache/compressed_entry.h"
+
+#include <string>
+
+#include "base/basictypes.h"
+#include "base/strings/stringprintf.h"
+#include "net/base/io_buffer.h"
+#include "net/base/net_errors.h"
+#include "net/base/test_completion_callback.h"
+#include "net/disk_cache/disk_cache_test_base.h"
+#include "net/disk_cache/disk_cache_test_util.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace {
+
+const int kStream = 1;
+
+// Returns |size| bytes of text that deflates well.
+std::string CompressibleData(int size) {
+  std::string data;
+  for (int i = 0; static_cast<int>(data.size()) < size; ++i) {
+    data += base::StringPrintf(
+        "var item%d = document.getElementById('item%d');\n", i % 97, i);
+  }
+  data.resize(size);
+  return data;
+}
+
+}  // namespace
+
+class DiskCacheCompressedEntryTest : public DiskCacheTestWithCache {
+ protected:
+  // Creates an entry, wrapped in |entry|.
+  void CreateCompressedEntry(const std::string& key,
+                             disk_cache::CompressedEntry** entry) {
+    disk_cache::Entry* inner_entry = NULL;
+    ASSERT_EQ(net::OK, CreateEntry(key, &inner_entry));
+    *entry = new disk_cache::CompressedEntry(inner_entry, kStream);
+  }
+
+  // Opens an entry, wrapped in |entry|, and the compressed stream in it.
+  void OpenCompressedEntry(const std::string& key,
+                           disk_cache::CompressedEntry** entry) {
+    disk_cache::Entry* inner_entry = NULL;
+    ASSERT_EQ(net::OK, OpenEntry(key, &inner_entry));
+    *entry = new disk_cache::CompressedEntry(inner_entry, kStream);
+    net::TestCompletionCallback cb;
+    ASSERT_EQ(net::OK,
+              cb.GetResult((*entry)->OpenCompressedStream(cb.callback())));
+  }
+
+  void Append(disk_cache::Entry* entry, const std::string& data) {
+    scoped_refptr<net::StringIOBuffer> buffer(new net::StringIOBuffer(data));
+    const int size = entry->GetDataSize(kStream);
+    EXPECT_EQ(buffer->size(),
+              WriteData(entry, kStream, size, buffer.get(), buffer->size(),
+                        false));
+  }
+
+  // Reads |length| bytes from |offset|, which may take several reads.
+  std::string Read(disk_cache::Entry* entry, int offset, int length) {
+    scoped_refptr<net::IOBuffer> buffer(new net::IOBuffer(length));
+    int read = 0;
+    while (read < length) {
+      scoped_refptr<net::WrappedIOBuffer> destination(
+          new net::WrappedIOBuffer(buffer->data() + read));
+      int rv = ReadData(entry, kStream, offset + read, destination.get(),
+                        length - read);
+      if (rv <= 0)
+        break;
+      read += rv;
+    }
+    return std::string(buffer->data(), read);
+  }
+
+  void RoundTrip();
+  void AppendAfterReopen();
+};
+
+void DiskCacheCompressedEntryTest::RoundTrip() {
+  InitCache();
+  const std::string data = CompressibleData(
+      3 * disk_cache::CompressedEntry::kBlockSize + 1000);
+
+  disk_cache::CompressedEntry* entry = NULL;
+  CreateCompressedEntry("the key", &entry);
+  entry->StartCompressedStream();
+  EXPECT_TRUE(entry->is_compressed());
+  Append(entry, data.substr(0, 1000));
+  Append(entry, data.substr(1000, 50000));
+  Append(entry, data.substr(51000));
+  EXPECT_EQ(static_cast<int32>(data.size()), entry->GetDataSize(kStream));
+  EXPECT_GT(entry->GetCompressedDataSize(), 0);
+  EXPECT_LT(entry->GetCompressedDataSize(),
+            3 * disk_cache::CompressedEntry::kBlockSize / 2);
+
+  // The data that follows the last complete block is read from memory.
+  EXPECT_EQ(data.substr(data.size() - 500),
+            Read(entry, data.size() - 500, 500));
+  entry->Close();
+
+  OpenCompressedEntry("the key", &entry);
+  EXPECT_EQ(static_cast<int32>(data.size()), entry->GetDataSize(kStream));
+  EXPECT_EQ(data, Read(entry, 0, data.size()));
+
+  // Reads across block boundaries, and past the end.
+  const int offset = disk_cache::CompressedEntry::kBlockSize - 10;
+  EXPECT_EQ(data.substr(offset, 100), Read(entry, offset, 100));
+  EXPECT_EQ(data.substr(2 * offset, 100), Read(entry, 2 * offset, 100));
+  EXPECT_EQ(data.substr(data.size() - 10), Read(entry, data.size() - 10, 100));
+  EXPECT_EQ("", Read(entry, data.size(), 100));
+  entry->Close();
+}
+
+TEST_F(DiskCacheCompressedEntryTest, MemoryOnlyRoundTrip) {
+  SetMemoryOnlyMode();
+  RoundTrip();
+}
+
+TEST_F(DiskCacheCompressedEntryTest, SimpleCacheRoundTrip) {
+  SetSimpleCacheMode();
+  RoundTrip();
+}
+
+void DiskCacheCompressedEntryTest::AppendAfterReopen() {
+  InitCache();
+  const std::string data = CompressibleData(100000);
+
+  disk_cache::CompressedEntry* entry = NULL;
+  CreateCompressedEntry("the key", &entry);
+  entry->StartCompressedStream();
+  Append(entry, data.substr(0, 40000));
+  entry->Close();
+
+  // The short block written on close is followed by new blocks.
+  OpenCompressedEntry("the key", &entry);
+  Append(entry, data.substr(40000));
+  entry->Close();
+
+  OpenCompressedEntry("the key", &entry);
+  EXPECT_EQ(static_cast<int32>(data.size()), entry->GetDataSize(kStream));
+  EXPECT_EQ(data, Read(entry, 0, data.size()));
+  EXPECT_EQ(data.substr(39990, 20), Read(entry, 39990, 20));
+  entry->Close();
+}
+
+TEST_F(DiskCacheCompressedEntryTest, MemoryOnlyAppendAfterReopen) {
+  SetMemoryOnlyMode();
+  AppendAfterReopen();
+}
+
+TEST_F(DiskCacheCompressedEntryTest, SimpleCacheAppendAfterReopen) {
+  SetSimpleCacheMode();
+  AppendAfterReopen();
+}
+
+// Tests that Flush() writes the partial last block, so that the stream can be
+// opened while the writer still has it open.
+TEST_F(DiskCacheCompressedEntryTest, Flush) {
+  SetMemoryOnlyMode();
+  InitCache();
+  const std::string data = CompressibleData(40000);
+
+  disk_cache::CompressedEntry* entry = NULL;
+  CreateCompressedEntry("the key", &entry);
+  EXPECT_EQ(net::OK, entry->Flush(net::CompletionCallback()));
+  entry->StartCompressedStream();
+  Append(entry, data);
+  net::TestCompletionCallback cb;
+  EXPECT_EQ(net::OK, cb.GetResult(entry->Flush(cb.callback())));
+  EXPECT_EQ(static_cast<int32>(data.size()), entry->GetDataSize(kStream));
+
+  disk_cache::CompressedEntry* reader = NULL;
+  OpenCompressedEntry("the key", &reader);
+  EXPECT_EQ(static_cast<int32>(data.size()), reader->GetDataSize(kStream));
+  EXPECT_EQ(data, Read(reader, 0, data.size()));
+  reader->Close();
+
+  // Appends after a flush follow the partial block.
+  Append(entry, data);
+  entry->Close();
+  OpenCompressedEntry("the key", &entry);
+  EXPECT_EQ(data + data, Read(entry, 0, 2 * data.size()));
+  entry->Close();
+}
+
+// Tests that the streams are passed through until the stream is compressed.
+TEST_F(DiskCacheCompressedEntryTest, PassThrough) {
+  SetMemoryOnlyMode();
+  InitCache();
+  const std::string data = CompressibleData(50000);
+
+  disk_cache::CompressedEntry* entry = NULL;
+  CreateCompressedEntry("the key", &entry);
+  Append(entry, data);
+  EXPECT_FALSE(entry->is_compressed());
+  EXPECT_EQ(static_cast<int32>(data.size()), entry->GetDataSize(kStream));
+  EXPECT_EQ(static_cast<int32>(data.size()), entry->GetCompressedDataSize());
+  entry->Close();
+
+  disk_cache::Entry* inner_entry = NULL;
+  ASSERT_EQ(net::OK, OpenEntry("the key", &inner_entry));
+  EXPECT_EQ(data, Read(inner_entry, 0, data.size()));
+
+  // An uncompressed stream can't be opened as a compressed one.
+  entry = new disk_cache::CompressedEntry(inner_entry, kStream);
+  net::TestCompletionCallback cb;
+  EXPECT_EQ(net::ERR_CACHE_READ_FAILURE,
+            cb.GetResult(entry->OpenCompressedStream(cb.callback())));
+  EXPECT_FALSE(entry->is_compressed());
+  EXPECT_EQ(data, Read(entry, 0, data.size()));
+  entry->Close();
+}
+
+// Tests that blocks that don't deflate are stored as they are.
+TEST_F(DiskCacheCompressedEntryTest, Incompressible) {
+  SetMemoryOnlyMode();
+  InitCache();
+  const int kSize = 2 * disk_cache::CompressedEntry::kBlockSize;
+  scoped_refptr<net::IOBuffer> buffer(new net::IOBuffer(kSize));
+  CacheTestFillBuffer(buffer->data(), kSize, false);
+  const std::string data(buffer->data(), kSize);
+
+  disk_cache::CompressedEntry* entry = NULL;
+  CreateCompressedEntry("the key", &entry);
+  entry->StartCompressedStream();
+  Append(entry, data);
+  EXPECT_EQ(kSize, entry->GetCompressedDataSize());
+  entry->Close();
+
+  OpenCompressedEntry("the key", &entry);
+  EXPECT_EQ(data, Read(entry, 0, kSize));
+  entry->Close();
+}
+
+// Tests that truncating a compressed stream switches it back to the
+// uncompressed mode, and that only appends are allowed otherwise.
+TEST_F(DiskCacheCompressedEntryTest, Truncate) {
+  SetMemoryOnlyMode();
+  InitCache();
+  const std::string data = CompressibleData(50000);
+
+  disk_cache::CompressedEntry* entry = NULL;
+  CreateCompressedEntry("the key", &entry);
+  entry->StartCompressedStream();
+  Append(entry, data);
+
+  scoped_refptr<net::StringIOBuffer> buffer(new net::StringIOBuffer("data"));
+  EXPECT_EQ(net::ERR_INVALID_ARGUMENT,
+            WriteData(entry, kStream, 10, buffer.get(), buffer->size(),
+                      false));
+
+  EXPECT_EQ(0, WriteData(entry, kStream, 0, NULL, 0, true));
+  EXPECT_FALSE(entry->is_compressed());
+  EXPECT_EQ(0, entry->GetDataSize(kStream));
+  EXPECT_EQ(buffer->size(),
+            WriteData(entry, kStream, 10, buffer.get(), buffer->size(),
+                      false));
+  EXPECT_EQ("data", Read(entry, 10, buffer->size()));
+  entry->Close();
+}
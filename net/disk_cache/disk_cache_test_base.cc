@@ -75,6 +75,8 @@ DiskCacheTestWithCache::DiskCacheTestWithCache()
       type_(net::DISK_CACHE),
       memory_only_(false),
       simple_cache_mode_(false),
+      simple_cache_packed_(false),
+      simple_cache_mapped_index_(false),
       simple_cache_wait_for_index_(true),
       force_creation_(false),
       new_eviction_(false),
@@ -305,6 +307,8 @@ void DiskCacheTestWithCache::CreateBackend(uint32 flags, base::Thread* thread) {
     scoped_ptr<disk_cache::SimpleBackendImpl> simple_backend(
         new disk_cache::SimpleBackendImpl(
             cache_path_, size_, type_, runner, NULL));
+    simple_backend->set_use_segment_store(simple_cache_packed_);
+    simple_backend->set_use_mapped_index(simple_cache_mapped_index_);
     int rv = simple_backend->Init(cb.callback());
     ASSERT_EQ(net::OK, cb.GetResult(rv));
     simple_cache_impl_ = simple_backend.get();
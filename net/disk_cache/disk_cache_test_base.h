@@ -86,6 +86,18 @@ class DiskCacheTestWithCache : public DiskCacheTest {
     simple_cache_mode_ = true;
   }
 
+  // Uses a simple cache packing its small entries in segment files.
+  void SetSimpleCachePackedMode() {
+    simple_cache_mode_ = true;
+    simple_cache_packed_ = true;
+  }
+
+  // Uses a simple cache keeping its index in a memory mapped table.
+  void SetSimpleCacheMappedIndexMode() {
+    simple_cache_mode_ = true;
+    simple_cache_mapped_index_ = true;
+  }
+
   void SetMask(uint32 mask) {
     mask_ = mask;
   }
@@ -168,6 +180,8 @@ class DiskCacheTestWithCache : public DiskCacheTest {
   net::CacheType type_;
   bool memory_only_;
   bool simple_cache_mode_;
+  bool simple_cache_packed_;
+  bool simple_cache_mapped_index_;
   bool simple_cache_wait_for_index_;
   bool force_creation_;
   bool new_eviction_;
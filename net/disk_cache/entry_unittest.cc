@@ -7,6 +7,7 @@
 #include "base/bind_helpers.h"
 #include "base/files/file.h"
 #include "base/files/file_util.h"
+#include "base/run_loop.h"
 #include "base/strings/string_util.h"
 #include "base/strings/stringprintf.h"
 #include "base/threading/platform_thread.h"
@@ -20,6 +21,7 @@
 #include "net/disk_cache/disk_cache_test_base.h"
 #include "net/disk_cache/disk_cache_test_util.h"
 #include "net/disk_cache/memory/mem_entry_impl.h"
+#include "net/disk_cache/simple/simple_backend_impl.h"
 #include "net/disk_cache/simple/simple_entry_format.h"
 #include "net/disk_cache/simple/simple_entry_impl.h"
 #include "net/disk_cache/simple/simple_synchronous_entry.h"
@@ -2486,6 +2488,97 @@ TEST_F(DiskCacheEntryTest, SimpleCacheDoomedEntry) {
   }
 }
 
+TEST_F(DiskCacheEntryTest, SimpleCachePackedInternalAsyncIO) {
+  SetSimpleCachePackedMode();
+  InitCache();
+  InternalAsyncIO();
+}
+
+TEST_F(DiskCacheEntryTest, SimpleCachePackedGrowData) {
+  SetSimpleCachePackedMode();
+  InitCache();
+  for (int i = 0; i < disk_cache::kSimpleEntryStreamCount; ++i) {
+    EXPECT_EQ(net::OK, DoomAllEntries());
+    GrowData(i);
+  }
+}
+
+TEST_F(DiskCacheEntryTest, SimpleCachePackedReuseExternalEntry) {
+  SetSimpleCachePackedMode();
+  SetMaxSize(400 * 1024);
+  InitCache();
+  for (int i = 0; i < disk_cache::kSimpleEntryStreamCount; ++i) {
+    EXPECT_EQ(net::OK, DoomAllEntries());
+    ReuseEntry(40 * 1024, i);
+  }
+}
+
+TEST_F(DiskCacheEntryTest, SimpleCachePackedDoomEntry) {
+  SetSimpleCachePackedMode();
+  InitCache();
+  DoomNormalEntry();
+}
+
+TEST_F(DiskCacheEntryTest, SimpleCachePackedDoomedEntry) {
+  SetSimpleCachePackedMode();
+  InitCache();
+  for (int i = 0; i < disk_cache::kSimpleEntryStreamCount - 1; ++i) {
+    EXPECT_EQ(net::OK, DoomAllEntries());
+    DoomedEntry(i);
+  }
+}
+
+// Tests that a small entry is packed in a segment, that a large one gets a
+// file of its own, and that both are read back after reopening the cache.
+TEST_F(DiskCacheEntryTest, SimpleCachePackedReopen) {
+  SetSimpleCachePackedMode();
+  InitCache();
+
+  const char kSmallKey[] = "the small key";
+  const char kLargeKey[] = "the large key";
+  const int kSmallSize = 1024;
+  const int kLargeSize = 40 * 1024;
+  scoped_refptr<net::IOBuffer> small_buffer(new net::IOBuffer(kSmallSize));
+  scoped_refptr<net::IOBuffer> large_buffer(new net::IOBuffer(kLargeSize));
+  CacheTestFillBuffer(small_buffer->data(), kSmallSize, false);
+  CacheTestFillBuffer(large_buffer->data(), kLargeSize, false);
+
+  disk_cache::Entry* entry = NULL;
+  ASSERT_EQ(net::OK, CreateEntry(kSmallKey, &entry));
+  EXPECT_EQ(kSmallSize,
+            WriteData(entry, 1, 0, small_buffer.get(), kSmallSize, false));
+  entry->Close();
+  ASSERT_EQ(net::OK, CreateEntry(kLargeKey, &entry));
+  EXPECT_EQ(kLargeSize,
+            WriteData(entry, 1, 0, large_buffer.get(), kLargeSize, false));
+  entry->Close();
+  base::RunLoop().RunUntilIdle();
+  disk_cache::SimpleBackendImpl::FlushWorkerPoolForTesting();
+
+  EXPECT_FALSE(base::PathExists(cache_path_.AppendASCII(
+      disk_cache::simple_util::GetFilenameFromKeyAndFileIndex(kSmallKey, 0))));
+  EXPECT_TRUE(base::PathExists(cache_path_.AppendASCII(
+      disk_cache::simple_util::GetFilenameFromKeyAndFileIndex(kLargeKey, 0))));
+
+  cache_.reset();
+  simple_cache_impl_ = NULL;
+  disk_cache::SimpleBackendImpl::FlushWorkerPoolForTesting();
+  base::RunLoop().RunUntilIdle();
+  DisableFirstCleanup();
+  InitCache();
+  EXPECT_EQ(2, cache_->GetEntryCount());
+
+  scoped_refptr<net::IOBuffer> read_buffer(new net::IOBuffer(kLargeSize));
+  ASSERT_EQ(net::OK, OpenEntry(kSmallKey, &entry));
+  EXPECT_EQ(kSmallSize, ReadData(entry, 1, 0, read_buffer.get(), kLargeSize));
+  EXPECT_EQ(0, memcmp(small_buffer->data(), read_buffer->data(), kSmallSize));
+  entry->Close();
+  ASSERT_EQ(net::OK, OpenEntry(kLargeKey, &entry));
+  EXPECT_EQ(kLargeSize, ReadData(entry, 1, 0, read_buffer.get(), kLargeSize));
+  EXPECT_EQ(0, memcmp(large_buffer->data(), read_buffer->data(), kLargeSize));
+  entry->Close();
+}
+
 // Creates an entry with corrupted last byte in stream 0.
 // Requires SimpleCacheMode.
 bool DiskCacheEntryTest::SimpleCacheMakeBadChecksumEntry(const std::string& key,
@@ -32,6 +32,7 @@
 #include "net/disk_cache/simple/simple_histogram_macros.h"
 #include "net/disk_cache/simple/simple_index.h"
 #include "net/disk_cache/simple/simple_index_file.h"
+#include "net/disk_cache/simple/simple_segment_store.h"
 #include "net/disk_cache/simple/simple_synchronous_entry.h"
 #include "net/disk_cache/simple/simple_util.h"
 #include "net/disk_cache/simple/simple_version_upgrade.h"
@@ -77,6 +78,17 @@ void MaybeCreateSequencedWorkerPool() {
   }
 }
 
+// Whether the index is mapped by default, which the "SimpleCacheMappedIndex"
+// field trial turns on.
+bool ShouldUseMappedIndex() {
+#if defined(OS_POSIX)
+  return base::FieldTrialList::FindFullName("SimpleCacheMappedIndex") ==
+      "Enabled";
+#else
+  return false;
+#endif
+}
+
 bool g_fd_limit_histogram_has_been_populated = false;
 
 void MaybeHistogramFdLimit(net::CacheType cache_type) {
@@ -232,6 +244,8 @@ SimpleBackendImpl::SimpleBackendImpl(
     : path_(path),
       cache_type_(cache_type),
       cache_thread_(cache_thread),
+      use_segment_store_(false),
+      use_mapped_index_(ShouldUseMappedIndex()),
       orig_max_size_(max_bytes),
       entry_operations_mode_(cache_type == net::DISK_CACHE ?
                                  SimpleEntryImpl::OPTIMISTIC_OPERATIONS :
@@ -249,21 +263,27 @@ int SimpleBackendImpl::Init(const CompletionCallback& completion_callback) {
 
   worker_pool_ = g_sequenced_worker_pool->GetTaskRunnerWithShutdownBehavior(
       SequencedWorkerPool::CONTINUE_ON_SHUTDOWN);
+  if (use_segment_store_)
+    segment_store_ = new SimpleSegmentStore(path_, worker_pool_);
 
+  scoped_ptr<SimpleIndexFile> index_file(new SimpleIndexFile(
+      cache_thread_, worker_pool_.get(), cache_type_, path_));
+  index_file->set_use_mapped_index(use_mapped_index_);
   index_.reset(new SimpleIndex(
       base::ThreadTaskRunnerHandle::Get(),
       this,
       cache_type_,
-      make_scoped_ptr(new SimpleIndexFile(
-          cache_thread_, worker_pool_.get(), cache_type_, path_))));
+      index_file.Pass()));
   index_->ExecuteWhenReady(
       base::Bind(&RecordIndexLoad, cache_type_, base::TimeTicks::Now()));
 
   PostTaskAndReplyWithResult(
       cache_thread_.get(),
       FROM_HERE,
-      base::Bind(
-          &SimpleBackendImpl::InitCacheStructureOnDisk, path_, orig_max_size_),
+      base::Bind(&SimpleBackendImpl::InitCacheStructureOnDisk,
+                 path_,
+                 orig_max_size_,
+                 segment_store_),
       base::Bind(&SimpleBackendImpl::InitializeIndex,
                  AsWeakPtr(),
                  completion_callback));
@@ -351,7 +371,8 @@ void SimpleBackendImpl::DoomEntries(std::vector<uint64>* entry_hashes,
                              FROM_HERE,
                              base::Bind(&SimpleSynchronousEntry::DoomEntrySet,
                                         mass_doom_entry_hashes_ptr,
-                                        path_),
+                                        path_,
+                                        segment_store_),
                              base::Bind(&SimpleBackendImpl::DoomEntriesComplete,
                                         AsWeakPtr(),
                                         base::Passed(&mass_doom_entry_hashes),
@@ -564,7 +585,8 @@ void SimpleBackendImpl::InitializeIndex(const CompletionCallback& callback,
 
 SimpleBackendImpl::DiskStatResult SimpleBackendImpl::InitCacheStructureOnDisk(
     const base::FilePath& path,
-    uint64 suggested_max_size) {
+    uint64 suggested_max_size,
+    const scoped_refptr<SimpleSegmentStore>& segment_store) {
   DiskStatResult result;
   result.max_size = suggested_max_size;
   result.net_error = net::OK;
@@ -572,10 +594,19 @@ SimpleBackendImpl::DiskStatResult SimpleBackendImpl::InitCacheStructureOnDisk(
     LOG(ERROR) << "Simple Cache Backend: wrong file structure on disk: "
                << path.LossyDisplayName();
     result.net_error = net::ERR_FAILED;
+  } else if (segment_store.get() && !segment_store->Init()) {
+    LOG(ERROR) << "Simple Cache Backend: could not read the segments: "
+               << path.LossyDisplayName();
+    result.net_error = net::ERR_FAILED;
   } else {
     bool mtime_result =
         disk_cache::simple_util::GetMTime(path, &result.cache_dir_mtime);
     DCHECK(mtime_result);
+    // Packing entries in the segments doesn't touch the cache directory.
+    if (segment_store.get() &&
+        segment_store->last_modified() > result.cache_dir_mtime) {
+      result.cache_dir_mtime = segment_store->last_modified();
+    }
     if (!result.max_size) {
       int64 available = base::SysInfo::AmountOfFreeDiskSpace(path);
       result.max_size = disk_cache::PreferredCacheSize(available);
@@ -44,6 +44,7 @@ namespace disk_cache {
 
 class SimpleEntryImpl;
 class SimpleIndex;
+class SimpleSegmentStore;
 
 class NET_EXPORT_PRIVATE SimpleBackendImpl : public Backend,
     public SimpleIndexDelegate,
@@ -63,6 +64,25 @@ class NET_EXPORT_PRIVATE SimpleBackendImpl : public Backend,
 
   base::TaskRunner* worker_pool() { return worker_pool_.get(); }
 
+  // The store the small entries are packed in, or NULL if they get files of
+  // their own.
+  const scoped_refptr<SimpleSegmentStore>& segment_store() const {
+    return segment_store_;
+  }
+
+  // Packs the small entries in a SimpleSegmentStore. Must be called before
+  // Init().
+  void set_use_segment_store(bool use_segment_store) {
+    use_segment_store_ = use_segment_store;
+  }
+
+  // Keeps the index in a memory mapped table updated in place, rather than in
+  // a pickle rewritten on every flush. Only available on POSIX. Must be called
+  // before Init().
+  void set_use_mapped_index(bool use_mapped_index) {
+    use_mapped_index_ = use_mapped_index;
+  }
+
   int Init(const CompletionCallback& completion_callback);
 
   // Sets the maximum size for the total amount of data stored by this instance.
@@ -137,10 +157,12 @@ class NET_EXPORT_PRIVATE SimpleBackendImpl : public Backend,
                          const CompletionCallback& callback,
                          int result);
 
-  // Try to create the directory if it doesn't exist. This must run on the IO
-  // thread.
-  static DiskStatResult InitCacheStructureOnDisk(const base::FilePath& path,
-                                                 uint64 suggested_max_size);
+  // Try to create the directory if it doesn't exist, and initialize
+  // |segment_store|, if any. This must run on the IO thread.
+  static DiskStatResult InitCacheStructureOnDisk(
+      const base::FilePath& path,
+      uint64 suggested_max_size,
+      const scoped_refptr<SimpleSegmentStore>& segment_store);
 
   // Searches |active_entries_| for the entry corresponding to |key|. If found,
   // returns the found entry. Otherwise, creates a new entry and returns that.
@@ -190,6 +212,9 @@ class NET_EXPORT_PRIVATE SimpleBackendImpl : public Backend,
   scoped_ptr<SimpleIndex> index_;
   const scoped_refptr<base::SingleThreadTaskRunner> cache_thread_;
   scoped_refptr<base::TaskRunner> worker_pool_;
+  bool use_segment_store_;
+  scoped_refptr<SimpleSegmentStore> segment_store_;
+  bool use_mapped_index_;
 
   int orig_max_size_;
   const SimpleEntryImpl::OperationsMode entry_operations_mode_;
@@ -0,0 +1,137 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/disk_cache/simple/simple_entry_file.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "base/files/file_path.h"
+#include "base/files/file_util.h"
+#include "base/logging.h"
+
+namespace disk_cache {
+
+SimpleEntryFile::SimpleEntryFile()
+    : in_memory_(false),
+      image_modified_(false) {
+}
+
+SimpleEntryFile::~SimpleEntryFile() {
+}
+
+void SimpleEntryFile::Initialize(const base::FilePath& name, uint32 flags) {
+  DCHECK(!in_memory_);
+  file_.Initialize(name, flags);
+}
+
+void SimpleEntryFile::InitializeInMemory(const std::string& image,
+                                         base::Time last_modified) {
+  DCHECK(!file_.IsValid());
+  in_memory_ = true;
+  image_ = image;
+  last_modified_ = last_modified;
+  image_modified_ = false;
+}
+
+bool SimpleEntryFile::MoveToFile(const base::FilePath& name) {
+  DCHECK(in_memory_);
+  base::File file(name, base::File::FLAG_CREATE | base::File::FLAG_READ |
+                            base::File::FLAG_WRITE);
+  if (!file.IsValid())
+    return false;
+  const int size = static_cast<int>(image_.size());
+  if (size > 0 && file.Write(0, image_.data(), size) != size) {
+    file.Close();
+    base::DeleteFile(name, false);
+    return false;
+  }
+  file_ = file.Pass();
+  in_memory_ = false;
+  image_.clear();
+  return true;
+}
+
+bool SimpleEntryFile::IsValid() const {
+  return in_memory_ || file_.IsValid();
+}
+
+base::File::Error SimpleEntryFile::error_details() const {
+  return in_memory_ ? base::File::FILE_OK : file_.error_details();
+}
+
+int SimpleEntryFile::Read(int64 offset, char* data, int size) {
+  if (!in_memory_)
+    return file_.Read(offset, data, size);
+  if (offset < 0 || size < 0)
+    return -1;
+  if (offset >= static_cast<int64>(image_.size()))
+    return 0;
+  const int bytes = static_cast<int>(
+      std::min(static_cast<int64>(size),
+               static_cast<int64>(image_.size()) - offset));
+  memcpy(data, image_.data() + offset, bytes);
+  return bytes;
+}
+
+int SimpleEntryFile::Write(int64 offset, const char* data, int size) {
+  if (!in_memory_)
+    return file_.Write(offset, data, size);
+  if (offset < 0 || size < 0)
+    return -1;
+  if (size == 0)
+    return 0;
+  const size_t end = static_cast<size_t>(offset) + size;
+  if (end > image_.size()) {
+    image_.resize(end);
+    image_modified_ = true;
+  } else if (memcmp(&image_[offset], data, size) == 0) {
+    // Closing an entry rewrites stream 0 and the EOF records; an entry only
+    // read needs not be written to the store again.
+    return size;
+  }
+  memcpy(&image_[offset], data, size);
+  image_modified_ = true;
+  return size;
+}
+
+int64 SimpleEntryFile::GetLength() {
+  if (!in_memory_)
+    return file_.GetLength();
+  return image_.size();
+}
+
+bool SimpleEntryFile::SetLength(int64 length) {
+  if (!in_memory_)
+    return file_.SetLength(length);
+  if (length < 0)
+    return false;
+  if (static_cast<size_t>(length) != image_.size()) {
+    image_.resize(length);
+    image_modified_ = true;
+  }
+  return true;
+}
+
+bool SimpleEntryFile::GetInfo(base::File::Info* info) {
+  if (!in_memory_)
+    return file_.GetInfo(info);
+  *info = base::File::Info();
+  info->size = image_.size();
+  info->last_modified = last_modified_;
+  info->last_accessed = last_modified_;
+  return true;
+}
+
+void SimpleEntryFile::Close() {
+  if (!in_memory_) {
+    file_.Close();
+    return;
+  }
+  in_memory_ = false;
+  image_.clear();
+  image_modified_ = false;
+}
+
+}  // namespace disk_cache
@@ -0,0 +1,70 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_DISK_CACHE_SIMPLE_SIMPLE_ENTRY_FILE_H_
+#define NET_DISK_CACHE_SIMPLE_SIMPLE_ENTRY_FILE_H_
+
+#include <string>
+
+#include "base/basictypes.h"
+#include "base/files/file.h"
+#include "base/time/time.h"
+#include "net/base/net_export.h"
+
+namespace base {
+class FilePath;
+}
+
+namespace disk_cache {
+
+// One of the files of a SimpleSynchronousEntry. It is either a base::File, or,
+// for the entries packed in the SimpleSegmentStore, an image of the file held
+// in memory, which is written to the store when the entry is closed. Both
+// share the interface of base::File used by the SimpleSynchronousEntry.
+class NET_EXPORT_PRIVATE SimpleEntryFile {
+ public:
+  SimpleEntryFile();
+  ~SimpleEntryFile();
+
+  // As base::File::Initialize().
+  void Initialize(const base::FilePath& name, uint32 flags);
+
+  // Uses |image| as the contents of the file, in memory. GetInfo() reports
+  // |last_modified| as the time the file was last modified and accessed.
+  void InitializeInMemory(const std::string& image, base::Time last_modified);
+
+  // Writes the image in memory to a new file named |name|, which is used from
+  // then on. Returns false, leaving the image in memory, on failure.
+  bool MoveToFile(const base::FilePath& name);
+
+  bool IsValid() const;
+  base::File::Error error_details() const;
+
+  int Read(int64 offset, char* data, int size);
+  int Write(int64 offset, const char* data, int size);
+  int64 GetLength();
+  bool SetLength(int64 length);
+  bool GetInfo(base::File::Info* info);
+  void Close();
+
+  bool in_memory() const { return in_memory_; }
+  const std::string& image() const { return image_; }
+
+  // True if the image has changed since InitializeInMemory().
+  bool image_modified() const { return image_modified_; }
+
+ private:
+  base::File file_;
+
+  bool in_memory_;
+  std::string image_;
+  base::Time last_modified_;
+  bool image_modified_;
+
+  DISALLOW_COPY_AND_ASSIGN(SimpleEntryFile);
+};
+
+}  // namespace disk_cache
+
+#endif  // NET_DISK_CACHE_SIMPLE_SIMPLE_ENTRY_FILE_H_
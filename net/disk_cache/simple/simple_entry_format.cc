@@ -23,4 +23,17 @@ SimpleFileSparseRangeHeader::SimpleFileSparseRangeHeader() {
   std::memset(this, 0, sizeof(*this));
 }
 
+SimpleSegmentFileHeader::SimpleSegmentFileHeader() {
+  std::memset(this, 0, sizeof(*this));
+}
+
+SimpleSegmentRecordHeader::SimpleSegmentRecordHeader() {
+  // Make hashing repeatable: leave no padding bytes untouched.
+  std::memset(this, 0, sizeof(*this));
+}
+
+SimpleSegmentFooter::SimpleSegmentFooter() {
+  std::memset(this, 0, sizeof(*this));
+}
+
 }  // namespace disk_cache
@@ -19,6 +19,9 @@ namespace disk_cache {
 const uint64 kSimpleInitialMagicNumber = GG_UINT64_C(0xfcfb6d1ba7725c30);
 const uint64 kSimpleFinalMagicNumber = GG_UINT64_C(0xf4fa6f45970d41d8);
 const uint64 kSimpleSparseRangeMagicNumber = GG_UINT64_C(0xeb97bf016553676b);
+const uint64 kSimpleSegmentMagicNumber = GG_UINT64_C(0x9c3e5f0a7d1b2486);
+const uint64 kSimpleSegmentFooterMagicNumber = GG_UINT64_C(0x2b8e61d4c07f935a);
+const uint32 kSimpleSegmentRecordMagicNumber = 0x5eb1c0de;
 
 // A file containing stream 0 and stream 1 in the Simple cache consists of:
 //   - a SimpleFileHeader.
@@ -68,6 +71,47 @@ struct SimpleFileSparseRangeHeader {
   uint32 data_crc32;
 };
 
+// A segment file of the SimpleSegmentStore consists of:
+//   - a SimpleSegmentFileHeader.
+//   - records, each a SimpleSegmentRecordHeader followed by |data_size| bytes
+//     holding the image of the file 0 of an entry, as described above.
+//   - once the segment is full, a copy of the headers of its records, and a
+//     SimpleSegmentFooter.
+// Records are only ever appended; the last record for a hash wins, and a
+// record with FLAG_TOMBSTONE and no data removes the hash.
+struct NET_EXPORT_PRIVATE SimpleSegmentFileHeader {
+  SimpleSegmentFileHeader();
+
+  uint64 magic_number;
+  uint32 version;
+  uint32 segment_id;
+};
+
+struct NET_EXPORT_PRIVATE SimpleSegmentRecordHeader {
+  enum Flags {
+    FLAG_TOMBSTONE = (1U << 0),
+  };
+
+  SimpleSegmentRecordHeader();
+
+  uint32 magic_number;
+  uint32 flags;
+  uint64 entry_hash;
+  int64 last_modified;
+  uint32 data_size;
+  // Covers the header, with this field zeroed, and the data.
+  uint32 record_crc32;
+};
+
+struct NET_EXPORT_PRIVATE SimpleSegmentFooter {
+  SimpleSegmentFooter();
+
+  uint64 magic_number;
+  uint32 record_count;
+  // Covers the copy of the record headers.
+  uint32 headers_crc32;
+};
+
 }  // namespace disk_cache
 
 #endif  // NET_DISK_CACHE_SIMPLE_SIMPLE_ENTRY_FORMAT_H_
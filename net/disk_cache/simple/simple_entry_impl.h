@@ -31,6 +31,7 @@ class IOBuffer;
 namespace disk_cache {
 
 class SimpleBackendImpl;
+class SimpleSegmentStore;
 class SimpleSynchronousEntry;
 class SimpleEntryStat;
 struct SimpleEntryCreationResults;
@@ -312,6 +313,7 @@ class NET_EXPORT_PRIVATE SimpleEntryImpl : public Entry,
   const net::CacheType cache_type_;
   const scoped_refptr<base::TaskRunner> worker_pool_;
   const base::FilePath path_;
+  const scoped_refptr<SimpleSegmentStore> segment_store_;
   const uint64 entry_hash_;
   const bool use_optimistic_operations_;
   std::string key_;
@@ -248,6 +248,7 @@ void SimpleIndex::Insert(uint64 entry_hash) {
   // creating the new entry, and then UpdateEntrySize will be called.
   InsertInEntrySet(
       entry_hash, EntryMetadata(base::Time::Now(), 0), &entries_set_);
+  dirty_entries_.insert(entry_hash);
   if (!initialized_)
     removed_entries_.erase(entry_hash);
   PostponeWritingToDisk();
@@ -260,6 +261,7 @@ void SimpleIndex::Remove(uint64 entry_hash) {
     UpdateEntryIteratorSize(&it, 0);
     entries_set_.erase(it);
   }
+  dirty_entries_.insert(entry_hash);
 
   if (!initialized_)
     removed_entries_.insert(entry_hash);
@@ -281,6 +283,7 @@ bool SimpleIndex::UseIfExists(uint64 entry_hash) {
     // If not initialized, always return true, forcing it to go to the disk.
     return !initialized_;
   it->second.SetLastUsedTime(base::Time::Now());
+  dirty_entries_.insert(entry_hash);
   PostponeWritingToDisk();
   return true;
 }
@@ -341,6 +344,7 @@ bool SimpleIndex::UpdateEntrySize(uint64 entry_hash, int entry_size) {
     return false;
 
   UpdateEntryIteratorSize(&it, entry_size);
+  dirty_entries_.insert(entry_hash);
   PostponeWritingToDisk();
   StartEvictionIfNeeded();
   return true;
@@ -422,6 +426,14 @@ void SimpleIndex::MergeInitializingSet(
   cache_size_ = merged_cache_size;
   initialized_ = true;
 
+  // An index restored from disk is written in full.
+  if (load_result->flush_required) {
+    for (EntrySet::const_iterator it = entries_set_.begin();
+         it != entries_set_.end(); ++it) {
+      dirty_entries_.insert(it->first);
+    }
+  }
+
   // The actual IO is asynchronous, so calling WriteToDisk() shouldn't slow the
   // merge down much.
   if (load_result->flush_required)
@@ -475,8 +487,9 @@ void SimpleIndex::WriteToDisk() {
   }
   last_write_to_disk_ = start;
 
-  index_file_->WriteToDisk(entries_set_, cache_size_,
+  index_file_->WriteToDisk(entries_set_, dirty_entries_, cache_size_,
                            start, app_on_background_);
+  dirty_entries_.clear();
 }
 
 }  // namespace disk_cache
@@ -170,6 +170,10 @@ class NET_EXPORT_PRIVATE SimpleIndex
   // This stores all the entry_hash of entries that are removed during
   // initialization.
   base::hash_set<uint64> removed_entries_;
+
+  // The entry_hash of the entries inserted, removed or updated since the last
+  // write to disk.
+  base::hash_set<uint64> dirty_entries_;
   bool initialized_;
 
   scoped_ptr<SimpleIndexFile> index_file_;
@@ -18,6 +18,8 @@
 #include "net/disk_cache/simple/simple_entry_format.h"
 #include "net/disk_cache/simple/simple_histogram_macros.h"
 #include "net/disk_cache/simple/simple_index.h"
+#include "net/disk_cache/simple/simple_index_table.h"
+#include "net/disk_cache/simple/simple_segment_store.h"
 #include "net/disk_cache/simple/simple_synchronous_entry.h"
 #include "net/disk_cache/simple/simple_util.h"
 #include "third_party/zlib/zlib.h"
@@ -143,6 +145,8 @@ const char SimpleIndexFile::kIndexFileName[] = "the-real-index";
 const char SimpleIndexFile::kIndexDirectory[] = "index-dir";
 // static
 const char SimpleIndexFile::kTempIndexFileName[] = "temp-index";
+// static
+const char SimpleIndexFile::kMappedIndexFileName[] = "the-mapped-index";
 
 SimpleIndexFile::IndexMetadata::IndexMetadata()
     : magic_number_(kSimpleIndexMagicNumber),
@@ -250,20 +254,67 @@ SimpleIndexFile::SimpleIndexFile(
 
 SimpleIndexFile::~SimpleIndexFile() {}
 
+void SimpleIndexFile::set_use_mapped_index(bool use_mapped_index) {
+#if defined(OS_POSIX)
+  mapped_index_ = NULL;
+  if (use_mapped_index) {
+    mapped_index_ = new SimpleIndexTable(
+        cache_directory_.AppendASCII(kIndexDirectory)
+            .AppendASCII(kMappedIndexFileName));
+  }
+#endif
+}
+
 void SimpleIndexFile::LoadIndexEntries(base::Time cache_last_modified,
                                        const base::Closure& callback,
                                        SimpleIndexLoadResult* out_result) {
+#if defined(OS_POSIX)
+  const base::FilePath& index_file_path =
+      mapped_index_.get() ? mapped_index_->file_path() : index_file_;
+  base::Closure task = base::Bind(&SimpleIndexFile::SyncLoadIndexEntries,
+                                  cache_type_,
+                                  cache_last_modified, cache_directory_,
+                                  index_file_path, mapped_index_, out_result);
+#else
   base::Closure task = base::Bind(&SimpleIndexFile::SyncLoadIndexEntries,
                                   cache_type_,
                                   cache_last_modified, cache_directory_,
                                   index_file_, out_result);
+#endif
   worker_pool_->PostTaskAndReply(FROM_HERE, task, callback);
 }
 
 void SimpleIndexFile::WriteToDisk(const SimpleIndex::EntrySet& entry_set,
+                                  const base::hash_set<uint64>& dirty_entries,
                                   uint64 cache_size,
                                   const base::TimeTicks& start,
                                   bool app_on_background) {
+#if defined(OS_POSIX)
+  if (mapped_index_.get()) {
+    scoped_ptr<std::vector<std::pair<uint64, EntryMetadata> > >
+        updated_entries(new std::vector<std::pair<uint64, EntryMetadata> >);
+    scoped_ptr<std::vector<uint64> > removed_entries(new std::vector<uint64>);
+    for (base::hash_set<uint64>::const_iterator it = dirty_entries.begin();
+         it != dirty_entries.end(); ++it) {
+      SimpleIndex::EntrySet::const_iterator found = entry_set.find(*it);
+      if (found != entry_set.end())
+        updated_entries->push_back(*found);
+      else
+        removed_entries->push_back(*it);
+    }
+    cache_thread_->PostTask(FROM_HERE,
+                            base::Bind(&SimpleIndexFile::SyncWriteToMappedIndex,
+                                       cache_type_,
+                                       cache_directory_,
+                                       mapped_index_,
+                                       base::Passed(&updated_entries),
+                                       base::Passed(&removed_entries),
+                                       base::TimeTicks::Now(),
+                                       app_on_background));
+    return;
+  }
+#endif
+
   IndexMetadata index_metadata(entry_set.size(), cache_size);
   scoped_ptr<Pickle> pickle = Serialize(index_metadata, entry_set);
   cache_thread_->PostTask(FROM_HERE,
@@ -283,10 +334,22 @@ void SimpleIndexFile::SyncLoadIndexEntries(
     base::Time cache_last_modified,
     const base::FilePath& cache_directory,
     const base::FilePath& index_file_path,
+#if defined(OS_POSIX)
+    const scoped_refptr<SimpleIndexTable>& mapped_index,
+#endif
     SimpleIndexLoadResult* out_result) {
   // Load the index and find its age.
   base::Time last_cache_seen_by_index;
+#if defined(OS_POSIX)
+  if (mapped_index.get()) {
+    SyncLoadFromMappedIndex(
+        mapped_index.get(), &last_cache_seen_by_index, out_result);
+  } else {
+    SyncLoadFromDisk(index_file_path, &last_cache_seen_by_index, out_result);
+  }
+#else
   SyncLoadFromDisk(index_file_path, &last_cache_seen_by_index, out_result);
+#endif
 
   // Consider the index loaded if it is fresh.
   const bool index_file_existed = base::PathExists(index_file_path);
@@ -311,6 +374,10 @@ void SimpleIndexFile::SyncLoadIndexEntries(
 
   // Reconstruct the index by scanning the disk for entries.
   const base::TimeTicks start = base::TimeTicks::Now();
+#if defined(OS_POSIX)
+  if (mapped_index.get())
+    mapped_index->Discard();
+#endif
   SyncRestoreFromDisk(cache_directory, index_file_path, out_result);
   SIMPLE_CACHE_UMA(MEDIUM_TIMES, "IndexRestoreTime", cache_type,
                    base::TimeTicks::Now() - start);
@@ -349,6 +416,59 @@ void SimpleIndexFile::SyncLoadFromDisk(const base::FilePath& index_filename,
     base::DeleteFile(index_filename, false);
 }
 
+#if defined(OS_POSIX)
+// static
+void SimpleIndexFile::SyncLoadFromMappedIndex(
+    SimpleIndexTable* mapped_index,
+    base::Time* out_last_cache_seen_by_index,
+    SimpleIndexLoadResult* out_result) {
+  out_result->Reset();
+  if (!mapped_index->Open()) {
+    LOG(WARNING) << "Could not map the Simple Index table.";
+    return;
+  }
+  out_result->entries.resize(mapped_index->entry_count() + kExtraSizeForMerge);
+  mapped_index->GetEntries(&out_result->entries);
+  *out_last_cache_seen_by_index = mapped_index->cache_last_modified();
+  out_result->did_load = true;
+}
+
+// static
+void SimpleIndexFile::SyncWriteToMappedIndex(
+    net::CacheType cache_type,
+    const base::FilePath& cache_directory,
+    const scoped_refptr<SimpleIndexTable>& mapped_index,
+    scoped_ptr<std::vector<std::pair<uint64, EntryMetadata> > >
+        updated_entries,
+    scoped_ptr<std::vector<uint64> > removed_entries,
+    const base::TimeTicks& start_time,
+    bool app_on_background) {
+  // As in SyncWriteToDisk(), the index is stamped with the modification time
+  // of the cache directory as of now. The changes must be applied even when
+  // it can't be read, since they won't be sent again; a null stamp has the
+  // index restored on the next load.
+  base::Time cache_dir_mtime;
+  if (!simple_util::GetMTime(cache_directory, &cache_dir_mtime)) {
+    LOG(ERROR) << "Could not obtain information about cache age";
+    cache_dir_mtime = base::Time();
+  }
+  if (!mapped_index->Apply(*updated_entries, *removed_entries,
+                           cache_dir_mtime)) {
+    return;
+  }
+
+  if (app_on_background) {
+    SIMPLE_CACHE_UMA(TIMES,
+                     "IndexWriteToDiskTime.Background", cache_type,
+                     (base::TimeTicks::Now() - start_time));
+  } else {
+    SIMPLE_CACHE_UMA(TIMES,
+                     "IndexWriteToDiskTime.Foreground", cache_type,
+                     (base::TimeTicks::Now() - start_time));
+  }
+}
+#endif  // defined(OS_POSIX)
+
 // static
 scoped_ptr<Pickle> SimpleIndexFile::Serialize(
     const SimpleIndexFile::IndexMetadata& index_metadata,
@@ -444,6 +564,7 @@ void SimpleIndexFile::SyncRestoreFromDisk(
     LOG(ERROR) << "Could not reconstruct index from disk";
     return;
   }
+  SimpleSegmentStore::RestoreEntries(cache_directory, entries);
   out_result->did_load = true;
   // When we restore from disk we write the merged index file to disk right
   // away, this might save us from having to restore again next time.
@@ -6,6 +6,7 @@
 #define NET_DISK_CACHE_SIMPLE_SIMPLE_INDEX_FILE_H_
 
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "base/basictypes.h"
@@ -13,6 +14,7 @@
 #include "base/files/file_path.h"
 #include "base/gtest_prod_util.h"
 #include "base/logging.h"
+#include "base/memory/ref_counted.h"
 #include "base/memory/scoped_ptr.h"
 #include "base/pickle.h"
 #include "base/port.h"
@@ -27,6 +29,8 @@ class TaskRunner;
 
 namespace disk_cache {
 
+class SimpleIndexTable;
+
 const uint64 kSimpleIndexMagicNumber = GG_UINT64_C(0x656e74657220796f);
 
 struct NET_EXPORT_PRIVATE SimpleIndexLoadResult {
@@ -46,6 +50,9 @@ struct NET_EXPORT_PRIVATE SimpleIndexLoadResult {
 // see SimpleIndexFile::Serialize() and SeeSimpleIndexFile::LoadFromDisk()
 // methods.
 //
+// With set_use_mapped_index(), the index is kept in a SimpleIndexTable
+// instead, and only the entries changed since the last write are written.
+//
 // The non-static methods must run on the IO thread. All the real
 // work is done in the static methods, which are run on the cache thread
 // or in worker threads. Synchronization between methods is the
@@ -81,13 +88,19 @@ class NET_EXPORT_PRIVATE SimpleIndexFile {
       const base::FilePath& cache_directory);
   virtual ~SimpleIndexFile();
 
+  // Keeps the index in a SimpleIndexTable, on POSIX. Must be called before
+  // LoadIndexEntries().
+  void set_use_mapped_index(bool use_mapped_index);
+
   // Get index entries based on current disk context.
   virtual void LoadIndexEntries(base::Time cache_last_modified,
                                 const base::Closure& callback,
                                 SimpleIndexLoadResult* out_result);
 
-  // Write the specified set of entries to disk.
+  // Write the specified set of entries to disk. |dirty_entries| holds the
+  // hashes of the entries inserted, removed or updated since the last write.
   virtual void WriteToDisk(const SimpleIndex::EntrySet& entry_set,
+                           const base::hash_set<uint64>& dirty_entries,
                            uint64 cache_size,
                            const base::TimeTicks& start,
                            bool app_on_background);
@@ -102,12 +115,25 @@ class NET_EXPORT_PRIVATE SimpleIndexFile {
   // prevent reallocation on the IO thread when merging in new live entries.
   static const int kExtraSizeForMerge = 512;
 
-  // Synchronous (IO performing) implementation of LoadIndexEntries.
-  static void SyncLoadIndexEntries(net::CacheType cache_type,
-                                   base::Time cache_last_modified,
-                                   const base::FilePath& cache_directory,
-                                   const base::FilePath& index_file_path,
-                                   SimpleIndexLoadResult* out_result);
+  // Synchronous (IO performing) implementation of LoadIndexEntries. On
+  // POSIX, loads |mapped_index| instead of the file at |index_file_path| if
+  // it isn't NULL.
+  static void SyncLoadIndexEntries(
+      net::CacheType cache_type,
+      base::Time cache_last_modified,
+      const base::FilePath& cache_directory,
+      const base::FilePath& index_file_path,
+#if defined(OS_POSIX)
+      const scoped_refptr<SimpleIndexTable>& mapped_index,
+#endif
+      SimpleIndexLoadResult* out_result);
+
+#if defined(OS_POSIX)
+  // Load the entries of |mapped_index|.
+  static void SyncLoadFromMappedIndex(SimpleIndexTable* mapped_index,
+                                      base::Time* out_last_cache_seen_by_index,
+                                      SimpleIndexLoadResult* out_result);
+#endif
 
   // Load the index file from disk returning an EntrySet.
   static void SyncLoadFromDisk(const base::FilePath& index_filename,
@@ -152,6 +178,17 @@ class NET_EXPORT_PRIVATE SimpleIndexFile {
                               const base::TimeTicks& start_time,
                               bool app_on_background);
 
+  // Writes |updated_entries| and |removed_entries| to |mapped_index|.
+  static void SyncWriteToMappedIndex(
+      net::CacheType cache_type,
+      const base::FilePath& cache_directory,
+      const scoped_refptr<SimpleIndexTable>& mapped_index,
+      scoped_ptr<std::vector<std::pair<uint64, EntryMetadata> > >
+          updated_entries,
+      scoped_ptr<std::vector<uint64> > removed_entries,
+      const base::TimeTicks& start_time,
+      bool app_on_background);
+
   // Scan the index directory for entries, returning an EntrySet of all entries
   // found.
   static void SyncRestoreFromDisk(const base::FilePath& cache_directory,
@@ -176,9 +213,15 @@ class NET_EXPORT_PRIVATE SimpleIndexFile {
   const base::FilePath index_file_;
   const base::FilePath temp_index_file_;
 
+#if defined(OS_POSIX)
+  // The index, when it is mapped rather than pickled.
+  scoped_refptr<SimpleIndexTable> mapped_index_;
+#endif
+
   static const char kIndexDirectory[];
   static const char kIndexFileName[];
   static const char kTempIndexFileName[];
+  static const char kMappedIndexFileName[];
 
   DISALLOW_COPY_AND_ASSIGN(SimpleIndexFile);
 };
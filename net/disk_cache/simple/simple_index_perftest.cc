@@ -0,0 +1,120 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/disk_cache/simple/simple_index_file.h"
+
+#include <string>
+
+#include "base/bind.h"
+#include "base/bind_helpers.h"
+#include "base/files/file_enumerator.h"
+#include "base/files/scoped_temp_dir.h"
+#include "base/message_loop/message_loop.h"
+#include "base/run_loop.h"
+#include "base/test/perf_time_logger.h"
+#include "base/test/test_file_util.h"
+#include "base/thread_task_runner_handle.h"
+#include "base/time/time.h"
+#include "net/base/cache_type.h"
+#include "net/disk_cache/simple/simple_index.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace disk_cache {
+
+namespace {
+
+const int kEntryCount = 100000;
+
+// Each flush follows this many entry updates, as when a page load opens a
+// hundred entries between two flushes.
+const int kEntriesPerFlush = 100;
+const int kFlushCount = 50;
+
+// Evicts the index files of the cache at |cache_path| from the system cache.
+void EvictIndexFiles(const base::FilePath& cache_path) {
+  base::FileEnumerator enumerator(cache_path, true,
+                                  base::FileEnumerator::FILES);
+  for (base::FilePath path = enumerator.Next(); !path.empty();
+       path = enumerator.Next()) {
+    EXPECT_TRUE(base::EvictFileFromSystemCache(path));
+  }
+}
+
+scoped_ptr<SimpleIndexFile> CreateIndexFile(const base::FilePath& cache_path,
+                                            bool use_mapped_index) {
+  scoped_ptr<SimpleIndexFile> index_file(new SimpleIndexFile(
+      base::ThreadTaskRunnerHandle::Get(), base::ThreadTaskRunnerHandle::Get(),
+      net::DISK_CACHE, cache_path));
+  index_file->set_use_mapped_index(use_mapped_index);
+  return index_file.Pass();
+}
+
+// Writes an index of kEntryCount entries, times kFlushCount flushes of
+// kEntriesPerFlush updated entries each, then times loading the index cold.
+void IndexPerformance(bool use_mapped_index, const std::string& name) {
+  base::MessageLoopForIO message_loop;
+  base::ScopedTempDir cache_dir;
+  ASSERT_TRUE(cache_dir.CreateUniqueTempDir());
+
+  SimpleIndex::EntrySet entries;
+  base::hash_set<uint64> dirty_entries;
+  const base::Time now = base::Time::Now();
+  for (int i = 0; i < kEntryCount; ++i) {
+    const uint64 entry_hash = GG_UINT64_C(0x9e3779b97f4a7c15) * (i + 1);
+    entries[entry_hash] = EntryMetadata(now, 10000 + i);
+    dirty_entries.insert(entry_hash);
+  }
+
+  {
+    scoped_ptr<SimpleIndexFile> index_file =
+        CreateIndexFile(cache_dir.path(), use_mapped_index);
+    SimpleIndexLoadResult load_result;
+    index_file->LoadIndexEntries(base::Time(), base::Bind(&base::DoNothing),
+                                 &load_result);
+    base::RunLoop().RunUntilIdle();
+    index_file->WriteToDisk(entries, dirty_entries, 0,
+                            base::TimeTicks::Now(), false);
+    base::RunLoop().RunUntilIdle();
+
+    SimpleIndex::EntrySet::iterator it = entries.begin();
+    base::PerfTimeLogger timer(("Simple_index_flush_" + name).c_str());
+    for (int i = 0; i < kFlushCount; ++i) {
+      dirty_entries.clear();
+      for (int j = 0; j < kEntriesPerFlush; ++j, ++it) {
+        it->second.SetEntrySize(it->second.GetEntrySize() + 1);
+        dirty_entries.insert(it->first);
+      }
+      index_file->WriteToDisk(entries, dirty_entries, 0,
+                              base::TimeTicks::Now(), false);
+      base::RunLoop().RunUntilIdle();
+    }
+    timer.Done();
+  }
+
+  EvictIndexFiles(cache_dir.path());
+  scoped_ptr<SimpleIndexFile> index_file =
+      CreateIndexFile(cache_dir.path(), use_mapped_index);
+  SimpleIndexLoadResult load_result;
+  base::PerfTimeLogger timer(("Simple_index_cold_load_" + name).c_str());
+  index_file->LoadIndexEntries(base::Time(), base::Bind(&base::DoNothing),
+                               &load_result);
+  base::RunLoop().RunUntilIdle();
+  timer.Done();
+  EXPECT_TRUE(load_result.did_load);
+  EXPECT_EQ(entries.size(), load_result.entries.size());
+}
+
+}  // namespace
+
+TEST(SimpleIndexPerfTest, Pickle) {
+  IndexPerformance(false, "pickle");
+}
+
+#if defined(OS_POSIX)
+TEST(SimpleIndexPerfTest, Mapped) {
+  IndexPerformance(true, "mapped");
+}
+#endif
+
+}  // namespace disk_cache
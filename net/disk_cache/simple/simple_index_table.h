@@ -0,0 +1,137 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_DISK_CACHE_SIMPLE_SIMPLE_INDEX_TABLE_H_
+#define NET_DISK_CACHE_SIMPLE_SIMPLE_INDEX_TABLE_H_
+
+#include <utility>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "base/files/file.h"
+#include "base/files/file_path.h"
+#include "base/memory/ref_counted.h"
+#include "base/time/time.h"
+#include "build/build_config.h"
+#include "net/base/net_export.h"
+#include "net/disk_cache/simple/simple_index.h"
+
+#if defined(OS_POSIX)
+
+namespace disk_cache {
+
+// The SimpleIndexTable is an index file that is memory mapped and updated in
+// place, as opposed to the pickle that SimpleIndexFile rewrites in full on
+// every flush. Only available on POSIX.
+//
+// The file holds a header page, a journal, and an open addressing hash table
+// of entry metadata, probed linearly from the low bits of the entry hash:
+//
+//   +--------+-----------------------------+------------------------------+
+//   | Header | kJournalCapacity x Bucket   | bucket_count x Bucket        |
+//   +--------+-----------------------------+------------------------------+
+//
+// Apply() first writes the changes to the journal and syncs it, which commits
+// them, then writes them to the buckets in place and syncs those, which only
+// writes the pages they dirtied, and finally empties the journal. Open()
+// replays a journal that a crash left committed. When the changes don't fit
+// in the journal, or the table gets too full, the file is rebuilt next to the
+// old one and renamed over it.
+//
+// The methods below block on IO. The table is used by one thread at a time.
+class NET_EXPORT_PRIVATE SimpleIndexTable
+    : public base::RefCountedThreadSafe<SimpleIndexTable> {
+ public:
+  typedef std::vector<std::pair<uint64, EntryMetadata> > EntryList;
+
+  // Up to this many changes are applied to the table in place.
+  static const uint32 kJournalCapacity = 2048;
+
+  explicit SimpleIndexTable(const base::FilePath& file_path);
+
+  const base::FilePath& file_path() const { return file_path_; }
+
+  // Maps the file, and replays its journal. Returns false, after deleting the
+  // file, if it is missing or corrupt.
+  bool Open();
+
+  // Deletes the file. The next Apply() builds the table from scratch.
+  void Discard();
+
+  // Adds the entries of the table to |entries|. The table must be open.
+  void GetEntries(SimpleIndex::EntrySet* entries) const;
+
+  // The number of entries in the table. The table must be open.
+  size_t entry_count() const { return entry_count_; }
+
+  // The |cache_modified| time given to the last Apply().
+  base::Time cache_last_modified() const;
+
+  // Sets |updated_entries| and removes |removed_entries| from the table, and
+  // records |cache_modified|. If the table isn't open, it is built from
+  // |updated_entries| alone. Returns false on failure, which deletes the file;
+  // the following calls then fail, as the changes since the last one are
+  // lost.
+  bool Apply(const EntryList& updated_entries,
+             const std::vector<uint64>& removed_entries,
+             base::Time cache_modified);
+
+  uint32 GetBucketCountForTesting() const;
+
+ private:
+  friend class base::RefCountedThreadSafe<SimpleIndexTable>;
+
+  struct Header;
+  struct Bucket;
+
+  enum State {
+    STATE_CLOSED,
+    STATE_OPEN,
+    STATE_FAILED,
+  };
+
+  ~SimpleIndexTable();
+
+  Header* header() const;
+  Bucket* journal() const;
+  Bucket* buckets() const;
+
+  // Maps the file, which must be |length| bytes long.
+  bool Map(size_t length);
+  void Unmap();
+
+  // Sets or clears the bucket for the hash of |record| in the mapping, and
+  // updates |entry_count_|. Returns false if the buckets are corrupt: they are
+  // all taken, by other entries.
+  bool ApplyRecord(const Bucket& record);
+
+  // Empties a torn journal, or writes a committed one to the buckets.
+  bool ReplayJournal();
+
+  // Writes the table and the changes to a new file, renames it over the file
+  // of the table and maps it.
+  bool Rebuild(const EntryList& updated_entries,
+               const std::vector<uint64>& removed_entries,
+               base::Time cache_modified);
+
+  // Syncs the mapping from |offset| for |length| bytes.
+  bool Sync(size_t offset, size_t length);
+
+  void Fail();
+
+  const base::FilePath file_path_;
+  State state_;
+  base::File file_;
+  char* mapping_;
+  size_t mapping_length_;
+  size_t entry_count_;
+
+  DISALLOW_COPY_AND_ASSIGN(SimpleIndexTable);
+};
+
+}  // namespace disk_cache
+
+#endif  // defined(OS_POSIX)
+
+#endif  // NET_DISK_CACHE_SIMPLE_SIMPLE_INDEX_TABLE_H_
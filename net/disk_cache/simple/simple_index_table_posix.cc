@@ -0,0 +1,414 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/disk_cache/simple/simple_index_table.h"
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include "base/files/file_util.h"
+#include "base/logging.h"
+#include "base/memory/scoped_ptr.h"
+#include "net/disk_cache/simple/simple_backend_version.h"
+#include "third_party/zlib/zlib.h"
+
+namespace disk_cache {
+
+namespace {
+
+const uint64 kSimpleIndexTableMagicNumber = GG_UINT64_C(0x6d61707065646978);
+
+// The header has a page of its own, so that syncing it doesn't write any
+// bucket.
+const size_t kHeaderSize = 4096;
+
+// The table is rebuilt twice as large as its entries need, and when it gets
+// three quarters full.
+const uint32 kMinBucketCount = 1024;
+
+// The entry size of an empty bucket, or of a journal record removing its
+// entry.
+const int kEmptyEntrySize = -1;
+
+}  // namespace
+
+struct SimpleIndexTable::Header {
+  uint64 magic_number;
+  uint32 version;
+  uint32 bucket_count;
+  int64 cache_last_modified;
+
+  // The number of committed records in the journal, their CRC, and the
+  // |cache_last_modified| they bring.
+  uint32 journal_size;
+  uint32 journal_crc;
+  int64 journal_cache_last_modified;
+};
+
+// A bucket of the table, or a record of the journal.
+struct SimpleIndexTable::Bucket {
+  uint64 entry_hash;
+  EntryMetadata metadata;
+};
+
+namespace {
+
+const size_t kBucketSize = 16;
+
+const size_t kBucketsOffset =
+    kHeaderSize + SimpleIndexTable::kJournalCapacity * kBucketSize;
+
+size_t GetFileLength(uint32 bucket_count) {
+  return kBucketsOffset + static_cast<size_t>(bucket_count) * kBucketSize;
+}
+
+uint32 GetBucketCountFor(size_t entry_count) {
+  uint32 bucket_count = kMinBucketCount;
+  while (bucket_count < 2 * entry_count)
+    bucket_count *= 2;
+  return bucket_count;
+}
+
+uint32 CalculateJournalCRC(const char* journal, size_t length) {
+  return crc32(crc32(0, Z_NULL, 0),
+               reinterpret_cast<const Bytef*>(journal),
+               length);
+}
+
+}  // namespace
+
+SimpleIndexTable::SimpleIndexTable(const base::FilePath& file_path)
+    : file_path_(file_path),
+      state_(STATE_CLOSED),
+      mapping_(NULL),
+      mapping_length_(0),
+      entry_count_(0) {
+  COMPILE_ASSERT(sizeof(Bucket) == kBucketSize, bucket_size);
+}
+
+SimpleIndexTable::~SimpleIndexTable() {
+  Unmap();
+}
+
+bool SimpleIndexTable::Open() {
+  DCHECK_NE(STATE_OPEN, state_);
+  file_.Initialize(file_path_, base::File::FLAG_OPEN |
+                                   base::File::FLAG_READ |
+                                   base::File::FLAG_WRITE);
+  const int64 length = file_.IsValid() ? file_.GetLength() : 0;
+  if (length < implicit_cast<int64>(kBucketsOffset) ||
+      !Map(static_cast<size_t>(length))) {
+    Discard();
+    return false;
+  }
+
+  const Header* const file_header = header();
+  if (file_header->magic_number != kSimpleIndexTableMagicNumber ||
+      file_header->version != kSimpleVersion ||
+      file_header->bucket_count < kMinBucketCount ||
+      (file_header->bucket_count & (file_header->bucket_count - 1)) != 0 ||
+      GetFileLength(file_header->bucket_count) != mapping_length_) {
+    LOG(WARNING) << "Invalid header in the mapped Simple Cache Index.";
+    Discard();
+    return false;
+  }
+
+  // Apply() never lets the table get more than three quarters full, and
+  // probing relies on empty buckets being left.
+  const Bucket* const table = buckets();
+  entry_count_ = 0;
+  for (uint32 i = 0; i < file_header->bucket_count; ++i) {
+    if (table[i].metadata.GetEntrySize() != kEmptyEntrySize)
+      ++entry_count_;
+  }
+  if (4 * entry_count_ > 3 * static_cast<size_t>(file_header->bucket_count)) {
+    LOG(WARNING) << "Overfull buckets in the mapped Simple Cache Index.";
+    Discard();
+    return false;
+  }
+
+  state_ = STATE_OPEN;
+  if (!ReplayJournal()) {
+    Discard();
+    return false;
+  }
+  return true;
+}
+
+void SimpleIndexTable::Discard() {
+  Unmap();
+  file_.Close();
+  base::DeleteFile(file_path_, false);
+  state_ = STATE_CLOSED;
+  entry_count_ = 0;
+}
+
+void SimpleIndexTable::GetEntries(SimpleIndex::EntrySet* entries) const {
+  DCHECK_EQ(STATE_OPEN, state_);
+  const Bucket* const table = buckets();
+  for (uint32 i = 0; i < header()->bucket_count; ++i) {
+    if (table[i].metadata.GetEntrySize() != kEmptyEntrySize) {
+      SimpleIndex::InsertInEntrySet(
+          table[i].entry_hash, table[i].metadata, entries);
+    }
+  }
+}
+
+base::Time SimpleIndexTable::cache_last_modified() const {
+  if (!mapping_)
+    return base::Time();
+  return base::Time::FromInternalValue(header()->cache_last_modified);
+}
+
+bool SimpleIndexTable::Apply(const EntryList& updated_entries,
+                             const std::vector<uint64>& removed_entries,
+                             base::Time cache_modified) {
+  if (state_ == STATE_FAILED)
+    return false;
+  const size_t change_count = updated_entries.size() + removed_entries.size();
+  if (state_ == STATE_CLOSED || change_count > kJournalCapacity ||
+      4 * (entry_count_ + updated_entries.size()) >
+          3 * static_cast<size_t>(header()->bucket_count)) {
+    if (Rebuild(updated_entries, removed_entries, cache_modified))
+      return true;
+    Fail();
+    return false;
+  }
+
+  // Commit the changes to the journal.
+  Header* const file_header = header();
+  Bucket* const records = journal();
+  size_t i = 0;
+  for (EntryList::const_iterator it = updated_entries.begin();
+       it != updated_entries.end(); ++it, ++i) {
+    records[i].entry_hash = it->first;
+    records[i].metadata = it->second;
+  }
+  for (std::vector<uint64>::const_iterator it = removed_entries.begin();
+       it != removed_entries.end(); ++it, ++i) {
+    records[i].entry_hash = *it;
+    records[i].metadata = EntryMetadata();
+    records[i].metadata.SetEntrySize(kEmptyEntrySize);
+  }
+  file_header->journal_size = change_count;
+  file_header->journal_crc = CalculateJournalCRC(
+      reinterpret_cast<const char*>(records), change_count * sizeof(Bucket));
+  file_header->journal_cache_last_modified = cache_modified.ToInternalValue();
+  if (!Sync(0, kHeaderSize + change_count * sizeof(Bucket)) ||
+      !ReplayJournal()) {
+    Fail();
+    return false;
+  }
+  return true;
+}
+
+uint32 SimpleIndexTable::GetBucketCountForTesting() const {
+  return mapping_ ? header()->bucket_count : 0;
+}
+
+SimpleIndexTable::Header* SimpleIndexTable::header() const {
+  DCHECK(mapping_);
+  return reinterpret_cast<Header*>(mapping_);
+}
+
+SimpleIndexTable::Bucket* SimpleIndexTable::journal() const {
+  DCHECK(mapping_);
+  return reinterpret_cast<Bucket*>(mapping_ + kHeaderSize);
+}
+
+SimpleIndexTable::Bucket* SimpleIndexTable::buckets() const {
+  DCHECK(mapping_);
+  return reinterpret_cast<Bucket*>(mapping_ + kBucketsOffset);
+}
+
+bool SimpleIndexTable::Map(size_t length) {
+  DCHECK(!mapping_);
+  void* const address = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED,
+                             file_.GetPlatformFile(), 0);
+  if (address == MAP_FAILED) {
+    DPLOG(ERROR) << "mmap " << file_path_.value();
+    return false;
+  }
+  mapping_ = static_cast<char*>(address);
+  mapping_length_ = length;
+  return true;
+}
+
+void SimpleIndexTable::Unmap() {
+  if (!mapping_)
+    return;
+  const int result = munmap(mapping_, mapping_length_);
+  DCHECK_EQ(0, result);
+  mapping_ = NULL;
+  mapping_length_ = 0;
+}
+
+bool SimpleIndexTable::ApplyRecord(const Bucket& record) {
+  Bucket* const table = buckets();
+  const uint32 mask = header()->bucket_count - 1;
+  uint32 i = record.entry_hash & mask;
+  uint32 probes = 0;
+  while (table[i].metadata.GetEntrySize() != kEmptyEntrySize &&
+         table[i].entry_hash != record.entry_hash) {
+    if (++probes == header()->bucket_count)
+      return false;
+    i = (i + 1) & mask;
+  }
+  const bool found = table[i].metadata.GetEntrySize() != kEmptyEntrySize;
+
+  if (record.metadata.GetEntrySize() != kEmptyEntrySize) {
+    table[i] = record;
+    if (!found)
+      ++entry_count_;
+    return true;
+  }
+  if (!found)
+    return true;
+  --entry_count_;
+
+  // Shift back the buckets of the probe sequence after |i|, so that lookups
+  // don't stop at the bucket emptied. A bucket at |j| that hashes to |k| can
+  // move to |i| unless |k| is cyclically in (i, j]. Stops after a round of
+  // the table, in case no bucket is empty.
+  uint32 j = i;
+  for (uint32 n = 1; n < header()->bucket_count; ++n) {
+    j = (j + 1) & mask;
+    if (table[j].metadata.GetEntrySize() == kEmptyEntrySize)
+      break;
+    const uint32 k = table[j].entry_hash & mask;
+    if (i <= j ? (i < k && k <= j) : (i < k || k <= j))
+      continue;
+    table[i] = table[j];
+    i = j;
+  }
+  table[i].entry_hash = 0;
+  table[i].metadata = EntryMetadata();
+  table[i].metadata.SetEntrySize(kEmptyEntrySize);
+  return true;
+}
+
+bool SimpleIndexTable::ReplayJournal() {
+  Header* const file_header = header();
+  if (file_header->journal_size == 0)
+    return true;
+
+  const Bucket* const records = journal();
+  const size_t journal_length = file_header->journal_size * sizeof(Bucket);
+  if (file_header->journal_size > kJournalCapacity ||
+      CalculateJournalCRC(reinterpret_cast<const char*>(records),
+                          journal_length) != file_header->journal_crc) {
+    // The journal wasn't committed, so the buckets weren't touched.
+    LOG(WARNING) << "Dropping a torn journal in the mapped Simple Cache Index.";
+    file_header->journal_size = 0;
+    return Sync(0, kHeaderSize);
+  }
+
+  // The records may already be in the buckets, if the last Apply() didn't
+  // complete. Applying them again is harmless.
+  for (uint32 i = 0; i < file_header->journal_size; ++i) {
+    if (!ApplyRecord(records[i])) {
+      LOG(WARNING) << "Full buckets in the mapped Simple Cache Index.";
+      return false;
+    }
+  }
+  if (!Sync(kBucketsOffset, mapping_length_ - kBucketsOffset))
+    return false;
+
+  file_header->cache_last_modified = file_header->journal_cache_last_modified;
+  file_header->journal_size = 0;
+  return Sync(0, kHeaderSize);
+}
+
+bool SimpleIndexTable::Rebuild(const EntryList& updated_entries,
+                               const std::vector<uint64>& removed_entries,
+                               base::Time cache_modified) {
+  SimpleIndex::EntrySet entries;
+  if (state_ == STATE_OPEN)
+    GetEntries(&entries);
+  for (EntryList::const_iterator it = updated_entries.begin();
+       it != updated_entries.end(); ++it) {
+    entries[it->first] = it->second;
+  }
+  for (std::vector<uint64>::const_iterator it = removed_entries.begin();
+       it != removed_entries.end(); ++it) {
+    entries.erase(*it);
+  }
+
+  const uint32 bucket_count = GetBucketCountFor(entries.size());
+  const size_t length = GetFileLength(bucket_count);
+  scoped_ptr<char[]> data(new char[length]);
+  std::fill(data.get(), data.get() + kBucketsOffset, 0);
+  Header* const new_header = reinterpret_cast<Header*>(data.get());
+  new_header->magic_number = kSimpleIndexTableMagicNumber;
+  new_header->version = kSimpleVersion;
+  new_header->bucket_count = bucket_count;
+  new_header->cache_last_modified = cache_modified.ToInternalValue();
+
+  Bucket* const table = reinterpret_cast<Bucket*>(data.get() + kBucketsOffset);
+  const uint32 mask = bucket_count - 1;
+  for (uint32 i = 0; i < bucket_count; ++i) {
+    table[i].entry_hash = 0;
+    table[i].metadata = EntryMetadata();
+    table[i].metadata.SetEntrySize(kEmptyEntrySize);
+  }
+  for (SimpleIndex::EntrySet::const_iterator it = entries.begin();
+       it != entries.end(); ++it) {
+    uint32 i = it->first & mask;
+    while (table[i].metadata.GetEntrySize() != kEmptyEntrySize)
+      i = (i + 1) & mask;
+    table[i].entry_hash = it->first;
+    table[i].metadata = it->second;
+  }
+
+  Unmap();
+  file_.Close();
+  state_ = STATE_CLOSED;
+
+  const base::FilePath temp_path =
+      file_path_.AddExtension(FILE_PATH_LITERAL("tmp"));
+  if (base::WriteFile(temp_path, data.get(), length) !=
+      implicit_cast<int>(length)) {
+    if (!base::CreateDirectory(temp_path.DirName()) ||
+        base::WriteFile(temp_path, data.get(), length) !=
+            implicit_cast<int>(length)) {
+      LOG(ERROR) << "Failed to write the mapped Simple Cache Index.";
+      base::DeleteFile(temp_path, false);
+      return false;
+    }
+  }
+  data.reset();
+  if (!base::ReplaceFile(temp_path, file_path_, NULL))
+    return false;
+
+  file_.Initialize(file_path_, base::File::FLAG_OPEN |
+                                   base::File::FLAG_READ |
+                                   base::File::FLAG_WRITE);
+  if (!file_.IsValid() || !Map(length))
+    return false;
+  entry_count_ = entries.size();
+  state_ = STATE_OPEN;
+  return true;
+}
+
+bool SimpleIndexTable::Sync(size_t offset, size_t length) {
+  // msync() takes a page aligned address.
+  const size_t page_size = sysconf(_SC_PAGESIZE);
+  const size_t aligned_offset = offset - offset % page_size;
+  if (msync(mapping_ + aligned_offset, length + offset - aligned_offset,
+            MS_SYNC) != 0) {
+    DPLOG(ERROR) << "msync " << file_path_.value();
+    return false;
+  }
+  return true;
+}
+
+void SimpleIndexTable::Fail() {
+  LOG(ERROR) << "Failed to update the mapped Simple Cache Index.";
+  Discard();
+  state_ = STATE_FAILED;
+}
+
+}  // namespace disk_cache
@@ -0,0 +1,342 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/disk_cache/simple/simple_index_table.h"
+
+#include <vector>
+
+#include "base/files/file.h"
+#include "base/files/file_util.h"
+#include "base/files/scoped_temp_dir.h"
+#include "base/memory/ref_counted.h"
+#include "base/time/time.h"
+#include "net/disk_cache/simple/simple_index.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "third_party/zlib/zlib.h"
+
+namespace disk_cache {
+
+#if defined(OS_POSIX)
+
+namespace {
+
+// The layout of the file, as documented in simple_index_table_posix.cc.
+const int64 kJournalSizeOffset = 24;
+const int64 kJournalOffset = 4096;
+
+struct TestRecord {
+  uint64 entry_hash;
+  EntryMetadata metadata;
+};
+
+class SimpleIndexTableTest : public testing::Test {
+ protected:
+  virtual void SetUp() OVERRIDE {
+    ASSERT_TRUE(temp_dir_.CreateUniqueTempDir());
+    file_path_ = temp_dir_.path().AppendASCII("the-mapped-index");
+    cache_modified_ = base::Time::UnixEpoch() + base::TimeDelta::FromDays(1);
+  }
+
+  scoped_refptr<SimpleIndexTable> Reopen() {
+    scoped_refptr<SimpleIndexTable> table(new SimpleIndexTable(file_path_));
+    EXPECT_TRUE(table->Open());
+    return table;
+  }
+
+  static EntryMetadata MakeMetadata(int seconds, int size) {
+    return EntryMetadata(
+        base::Time::UnixEpoch() + base::TimeDelta::FromSeconds(seconds), size);
+  }
+
+  static void ExpectEntries(const SimpleIndex::EntrySet& expected,
+                            const SimpleIndexTable& table) {
+    SimpleIndex::EntrySet entries;
+    table.GetEntries(&entries);
+    EXPECT_EQ(expected.size(), entries.size());
+    EXPECT_EQ(expected.size(), table.entry_count());
+    for (SimpleIndex::EntrySet::const_iterator it = expected.begin();
+         it != expected.end(); ++it) {
+      SimpleIndex::EntrySet::const_iterator found = entries.find(it->first);
+      ASSERT_TRUE(found != entries.end());
+      EXPECT_EQ(it->second.GetLastUsedTime(), found->second.GetLastUsedTime());
+      EXPECT_EQ(it->second.GetEntrySize(), found->second.GetEntrySize());
+    }
+  }
+
+  base::ScopedTempDir temp_dir_;
+  base::FilePath file_path_;
+  base::Time cache_modified_;
+};
+
+}  // namespace
+
+TEST_F(SimpleIndexTableTest, CreateAndReopen) {
+  scoped_refptr<SimpleIndexTable> table(new SimpleIndexTable(file_path_));
+  EXPECT_FALSE(table->Open());
+
+  SimpleIndexTable::EntryList updated;
+  SimpleIndex::EntrySet expected;
+  for (uint64 i = 1; i <= 10; ++i) {
+    updated.push_back(std::make_pair(i * 7919, MakeMetadata(i, i * 100)));
+    expected[i * 7919] = MakeMetadata(i, i * 100);
+  }
+  EXPECT_TRUE(table->Apply(updated, std::vector<uint64>(), cache_modified_));
+  ExpectEntries(expected, *table.get());
+  table = NULL;
+
+  table = Reopen();
+  ExpectEntries(expected, *table.get());
+  EXPECT_EQ(cache_modified_, table->cache_last_modified());
+}
+
+TEST_F(SimpleIndexTableTest, UpdateInPlace) {
+  scoped_refptr<SimpleIndexTable> table(new SimpleIndexTable(file_path_));
+  SimpleIndexTable::EntryList updated;
+  for (uint64 i = 1; i <= 100; ++i)
+    updated.push_back(std::make_pair(i, MakeMetadata(i, 10)));
+  ASSERT_TRUE(table->Apply(updated, std::vector<uint64>(), cache_modified_));
+  const uint32 bucket_count = table->GetBucketCountForTesting();
+
+  SimpleIndex::EntrySet expected;
+  for (uint64 i = 1; i <= 100; ++i)
+    expected[i] = MakeMetadata(i, 10);
+  updated.clear();
+  updated.push_back(std::make_pair(5, MakeMetadata(500, 50)));
+  updated.push_back(std::make_pair(1000, MakeMetadata(1000, 1)));
+  expected[5] = MakeMetadata(500, 50);
+  expected[1000] = MakeMetadata(1000, 1);
+  std::vector<uint64> removed;
+  removed.push_back(7);
+  removed.push_back(12345);
+  expected.erase(7);
+  const base::Time later = cache_modified_ + base::TimeDelta::FromHours(1);
+  EXPECT_TRUE(table->Apply(updated, removed, later));
+  EXPECT_EQ(bucket_count, table->GetBucketCountForTesting());
+  ExpectEntries(expected, *table.get());
+  table = NULL;
+
+  table = Reopen();
+  ExpectEntries(expected, *table.get());
+  EXPECT_EQ(later, table->cache_last_modified());
+}
+
+// Removing an entry keeps the entries probed after it reachable.
+TEST_F(SimpleIndexTableTest, RemoveKeepsProbeSequence) {
+  scoped_refptr<SimpleIndexTable> table(new SimpleIndexTable(file_path_));
+  ASSERT_TRUE(table->Apply(SimpleIndexTable::EntryList(),
+                           std::vector<uint64>(), cache_modified_));
+  const uint64 bucket_count = table->GetBucketCountForTesting();
+
+  // These all hash to the last bucket, so the probe sequence wraps around.
+  SimpleIndexTable::EntryList updated;
+  SimpleIndex::EntrySet expected;
+  for (uint64 i = 0; i < 4; ++i) {
+    const uint64 entry_hash = i * bucket_count + bucket_count - 1;
+    updated.push_back(std::make_pair(entry_hash, MakeMetadata(i + 1, 1)));
+    expected[entry_hash] = MakeMetadata(i + 1, 1);
+  }
+  // And this one to the first bucket, which the sequence above wraps into.
+  updated.push_back(std::make_pair(bucket_count, MakeMetadata(10, 1)));
+  expected[bucket_count] = MakeMetadata(10, 1);
+  ASSERT_TRUE(table->Apply(updated, std::vector<uint64>(), cache_modified_));
+
+  std::vector<uint64> removed;
+  removed.push_back(bucket_count - 1);
+  expected.erase(bucket_count - 1);
+  ASSERT_TRUE(table->Apply(SimpleIndexTable::EntryList(), removed,
+                           cache_modified_));
+  ExpectEntries(expected, *table.get());
+
+  // Updating the entries finds them, rather than adding them again.
+  updated.clear();
+  for (SimpleIndex::EntrySet::iterator it = expected.begin();
+       it != expected.end(); ++it) {
+    it->second.SetEntrySize(2);
+    updated.push_back(*it);
+  }
+  ASSERT_TRUE(table->Apply(updated, std::vector<uint64>(), cache_modified_));
+  ExpectEntries(expected, *table.get());
+}
+
+TEST_F(SimpleIndexTableTest, Grow) {
+  scoped_refptr<SimpleIndexTable> table(new SimpleIndexTable(file_path_));
+  ASSERT_TRUE(table->Apply(SimpleIndexTable::EntryList(),
+                           std::vector<uint64>(), cache_modified_));
+  const uint32 bucket_count = table->GetBucketCountForTesting();
+
+  SimpleIndex::EntrySet expected;
+  uint64 next_hash = 1;
+  while (table->GetBucketCountForTesting() == bucket_count) {
+    SimpleIndexTable::EntryList updated;
+    for (int i = 0; i < 100; ++i, ++next_hash) {
+      updated.push_back(std::make_pair(next_hash * 104729,
+                                       MakeMetadata(next_hash, 1)));
+      expected[next_hash * 104729] = MakeMetadata(next_hash, 1);
+    }
+    ASSERT_TRUE(table->Apply(updated, std::vector<uint64>(), cache_modified_));
+  }
+  EXPECT_LT(bucket_count, table->GetBucketCountForTesting());
+  ExpectEntries(expected, *table.get());
+  table = NULL;
+
+  table = Reopen();
+  ExpectEntries(expected, *table.get());
+}
+
+// More changes than the journal holds rebuild the file.
+TEST_F(SimpleIndexTableTest, ApplyMoreThanJournal) {
+  scoped_refptr<SimpleIndexTable> table(new SimpleIndexTable(file_path_));
+  ASSERT_TRUE(table->Apply(SimpleIndexTable::EntryList(),
+                           std::vector<uint64>(), cache_modified_));
+
+  SimpleIndexTable::EntryList updated;
+  SimpleIndex::EntrySet expected;
+  for (uint64 i = 1; i <= SimpleIndexTable::kJournalCapacity + 1; ++i) {
+    updated.push_back(std::make_pair(i, MakeMetadata(i, 1)));
+    expected[i] = MakeMetadata(i, 1);
+  }
+  ASSERT_TRUE(table->Apply(updated, std::vector<uint64>(), cache_modified_));
+  ExpectEntries(expected, *table.get());
+}
+
+// A journal committed before a crash is applied by Open().
+TEST_F(SimpleIndexTableTest, ReplayCommittedJournal) {
+  scoped_refptr<SimpleIndexTable> table(new SimpleIndexTable(file_path_));
+  SimpleIndexTable::EntryList updated;
+  updated.push_back(std::make_pair(1, MakeMetadata(1, 1)));
+  updated.push_back(std::make_pair(2, MakeMetadata(2, 2)));
+  ASSERT_TRUE(table->Apply(updated, std::vector<uint64>(), cache_modified_));
+  table = NULL;
+
+  TestRecord records[2];
+  records[0].entry_hash = 3;
+  records[0].metadata = MakeMetadata(3, 3);
+  records[1].entry_hash = 1;
+  records[1].metadata = EntryMetadata();
+  records[1].metadata.SetEntrySize(-1);
+  const uint32 journal[2] = {
+    2,
+    static_cast<uint32>(crc32(crc32(0, Z_NULL, 0),
+                              reinterpret_cast<const Bytef*>(records),
+                              sizeof(records))),
+  };
+  {
+    base::File file(file_path_,
+                    base::File::FLAG_OPEN | base::File::FLAG_WRITE);
+    ASSERT_TRUE(file.IsValid());
+    ASSERT_EQ(static_cast<int>(sizeof(records)),
+              file.Write(kJournalOffset, reinterpret_cast<const char*>(records),
+                         sizeof(records)));
+    ASSERT_EQ(static_cast<int>(sizeof(journal)),
+              file.Write(kJournalSizeOffset,
+                         reinterpret_cast<const char*>(journal),
+                         sizeof(journal)));
+  }
+
+  table = Reopen();
+  SimpleIndex::EntrySet expected;
+  expected[2] = MakeMetadata(2, 2);
+  expected[3] = MakeMetadata(3, 3);
+  ExpectEntries(expected, *table.get());
+}
+
+// A journal that a crash left torn is dropped by Open().
+TEST_F(SimpleIndexTableTest, DropTornJournal) {
+  scoped_refptr<SimpleIndexTable> table(new SimpleIndexTable(file_path_));
+  SimpleIndexTable::EntryList updated;
+  updated.push_back(std::make_pair(1, MakeMetadata(1, 1)));
+  ASSERT_TRUE(table->Apply(updated, std::vector<uint64>(), cache_modified_));
+  table = NULL;
+
+  TestRecord record;
+  record.entry_hash = 2;
+  record.metadata = MakeMetadata(2, 2);
+  const uint32 journal[2] = { 1, 0xdeadbeef };
+  {
+    base::File file(file_path_,
+                    base::File::FLAG_OPEN | base::File::FLAG_WRITE);
+    ASSERT_TRUE(file.IsValid());
+    ASSERT_EQ(static_cast<int>(sizeof(record)),
+              file.Write(kJournalOffset, reinterpret_cast<const char*>(&record),
+                         sizeof(record)));
+    ASSERT_EQ(static_cast<int>(sizeof(journal)),
+              file.Write(kJournalSizeOffset,
+                         reinterpret_cast<const char*>(journal),
+                         sizeof(journal)));
+  }
+
+  table = Reopen();
+  SimpleIndex::EntrySet expected;
+  expected[1] = MakeMetadata(1, 1);
+  ExpectEntries(expected, *table.get());
+}
+
+// A table whose buckets are all taken is corrupt, and is rebuilt rather than
+// probed for the records of its journal.
+TEST_F(SimpleIndexTableTest, OpenFullTable) {
+  scoped_refptr<SimpleIndexTable> table(new SimpleIndexTable(file_path_));
+  SimpleIndexTable::EntryList updated;
+  updated.push_back(std::make_pair(1, MakeMetadata(1, 1)));
+  ASSERT_TRUE(table->Apply(updated, std::vector<uint64>(), cache_modified_));
+  const uint32 bucket_count = table->GetBucketCountForTesting();
+  table = NULL;
+
+  std::vector<TestRecord> buckets(bucket_count);
+  for (uint32 i = 0; i < bucket_count; ++i) {
+    buckets[i].entry_hash = i;
+    buckets[i].metadata = MakeMetadata(1, 1);
+  }
+  TestRecord record;
+  record.entry_hash = bucket_count;
+  record.metadata = MakeMetadata(2, 2);
+  const uint32 journal[2] = {
+    1,
+    static_cast<uint32>(crc32(crc32(0, Z_NULL, 0),
+                              reinterpret_cast<const Bytef*>(&record),
+                              sizeof(record))),
+  };
+  {
+    base::File file(file_path_,
+                    base::File::FLAG_OPEN | base::File::FLAG_WRITE);
+    ASSERT_TRUE(file.IsValid());
+    const int buckets_length =
+        static_cast<int>(bucket_count * sizeof(TestRecord));
+    ASSERT_EQ(buckets_length,
+              file.Write(kJournalOffset + SimpleIndexTable::kJournalCapacity *
+                                              sizeof(TestRecord),
+                         reinterpret_cast<const char*>(&buckets[0]),
+                         buckets_length));
+    ASSERT_EQ(static_cast<int>(sizeof(record)),
+              file.Write(kJournalOffset, reinterpret_cast<const char*>(&record),
+                         sizeof(record)));
+    ASSERT_EQ(static_cast<int>(sizeof(journal)),
+              file.Write(kJournalSizeOffset,
+                         reinterpret_cast<const char*>(journal),
+                         sizeof(journal)));
+  }
+
+  table = new SimpleIndexTable(file_path_);
+  EXPECT_FALSE(table->Open());
+  EXPECT_FALSE(base::PathExists(file_path_));
+}
+
+TEST_F(SimpleIndexTableTest, OpenCorrupt) {
+  const char kGarbage[] = "not an index";
+  ASSERT_EQ(static_cast<int>(sizeof(kGarbage)),
+            base::WriteFile(file_path_, kGarbage, sizeof(kGarbage)));
+  scoped_refptr<SimpleIndexTable> table(new SimpleIndexTable(file_path_));
+  EXPECT_FALSE(table->Open());
+  EXPECT_FALSE(base::PathExists(file_path_));
+
+  // The table is then built from scratch.
+  SimpleIndexTable::EntryList updated;
+  updated.push_back(std::make_pair(1, MakeMetadata(1, 1)));
+  EXPECT_TRUE(table->Apply(updated, std::vector<uint64>(), cache_modified_));
+  table = Reopen();
+  EXPECT_EQ(1u, table->entry_count());
+}
+
+#endif  // defined(OS_POSIX)
+
+}  // namespace disk_cache
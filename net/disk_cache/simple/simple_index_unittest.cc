@@ -67,17 +67,23 @@ class MockSimpleIndexFile : public SimpleIndexFile,
   }
 
   virtual void WriteToDisk(const SimpleIndex::EntrySet& entry_set,
+                           const base::hash_set<uint64>& dirty_entries,
                            uint64 cache_size,
                            const base::TimeTicks& start,
                            bool app_on_background) OVERRIDE {
     disk_writes_++;
     disk_write_entry_set_ = entry_set;
+    disk_write_dirty_entries_ = dirty_entries;
   }
 
   void GetAndResetDiskWriteEntrySet(SimpleIndex::EntrySet* entry_set) {
     entry_set->swap(disk_write_entry_set_);
   }
 
+  const base::hash_set<uint64>& disk_write_dirty_entries() const {
+    return disk_write_dirty_entries_;
+  }
+
   const base::Closure& load_callback() const { return load_callback_; }
   SimpleIndexLoadResult* load_result() const { return load_result_; }
   int load_index_entries_calls() const { return load_index_entries_calls_; }
@@ -89,6 +95,7 @@ class MockSimpleIndexFile : public SimpleIndexFile,
   int load_index_entries_calls_;
   int disk_writes_;
   SimpleIndex::EntrySet disk_write_entry_set_;
+  base::hash_set<uint64> disk_write_dirty_entries_;
 };
 
 class SimpleIndexTest  : public testing::Test, public SimpleIndexDelegate {
@@ -604,6 +611,46 @@ TEST_F(SimpleIndexTest, DiskWriteExecuted) {
   EXPECT_EQ(20, entry1.GetEntrySize());
 }
 
+// Only the entries changed since the last write are reported dirty to the
+// index file.
+TEST_F(SimpleIndexTest, DiskWriteDirtyEntries) {
+  const uint64 kHash1 = hashes_.at<1>();
+  const uint64 kHash2 = hashes_.at<2>();
+  const uint64 kHash3 = hashes_.at<3>();
+  const uint64 kHash4 = hashes_.at<4>();
+  InsertIntoIndexFileReturn(kHash1, base::Time::Now(), 10);
+  InsertIntoIndexFileReturn(kHash2, base::Time::Now(), 10);
+  InsertIntoIndexFileReturn(kHash4, base::Time::Now(), 10);
+  ReturnIndexFile();
+
+  index()->UseIfExists(kHash1);
+  index()->Remove(kHash2);
+  index()->Insert(kHash3);
+  index()->WriteToDisk();
+  EXPECT_EQ(1, index_file()->disk_writes());
+  const base::hash_set<uint64>& dirty_entries =
+      index_file()->disk_write_dirty_entries();
+  EXPECT_EQ(3u, dirty_entries.size());
+  EXPECT_EQ(1u, dirty_entries.count(kHash1));
+  EXPECT_EQ(1u, dirty_entries.count(kHash2));
+  EXPECT_EQ(1u, dirty_entries.count(kHash3));
+
+  index()->WriteToDisk();
+  EXPECT_EQ(2, index_file()->disk_writes());
+  EXPECT_TRUE(index_file()->disk_write_dirty_entries().empty());
+}
+
+// An index restored from disk reports all its entries dirty.
+TEST_F(SimpleIndexTest, DiskWriteAllDirtyOnRestore) {
+  InsertIntoIndexFileReturn(hashes_.at<1>(), base::Time::Now(), 10);
+  InsertIntoIndexFileReturn(hashes_.at<2>(), base::Time::Now(), 10);
+  index_file_->load_result()->flush_required = true;
+  ReturnIndexFile();
+
+  EXPECT_EQ(1, index_file()->disk_writes());
+  EXPECT_EQ(2u, index_file()->disk_write_dirty_entries().size());
+}
+
 TEST_F(SimpleIndexTest, DiskWritePostponed) {
   index()->SetMaxSize(1000);
   ReturnIndexFile();
@@ -0,0 +1,730 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/disk_cache/simple/simple_segment_store.h"
+
+#include <algorithm>
+#include <vector>
+
+#include "base/bind.h"
+#include "base/files/file.h"
+#include "base/files/file_enumerator.h"
+#include "base/files/file_util.h"
+#include "base/location.h"
+#include "base/logging.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/strings/stringprintf.h"
+#include "base/task_runner.h"
+#include "net/disk_cache/simple/simple_entry_format.h"
+#include "third_party/zlib/zlib.h"
+
+namespace disk_cache {
+
+namespace {
+
+const char kSegmentDirectory[] = "segments";
+const char kSegmentFilePrefix[] = "segment_";
+const uint32 kSegmentVersion = 1;
+
+// Segments are sealed once they reach this size.
+const int64 kDefaultMaxSegmentSize = 8 * 1024 * 1024;
+
+const int64 kRecordsStart = sizeof(SimpleSegmentFileHeader);
+
+typedef std::vector<SimpleSegmentRecordHeader> RecordHeaders;
+
+// A segment is opened by a reader while the compaction may delete it.
+const uint32 kSegmentFileFlags = base::File::FLAG_READ |
+                                 base::File::FLAG_WRITE |
+                                 base::File::FLAG_SHARE_DELETE;
+
+base::FilePath GetSegmentDirectory(const base::FilePath& cache_path) {
+  return cache_path.AppendASCII(kSegmentDirectory);
+}
+
+base::FilePath GetSegmentFilePath(const base::FilePath& directory,
+                                  uint32 segment_id) {
+  return directory.AppendASCII(
+      base::StringPrintf("%s%08x", kSegmentFilePrefix, segment_id));
+}
+
+// Returns the ids of the segments in |directory|, in the order they were
+// started in.
+std::vector<uint32> ListSegments(const base::FilePath& directory) {
+  std::vector<uint32> segment_ids;
+  const std::string prefix(kSegmentFilePrefix);
+  base::FileEnumerator enumerator(directory, false,
+                                  base::FileEnumerator::FILES);
+  for (base::FilePath path = enumerator.Next(); !path.empty();
+       path = enumerator.Next()) {
+    const std::string name = path.BaseName().MaybeAsASCII();
+    uint32 segment_id;
+    if (name.size() != prefix.size() + 8 ||
+        name.compare(0, prefix.size(), prefix) != 0 ||
+        !base::HexStringToUInt(name.substr(prefix.size()), &segment_id) ||
+        segment_id == 0) {
+      continue;
+    }
+    segment_ids.push_back(segment_id);
+  }
+  std::sort(segment_ids.begin(), segment_ids.end());
+  return segment_ids;
+}
+
+int64 GetRecordSize(const SimpleSegmentRecordHeader& header) {
+  return sizeof(header) + header.data_size;
+}
+
+bool IsTombstone(const SimpleSegmentRecordHeader& header) {
+  return (header.flags & SimpleSegmentRecordHeader::FLAG_TOMBSTONE) != 0;
+}
+
+uint32 GetRecordCrc(const SimpleSegmentRecordHeader& header,
+                    const char* data) {
+  SimpleSegmentRecordHeader header_copy = header;
+  header_copy.record_crc32 = 0;
+  uint32 crc = crc32(0, Z_NULL, 0);
+  crc = crc32(crc, reinterpret_cast<const Bytef*>(&header_copy),
+              sizeof(header_copy));
+  if (header.data_size > 0)
+    crc = crc32(crc, reinterpret_cast<const Bytef*>(data), header.data_size);
+  return crc;
+}
+
+uint32 GetHeadersCrc(const RecordHeaders& headers) {
+  uint32 crc = crc32(0, Z_NULL, 0);
+  if (!headers.empty()) {
+    crc = crc32(crc, reinterpret_cast<const Bytef*>(&headers[0]),
+                headers.size() * sizeof(headers[0]));
+  }
+  return crc;
+}
+
+// Reads the headers of the records of a sealed segment from its footer.
+// Returns false if the footer is missing or invalid.
+bool ReadFooter(base::File* file,
+                int64 length,
+                RecordHeaders* out_headers,
+                int64* out_records_end) {
+  SimpleSegmentFooter footer;
+  if (length < kRecordsStart + static_cast<int64>(sizeof(footer)))
+    return false;
+  const int64 footer_offset = length - sizeof(footer);
+  if (file->Read(footer_offset, reinterpret_cast<char*>(&footer),
+                 sizeof(footer)) != sizeof(footer) ||
+      footer.magic_number != kSimpleSegmentFooterMagicNumber) {
+    return false;
+  }
+  const int64 headers_size =
+      static_cast<int64>(footer.record_count) *
+      sizeof(SimpleSegmentRecordHeader);
+  const int64 records_end = footer_offset - headers_size;
+  if (records_end < kRecordsStart)
+    return false;
+
+  RecordHeaders headers(footer.record_count);
+  if (!headers.empty() &&
+      file->Read(records_end, reinterpret_cast<char*>(&headers[0]),
+                 headers_size) != headers_size) {
+    return false;
+  }
+  if (GetHeadersCrc(headers) != footer.headers_crc32)
+    return false;
+  int64 offset = kRecordsStart;
+  for (size_t i = 0; i < headers.size(); ++i)
+    offset += GetRecordSize(headers[i]);
+  if (offset != records_end)
+    return false;
+
+  out_headers->swap(headers);
+  *out_records_end = records_end;
+  return true;
+}
+
+// Reads the headers of the records of a segment. A sealed segment is read
+// from its footer; the records of another one are read and checked in full,
+// up to the first incomplete one, where the segment is truncated if
+// |truncate|. Returns false if |file| isn't the segment |segment_id|.
+bool LoadSegment(base::File* file,
+                 uint32 segment_id,
+                 bool truncate,
+                 RecordHeaders* out_headers,
+                 int64* out_records_end,
+                 bool* out_sealed) {
+  SimpleSegmentFileHeader file_header;
+  if (file->Read(0, reinterpret_cast<char*>(&file_header),
+                 sizeof(file_header)) != sizeof(file_header) ||
+      file_header.magic_number != kSimpleSegmentMagicNumber ||
+      file_header.version != kSegmentVersion ||
+      file_header.segment_id != segment_id) {
+    return false;
+  }
+  const int64 length = file->GetLength();
+  if (length < kRecordsStart)
+    return false;
+
+  out_headers->clear();
+  *out_sealed = ReadFooter(file, length, out_headers, out_records_end);
+  if (*out_sealed)
+    return true;
+
+  int64 offset = kRecordsStart;
+  std::string data;
+  while (offset < length) {
+    SimpleSegmentRecordHeader header;
+    if (length - offset < static_cast<int64>(sizeof(header)) ||
+        file->Read(offset, reinterpret_cast<char*>(&header),
+                   sizeof(header)) != sizeof(header) ||
+        header.magic_number != kSimpleSegmentRecordMagicNumber ||
+        header.data_size > static_cast<uint32>(
+                               SimpleSegmentStore::kMaxImageSize) ||
+        GetRecordSize(header) > length - offset) {
+      break;
+    }
+    data.resize(header.data_size);
+    if (header.data_size > 0 &&
+        file->Read(offset + sizeof(header), &data[0], header.data_size) !=
+            static_cast<int>(header.data_size)) {
+      break;
+    }
+    if (GetRecordCrc(header, data.data()) != header.record_crc32)
+      break;
+    out_headers->push_back(header);
+    offset += GetRecordSize(header);
+  }
+  if (offset < length) {
+    DLOG(WARNING) << "Incomplete record in segment " << segment_id
+                  << " at offset " << offset;
+    if (truncate && !file->SetLength(offset))
+      return false;
+  }
+  *out_records_end = offset;
+  return true;
+}
+
+}  // namespace
+
+class SimpleSegmentStore::Segment
+    : public base::RefCountedThreadSafe<SimpleSegmentStore::Segment> {
+ public:
+  Segment(uint32 id_p, const base::FilePath& path_p, base::File file_p)
+      : id(id_p),
+        path(path_p),
+        file(file_p.Pass()),
+        records_end(kRecordsStart),
+        live_bytes(0),
+        sealed(false) {}
+
+  // Returns true if less than half of the records of the segment are live.
+  bool NeedsCompaction() const {
+    return sealed && live_bytes * 2 < records_end - kRecordsStart;
+  }
+
+  const uint32 id;
+  const base::FilePath path;
+
+  // Only read from outside of |lock_|.
+  base::File file;
+
+  // The members below are guarded by the |lock_| of the store.
+  int64 records_end;
+  int64 live_bytes;
+  bool sealed;
+  RecordHeaders headers;
+
+ private:
+  friend class base::RefCountedThreadSafe<Segment>;
+
+  ~Segment() {}
+
+  DISALLOW_COPY_AND_ASSIGN(Segment);
+};
+
+SimpleSegmentStore::RecordLocation::RecordLocation()
+    : segment_id(0),
+      offset(0),
+      size(0),
+      ticket(0) {
+}
+
+SimpleSegmentStore::SimpleSegmentStore(
+    const base::FilePath& cache_path,
+    const scoped_refptr<base::TaskRunner>& worker_pool)
+    : directory_(GetSegmentDirectory(cache_path)),
+      worker_pool_(worker_pool),
+      max_segment_size_(kDefaultMaxSegmentSize),
+      next_segment_id_(1),
+      active_segment_id_(0),
+      next_ticket_(1),
+      compaction_pending_(false) {
+}
+
+bool SimpleSegmentStore::Init() {
+  if (!base::CreateDirectory(directory_)) {
+    LOG(ERROR) << "Could not create " << directory_.LossyDisplayName();
+    return false;
+  }
+
+  base::AutoLock auto_lock(lock_);
+  DCHECK(segments_.empty());
+  const std::vector<uint32> segment_ids = ListSegments(directory_);
+  for (size_t i = 0; i < segment_ids.size(); ++i) {
+    const uint32 segment_id = segment_ids[i];
+    const base::FilePath path = GetSegmentFilePath(directory_, segment_id);
+    next_segment_id_ = segment_id + 1;
+
+    base::File file(path, base::File::FLAG_OPEN | kSegmentFileFlags);
+    base::File::Info info;
+    if (!file.IsValid() || !file.GetInfo(&info))
+      return false;
+    scoped_refptr<Segment> segment(new Segment(segment_id, path, file.Pass()));
+    if (!LoadSegment(&segment->file, segment_id, true, &segment->headers,
+                     &segment->records_end, &segment->sealed)) {
+      // Only the creation of a segment, before any record was appended to
+      // it, can leave it without a valid header.
+      DLOG(WARNING) << "Deleting invalid segment " << segment_id;
+      segment->file.Close();
+      base::DeleteFile(path, false);
+      continue;
+    }
+    last_modified_ = std::max(last_modified_, info.last_modified);
+    segments_[segment_id] = segment;
+
+    int64 offset = kRecordsStart;
+    for (RecordHeaders::const_iterator it = segment->headers.begin();
+         it != segment->headers.end(); ++it) {
+      if (IsTombstone(*it)) {
+        entries_.erase(it->entry_hash);
+      } else {
+        RecordLocation& location = entries_[it->entry_hash];
+        location.segment_id = segment_id;
+        location.offset = offset;
+        location.size = GetRecordSize(*it);
+      }
+      offset += GetRecordSize(*it);
+    }
+  }
+
+  for (EntryTable::iterator it = entries_.begin(); it != entries_.end();
+       ++it) {
+    it->second.ticket = next_ticket_++;
+    segments_[it->second.segment_id]->live_bytes += it->second.size;
+  }
+
+  // Records are appended to the newest segment if it wasn't sealed; the
+  // others were sealed, unless writing their footer failed.
+  for (SegmentMap::iterator it = segments_.begin(); it != segments_.end();
+       ++it) {
+    if (it->second->sealed)
+      continue;
+    if (it->first == segments_.rbegin()->first)
+      active_segment_id_ = it->first;
+    else
+      SealSegmentLocked(it->second.get());
+  }
+  MaybePostCompactionLocked();
+  return true;
+}
+
+bool SimpleSegmentStore::CreateEntry(uint64 entry_hash, uint64* out_ticket) {
+  base::AutoLock auto_lock(lock_);
+  std::pair<EntryTable::iterator, bool> insert_result =
+      entries_.insert(std::make_pair(entry_hash, RecordLocation()));
+  if (!insert_result.second)
+    return false;
+  insert_result.first->second.ticket = next_ticket_++;
+  *out_ticket = insert_result.first->second.ticket;
+  return true;
+}
+
+bool SimpleSegmentStore::OpenEntry(uint64 entry_hash,
+                                   std::string* out_image,
+                                   base::Time* out_last_modified,
+                                   uint64* out_ticket) {
+  scoped_refptr<Segment> segment;
+  RecordLocation location;
+  {
+    base::AutoLock auto_lock(lock_);
+    EntryTable::const_iterator it = entries_.find(entry_hash);
+    if (it == entries_.end() || it->second.segment_id == 0)
+      return false;
+    location = it->second;
+    segment = segments_[location.segment_id];
+  }
+
+  // Compacting the segment doesn't close it, so it can be read outside of the
+  // lock.
+  std::string record(location.size, '\0');
+  if (segment->file.Read(location.offset, &record[0], location.size) !=
+      location.size) {
+    DLOG(WARNING) << "Could not read the record of an entry.";
+    return false;
+  }
+  SimpleSegmentRecordHeader header;
+  memcpy(&header, record.data(), sizeof(header));
+  const char* data = record.data() + sizeof(header);
+  if (header.magic_number != kSimpleSegmentRecordMagicNumber ||
+      header.entry_hash != entry_hash ||
+      GetRecordSize(header) != location.size ||
+      GetRecordCrc(header, data) != header.record_crc32) {
+    DLOG(WARNING) << "Invalid record for an entry.";
+    return false;
+  }
+  out_image->assign(data, header.data_size);
+  *out_last_modified = base::Time::FromInternalValue(header.last_modified);
+  *out_ticket = location.ticket;
+  return true;
+}
+
+bool SimpleSegmentStore::IsCurrent(uint64 entry_hash, uint64 ticket) {
+  base::AutoLock auto_lock(lock_);
+  EntryTable::const_iterator it = entries_.find(entry_hash);
+  return it != entries_.end() && it->second.ticket == ticket;
+}
+
+bool SimpleSegmentStore::CloseEntry(uint64 entry_hash,
+                                    uint64 ticket,
+                                    const std::string& image,
+                                    base::Time last_modified) {
+  DCHECK_GE(kMaxImageSize, static_cast<int>(image.size()));
+  base::AutoLock auto_lock(lock_);
+  EntryTable::iterator it = entries_.find(entry_hash);
+  if (it == entries_.end() || it->second.ticket != ticket)
+    return false;
+
+  const RecordLocation old_location = it->second;
+  RecordLocation new_location;
+  if (!AppendRecordLocked(entry_hash, 0, image, last_modified,
+                          &new_location)) {
+    RemoveEntryLocked(it);
+    return false;
+  }
+  if (old_location.segment_id)
+    ReleaseRecordLocked(old_location);
+  new_location.ticket = ticket;
+  it->second = new_location;
+  return true;
+}
+
+bool SimpleSegmentStore::DoomEntry(uint64 entry_hash) {
+  base::AutoLock auto_lock(lock_);
+  EntryTable::iterator it = entries_.find(entry_hash);
+  if (it == entries_.end())
+    return true;
+  return RemoveEntryLocked(it);
+}
+
+// static
+void SimpleSegmentStore::RestoreEntries(const base::FilePath& cache_path,
+                                        SimpleIndex::EntrySet* entries) {
+  const base::FilePath directory = GetSegmentDirectory(cache_path);
+  SimpleIndex::EntrySet segment_entries;
+  const std::vector<uint32> segment_ids = ListSegments(directory);
+  for (size_t i = 0; i < segment_ids.size(); ++i) {
+    base::File file(GetSegmentFilePath(directory, segment_ids[i]),
+                    base::File::FLAG_OPEN | base::File::FLAG_READ |
+                        base::File::FLAG_SHARE_DELETE);
+    RecordHeaders headers;
+    int64 records_end;
+    bool sealed;
+    if (!file.IsValid() ||
+        !LoadSegment(&file, segment_ids[i], false, &headers, &records_end,
+                     &sealed)) {
+      continue;
+    }
+    for (RecordHeaders::const_iterator it = headers.begin();
+         it != headers.end(); ++it) {
+      if (IsTombstone(*it)) {
+        segment_entries.erase(it->entry_hash);
+      } else {
+        segment_entries[it->entry_hash] = EntryMetadata(
+            base::Time::FromInternalValue(it->last_modified),
+            GetRecordSize(*it));
+      }
+    }
+  }
+
+  for (SimpleIndex::EntrySet::const_iterator it = segment_entries.begin();
+       it != segment_entries.end(); ++it) {
+    SimpleIndex::EntrySet::iterator found = entries->find(it->first);
+    if (found == entries->end()) {
+      SimpleIndex::InsertInEntrySet(it->first, it->second, entries);
+    } else {
+      // The stream 2 or the sparse file of the entry were found first.
+      found->second.SetEntrySize(found->second.GetEntrySize() +
+                                 it->second.GetEntrySize());
+    }
+  }
+}
+
+size_t SimpleSegmentStore::GetSegmentCountForTesting() {
+  base::AutoLock auto_lock(lock_);
+  return segments_.size();
+}
+
+size_t SimpleSegmentStore::GetTombstoneCountForTesting() {
+  base::AutoLock auto_lock(lock_);
+  size_t tombstone_count = 0;
+  for (SegmentMap::const_iterator it = segments_.begin();
+       it != segments_.end(); ++it) {
+    tombstone_count += std::count_if(it->second->headers.begin(),
+                                     it->second->headers.end(), IsTombstone);
+  }
+  return tombstone_count;
+}
+
+SimpleSegmentStore::~SimpleSegmentStore() {
+}
+
+bool SimpleSegmentStore::AppendRecordLocked(uint64 entry_hash,
+                                            uint32 flags,
+                                            const std::string& data,
+                                            base::Time last_modified,
+                                            RecordLocation* out_location) {
+  lock_.AssertAcquired();
+  SimpleSegmentRecordHeader header;
+  header.magic_number = kSimpleSegmentRecordMagicNumber;
+  header.flags = flags;
+  header.entry_hash = entry_hash;
+  header.last_modified = last_modified.ToInternalValue();
+  header.data_size = data.size();
+  header.record_crc32 = GetRecordCrc(header, data.data());
+  const int64 record_size = GetRecordSize(header);
+
+  Segment* segment =
+      active_segment_id_ ? segments_[active_segment_id_].get() : NULL;
+  if (segment && !segment->headers.empty() &&
+      segment->records_end + record_size > max_segment_size_) {
+    SealSegmentLocked(segment);
+    segment = NULL;
+  }
+  if (!segment) {
+    segment = CreateSegmentLocked();
+    if (!segment)
+      return false;
+  }
+
+  // A single write, so that a crash can only leave the last record torn.
+  std::string record(reinterpret_cast<const char*>(&header), sizeof(header));
+  record.append(data);
+  if (segment->file.Write(segment->records_end, record.data(),
+                          record.size()) != static_cast<int>(record.size())) {
+    DLOG(WARNING) << "Could not append to segment " << segment->id;
+    segment->file.SetLength(segment->records_end);
+    return false;
+  }
+
+  out_location->segment_id = segment->id;
+  out_location->offset = segment->records_end;
+  out_location->size = record_size;
+  segment->records_end += record_size;
+  segment->headers.push_back(header);
+  if (!IsTombstone(header))
+    segment->live_bytes += record_size;
+  return true;
+}
+
+SimpleSegmentStore::Segment* SimpleSegmentStore::CreateSegmentLocked() {
+  lock_.AssertAcquired();
+  const uint32 segment_id = next_segment_id_++;
+  const base::FilePath path = GetSegmentFilePath(directory_, segment_id);
+  base::File file(path, base::File::FLAG_CREATE_ALWAYS | kSegmentFileFlags);
+  SimpleSegmentFileHeader file_header;
+  file_header.magic_number = kSimpleSegmentMagicNumber;
+  file_header.version = kSegmentVersion;
+  file_header.segment_id = segment_id;
+  if (!file.IsValid() ||
+      file.Write(0, reinterpret_cast<const char*>(&file_header),
+                 sizeof(file_header)) != sizeof(file_header)) {
+    LOG(ERROR) << "Could not create segment " << path.LossyDisplayName();
+    file.Close();
+    base::DeleteFile(path, false);
+    return NULL;
+  }
+  Segment* segment = new Segment(segment_id, path, file.Pass());
+  segments_[segment_id] = segment;
+  active_segment_id_ = segment_id;
+  return segment;
+}
+
+void SimpleSegmentStore::SealSegmentLocked(Segment* segment) {
+  lock_.AssertAcquired();
+  DCHECK(!segment->sealed);
+  SimpleSegmentFooter footer;
+  footer.magic_number = kSimpleSegmentFooterMagicNumber;
+  footer.record_count = segment->headers.size();
+  footer.headers_crc32 = GetHeadersCrc(segment->headers);
+  std::string footer_data;
+  if (!segment->headers.empty()) {
+    footer_data.assign(reinterpret_cast<const char*>(&segment->headers[0]),
+                       segment->headers.size() * sizeof(segment->headers[0]));
+  }
+  footer_data.append(reinterpret_cast<const char*>(&footer), sizeof(footer));
+  // A segment whose footer couldn't be written is read in full by Init().
+  if (segment->file.Write(segment->records_end, footer_data.data(),
+                          footer_data.size()) !=
+      static_cast<int>(footer_data.size())) {
+    DLOG(WARNING) << "Could not write the footer of segment " << segment->id;
+  }
+  segment->sealed = true;
+  if (active_segment_id_ == segment->id)
+    active_segment_id_ = 0;
+  MaybePostCompactionLocked();
+}
+
+bool SimpleSegmentStore::RemoveEntryLocked(EntryTable::iterator it) {
+  lock_.AssertAcquired();
+  const uint64 entry_hash = it->first;
+  const RecordLocation location = it->second;
+  // An entry never closed has no record to remove.
+  if (location.segment_id) {
+    RecordLocation tombstone_location;
+    if (!AppendRecordLocked(entry_hash,
+                            SimpleSegmentRecordHeader::FLAG_TOMBSTONE,
+                            std::string(), base::Time(), &tombstone_location)) {
+      // The record would come back with the next Init(), so keep the entry.
+      it->second.ticket = next_ticket_++;
+      return false;
+    }
+    ReleaseRecordLocked(location);
+  }
+  entries_.erase(it);
+  return true;
+}
+
+void SimpleSegmentStore::ReleaseRecordLocked(const RecordLocation& location) {
+  lock_.AssertAcquired();
+  SegmentMap::iterator it = segments_.find(location.segment_id);
+  DCHECK(it != segments_.end());
+  it->second->live_bytes -= location.size;
+  DCHECK_LE(0, it->second->live_bytes);
+  if (it->second->NeedsCompaction())
+    MaybePostCompactionLocked();
+}
+
+void SimpleSegmentStore::MaybePostCompactionLocked() {
+  lock_.AssertAcquired();
+  if (compaction_pending_)
+    return;
+  for (SegmentMap::const_iterator it = segments_.begin();
+       it != segments_.end(); ++it) {
+    if (!it->second->NeedsCompaction())
+      continue;
+    compaction_pending_ = worker_pool_->PostTask(
+        FROM_HERE, base::Bind(&SimpleSegmentStore::CompactSegments, this));
+    return;
+  }
+}
+
+void SimpleSegmentStore::CompactSegments() {
+  for (;;) {
+    uint32 segment_id = 0;
+    {
+      base::AutoLock auto_lock(lock_);
+      for (SegmentMap::const_iterator it = segments_.begin();
+           it != segments_.end(); ++it) {
+        if (it->second->NeedsCompaction()) {
+          segment_id = it->first;
+          break;
+        }
+      }
+      if (!segment_id) {
+        compaction_pending_ = false;
+        return;
+      }
+    }
+    CompactSegment(segment_id);
+  }
+}
+
+void SimpleSegmentStore::CompactSegment(uint32 segment_id) {
+  scoped_refptr<Segment> segment;
+  RecordHeaders headers;
+  // The entries with a record in an older segment, which the tombstones of
+  // the segment may hide. Records are only appended to newer segments.
+  base::hash_set<uint64> shadowed_entries;
+  {
+    base::AutoLock auto_lock(lock_);
+    segment = segments_[segment_id];
+    headers = segment->headers;
+    for (SegmentMap::const_iterator it = segments_.begin();
+         it != segments_.end() && it->first < segment_id; ++it) {
+      for (RecordHeaders::const_iterator header = it->second->headers.begin();
+           header != it->second->headers.end(); ++header) {
+        if (!IsTombstone(*header))
+          shadowed_entries.insert(header->entry_hash);
+      }
+    }
+  }
+
+  int64 offset = kRecordsStart;
+  std::string data;
+  for (RecordHeaders::const_iterator it = headers.begin(); it != headers.end();
+       offset += GetRecordSize(*it), ++it) {
+    const uint64 entry_hash = it->entry_hash;
+    RecordLocation new_location;
+    if (IsTombstone(*it)) {
+      // A tombstone is only moved if it still hides the record of an older
+      // segment, and the entry wasn't written again since, as its newer
+      // record would be hidden.
+      if (!shadowed_entries.count(entry_hash))
+        continue;
+      base::AutoLock auto_lock(lock_);
+      EntryTable::const_iterator found = entries_.find(entry_hash);
+      if (found == entries_.end() || !found->second.segment_id) {
+        AppendRecordLocked(entry_hash, it->flags, std::string(), base::Time(),
+                           &new_location);
+      }
+      continue;
+    }
+
+    {
+      base::AutoLock auto_lock(lock_);
+      EntryTable::const_iterator found = entries_.find(entry_hash);
+      if (found == entries_.end() || found->second.segment_id != segment_id ||
+          found->second.offset != offset) {
+        continue;
+      }
+    }
+
+    data.resize(it->data_size);
+    const bool read_ok =
+        it->data_size == 0 ||
+        segment->file.Read(offset + sizeof(*it), &data[0], it->data_size) ==
+            static_cast<int>(it->data_size);
+
+    base::AutoLock auto_lock(lock_);
+    EntryTable::iterator found = entries_.find(entry_hash);
+    if (found == entries_.end() || found->second.segment_id != segment_id ||
+        found->second.offset != offset) {
+      continue;
+    }
+    const RecordLocation old_location = found->second;
+    if (!read_ok || GetRecordCrc(*it, data.data()) != it->record_crc32 ||
+        !AppendRecordLocked(
+            entry_hash, it->flags, data,
+            base::Time::FromInternalValue(it->last_modified),
+            &new_location)) {
+      DLOG(WARNING) << "Could not move a record out of segment " << segment_id;
+      entries_.erase(found);
+      ReleaseRecordLocked(old_location);
+      AppendRecordLocked(entry_hash, SimpleSegmentRecordHeader::FLAG_TOMBSTONE,
+                         std::string(), base::Time(), &new_location);
+      continue;
+    }
+    ReleaseRecordLocked(old_location);
+    new_location.ticket = old_location.ticket;
+    found->second = new_location;
+  }
+
+  {
+    base::AutoLock auto_lock(lock_);
+    DCHECK_EQ(0, segment->live_bytes);
+    segments_.erase(segment_id);
+  }
+  // The readers holding |segment| still read it once deleted.
+  base::DeleteFile(segment->path, false);
+}
+
+}  // namespace disk_cache
@@ -0,0 +1,176 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_DISK_CACHE_SIMPLE_SIMPLE_SEGMENT_STORE_H_
+#define NET_DISK_CACHE_SIMPLE_SIMPLE_SEGMENT_STORE_H_
+
+#include <map>
+#include <string>
+
+#include "base/basictypes.h"
+#include "base/containers/hash_tables.h"
+#include "base/files/file_path.h"
+#include "base/memory/ref_counted.h"
+#include "base/synchronization/lock.h"
+#include "base/time/time.h"
+#include "net/base/net_export.h"
+#include "net/disk_cache/simple/simple_index.h"
+
+namespace base {
+class TaskRunner;
+}
+
+namespace disk_cache {
+
+// The SimpleSegmentStore packs the file 0 of the small entries of a simple
+// cache, which holds their key, stream 0 and stream 1, in a few large segment
+// files, rather than in a file per entry. A cache of small entries then takes
+// a handful of files, and opening or closing one of them takes no system call
+// on a file of its own.
+//
+// Records are appended to the newest segment, and an offset table in memory
+// maps each entry hash to its newest record. Dooming an entry appends a
+// tombstone. When less than half of a full segment is live, its live records
+// are appended to the newest segment on the worker pool, and it is deleted.
+// A full segment ends with a copy of the headers of its records, so Init()
+// rebuilds the table from those, and from the records of the newest segment,
+// truncating the records a crash left incomplete.
+//
+// Tickets keep an instance of an entry doomed while open from writing over
+// the entry created next with its hash: the ticket from CreateEntry() or
+// OpenEntry() is invalidated by DoomEntry(), and CloseEntry() only writes
+// with a valid ticket.
+//
+// The methods below block on IO, and may be called on any thread, after
+// Init().
+class NET_EXPORT_PRIVATE SimpleSegmentStore
+    : public base::RefCountedThreadSafe<SimpleSegmentStore> {
+ public:
+  // The largest image of a file packed. Larger entries get their own files.
+  static const int kMaxImageSize = 32 * 1024;
+
+  SimpleSegmentStore(const base::FilePath& cache_path,
+                     const scoped_refptr<base::TaskRunner>& worker_pool);
+
+  // Reads the segments of the cache at |cache_path|, creating their
+  // directory if needed. Returns false if the segments can't be used.
+  bool Init();
+
+  // The time the segments were last written to, as of Init(). Writing to a
+  // segment doesn't change the modification time of the cache directory, on
+  // which the index relies to know if it is stale.
+  base::Time last_modified() const { return last_modified_; }
+
+  // Reserves |entry_hash| for a new entry. Returns false if the store already
+  // has an entry for |entry_hash|.
+  bool CreateEntry(uint64 entry_hash, uint64* out_ticket);
+
+  // Reads the image of the entry for |entry_hash|. Returns false if the store
+  // has no such entry, or if its record can't be read.
+  bool OpenEntry(uint64 entry_hash,
+                 std::string* out_image,
+                 base::Time* out_last_modified,
+                 uint64* out_ticket);
+
+  // Returns true if |ticket| is the current one for |entry_hash|.
+  bool IsCurrent(uint64 entry_hash, uint64 ticket);
+
+  // Appends a record of |image| for |entry_hash|, if |ticket| is current.
+  // Returns false if it isn't, or on failure, which dooms the entry if its
+  // previous record can be removed.
+  bool CloseEntry(uint64 entry_hash,
+                  uint64 ticket,
+                  const std::string& image,
+                  base::Time last_modified);
+
+  // Removes the entry for |entry_hash|, if any, invalidating its ticket.
+  // Returns false on failure, which keeps the entry.
+  bool DoomEntry(uint64 entry_hash);
+
+  // Adds the entries of the segments of the cache at |cache_path| to
+  // |entries|, adding their size to the size of an entry already there.
+  static void RestoreEntries(const base::FilePath& cache_path,
+                             SimpleIndex::EntrySet* entries);
+
+  void set_max_segment_size_for_testing(int64 max_segment_size) {
+    max_segment_size_ = max_segment_size;
+  }
+  size_t GetSegmentCountForTesting();
+  size_t GetTombstoneCountForTesting();
+
+ private:
+  friend class base::RefCountedThreadSafe<SimpleSegmentStore>;
+
+  class Segment;
+
+  // Where the newest record for an entry is, and the ticket of the entry.
+  // |segment_id| is 0 for an entry created and not closed yet.
+  struct RecordLocation {
+    RecordLocation();
+
+    uint32 segment_id;
+    int64 offset;
+    int32 size;
+    uint64 ticket;
+  };
+
+  typedef std::map<uint32, scoped_refptr<Segment> > SegmentMap;
+  typedef base::hash_map<uint64, RecordLocation> EntryTable;
+
+  ~SimpleSegmentStore();
+
+  // Appends a record to the newest segment, starting a segment if it is full,
+  // and sets |out_location|. |lock_| must be held.
+  bool AppendRecordLocked(uint64 entry_hash,
+                          uint32 flags,
+                          const std::string& data,
+                          base::Time last_modified,
+                          RecordLocation* out_location);
+
+  // Starts a new segment, to append the records to. |lock_| must be held.
+  Segment* CreateSegmentLocked();
+
+  // Writes the footer of |segment|, after which no record is appended to it.
+  // |lock_| must be held.
+  void SealSegmentLocked(Segment* segment);
+
+  // Appends a tombstone for the entry at |it|, if it has a record, and
+  // removes it from the table. On failure, keeps the entry, with a new ticket,
+  // and returns false. |lock_| must be held.
+  bool RemoveEntryLocked(EntryTable::iterator it);
+
+  // Accounts for the record at |location| being replaced or removed. |lock_|
+  // must be held.
+  void ReleaseRecordLocked(const RecordLocation& location);
+
+  // Posts a compaction if a sealed segment is less than half live. |lock_|
+  // must be held.
+  void MaybePostCompactionLocked();
+
+  // Moves the live records out of the segments less than half live, on the
+  // worker pool.
+  void CompactSegments();
+  void CompactSegment(uint32 segment_id);
+
+  const base::FilePath directory_;
+  const scoped_refptr<base::TaskRunner> worker_pool_;
+  int64 max_segment_size_;
+  base::Time last_modified_;
+
+  // Guards the members below.
+  base::Lock lock_;
+  SegmentMap segments_;
+  EntryTable entries_;
+  uint32 next_segment_id_;
+  // The segment records are appended to, or 0 if none is started.
+  uint32 active_segment_id_;
+  uint64 next_ticket_;
+  bool compaction_pending_;
+
+  DISALLOW_COPY_AND_ASSIGN(SimpleSegmentStore);
+};
+
+}  // namespace disk_cache
+
+#endif  // NET_DISK_CACHE_SIMPLE_SIMPLE_SEGMENT_STORE_H_
@@ -0,0 +1,237 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <string>
+
+#include "base/files/file.h"
+#include "base/files/file_path.h"
+#include "base/files/scoped_temp_dir.h"
+#include "base/memory/ref_counted.h"
+#include "base/test/test_simple_task_runner.h"
+#include "base/time/time.h"
+#include "net/disk_cache/simple/simple_index.h"
+#include "net/disk_cache/simple/simple_segment_store.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace disk_cache {
+
+namespace {
+
+const base::FilePath::CharType kFirstSegment[] =
+    FILE_PATH_LITERAL("segments/segment_00000001");
+
+class SimpleSegmentStoreTest : public testing::Test {
+ protected:
+  SimpleSegmentStoreTest()
+      : worker_pool_(new base::TestSimpleTaskRunner) {}
+
+  virtual void SetUp() OVERRIDE {
+    ASSERT_TRUE(temp_dir_.CreateUniqueTempDir());
+  }
+
+  // Opens the store of the cache, as a new backend would.
+  scoped_refptr<SimpleSegmentStore> OpenStore() {
+    scoped_refptr<SimpleSegmentStore> store(
+        new SimpleSegmentStore(temp_dir_.path(), worker_pool_));
+    EXPECT_TRUE(store->Init());
+    return store;
+  }
+
+  // Creates the entry for |entry_hash| with |image|.
+  bool WriteEntry(SimpleSegmentStore* store,
+                  uint64 entry_hash,
+                  const std::string& image) {
+    uint64 ticket;
+    return store->CreateEntry(entry_hash, &ticket) &&
+           store->CloseEntry(entry_hash, ticket, image, base::Time::Now());
+  }
+
+  std::string ReadEntry(SimpleSegmentStore* store, uint64 entry_hash) {
+    std::string image;
+    base::Time last_modified;
+    uint64 ticket;
+    if (!store->OpenEntry(entry_hash, &image, &last_modified, &ticket))
+      return "<missing>";
+    return image;
+  }
+
+  base::ScopedTempDir temp_dir_;
+  scoped_refptr<base::TestSimpleTaskRunner> worker_pool_;
+};
+
+TEST_F(SimpleSegmentStoreTest, WriteAndRead) {
+  scoped_refptr<SimpleSegmentStore> store = OpenStore();
+  EXPECT_TRUE(WriteEntry(store.get(), 1, "first image"));
+  EXPECT_TRUE(WriteEntry(store.get(), 2, std::string()));
+  EXPECT_EQ("first image", ReadEntry(store.get(), 1));
+  EXPECT_EQ("", ReadEntry(store.get(), 2));
+  EXPECT_EQ("<missing>", ReadEntry(store.get(), 3));
+
+  // An entry can't be created twice.
+  uint64 ticket;
+  EXPECT_FALSE(store->CreateEntry(1, &ticket));
+
+  store = OpenStore();
+  EXPECT_EQ("first image", ReadEntry(store.get(), 1));
+  EXPECT_EQ("", ReadEntry(store.get(), 2));
+  EXPECT_EQ(1U, store->GetSegmentCountForTesting());
+}
+
+TEST_F(SimpleSegmentStoreTest, RewriteEntry) {
+  scoped_refptr<SimpleSegmentStore> store = OpenStore();
+  EXPECT_TRUE(WriteEntry(store.get(), 1, "first image"));
+
+  std::string image;
+  base::Time last_modified;
+  uint64 ticket;
+  ASSERT_TRUE(store->OpenEntry(1, &image, &last_modified, &ticket));
+  EXPECT_TRUE(store->CloseEntry(1, ticket, "second image", last_modified));
+  EXPECT_EQ("second image", ReadEntry(store.get(), 1));
+
+  store = OpenStore();
+  EXPECT_EQ("second image", ReadEntry(store.get(), 1));
+}
+
+TEST_F(SimpleSegmentStoreTest, DoomEntry) {
+  scoped_refptr<SimpleSegmentStore> store = OpenStore();
+  EXPECT_TRUE(WriteEntry(store.get(), 1, "first image"));
+  EXPECT_TRUE(WriteEntry(store.get(), 2, "second image"));
+  EXPECT_TRUE(store->DoomEntry(1));
+  EXPECT_TRUE(store->DoomEntry(3));
+  EXPECT_EQ("<missing>", ReadEntry(store.get(), 1));
+
+  // The tombstone hides the record of the entry once reopened.
+  store = OpenStore();
+  EXPECT_EQ("<missing>", ReadEntry(store.get(), 1));
+  EXPECT_EQ("second image", ReadEntry(store.get(), 2));
+}
+
+// Tests that an instance of an entry doomed while open doesn't write over the
+// entry created next with its hash.
+TEST_F(SimpleSegmentStoreTest, DoomInvalidatesTicket) {
+  scoped_refptr<SimpleSegmentStore> store = OpenStore();
+  uint64 doomed_ticket;
+  ASSERT_TRUE(store->CreateEntry(1, &doomed_ticket));
+  EXPECT_TRUE(store->IsCurrent(1, doomed_ticket));
+  EXPECT_TRUE(store->DoomEntry(1));
+  EXPECT_FALSE(store->IsCurrent(1, doomed_ticket));
+
+  uint64 ticket;
+  ASSERT_TRUE(store->CreateEntry(1, &ticket));
+  EXPECT_NE(doomed_ticket, ticket);
+  EXPECT_FALSE(
+      store->CloseEntry(1, doomed_ticket, "doomed image", base::Time::Now()));
+  EXPECT_TRUE(store->CloseEntry(1, ticket, "new image", base::Time::Now()));
+  EXPECT_EQ("new image", ReadEntry(store.get(), 1));
+}
+
+// Tests that a record torn by a crash is dropped, and the records before it
+// kept.
+TEST_F(SimpleSegmentStoreTest, TornRecord) {
+  scoped_refptr<SimpleSegmentStore> store = OpenStore();
+  EXPECT_TRUE(WriteEntry(store.get(), 1, "first image"));
+  EXPECT_TRUE(WriteEntry(store.get(), 2, std::string(1000, 'x')));
+  store = NULL;
+
+  const base::FilePath segment_path = temp_dir_.path().Append(kFirstSegment);
+  {
+    base::File segment(segment_path,
+                       base::File::FLAG_OPEN | base::File::FLAG_WRITE |
+                           base::File::FLAG_READ);
+    ASSERT_TRUE(segment.IsValid());
+    ASSERT_TRUE(segment.SetLength(segment.GetLength() - 10));
+  }
+
+  store = OpenStore();
+  EXPECT_EQ("first image", ReadEntry(store.get(), 1));
+  EXPECT_EQ("<missing>", ReadEntry(store.get(), 2));
+
+  // The torn record was truncated, and the records appended next survive.
+  EXPECT_TRUE(WriteEntry(store.get(), 3, "third image"));
+  store = OpenStore();
+  EXPECT_EQ("first image", ReadEntry(store.get(), 1));
+  EXPECT_EQ("third image", ReadEntry(store.get(), 3));
+}
+
+TEST_F(SimpleSegmentStoreTest, Compaction) {
+  const int kEntryCount = 20;
+  const std::string kImage(400, 'x');
+  scoped_refptr<SimpleSegmentStore> store(
+      new SimpleSegmentStore(temp_dir_.path(), worker_pool_));
+  store->set_max_segment_size_for_testing(2048);
+  ASSERT_TRUE(store->Init());
+  for (int i = 0; i < kEntryCount; ++i)
+    EXPECT_TRUE(WriteEntry(store.get(), i, kImage));
+  const size_t segment_count = store->GetSegmentCountForTesting();
+  EXPECT_LT(1U, segment_count);
+
+  // Dooming most entries leaves the older segments mostly dead.
+  for (int i = 0; i < kEntryCount; ++i) {
+    if (i % 4)
+      EXPECT_TRUE(store->DoomEntry(i));
+  }
+  EXPECT_TRUE(worker_pool_->HasPendingTask());
+  worker_pool_->RunUntilIdle();
+  EXPECT_GT(segment_count, store->GetSegmentCountForTesting());
+
+  for (int i = 0; i < kEntryCount; ++i)
+    EXPECT_EQ(i % 4 ? "<missing>" : kImage, ReadEntry(store.get(), i));
+
+  store = OpenStore();
+  for (int i = 0; i < kEntryCount; ++i)
+    EXPECT_EQ(i % 4 ? "<missing>" : kImage, ReadEntry(store.get(), i));
+}
+
+// Tests that compacting a segment drops the tombstones which no longer hide
+// a record, rather than moving them forward every time.
+TEST_F(SimpleSegmentStoreTest, CompactionDropsTombstones) {
+  const int kRounds = 3;
+  const int kEntriesPerRound = 12;
+  const std::string kImage(400, 'x');
+  scoped_refptr<SimpleSegmentStore> store(
+      new SimpleSegmentStore(temp_dir_.path(), worker_pool_));
+  store->set_max_segment_size_for_testing(2048);
+  ASSERT_TRUE(store->Init());
+  // The oldest segment stays live, and is never compacted.
+  for (int i = 0; i < 4; ++i)
+    EXPECT_TRUE(WriteEntry(store.get(), i, kImage));
+
+  for (int round = 1; round <= kRounds; ++round) {
+    const int first_entry = round * 100;
+    for (int i = first_entry; i < first_entry + kEntriesPerRound; ++i)
+      EXPECT_TRUE(WriteEntry(store.get(), i, kImage));
+    for (int i = first_entry; i < first_entry + kEntriesPerRound; ++i)
+      EXPECT_TRUE(store->DoomEntry(i));
+    EXPECT_LE(static_cast<size_t>(kEntriesPerRound),
+              store->GetTombstoneCountForTesting());
+    worker_pool_->RunUntilIdle();
+    EXPECT_GT(static_cast<size_t>(kEntriesPerRound),
+              store->GetTombstoneCountForTesting());
+  }
+
+  store = OpenStore();
+  for (int i = 0; i < 4; ++i)
+    EXPECT_EQ(kImage, ReadEntry(store.get(), i));
+  for (int round = 1; round <= kRounds; ++round)
+    EXPECT_EQ("<missing>", ReadEntry(store.get(), round * 100));
+}
+
+TEST_F(SimpleSegmentStoreTest, RestoreEntries) {
+  scoped_refptr<SimpleSegmentStore> store = OpenStore();
+  EXPECT_TRUE(WriteEntry(store.get(), 1, "first image"));
+  EXPECT_TRUE(WriteEntry(store.get(), 2, "second image"));
+  EXPECT_TRUE(store->DoomEntry(2));
+
+  SimpleIndex::EntrySet entries;
+  SimpleSegmentStore::RestoreEntries(temp_dir_.path(), &entries);
+  ASSERT_EQ(1U, entries.size());
+  ASSERT_EQ(1U, entries.count(1));
+  // The size of the entry includes the header of its record.
+  EXPECT_LT(static_cast<int>(std::string("first image").size()),
+            entries.find(1)->second.GetEntrySize());
+}
+
+}  // namespace
+
+}  // namespace disk_cache
@@ -20,6 +20,7 @@
 #include "net/base/net_errors.h"
 #include "net/disk_cache/simple/simple_backend_version.h"
 #include "net/disk_cache/simple/simple_histogram_macros.h"
+#include "net/disk_cache/simple/simple_segment_store.h"
 #include "net/disk_cache/simple/simple_util.h"
 #include "third_party/zlib/zlib.h"
 
@@ -211,11 +212,12 @@ SimpleSynchronousEntry::EntryOperationData::EntryOperationData(
 void SimpleSynchronousEntry::OpenEntry(
     net::CacheType cache_type,
     const FilePath& path,
+    const scoped_refptr<SimpleSegmentStore>& segment_store,
     const uint64 entry_hash,
     bool had_index,
     SimpleEntryCreationResults *out_results) {
-  SimpleSynchronousEntry* sync_entry =
-      new SimpleSynchronousEntry(cache_type, path, "", entry_hash);
+  SimpleSynchronousEntry* sync_entry = new SimpleSynchronousEntry(
+      cache_type, path, segment_store, "", entry_hash);
   out_results->result =
       sync_entry->InitializeForOpen(had_index,
                                     &out_results->entry_stat,
@@ -235,13 +237,14 @@ void SimpleSynchronousEntry::OpenEntry(
 void SimpleSynchronousEntry::CreateEntry(
     net::CacheType cache_type,
     const FilePath& path,
+    const scoped_refptr<SimpleSegmentStore>& segment_store,
     const std::string& key,
     const uint64 entry_hash,
     bool had_index,
     SimpleEntryCreationResults *out_results) {
   DCHECK_EQ(entry_hash, GetEntryHashKey(key));
-  SimpleSynchronousEntry* sync_entry =
-      new SimpleSynchronousEntry(cache_type, path, key, entry_hash);
+  SimpleSynchronousEntry* sync_entry = new SimpleSynchronousEntry(
+      cache_type, path, segment_store, key, entry_hash);
   out_results->result = sync_entry->InitializeForCreate(
       had_index, &out_results->entry_stat);
   if (out_results->result != net::OK) {
@@ -257,18 +260,24 @@ void SimpleSynchronousEntry::CreateEntry(
 // static
 int SimpleSynchronousEntry::DoomEntry(
     const FilePath& path,
+    const scoped_refptr<SimpleSegmentStore>& segment_store,
     uint64 entry_hash) {
-  const bool deleted_well = DeleteFilesForEntryHash(path, entry_hash);
+  const bool deleted_well =
+      DeleteEntry(path, segment_store.get(), entry_hash);
   return deleted_well ? net::OK : net::ERR_FAILED;
 }
 
 // static
 int SimpleSynchronousEntry::DoomEntrySet(
     const std::vector<uint64>* key_hashes,
-    const FilePath& path) {
-  const size_t did_delete_count = std::count_if(
-      key_hashes->begin(), key_hashes->end(), std::bind1st(
-          std::ptr_fun(SimpleSynchronousEntry::DeleteFilesForEntryHash), path));
+    const FilePath& path,
+    const scoped_refptr<SimpleSegmentStore>& segment_store) {
+  size_t did_delete_count = 0;
+  for (std::vector<uint64>::const_iterator it = key_hashes->begin();
+       it != key_hashes->end(); ++it) {
+    if (DeleteEntry(path, segment_store.get(), *it))
+      ++did_delete_count;
+  }
   return (did_delete_count == key_hashes->size()) ? net::OK : net::ERR_FAILED;
 }
 
@@ -286,7 +295,7 @@ void SimpleSynchronousEntry::ReadData(const EntryOperationData& in_entry_op,
   // be handled in the SimpleEntryImpl.
   DCHECK_LT(0, in_entry_op.buf_len);
   DCHECK(!empty_file_omitted_[file_index]);
-  File* file = const_cast<File*>(&files_[file_index]);
+  SimpleEntryFile* file = const_cast<SimpleEntryFile*>(&files_[file_index]);
   int bytes_read =
       file->Read(file_offset, out_buf->data(), in_entry_op.buf_len);
   if (bytes_read > 0) {
@@ -346,6 +355,17 @@ void SimpleSynchronousEntry::WriteData(const EntryOperationData& in_entry_op,
   }
   DCHECK(!empty_file_omitted_[file_index]);
 
+  // A packed file outgrowing the store gets a file of its own. A doomed entry
+  // only keeps it in memory until it is closed.
+  if (files_[file_index].in_memory() && !doomed &&
+      file_offset + buf_len > SimpleSegmentStore::kMaxImageSize &&
+      !MoveFileOutOfStore()) {
+    RecordWriteResult(cache_type_, WRITE_RESULT_WRITE_FAILURE);
+    Doom();
+    *out_result = net::ERR_CACHE_WRITE_FAILURE;
+    return;
+  }
+
   if (extending_by_write) {
     // The EOF record and the eventual stream afterward need to be zeroed out.
     const int64 file_eof_offset =
@@ -668,11 +688,30 @@ void SimpleSynchronousEntry::Close(
       break;
     }
   }
+  if (files_[0].in_memory() && files_[0].image_modified()) {
+    // Writing fails if the entry was doomed since it was opened.
+    bool written;
+    if (files_[0].image().size() <=
+        static_cast<size_t>(SimpleSegmentStore::kMaxImageSize)) {
+      written = segment_store_->CloseEntry(entry_hash_, segment_ticket_,
+                                           files_[0].image(),
+                                           entry_stat.last_modified());
+    } else {
+      written = segment_store_->IsCurrent(entry_hash_, segment_ticket_) &&
+                MoveFileOutOfStore();
+    }
+    if (!written)
+      DVLOG(1) << "Could not write the packed file of the entry.";
+  }
+
   for (int i = 0; i < kSimpleEntryFileCount; ++i) {
     if (empty_file_omitted_[i])
       continue;
 
+    const bool in_memory = files_[i].in_memory();
     files_[i].Close();
+    if (in_memory)
+      continue;
     const int64 file_size = entry_stat.GetFileSize(key_, i);
     SIMPLE_CACHE_UMA(CUSTOM_COUNTS,
                      "LastClusterSize", cache_type_,
@@ -696,16 +735,20 @@ void SimpleSynchronousEntry::Close(
   delete this;
 }
 
-SimpleSynchronousEntry::SimpleSynchronousEntry(net::CacheType cache_type,
-                                               const FilePath& path,
-                                               const std::string& key,
-                                               const uint64 entry_hash)
+SimpleSynchronousEntry::SimpleSynchronousEntry(
+    net::CacheType cache_type,
+    const FilePath& path,
+    const scoped_refptr<SimpleSegmentStore>& segment_store,
+    const std::string& key,
+    const uint64 entry_hash)
     : cache_type_(cache_type),
       path_(path),
+      segment_store_(segment_store),
       entry_hash_(entry_hash),
       key_(key),
       have_open_files_(false),
-      initialized_(false) {
+      initialized_(false),
+      segment_ticket_(0) {
   for (int i = 0; i < kSimpleEntryFileCount; ++i)
     empty_file_omitted_[i] = false;
 }
@@ -721,6 +764,11 @@ bool SimpleSynchronousEntry::MaybeOpenFile(
     File::Error* out_error) {
   DCHECK(out_error);
 
+  if (file_index == 0 && OpenPackedFile()) {
+    *out_error = File::FILE_OK;
+    return true;
+  }
+
   FilePath filename = GetFilenameFromFileIndex(file_index);
   int flags = File::FLAG_OPEN | File::FLAG_READ | File::FLAG_WRITE;
   files_[file_index].Initialize(filename, flags);
@@ -746,6 +794,11 @@ bool SimpleSynchronousEntry::MaybeCreateFile(
     return true;
   }
 
+  if (file_index == 0 && segment_store_.get()) {
+    empty_file_omitted_[file_index] = false;
+    return CreatePackedFile(out_error);
+  }
+
   FilePath filename = GetFilenameFromFileIndex(file_index);
   int flags = File::FLAG_CREATE | File::FLAG_READ | File::FLAG_WRITE;
   files_[file_index].Initialize(filename, flags);
@@ -756,6 +809,39 @@ bool SimpleSynchronousEntry::MaybeCreateFile(
   return files_[file_index].IsValid();
 }
 
+bool SimpleSynchronousEntry::OpenPackedFile() {
+  std::string image;
+  base::Time last_modified;
+  if (!segment_store_.get() ||
+      !segment_store_->OpenEntry(entry_hash_, &image, &last_modified,
+                                 &segment_ticket_)) {
+    return false;
+  }
+  files_[0].InitializeInMemory(image, last_modified);
+  return true;
+}
+
+bool SimpleSynchronousEntry::CreatePackedFile(File::Error* out_error) {
+  DCHECK(segment_store_.get());
+  // The entry may have grown out of the store before.
+  if (base::PathExists(GetFilenameFromFileIndex(0)) ||
+      !segment_store_->CreateEntry(entry_hash_, &segment_ticket_)) {
+    *out_error = File::FILE_ERROR_EXISTS;
+    return false;
+  }
+  files_[0].InitializeInMemory(std::string(), base::Time::Now());
+  *out_error = File::FILE_OK;
+  return true;
+}
+
+bool SimpleSynchronousEntry::MoveFileOutOfStore() {
+  DCHECK(files_[0].in_memory());
+  if (!files_[0].MoveToFile(GetFilenameFromFileIndex(0)))
+    return false;
+  segment_store_->DoomEntry(entry_hash_);
+  return true;
+}
+
 bool SimpleSynchronousEntry::OpenFiles(
     bool had_index,
     SimpleEntryStat* out_entry_stat) {
@@ -1075,7 +1161,7 @@ int SimpleSynchronousEntry::ReadAndValidateStream0(
   *stream_0_data = new net::GrowableIOBuffer();
   (*stream_0_data)->SetCapacity(stream_0_size);
   int file_offset = out_entry_stat->GetOffsetInFile(key_, 0, 0);
-  File* file = const_cast<File*>(&files_[0]);
+  SimpleEntryFile* file = const_cast<SimpleEntryFile*>(&files_[0]);
   int bytes_read =
       file->Read(file_offset, (*stream_0_data)->data(), stream_0_size);
   if (bytes_read != stream_0_size)
@@ -1106,7 +1192,7 @@ int SimpleSynchronousEntry::GetEOFRecordData(int index,
   SimpleFileEOF eof_record;
   int file_offset = entry_stat.GetEOFOffsetInFile(key_, index);
   int file_index = GetFileIndexFromStreamIndex(index);
-  File* file = const_cast<File*>(&files_[file_index]);
+  SimpleEntryFile* file = const_cast<SimpleEntryFile*>(&files_[file_index]);
   if (file->Read(file_offset, reinterpret_cast<char*>(&eof_record),
                  sizeof(eof_record)) !=
       sizeof(eof_record)) {
@@ -1129,7 +1215,7 @@ int SimpleSynchronousEntry::GetEOFRecordData(int index,
 }
 
 void SimpleSynchronousEntry::Doom() const {
-  DeleteFilesForEntryHash(path_, entry_hash_);
+  DeleteEntry(path_, segment_store_.get(), entry_hash_);
 }
 
 // static
@@ -1157,6 +1243,16 @@ bool SimpleSynchronousEntry::DeleteFilesForEntryHash(
   return result;
 }
 
+// static
+bool SimpleSynchronousEntry::DeleteEntry(const FilePath& path,
+                                         SimpleSegmentStore* segment_store,
+                                         uint64 entry_hash) {
+  bool result = DeleteFilesForEntryHash(path, entry_hash);
+  if (segment_store && !segment_store->DoomEntry(entry_hash))
+    result = false;
+  return result;
+}
+
 void SimpleSynchronousEntry::RecordSyncCreateResult(CreateEntryResult result,
                                                     bool had_index) {
   DCHECK_GT(CREATE_ENTRY_MAX, result);
@@ -18,6 +18,7 @@
 #include "base/time/time.h"
 #include "net/base/cache_type.h"
 #include "net/base/net_export.h"
+#include "net/disk_cache/simple/simple_entry_file.h"
 #include "net/disk_cache/simple/simple_entry_format.h"
 
 namespace net {
@@ -27,6 +28,7 @@ class IOBuffer;
 
 namespace disk_cache {
 
+class SimpleSegmentStore;
 class SimpleSynchronousEntry;
 
 // This class handles the passing of data about the entry between
@@ -112,30 +114,37 @@ class SimpleSynchronousEntry {
     bool doomed;
   };
 
+  // |segment_store| is NULL unless the small entries are packed in segments.
   static void OpenEntry(net::CacheType cache_type,
                         const base::FilePath& path,
+                        const scoped_refptr<SimpleSegmentStore>& segment_store,
                         uint64 entry_hash,
                         bool had_index,
                         SimpleEntryCreationResults* out_results);
 
-  static void CreateEntry(net::CacheType cache_type,
-                          const base::FilePath& path,
-                          const std::string& key,
-                          uint64 entry_hash,
-                          bool had_index,
-                          SimpleEntryCreationResults* out_results);
+  static void CreateEntry(
+      net::CacheType cache_type,
+      const base::FilePath& path,
+      const scoped_refptr<SimpleSegmentStore>& segment_store,
+      const std::string& key,
+      uint64 entry_hash,
+      bool had_index,
+      SimpleEntryCreationResults* out_results);
 
   // Deletes an entry from the file system without affecting the state of the
   // corresponding instance, if any (allowing operations to continue to be
   // executed through that instance). Returns a net error code.
   static int DoomEntry(const base::FilePath& path,
+                       const scoped_refptr<SimpleSegmentStore>& segment_store,
                        uint64 entry_hash);
 
   // Like |DoomEntry()| above. Deletes all entries corresponding to the
   // |key_hashes|. Succeeds only when all entries are deleted. Returns a net
   // error code.
-  static int DoomEntrySet(const std::vector<uint64>* key_hashes,
-                          const base::FilePath& path);
+  static int DoomEntrySet(
+      const std::vector<uint64>* key_hashes,
+      const base::FilePath& path,
+      const scoped_refptr<SimpleSegmentStore>& segment_store);
 
   // N.B. ReadData(), WriteData(), CheckEOFRecord() and Close() may block on IO.
   void ReadData(const EntryOperationData& in_entry_op,
@@ -202,6 +211,7 @@ class SimpleSynchronousEntry {
   SimpleSynchronousEntry(
       net::CacheType cache_type,
       const base::FilePath& path,
+      const scoped_refptr<SimpleSegmentStore>& segment_store,
       const std::string& key,
       uint64 entry_hash);
 
@@ -220,6 +230,15 @@ class SimpleSynchronousEntry {
   bool MaybeCreateFile(int file_index,
                        FileRequired file_required,
                        base::File::Error* out_error);
+  // Reads the file 0 of an entry packed in |segment_store_| to memory.
+  // Returns false if the entry isn't packed.
+  bool OpenPackedFile();
+  // Packs the file 0 of a new entry in |segment_store_|. Returns false, and
+  // sets |*out_error|, if the entry exists.
+  bool CreatePackedFile(base::File::Error* out_error);
+  // Moves the file 0 of an entry grown too large to be packed to its own file.
+  bool MoveFileOutOfStore();
+
   bool OpenFiles(bool had_index,
                  SimpleEntryStat* out_entry_stat);
   bool CreateFiles(bool had_index,
@@ -299,6 +318,11 @@ class SimpleSynchronousEntry {
                                      int file_index);
   static bool DeleteFilesForEntryHash(const base::FilePath& path,
                                       uint64 entry_hash);
+  // Deletes the files of the entry, and its record in |segment_store|, if
+  // not NULL.
+  static bool DeleteEntry(const base::FilePath& path,
+                          SimpleSegmentStore* segment_store,
+                          uint64 entry_hash);
 
   void RecordSyncCreateResult(CreateEntryResult result, bool had_index);
 
@@ -310,13 +334,17 @@ class SimpleSynchronousEntry {
 
   const net::CacheType cache_type_;
   const base::FilePath path_;
+  const scoped_refptr<SimpleSegmentStore> segment_store_;
   const uint64 entry_hash_;
   std::string key_;
 
   bool have_open_files_;
   bool initialized_;
 
-  base::File files_[kSimpleEntryFileCount];
+  SimpleEntryFile files_[kSimpleEntryFileCount];
+
+  // The ticket from |segment_store_| when the file 0 is packed in it.
+  uint64 segment_ticket_;
 
   // True if the corresponding stream is empty and therefore no on-disk file
   // was created to store it.
@@ -0,0 +1,288 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/disk_cache/tiered/tiered_backend.h"
+
+#include "base/bind.h"
+#include "base/hash.h"
+#include "base/logging.h"
+#include "base/metrics/histogram.h"
+#include "base/strings/string_number_conversions.h"
+#include "net/base/io_buffer.h"
+#include "net/base/net_errors.h"
+#include "net/disk_cache/memory/mem_backend_impl.h"
+#include "net/disk_cache/tiered/tiered_entry.h"
+
+namespace {
+
+// Used in histograms, please only add entries at the end.
+enum OpenResult {
+  OPEN_RESULT_MEMORY_HIT = 0,
+  OPEN_RESULT_DISK_HIT = 1,
+  OPEN_RESULT_MISS = 2,
+  OPEN_RESULT_MAX = 3,
+};
+
+void RecordOpenResult(OpenResult result) {
+  UMA_HISTOGRAM_ENUMERATION("DiskCache.Tiered.OpenResult", result,
+                            OPEN_RESULT_MAX);
+}
+
+}  // namespace
+
+namespace disk_cache {
+
+class TieredBackend::TieredIterator : public Backend::Iterator {
+ public:
+  TieredIterator(const base::WeakPtr<TieredBackend>& backend,
+                 scoped_ptr<Backend::Iterator> disk_iterator)
+      : backend_(backend),
+        disk_iterator_(disk_iterator.Pass()),
+        weak_factory_(this) {
+  }
+
+  virtual int OpenNextEntry(Entry** next_entry,
+                            const CompletionCallback& callback) OVERRIDE {
+    int rv = disk_iterator_->OpenNextEntry(
+        next_entry,
+        base::Bind(&TieredIterator::OnNextEntryOpened,
+                   weak_factory_.GetWeakPtr(), next_entry, callback));
+    if (rv == net::ERR_IO_PENDING)
+      return rv;
+    return WrapNextEntry(next_entry, rv);
+  }
+
+ private:
+  void OnNextEntryOpened(Entry** next_entry,
+                         const CompletionCallback& callback,
+                         int result) {
+    callback.Run(WrapNextEntry(next_entry, result));
+  }
+
+  int WrapNextEntry(Entry** next_entry, int result) {
+    if (result == net::OK) {
+      *next_entry =
+          new TieredEntry(backend_, (*next_entry)->GetKey(), NULL, *next_entry);
+    }
+    return result;
+  }
+
+  base::WeakPtr<TieredBackend> backend_;
+  scoped_ptr<Backend::Iterator> disk_iterator_;
+  base::WeakPtrFactory<TieredIterator> weak_factory_;
+
+  DISALLOW_COPY_AND_ASSIGN(TieredIterator);
+};
+
+TieredBackend::TieredBackend(scoped_ptr<Backend> disk_backend,
+                             scoped_ptr<Backend> memory_backend)
+    : disk_backend_(disk_backend.Pass()),
+      memory_backend_(memory_backend.Pass()),
+      max_entry_size_(kDefaultMaxEntrySize),
+      open_counts_(kOpenHistorySize),
+      memory_hit_count_(0),
+      disk_hit_count_(0),
+      promotion_count_(0),
+      weak_factory_(this) {
+  DCHECK(disk_backend_);
+  DCHECK(memory_backend_);
+}
+
+TieredBackend::~TieredBackend() {
+}
+
+// static
+scoped_ptr<Backend> TieredBackend::CreateBackend(
+    scoped_ptr<Backend> disk_backend,
+    int memory_bytes,
+    net::NetLog* net_log) {
+  scoped_ptr<Backend> memory_backend =
+      MemBackendImpl::CreateBackend(memory_bytes, net_log);
+  if (!memory_backend) {
+    LOG(ERROR) << "Unable to create the memory tier";
+    return disk_backend.Pass();
+  }
+  return scoped_ptr<Backend>(
+      new TieredBackend(disk_backend.Pass(), memory_backend.Pass()));
+}
+
+Entry* TieredBackend::PromoteEntry(const std::string& key,
+                                   const std::vector<std::string>& data) {
+  Entry* entry = NULL;
+  if (memory_backend_->CreateEntry(key, &entry, CompletionCallback()) !=
+      net::OK) {
+    return NULL;
+  }
+
+  int size = 0;
+  for (size_t i = 0; i < data.size(); ++i) {
+    if (data[i].empty())
+      continue;
+    scoped_refptr<net::StringIOBuffer> buffer(
+        new net::StringIOBuffer(data[i]));
+    if (entry->WriteData(i, 0, buffer.get(), buffer->size(),
+                         CompletionCallback(), true) != buffer->size()) {
+      entry->Doom();
+      entry->Close();
+      return NULL;
+    }
+    size += buffer->size();
+  }
+
+  ++promotion_count_;
+  UMA_HISTOGRAM_COUNTS("DiskCache.Tiered.PromotedEntrySize", size);
+  return entry;
+}
+
+void TieredBackend::DoomMemoryEntry(const std::string& key) {
+  memory_backend_->DoomEntry(key, CompletionCallback());
+}
+
+net::CacheType TieredBackend::GetCacheType() const {
+  return disk_backend_->GetCacheType();
+}
+
+int32 TieredBackend::GetEntryCount() const {
+  return disk_backend_->GetEntryCount();
+}
+
+int TieredBackend::OpenEntry(const std::string& key,
+                             Entry** entry,
+                             const CompletionCallback& callback) {
+  Entry* memory_entry = NULL;
+  if (memory_backend_->OpenEntry(key, &memory_entry, CompletionCallback()) ==
+      net::OK) {
+    ++memory_hit_count_;
+    RecordOpenResult(OPEN_RESULT_MEMORY_HIT);
+    // The disk tier doesn't see this use, but it keeps the times that
+    // eviction and DoomEntriesSince() go by.
+    disk_backend_->OnExternalCacheHit(key);
+    *entry =
+        new TieredEntry(weak_factory_.GetWeakPtr(), key, memory_entry, NULL);
+    return net::OK;
+  }
+
+  int rv = disk_backend_->OpenEntry(
+      key, entry,
+      base::Bind(&TieredBackend::OnDiskEntryOpened,
+                 weak_factory_.GetWeakPtr(), key, entry, true, callback));
+  if (rv == net::ERR_IO_PENDING)
+    return rv;
+  return FinishDiskOpen(key, entry, true, rv);
+}
+
+int TieredBackend::CreateEntry(const std::string& key,
+                               Entry** entry,
+                               const CompletionCallback& callback) {
+  // The memory tier may have outlived an entry evicted from the disk tier.
+  DoomMemoryEntry(key);
+
+  int rv = disk_backend_->CreateEntry(
+      key, entry,
+      base::Bind(&TieredBackend::OnDiskEntryOpened,
+                 weak_factory_.GetWeakPtr(), key, entry, false, callback));
+  if (rv == net::ERR_IO_PENDING)
+    return rv;
+  return FinishDiskOpen(key, entry, false, rv);
+}
+
+int TieredBackend::DoomEntry(const std::string& key,
+                             const CompletionCallback& callback) {
+  DoomMemoryEntry(key);
+  return disk_backend_->DoomEntry(key, callback);
+}
+
+int TieredBackend::DoomAllEntries(const CompletionCallback& callback) {
+  memory_backend_->DoomAllEntries(CompletionCallback());
+  return disk_backend_->DoomAllEntries(callback);
+}
+
+int TieredBackend::DoomEntriesBetween(base::Time initial_time,
+                                      base::Time end_time,
+                                      const CompletionCallback& callback) {
+  // The times of the memory tier are those of the copies, so it is emptied.
+  memory_backend_->DoomAllEntries(CompletionCallback());
+  return disk_backend_->DoomEntriesBetween(initial_time, end_time, callback);
+}
+
+int TieredBackend::DoomEntriesSince(base::Time initial_time,
+                                    const CompletionCallback& callback) {
+  memory_backend_->DoomAllEntries(CompletionCallback());
+  return disk_backend_->DoomEntriesSince(initial_time, callback);
+}
+
+scoped_ptr<Backend::Iterator> TieredBackend::CreateIterator() {
+  return scoped_ptr<Backend::Iterator>(new TieredIterator(
+      weak_factory_.GetWeakPtr(), disk_backend_->CreateIterator()));
+}
+
+void TieredBackend::GetStats(
+    std::vector<std::pair<std::string, std::string> >* stats) {
+  disk_backend_->GetStats(stats);
+
+  std::pair<std::string, std::string> item;
+  item.first = "Memory tier entries";
+  item.second = base::IntToString(memory_backend_->GetEntryCount());
+  stats->push_back(item);
+  item.first = "Memory tier hits";
+  item.second = base::IntToString(memory_hit_count_);
+  stats->push_back(item);
+  item.first = "Disk tier hits";
+  item.second = base::IntToString(disk_hit_count_);
+  stats->push_back(item);
+  item.first = "Promotions";
+  item.second = base::IntToString(promotion_count_);
+  stats->push_back(item);
+}
+
+void TieredBackend::OnExternalCacheHit(const std::string& key) {
+  memory_backend_->OnExternalCacheHit(key);
+  disk_backend_->OnExternalCacheHit(key);
+}
+
+bool TieredBackend::ShouldPromote(const std::string& key, Entry* disk_entry) {
+  const uint32 hash = base::Hash(key);
+  base::HashingMRUCache<uint32, int>::iterator it = open_counts_.Get(hash);
+  if (it == open_counts_.end())
+    it = open_counts_.Put(hash, 0);
+  if (++it->second < kAdmissionOpenCount || disk_entry->CouldBeSparse())
+    return false;
+
+  int64 size = 0;
+  for (int i = 0; i < TieredEntry::kStreamCount; ++i)
+    size += disk_entry->GetDataSize(i);
+  return size <= max_entry_size_;
+}
+
+void TieredBackend::OnDiskEntryOpened(const std::string& key,
+                                      Entry** entry,
+                                      bool opened,
+                                      const CompletionCallback& callback,
+                                      int result) {
+  callback.Run(FinishDiskOpen(key, entry, opened, result));
+}
+
+int TieredBackend::FinishDiskOpen(const std::string& key,
+                                  Entry** entry,
+                                  bool opened,
+                                  int result) {
+  if (result != net::OK) {
+    if (opened)
+      RecordOpenResult(OPEN_RESULT_MISS);
+    return result;
+  }
+
+  TieredEntry* tiered_entry =
+      new TieredEntry(weak_factory_.GetWeakPtr(), key, NULL, *entry);
+  if (opened) {
+    ++disk_hit_count_;
+    RecordOpenResult(OPEN_RESULT_DISK_HIT);
+    if (ShouldPromote(key, *entry))
+      tiered_entry->Promote();
+  }
+  *entry = tiered_entry;
+  return net::OK;
+}
+
+}  // namespace disk_cache
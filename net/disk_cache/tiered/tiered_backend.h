@@ -0,0 +1,141 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// See net/disk_cache/disk_cache.h for the public interface of the cache.
+
+#ifndef NET_DISK_CACHE_TIERED_TIERED_BACKEND_H_
+#define NET_DISK_CACHE_TIERED_TIERED_BACKEND_H_
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "base/compiler_specific.h"
+#include "base/containers/mru_cache.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/memory/weak_ptr.h"
+#include "net/base/net_export.h"
+#include "net/disk_cache/disk_cache.h"
+
+namespace net {
+class NetLog;
+}  // namespace net
+
+namespace disk_cache {
+
+// This class implements the Backend interface on top of another backend, the
+// disk tier, and keeps copies of its hot small entries in a memory backend,
+// the memory tier.
+//
+// The disk tier holds every entry, and every write goes to it. An entry is
+// copied to the memory tier, from which it is then opened and read without
+// touching the disk, when it is opened for the kAdmissionOpenCount-th time
+// among the last kOpenHistorySize opened entries, if it isn't sparse and its
+// streams hold at most max_entry_size() bytes. Writes are applied to the
+// memory copy as well, and drop it once it grows past max_entry_size(). The
+// memory tier evicts its least recently used entries on its own.
+class NET_EXPORT_PRIVATE TieredBackend : public Backend {
+ public:
+  // The default for max_entry_size().
+  static const int kDefaultMaxEntrySize = 64 * 1024;
+
+  // The number of opens that admit an entry to the memory tier.
+  static const int kAdmissionOpenCount = 2;
+
+  // The number of entries whose opens are counted.
+  static const size_t kOpenHistorySize = 10000;
+
+  // |memory_backend| is the memory tier, and should not be used by anyone
+  // else.
+  TieredBackend(scoped_ptr<Backend> disk_backend,
+                scoped_ptr<Backend> memory_backend);
+  virtual ~TieredBackend();
+
+  // Returns |disk_backend| behind a memory tier of |memory_bytes|, as given to
+  // MemBackendImpl::CreateBackend(). Returns |disk_backend| as is if the
+  // memory tier can't be created.
+  static scoped_ptr<Backend> CreateBackend(scoped_ptr<Backend> disk_backend,
+                                           int memory_bytes,
+                                           net::NetLog* net_log);
+
+  int max_entry_size() const { return max_entry_size_; }
+  void set_max_entry_size(int max_entry_size) {
+    max_entry_size_ = max_entry_size;
+  }
+
+  int memory_hit_count() const { return memory_hit_count_; }
+  int disk_hit_count() const { return disk_hit_count_; }
+  int promotion_count() const { return promotion_count_; }
+
+  Backend* disk_backend() { return disk_backend_.get(); }
+  Backend* memory_backend() { return memory_backend_.get(); }
+
+  // Copies the streams of |data|, of the entry |key| just read from the disk
+  // tier, to a new entry of the memory tier and returns it. Returns NULL if
+  // the entry can't be created.
+  Entry* PromoteEntry(const std::string& key,
+                      const std::vector<std::string>& data);
+
+  // Dooms the copy of the entry |key| in the memory tier, if any.
+  void DoomMemoryEntry(const std::string& key);
+
+  // Backend interface.
+  virtual net::CacheType GetCacheType() const OVERRIDE;
+  virtual int32 GetEntryCount() const OVERRIDE;
+  virtual int OpenEntry(const std::string& key, Entry** entry,
+                        const CompletionCallback& callback) OVERRIDE;
+  virtual int CreateEntry(const std::string& key, Entry** entry,
+                          const CompletionCallback& callback) OVERRIDE;
+  virtual int DoomEntry(const std::string& key,
+                        const CompletionCallback& callback) OVERRIDE;
+  virtual int DoomAllEntries(const CompletionCallback& callback) OVERRIDE;
+  virtual int DoomEntriesBetween(base::Time initial_time,
+                                 base::Time end_time,
+                                 const CompletionCallback& callback) OVERRIDE;
+  virtual int DoomEntriesSince(base::Time initial_time,
+                               const CompletionCallback& callback) OVERRIDE;
+  virtual scoped_ptr<Iterator> CreateIterator() OVERRIDE;
+  virtual void GetStats(
+      std::vector<std::pair<std::string, std::string> >* stats) OVERRIDE;
+  virtual void OnExternalCacheHit(const std::string& key) OVERRIDE;
+
+ private:
+  class TieredIterator;
+
+  // Counts an open of the entry |key|, and returns true if |disk_entry|
+  // should be copied to the memory tier.
+  bool ShouldPromote(const std::string& key, Entry* disk_entry);
+
+  // Wraps |*entry|, just opened, or created if not |opened|, on the disk tier
+  // in a TieredEntry.
+  void OnDiskEntryOpened(const std::string& key,
+                         Entry** entry,
+                         bool opened,
+                         const CompletionCallback& callback,
+                         int result);
+  int FinishDiskOpen(const std::string& key,
+                     Entry** entry,
+                     bool opened,
+                     int result);
+
+  scoped_ptr<Backend> disk_backend_;
+  scoped_ptr<Backend> memory_backend_;
+  int max_entry_size_;
+
+  // The number of opens of recently opened entries, by key hash.
+  base::HashingMRUCache<uint32, int> open_counts_;
+
+  int memory_hit_count_;
+  int disk_hit_count_;
+  int promotion_count_;
+
+  base::WeakPtrFactory<TieredBackend> weak_factory_;
+
+  DISALLOW_COPY_AND_ASSIGN(TieredBackend);
+};
+
+}  // namespace disk_cache
+
+#endif  // NET_DISK_CACHE_TIERED_TIERED_BACKEND_H_
@@ -0,0 +1,263 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/disk_cache/tiered/tiered_backend.h"
+
+#include <string>
+
+#include "base/basictypes.h"
+#include "base/run_loop.h"
+#include "base/time/time.h"
+#include "net/base/io_buffer.h"
+#include "net/base/net_errors.h"
+#include "net/disk_cache/disk_cache_test_base.h"
+#include "net/disk_cache/memory/mem_backend_impl.h"
+#include "net/disk_cache/simple/simple_backend_impl.h"
+#include "net/disk_cache/tiered/tiered_entry.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace {
+
+const int kMemoryTierSize = 1024 * 1024;
+
+}  // namespace
+
+class DiskCacheTieredBackendTest : public DiskCacheTestWithCache {
+ protected:
+  DiskCacheTieredBackendTest() : tiered_backend_(NULL) {}
+
+  // Puts a memory tier in front of the cache.
+  void InitTieredCache() {
+    InitCache();
+    tiered_backend_ = new disk_cache::TieredBackend(
+        cache_.Pass(), disk_cache::MemBackendImpl::CreateBackend(
+                           kMemoryTierSize, NULL));
+    cache_.reset(tiered_backend_);
+  }
+
+  // Lets the reads of a promotion finish.
+  void WaitForPromotion() {
+    base::RunLoop().RunUntilIdle();
+    disk_cache::SimpleBackendImpl::FlushWorkerPoolForTesting();
+    base::RunLoop().RunUntilIdle();
+  }
+
+  void CreateTestEntry(const std::string& key,
+                       const std::string& data0,
+                       const std::string& data1) {
+    disk_cache::Entry* entry = NULL;
+    ASSERT_EQ(net::OK, CreateEntry(key, &entry));
+    Write(entry, 0, data0);
+    Write(entry, 1, data1);
+    entry->Close();
+  }
+
+  // Opens |key| |count| times, closing it every time.
+  void OpenTimes(const std::string& key, int count) {
+    for (int i = 0; i < count; ++i) {
+      disk_cache::Entry* entry = NULL;
+      ASSERT_EQ(net::OK, OpenEntry(key, &entry));
+      WaitForPromotion();
+      entry->Close();
+    }
+  }
+
+  void Write(disk_cache::Entry* entry, int index, const std::string& data) {
+    scoped_refptr<net::StringIOBuffer> buffer(new net::StringIOBuffer(data));
+    EXPECT_EQ(buffer->size(),
+              WriteData(entry, index, 0, buffer.get(), buffer->size(), true));
+  }
+
+  std::string Read(disk_cache::Entry* entry, int index) {
+    const int size = entry->GetDataSize(index);
+    if (size == 0)
+      return std::string();
+    scoped_refptr<net::IOBuffer> buffer(new net::IOBuffer(size));
+    EXPECT_EQ(size, ReadData(entry, index, 0, buffer.get(), size));
+    return std::string(buffer->data(), size);
+  }
+
+  bool IsInMemoryTier(const std::string& key) {
+    disk_cache::Entry* entry = NULL;
+    if (tiered_backend_->memory_backend()->OpenEntry(
+            key, &entry, net::CompletionCallback()) != net::OK) {
+      return false;
+    }
+    entry->Close();
+    return true;
+  }
+
+  void Promotion();
+
+  disk_cache::TieredBackend* tiered_backend_;
+};
+
+void DiskCacheTieredBackendTest::Promotion() {
+  InitTieredCache();
+  CreateTestEntry("the key", "headers", "body");
+  EXPECT_FALSE(IsInMemoryTier("the key"));
+
+  // The entry is admitted by its second open.
+  OpenTimes("the key", 1);
+  EXPECT_FALSE(IsInMemoryTier("the key"));
+  EXPECT_EQ(0, tiered_backend_->promotion_count());
+  OpenTimes("the key", 1);
+  EXPECT_TRUE(IsInMemoryTier("the key"));
+  EXPECT_EQ(1, tiered_backend_->promotion_count());
+  EXPECT_EQ(2, tiered_backend_->disk_hit_count());
+
+  disk_cache::Entry* entry = NULL;
+  ASSERT_EQ(net::OK, OpenEntry("the key", &entry));
+  EXPECT_EQ(1, tiered_backend_->memory_hit_count());
+  EXPECT_TRUE(static_cast<disk_cache::TieredEntry*>(entry)
+                  ->HasMemoryEntryForTesting());
+  EXPECT_EQ("headers", Read(entry, 0));
+  EXPECT_EQ("body", Read(entry, 1));
+  EXPECT_EQ(0, entry->GetDataSize(2));
+  entry->Close();
+}
+
+TEST_F(DiskCacheTieredBackendTest, MemoryOnlyPromotion) {
+  SetMemoryOnlyMode();
+  Promotion();
+}
+
+TEST_F(DiskCacheTieredBackendTest, SimpleCachePromotion) {
+  SetSimpleCacheMode();
+  Promotion();
+}
+
+TEST_F(DiskCacheTieredBackendTest, LargeEntryNotPromoted) {
+  SetMemoryOnlyMode();
+  InitTieredCache();
+  tiered_backend_->set_max_entry_size(10);
+  CreateTestEntry("the key", "headers", "a body too large");
+  OpenTimes("the key", 3);
+  EXPECT_FALSE(IsInMemoryTier("the key"));
+  EXPECT_EQ(0, tiered_backend_->promotion_count());
+}
+
+// Tests that writes to an entry opened from the memory tier reach both tiers.
+TEST_F(DiskCacheTieredBackendTest, WriteToMemoryHit) {
+  SetMemoryOnlyMode();
+  InitTieredCache();
+  CreateTestEntry("the key", "headers", "body");
+  OpenTimes("the key", 2);
+  ASSERT_TRUE(IsInMemoryTier("the key"));
+
+  disk_cache::Entry* entry = NULL;
+  ASSERT_EQ(net::OK, OpenEntry("the key", &entry));
+  Write(entry, 1, "new body");
+  EXPECT_EQ("new body", Read(entry, 1));
+  entry->Close();
+  EXPECT_TRUE(IsInMemoryTier("the key"));
+
+  ASSERT_EQ(net::OK, tiered_backend_->disk_backend()->OpenEntry(
+      "the key", &entry, net::CompletionCallback()));
+  EXPECT_EQ("new body", Read(entry, 1));
+  entry->Close();
+
+  // Growing past the limit drops the memory copy.
+  tiered_backend_->set_max_entry_size(10);
+  ASSERT_EQ(net::OK, OpenEntry("the key", &entry));
+  Write(entry, 1, "a body too large");
+  EXPECT_EQ("a body too large", Read(entry, 1));
+  EXPECT_FALSE(static_cast<disk_cache::TieredEntry*>(entry)
+                   ->HasMemoryEntryForTesting());
+  entry->Close();
+  EXPECT_FALSE(IsInMemoryTier("the key"));
+}
+
+// Tests that a write while the entry is being promoted cancels the promotion.
+TEST_F(DiskCacheTieredBackendTest, WriteCancelsPromotion) {
+  SetSimpleCacheMode();
+  InitTieredCache();
+  CreateTestEntry("the key", "headers", "body");
+  OpenTimes("the key", 1);
+
+  disk_cache::Entry* entry = NULL;
+  ASSERT_EQ(net::OK, OpenEntry("the key", &entry));
+  Write(entry, 1, "new body");
+  WaitForPromotion();
+  entry->Close();
+  EXPECT_FALSE(IsInMemoryTier("the key"));
+}
+
+TEST_F(DiskCacheTieredBackendTest, Doom) {
+  SetMemoryOnlyMode();
+  InitTieredCache();
+  CreateTestEntry("first", "headers", "body");
+  CreateTestEntry("second", "headers", "body");
+  OpenTimes("first", 2);
+  OpenTimes("second", 2);
+  ASSERT_TRUE(IsInMemoryTier("first"));
+  ASSERT_TRUE(IsInMemoryTier("second"));
+
+  EXPECT_EQ(net::OK, DoomEntry("first"));
+  disk_cache::Entry* entry = NULL;
+  EXPECT_NE(net::OK, OpenEntry("first", &entry));
+  EXPECT_FALSE(IsInMemoryTier("first"));
+
+  // Dooming an entry opened from the memory tier dooms it on disk too.
+  ASSERT_EQ(net::OK, OpenEntry("second", &entry));
+  entry->Doom();
+  entry->Close();
+  EXPECT_FALSE(IsInMemoryTier("second"));
+  EXPECT_NE(net::OK, OpenEntry("second", &entry));
+  EXPECT_EQ(0, cache_->GetEntryCount());
+}
+
+// Tests that an entry re-created on disk doesn't keep an old memory copy.
+TEST_F(DiskCacheTieredBackendTest, CreateReplacesMemoryCopy) {
+  SetMemoryOnlyMode();
+  InitTieredCache();
+  CreateTestEntry("the key", "headers", "body");
+  OpenTimes("the key", 2);
+  ASSERT_TRUE(IsInMemoryTier("the key"));
+
+  ASSERT_EQ(net::OK,
+            tiered_backend_->disk_backend()->DoomEntry(
+                "the key", net::CompletionCallback()));
+  CreateTestEntry("the key", "other headers", "other body");
+  EXPECT_FALSE(IsInMemoryTier("the key"));
+
+  disk_cache::Entry* entry = NULL;
+  ASSERT_EQ(net::OK, OpenEntry("the key", &entry));
+  EXPECT_EQ("other body", Read(entry, 1));
+  entry->Close();
+}
+
+TEST_F(DiskCacheTieredBackendTest, DoomEntriesSince) {
+  SetMemoryOnlyMode();
+  InitTieredCache();
+  CreateTestEntry("the key", "headers", "body");
+  OpenTimes("the key", 2);
+  ASSERT_TRUE(IsInMemoryTier("the key"));
+
+  EXPECT_EQ(net::OK, DoomEntriesSince(base::Time()));
+  EXPECT_FALSE(IsInMemoryTier("the key"));
+  EXPECT_EQ(0, cache_->GetEntryCount());
+}
+
+// Tests that an entry only used from the memory tier since a time is doomed
+// by DoomEntriesSince() that time.
+TEST_F(DiskCacheTieredBackendTest, DoomEntriesSinceMemoryHit) {
+  SetSimpleCacheMode();
+  InitTieredCache();
+  CreateTestEntry("the key", "headers", "body");
+  OpenTimes("the key", 2);
+  ASSERT_TRUE(IsInMemoryTier("the key"));
+
+  AddDelay();
+  base::Time used_time = base::Time::Now();
+  AddDelay();
+  disk_cache::Entry* entry = NULL;
+  ASSERT_EQ(net::OK, OpenEntry("the key", &entry));
+  EXPECT_EQ(1, tiered_backend_->memory_hit_count());
+  entry->Close();
+
+  EXPECT_EQ(net::OK, DoomEntriesSince(used_time));
+  EXPECT_NE(net::OK, OpenEntry("the key", &entry));
+  EXPECT_EQ(0, cache_->GetEntryCount());
+}
@@ -0,0 +1,355 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/disk_cache/tiered/tiered_entry.h"
+
+#include "base/bind.h"
+#include "base/logging.h"
+#include "net/base/io_buffer.h"
+#include "net/base/net_errors.h"
+#include "net/disk_cache/tiered/tiered_backend.h"
+
+namespace {
+
+void IgnoreDoomResult(int result) {
+}
+
+}  // namespace
+
+namespace disk_cache {
+
+TieredEntry::DiskOperation::DiskOperation(Type type,
+                                          int index,
+                                          int64 offset,
+                                          net::IOBuffer* buf,
+                                          int buf_len,
+                                          const CompletionCallback& callback)
+    : type(type),
+      index(index),
+      offset(offset),
+      buf(buf),
+      buf_len(buf_len),
+      truncate(false),
+      start(NULL),
+      callback(callback) {
+}
+
+TieredEntry::DiskOperation::~DiskOperation() {
+}
+
+TieredEntry::TieredEntry(const base::WeakPtr<TieredBackend>& backend,
+                         const std::string& key,
+                         Entry* memory_entry,
+                         Entry* disk_entry)
+    : backend_(backend),
+      key_(key),
+      memory_entry_(memory_entry),
+      disk_entry_(disk_entry),
+      opened_disk_entry_(NULL),
+      opening_disk_entry_(false),
+      pending_promotion_reads_(0),
+      promoting_(false),
+      closing_(false),
+      weak_factory_(this) {
+  DCHECK(memory_entry_ || disk_entry_);
+}
+
+void TieredEntry::Promote() {
+  DCHECK(disk_entry_);
+  DCHECK(!memory_entry_);
+  DCHECK(!promoting_);
+  promoting_ = true;
+  promotion_data_.assign(kStreamCount, std::string());
+  pending_promotion_reads_ = kStreamCount;
+  for (int i = 0; i < kStreamCount; ++i) {
+    const int size = disk_entry_->GetDataSize(i);
+    if (size <= 0) {
+      OnPromotionRead(i, NULL, 0);
+      continue;
+    }
+    scoped_refptr<net::IOBuffer> buf(new net::IOBuffer(size));
+    int rv = disk_entry_->ReadData(
+        i, 0, buf.get(), size,
+        base::Bind(&TieredEntry::OnPromotionRead, weak_factory_.GetWeakPtr(),
+                   i, buf));
+    if (rv != net::ERR_IO_PENDING)
+      OnPromotionRead(i, buf, rv);
+  }
+}
+
+void TieredEntry::Doom() {
+  promoting_ = false;
+  if (memory_entry_)
+    memory_entry_->Doom();
+  else if (backend_)
+    backend_->DoomMemoryEntry(key_);
+
+  if (disk_entry_) {
+    disk_entry_->Doom();
+  } else if (backend_) {
+    backend_->disk_backend()->DoomEntry(key_, base::Bind(&IgnoreDoomResult));
+  }
+}
+
+void TieredEntry::Close() {
+  DCHECK(!closing_);
+  closing_ = true;
+  if (!opening_disk_entry_)
+    FinishClose();
+}
+
+std::string TieredEntry::GetKey() const {
+  return key_;
+}
+
+base::Time TieredEntry::GetLastUsed() const {
+  return disk_entry_ ? disk_entry_->GetLastUsed()
+                     : memory_entry_->GetLastUsed();
+}
+
+base::Time TieredEntry::GetLastModified() const {
+  return disk_entry_ ? disk_entry_->GetLastModified()
+                     : memory_entry_->GetLastModified();
+}
+
+int32 TieredEntry::GetDataSize(int index) const {
+  return memory_entry_ ? memory_entry_->GetDataSize(index)
+                       : disk_entry_->GetDataSize(index);
+}
+
+int TieredEntry::ReadData(int index, int offset, net::IOBuffer* buf,
+                          int buf_len, const CompletionCallback& callback) {
+  if (memory_entry_)
+    return memory_entry_->ReadData(index, offset, buf, buf_len, callback);
+  return disk_entry_->ReadData(index, offset, buf, buf_len, callback);
+}
+
+int TieredEntry::WriteData(int index, int offset, net::IOBuffer* buf,
+                           int buf_len, const CompletionCallback& callback,
+                           bool truncate) {
+  DiskOperation operation(DiskOperation::WRITE_DATA, index, offset, buf,
+                          buf_len, callback);
+  operation.truncate = truncate;
+  return RunDiskOperation(operation);
+}
+
+int TieredEntry::ReadSparseData(int64 offset, net::IOBuffer* buf, int buf_len,
+                                const CompletionCallback& callback) {
+  return RunDiskOperation(DiskOperation(DiskOperation::READ_SPARSE_DATA, 0,
+                                        offset, buf, buf_len, callback));
+}
+
+int TieredEntry::WriteSparseData(int64 offset, net::IOBuffer* buf, int buf_len,
+                                 const CompletionCallback& callback) {
+  return RunDiskOperation(DiskOperation(DiskOperation::WRITE_SPARSE_DATA, 0,
+                                        offset, buf, buf_len, callback));
+}
+
+int TieredEntry::GetAvailableRange(int64 offset, int len, int64* start,
+                                   const CompletionCallback& callback) {
+  DiskOperation operation(DiskOperation::GET_AVAILABLE_RANGE, 0, offset, NULL,
+                          len, callback);
+  operation.start = start;
+  return RunDiskOperation(operation);
+}
+
+bool TieredEntry::CouldBeSparse() const {
+  return memory_entry_ ? memory_entry_->CouldBeSparse()
+                       : disk_entry_->CouldBeSparse();
+}
+
+void TieredEntry::CancelSparseIO() {
+  if (disk_entry_)
+    disk_entry_->CancelSparseIO();
+}
+
+int TieredEntry::ReadyForSparseIO(const CompletionCallback& callback) {
+  return RunDiskOperation(DiskOperation(DiskOperation::READY_FOR_SPARSE_IO, 0,
+                                        0, NULL, 0, callback));
+}
+
+TieredEntry::~TieredEntry() {
+  DCHECK(!memory_entry_);
+  DCHECK(!disk_entry_);
+}
+
+int TieredEntry::RunDiskOperation(const DiskOperation& operation) {
+  if (disk_entry_)
+    return StartDiskOperation(operation);
+
+  if (opening_disk_entry_) {
+    pending_operations_.push_back(operation);
+    return net::ERR_IO_PENDING;
+  }
+
+  if (!backend_)
+    return net::ERR_FAILED;
+
+  // The entry was opened from the memory tier.
+  opening_disk_entry_ = true;
+  int rv = backend_->disk_backend()->OpenEntry(
+      key_, &opened_disk_entry_,
+      base::Bind(&TieredEntry::OnDiskEntryOpened,
+                 weak_factory_.GetWeakPtr()));
+  if (rv == net::ERR_IO_PENDING) {
+    pending_operations_.push_back(operation);
+    return rv;
+  }
+
+  opening_disk_entry_ = false;
+  if (rv != net::OK) {
+    // The disk tier lost the entry, so the memory copy is stale.
+    memory_entry_->Doom();
+    return rv;
+  }
+  disk_entry_ = opened_disk_entry_;
+  opened_disk_entry_ = NULL;
+  return StartDiskOperation(operation);
+}
+
+int TieredEntry::StartDiskOperation(const DiskOperation& operation) {
+  DCHECK(disk_entry_);
+  switch (operation.type) {
+    case DiskOperation::WRITE_DATA: {
+      promoting_ = false;
+      WriteMemoryEntry(operation.index, operation.offset, operation.buf.get(),
+                       operation.buf_len, operation.truncate);
+      // A write without a callback stays one, as the disk entry may then
+      // complete it synchronously; its result is checked below.
+      CompletionCallback callback;
+      if (!operation.callback.is_null()) {
+        callback = base::Bind(&TieredEntry::OnDiskWriteDone,
+                              weak_factory_.GetWeakPtr(), backend_, key_,
+                              operation.callback);
+      }
+      int rv = disk_entry_->WriteData(operation.index, operation.offset,
+                                      operation.buf.get(), operation.buf_len,
+                                      callback, operation.truncate);
+      if (rv < 0 && rv != net::ERR_IO_PENDING)
+        DropMemoryEntry();
+      return rv;
+    }
+    case DiskOperation::READ_SPARSE_DATA:
+      return disk_entry_->ReadSparseData(operation.offset, operation.buf.get(),
+                                         operation.buf_len,
+                                         operation.callback);
+    case DiskOperation::WRITE_SPARSE_DATA:
+      // Sparse entries are not kept in the memory tier.
+      promoting_ = false;
+      DropMemoryEntry();
+      return disk_entry_->WriteSparseData(operation.offset,
+                                          operation.buf.get(),
+                                          operation.buf_len,
+                                          operation.callback);
+    case DiskOperation::GET_AVAILABLE_RANGE:
+      return disk_entry_->GetAvailableRange(operation.offset,
+                                            operation.buf_len,
+                                            operation.start,
+                                            operation.callback);
+    case DiskOperation::READY_FOR_SPARSE_IO:
+      return disk_entry_->ReadyForSparseIO(operation.callback);
+  }
+  NOTREACHED();
+  return net::ERR_FAILED;
+}
+
+void TieredEntry::OnDiskEntryOpened(int result) {
+  DCHECK(opening_disk_entry_);
+  if (result == net::OK) {
+    disk_entry_ = opened_disk_entry_;
+    opened_disk_entry_ = NULL;
+  } else if (memory_entry_) {
+    memory_entry_->Doom();
+  }
+
+  // The callbacks may queue more operations, or close this entry, which waits
+  // for the queue to be empty.
+  while (!pending_operations_.empty()) {
+    DiskOperation operation = pending_operations_.front();
+    pending_operations_.erase(pending_operations_.begin());
+    int rv = disk_entry_ ? StartDiskOperation(operation) : result;
+    if (rv != net::ERR_IO_PENDING)
+      operation.callback.Run(rv);
+  }
+  opening_disk_entry_ = false;
+
+  if (closing_)
+    FinishClose();
+}
+
+// static
+void TieredEntry::OnDiskWriteDone(const base::WeakPtr<TieredEntry>& entry,
+                                  const base::WeakPtr<TieredBackend>& backend,
+                                  const std::string& key,
+                                  const CompletionCallback& callback,
+                                  int result) {
+  if (result < 0) {
+    // The memory copy already has the write the disk entry failed to take.
+    if (entry)
+      entry->DropMemoryEntry();
+    else if (backend)
+      backend->DoomMemoryEntry(key);
+  }
+  callback.Run(result);
+}
+
+void TieredEntry::DropMemoryEntry() {
+  DCHECK(disk_entry_);
+  if (memory_entry_) {
+    memory_entry_->Doom();
+    memory_entry_->Close();
+    memory_entry_ = NULL;
+  } else if (backend_) {
+    backend_->DoomMemoryEntry(key_);
+  }
+}
+
+void TieredEntry::WriteMemoryEntry(int index, int offset, net::IOBuffer* buf,
+                                   int buf_len, bool truncate) {
+  if (!memory_entry_ || !backend_) {
+    DropMemoryEntry();
+    return;
+  }
+
+  int rv = memory_entry_->WriteData(index, offset, buf, buf_len,
+                                    CompletionCallback(), truncate);
+  int64 size = 0;
+  for (int i = 0; i < kStreamCount; ++i)
+    size += memory_entry_->GetDataSize(i);
+  if (rv != buf_len || size > backend_->max_entry_size())
+    DropMemoryEntry();
+}
+
+void TieredEntry::OnPromotionRead(int index,
+                                  scoped_refptr<net::IOBuffer> buf,
+                                  int result) {
+  DCHECK_GT(pending_promotion_reads_, 0);
+  if (result != disk_entry_->GetDataSize(index))
+    promoting_ = false;
+  else if (promoting_ && result > 0)
+    promotion_data_[index].assign(buf->data(), result);
+
+  if (--pending_promotion_reads_ > 0)
+    return;
+
+  if (promoting_ && backend_ && !memory_entry_)
+    memory_entry_ = backend_->PromoteEntry(key_, promotion_data_);
+  promoting_ = false;
+  promotion_data_.clear();
+}
+
+void TieredEntry::FinishClose() {
+  DCHECK(!opening_disk_entry_);
+  if (memory_entry_) {
+    memory_entry_->Close();
+    memory_entry_ = NULL;
+  }
+  if (disk_entry_) {
+    disk_entry_->Close();
+    disk_entry_ = NULL;
+  }
+  delete this;
+}
+
+}  // namespace disk_cache
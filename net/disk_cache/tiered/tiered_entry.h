@@ -0,0 +1,154 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_DISK_CACHE_TIERED_TIERED_ENTRY_H_
+#define NET_DISK_CACHE_TIERED_TIERED_ENTRY_H_
+
+#include <string>
+#include <vector>
+
+#include "base/compiler_specific.h"
+#include "base/memory/ref_counted.h"
+#include "base/memory/weak_ptr.h"
+#include "net/base/net_export.h"
+#include "net/disk_cache/disk_cache.h"
+
+namespace net {
+class IOBuffer;
+}
+
+namespace disk_cache {
+
+class TieredBackend;
+
+// An entry of a TieredBackend. It holds the entry of the disk tier, the entry
+// of the memory tier, or both. Reads are served by the memory entry when
+// there is one. Writes go to the disk entry, which is opened when the first
+// one comes if it isn't open yet, and to the memory entry, if any.
+class NET_EXPORT_PRIVATE TieredEntry : public Entry {
+ public:
+  // The number of streams copied to the memory tier.
+  static const int kStreamCount = 3;
+
+  TieredEntry(const base::WeakPtr<TieredBackend>& backend,
+              const std::string& key,
+              Entry* memory_entry,
+              Entry* disk_entry);
+
+  // Reads the disk entry, and copies it to the memory tier unless it is
+  // written to in the meantime.
+  void Promote();
+
+  bool HasMemoryEntryForTesting() const { return memory_entry_ != NULL; }
+
+  // Entry interface.
+  virtual void Doom() OVERRIDE;
+  virtual void Close() OVERRIDE;
+  virtual std::string GetKey() const OVERRIDE;
+  virtual base::Time GetLastUsed() const OVERRIDE;
+  virtual base::Time GetLastModified() const OVERRIDE;
+  virtual int32 GetDataSize(int index) const OVERRIDE;
+  virtual int ReadData(int index, int offset, net::IOBuffer* buf, int buf_len,
+                       const CompletionCallback& callback) OVERRIDE;
+  virtual int WriteData(int index, int offset, net::IOBuffer* buf, int buf_len,
+                        const CompletionCallback& callback,
+                        bool truncate) OVERRIDE;
+  virtual int ReadSparseData(int64 offset, net::IOBuffer* buf, int buf_len,
+                             const CompletionCallback& callback) OVERRIDE;
+  virtual int WriteSparseData(int64 offset, net::IOBuffer* buf, int buf_len,
+                              const CompletionCallback& callback) OVERRIDE;
+  virtual int GetAvailableRange(int64 offset, int len, int64* start,
+                                const CompletionCallback& callback) OVERRIDE;
+  virtual bool CouldBeSparse() const OVERRIDE;
+  virtual void CancelSparseIO() OVERRIDE;
+  virtual int ReadyForSparseIO(const CompletionCallback& callback) OVERRIDE;
+
+ private:
+  // An operation on the disk entry, waiting for it to open.
+  struct DiskOperation {
+    enum Type {
+      WRITE_DATA,
+      READ_SPARSE_DATA,
+      WRITE_SPARSE_DATA,
+      GET_AVAILABLE_RANGE,
+      READY_FOR_SPARSE_IO,
+    };
+
+    DiskOperation(Type type,
+                  int index,
+                  int64 offset,
+                  net::IOBuffer* buf,
+                  int buf_len,
+                  const CompletionCallback& callback);
+    ~DiskOperation();
+
+    Type type;
+    int index;
+    int64 offset;
+    scoped_refptr<net::IOBuffer> buf;
+    int buf_len;
+    bool truncate;
+    int64* start;
+    CompletionCallback callback;
+  };
+
+  virtual ~TieredEntry();
+
+  // Runs |operation| on the disk entry, opening it first if needed. Returns
+  // a net error code, or the result of the operation.
+  int RunDiskOperation(const DiskOperation& operation);
+  int StartDiskOperation(const DiskOperation& operation);
+  void OnDiskEntryOpened(int result);
+
+  // Completes a disk write started by StartDiskOperation(), dropping the
+  // memory copy of the entry if it failed. Runs even if |entry| is gone, as
+  // the copy outlives it.
+  static void OnDiskWriteDone(const base::WeakPtr<TieredEntry>& entry,
+                              const base::WeakPtr<TieredBackend>& backend,
+                              const std::string& key,
+                              const CompletionCallback& callback,
+                              int result);
+
+  // Dooms and closes the memory entry, as well as any other copy of the entry
+  // in the memory tier.
+  void DropMemoryEntry();
+
+  // Applies a write to the memory entry, which is dropped if it fails or gets
+  // too large.
+  void WriteMemoryEntry(int index, int offset, net::IOBuffer* buf,
+                        int buf_len, bool truncate);
+
+  void OnPromotionRead(int index, scoped_refptr<net::IOBuffer> buf,
+                       int result);
+
+  // Closes both entries and deletes this one, once the disk entry is no longer
+  // being opened.
+  void FinishClose();
+
+  base::WeakPtr<TieredBackend> backend_;
+  const std::string key_;
+  Entry* memory_entry_;
+  Entry* disk_entry_;
+
+  // The entry opened by OpenEntry() on the disk tier, while it is opened.
+  Entry* opened_disk_entry_;
+  bool opening_disk_entry_;
+  std::vector<DiskOperation> pending_operations_;
+
+  // The streams read so far from the disk entry by Promote(), the number of
+  // reads left, and whether the promotion is still on.
+  std::vector<std::string> promotion_data_;
+  int pending_promotion_reads_;
+  bool promoting_;
+
+  bool closing_;
+
+  base::WeakPtrFactory<TieredEntry> weak_factory_;
+
+  DISALLOW_COPY_AND_ASSIGN(TieredEntry);
+};
+
+}  // namespace disk_cache
+
+#endif  // NET_DISK_CACHE_TIERED_TIERED_ENTRY_H_
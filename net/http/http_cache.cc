@@ -21,6 +21,7 @@
 #include "base/memory/ref_counted.h"
 #include "base/message_loop/message_loop.h"
 #include "base/metrics/field_trial.h"
+#include "base/metrics/histogram.h"
 #include "base/pickle.h"
 #include "base/stl_util.h"
 #include "base/strings/string_number_conversions.h"
@@ -30,9 +31,12 @@
 #include "net/base/cache_type.h"
 #include "net/base/io_buffer.h"
 #include "net/base/load_flags.h"
+#include "net/base/mime_util.h"
 #include "net/base/net_errors.h"
 #include "net/base/upload_data_stream.h"
+#include "net/disk_cache/compressed_entry.h"
 #include "net/disk_cache/disk_cache.h"
+#include "net/disk_cache/tiered/tiered_backend.h"
 #include "net/http/disk_based_cert_cache.h"
 #include "net/http/disk_cache_based_quic_server_info.h"
 #include "net/http/http_cache_transaction.h"
@@ -46,6 +50,15 @@
 
 namespace {
 
+// The outcome of the revalidation of a stale entry in the background. Used in
+// histograms, please only add entries at the end.
+enum AsyncValidationResult {
+  ASYNC_VALIDATION_NOT_MODIFIED = 0,
+  ASYNC_VALIDATION_UPDATED = 1,
+  ASYNC_VALIDATION_FAILED = 2,
+  ASYNC_VALIDATION_MAX = 3,
+};
+
 bool UseCertCache() {
   return base::FieldTrialList::FindFullName("CertCacheTrial") ==
          "ExperimentGroup";
@@ -56,6 +69,27 @@ void DeletePath(base::FilePath path) {
   base::DeleteFile(path, false);
 }
 
+// Puts a memory tier of |memory_tier_bytes| in front of |*backend|, once it
+// is created.
+int AddMemoryTier(scoped_ptr<disk_cache::Backend>* backend,
+                  int memory_tier_bytes,
+                  net::NetLog* net_log,
+                  int result) {
+  if (result == net::OK) {
+    *backend = disk_cache::TieredBackend::CreateBackend(
+        backend->Pass(), memory_tier_bytes, net_log);
+  }
+  return result;
+}
+
+void OnDiskTierCreated(scoped_ptr<disk_cache::Backend>* backend,
+                       int memory_tier_bytes,
+                       net::NetLog* net_log,
+                       const net::CompletionCallback& callback,
+                       int result) {
+  callback.Run(AddMemoryTier(backend, memory_tier_bytes, net_log, result));
+}
+
 }  // namespace
 
 namespace net {
@@ -70,6 +104,7 @@ HttpCache::DefaultBackend::DefaultBackend(
       backend_type_(backend_type),
       path_(path),
       max_bytes_(max_bytes),
+      memory_tier_bytes_(0),
       thread_(thread) {
 }
 
@@ -85,21 +120,32 @@ int HttpCache::DefaultBackend::CreateBackend(
     NetLog* net_log, scoped_ptr<disk_cache::Backend>* backend,
     const CompletionCallback& callback) {
   DCHECK_GE(max_bytes_, 0);
-  return disk_cache::CreateCacheBackend(type_,
-                                        backend_type_,
-                                        path_,
-                                        max_bytes_,
-                                        true,
-                                        thread_,
-                                        net_log,
-                                        backend,
-                                        callback);
+  if (memory_tier_bytes_ <= 0 || type_ == MEMORY_CACHE) {
+    return disk_cache::CreateCacheBackend(type_,
+                                          backend_type_,
+                                          path_,
+                                          max_bytes_,
+                                          true,
+                                          thread_,
+                                          net_log,
+                                          backend,
+                                          callback);
+  }
+
+  int rv = disk_cache::CreateCacheBackend(
+      type_, backend_type_, path_, max_bytes_, true, thread_, net_log,
+      backend,
+      base::Bind(&OnDiskTierCreated, backend, memory_tier_bytes_, net_log,
+                 callback));
+  if (rv == ERR_IO_PENDING)
+    return rv;
+  return AddMemoryTier(backend, memory_tier_bytes_, net_log, rv);
 }
 
 //-----------------------------------------------------------------------------
 
 HttpCache::ActiveEntry::ActiveEntry(disk_cache::Entry* entry)
-    : disk_entry(entry),
+    : disk_entry(new disk_cache::CompressedEntry(entry, kResponseContentIndex)),
       writer(NULL),
       will_process_pending_queue(false),
       doomed(false) {
@@ -276,6 +322,116 @@ void HttpCache::MetadataWriter::OnIOComplete(int result) {
 
 //-----------------------------------------------------------------------------
 
+// Revalidates the entry of a request with a transaction of its own, which runs
+// to completion in the background. The entry is only locked to read it and to
+// apply the response, not while the request is on the network. It is owned by
+// the HttpCache, and deleted through HttpCache::DeleteAsyncValidation() once
+// done.
+class HttpCache::AsyncValidation {
+ public:
+  AsyncValidation(const HttpRequestInfo& original_request,
+                  const std::string& key,
+                  HttpCache* cache)
+      : request_info_(original_request),
+        key_(key),
+        cache_(cache) {
+  }
+
+  ~AsyncValidation() {}
+
+  void Start(scoped_ptr<HttpTransaction> transaction);
+
+ private:
+  void OnStarted(int result);
+  void DoRead();
+  void OnRead(int result);
+
+  // Records the outcome of the revalidation, and has the cache delete this
+  // object.
+  void Terminate(AsyncValidationResult result);
+
+  HttpRequestInfo request_info_;
+  const std::string key_;
+  HttpCache* const cache_;
+  scoped_ptr<HttpTransaction> transaction_;
+  scoped_refptr<IOBuffer> buf_;
+  base::TimeTicks start_time_;
+
+  DISALLOW_COPY_AND_ASSIGN(AsyncValidation);
+};
+
+void HttpCache::AsyncValidation::Start(
+    scoped_ptr<HttpTransaction> transaction) {
+  transaction_ = transaction.Pass();
+
+  // The entry is within its stale-while-revalidate window, which would let
+  // the transaction use it as is.
+  request_info_.load_flags |= LOAD_VALIDATE_CACHE;
+  start_time_ = base::TimeTicks::Now();
+
+  int rv = transaction_->Start(
+      &request_info_,
+      base::Bind(&AsyncValidation::OnStarted, base::Unretained(this)),
+      BoundNetLog());
+  if (rv != ERR_IO_PENDING)
+    OnStarted(rv);
+}
+
+void HttpCache::AsyncValidation::OnStarted(int result) {
+  if (result != OK) {
+    // The entry can't be served again before the certificate issue is
+    // resolved.
+    if (IsCertificateError(result))
+      cache_->DoomEntry(key_, NULL);
+    return Terminate(ASYNC_VALIDATION_FAILED);
+  }
+
+  const HttpResponseInfo* response_info = transaction_->GetResponseInfo();
+
+  // Credentials can't be asked for in the background.
+  if (response_info->auth_challenge.get())
+    return Terminate(ASYNC_VALIDATION_FAILED);
+
+  // A 304 updated the stored headers before the transaction started, while a
+  // new response is stored as it is read.
+  if (response_info->was_cached)
+    return Terminate(ASYNC_VALIDATION_NOT_MODIFIED);
+  DoRead();
+}
+
+void HttpCache::AsyncValidation::DoRead() {
+  const int kBufferSize = 4096;
+  if (!buf_.get())
+    buf_ = new IOBuffer(kBufferSize);
+
+  int rv;
+  do {
+    rv = transaction_->Read(
+        buf_.get(), kBufferSize,
+        base::Bind(&AsyncValidation::OnRead, base::Unretained(this)));
+  } while (rv > 0);
+
+  if (rv != ERR_IO_PENDING)
+    OnRead(rv);
+}
+
+void HttpCache::AsyncValidation::OnRead(int result) {
+  if (result > 0)
+    return DoRead();
+  Terminate(result == OK ? ASYNC_VALIDATION_UPDATED : ASYNC_VALIDATION_FAILED);
+}
+
+void HttpCache::AsyncValidation::Terminate(AsyncValidationResult result) {
+  UMA_HISTOGRAM_ENUMERATION("HttpCache.AsyncValidation", result,
+                            ASYNC_VALIDATION_MAX);
+  UMA_HISTOGRAM_TIMES("HttpCache.AsyncValidationTime",
+                      base::TimeTicks::Now() - start_time_);
+  cache_->DeleteAsyncValidation(key_);
+  // |this| is deleted.
+}
+
+//-----------------------------------------------------------------------------
+
 class HttpCache::QuicServerInfoFactoryAdaptor : public QuicServerInfoFactory {
  public:
   QuicServerInfoFactoryAdaptor(HttpCache* http_cache)
@@ -299,6 +455,7 @@ HttpCache::HttpCache(const net::HttpNetworkSession::Params& params,
       building_backend_(false),
       bypass_lock_for_test_(false),
       mode_(NORMAL),
+      use_stale_while_revalidate_(false),
       network_layer_(new HttpNetworkLayer(new HttpNetworkSession(params))),
       weak_factory_(this) {
   SetupQuicServerInfoFactory(network_layer_->GetSession());
@@ -314,6 +471,7 @@ HttpCache::HttpCache(HttpNetworkSession* session,
       building_backend_(false),
       bypass_lock_for_test_(false),
       mode_(NORMAL),
+      use_stale_while_revalidate_(false),
       network_layer_(new HttpNetworkLayer(session)),
       weak_factory_(this) {
 }
@@ -326,6 +484,7 @@ HttpCache::HttpCache(HttpTransactionFactory* network_layer,
       building_backend_(false),
       bypass_lock_for_test_(false),
       mode_(NORMAL),
+      use_stale_while_revalidate_(false),
       network_layer_(network_layer),
       weak_factory_(this) {
   SetupQuicServerInfoFactory(network_layer_->GetSession());
@@ -336,6 +495,8 @@ HttpCache::~HttpCache() {
   // could see an inconsistent object (half destroyed).
   weak_factory_.InvalidateWeakPtrs();
 
+  STLDeleteValues(&async_validations_);
+
   // If we have any active entries remaining, then we need to deactivate them.
   // We may have some pending calls to OnProcessPendingQueue, but since those
   // won't run (due to our destruction), we can simply ignore the corresponding
@@ -426,6 +587,14 @@ void HttpCache::WriteMetadata(const GURL& url,
   writer->Write(url, expected_response_time, buf, buf_len);
 }
 
+bool HttpCache::ShouldCompressMimeType(const std::string& mime_type) const {
+  for (size_t i = 0; i < compressed_mime_types_.size(); ++i) {
+    if (MatchesMimeType(compressed_mime_types_[i], mime_type))
+      return true;
+  }
+  return false;
+}
+
 void HttpCache::CloseAllConnections() {
   HttpNetworkSession* session = GetSession();
   if (session)
@@ -1038,6 +1207,34 @@ void HttpCache::ProcessPendingQueue(ActiveEntry* entry) {
       base::Bind(&HttpCache::OnProcessPendingQueue, GetWeakPtr(), entry));
 }
 
+void HttpCache::PerformAsyncValidation(
+    const HttpRequestInfo& original_request) {
+  std::string key = GenerateCacheKey(&original_request);
+
+  // Another stale hit may have triggered a revalidation already.
+  if (async_validations_.find(key) != async_validations_.end())
+    return;
+
+  AsyncValidation* async_validation =
+      new AsyncValidation(original_request, key, this);
+  async_validations_[key] = async_validation;
+
+  HttpCache::Transaction* transaction = new HttpCache::Transaction(IDLE, this);
+  transaction->ReleaseEntryWhileValidating();
+  if (bypass_lock_for_test_)
+    transaction->BypassLockForTest();
+  async_validation->Start(scoped_ptr<HttpTransaction>(transaction));
+  // |async_validation| may have been deleted here.
+}
+
+void HttpCache::DeleteAsyncValidation(const std::string& key) {
+  AsyncValidationMap::iterator it = async_validations_.find(key);
+  DCHECK(it != async_validations_.end());
+  AsyncValidation* async_validation = it->second;
+  async_validations_.erase(it);
+  delete async_validation;
+}
+
 void HttpCache::OnProcessPendingQueue(ActiveEntry* entry) {
   entry->will_process_pending_queue = false;
   DCHECK(!entry->writer);
@@ -17,6 +17,7 @@
 #include <list>
 #include <set>
 #include <string>
+#include <vector>
 
 #include "base/basictypes.h"
 #include "base/containers/hash_tables.h"
@@ -41,6 +42,7 @@ class SingleThreadTaskRunner;
 
 namespace disk_cache {
 class Backend;
+class CompressedEntry;
 class Entry;
 }  // namespace disk_cache
 
@@ -112,6 +114,10 @@ class NET_EXPORT HttpCache : public HttpTransactionFactory,
     // Returns a factory for an in-memory cache.
     static BackendFactory* InMemory(int max_bytes);
 
+    // Puts a memory tier of |bytes| in front of an on-disk backend, which keeps
+    // copies of its hot small entries. See disk_cache::TieredBackend.
+    void set_memory_tier_size(int bytes) { memory_tier_bytes_ = bytes; }
+
     // BackendFactory implementation.
     virtual int CreateBackend(NetLog* net_log,
                               scoped_ptr<disk_cache::Backend>* backend,
@@ -122,6 +128,7 @@ class NET_EXPORT HttpCache : public HttpTransactionFactory,
     BackendType backend_type_;
     const base::FilePath path_;
     int max_bytes_;
+    int memory_tier_bytes_;
     scoped_refptr<base::SingleThreadTaskRunner> thread_;
   };
 
@@ -180,6 +187,27 @@ class NET_EXPORT HttpCache : public HttpTransactionFactory,
   void set_mode(Mode value) { mode_ = value; }
   Mode mode() { return mode_; }
 
+  // Sets the MIME types of the responses whose bodies are stored compressed.
+  // The types may contain wildcards, as in net::MatchesMimeType(). Responses
+  // with a Content-Encoding are stored as received. Empty by default.
+  void set_compressed_mime_types(const std::vector<std::string>& mime_types) {
+    compressed_mime_types_ = mime_types;
+  }
+
+  // Returns true if bodies of type |mime_type| should be stored compressed.
+  bool ShouldCompressMimeType(const std::string& mime_type) const;
+
+  // Enables the stale-while-revalidate directive: a GET request that finds a
+  // stale entry within its window is served the entry as is, and the entry is
+  // revalidated by a transaction of the cache in the background. Disabled by
+  // default.
+  void set_use_stale_while_revalidate(bool use_stale_while_revalidate) {
+    use_stale_while_revalidate_ = use_stale_while_revalidate;
+  }
+  bool use_stale_while_revalidate() const {
+    return use_stale_while_revalidate_;
+  }
+
   // Close currently active sockets so that fresh page loads will not use any
   // recycled connections.  For sockets currently in use, they may not close
   // immediately, but they will not be reusable. This is for debugging.
@@ -230,6 +258,7 @@ class NET_EXPORT HttpCache : public HttpTransactionFactory,
     kNumCacheEntryDataIndices
   };
 
+  class AsyncValidation;
   class MetadataWriter;
   class QuicServerInfoFactoryAdaptor;
   class Transaction;
@@ -245,7 +274,9 @@ class NET_EXPORT HttpCache : public HttpTransactionFactory,
     explicit ActiveEntry(disk_cache::Entry* entry);
     ~ActiveEntry();
 
-    disk_cache::Entry* disk_entry;
+    // Wraps the backend entry, which it stores the body of compressed
+    // responses in.
+    disk_cache::CompressedEntry* disk_entry;
     Transaction*       writer;
     TransactionList    readers;
     TransactionList    pending_queue;
@@ -257,6 +288,7 @@ class NET_EXPORT HttpCache : public HttpTransactionFactory,
   typedef base::hash_map<std::string, PendingOp*> PendingOpsMap;
   typedef std::set<ActiveEntry*> ActiveEntriesSet;
   typedef base::hash_map<std::string, int> PlaybackCacheMap;
+  typedef base::hash_map<std::string, AsyncValidation*> AsyncValidationMap;
 
   // Methods ------------------------------------------------------------------
 
@@ -374,6 +406,13 @@ class NET_EXPORT HttpCache : public HttpTransactionFactory,
   // Resumes processing the pending list of |entry|.
   void ProcessPendingQueue(ActiveEntry* entry);
 
+  // Revalidates the entry of |original_request| with a new transaction, unless
+  // it is already being revalidated.
+  void PerformAsyncValidation(const HttpRequestInfo& original_request);
+
+  // Deletes the finished revalidation of the entry |key|.
+  void DeleteAsyncValidation(const std::string& key);
+
   // Events (called via PostTask) ---------------------------------------------
 
   void OnProcessPendingQueue(ActiveEntry* entry);
@@ -407,6 +446,13 @@ class NET_EXPORT HttpCache : public HttpTransactionFactory,
 
   Mode mode_;
 
+  std::vector<std::string> compressed_mime_types_;
+
+  bool use_stale_while_revalidate_;
+
+  // The revalidations in progress, by cache key.
+  AsyncValidationMap async_validations_;
+
   scoped_ptr<QuicServerInfoFactoryAdaptor> quic_server_info_factory_;
 
   scoped_ptr<HttpTransactionFactory> network_layer_;
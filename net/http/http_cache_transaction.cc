@@ -34,6 +34,7 @@
 #include "net/base/net_log.h"
 #include "net/base/upload_data_stream.h"
 #include "net/cert/cert_status_flags.h"
+#include "net/disk_cache/compressed_entry.h"
 #include "net/disk_cache/disk_cache.h"
 #include "net/http/disk_based_cert_cache.h"
 #include "net/http/http_network_session.h"
@@ -332,6 +333,8 @@ HttpCache::Transaction::Transaction(
       vary_mismatch_(false),
       couldnt_conditionalize_request_(false),
       bypass_lock_for_test_(false),
+      release_entry_while_validating_(false),
+      validating_without_entry_(false),
       io_buf_len_(0),
       read_offset_(0),
       effective_load_flags_(0),
@@ -930,6 +933,13 @@ int HttpCache::Transaction::DoLoop(int result) {
       case STATE_CACHE_READ_RESPONSE_COMPLETE:
         rv = DoCacheReadResponseComplete(rv);
         break;
+      case STATE_CACHE_OPEN_COMPRESSED_BODY:
+        DCHECK_EQ(OK, rv);
+        rv = DoCacheOpenCompressedBody();
+        break;
+      case STATE_CACHE_OPEN_COMPRESSED_BODY_COMPLETE:
+        rv = DoCacheOpenCompressedBodyComplete(rv);
+        break;
       case STATE_CACHE_WRITE_RESPONSE:
         DCHECK_EQ(OK, rv);
         rv = DoCacheWriteResponse();
@@ -1166,6 +1176,12 @@ int HttpCache::Transaction::DoSuccessfulSendRequest() {
     partial_.reset();
   }
 
+  if (validating_without_entry_) {
+    // Add to the entry again to apply the response.
+    next_state_ = STATE_INIT_ENTRY;
+    return OK;
+  }
+
   new_response_ = new_response;
   if (authentication_failure ||
       (!ValidatePartialResponse() && !auth_response_.headers.get())) {
@@ -1294,6 +1310,12 @@ int HttpCache::Transaction::DoOpenEntryComplete(int result) {
     return OK;
   }
 
+  if (validating_without_entry_) {
+    // The entry is gone, so there is nothing left to update.
+    mode_ = NONE;
+    return FinishValidatingWithoutEntry();
+  }
+
   if (request_->method == "PUT" || request_->method == "DELETE" ||
       (request_->method == "HEAD" && mode_ == READ_WRITE)) {
     DCHECK(mode_ == READ_WRITE || mode_ == WRITE || request_->method == "HEAD");
@@ -1444,6 +1466,8 @@ int HttpCache::Transaction::DoAddToEntryComplete(int result) {
   if (result == ERR_CACHE_LOCK_TIMEOUT) {
     // The cache is busy, bypass it for this transaction.
     mode_ = NONE;
+    if (validating_without_entry_)
+      return FinishValidatingWithoutEntry();
     next_state_ = STATE_SEND_REQUEST;
     if (partial_) {
       partial_->RestoreHeaders(&custom_request_->extra_headers);
@@ -1585,6 +1609,8 @@ int HttpCache::Transaction::DoOverwriteCachedResponse() {
     return OK;
   }
 
+  response_.body_compressed_in_cache = ShouldCompressBody();
+
   target_state_ = STATE_TRUNCATE_CACHED_DATA;
   next_state_ = truncated_ ? STATE_CACHE_WRITE_TRUNCATED_RESPONSE :
                              STATE_CACHE_WRITE_RESPONSE;
@@ -1607,6 +1633,9 @@ int HttpCache::Transaction::DoTruncateCachedDataComplete(int result) {
       net_log_.EndEventWithNetErrorCode(NetLog::TYPE_HTTP_CACHE_WRITE_DATA,
                                         result);
     }
+    // The new body is written to the now empty stream.
+    if (result == OK && response_.body_compressed_in_cache)
+      entry_->disk_entry->StartCompressedStream();
   }
 
   next_state_ = STATE_TRUNCATE_CACHED_METADATA;
@@ -1682,41 +1711,23 @@ int HttpCache::Transaction::DoCacheReadResponseComplete(int result) {
   if (cache_->cert_cache() && response_.ssl_info.is_valid())
     ReadCertChain();
 
-  // Some resources may have slipped in as truncated when they're not.
-  int current_size = entry_->disk_entry->GetDataSize(kResponseContentIndex);
-  if (response_.headers->GetContentLength() == current_size)
-    truncated_ = false;
-
-  // We now have access to the cache entry.
-  //
-  //  o if we are a reader for the transaction, then we can start reading the
-  //    cache entry.
-  //
-  //  o if we can read or write, then we should check if the cache entry needs
-  //    to be validated and then issue a network request if needed or just read
-  //    from the cache if the cache entry is already valid.
-  //
-  //  o if we are set to UPDATE, then we are handling an externally
-  //    conditionalized request (if-modified-since / if-none-match). We check
-  //    if the request headers define a validation request.
-  //
-  switch (mode_) {
-    case READ:
-      UpdateTransactionPattern(PATTERN_ENTRY_USED);
-      result = BeginCacheRead();
-      break;
-    case READ_WRITE:
-      result = BeginPartialCacheValidation();
-      break;
-    case UPDATE:
-      result = BeginExternallyConditionalizedRequest();
-      break;
-    case WRITE:
-    default:
-      NOTREACHED();
-      result = ERR_FAILED;
+  // The size of a compressed body is only known once it's open.
+  if (response_.body_compressed_in_cache) {
+    next_state_ = STATE_CACHE_OPEN_COMPRESSED_BODY;
+    return OK;
   }
-  return result;
+  return BeginCacheEntryUse();
+}
+
+int HttpCache::Transaction::DoCacheOpenCompressedBody() {
+  next_state_ = STATE_CACHE_OPEN_COMPRESSED_BODY_COMPLETE;
+  return entry_->disk_entry->OpenCompressedStream(io_callback_);
+}
+
+int HttpCache::Transaction::DoCacheOpenCompressedBodyComplete(int result) {
+  if (result != OK)
+    return OnCacheReadError(result, true);
+  return BeginCacheEntryUse();
 }
 
 int HttpCache::Transaction::DoCacheWriteResponse() {
@@ -2087,6 +2098,62 @@ bool HttpCache::Transaction::ShouldPassThrough() {
   return true;
 }
 
+bool HttpCache::Transaction::ShouldCompressBody() const {
+  // Range requests store the body in sparse data, which is never compressed,
+  // and encoded bodies don't compress any further.
+  if (partial_.get() || response_.headers->HasHeader("Content-Encoding"))
+    return false;
+  std::string mime_type;
+  return response_.headers->GetMimeType(&mime_type) &&
+         cache_->ShouldCompressMimeType(mime_type);
+}
+
+int HttpCache::Transaction::BeginCacheEntryUse() {
+  if (validating_without_entry_) {
+    // Another transaction may have replaced the entry in the meantime.
+    if (response_.response_time != validated_response_time_)
+      DoneWritingToEntry(true);
+    return FinishValidatingWithoutEntry();
+  }
+
+  // Some resources may have slipped in as truncated when they're not.
+  int current_size = entry_->disk_entry->GetDataSize(kResponseContentIndex);
+  if (response_.headers->GetContentLength() == current_size)
+    truncated_ = false;
+
+  // We now have access to the cache entry.
+  //
+  //  o if we are a reader for the transaction, then we can start reading the
+  //    cache entry.
+  //
+  //  o if we can read or write, then we should check if the cache entry needs
+  //    to be validated and then issue a network request if needed or just read
+  //    from the cache if the cache entry is already valid.
+  //
+  //  o if we are set to UPDATE, then we are handling an externally
+  //    conditionalized request (if-modified-since / if-none-match). We check
+  //    if the request headers define a validation request.
+  //
+  int result;
+  switch (mode_) {
+    case READ:
+      UpdateTransactionPattern(PATTERN_ENTRY_USED);
+      result = BeginCacheRead();
+      break;
+    case READ_WRITE:
+      result = BeginPartialCacheValidation();
+      break;
+    case UPDATE:
+      result = BeginExternallyConditionalizedRequest();
+      break;
+    case WRITE:
+    default:
+      NOTREACHED();
+      result = ERR_FAILED;
+  }
+  return result;
+}
+
 int HttpCache::Transaction::BeginCacheRead() {
   // We don't support any combination of LOAD_ONLY_FROM_CACHE and byte ranges.
   if (response_.headers->response_code() == 206 || partial_.get()) {
@@ -2139,6 +2206,11 @@ int HttpCache::Transaction::BeginCacheValidation() {
     skip_validation = false;
   }
 
+  if (!skip_validation && CanUseStaleWhileRevalidating()) {
+    TriggerAsyncValidation();
+    skip_validation = true;
+  }
+
   if (skip_validation) {
     UpdateTransactionPattern(PATTERN_ENTRY_USED);
     RecordOfflineStatus(effective_load_flags_, OFFLINE_STATUS_FRESH_CACHE);
@@ -2157,6 +2229,12 @@ int HttpCache::Transaction::BeginCacheValidation() {
         return DoRestartPartialRequest();
 
       DCHECK_NE(206, response_.headers->response_code());
+    } else if (release_entry_while_validating_ && !partial_.get()) {
+      // Let other transactions use the entry while the request is sent.
+      validating_without_entry_ = true;
+      validated_response_time_ = response_.response_time;
+      cache_->DoneWritingToEntry(entry_, true);
+      entry_ = NULL;
     }
     next_state_ = STATE_SEND_REQUEST;
   }
@@ -2328,6 +2406,38 @@ bool HttpCache::Transaction::RequiresValidation() {
   return false;
 }
 
+bool HttpCache::Transaction::CanUseStaleWhileRevalidating() {
+  if (!cache_->use_stale_while_revalidate() ||
+      cache_->mode() != net::HttpCache::NORMAL) {
+    return false;
+  }
+
+  // Validations asked for by the request, or required by a Vary mismatch,
+  // can't be deferred.
+  if (vary_mismatch_ || (effective_load_flags_ & LOAD_VALIDATE_CACHE))
+    return false;
+
+  // The revalidation repeats the request, and updates the whole entry.
+  if (request_->method != "GET" || request_->upload_data_stream ||
+      partial_.get() || truncated_ ||
+      response_.headers->response_code() != 200) {
+    return false;
+  }
+
+  return response_.headers->IsWithinStaleWhileRevalidate(
+      response_.request_time, response_.response_time, Time::Now());
+}
+
+void HttpCache::Transaction::TriggerAsyncValidation() {
+  net_log_.AddEvent(NetLog::TYPE_HTTP_CACHE_ASYNC_VALIDATION);
+
+  // Posted so that the revalidation doesn't start from within this
+  // transaction.
+  base::MessageLoop::current()->PostTask(
+      FROM_HERE,
+      base::Bind(&HttpCache::PerformAsyncValidation, cache_, *request_));
+}
+
 bool HttpCache::Transaction::ConditionalizeRequest() {
   DCHECK(response_.headers.get());
 
@@ -2422,6 +2532,12 @@ bool HttpCache::Transaction::ConditionalizeRequest() {
   return true;
 }
 
+int HttpCache::Transaction::FinishValidatingWithoutEntry() {
+  validating_without_entry_ = false;
+  next_state_ = STATE_SUCCESSFUL_SEND_REQUEST;
+  return OK;
+}
+
 // We just received some headers from the server. We may have asked for a range,
 // in which case partial_ has an object. This could be the first network request
 // we make to fulfill the original request, or we may be already reading (from
@@ -2665,9 +2781,15 @@ int HttpCache::Transaction::WriteResponseInfoToEntry(bool truncated) {
 
 int HttpCache::Transaction::AppendResponseDataToEntry(
     IOBuffer* data, int data_len, const CompletionCallback& callback) {
-  if (!entry_ || !data_len)
+  if (!entry_)
     return data_len;
 
+  // The network has no more data, for now at least: write the last block of a
+  // compressed body, so that it fails like any other write if it has to, and
+  // a truncated entry can be resumed by another transaction.
+  if (!data_len)
+    return entry_->disk_entry->Flush(callback);
+
   int current_size = entry_->disk_entry->GetDataSize(kResponseContentIndex);
   return WriteToEntry(kResponseContentIndex, current_size, data, data_len,
                       callback);
@@ -2699,6 +2821,14 @@ int HttpCache::Transaction::OnCacheReadError(int result, bool restart) {
   if (cache_.get())
     cache_->DoomActiveEntry(cache_key_);
 
+  if (restart && validating_without_entry_) {
+    // The response has nothing left to update.
+    cache_->DoneWithEntry(entry_, this, false);
+    entry_ = NULL;
+    mode_ = NONE;
+    return FinishValidatingWithoutEntry();
+  }
+
   if (restart) {
     DCHECK(!reading_);
     DCHECK(!network_trans_.get());
@@ -108,6 +108,13 @@ class HttpCache::Transaction : public HttpTransaction {
     bypass_lock_for_test_ = true;
   }
 
+  // Has a conditional request let go of the entry while it is sent, so that
+  // other transactions can use the entry in the meantime, and add to it again
+  // to apply the response. Used by the revalidations run in the background.
+  void ReleaseEntryWhileValidating() {
+    release_entry_while_validating_ = true;
+  }
+
   // HttpTransaction methods:
   virtual int Start(const HttpRequestInfo* request_info,
                     const CompletionCallback& callback,
@@ -184,6 +191,8 @@ class HttpCache::Transaction : public HttpTransaction {
     STATE_PARTIAL_HEADERS_RECEIVED,
     STATE_CACHE_READ_RESPONSE,
     STATE_CACHE_READ_RESPONSE_COMPLETE,
+    STATE_CACHE_OPEN_COMPRESSED_BODY,
+    STATE_CACHE_OPEN_COMPRESSED_BODY_COMPLETE,
     STATE_CACHE_WRITE_RESPONSE,
     STATE_CACHE_WRITE_TRUNCATED_RESPONSE,
     STATE_CACHE_WRITE_RESPONSE_COMPLETE,
@@ -255,6 +264,8 @@ class HttpCache::Transaction : public HttpTransaction {
   int DoPartialHeadersReceived();
   int DoCacheReadResponse();
   int DoCacheReadResponseComplete(int result);
+  int DoCacheOpenCompressedBody();
+  int DoCacheOpenCompressedBodyComplete(int result);
   int DoCacheWriteResponse();
   int DoCacheWriteTruncatedResponse();
   int DoCacheWriteResponseComplete(int result);
@@ -279,6 +290,13 @@ class HttpCache::Transaction : public HttpTransaction {
   // layer (skipping the cache entirely).
   bool ShouldPassThrough();
 
+  // Returns true if the body of response_ should be stored compressed.
+  bool ShouldCompressBody() const;
+
+  // Called once the cached response and the size of its body are known, to
+  // decide how to use the cache entry.  Returns network error code.
+  int BeginCacheEntryUse();
+
   // Called to begin reading from the cache.  Returns network error code.
   int BeginCacheRead();
 
@@ -314,10 +332,22 @@ class HttpCache::Transaction : public HttpTransaction {
   // Called to determine if we need to validate the cache entry before using it.
   bool RequiresValidation();
 
+  // Returns true if the cache entry, which requires validation, may be used
+  // while it is revalidated in the background, as its stale-while-revalidate
+  // directive allows.
+  bool CanUseStaleWhileRevalidating();
+
+  // Has the cache revalidate the entry with a transaction of its own.
+  void TriggerAsyncValidation();
+
   // Called to make the request conditional (to ask the server if the cached
   // copy is valid).  Returns true if able to make the request conditional.
   bool ConditionalizeRequest();
 
+  // Called once the response to a conditional request sent without the entry
+  // can be handled: the entry was added to again, or is gone. Returns OK.
+  int FinishValidatingWithoutEntry();
+
   // Makes sure that a 206 response is expected.  Returns true on success.
   // On success, handling_206_ will be set to true if we are processing a
   // partial entry.
@@ -353,7 +383,7 @@ class HttpCache::Transaction : public HttpTransaction {
   int WriteResponseInfoToEntry(bool truncated);
 
   // Called to append response data to the cache entry.  Returns a network error
-  // code.
+  // code.  An empty |data| flushes the data still buffered by the entry.
   int AppendResponseDataToEntry(IOBuffer* data, int data_len,
                                 const CompletionCallback& callback);
 
@@ -431,6 +461,11 @@ class HttpCache::Transaction : public HttpTransaction {
   bool vary_mismatch_;  // The request doesn't match the stored vary data.
   bool couldnt_conditionalize_request_;
   bool bypass_lock_for_test_;  // A test is exercising the cache lock.
+  bool release_entry_while_validating_;
+  // The conditional request is sent without the entry. The response is only
+  // applied to the version of the entry stored at |validated_response_time_|.
+  bool validating_without_entry_;
+  base::Time validated_response_time_;
   scoped_refptr<IOBuffer> read_buf_;
   int io_buf_len_;
   int read_offset_;
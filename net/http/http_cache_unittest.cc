@@ -22,6 +22,7 @@
 #include "net/base/upload_bytes_element_reader.h"
 #include "net/base/upload_data_stream.h"
 #include "net/cert/cert_status_flags.h"
+#include "net/disk_cache/compressed_entry.h"
 #include "net/disk_cache/disk_cache.h"
 #include "net/http/http_byte_range.h"
 #include "net/http/http_request_headers.h"
@@ -917,6 +918,73 @@ TEST(HttpCache, SimpleGET_LoadPreferringCache_VaryMismatch) {
   RemoveMockTransaction(&transaction);
 }
 
+// Tests that bodies of the configured types are stored compressed, and read
+// back as they were received.
+TEST(HttpCache, SimpleGET_CompressedBody) {
+  MockHttpCache cache;
+  std::vector<std::string> mime_types;
+  mime_types.push_back("text/*");
+  cache.http_cache()->set_compressed_mime_types(mime_types);
+
+  std::string body;
+  for (int i = 0; i < 2000; ++i)
+    body += base::StringPrintf("var item%d = lookup('item%d');\n", i % 7, i);
+
+  MockTransaction transaction(kSimpleGET_Transaction);
+  transaction.response_headers = "Cache-Control: max-age=10000\n"
+                                 "Content-Type: text/javascript\n";
+  transaction.data = body.c_str();
+  AddMockTransaction(&transaction);
+  RunTransactionTest(cache.http_cache(), transaction);
+
+  disk_cache::Entry* entry;
+  ASSERT_TRUE(cache.OpenBackendEntry(transaction.url, &entry));
+  net::HttpResponseInfo response;
+  bool truncated;
+  ASSERT_TRUE(MockHttpCache::ReadResponseInfo(entry, &response, &truncated));
+  EXPECT_TRUE(response.body_compressed_in_cache);
+  EXPECT_LT(entry->GetDataSize(1), static_cast<int>(body.size()) / 2);
+  entry->Close();
+
+  // Compressed bodies are read even once the policy is gone.
+  cache.http_cache()->set_compressed_mime_types(std::vector<std::string>());
+  RunTransactionTest(cache.http_cache(), transaction);
+
+  EXPECT_EQ(1, cache.network_layer()->transaction_count());
+  EXPECT_EQ(2, cache.disk_cache()->open_count());
+  EXPECT_EQ(1, cache.disk_cache()->create_count());
+  RemoveMockTransaction(&transaction);
+}
+
+// Tests that bodies with a Content-Encoding are stored as received.
+TEST(HttpCache, SimpleGET_CompressedBody_ContentEncoding) {
+  MockHttpCache cache;
+  std::vector<std::string> mime_types;
+  mime_types.push_back("text/*");
+  cache.http_cache()->set_compressed_mime_types(mime_types);
+
+  MockTransaction transaction(kSimpleGET_Transaction);
+  transaction.response_headers = "Cache-Control: max-age=10000\n"
+                                 "Content-Type: text/javascript\n"
+                                 "Content-Encoding: gzip\n";
+  AddMockTransaction(&transaction);
+  RunTransactionTest(cache.http_cache(), transaction);
+
+  disk_cache::Entry* entry;
+  ASSERT_TRUE(cache.OpenBackendEntry(transaction.url, &entry));
+  net::HttpResponseInfo response;
+  bool truncated;
+  ASSERT_TRUE(MockHttpCache::ReadResponseInfo(entry, &response, &truncated));
+  EXPECT_FALSE(response.body_compressed_in_cache);
+  EXPECT_EQ(static_cast<int>(strlen(transaction.data)),
+            entry->GetDataSize(1));
+  entry->Close();
+
+  RunTransactionTest(cache.http_cache(), transaction);
+  EXPECT_EQ(1, cache.network_layer()->transaction_count());
+  RemoveMockTransaction(&transaction);
+}
+
 // Tests that LOAD_FROM_CACHE_IF_OFFLINE returns proper response on
 // network success
 TEST(HttpCache, SimpleGET_CacheOverride_Network) {
@@ -5348,6 +5416,80 @@ TEST(HttpCache, GET_IncompleteResource) {
   RemoveMockTransaction(&kRangeGET_TransactionOK);
 }
 
+// Tests that a truncated entry with a compressed body is resumed by appending
+// to the compressed stream.
+TEST(HttpCache, GET_IncompleteResource_CompressedBody) {
+  MockHttpCache cache;
+  AddMockTransaction(&kRangeGET_TransactionOK);
+
+  // Create an entry that stores the first 20 bytes compressed.
+  disk_cache::Entry* entry;
+  ASSERT_TRUE(cache.CreateBackendEntry(kRangeGET_TransactionOK.url, &entry,
+                                       NULL));
+  std::string raw_headers("HTTP/1.1 200 OK\n"
+                          "Last-Modified: Sat, 18 Apr 2007 01:10:43 GMT\n"
+                          "ETag: \"foo\"\n"
+                          "Accept-Ranges: bytes\n"
+                          "Content-Length: 80\n");
+  raw_headers = net::HttpUtil::AssembleRawHeaders(raw_headers.data(),
+                                                  raw_headers.size());
+  net::HttpResponseInfo response;
+  response.response_time = base::Time::Now();
+  response.request_time = base::Time::Now();
+  response.headers = new net::HttpResponseHeaders(raw_headers);
+  response.body_compressed_in_cache = true;
+  EXPECT_TRUE(MockHttpCache::WriteResponseInfo(entry, &response, true, true));
+
+  disk_cache::CompressedEntry* compressed_entry =
+      new disk_cache::CompressedEntry(entry, 1);
+  compressed_entry->StartCompressedStream();
+  scoped_refptr<net::StringIOBuffer> buf(
+      new net::StringIOBuffer("rg: 00-09 rg: 10-19 "));
+  net::TestCompletionCallback cb;
+  int rv = compressed_entry->WriteData(1, 0, buf.get(), buf->size(),
+                                       cb.callback(), true);
+  EXPECT_EQ(buf->size(), cb.GetResult(rv));
+  rv = compressed_entry->Flush(cb.callback());
+  EXPECT_EQ(net::OK, cb.GetResult(rv));
+  compressed_entry->Close();
+
+  // Now make a regular request, which appends the rest of the body.
+  std::string headers;
+  MockTransaction transaction(kRangeGET_TransactionOK);
+  transaction.request_headers = EXTRA_HEADER;
+  transaction.data = "rg: 00-09 rg: 10-19 rg: 20-29 rg: 30-39 rg: 40-49 "
+                     "rg: 50-59 rg: 60-69 rg: 70-79 ";
+  RunTransactionTestWithResponse(cache.http_cache(), transaction, &headers);
+  EXPECT_EQ(2, cache.network_layer()->transaction_count());
+  EXPECT_EQ(1, cache.disk_cache()->open_count());
+  EXPECT_EQ(1, cache.disk_cache()->create_count());
+
+  // Verify that the whole body is stored, still compressed.
+  ASSERT_TRUE(cache.OpenBackendEntry(kRangeGET_TransactionOK.url, &entry));
+  bool truncated = true;
+  EXPECT_TRUE(MockHttpCache::ReadResponseInfo(entry, &response, &truncated));
+  EXPECT_FALSE(truncated);
+  EXPECT_TRUE(response.body_compressed_in_cache);
+
+  compressed_entry = new disk_cache::CompressedEntry(entry, 1);
+  rv = compressed_entry->OpenCompressedStream(cb.callback());
+  ASSERT_EQ(net::OK, cb.GetResult(rv));
+  EXPECT_EQ(80, compressed_entry->GetDataSize(1));
+  std::string body;
+  while (body.size() < 80) {
+    scoped_refptr<net::IOBuffer> read_buf(new net::IOBuffer(80));
+    rv = compressed_entry->ReadData(1, body.size(), read_buf.get(), 80,
+                                    cb.callback());
+    rv = cb.GetResult(rv);
+    ASSERT_LT(0, rv);
+    body.append(read_buf->data(), rv);
+  }
+  EXPECT_EQ(transaction.data, body);
+  compressed_entry->Close();
+
+  RemoveMockTransaction(&kRangeGET_TransactionOK);
+}
+
 // Tests the handling of no-store when revalidating a truncated entry.
 TEST(HttpCache, GET_IncompleteResource_NoStore) {
   MockHttpCache cache;
@@ -6823,6 +6965,237 @@ TEST(HttpCache, ResourceFreshnessHeaderNotSent) {
   EXPECT_EQ(2, cache.network_layer()->transaction_count());
 }
 
+const char kStaleWhileRevalidateHeaders[] =
+    "Last-Modified: Sat, 18 Apr 2007 01:10:43 GMT\n"
+    "Age: 3700\n"
+    "Cache-Control: max-age=3600,stale-while-revalidate=7200\n";
+
+static int g_stale_while_revalidate_validations = 0;
+
+// Answers the revalidation of kStaleWhileRevalidateHeaders with a 304 that
+// makes the entry fresh again.
+static void StaleWhileRevalidateHandler(const net::HttpRequestInfo* request,
+                                        std::string* response_status,
+                                        std::string* response_headers,
+                                        std::string* response_data) {
+  ++g_stale_while_revalidate_validations;
+  EXPECT_TRUE(request->extra_headers.HasHeader(
+      net::HttpRequestHeaders::kIfModifiedSince));
+  response_status->assign("HTTP/1.1 304 Not Modified");
+  response_headers->assign(
+      "Age: 0\n"
+      "Cache-Control: max-age=3600,stale-while-revalidate=7200\n");
+  response_data->clear();
+}
+
+// Tests that a stale entry within its stale-while-revalidate window is served
+// as is, and revalidated in the background.
+TEST(HttpCache, StaleWhileRevalidate_AsyncValidation) {
+  MockHttpCache cache;
+  cache.http_cache()->set_use_stale_while_revalidate(true);
+
+  ScopedMockTransaction transaction(kSimpleGET_Transaction);
+  transaction.response_headers = kStaleWhileRevalidateHeaders;
+  RunTransactionTest(cache.http_cache(), transaction);
+  EXPECT_EQ(1, cache.network_layer()->transaction_count());
+
+  g_stale_while_revalidate_validations = 0;
+  transaction.handler = StaleWhileRevalidateHandler;
+  net::HttpResponseInfo response;
+  RunTransactionTestWithResponseInfo(cache.http_cache(), transaction,
+                                     &response);
+  EXPECT_TRUE(response.was_cached);
+  EXPECT_FALSE(response.network_accessed);
+
+  // The revalidation makes the entry fresh.
+  base::MessageLoop::current()->RunUntilIdle();
+  EXPECT_EQ(2, cache.network_layer()->transaction_count());
+  EXPECT_EQ(1, g_stale_while_revalidate_validations);
+
+  RunTransactionTestWithResponseInfo(cache.http_cache(), transaction,
+                                     &response);
+  EXPECT_TRUE(response.was_cached);
+  base::MessageLoop::current()->RunUntilIdle();
+  EXPECT_EQ(2, cache.network_layer()->transaction_count());
+  EXPECT_EQ(1, g_stale_while_revalidate_validations);
+}
+
+// Tests that the stale entry is validated synchronously unless the policy is
+// enabled.
+TEST(HttpCache, StaleWhileRevalidate_Disabled) {
+  MockHttpCache cache;
+
+  ScopedMockTransaction transaction(kSimpleGET_Transaction);
+  transaction.response_headers = kStaleWhileRevalidateHeaders;
+  RunTransactionTest(cache.http_cache(), transaction);
+
+  g_stale_while_revalidate_validations = 0;
+  transaction.handler = StaleWhileRevalidateHandler;
+  net::HttpResponseInfo response;
+  RunTransactionTestWithResponseInfo(cache.http_cache(), transaction,
+                                     &response);
+  EXPECT_TRUE(response.network_accessed);
+  EXPECT_EQ(2, cache.network_layer()->transaction_count());
+  EXPECT_EQ(1, g_stale_while_revalidate_validations);
+}
+
+// Tests that entries past their window, and requests that ask for validation,
+// are validated synchronously.
+TEST(HttpCache, StaleWhileRevalidate_SyncValidation) {
+  const struct {
+    const char* response_headers;
+    int load_flags;
+  } kTests[] = {
+    { "Last-Modified: Sat, 18 Apr 2007 01:10:43 GMT\n"
+      "Age: 10801\n"
+      "Cache-Control: max-age=3600,stale-while-revalidate=7200\n",
+      net::LOAD_NORMAL },
+    { kStaleWhileRevalidateHeaders, net::LOAD_VALIDATE_CACHE },
+  };
+
+  for (size_t i = 0; i < arraysize(kTests); ++i) {
+    MockHttpCache cache;
+    cache.http_cache()->set_use_stale_while_revalidate(true);
+
+    ScopedMockTransaction transaction(kSimpleGET_Transaction);
+    transaction.response_headers = kTests[i].response_headers;
+    RunTransactionTest(cache.http_cache(), transaction);
+
+    g_stale_while_revalidate_validations = 0;
+    transaction.handler = StaleWhileRevalidateHandler;
+    transaction.load_flags = kTests[i].load_flags;
+    net::HttpResponseInfo response;
+    RunTransactionTestWithResponseInfo(cache.http_cache(), transaction,
+                                       &response);
+    EXPECT_TRUE(response.network_accessed) << i;
+
+    base::MessageLoop::current()->RunUntilIdle();
+    EXPECT_EQ(2, cache.network_layer()->transaction_count()) << i;
+    EXPECT_EQ(1, g_stale_while_revalidate_validations) << i;
+  }
+}
+
+// Tests that concurrent readers of a stale entry are all served the entry,
+// while it is revalidated once, after they are done with it.
+TEST(HttpCache, StaleWhileRevalidate_ConcurrentReaders) {
+  MockHttpCache cache;
+  cache.http_cache()->set_use_stale_while_revalidate(true);
+
+  ScopedMockTransaction transaction(kSimpleGET_Transaction);
+  transaction.response_headers = kStaleWhileRevalidateHeaders;
+  RunTransactionTest(cache.http_cache(), transaction);
+
+  g_stale_while_revalidate_validations = 0;
+  transaction.handler = StaleWhileRevalidateHandler;
+  MockHttpRequest request(transaction);
+
+  std::vector<Context*> context_list;
+  const int kNumTransactions = 3;
+  for (int i = 0; i < kNumTransactions; ++i) {
+    context_list.push_back(new Context());
+    Context* c = context_list[i];
+    c->result = cache.CreateTransaction(&c->trans);
+    ASSERT_EQ(net::OK, c->result);
+    c->result = c->trans->Start(
+        &request, c->callback.callback(), net::BoundNetLog());
+  }
+  base::MessageLoop::current()->RunUntilIdle();
+
+  // The revalidation waits for the readers of the entry.
+  for (int i = 0; i < kNumTransactions; ++i) {
+    Context* c = context_list[i];
+    if (c->result == net::ERR_IO_PENDING)
+      c->result = c->callback.WaitForResult();
+    ASSERT_EQ(net::OK, c->result);
+    EXPECT_TRUE(c->trans->GetResponseInfo()->was_cached);
+    EXPECT_FALSE(c->trans->GetResponseInfo()->network_accessed);
+    EXPECT_EQ(0, g_stale_while_revalidate_validations);
+    ReadAndVerifyTransaction(c->trans.get(), transaction);
+    delete c;
+  }
+
+  base::MessageLoop::current()->RunUntilIdle();
+  EXPECT_EQ(2, cache.network_layer()->transaction_count());
+  EXPECT_EQ(1, g_stale_while_revalidate_validations);
+  EXPECT_EQ(1, cache.disk_cache()->create_count());
+}
+
+static MockHttpCache* g_revalidated_cache = NULL;
+static MockHttpRequest* g_reader_request = NULL;
+static Context* g_reader = NULL;
+
+// Starts a reader of the entry while the revalidation is on the network, and
+// lets it run as far as it can before the server answers.
+static void StartReaderDuringRevalidationHandler(
+    const net::HttpRequestInfo* request,
+    std::string* response_status,
+    std::string* response_headers,
+    std::string* response_data) {
+  StaleWhileRevalidateHandler(request, response_status, response_headers,
+                              response_data);
+  if (!g_reader || g_reader->trans.get())
+    return;
+
+  g_reader->result = g_revalidated_cache->CreateTransaction(&g_reader->trans);
+  ASSERT_EQ(net::OK, g_reader->result);
+  g_reader->result = g_reader->trans->Start(
+      g_reader_request, g_reader->callback.callback(), net::BoundNetLog());
+
+  base::MessageLoop::ScopedNestableTaskAllower allow(
+      base::MessageLoop::current());
+  base::MessageLoop::current()->RunUntilIdle();
+  if (g_reader->result == net::ERR_IO_PENDING &&
+      g_reader->callback.have_result()) {
+    g_reader->result = g_reader->callback.WaitForResult();
+  }
+}
+
+// Tests that the entry can be read while it is revalidated in the background,
+// without waiting for the server to answer.
+TEST(HttpCache, StaleWhileRevalidate_ReadDuringValidation) {
+  MockHttpCache cache;
+  cache.http_cache()->set_use_stale_while_revalidate(true);
+
+  ScopedMockTransaction transaction(kSimpleGET_Transaction);
+  transaction.response_headers = kStaleWhileRevalidateHeaders;
+  RunTransactionTest(cache.http_cache(), transaction);
+
+  g_stale_while_revalidate_validations = 0;
+  transaction.handler = StartReaderDuringRevalidationHandler;
+  MockHttpRequest request(transaction);
+  Context reader;
+  g_revalidated_cache = &cache;
+  g_reader_request = &request;
+  g_reader = &reader;
+
+  net::HttpResponseInfo response;
+  RunTransactionTestWithResponseInfo(cache.http_cache(), transaction,
+                                     &response);
+  EXPECT_TRUE(response.was_cached);
+
+  // The reader was done before the revalidation got its response.
+  base::MessageLoop::current()->RunUntilIdle();
+  g_reader = NULL;
+  ASSERT_TRUE(reader.trans.get());
+  ASSERT_EQ(net::OK, reader.result);
+  EXPECT_TRUE(reader.trans->GetResponseInfo()->was_cached);
+  EXPECT_FALSE(reader.trans->GetResponseInfo()->network_accessed);
+  ReadAndVerifyTransaction(reader.trans.get(), transaction);
+  reader.trans.reset();
+
+  // The response is applied once the reader lets go of the entry.
+  base::MessageLoop::current()->RunUntilIdle();
+  EXPECT_EQ(2, cache.network_layer()->transaction_count());
+  EXPECT_EQ(1, g_stale_while_revalidate_validations);
+
+  RunTransactionTestWithResponseInfo(cache.http_cache(), transaction,
+                                     &response);
+  EXPECT_TRUE(response.was_cached);
+  base::MessageLoop::current()->RunUntilIdle();
+  EXPECT_EQ(2, cache.network_layer()->transaction_count());
+  EXPECT_EQ(1, cache.disk_cache()->create_count());
+}
+
 // Tests that we allow multiple simultaneous, non-overlapping transactions to
 // take place on a sparse entry.
 TEST(HttpCache, RangeGET_MultipleRequests) {
@@ -4,6 +4,7 @@
 
 #include "net/http/http_request_headers.h"
 
+#include "base/lazy_instance.h"
 #include "base/logging.h"
 #include "base/strings/string_split.h"
 #include "base/strings/string_util.h"
@@ -14,6 +15,13 @@
 
 namespace net {
 
+namespace {
+
+base::LazyInstance<HttpRequestHeaders::HeaderVector>::Leaky g_empty_headers =
+    LAZY_INSTANCE_INITIALIZER;
+
+}  // namespace
+
 const char HttpRequestHeaders::kGetMethod[] = "GET";
 const char HttpRequestHeaders::kAcceptCharset[] = "Accept-Charset";
 const char HttpRequestHeaders::kAcceptEncoding[] = "Accept-Encoding";
@@ -48,8 +56,8 @@ HttpRequestHeaders::HeaderKeyValuePair::HeaderKeyValuePair(
 
 HttpRequestHeaders::Iterator::Iterator(const HttpRequestHeaders& headers)
     : started_(false),
-      curr_(headers.headers_.begin()),
-      end_(headers.headers_.end()) {}
+      curr_(headers.headers().begin()),
+      end_(headers.headers().end()) {}
 
 HttpRequestHeaders::Iterator::~Iterator() {}
 
@@ -72,14 +80,14 @@ HttpRequestHeaders::~HttpRequestHeaders() {}
 bool HttpRequestHeaders::GetHeader(const base::StringPiece& key,
                                    std::string* out) const {
   HeaderVector::const_iterator it = FindHeader(key);
-  if (it == headers_.end())
+  if (it == headers().end())
     return false;
   out->assign(it->value);
   return true;
 }
 
 void HttpRequestHeaders::Clear() {
-  headers_.clear();
+  headers_ = NULL;
 }
 
 void HttpRequestHeaders::SetHeader(const base::StringPiece& key,
@@ -87,25 +95,25 @@ void HttpRequestHeaders::SetHeader(const base::StringPiece& key,
   DCHECK(HttpUtil::IsValidHeaderName(key.as_string()));
   DCHECK(HttpUtil::IsValidHeaderValue(value.as_string()));
   HeaderVector::iterator it = FindHeader(key);
-  if (it != headers_.end())
+  if (it != mutable_headers()->end())
     it->value.assign(value.data(), value.size());
   else
-    headers_.push_back(HeaderKeyValuePair(key, value));
+    mutable_headers()->push_back(HeaderKeyValuePair(key, value));
 }
 
 void HttpRequestHeaders::SetHeaderIfMissing(const base::StringPiece& key,
                                             const base::StringPiece& value) {
   DCHECK(HttpUtil::IsValidHeaderName(key.as_string()));
   DCHECK(HttpUtil::IsValidHeaderValue(value.as_string()));
-  HeaderVector::iterator it = FindHeader(key);
-  if (it == headers_.end())
-    headers_.push_back(HeaderKeyValuePair(key, value));
+  if (!HasHeader(key))
+    mutable_headers()->push_back(HeaderKeyValuePair(key, value));
 }
 
 void HttpRequestHeaders::RemoveHeader(const base::StringPiece& key) {
+  if (!HasHeader(key))
+    return;
   HeaderVector::iterator it = FindHeader(key);
-  if (it != headers_.end())
-    headers_.erase(it);
+  mutable_headers()->erase(it);
 }
 
 void HttpRequestHeaders::AddHeaderFromString(
@@ -167,16 +175,20 @@ void HttpRequestHeaders::AddHeadersFromString(
 }
 
 void HttpRequestHeaders::MergeFrom(const HttpRequestHeaders& other) {
-  for (HeaderVector::const_iterator it = other.headers_.begin();
-       it != other.headers_.end(); ++it ) {
+  if (IsEmpty()) {
+    CopyFrom(other);
+    return;
+  }
+  for (HeaderVector::const_iterator it = other.headers().begin();
+       it != other.headers().end(); ++it ) {
     SetHeader(it->key, it->value);
   }
 }
 
 std::string HttpRequestHeaders::ToString() const {
   std::string output;
-  for (HeaderVector::const_iterator it = headers_.begin();
-       it != headers_.end(); ++it) {
+  for (HeaderVector::const_iterator it = headers().begin();
+       it != headers().end(); ++it) {
     if (!it->value.empty()) {
       base::StringAppendF(&output, "%s: %s\r\n",
                           it->key.c_str(), it->value.c_str());
@@ -193,16 +205,16 @@ base::Value* HttpRequestHeaders::NetLogCallback(
     NetLog::LogLevel log_level) const {
   base::DictionaryValue* dict = new base::DictionaryValue();
   dict->SetString("line", *request_line);
-  base::ListValue* headers = new base::ListValue();
-  for (HeaderVector::const_iterator it = headers_.begin();
-       it != headers_.end(); ++it) {
+  base::ListValue* header_list = new base::ListValue();
+  for (HeaderVector::const_iterator it = headers().begin();
+       it != headers().end(); ++it) {
     std::string log_value = ElideHeaderValueForNetLog(
         log_level, it->key, it->value);
-    headers->Append(new base::StringValue(
+    header_list->Append(new base::StringValue(
         base::StringPrintf("%s: %s",
                            it->key.c_str(), log_value.c_str())));
   }
-  dict->Set("headers", headers);
+  dict->Set("headers", header_list);
   return dict;
 }
 
@@ -237,28 +249,43 @@ bool HttpRequestHeaders::FromNetLogParam(const base::Value* event_param,
   return true;
 }
 
+const HttpRequestHeaders::HeaderVector& HttpRequestHeaders::headers() const {
+  if (!headers_.get())
+    return g_empty_headers.Get();
+  return headers_->data;
+}
+
+HttpRequestHeaders::HeaderVector* HttpRequestHeaders::mutable_headers() {
+  if (!headers_.get())
+    headers_ = new SharedHeaderVector;
+  else if (!headers_->HasOneRef())
+    headers_ = new SharedHeaderVector(headers_->data);
+  return &headers_->data;
+}
+
 HttpRequestHeaders::HeaderVector::iterator
 HttpRequestHeaders::FindHeader(const base::StringPiece& key) {
-  for (HeaderVector::iterator it = headers_.begin();
-       it != headers_.end(); ++it) {
+  HeaderVector* headers = mutable_headers();
+  for (HeaderVector::iterator it = headers->begin();
+       it != headers->end(); ++it) {
     if (key.length() == it->key.length() &&
         !base::strncasecmp(key.data(), it->key.data(), key.length()))
       return it;
   }
 
-  return headers_.end();
+  return headers->end();
 }
 
 HttpRequestHeaders::HeaderVector::const_iterator
 HttpRequestHeaders::FindHeader(const base::StringPiece& key) const {
-  for (HeaderVector::const_iterator it = headers_.begin();
-       it != headers_.end(); ++it) {
+  for (HeaderVector::const_iterator it = headers().begin();
+       it != headers().end(); ++it) {
     if (key.length() == it->key.length() &&
         !base::strncasecmp(key.data(), it->key.data(), key.length()))
       return it;
   }
 
-  return headers_.end();
+  return headers().end();
 }
 
 }  // namespace net
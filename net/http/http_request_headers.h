@@ -6,6 +6,10 @@
 // It maintains these in a vector of header key/value pairs, thereby maintaining
 // the order of the headers.  This means that any lookups are linear time
 // operations.
+//
+// Copies share the vector until one of them is modified, so that copying the
+// headers of a request, as the cache and network transactions do, does not
+// copy the headers themselves.
 
 #ifndef NET_HTTP_HTTP_REQUEST_HEADERS_H_
 #define NET_HTTP_HTTP_REQUEST_HEADERS_H_
@@ -14,6 +18,7 @@
 #include <vector>
 
 #include "base/basictypes.h"
+#include "base/memory/ref_counted.h"
 #include "base/strings/string_piece.h"
 #include "net/base/net_export.h"
 #include "net/base/net_log.h"
@@ -82,10 +87,10 @@ class NET_EXPORT HttpRequestHeaders {
   HttpRequestHeaders();
   ~HttpRequestHeaders();
 
-  bool IsEmpty() const { return headers_.empty(); }
+  bool IsEmpty() const { return headers().empty(); }
 
   bool HasHeader(const base::StringPiece& key) const {
-    return FindHeader(key) != headers_.end();
+    return FindHeader(key) != headers().end();
   }
 
   // Gets the first header that matches |key|.  If found, returns true and
@@ -131,7 +136,8 @@ class NET_EXPORT HttpRequestHeaders {
   // Calls SetHeader() on each header from |other|, maintaining order.
   void MergeFrom(const HttpRequestHeaders& other);
 
-  // Copies from |other| to |this|.
+  // Copies from |other| to |this|. This only takes a reference to the headers
+  // of |other|.
   void CopyFrom(const HttpRequestHeaders& other) {
     *this = other;
   }
@@ -160,10 +166,20 @@ class NET_EXPORT HttpRequestHeaders {
                               std::string* request_line);
 
  private:
+  typedef base::RefCountedData<HeaderVector> SharedHeaderVector;
+
+  // Returns the headers, for reading.
+  const HeaderVector& headers() const;
+
+  // Returns the headers, for modifying them, after copying them if they are
+  // shared with other copies.
+  HeaderVector* mutable_headers();
+
   HeaderVector::iterator FindHeader(const base::StringPiece& key);
   HeaderVector::const_iterator FindHeader(const base::StringPiece& key) const;
 
-  HeaderVector headers_;
+  // NULL when there are no headers.
+  scoped_refptr<SharedHeaderVector> headers_;
 
   // Allow the copy construction and operator= to facilitate copying in
   // HttpRequestHeaders.
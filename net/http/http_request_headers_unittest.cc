@@ -165,6 +165,34 @@ TEST(HttpRequestHeaders, CopyFrom) {
   EXPECT_EQ("B: b\r\nC: c\r\n\r\n", headers.ToString());
 }
 
+// Copies share the headers until one of them is changed.
+TEST(HttpRequestHeaders, CopyOnWrite) {
+  HttpRequestHeaders headers;
+  headers.SetHeader("A", "A");
+  headers.SetHeader("B", "B");
+
+  HttpRequestHeaders headers2(headers);
+  headers2.SetHeader("B", "b");
+  HttpRequestHeaders headers3;
+  headers3.CopyFrom(headers);
+  headers3.RemoveHeader("A");
+  headers3.RemoveHeader("C");
+  HttpRequestHeaders headers4 = headers;
+  headers4.SetHeaderIfMissing("A", "a");
+  headers4.SetHeaderIfMissing("C", "c");
+  headers.Clear();
+
+  EXPECT_TRUE(headers.IsEmpty());
+  EXPECT_EQ("A: A\r\nB: b\r\n\r\n", headers2.ToString());
+  EXPECT_EQ("B: B\r\n\r\n", headers3.ToString());
+  EXPECT_EQ("A: A\r\nB: B\r\nC: c\r\n\r\n", headers4.ToString());
+
+  headers.MergeFrom(headers4);
+  headers.SetHeader("D", "d");
+  EXPECT_EQ("A: A\r\nB: B\r\nC: c\r\nD: d\r\n\r\n", headers.ToString());
+  EXPECT_EQ("A: A\r\nB: B\r\nC: c\r\n\r\n", headers4.ToString());
+}
+
 TEST(HttpRequestHeaders, ToNetLogParamAndBackAgain) {
   HttpRequestHeaders headers;
   headers.SetHeader("B", "b");
@@ -134,7 +134,8 @@ struct HttpResponseHeaders::ParsedHeader {
 //-----------------------------------------------------------------------------
 
 HttpResponseHeaders::HttpResponseHeaders(const std::string& raw_input)
-    : response_code_(-1) {
+    : raw_headers_(new base::RefCountedString),
+      response_code_(-1) {
   Parse(raw_input);
 
   // The most important thing to do with this histogram is find out
@@ -158,15 +159,32 @@ HttpResponseHeaders::HttpResponseHeaders(const std::string& raw_input)
 
 HttpResponseHeaders::HttpResponseHeaders(const Pickle& pickle,
                                          PickleIterator* iter)
-    : response_code_(-1) {
+    : raw_headers_(new base::RefCountedString),
+      response_code_(-1) {
   std::string raw_input;
   if (pickle.ReadString(iter, &raw_input))
     Parse(raw_input);
 }
 
+scoped_refptr<HttpResponseHeaders> HttpResponseHeaders::Clone() const {
+  scoped_refptr<HttpResponseHeaders> clone(new HttpResponseHeaders);
+  // |parsed_| points into the header block, which is never modified, so the
+  // clone can use it as is.
+  clone->raw_headers_ = raw_headers_;
+  clone->parsed_ = parsed_;
+  clone->response_code_ = response_code_;
+  clone->http_version_ = http_version_;
+  clone->parsed_http_version_ = parsed_http_version_;
+  return clone;
+}
+
+base::SharedStringPiece HttpResponseHeaders::raw_headers_block() const {
+  return base::SharedStringPiece(raw_headers_);
+}
+
 void HttpResponseHeaders::Persist(Pickle* pickle, PersistOptions options) {
   if (options == PERSIST_RAW) {
-    pickle->WriteString(raw_headers_);
+    pickle->WriteString(raw_headers());
     return;  // Done.
   }
 
@@ -192,12 +210,12 @@ void HttpResponseHeaders::Persist(Pickle* pickle, PersistOptions options) {
     AddSecurityStateHeaders(&filter_headers);
 
   std::string blob;
-  blob.reserve(raw_headers_.size());
+  blob.reserve(raw_headers().size());
 
   // This copies the status line w/ terminator null.
   // Note raw_headers_ has embedded nulls instead of \n,
   // so this just copies the first header line.
-  blob.assign(raw_headers_.c_str(), strlen(raw_headers_.c_str()) + 1);
+  blob.assign(raw_headers().c_str(), strlen(raw_headers().c_str()) + 1);
 
   for (size_t i = 0; i < parsed_.size(); ++i) {
     DCHECK(!parsed_[i].is_continuation());
@@ -228,7 +246,7 @@ void HttpResponseHeaders::Update(const HttpResponseHeaders& new_headers) {
          new_headers.response_code() == 206);
 
   // Copy up to the null byte.  This just copies the status line.
-  std::string new_raw_headers(raw_headers_.c_str());
+  std::string new_raw_headers(raw_headers().c_str());
   new_raw_headers.push_back('\0');
 
   HeaderSet updated_headers;
@@ -291,14 +309,13 @@ void HttpResponseHeaders::MergeWithHeaders(const std::string& raw_headers,
   new_raw_headers.push_back('\0');
 
   // Make this object hold the new data.
-  raw_headers_.clear();
   parsed_.clear();
   Parse(new_raw_headers);
 }
 
 void HttpResponseHeaders::RemoveHeader(const std::string& name) {
   // Copy up to the null byte.  This just copies the status line.
-  std::string new_raw_headers(raw_headers_.c_str());
+  std::string new_raw_headers(raw_headers().c_str());
   new_raw_headers.push_back('\0');
 
   std::string lowercase_name(name);
@@ -316,7 +333,7 @@ void HttpResponseHeaders::RemoveHeaderLine(const std::string& name,
   std::string new_raw_headers(GetStatusLine());
   new_raw_headers.push_back('\0');
 
-  new_raw_headers.reserve(raw_headers_.size());
+  new_raw_headers.reserve(raw_headers().size());
 
   void* iter = NULL;
   std::string old_header_name;
@@ -338,23 +355,21 @@ void HttpResponseHeaders::RemoveHeaderLine(const std::string& name,
   new_raw_headers.push_back('\0');
 
   // Make this object hold the new data.
-  raw_headers_.clear();
   parsed_.clear();
   Parse(new_raw_headers);
 }
 
 void HttpResponseHeaders::AddHeader(const std::string& header) {
   CheckDoesNotHaveEmbededNulls(header);
-  DCHECK_EQ('\0', raw_headers_[raw_headers_.size() - 2]);
-  DCHECK_EQ('\0', raw_headers_[raw_headers_.size() - 1]);
+  DCHECK_EQ('\0', raw_headers()[raw_headers().size() - 2]);
+  DCHECK_EQ('\0', raw_headers()[raw_headers().size() - 1]);
   // Don't copy the last null.
-  std::string new_raw_headers(raw_headers_, 0, raw_headers_.size() - 1);
+  std::string new_raw_headers(raw_headers(), 0, raw_headers().size() - 1);
   new_raw_headers.append(header);
   new_raw_headers.push_back('\0');
   new_raw_headers.push_back('\0');
 
   // Make this object hold the new data.
-  raw_headers_.clear();
   parsed_.clear();
   Parse(new_raw_headers);
 }
@@ -396,7 +411,11 @@ void HttpResponseHeaders::UpdateWithNewRange(
 }
 
 void HttpResponseHeaders::Parse(const std::string& raw_input) {
-  raw_headers_.reserve(raw_input.size());
+  // Start a new header block rather than modifying the current one, which may
+  // be shared with clones of these headers.
+  raw_headers_ = new base::RefCountedString;
+  std::string& raw_headers = raw_headers_->data();
+  raw_headers.reserve(raw_input.size());
 
   // ParseStatusLine adds a normalized status line to raw_headers_
   std::string::const_iterator line_begin = raw_input.begin();
@@ -408,34 +427,34 @@ void HttpResponseHeaders::Parse(const std::string& raw_input) {
                       (line_end + 1) != raw_input.end() &&
                       *(line_end + 1) != '\0');
   ParseStatusLine(line_begin, line_end, has_headers);
-  raw_headers_.push_back('\0');  // Terminate status line with a null.
+  raw_headers.push_back('\0');  // Terminate status line with a null.
 
   if (line_end == raw_input.end()) {
-    raw_headers_.push_back('\0');  // Ensure the headers end with a double null.
+    raw_headers.push_back('\0');  // Ensure the headers end with a double null.
 
-    DCHECK_EQ('\0', raw_headers_[raw_headers_.size() - 2]);
-    DCHECK_EQ('\0', raw_headers_[raw_headers_.size() - 1]);
+    DCHECK_EQ('\0', raw_headers[raw_headers.size() - 2]);
+    DCHECK_EQ('\0', raw_headers[raw_headers.size() - 1]);
     return;
   }
 
   // Including a terminating null byte.
-  size_t status_line_len = raw_headers_.size();
+  size_t status_line_len = raw_headers.size();
 
   // Now, we add the rest of the raw headers to raw_headers_, and begin parsing
   // it (to populate our parsed_ vector).
-  raw_headers_.append(line_end + 1, raw_input.end());
+  raw_headers.append(line_end + 1, raw_input.end());
 
   // Ensure the headers end with a double null.
-  while (raw_headers_.size() < 2 ||
-         raw_headers_[raw_headers_.size() - 2] != '\0' ||
-         raw_headers_[raw_headers_.size() - 1] != '\0') {
-    raw_headers_.push_back('\0');
+  while (raw_headers.size() < 2 ||
+         raw_headers[raw_headers.size() - 2] != '\0' ||
+         raw_headers[raw_headers.size() - 1] != '\0') {
+    raw_headers.push_back('\0');
   }
 
   // Adjust to point at the null byte following the status line
-  line_end = raw_headers_.begin() + status_line_len - 1;
+  line_end = raw_headers.begin() + status_line_len - 1;
 
-  HttpUtil::HeadersIterator headers(line_end + 1, raw_headers_.end(),
+  HttpUtil::HeadersIterator headers(line_end + 1, raw_headers.end(),
                                     std::string(1, '\0'));
   while (headers.GetNext()) {
     AddHeader(headers.name_begin(),
@@ -444,14 +463,14 @@ void HttpResponseHeaders::Parse(const std::string& raw_input) {
               headers.values_end());
   }
 
-  DCHECK_EQ('\0', raw_headers_[raw_headers_.size() - 2]);
-  DCHECK_EQ('\0', raw_headers_[raw_headers_.size() - 1]);
+  DCHECK_EQ('\0', raw_headers[raw_headers.size() - 2]);
+  DCHECK_EQ('\0', raw_headers[raw_headers.size() - 1]);
 }
 
 // Append all of our headers to the final output string.
 void HttpResponseHeaders::GetNormalizedHeaders(std::string* output) const {
   // copy up to the null byte.  this just copies the status line.
-  output->assign(raw_headers_.c_str());
+  output->assign(raw_headers().c_str());
 
   // headers may appear multiple times (not necessarily in succession) in the
   // header data, so we build a map from header name to generated header lines.
@@ -533,7 +552,7 @@ bool HttpResponseHeaders::GetNormalizedHeader(const std::string& name,
 
 std::string HttpResponseHeaders::GetStatusLine() const {
   // copy up to the null byte.
-  return std::string(raw_headers_.c_str());
+  return std::string(raw_headers().c_str());
 }
 
 std::string HttpResponseHeaders::GetStatusText() const {
@@ -572,6 +591,21 @@ bool HttpResponseHeaders::EnumerateHeaderLines(void** iter,
 bool HttpResponseHeaders::EnumerateHeader(void** iter,
                                           const base::StringPiece& name,
                                           std::string* value) const {
+  std::string::const_iterator value_begin;
+  std::string::const_iterator value_end;
+  if (!EnumerateHeaderRange(iter, name, &value_begin, &value_end)) {
+    value->clear();
+    return false;
+  }
+  value->assign(value_begin, value_end);
+  return true;
+}
+
+bool HttpResponseHeaders::EnumerateHeaderRange(
+    void** iter,
+    const base::StringPiece& name,
+    std::string::const_iterator* value_begin,
+    std::string::const_iterator* value_end) const {
   size_t i;
   if (!iter || !*iter) {
     i = FindHeader(0, name);
@@ -584,14 +618,31 @@ bool HttpResponseHeaders::EnumerateHeader(void** iter,
     }
   }
 
-  if (i == std::string::npos) {
-    value->clear();
+  if (i == std::string::npos)
     return false;
-  }
 
   if (iter)
     *iter = reinterpret_cast<void*>(i + 1);
-  value->assign(parsed_[i].value_begin, parsed_[i].value_end);
+  *value_begin = parsed_[i].value_begin;
+  *value_end = parsed_[i].value_end;
+  return true;
+}
+
+bool HttpResponseHeaders::EnumerateHeader(
+    void** iter,
+    const base::StringPiece& name,
+    base::SharedStringPiece* value) const {
+  std::string::const_iterator value_begin;
+  std::string::const_iterator value_end;
+  if (!EnumerateHeaderRange(iter, name, &value_begin, &value_end)) {
+    *value = base::SharedStringPiece();
+    return false;
+  }
+  const std::string& raw_headers = raw_headers_->data();
+  size_t offset = value_begin - raw_headers.begin();
+  *value = base::SharedStringPiece(
+      raw_headers_,
+      base::StringPiece(raw_headers.data() + offset, value_end - value_begin));
   return true;
 }
 
@@ -614,7 +665,9 @@ bool HttpResponseHeaders::HasHeader(const base::StringPiece& name) const {
   return FindHeader(0, name) != std::string::npos;
 }
 
-HttpResponseHeaders::HttpResponseHeaders() : response_code_(-1) {
+HttpResponseHeaders::HttpResponseHeaders()
+    : raw_headers_(new base::RefCountedString),
+      response_code_(-1) {
 }
 
 HttpResponseHeaders::~HttpResponseHeaders() {
@@ -676,14 +729,14 @@ void HttpResponseHeaders::ParseStatusLine(
   // Clamp the version number to one of: {0.9, 1.0, 1.1}
   if (parsed_http_version_ == HttpVersion(0, 9) && !has_headers) {
     http_version_ = HttpVersion(0, 9);
-    raw_headers_ = "HTTP/0.9";
+    raw_headers_->data() = "HTTP/0.9";
   } else if (parsed_http_version_ >= HttpVersion(1, 1)) {
     http_version_ = HttpVersion(1, 1);
-    raw_headers_ = "HTTP/1.1";
+    raw_headers_->data() = "HTTP/1.1";
   } else {
     // Treat everything else like HTTP 1.0
     http_version_ = HttpVersion(1, 0);
-    raw_headers_ = "HTTP/1.0";
+    raw_headers_->data() = "HTTP/1.0";
   }
   if (parsed_http_version_ != http_version_) {
     DVLOG(1) << "assuming HTTP/" << http_version_.major_value() << "."
@@ -695,7 +748,7 @@ void HttpResponseHeaders::ParseStatusLine(
 
   if (p == line_end) {
     DVLOG(1) << "missing response status; assuming 200 OK";
-    raw_headers_.append(" 200 OK");
+    raw_headers_->data().append(" 200 OK");
     response_code_ = 200;
     return;
   }
@@ -710,13 +763,13 @@ void HttpResponseHeaders::ParseStatusLine(
 
   if (p == code) {
     DVLOG(1) << "missing response status number; assuming 200";
-    raw_headers_.append(" 200 OK");
+    raw_headers_->data().append(" 200 OK");
     response_code_ = 200;
     return;
   }
-  raw_headers_.push_back(' ');
-  raw_headers_.append(code, p);
-  raw_headers_.push_back(' ');
+  raw_headers_->data().push_back(' ');
+  raw_headers_->data().append(code, p);
+  raw_headers_->data().push_back(' ');
   base::StringToInt(StringPiece(code, p), &response_code_);
 
   // Skip whitespace.
@@ -731,9 +784,9 @@ void HttpResponseHeaders::ParseStatusLine(
     DVLOG(1) << "missing response status text; assuming OK";
     // Not super critical what we put here. Just use "OK"
     // even if it isn't descriptive of response_code_.
-    raw_headers_.append("OK");
+    raw_headers_->data().append("OK");
   } else {
-    raw_headers_.append(p, line_end);
+    raw_headers_->data().append(p, line_end);
   }
 }
 
@@ -792,7 +845,7 @@ void HttpResponseHeaders::AddHeader(std::string::const_iterator name_begin,
     while (it.GetNext()) {
       AddToParsed(name_begin, name_end, it.value_begin(), it.value_end());
       // clobber these so that subsequent values are treated as continuations
-      name_begin = name_end = raw_headers_.end();
+      name_begin = name_end = raw_headers().end();
     }
   }
 }
@@ -967,6 +1020,36 @@ bool HttpResponseHeaders::RequiresValidation(const Time& request_time,
   return lifetime <= GetCurrentAge(request_time, response_time, current_time);
 }
 
+// From RFC 5861 section 3:
+//
+// When present in an HTTP response, the stale-while-revalidate Cache-Control
+// extension indicates that caches MAY serve the response in which it appears
+// after it becomes stale, up to the indicated number of seconds.
+//
+// The directives that forbid serving a stale response still apply.
+//
+bool HttpResponseHeaders::IsWithinStaleWhileRevalidate(
+    const Time& request_time,
+    const Time& response_time,
+    const Time& current_time) const {
+  if (HasHeaderValue("cache-control", "no-cache") ||
+      HasHeaderValue("cache-control", "no-store") ||
+      HasHeaderValue("cache-control", "must-revalidate") ||
+      HasHeaderValue("pragma", "no-cache") ||
+      HasHeaderValue("vary", "*"))
+    return false;
+
+  TimeDelta stale_while_revalidate;
+  if (!GetStaleWhileRevalidateValue(&stale_while_revalidate) ||
+      stale_while_revalidate <= TimeDelta()) {
+    return false;
+  }
+
+  TimeDelta lifetime = GetFreshnessLifetime(response_time);
+  TimeDelta age = GetCurrentAge(request_time, response_time, current_time);
+  return lifetime <= age && age < lifetime + stale_while_revalidate;
+}
+
 // From RFC 2616 section 13.2.4:
 //
 // The max-age directive takes priority over Expires, so if max-age is present
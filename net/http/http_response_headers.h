@@ -11,6 +11,8 @@
 #include "base/basictypes.h"
 #include "base/containers/hash_tables.h"
 #include "base/memory/ref_counted.h"
+#include "base/memory/ref_counted_memory.h"
+#include "base/strings/shared_string_piece.h"
 #include "base/strings/string_piece.h"
 #include "net/base/net_export.h"
 #include "net/base/net_log.h"
@@ -60,6 +62,12 @@ class NET_EXPORT HttpResponseHeaders
   // be passed to the pickle's various Read* methods.
   HttpResponseHeaders(const Pickle& pickle, PickleIterator* pickle_iter);
 
+  // Returns a copy of these headers, which shares their header block rather
+  // than copying and parsing it again, so it is cheap to make one for another
+  // thread or for a consumer that modifies it. Modifying either the copy or
+  // these headers gives it a header block of its own.
+  scoped_refptr<HttpResponseHeaders> Clone() const;
+
   // Appends a representation of this object to the given pickle.
   // The options argument can be a combination of PersistOptions.
   void Persist(Pickle* pickle, PersistOptions options);
@@ -171,6 +179,12 @@ class NET_EXPORT HttpResponseHeaders
                        const base::StringPiece& name,
                        std::string* value) const;
 
+  // Same as above, but returns the value as a slice of the header block,
+  // which stays valid after these headers are modified or destroyed.
+  bool EnumerateHeader(void** iter,
+                       const base::StringPiece& name,
+                       base::SharedStringPiece* value) const;
+
   // Returns true if the response contains the specified header-value pair.
   // Both name and value are compared case insensitively.
   bool HasHeaderValue(const base::StringPiece& name,
@@ -210,6 +224,14 @@ class NET_EXPORT HttpResponseHeaders
                           const base::Time& response_time,
                           const base::Time& current_time) const;
 
+  // Returns true if the response requires validation, but is still within the
+  // window of its stale-while-revalidate directive, in which it may be used
+  // while it is revalidated asynchronously. See RFC 5861. The parameters are
+  // those of RequiresValidation.
+  bool IsWithinStaleWhileRevalidate(const base::Time& request_time,
+                                    const base::Time& response_time,
+                                    const base::Time& current_time) const;
+
   // Returns the amount of time the server claims the response is fresh from
   // the time the response was generated.  See section 13.2.4 of RFC 2616.  See
   // RequiresValidation for a description of the response_time parameter.
@@ -282,7 +304,11 @@ class NET_EXPORT HttpResponseHeaders
   int response_code() const { return response_code_; }
 
   // Returns the raw header string.
-  const std::string& raw_headers() const { return raw_headers_; }
+  const std::string& raw_headers() const { return raw_headers_->data(); }
+
+  // Returns the raw header string as a slice, which can be kept without
+  // copying it.
+  base::SharedStringPiece raw_headers_block() const;
 
  private:
   friend class base::RefCountedThreadSafe<HttpResponseHeaders>;
@@ -317,6 +343,13 @@ class NET_EXPORT HttpResponseHeaders
                        std::string::const_iterator line_end,
                        bool has_headers);
 
+  // Implements EnumerateHeader(), returning the range of the value in the
+  // header block.
+  bool EnumerateHeaderRange(void** iter,
+                            const base::StringPiece& name,
+                            std::string::const_iterator* value_begin,
+                            std::string::const_iterator* value_end) const;
+
   // Find the header in our list (case-insensitive) starting with parsed_ at
   // index |from|.  Returns string::npos if not found.
   size_t FindHeader(size_t from, const base::StringPiece& name) const;
@@ -378,7 +411,10 @@ class NET_EXPORT HttpResponseHeaders
   // maintain as much ancillary fidelity as possible (since it is sometimes
   // hard to tell what may matter down-stream to a consumer of XMLHttpRequest).
   // [*] The status line may be modified.
-  std::string raw_headers_;
+  //
+  // It is shared with the clones of these headers, and never modified once
+  // parsed: Parse() makes a new one.
+  scoped_refptr<base::RefCountedString> raw_headers_;
 
   // This is the parsed HTTP response code.
   int response_code_;
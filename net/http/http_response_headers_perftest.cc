@@ -0,0 +1,155 @@
+// Copyright 2014 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/http/http_response_headers.h"
+
+#include <algorithm>
+#include <string>
+
+#include "base/memory/ref_counted.h"
+#include "base/pickle.h"
+#include "base/strings/shared_string_piece.h"
+#include "base/test/perf_time_logger.h"
+#include "net/http/http_request_headers.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace net {
+
+namespace {
+
+const int kIterations = 100000;
+
+// The headers of a typical response from a large site.
+const char kResponseHeaders[] =
+    "HTTP/1.1 200 OK\n"
+    "Date: Tue, 07 Oct 2014 18:32:46 GMT\n"
+    "Expires: -1\n"
+    "Cache-Control: private, max-age=0\n"
+    "Content-Type: text/html; charset=UTF-8\n"
+    "Set-Cookie: PREF=ID=0123456789abcdef:FF=0:TM=1412706766:LM=1412706766:"
+    "S=abcdefghijklmnop; expires=Thu, 06-Oct-2016 18:32:46 GMT; path=/; "
+    "domain=.example.com\n"
+    "Set-Cookie: NID=67=abcdefghijklmnopqrstuvwxyz0123456789; "
+    "expires=Wed, 08-Apr-2015 18:32:46 GMT; path=/; domain=.example.com; "
+    "HttpOnly\n"
+    "P3P: CP=\"This is not a P3P policy! See the help pages for more info.\"\n"
+    "Server: gws\n"
+    "X-XSS-Protection: 1; mode=block\n"
+    "X-Frame-Options: SAMEORIGIN\n"
+    "Alternate-Protocol: 80:quic,p=0.01\n"
+    "Vary: Accept-Encoding\n"
+    "Content-Encoding: gzip\n"
+    "Transfer-Encoding: chunked\n";
+
+std::string RawResponseHeaders() {
+  std::string raw(kResponseHeaders);
+  std::replace(raw.begin(), raw.end(), '\n', '\0');
+  raw += '\0';
+  return raw;
+}
+
+}  // namespace
+
+TEST(HttpResponseHeadersPerfTest, Parse) {
+  const std::string raw = RawResponseHeaders();
+  base::PerfTimeLogger timer("Response_headers_parse");
+  for (int i = 0; i < kIterations; ++i)
+    scoped_refptr<HttpResponseHeaders> headers(new HttpResponseHeaders(raw));
+  timer.Done();
+}
+
+// Copying the headers, as is done to override them or to hand them to another
+// thread, used to parse them again.
+TEST(HttpResponseHeadersPerfTest, Copy) {
+  scoped_refptr<HttpResponseHeaders> headers(
+      new HttpResponseHeaders(RawResponseHeaders()));
+  {
+    base::PerfTimeLogger timer("Response_headers_copy_by_parsing");
+    for (int i = 0; i < kIterations; ++i) {
+      scoped_refptr<HttpResponseHeaders> copy(
+          new HttpResponseHeaders(headers->raw_headers()));
+    }
+  }
+  {
+    base::PerfTimeLogger timer("Response_headers_clone");
+    for (int i = 0; i < kIterations; ++i)
+      scoped_refptr<HttpResponseHeaders> copy(headers->Clone());
+  }
+}
+
+// Persisting to and restoring from the cache.
+TEST(HttpResponseHeadersPerfTest, PersistAndRestore) {
+  scoped_refptr<HttpResponseHeaders> headers(
+      new HttpResponseHeaders(RawResponseHeaders()));
+  base::PerfTimeLogger timer("Response_headers_persist_restore");
+  for (int i = 0; i < kIterations; ++i) {
+    Pickle pickle;
+    headers->Persist(&pickle, HttpResponseHeaders::PERSIST_SANS_COOKIES);
+    PickleIterator iter(pickle);
+    scoped_refptr<HttpResponseHeaders> restored(
+        new HttpResponseHeaders(pickle, &iter));
+  }
+  timer.Done();
+}
+
+// Reads the headers a transaction reads for each response.
+TEST(HttpResponseHeadersPerfTest, EnumerateHeader) {
+  static const char* const kNames[] = {
+    "cache-control", "content-type", "set-cookie", "vary", "date", "expires",
+    "content-encoding", "alternate-protocol" };
+  scoped_refptr<HttpResponseHeaders> headers(
+      new HttpResponseHeaders(RawResponseHeaders()));
+  {
+    base::PerfTimeLogger timer("Response_headers_enumerate_string");
+    std::string value;
+    for (int i = 0; i < kIterations; ++i) {
+      for (size_t j = 0; j < arraysize(kNames); ++j) {
+        void* iter = NULL;
+        while (headers->EnumerateHeader(&iter, kNames[j], &value)) {}
+      }
+    }
+  }
+  {
+    base::PerfTimeLogger timer("Response_headers_enumerate_shared_piece");
+    base::SharedStringPiece value;
+    for (int i = 0; i < kIterations; ++i) {
+      for (size_t j = 0; j < arraysize(kNames); ++j) {
+        void* iter = NULL;
+        while (headers->EnumerateHeader(&iter, kNames[j], &value)) {}
+      }
+    }
+  }
+}
+
+// The request headers are copied by each layer of transactions that a request
+// goes through, and mostly left unchanged.
+TEST(HttpResponseHeadersPerfTest, CopyRequestHeaders) {
+  HttpRequestHeaders headers;
+  headers.SetHeader(HttpRequestHeaders::kHost, "www.example.com");
+  headers.SetHeader(HttpRequestHeaders::kConnection, "keep-alive");
+  headers.SetHeader("Accept",
+                    "text/html,application/xhtml+xml,application/xml;q=0.9,"
+                    "image/webp,*/*;q=0.8");
+  headers.SetHeader(HttpRequestHeaders::kUserAgent,
+                    "Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 "
+                    "(KHTML, like Gecko) Chrome/38.0.2125.101 Safari/537.36");
+  headers.SetHeader(HttpRequestHeaders::kAcceptEncoding,
+                    "gzip, deflate, sdch");
+  headers.SetHeader(HttpRequestHeaders::kAcceptLanguage, "en-US,en;q=0.8");
+  headers.SetHeader(HttpRequestHeaders::kCookie,
+                    "PREF=ID=0123456789abcdef:FF=0:TM=1412706766; "
+                    "NID=67=abcdefghijklmnopqrstuvwxyz0123456789");
+
+  base::PerfTimeLogger timer("Request_headers_copy");
+  for (int i = 0; i < kIterations; ++i) {
+    HttpRequestHeaders copy;
+    copy.CopyFrom(headers);
+    HttpRequestHeaders copy2;
+    copy2.CopyFrom(copy);
+    EXPECT_TRUE(copy2.HasHeader(HttpRequestHeaders::kCookie));
+  }
+  timer.Done();
+}
+
+}  // namespace net
@@ -8,6 +8,7 @@
 #include "base/basictypes.h"
 #include "base/memory/scoped_ptr.h"
 #include "base/pickle.h"
+#include "base/strings/shared_string_piece.h"
 #include "base/time/time.h"
 #include "base/values.h"
 #include "net/http/http_byte_range.h"
@@ -580,6 +581,63 @@ TEST(HttpResponseHeadersTest, EnumerateHeader_DateValued) {
   EXPECT_EQ("Wed, 01 Aug 2007 23:23:45 GMT", value);
 }
 
+TEST(HttpResponseHeadersTest, EnumerateHeader_SharedStringPiece) {
+  std::string headers =
+      "HTTP/1.1 200 OK\n"
+      "Cache-control:private , no-cache=\"set-cookie,server\" \n"
+      "cache-Control: no-store\n";
+  HeadersToRaw(&headers);
+  scoped_refptr<net::HttpResponseHeaders> parsed(
+      new net::HttpResponseHeaders(headers));
+
+  void* iter = NULL;
+  base::SharedStringPiece value;
+  EXPECT_TRUE(parsed->EnumerateHeader(&iter, "cache-control", &value));
+  EXPECT_EQ("private", value.as_string());
+  EXPECT_TRUE(parsed->EnumerateHeader(&iter, "cache-control", &value));
+  EXPECT_EQ("no-cache=\"set-cookie,server\"", value.as_string());
+  EXPECT_TRUE(parsed->EnumerateHeader(&iter, "cache-control", &value));
+  EXPECT_EQ("no-store", value.as_string());
+
+  // The value points into the header block, and outlives the headers.
+  EXPECT_EQ(parsed->raw_headers_block().buffer().get(), value.buffer().get());
+  parsed = NULL;
+  EXPECT_EQ("no-store", value.as_string());
+}
+
+TEST(HttpResponseHeadersTest, Clone) {
+  std::string headers =
+      "HTTP/1.1 404 Not Found\n"
+      "Cache-control: private\n"
+      "Content-Type: text/html\n";
+  HeadersToRaw(&headers);
+  scoped_refptr<net::HttpResponseHeaders> parsed(
+      new net::HttpResponseHeaders(headers));
+
+  scoped_refptr<net::HttpResponseHeaders> clone = parsed->Clone();
+  EXPECT_EQ(parsed->raw_headers(), clone->raw_headers());
+  EXPECT_EQ(parsed->raw_headers().data(), clone->raw_headers().data());
+  EXPECT_EQ(404, clone->response_code());
+  EXPECT_EQ(parsed->GetHttpVersion(), clone->GetHttpVersion());
+  EXPECT_TRUE(clone->HasHeaderValue("cache-control", "private"));
+
+  // Changing the clone leaves the original alone, and the other way round.
+  clone->ReplaceStatusLine("HTTP/1.1 302 Found");
+  clone->RemoveHeader("Cache-control");
+  EXPECT_EQ(302, clone->response_code());
+  EXPECT_FALSE(clone->HasHeader("cache-control"));
+  EXPECT_EQ(404, parsed->response_code());
+  EXPECT_TRUE(parsed->HasHeaderValue("cache-control", "private"));
+
+  clone = parsed->Clone();
+  parsed->AddHeader("Content-Length: 10");
+  parsed = NULL;
+  EXPECT_FALSE(clone->HasHeader("content-length"));
+  std::string mime_type;
+  EXPECT_TRUE(clone->GetMimeType(&mime_type));
+  EXPECT_EQ("text/html", mime_type);
+}
+
 TEST(HttpResponseHeadersTest, DefaultDateToGMT) {
   // Verify we make the best interpretation when parsing dates that incorrectly
   // do not end in "GMT" as RFC2616 requires.
@@ -946,6 +1004,87 @@ INSTANTIATE_TEST_CASE_P(HttpResponseHeaders,
                         RequiresValidationTest,
                         testing::ValuesIn(requires_validation_tests));
 
+struct StaleWhileRevalidateTestData {
+  const char* headers;
+  bool within_stale_while_revalidate;
+};
+
+class StaleWhileRevalidateTest
+    : public HttpResponseHeadersTest,
+      public ::testing::WithParamInterface<StaleWhileRevalidateTestData> {
+};
+
+TEST_P(StaleWhileRevalidateTest, IsWithinStaleWhileRevalidate) {
+  const StaleWhileRevalidateTestData test = GetParam();
+
+  base::Time request_time, response_time, current_time;
+  base::Time::FromString("Wed, 28 Nov 2007 00:40:09 GMT", &request_time);
+  base::Time::FromString("Wed, 28 Nov 2007 00:40:12 GMT", &response_time);
+  base::Time::FromString("Wed, 28 Nov 2007 00:45:20 GMT", &current_time);
+
+  std::string headers(test.headers);
+  HeadersToRaw(&headers);
+  scoped_refptr<net::HttpResponseHeaders> parsed(
+      new net::HttpResponseHeaders(headers));
+
+  EXPECT_EQ(test.within_stale_while_revalidate,
+            parsed->IsWithinStaleWhileRevalidate(request_time, response_time,
+                                                 current_time));
+}
+
+const struct StaleWhileRevalidateTestData stale_while_revalidate_tests[] = {
+  // Stale, within the window.
+  { "HTTP/1.1 200 OK\n"
+    "cache-control: max-age=300,stale-while-revalidate=60\n"
+    "\n",
+    true
+  },
+  // Stale, past the window.
+  { "HTTP/1.1 200 OK\n"
+    "cache-control: max-age=300,stale-while-revalidate=5\n"
+    "\n",
+    false
+  },
+  // Fresh.
+  { "HTTP/1.1 200 OK\n"
+    "cache-control: max-age=10000,stale-while-revalidate=60\n"
+    "\n",
+    false
+  },
+  // Never fresh, within the window.
+  { "HTTP/1.1 200 OK\n"
+    "cache-control: max-age=0,stale-while-revalidate=600\n"
+    "\n",
+    true
+  },
+  // No window.
+  { "HTTP/1.1 200 OK\n"
+    "cache-control: max-age=300\n"
+    "\n",
+    false
+  },
+  { "HTTP/1.1 200 OK\n"
+    "cache-control: max-age=300,stale-while-revalidate=0\n"
+    "\n",
+    false
+  },
+  // Directives that forbid stale responses.
+  { "HTTP/1.1 200 OK\n"
+    "cache-control: max-age=300,stale-while-revalidate=60,must-revalidate\n"
+    "\n",
+    false
+  },
+  { "HTTP/1.1 200 OK\n"
+    "cache-control: no-cache,stale-while-revalidate=600\n"
+    "\n",
+    false
+  },
+};
+
+INSTANTIATE_TEST_CASE_P(HttpResponseHeaders,
+                        StaleWhileRevalidateTest,
+                        testing::ValuesIn(stale_while_revalidate_tests));
+
 struct UpdateTestData {
   const char* orig_headers;
   const char* new_headers;
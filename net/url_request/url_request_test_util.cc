@@ -433,8 +433,7 @@ int TestNetworkDelegate::OnHeadersReceived(
   next_states_[req_id] |= kStageBeforeSendHeaders;
 
   if (!redirect_on_headers_received_url_.is_empty()) {
-    *override_response_headers =
-        new net::HttpResponseHeaders(original_response_headers->raw_headers());
+    *override_response_headers = original_response_headers->Clone();
     (*override_response_headers)->ReplaceStatusLine("HTTP/1.1 302 Found");
     (*override_response_headers)->RemoveHeader("Location");
     (*override_response_headers)->AddHeader(